@@ -0,0 +1,637 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	batch.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Batch mode: runs all jobs from a job list file ("--batch=").
+ *
+ * 				See batch.h for details.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef MINGW
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "global.h"
+
+#include "batch.h"
+#include "errors.h"
+#include "i18n.h"
+#include "options.h"
+#include "s2g.h"
+#include "tools.h"
+
+
+/*
+ * Helper function for batch_load():
+ * Reads one line of any length from "fp", without the line break.
+ * Returns a newly allocated string or NULL at the end of the file.
+ */
+char *batch_read_line ( FILE *fp )
+{
+	char *line = NULL;
+	size_t len = 0;
+	size_t max = 0;
+	int c;
+
+
+	while ( (c = fgetc ( fp )) != EOF ) {
+		if ( c == '\n' ) {
+			break;
+		}
+		if ( len + 1 >= max ) {
+			max = max > 0 ? max * 2 : PRG_MAX_STR_LEN;
+			line = realloc ( line, sizeof (char) * max );
+		}
+		line[len++] = (char) c;
+	}
+
+	if ( c == EOF && line == NULL ) {
+		return (NULL);
+	}
+	if ( line == NULL ) {
+		line = malloc ( sizeof (char) );
+	}
+	line[len] = '\0';
+	/* DOS line break */
+	if ( len > 0 && line[len-1] == '\r' ) {
+		line[len-1] = '\0';
+	}
+
+	return (line);
+}
+
+
+/*
+ * Releases a NULL terminated list of strings.
+ */
+void batch_free_tokens ( char **tokens )
+{
+	int i;
+
+
+	if ( tokens == NULL ) {
+		return;
+	}
+	for ( i = 0; tokens[i] != NULL; i ++ ) {
+		free ( tokens[i] );
+	}
+	free ( tokens );
+}
+
+
+/*
+ * Helper function for batch_load():
+ * Splits "line" into white space separated tokens. Tokens can be
+ * put into double quotes, to include white space. The number of
+ * tokens is stored in "num".
+ *
+ * Returns a NULL terminated list of new strings. Returns NULL if
+ * the line is empty or a comment (or a quote was not closed).
+ */
+char **batch_tokenize ( const char *line, int *num )
+{
+	char **tokens = NULL;
+	char *token;
+	const char *p = line;
+	BOOLEAN quoted;
+	int len;
+
+
+	*num = 0;
+	while ( *p != '\0' ) {
+		while ( *p != '\0' && isspace ( (unsigned char) *p ) ) {
+			p ++;
+		}
+		if ( *p == '\0' || ( *num == 0 && *p == '#' ) ) {
+			break;
+		}
+		token = malloc ( sizeof (char) * (strlen (p) + 1) );
+		len = 0;
+		quoted = FALSE;
+		while ( *p != '\0' && ( quoted == TRUE || !isspace ( (unsigned char) *p ) ) ) {
+			if ( *p == '"' ) {
+				quoted = !quoted;
+			} else {
+				token[len++] = *p;
+			}
+			p ++;
+		}
+		token[len] = '\0';
+		tokens = realloc ( tokens, sizeof (char*) * (*num + 2) );
+		tokens[*num] = token;
+		tokens[*num + 1] = NULL;
+		(*num) ++;
+		if ( quoted == TRUE ) {
+			batch_free_tokens ( tokens );
+			*num = -1;
+			return (NULL);
+		}
+	}
+
+	return (tokens);
+}
+
+
+/*
+ * Helper function for batch_load():
+ * Returns the index of the option set with options "opts"
+ * (and creates it, if there is none, yet).
+ */
+int batch_get_set ( batch *b, int num_opts, char **opts )
+{
+	int i, j;
+	batch_set *set;
+
+
+	for ( i = 0; i < b->num_sets; i ++ ) {
+		set = &b->sets[i];
+		if ( set->num_opts != num_opts ) {
+			continue;
+		}
+		for ( j = 0; j < num_opts; j ++ ) {
+			if ( strcmp ( set->opts[j], opts[j] ) ) {
+				break;
+			}
+		}
+		if ( j == num_opts ) {
+			return (i);
+		}
+	}
+
+	b->sets = realloc ( b->sets, sizeof (batch_set) * (b->num_sets + 1) );
+	set = &b->sets[b->num_sets];
+	set->num_opts = num_opts;
+	set->opts = malloc ( sizeof (char*) * (num_opts + 1) );
+	for ( j = 0; j < num_opts; j ++ ) {
+		set->opts[j] = strdup ( opts[j] );
+	}
+	set->opts[num_opts] = NULL;
+	set->ctx = NULL;
+	set->error = NULL;
+	b->num_sets ++;
+
+	return (b->num_sets - 1);
+}
+
+
+/*
+ * Reads the job list "file" into "b".
+ * Exits with an error message if the list cannot be read or
+ * has errors.
+ */
+void batch_load ( batch *b, const char *file )
+{
+	FILE *fp;
+	char *line;
+	char **tokens;
+	unsigned int line_no = 0;
+	int num_tokens;
+	int i, sep;
+	batch_job *job;
+
+
+	fp = t_fopen_utf8 ( file, "r" );
+	if ( fp == NULL ) {
+		err_show ( ERR_EXIT, _("Cannot open job list for reading ('%s').\nReason: %s"),
+				file, strerror (errno));
+		return;
+	}
+
+	while ( (line = batch_read_line ( fp )) != NULL ) {
+		line_no ++;
+		tokens = batch_tokenize ( line, &num_tokens );
+		free ( line );
+		if ( num_tokens < 0 ) {
+			err_show ( ERR_EXIT, _("Job list '%s', line %u: Missing closing quote."), file, line_no );
+		}
+		if ( tokens == NULL ) {
+			continue;
+		}
+		for ( sep = 0; sep < num_tokens; sep ++ ) {
+			if ( !strcmp ( tokens[sep], BATCH_OPTS_SEPARATOR ) ) {
+				break;
+			}
+		}
+		if ( sep < 3 ) {
+			err_show ( ERR_EXIT, _("Job list '%s', line %u: Need output folder, base name and input file(s)."),
+					file, line_no );
+		}
+		b->jobs = realloc ( b->jobs, sizeof (batch_job) * (b->num_jobs + 1) );
+		job = &b->jobs[b->num_jobs];
+		job->line = line_no;
+		job->output = strdup ( tokens[0] );
+		job->base = strdup ( tokens[1] );
+		job->num_input = sep - 2;
+		job->input = malloc ( sizeof (char*) * (job->num_input + 1) );
+		for ( i = 0; i < job->num_input; i ++ ) {
+			job->input[i] = strdup ( tokens[i+2] );
+		}
+		job->input[job->num_input] = NULL;
+		if ( sep < num_tokens ) {
+			job->set = batch_get_set ( b, num_tokens - sep - 1, &tokens[sep+1] );
+		} else {
+			job->set = batch_get_set ( b, 0, NULL );
+		}
+		job->pid = 0;
+		job->failed = FALSE;
+		b->num_jobs ++;
+		batch_free_tokens ( tokens );
+	}
+
+	fclose ( fp );
+
+	if ( b->num_jobs < 1 ) {
+		err_show ( ERR_EXIT, _("Job list '%s' contains no jobs."), file );
+	}
+}
+
+
+/*
+ * Helper function for batch_setup():
+ * Returns FALSE if warning "msg" has already been produced
+ * by the setup of any option set before set no. "set".
+ */
+BOOLEAN batch_is_new_warning ( batch *b, int set, const char *msg )
+{
+	int i, j;
+	unsigned short type;
+	const char *other;
+
+
+	for ( i = 0; i < set; i ++ ) {
+		if ( b->sets[i].ctx == NULL ) {
+			continue;
+		}
+		for ( j = 0; j < s2g_get_num_messages ( b->sets[i].ctx ); j ++ ) {
+			other = s2g_get_message ( b->sets[i].ctx, j, &type );
+			if ( type == ERR_WARN && !strcmp ( other, msg ) ) {
+				return (FALSE);
+			}
+		}
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Helper function for batch_run():
+ * Sets up one library context for each option set: The context gets
+ * the command line options, plus the set's own options. The schema
+ * and reprojection settings are thus read and checked only once for
+ * all jobs that share the same options. Each job runs in a single
+ * thread, unless its options say otherwise (several jobs will run in
+ * parallel, instead).
+ *
+ * If a context cannot be set up, then all jobs that use it fail.
+ * The reason is kept for their log files.
+ */
+void batch_setup ( batch *b, options *opts )
+{
+	int i, j, k;
+	int argc;
+	char **argv;
+	unsigned short type;
+	const char *msg;
+	batch_set *set;
+
+
+	for ( i = 0; i < b->num_sets; i ++ ) {
+		set = &b->sets[i];
+		argv = malloc ( sizeof (char*) * (opts->argc + set->num_opts + 2) );
+		argc = 0;
+		for ( j = 0; j < opts->argc; j ++ ) {
+			argv[argc++] = opts->argv[j];
+		}
+		argv[argc++] = "--threads=1";
+		for ( j = 0; j < set->num_opts; j ++ ) {
+			argv[argc++] = set->opts[j];
+		}
+		argv[argc] = NULL;
+
+		set->ctx = s2g_context_create ();
+		if ( s2g_context_setup ( set->ctx, argc, argv ) != S2G_OK ) {
+			msg = s2g_get_error ( set->ctx );
+			while ( *msg == '\n' ) {
+				msg ++;
+			}
+			if ( set->num_opts > 0 ) {
+				err_show ( ERR_WARN, _("Cannot set up jobs with options '%s ...'.\nReason: %s"),
+						set->opts[0], msg );
+			} else {
+				err_show ( ERR_WARN, _("Cannot set up jobs.\nReason: %s"), msg );
+			}
+			set->error = strdup ( msg );
+			s2g_context_destroy ( set->ctx );
+			set->ctx = NULL;
+			for ( k = 0; k < b->num_jobs; k ++ ) {
+				if ( b->jobs[k].set == i ) {
+					b->jobs[k].failed = TRUE;
+				}
+			}
+		} else {
+			/* pass on setup warnings (but only once, if all sets have them) */
+			for ( j = 0; j < s2g_get_num_messages ( set->ctx ); j ++ ) {
+				msg = s2g_get_message ( set->ctx, j, &type );
+				if ( type == ERR_WARN && batch_is_new_warning ( b, i, msg ) == TRUE ) {
+					err_show ( ERR_WARN, "%s", msg );
+				}
+			}
+		}
+		free ( argv );
+	}
+}
+
+
+/*
+ * Helper function for batch_exec():
+ * Writes all messages of a job into the job's log file,
+ * or to the console, if the log file cannot be opened.
+ * For a job whose options could not be set up, the log
+ * only gives the reason for that.
+ */
+void batch_write_log ( batch *b, batch_job *job, const char *file, int status )
+{
+	s2g_context *ctx = b->sets[job->set].ctx;
+	char *path;
+	const char *msg;
+	unsigned short type;
+	FILE *fp;
+	int i;
+
+
+	path = malloc ( sizeof (char) * (strlen (job->output) + strlen (job->base) +
+			strlen (BATCH_LOG_EXTENSION) + 2) );
+	sprintf ( path, "%s%c%s%s", job->output, PRG_FILE_SEPARATOR, job->base, BATCH_LOG_EXTENSION );
+	fp = t_fopen_utf8 ( path, "w" );
+	if ( fp == NULL ) {
+		fprintf ( stderr, _("WARNING: "));
+		fprintf ( stderr, _("Cannot open log file for writing ('%s').\nReason: %s"),
+				path, strerror (errno) );
+		fprintf ( stderr, "\n" );
+		fp = stderr;
+	}
+
+	fprintf ( fp, _("Job from line %u of '%s'\n"), job->line, file );
+	fprintf ( fp, _("Output: %s%c%s\n"), job->output, PRG_FILE_SEPARATOR, job->base );
+	for ( i = 0; i < job->num_input; i ++ ) {
+		fprintf ( fp, _("Input: %s\n"), job->input[i] );
+	}
+	for ( i = 0; i < b->sets[job->set].num_opts; i ++ ) {
+		fprintf ( fp, _("Option: %s\n"), b->sets[job->set].opts[i] );
+	}
+	fprintf ( fp, "\n" );
+
+	if ( ctx == NULL ) {
+		fprintf ( fp, _("ERROR: "));
+		fprintf ( fp, _("Cannot set up job.\nReason: %s\n"),
+				b->sets[job->set].error != NULL ? b->sets[job->set].error : "" );
+	}
+	for ( i = 0; ctx != NULL && i < s2g_get_num_messages ( ctx ); i ++ ) {
+		msg = s2g_get_message ( ctx, i, &type );
+		if ( type == ERR_EXIT ) {
+			fprintf ( fp, _("ERROR: "));
+		}
+		if ( type == ERR_WARN ) {
+			fprintf ( fp, _("WARNING: "));
+		}
+		if ( type == ERR_DBUG ) {
+			fprintf ( fp, _("DEBUG: "));
+		}
+		fprintf ( fp, "%s\n", msg );
+	}
+
+	if ( status == S2G_OK ) {
+		fprintf ( fp, _("\nJob completed.\n") );
+	} else {
+		fprintf ( fp, _("\nJob failed.\n") );
+	}
+
+	if ( fp != stderr ) {
+		fclose ( fp );
+	}
+	free ( path );
+}
+
+
+/*
+ * Runs one job (in the calling process) and writes its log.
+ * Returns S2G_OK or S2G_ERROR.
+ */
+int batch_exec ( batch *b, batch_job *job, const char *file )
+{
+	int status;
+
+
+	status = s2g_process_files ( b->sets[job->set].ctx, job->output, job->base,
+			job->num_input, (const char**) job->input );
+	batch_write_log ( b, job, file, status );
+
+	return (status);
+}
+
+
+/*
+ * Helper function for batch_run():
+ * Shows the result of a finished job.
+ */
+void batch_report ( batch_job *job )
+{
+	if ( job->failed == TRUE ) {
+		err_show ( ERR_WARN, _("Job from line %u failed (see '%s%c%s%s')."),
+				job->line, job->output, PRG_FILE_SEPARATOR, job->base, BATCH_LOG_EXTENSION );
+	} else {
+		err_show ( ERR_NOTE, _("Job from line %u completed: %s%c%s"),
+				job->line, job->output, PRG_FILE_SEPARATOR, job->base );
+	}
+}
+
+
+#ifdef MINGW
+/*
+ * Helper function for batch_run():
+ * Runs all jobs, one after the other. On Windows, there
+ * is no cheap way to run a job in a copy of the current
+ * process, with the schema already in place.
+ */
+void batch_exec_all ( batch *b, options *opts )
+{
+	int i;
+	batch_job *job;
+
+
+	for ( i = 0; i < b->num_jobs; i ++ ) {
+		job = &b->jobs[i];
+		if ( job->failed == TRUE ) {
+			/* option set could not be set up */
+			batch_write_log ( b, job, opts->batch, S2G_ERROR );
+			batch_report ( job );
+			continue;
+		}
+		if ( batch_exec ( b, job, opts->batch ) != S2G_OK ) {
+			job->failed = TRUE;
+		}
+		batch_report ( job );
+	}
+}
+#else
+/*
+ * Helper function for batch_run():
+ * Runs all jobs, with up to "opts->threads" jobs at the same time.
+ * Each job runs in its own worker process: Those start off with a
+ * copy of the parsed schema and reprojection setup, and a job that
+ * fails (or crashes) cannot affect any other.
+ */
+void batch_exec_all ( batch *b, options *opts )
+{
+	int next = 0;
+	int running = 0;
+	int wstatus;
+	int i;
+	pid_t pid;
+	batch_job *job;
+
+
+	while ( next < b->num_jobs || running > 0 ) {
+		/* start as many jobs as allowed */
+		while ( running < opts->threads && next < b->num_jobs ) {
+			job = &b->jobs[next++];
+			if ( job->failed == TRUE ) {
+				/* option set could not be set up */
+				batch_write_log ( b, job, opts->batch, S2G_ERROR );
+				batch_report ( job );
+				continue;
+			}
+			/* don't let the worker inherit buffered output */
+			fflush ( NULL );
+			pid = fork ();
+			if ( pid < 0 ) {
+				err_show ( ERR_WARN, _("Cannot start job from line %u.\nReason: %s"),
+						job->line, strerror (errno) );
+				job->failed = TRUE;
+				continue;
+			}
+			if ( pid == 0 ) {
+				/* worker process */
+				_exit ( batch_exec ( b, job, opts->batch ) == S2G_OK ? PRG_EXIT_OK : PRG_EXIT_ERR );
+			}
+			job->pid = (long) pid;
+			running ++;
+		}
+		if ( running < 1 ) {
+			break;
+		}
+
+		/* wait for any job to finish */
+		pid = waitpid ( -1, &wstatus, 0 );
+		if ( pid < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			err_show ( ERR_EXIT, _("Lost track of running jobs.\nReason: %s"), strerror (errno) );
+			return;
+		}
+		for ( i = 0; i < b->num_jobs; i ++ ) {
+			job = &b->jobs[i];
+			if ( job->pid == (long) pid ) {
+				job->pid = 0;
+				running --;
+				if ( WIFSIGNALED ( wstatus ) ) {
+					err_show ( ERR_WARN, _("Job from line %u was terminated by signal %i."),
+							job->line, WTERMSIG ( wstatus ) );
+					job->failed = TRUE;
+				} else if ( !WIFEXITED ( wstatus ) || WEXITSTATUS ( wstatus ) != PRG_EXIT_OK ) {
+					job->failed = TRUE;
+				}
+				batch_report ( job );
+				break;
+			}
+		}
+	}
+}
+#endif
+
+
+/*
+ * Releases all memory of a job list.
+ */
+void batch_free ( batch *b )
+{
+	int i;
+
+
+	for ( i = 0; i < b->num_jobs; i ++ ) {
+		free ( b->jobs[i].output );
+		free ( b->jobs[i].base );
+		batch_free_tokens ( b->jobs[i].input );
+	}
+	t_free ( b->jobs );
+	for ( i = 0; i < b->num_sets; i ++ ) {
+		batch_free_tokens ( b->sets[i].opts );
+		s2g_context_destroy ( b->sets[i].ctx );
+		t_free ( b->sets[i].error );
+	}
+	t_free ( b->sets );
+}
+
+
+/*
+ * Runs all jobs from the job list given in "opts" (option "--batch=").
+ * The messages of each job go into a log file named after the job's
+ * output. The program's own messages only report progress.
+ *
+ * Returns the number of failed jobs.
+ */
+int batch_run ( options *opts )
+{
+	batch b;
+	int i;
+	int num_failed = 0;
+
+
+	memset ( &b, 0, sizeof (batch) );
+
+	err_log_init ( opts );
+
+	batch_load ( &b, opts->batch );
+	batch_setup ( &b, opts );
+
+	err_show (ERR_NOTE, _("Running %i job(s) from '%s' with %i option set(s), max. %i at a time."),
+			b.num_jobs, opts->batch, b.num_sets, opts->threads );
+
+	batch_exec_all ( &b, opts );
+
+	for ( i = 0; i < b.num_jobs; i ++ ) {
+		if ( b.jobs[i].failed == TRUE ) {
+			num_failed ++;
+		}
+	}
+	if ( num_failed > 0 ) {
+		err_show (ERR_WARN, _("%i of %i job(s) failed."), num_failed, b.num_jobs );
+	} else {
+		err_show (ERR_NOTE, _("All %i job(s) completed."), b.num_jobs );
+	}
+
+	batch_free ( &b );
+	err_close ();
+
+	return (num_failed);
+}
@@ -0,0 +1,85 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	batch.h
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Batch mode: runs all jobs from a job list file ("--batch=").
+ *
+ * 				Each line of the job list names an output folder, a base
+ * 				name and one or more input files, optionally followed by
+ * 				"--" and options that override those of the command line.
+ * 				The parser schema is read and the reprojection is set up
+ * 				only once for all jobs with the same set of overrides.
+ * 				Jobs run in separate worker processes, several at a time,
+ * 				and the messages of each job are written to its own log.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include "global.h"
+
+#include "options.h"
+#include "s2g.h"
+
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/* string that separates input files from job options in the job list */
+#define BATCH_OPTS_SEPARATOR	"--"
+
+/* extension of the log file written for each job */
+#define BATCH_LOG_EXTENSION		".log"
+
+/*
+ * A set of options that overrides the command line options
+ * for one or more jobs, and the library context set up with it.
+ */
+typedef struct batch_set batch_set;
+struct batch_set
+{
+	int num_opts; /* number of overriding options */
+	char **opts; /* overriding options (as on the command line) */
+	s2g_context *ctx; /* context set up for these options (NULL if setup failed) */
+	char *error; /* reason for a failed setup (or NULL) */
+};
+
+/*
+ * One job from the job list.
+ */
+typedef struct batch_job batch_job;
+struct batch_job
+{
+	unsigned int line; /* line number in the job list */
+	char *output; /* output folder */
+	char *base; /* output base name */
+	int num_input; /* number of input files */
+	char **input; /* input file names */
+	int set; /* index of the job's option set */
+	long pid; /* ID of the worker process (while running) */
+	BOOLEAN failed; /* TRUE if the job could not be completed */
+};
+
+/*
+ * All jobs of a job list.
+ */
+typedef struct batch batch;
+struct batch
+{
+	int num_jobs;
+	batch_job *jobs;
+	int num_sets;
+	batch_set *sets;
+};
+
+/* run all jobs from the job list given in "opts", return number of failed jobs */
+int batch_run ( options *opts );
+
+#endif /* BATCH_H */
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "config.h"
 #include "global.h"
@@ -37,6 +38,15 @@
 /* file handle for error log file */
 static FILE *ERR_LOG_OUTPUT = NULL;
 
+/* thread-specific message queue (see err_queue_attach()) */
+static pthread_key_t ERR_QUEUE_KEY;
+static pthread_once_t ERR_QUEUE_ONCE = PTHREAD_ONCE_INIT;
+
+/* thread-specific jump target for fatal errors and the queue
+   that was attached along with it (see err_trap_attach()) */
+static pthread_key_t ERR_TRAP_KEY;
+static pthread_key_t ERR_TRAP_QUEUE_KEY;
+
 
 /*
  * Store an error message in the global message string.
@@ -54,21 +64,240 @@ void err_msg_clear () {
 }
 
 
+/*
+ * Helper function for err_queue_attach() and err_show():
+ * Creates the keys under which each thread stores its
+ * message queue and fatal error trap (called only once).
+ */
+void err_queue_key_create ( void )
+{
+	pthread_key_create ( &ERR_QUEUE_KEY, NULL );
+	pthread_key_create ( &ERR_TRAP_KEY, NULL );
+	pthread_key_create ( &ERR_TRAP_QUEUE_KEY, NULL );
+}
+
+
+/*
+ * Initializes an empty message queue.
+ */
+void err_queue_init ( err_queue *queue )
+{
+	if ( queue == NULL )
+		return;
+
+	queue->types = NULL;
+	queue->msgs = NULL;
+	queue->num = 0;
+	queue->max = 0;
+	queue->hook = NULL;
+	queue->hook_data = NULL;
+}
+
+
+/*
+ * Sets a function that will be called with every new message
+ * that is added to "queue" (pass NULL to remove it). The hook
+ * is called by the thread that produced the message, so it
+ * can pass messages on while the work is still running. It is
+ * kept when the queue is flushed or freed.
+ */
+void err_queue_set_hook ( err_queue *queue, err_queue_hook hook, void *data )
+{
+	if ( queue == NULL )
+		return;
+
+	queue->hook = hook;
+	queue->hook_data = data;
+}
+
+
+/*
+ * Attaches a message queue to the calling thread: From now on, all
+ * messages passed to err_show() by this thread will be stored in
+ * "queue" instead of being shown. Pass NULL to detach the current
+ * queue and return to normal message output.
+ *
+ * Messages of type ERR_EXIT will also be queued and will only
+ * take effect once the queue is flushed. A worker thread must
+ * therefore stop its own work after it has produced such a message.
+ *
+ * Returns the queue that was attached before (or NULL). A worker
+ * function that may also be run by the calling thread itself (see
+ * t_thread_run() in tools.c) must re-attach that queue when done.
+ */
+err_queue *err_queue_attach ( err_queue *queue )
+{
+	err_queue *previous;
+
+	pthread_once ( &ERR_QUEUE_ONCE, err_queue_key_create );
+	previous = (err_queue*) pthread_getspecific ( ERR_QUEUE_KEY );
+	pthread_setspecific ( ERR_QUEUE_KEY, queue );
+
+	return ( previous );
+}
+
+
+/*
+ * Helper function for err_show():
+ * Appends a copy of message "msg" to "queue".
+ * If memory runs out, then the message is lost.
+ */
+void err_queue_add ( err_queue *queue, unsigned short type, const char *msg )
+{
+	if ( queue->num >= queue->max ) {
+		int max = queue->max > 0 ? queue->max * 2 : 16;
+		unsigned short *types = realloc ( queue->types, sizeof (unsigned short) * max );
+		char **msgs;
+		if ( types == NULL )
+			return;
+		queue->types = types;
+		msgs = realloc ( queue->msgs, sizeof (char*) * max );
+		if ( msgs == NULL )
+			return;
+		queue->msgs = msgs;
+		queue->max = max;
+	}
+	queue->msgs[queue->num] = strdup ( msg );
+	if ( queue->msgs[queue->num] == NULL )
+		return;
+	queue->types[queue->num] = type;
+	queue->num ++;
+	if ( queue->hook != NULL )
+		queue->hook ( type, msg, queue->hook_data );
+}
+
+
+/*
+ * Shows all messages that have been stored in "queue",
+ * in their original order, then releases them.
+ * This must be called from the main thread, with no queue
+ * attached (see err_queue_attach()).
+ */
+void err_queue_flush ( err_queue *queue )
+{
+	int i;
+
+	if ( queue == NULL )
+		return;
+
+	for ( i = 0; i < queue->num; i ++ ) {
+		err_show ( queue->types[i], "%s", queue->msgs[i] );
+		free ( queue->msgs[i] );
+		queue->msgs[i] = NULL; /* in case a fatal error jumps out of here */
+	}
+	t_free ( queue->types );
+	t_free ( queue->msgs );
+	queue->types = NULL;
+	queue->msgs = NULL;
+	queue->num = 0;
+	queue->max = 0;
+}
+
+
+/*
+ * Releases all messages stored in "queue", without showing them.
+ */
+void err_queue_free ( err_queue *queue )
+{
+	int i;
+
+	if ( queue == NULL )
+		return;
+
+	for ( i = 0; i < queue->num; i ++ ) {
+		free ( queue->msgs[i] );
+	}
+	t_free ( queue->types );
+	t_free ( queue->msgs );
+	queue->types = NULL;
+	queue->msgs = NULL;
+	queue->num = 0;
+	queue->max = 0;
+}
+
+
+/*
+ * Attaches a fatal error trap to the calling thread: From now on,
+ * a message of type ERR_EXIT passed to err_show() by this thread will
+ * be shown (or queued) as usual, but then, instead of exiting the
+ * program, err_show() will longjmp() to "trap" (with value "1").
+ * Pass NULL to detach the current trap.
+ *
+ * If a message queue is to be used as well, then it must be attached
+ * first. Fatal errors stored in any other queue (i.e. by a worker
+ * function that runs in this thread) are left for that queue's owner
+ * to flush, as usual.
+ *
+ * This allows the processing pipeline to be run in-process
+ * (see s2g.c). Note that the code after a fatal error is never
+ * run, so anything it would have released must be tracked (and
+ * released) by the code that set up the trap.
+ */
+void err_trap_attach ( jmp_buf *trap )
+{
+	pthread_once ( &ERR_QUEUE_ONCE, err_queue_key_create );
+	pthread_setspecific ( ERR_TRAP_KEY, trap );
+	pthread_setspecific ( ERR_TRAP_QUEUE_KEY, pthread_getspecific ( ERR_QUEUE_KEY ) );
+}
+
+
+/*
+ * Helper function for err_show():
+ * Jumps to the fatal error trap of the calling thread, if
+ * there is one. Returns only if there is none.
+ */
+void err_trap_jump ( void )
+{
+	jmp_buf *trap = (jmp_buf*) pthread_getspecific ( ERR_TRAP_KEY );
+
+	if ( trap != NULL ) {
+		longjmp ( *trap, 1 );
+	}
+}
+
+
 /*
  * Display an error message straight to the console.
  * If a log file has been specified, then the message
  * will also be written to the log.
+ *
+ * If a message queue has been attached to the calling
+ * thread, then the message will be stored there, instead
+ * (see err_queue_attach()).
+ *
+ * If a fatal error trap has been attached to the calling
+ * thread, then messages of type ERR_EXIT will not exit the
+ * program (see err_trap_attach()).
  */
 void err_show ( unsigned short type, const char *format, ... )
 {
 	char buffer[ERR_MSG_LENGTH+1];
 	va_list argp;
+	err_queue *queue;
 #ifdef GUI
 	GtkTextIter iter;
 	GtkTextBuffer *tbuffer;
 	GtkTextMark *mark;
+#endif
+
+
+	va_start(argp, format);
+
+	vsnprintf ( buffer, ERR_MSG_LENGTH, format, argp );
+	va_end(argp);
 
+	/* message from a worker thread: store for later */
+	pthread_once ( &ERR_QUEUE_ONCE, err_queue_key_create );
+	queue = (err_queue*) pthread_getspecific ( ERR_QUEUE_KEY );
+	if ( queue != NULL ) {
+		err_queue_add ( queue, type, buffer );
+		if ( type == ERR_EXIT && queue == pthread_getspecific ( ERR_TRAP_QUEUE_KEY ) ) {
+			err_trap_jump ();
+		}
+		return;
+	}
 
+#ifdef GUI
 	if ( GUI_TEXT_VIEW != NULL ) {
 		if ( OPTIONS_GUI_MODE == TRUE ) {
 			tbuffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(GUI_TEXT_VIEW));
@@ -76,9 +305,6 @@ void err_show ( unsigned short type, const char *format, ... )
 		}
 	}
 #endif
-	va_start(argp, format);
-
-	vsnprintf ( buffer, ERR_MSG_LENGTH, format, argp );
 
 	if ( type == ERR_EXIT ) {
 		ERR_STATUS = 1;
@@ -109,13 +335,15 @@ void err_show ( unsigned short type, const char *format, ... )
 		fprintf ( stderr, "\n");
 		if ( OPTIONS_GUI_MODE == TRUE )
 			fprintf ( stderr, "<ERROR_END>\n" );
+		err_trap_jump ();
 		if ( OPTIONS_GUI_MODE == FALSE )
 			exit (PRG_EXIT_ERR);
 #else
 		fprintf ( stderr, _("ERROR: "));
 		fprintf ( stderr, "%s", buffer );
 		fprintf ( stderr, "\n");
-		/* in non-GUI mode we exit right here! */
+		/* in non-GUI mode we exit right here (unless trapped) */
+		err_trap_jump ();
 		exit (PRG_EXIT_ERR);
 #endif
 	}
@@ -216,7 +444,6 @@ void err_show ( unsigned short type, const char *format, ... )
 		fprintf ( stderr, "\n");
 #endif
 	}
-	va_end(argp);
 }
 
 
@@ -17,6 +17,7 @@
 
 
 #include <stdio.h>
+#include <setjmp.h>
 #include <string.h>
 
 #include "global.h"
@@ -34,6 +35,27 @@
 /* maximum length of an error message string */
 #define ERR_MSG_LENGTH	1000
 
+/* function to call for each message added to a queue (see err_queue_set_hook()) */
+typedef void (*err_queue_hook) ( unsigned short type, const char *msg, void *data );
+
+/*
+ * A queue of messages that have been produced by a worker thread.
+ * While a queue is attached to a thread, all messages passed to
+ * err_show() by that thread are stored in the queue instead of
+ * being shown. The calling (main) thread can then show them, in
+ * the order in which they were produced, by calling err_queue_flush().
+ */
+typedef struct err_queue err_queue;
+struct err_queue
+{
+	unsigned short *types; /* message types (ERR_*) */
+	char **msgs; /* message texts */
+	int num; /* number of messages in the queue */
+	int max; /* number of messages allocated */
+	err_queue_hook hook; /* called for each new message (NULL = none) */
+	void *hook_data; /* passed on to "hook" */
+};
+
 #ifdef MAIN
 char err_msg[ERR_MSG_LENGTH]; /* global buffer for error messages */
 int ERR_STATUS;
@@ -53,6 +75,24 @@ void err_msg_clear ();
 /* display an error message straight to the console */
 void err_show ( unsigned short type, const char *format, ... );
 
+/* initialize an empty message queue */
+void err_queue_init ( err_queue *queue );
+
+/* set a function to call for each message added to a queue (NULL to remove) */
+void err_queue_set_hook ( err_queue *queue, err_queue_hook hook, void *data );
+
+/* attach a message queue to the calling thread (NULL to detach) */
+err_queue *err_queue_attach ( err_queue *queue );
+
+/* show all queued messages, then empty the queue */
+void err_queue_flush ( err_queue *queue );
+
+/* release all queued messages without showing them */
+void err_queue_free ( err_queue *queue );
+
+/* make fatal errors of the calling thread jump to "trap" instead of exiting (NULL to detach) */
+void err_trap_attach ( jmp_buf *trap );
+
 /* initialize message logging facility */
 void err_log_init ( options *opts );
 
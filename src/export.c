@@ -19,6 +19,7 @@
 
 
 #include <errno.h>
+#include <float.h>
 #include <limits.h>
 #include <math.h>
 #include <stdarg.h>
@@ -34,6 +35,7 @@
 #include "i18n.h"
 #include "options.h"
 #include "parser.h"
+#include "reproj.h"
 #include "selections.h"
 #include "tools.h"
 
@@ -60,7 +62,9 @@ static double DXF_LABEL_SIZE_AREA = 0.12;
 static double DXF_LABEL_SIZE_USER = 0.12;
 
 /* forward declarations of functions */
-char *export_float_to_str ( double f );
+int export_float_to_str ( double f, char *dst );
+export_buf *export_buf_open ( const char *path );
+export_buf *export_buf_open_append ( const char *path );
 
 
 /* Checks whether a value can be stored in a DBase
@@ -119,7 +123,7 @@ BOOLEAN export_SHP_DBF_field_width_OK ( char *val, int type, options *opts )
  *
  * The return value is the total number of attribute data errors.
  */
-int export_SHP_write_atts ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
+int export_SHP_write_atts ( 	export_dbf *dbf, geom_store *gs, int GEOM_TYPE,
 		unsigned int pk, unsigned int obj, parser_desc *parser,
 		options *opts )
 {
@@ -198,7 +202,7 @@ int export_SHP_write_atts ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
 	err_count = 0;
 
 	/* first field is always the primary key */
-	success = DBFWriteIntegerAttribute( dbf, obj, 0, pk );
+	success = export_dbf_write_int ( dbf, obj, 0, opts->incremental == TRUE ? obj : pk );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write primary key '%i' into '%s'."),
@@ -232,14 +236,14 @@ int export_SHP_write_atts ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write default XBase NULL value */
-						success = DBFWriteNULLAttribute( dbf, obj, pos );
+						success = export_dbf_write_null ( dbf, obj, pos );
 					} else {
 						/* write user-defined NULL value */
-						success = DBFWriteStringAttribute( dbf, obj, pos, NULL_str );
+						success = export_dbf_write_string ( dbf, obj, pos, NULL_str );
 					}
 				} else {
 					/* write actual field contents */
-					success = DBFWriteStringAttribute( dbf, obj, pos, atts[field_num] );
+					success = export_dbf_write_string ( dbf, obj, pos, atts[field_num] );
 				}
 			}
 
@@ -281,14 +285,14 @@ int export_SHP_write_atts ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write default XBase NULL value */
-						success = DBFWriteNULLAttribute( dbf, obj, pos );
+						success = export_dbf_write_null ( dbf, obj, pos );
 					} else {
 						/* write user-defined NULL value */
-						success = DBFWriteIntegerAttribute( dbf, obj, pos, parser->empty_val );
+						success = export_dbf_write_int ( dbf, obj, pos, parser->empty_val );
 					}
 				} else {
 					/* write actual attribute value */
-					success = DBFWriteIntegerAttribute( dbf, obj, pos, i_value );
+					success = export_dbf_write_int ( dbf, obj, pos, i_value );
 				}
 				if ( success == FALSE ) {
 					/* attribute write error */
@@ -384,15 +388,15 @@ int export_SHP_write_atts ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write default XBase NULL value */
-						success = DBFWriteNULLAttribute( dbf, obj, pos );
+						success = export_dbf_write_null ( dbf, obj, pos );
 					} else {
 						/* write user-defined NULL value */
-						success = DBFWriteDoubleAttribute( dbf, obj, pos, (double) parser->empty_val );
+						success = export_dbf_write_double ( dbf, obj, pos, (double) parser->empty_val );
 					}
 				} else {
 
 					/* write actual attribute value */
-					success = DBFWriteDoubleAttribute( dbf, obj, pos, d_value );
+					success = export_dbf_write_double ( dbf, obj, pos, d_value );
 
 				}
 				if ( success == FALSE ) {
@@ -441,7 +445,7 @@ int export_SHP_write_atts ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
  *
  * The return value is the total number of attribute data errors.
  */
-int export_SHP_write_atts_labels ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE,
+int export_SHP_write_atts_labels ( 	export_dbf *dbf, geom_store *gs, int GEOM_TYPE,
 		unsigned int pk, unsigned int obj, parser_desc *parser,
 		options *opts )
 {
@@ -515,7 +519,7 @@ int export_SHP_write_atts_labels ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE
 	err_count = 0;
 
 	/* first field is always the primary key */
-	success = DBFWriteIntegerAttribute( dbf, obj, 0, pk );
+	success = export_dbf_write_int ( dbf, obj, 0, opts->incremental == TRUE ? obj : pk );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write primary key '%i' into '%s'."),
@@ -545,14 +549,14 @@ int export_SHP_write_atts_labels ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE
 				/* store "no data" representation */
 				if ( parser->empty_val_set == FALSE ) {
 					/* write default XBase NULL value */
-					success = DBFWriteNULLAttribute( dbf, obj, LBL_FIELD_POS_TEXT );
+					success = export_dbf_write_null ( dbf, obj, LBL_FIELD_POS_TEXT );
 				} else {
 					/* write user-defined NULL value */
-					success = DBFWriteStringAttribute( dbf, obj, LBL_FIELD_POS_TEXT, NULL_str );
+					success = export_dbf_write_string ( dbf, obj, LBL_FIELD_POS_TEXT, NULL_str );
 				}
 			} else {
 				/* write actual field contents */
-				success = DBFWriteStringAttribute( dbf, obj, LBL_FIELD_POS_TEXT, atts[field_num] );
+				success = export_dbf_write_string ( dbf, obj, LBL_FIELD_POS_TEXT, atts[field_num] );
 			}
 			if ( success == FALSE ) {
 				err_show ( ERR_NOTE, "" );
@@ -565,35 +569,35 @@ int export_SHP_write_atts_labels ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE
 	}
 
 	/* Write default values into all other fields */
-	success = DBFWriteStringAttribute( dbf, obj, LBL_FIELD_POS_FONT_TYPE, LBL_FIELD_DEFAULT_FONT_TYPE );
+	success = export_dbf_write_string ( dbf, obj, LBL_FIELD_POS_FONT_TYPE, LBL_FIELD_DEFAULT_FONT_TYPE );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write label attribute '%s'."),
 				input, line, LBL_FIELD_NAME_FONT_TYPE );
 		err_count ++;
 	}
-	success = DBFWriteIntegerAttribute( dbf, obj, LBL_FIELD_POS_FONT_STYLE, LBL_FIELD_DEFAULT_FONT_STYLE );
+	success = export_dbf_write_int ( dbf, obj, LBL_FIELD_POS_FONT_STYLE, LBL_FIELD_DEFAULT_FONT_STYLE );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write label attribute '%s'."),
 				input, line, LBL_FIELD_NAME_FONT_STYLE );
 		err_count ++;
 	}
-	success = DBFWriteIntegerAttribute( dbf, obj, LBL_FIELD_POS_FONT_COLOR, LBL_FIELD_DEFAULT_FONT_COLOR );
+	success = export_dbf_write_int ( dbf, obj, LBL_FIELD_POS_FONT_COLOR, LBL_FIELD_DEFAULT_FONT_COLOR );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write label attribute '%s'."),
 				input, line, LBL_FIELD_NAME_FONT_COLOR );
 		err_count ++;
 	}
-	success = DBFWriteDoubleAttribute( dbf, obj, LBL_FIELD_POS_FONT_SIZE, LBL_FIELD_DEFAULT_FONT_SIZE );
+	success = export_dbf_write_double ( dbf, obj, LBL_FIELD_POS_FONT_SIZE, LBL_FIELD_DEFAULT_FONT_SIZE );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write label attribute '%s'."),
 				input, line, LBL_FIELD_NAME_FONT_SIZE );
 		err_count ++;
 	}
-	success = DBFWriteDoubleAttribute( dbf, obj, LBL_FIELD_POS_FONT_ROTATE, LBL_FIELD_DEFAULT_FONT_ROTATE );
+	success = export_dbf_write_double ( dbf, obj, LBL_FIELD_POS_FONT_ROTATE, LBL_FIELD_DEFAULT_FONT_ROTATE );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write label attribute '%s'."),
@@ -607,7 +611,7 @@ int export_SHP_write_atts_labels ( 	DBFHandle dbf, geom_store *gs, int GEOM_TYPE
 	} else if ( GEOM_TYPE == GEOM_TYPE_POLY ) {
 		geom_type = LBL_FIELD_GEOM_TYPE_POLY;
 	}
-	success = DBFWriteIntegerAttribute( dbf, obj, LBL_FIELD_POS_GEOM_TYPE, geom_type );
+	success = export_dbf_write_int ( dbf, obj, LBL_FIELD_POS_GEOM_TYPE, geom_type );
 	if ( success == FALSE ) {
 		err_show ( ERR_NOTE, "" );
 		err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nUnable to write label attribute '%s'."),
@@ -879,6 +883,304 @@ DBFHandle export_SHP_DBFCreate ( const char* pszDBFFile )
 }
 
 
+/*
+ * Opens the Shapefile for one output layer: In incremental mode, an
+ * existing Shapefile is opened, so that new geometries can be appended
+ * to it. Otherwise (or if there is no such file yet), a new Shapefile
+ * is created with export_SHP_SHPCreate().
+ *
+ * Returns NULL on error.
+ */
+SHPHandle export_SHP_SHPOpenOutput ( const char* pszShapeFile, int nShapeType, options *opts )
+{
+	SHPHandle h = NULL;
+	char *path;
+
+
+	/* (checking first avoids Shapelib's message about missing files) */
+	if ( opts->incremental == TRUE && t_file_size_utf8 ( pszShapeFile ) > 0 ) {
+		path = export_SHP_path_utf8_to_native (pszShapeFile);
+		h = SHPOpen ( (const char*)path, "rb+" );
+		if ( path != NULL ) {
+			free ( path );
+		}
+		if ( h != NULL && h->nShapeType != nShapeType ) {
+			int type = h->nShapeType;
+			SHPClose ( h );
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nCannot add %s geometries to existing Shapefile of type %s\n(%s).\nDelete the output files to process all data again."),
+					SHPTypeName ( nShapeType ), SHPTypeName ( type ), pszShapeFile );
+			return ( NULL );
+		}
+	}
+	if ( h == NULL ) {
+		h = export_SHP_SHPCreate ( pszShapeFile, nShapeType );
+	}
+
+	return ( h );
+}
+
+
+/*
+ * Opens the DBase attribute table for one output layer: In incremental
+ * mode, an existing table is opened, so that new records can be appended
+ * to it. Otherwise (or if there is no such file yet), a new table is
+ * created with export_SHP_DBFCreate().
+ * Tables returned by this function have no fields, if they are new.
+ *
+ * Returns NULL on error.
+ */
+DBFHandle export_SHP_DBFOpenOutput ( const char* pszDBFFile, options *opts )
+{
+	DBFHandle h = NULL;
+	char *path;
+
+
+	if ( opts->incremental == TRUE && t_file_size_utf8 ( pszDBFFile ) > 0 ) {
+		path = export_SHP_path_utf8_to_native (pszDBFFile);
+		h = DBFOpen ( (const char*)path, "rb+" );
+		if ( path != NULL ) {
+			free ( path );
+		}
+	}
+	if ( h == NULL ) {
+		h = export_SHP_DBFCreate ( pszDBFFile );
+	}
+
+	return ( h );
+}
+
+
+/*
+ * Restores the Shapefile "shp_path" (with its ".shx" index file) and its
+ * attribute table "dbf_path" to the file sizes they had at the end of an
+ * earlier run (incremental mode): All geometries and records written
+ * since then are removed and the file headers are updated to match.
+ * If "shp_size" is "0", then all three files are deleted, instead.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int export_SHP_rollback ( const char *shp_path, const char *dbf_path,
+		long shp_size, long shx_size, long dbf_size )
+{
+	SHPHandle shp;
+	DBFHandle dbf;
+	char *shx_path;
+	char *path;
+	int result = 0;
+
+
+	shx_path = strdup ( shp_path );
+	if ( strlen (shx_path) >= strlen (".shp") ) {
+		strcpy ( &shx_path[strlen (shx_path) - strlen (".shp")], ".shx" );
+	}
+
+	/* nothing to keep */
+	if ( shp_size <= 0 ) {
+		t_remove_utf8 ( shp_path );
+		t_remove_utf8 ( shx_path );
+		t_remove_utf8 ( dbf_path );
+		free ( shx_path );
+		return ( 0 );
+	}
+
+	/* nothing added since */
+	if ( 	t_file_size_utf8 ( shp_path ) == shp_size &&
+			t_file_size_utf8 ( shx_path ) == shx_size &&
+			t_file_size_utf8 ( dbf_path ) == dbf_size ) {
+		free ( shx_path );
+		return ( 0 );
+	}
+
+	/* let shapelib rewrite the headers for the old number of records */
+	path = export_SHP_path_utf8_to_native ( shp_path );
+	shp = SHPOpen ( (const char*)path, "rb+" );
+	t_free ( path );
+	if ( shp == NULL || ( shx_size - 100 ) / 8 > shp->nRecords ) {
+		SHPClose ( shp );
+		free ( shx_path );
+		return ( -1 );
+	}
+	shp->nRecords = ( shx_size - 100 ) / 8;
+	shp->nFileSize = shp_size;
+	shp->bUpdated = TRUE;
+	SHPClose ( shp );
+
+	path = export_SHP_path_utf8_to_native ( dbf_path );
+	dbf = DBFOpen ( (const char*)path, "rb+" );
+	t_free ( path );
+	if ( dbf == NULL || dbf->nRecordLength < 1 ||
+			( dbf_size - dbf->nHeaderLength ) / dbf->nRecordLength > dbf->nRecords ) {
+		DBFClose ( dbf );
+		free ( shx_path );
+		return ( -1 );
+	}
+	dbf->nRecords = ( dbf_size - dbf->nHeaderLength ) / dbf->nRecordLength;
+	dbf->bUpdated = TRUE;
+	DBFClose ( dbf );
+
+	/* cut off everything that was written later */
+	if ( 	t_truncate_utf8 ( shp_path, shp_size ) != 0 ||
+			t_truncate_utf8 ( shx_path, shx_size ) != 0 ||
+			t_truncate_utf8 ( dbf_path, dbf_size ) != 0 ) {
+		result = -1;
+	}
+	free ( shx_path );
+
+	return ( result );
+}
+
+
+/*
+ * PARALLEL TEXT EXPORT
+ *
+ * Formatting features as text (GeoJSON, KML) takes much more time
+ * than writing the text to disk. So the geometries of each type are
+ * split into ranges of EXPORT_TEXT_JOB_SIZE, which are formatted by
+ * parallel jobs, each one into its own memory buffer. The buffers
+ * are then appended to the output file in the order of the ranges.
+ * Feature IDs are assigned to each range in advance, so the output
+ * is always the same as that of a sequential export.
+ */
+
+/*
+ * Returns the number of geometries of type "GEOM_TYPE" in "gs".
+ */
+int export_text_num_geoms ( geom_store *gs, int GEOM_TYPE )
+{
+	if ( GEOM_TYPE == GEOM_TYPE_POINT ) return ( gs->num_points );
+	if ( GEOM_TYPE == GEOM_TYPE_POINT_RAW ) return ( gs->num_points_raw );
+	if ( GEOM_TYPE == GEOM_TYPE_LINE ) return ( gs->num_lines );
+	if ( GEOM_TYPE == GEOM_TYPE_POLY ) return ( gs->num_polygons );
+	return ( 0 );
+}
+
+
+/*
+ * Returns TRUE if geometry "i" of type "GEOM_TYPE" in "gs"
+ * is selected for output, FALSE otherwise.
+ */
+BOOLEAN export_text_is_selected ( geom_store *gs, int GEOM_TYPE, int i )
+{
+	if ( GEOM_TYPE == GEOM_TYPE_POINT ) return ( gs->points[i].is_selected );
+	if ( GEOM_TYPE == GEOM_TYPE_POINT_RAW ) return ( gs->points_raw[i].is_selected );
+	if ( GEOM_TYPE == GEOM_TYPE_LINE ) return ( gs->lines[i].is_selected );
+	if ( GEOM_TYPE == GEOM_TYPE_POLY ) return ( gs->polygons[i].is_selected );
+	return ( FALSE );
+}
+
+
+/*
+ * Thread function for export_text_write_features() (below):
+ * formats all selected geometries in the range of one job.
+ * All messages are kept in the job's queue, until the
+ * output of the job gets written.
+ */
+void *export_text_write_range ( void *arg )
+{
+	export_text_job *job = (export_text_job*) arg;
+	int geom_id = job->geom_id;
+	int i;
+	err_queue *previous;
+
+	previous = err_queue_attach ( &job->messages );
+
+	for ( i = job->first; i < job->last; i ++ ) {
+		if ( export_text_is_selected ( job->gs, job->GEOM_TYPE, i ) == TRUE ) {
+			job->num_errors += job->write ( job->buf, job, i, geom_id );
+			geom_id ++;
+		}
+	}
+
+	err_queue_attach ( previous );
+
+	return ( NULL );
+}
+
+
+/*
+ * Writes all selected geometries of type "GEOM_TYPE" in "gs" to "fp",
+ * using the callback function "write" to format each one of them. The
+ * first one gets ID "geom_id", the following ones consecutive IDs.
+ * "num_selected" must contain the number of selected geometries for
+ * each type (indexed by GEOM_TYPE_*), for use by "write".
+ *
+ * Formatting is done by up to "opts->threads" parallel threads
+ * (see comments at the start of this section). Output and messages
+ * are exactly the same as if all geometries were written in sequence.
+ *
+ * Returns number of attribute field errors.
+ */
+int export_text_write_features ( export_buf *fp, int (*write) ( export_buf*, export_text_job*, int, int ),
+		int GEOM_TYPE, int geom_id, const int *num_selected,
+		geom_store *gs, parser_desc *parser, options *opts )
+{
+	export_text_job *jobs = NULL;
+	int num_geoms = export_text_num_geoms ( gs, GEOM_TYPE );
+	int max_jobs, num_jobs;
+	int num_errors = 0;
+	int first = 0;
+	int i, j;
+
+
+	if ( num_geoms < 1 ) {
+		return ( 0 );
+	}
+
+	max_jobs = 1;
+	if ( opts->threads > 1 ) {
+		max_jobs = opts->threads * EXPORT_TEXT_JOBS_PER_THREAD;
+	}
+	jobs = malloc ( sizeof (export_text_job) * max_jobs );
+	for ( i = 0; i < max_jobs; i ++ ) {
+		jobs[i].write = write;
+		jobs[i].GEOM_TYPE = GEOM_TYPE;
+		jobs[i].num_selected = num_selected;
+		jobs[i].gs = gs;
+		jobs[i].parser = parser;
+		jobs[i].opts = opts;
+		jobs[i].buf = export_buf_create ( NULL );
+		err_queue_init ( &jobs[i].messages );
+	}
+
+	/* format as many ranges in parallel as there are jobs,
+	   then append their output in order, until done */
+	while ( first < num_geoms ) {
+		num_jobs = 0;
+		while ( num_jobs < max_jobs && first < num_geoms ) {
+			jobs[num_jobs].first = first;
+			jobs[num_jobs].last = first + EXPORT_TEXT_JOB_SIZE;
+			if ( jobs[num_jobs].last > num_geoms ) {
+				jobs[num_jobs].last = num_geoms;
+			}
+			jobs[num_jobs].geom_id = geom_id;
+			for ( j = jobs[num_jobs].first; j < jobs[num_jobs].last; j ++ ) {
+				if ( export_text_is_selected ( gs, GEOM_TYPE, j ) == TRUE ) {
+					geom_id ++;
+				}
+			}
+			jobs[num_jobs].buf->len = 0;
+			jobs[num_jobs].num_errors = 0;
+			first = jobs[num_jobs].last;
+			num_jobs ++;
+		}
+		t_thread_run_pool ( export_text_write_range, jobs, num_jobs, sizeof (export_text_job), opts->threads );
+		for ( i = 0; i < num_jobs; i ++ ) {
+			err_queue_flush ( &jobs[i].messages );
+			export_buf_write ( fp, jobs[i].buf->data, jobs[i].buf->len );
+			num_errors += jobs[i].num_errors;
+		}
+	}
+
+	for ( i = 0; i < max_jobs; i ++ ) {
+		export_buf_close ( jobs[i].buf );
+	}
+	free ( jobs );
+
+	return ( num_errors );
+}
+
+
 /*
  * Creates the attribute data ("properties") for a GeoJSON feature
  * and writes it to the file pointed to by argument 'ft'.
@@ -897,7 +1199,7 @@ DBFHandle export_SHP_DBFCreate ( const char* pszDBFFile )
  *       Therefore, we can only store one set of label properties.
  *       Currently, "part_id" is always as "0".
  */
-int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
+int export_GeoJSON_write_properties ( export_buf *ft, geom_store *gs, int GEOM_TYPE,
 		unsigned int pk, unsigned int geom_id, int part_id,
 		parser_desc *parser, options *opts )
 {
@@ -971,10 +1273,10 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 	/* reset error count to "0" */
 	err_count = 0;
 
-	fprintf ( ft, "      \"properties\": {\n" );
+	export_buf_puts ( ft, "      \"properties\": {\n" );
 
 	/* first property is always the geom ID */
-	fprintf ( ft, "        \"geom_id\": %u", geom_id - 1);
+	export_buf_printf ( ft, "        \"geom_id\": %u", geom_id - 1);
 
 	/* handle label properties */
 	BOOLEAN has_label = FALSE;
@@ -1010,14 +1312,14 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 			label_y = gs->polygons[pk].parts[part_id].label_y;
 		}
 
-		fprintf ( ft, "," );
-		fprintf ( ft, "\n" );
-		char *label_x_str = export_float_to_str ( label_x );
-		char *label_y_str = export_float_to_str ( label_y );
-		fprintf ( ft, "        \"%s\": %s,\n", LBL_FIELD_NAME_X, label_x_str );
-		fprintf ( ft, "        \"%s\": %s,\n", LBL_FIELD_NAME_Y, label_y_str );
-		free (label_x_str);
-		free (label_y_str);
+		export_buf_puts ( ft, "," );
+		export_buf_puts ( ft, "\n" );
+		char label_x_str[EXPORT_FLOAT_STR_LEN];
+		export_float_to_str ( label_x, label_x_str );
+		char label_y_str[EXPORT_FLOAT_STR_LEN];
+		export_float_to_str ( label_y, label_y_str );
+		export_buf_printf ( ft, "        \"%s\": %s,\n", LBL_FIELD_NAME_X, label_x_str );
+		export_buf_printf ( ft, "        \"%s\": %s,\n", LBL_FIELD_NAME_Y, label_y_str );
 		/* get label field and its contents */
 		i = 0;
 		while ( parser->fields[i] != NULL ) {
@@ -1031,29 +1333,29 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write NULL value as empty string */
-						fprintf ( ft, "        \"%s\": \"\",\n", LBL_FIELD_NAME_TEXT );
+						export_buf_printf ( ft, "        \"%s\": \"\",\n", LBL_FIELD_NAME_TEXT );
 					} else {
 						/* write user-defined NULL value */
-						fprintf ( ft, "        \"%s\": \"%s\",\n", LBL_FIELD_NAME_TEXT, NULL_str);
+						export_buf_printf ( ft, "        \"%s\": \"%s\",\n", LBL_FIELD_NAME_TEXT, NULL_str);
 					}
 				} else {
 					/* write actual field contents */
-					fprintf ( ft, "        \"%s\": \"%s\",\n", LBL_FIELD_NAME_TEXT, atts[i]);
+					export_buf_printf ( ft, "        \"%s\": \"%s\",\n", LBL_FIELD_NAME_TEXT, atts[i]);
 				}
 				break;
 			}
 			i ++;
 		}
 		/* write default label properties */
-		fprintf ( ft, "        \"%s\": \"%s\",\n", LBL_FIELD_NAME_FONT_TYPE, LBL_FIELD_DEFAULT_FONT_TYPE);
-		fprintf ( ft, "        \"%s\": %i,\n", LBL_FIELD_NAME_FONT_STYLE, LBL_FIELD_DEFAULT_FONT_STYLE);
-		fprintf ( ft, "        \"%s\": %i,\n", LBL_FIELD_NAME_FONT_COLOR, LBL_FIELD_DEFAULT_FONT_COLOR);
-		char *lbl_field_default_str = export_float_to_str ( LBL_FIELD_DEFAULT_FONT_SIZE );
-		fprintf ( ft, "        \"%s\": %s,\n", LBL_FIELD_NAME_FONT_SIZE, lbl_field_default_str );
-		free ( lbl_field_default_str );
-		char *lbl_field_font_str = export_float_to_str ( LBL_FIELD_DEFAULT_FONT_ROTATE );
-		fprintf ( ft, "        \"%s\": %s", LBL_FIELD_NAME_FONT_ROTATE, lbl_field_font_str );
-		free ( lbl_field_font_str );
+		export_buf_printf ( ft, "        \"%s\": \"%s\",\n", LBL_FIELD_NAME_FONT_TYPE, LBL_FIELD_DEFAULT_FONT_TYPE);
+		export_buf_printf ( ft, "        \"%s\": %i,\n", LBL_FIELD_NAME_FONT_STYLE, LBL_FIELD_DEFAULT_FONT_STYLE);
+		export_buf_printf ( ft, "        \"%s\": %i,\n", LBL_FIELD_NAME_FONT_COLOR, LBL_FIELD_DEFAULT_FONT_COLOR);
+		char lbl_field_default_str[EXPORT_FLOAT_STR_LEN];
+		export_float_to_str ( LBL_FIELD_DEFAULT_FONT_SIZE, lbl_field_default_str );
+		export_buf_printf ( ft, "        \"%s\": %s,\n", LBL_FIELD_NAME_FONT_SIZE, lbl_field_default_str );
+		char lbl_field_font_str[EXPORT_FLOAT_STR_LEN];
+		export_float_to_str ( LBL_FIELD_DEFAULT_FONT_ROTATE, lbl_field_font_str );
+		export_buf_printf ( ft, "        \"%s\": %s", LBL_FIELD_NAME_FONT_ROTATE, lbl_field_font_str );
 	}
 
 	int num_properties = 0;
@@ -1061,15 +1363,15 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 		num_properties ++;
 	}
 	if ( num_properties > 0 ) {
-		fprintf ( ft, "," );
-		fprintf ( ft, "\n" );
+		export_buf_puts ( ft, "," );
+		export_buf_puts ( ft, "\n" );
 		for ( i = 0; i < num_properties; i ++ ) {
 			if ( parser->fields[i]->skip == FALSE ) {
 				if ( !strcasecmp (parser->fields[i]->name,"id") ) {
 					/* "id" is reserved for primary key in GeoJSON! */
-					fprintf ( ft, "        \"_%s\": ", parser->fields[i]->name );
+					export_buf_printf ( ft, "        \"_%s\": ", parser->fields[i]->name );
 				} else {
-					fprintf ( ft, "        \"%s\": ", parser->fields[i]->name );
+					export_buf_printf ( ft, "        \"%s\": ", parser->fields[i]->name );
 				}
 				if ( parser->fields[i]->type == PARSER_FIELD_TYPE_TEXT ) {
 					/*** TEXT ***/
@@ -1077,14 +1379,14 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 						/* store "no data" representation */
 						if ( parser->empty_val_set == FALSE ) {
 							/* write default NULL value */
-							fprintf (ft, "\"\"");
+							export_buf_puts (ft, "\"\"");
 						} else {
 							/* write user-defined NULL value */
-							fprintf (ft, "\"%s\"", NULL_str);
+							export_buf_printf (ft, "\"%s\"", NULL_str);
 						}
 					} else {
 						/* write actual field contents */
-						fprintf (ft, "\"%s\"", atts[i]);
+						export_buf_printf (ft, "\"%s\"", atts[i]);
 					}
 				}
 				if ( parser->fields[i]->type == PARSER_FIELD_TYPE_INT ) {
@@ -1115,14 +1417,14 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 						/* store "no data" representation */
 						if ( parser->empty_val_set == FALSE ) {
 							/* write default integer NULL value */
-							fprintf (ft, "0");
+							export_buf_puts (ft, "0");
 						} else {
 							/* write user-defined NULL value */
-							fprintf (ft, "%i", parser->empty_val);
+							export_buf_printf (ft, "%i", parser->empty_val);
 						}
 					} else {
 						/* write actual attribute value */
-						fprintf (ft, "%i", i_value);
+						export_buf_printf (ft, "%i", i_value);
 					}
 				}
 
@@ -1154,31 +1456,31 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 						/* store "no data" representation */
 						if ( parser->empty_val_set == FALSE ) {
 							/* write default double NULL value */
-							fprintf (ft, "0.0");
+							export_buf_puts (ft, "0.0");
 						} else {
 							/* write user-defined NULL value */
-							fprintf (ft, "%i.0", parser->empty_val);
+							export_buf_printf (ft, "%i.0", parser->empty_val);
 						}
 					} else {
 						/* write actual attribute value */
 						if ( d_value == 0 ) {
-							fprintf (ft, "0.0");
+							export_buf_puts (ft, "0.0");
 						} else {
-							char *d_str = export_float_to_str ( d_value );
-							fprintf (ft, "%s", d_str);
-							free (d_str);
+							char d_str[EXPORT_FLOAT_STR_LEN];
+							export_float_to_str ( d_value, d_str );
+							export_buf_printf (ft, "%s", d_str);
 						}
 					}
 				}
 
 				if ( i < (num_properties-1) ) {
-					fprintf ( ft, "," );
+					export_buf_puts ( ft, "," );
 				}
-				fprintf ( ft, "\n" );
+				export_buf_puts ( ft, "\n" );
 			}
 		}
 	} else {
-		fprintf ( ft, "\n" );
+		export_buf_puts ( ft, "\n" );
 	}
 
 	if ( NULL_str != NULL ) {
@@ -1189,6 +1491,336 @@ int export_GeoJSON_write_properties ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 }
 
 
+/*
+ * Writes geometry "i" of type "GEOM_TYPE" in "gs" as a GeoJSON feature
+ * with ID "geom_id"-1, from the opening to the closing brace. Separators
+ * between features are left to the caller.
+ *
+ * Returns number of attribute field errors.
+ */
+int export_GeoJSON_write_feature ( export_buf *fp, geom_store *gs, int GEOM_TYPE, int i,
+		int geom_id, parser_desc *parser, options *opts )
+{
+	double X,Y,Z;
+	char xf[EXPORT_FLOAT_STR_LEN], yf[EXPORT_FLOAT_STR_LEN], zf[EXPORT_FLOAT_STR_LEN];
+	int j, k, l, m;
+	int att_errors = 0;
+
+
+	/* POLYGONS
+	 *
+	 * Polygons in GeoJSON are quite tricky, because for each part we need
+	 * store the boundaries/rings in a well-defined order: first the outer
+	 * boundary, then all holes.
+	 */
+	if ( GEOM_TYPE == GEOM_TYPE_POLY ) {
+		/* Deciding between GeoJSON geometry types is also a little trickier:
+		 * A polygon is a MultiPolygon if it has at least two parts that are
+		 * _not_ holes. Otherwise it's a simple Polygon. */
+		BOOLEAN is_multi_part = FALSE;
+		int num_non_holes = 0;
+		for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
+			if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
+				num_non_holes ++;
+			}
+		}
+		if ( num_non_holes > 1 ) {
+			is_multi_part = TRUE;
+		}
+
+		export_buf_printf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
+		export_buf_puts ( fp, "      \"geometry\": {\n" );
+		if ( is_multi_part ) {
+			export_buf_puts	( fp, "        \"type\": \"MultiPolygon\",\n" );
+			export_buf_puts	( fp, "        \"coordinates\": [\n" );
+		} else {
+			export_buf_puts	( fp, "        \"type\": \"Polygon\",\n" );
+			export_buf_puts	( fp, "        \"coordinates\": [\n" );
+		}
+		BOOLEAN hole_added = FALSE;
+		for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
+			/* Iterate over all polygon parts that are _not_ holes */
+			if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
+				hole_added = FALSE;
+				if ( is_multi_part ) {
+					export_buf_puts	( fp, "          [\n" );
+					export_buf_puts	( fp, "            [\n" );
+				} else {
+					export_buf_puts	( fp, "          [\n" );
+				}
+				for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
+					X = gs->polygons[i].parts[j].X[k];
+					Y = gs->polygons[i].parts[j].Y[k];
+					export_float_to_str ( X, xf );
+					export_float_to_str ( Y, yf );
+					if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+						Z = gs->polygons[i].parts[j].Z[k];
+					} else {
+						Z = 0.0;
+					}
+					export_float_to_str ( Z, zf );
+
+					if ( is_multi_part ) {
+						export_buf_printf	( fp, "              [%s, %s, %s]", xf, yf, zf );
+					} else {
+						export_buf_printf	( fp, "             [%s, %s, %s]", xf, yf, zf );
+					}
+					if ( k < (gs->polygons[i].parts[j].num_vertices-1) ) {
+						export_buf_puts	( fp, "," );
+					}
+					export_buf_puts	( fp, "\n" );
+				}
+				if ( is_multi_part ) {
+					export_buf_puts	( fp, "            ]" );
+				} else {
+					export_buf_puts	( fp, "          ]" );
+				}
+				/* Iterate over all holes to see which ones are in this part. */
+				for ( k = 0; k < gs->polygons[i].num_parts; k++ ) {
+					if ( gs->polygons[i].parts[k].is_hole == TRUE ) {
+						geom_part *A = &gs->polygons[i].parts[k];
+						geom_part *B = &gs->polygons[i].parts[j];
+						if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
+							BOOLEAN lies_inside_hole = FALSE;
+							/* Eliminate holes that lie within another hole. */
+							for ( l = 0; l < gs->num_polygons && lies_inside_hole == FALSE; l++ ) {
+								for ( m = 0; m < gs->polygons[l].num_parts && lies_inside_hole == FALSE; m++ ) {
+									if ( gs->polygons[l].parts[m].is_hole == TRUE ) {
+										B = &gs->polygons[l].parts[m];
+										if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
+											lies_inside_hole = TRUE;
+										}
+									}
+								}
+							}
+							if ( lies_inside_hole == FALSE ) {
+								/* Add hole to current part. */
+								export_buf_puts	( fp, ", [\n" );
+								for ( l = 0; l < gs->polygons[i].parts[k].num_vertices; l++ ) {
+									X = gs->polygons[i].parts[k].X[l];
+									Y = gs->polygons[i].parts[k].Y[l];
+									export_float_to_str ( X, xf );
+									export_float_to_str ( Y, yf );
+									if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+										Z = gs->polygons[i].parts[k].Z[l];
+									} else {
+										Z = 0.0;
+									}
+									export_float_to_str ( Z, zf );
+
+									if ( is_multi_part ) {
+										export_buf_printf	( fp, "             [%s, %s, %s]", xf, yf, zf );
+									} else {
+										export_buf_printf	( fp, "             [%s, %s, %s]", xf, yf, zf );
+									}
+
+									if ( l < (gs->polygons[i].parts[k].num_vertices-1) ) {
+										export_buf_puts	( fp, "," );
+									}
+									export_buf_puts	( fp, "\n" );
+								}
+								hole_added = TRUE; /* for line break in output file */
+								if ( is_multi_part ) {
+									export_buf_puts	( fp, "            ]" );
+								} else {
+									export_buf_puts	( fp, "          ]" );
+								}
+							}
+						}
+					}
+				}
+			} /* DONE (adding all holes to this part */
+			if ( hole_added == FALSE || j == gs->polygons[i].num_parts-1 ) {
+				export_buf_puts	( fp, "\n" );
+				if ( is_multi_part == TRUE ) {
+					if ( j < gs->polygons[i].num_parts-1 ) {
+						export_buf_puts	( fp, "          ],\n" );
+					} else {
+						export_buf_puts	( fp, "          ]\n" );
+					}
+				}
+			}
+		} /* DONE (adding all parts) */
+		export_buf_puts	( fp, "        ]\n" );
+		export_buf_puts ( fp, "      },\n" );
+		/* write attributes (=properties) */
+		att_errors =
+				export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_POLY,
+						i, geom_id, 0, parser, opts );
+		export_buf_puts ( fp, "      }\n" );
+		export_buf_puts ( fp, "    }" );
+	}
+
+	/* LINES */
+	if ( GEOM_TYPE == GEOM_TYPE_LINE ) {
+		BOOLEAN is_multi_part = FALSE;
+		if ( gs->lines[i].num_parts > 1 ) {
+			is_multi_part = TRUE;
+		}
+		export_buf_printf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
+		export_buf_puts ( fp, "      \"geometry\": {\n" );
+		if ( is_multi_part == TRUE ) {
+			export_buf_puts	( fp, "        \"type\": \"MultiLineString\",\n" );
+			export_buf_puts	( fp, "        \"coordinates\": [\n" );
+		} else {
+			export_buf_puts	( fp, "        \"type\": \"LineString\",\n" );
+			export_buf_puts	( fp, "        \"coordinates\":\n" );
+		}
+		for ( j = 0; j < gs->lines[i].num_parts; j++ ) {
+			if ( is_multi_part == TRUE ) {
+				export_buf_puts	( fp, "          [\n" );
+			} else {
+				export_buf_puts	( fp, "        [\n" );
+			}
+			for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
+				X = gs->lines[i].parts[j].X[k];
+				Y = gs->lines[i].parts[j].Y[k];
+				export_float_to_str ( X, xf );
+				export_float_to_str ( Y, yf );
+				if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+					Z = gs->lines[i].parts[j].Z[k];
+				} else {
+					Z = 0.0;
+				}
+				export_float_to_str ( Z, zf );
+				if ( is_multi_part == TRUE ) {
+					export_buf_printf	( fp, "             [%s, %s, %s]", xf, yf, zf );
+				} else {
+					export_buf_printf	( fp, "           [%s, %s, %s]", xf, yf, zf );
+				}
+				if ( k < (gs->lines[i].parts[j].num_vertices-1) ) {
+					export_buf_puts	( fp, "," );
+				}
+				export_buf_puts	( fp, "\n" );
+			}
+			if ( is_multi_part == TRUE ) {
+				if ( j < gs->lines[i].num_parts-1 ) {
+					export_buf_puts	( fp, "          ],\n" );
+				} else {
+					export_buf_puts	( fp, "          ]\n" );
+				}
+			}
+		}
+		/* DONE (adding all parts) */
+		export_buf_puts	( fp, "        ]\n" );
+		export_buf_puts ( fp, "      },\n" );
+		/* write attributes (=properties) */
+		att_errors =
+				export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_LINE,
+						i, geom_id, 0, parser, opts );
+		export_buf_puts ( fp, "      }\n" );
+		export_buf_puts ( fp, "    }" );
+	}
+
+	/* POINTS */
+	if ( GEOM_TYPE == GEOM_TYPE_POINT ) {
+		X = gs->points[i].X;
+		Y = gs->points[i].Y;
+		export_float_to_str ( X, xf );
+		export_float_to_str ( Y, yf );
+		if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+			Z = gs->points[i].Z;
+		} else {
+			Z = 0.0;
+		}
+		export_float_to_str ( Z, zf );
+		/* write point geometry */
+		export_buf_printf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
+		export_buf_puts ( fp, "      \"geometry\": {\n" );
+		export_buf_puts	( fp, "        \"type\": \"Point\",\n" );
+		export_buf_printf	( fp, "        \"coordinates\": [%s, %s, %s]\n", xf, yf, zf );
+		export_buf_puts ( fp, "      },\n" );
+		/* write attributes (=properties) */
+		att_errors =
+				export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_POINT,
+						i, geom_id, 0, parser, opts );
+		export_buf_puts ( fp, "      }\n" );
+		export_buf_puts ( fp, "    }" );
+	}
+
+	/* RAW VERTICES */
+	if ( GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+		X = gs->points_raw[i].X;
+		Y = gs->points_raw[i].Y;
+		export_float_to_str ( X, xf );
+		export_float_to_str ( Y, yf );
+		if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+			Z = gs->points_raw[i].Z;
+		} else {
+			Z = 0.0;
+		}
+		export_float_to_str ( Z, zf );
+		/* write point geometry */
+		export_buf_printf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
+		export_buf_puts ( fp, "      \"geometry\": {\n" );
+		export_buf_puts	( fp, "        \"type\": \"Point\",\n" );
+		export_buf_puts	( fp, "        \"coordinates\": [\n" );
+		export_buf_printf	( fp, "           %s, %s, %s\n", xf, yf, zf );
+		export_buf_puts	( fp, "        ]\n" );
+		export_buf_puts ( fp, "      },\n" );
+		/* write attributes (=properties) */
+		att_errors =
+				export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_POINT_RAW,
+						i, geom_id, 0, parser, opts );
+		export_buf_puts ( fp, "      }\n" );
+		export_buf_puts ( fp, "    }" );
+	}
+
+	return ( att_errors );
+}
+
+
+/*
+ * Helper function for export_GeoJSON (below): writes one feature
+ * (see export_text_write_features()), followed by a comma if more
+ * features follow, and a line break.
+ */
+int export_GeoJSON_write_record ( export_buf *fp, export_text_job *job, int i, int geom_id )
+{
+	geom_store *gs = job->gs;
+	int num_errors;
+
+
+	num_errors = export_GeoJSON_write_feature ( fp, gs, job->GEOM_TYPE, i, geom_id, job->parser, job->opts );
+
+	if ( job->GEOM_TYPE == GEOM_TYPE_POLY ) {
+		if ( i < gs->num_polygons-1 ) {
+			export_buf_puts ( fp, "," );
+		} else {
+			if ( job->num_selected[GEOM_TYPE_LINE] > 0 || job->num_selected[GEOM_TYPE_POINT] > 0 ) {
+				export_buf_puts ( fp, "," );
+			}
+		}
+	}
+	if ( job->GEOM_TYPE == GEOM_TYPE_LINE ) {
+		if ( i < ( gs->num_lines - 1 ) ) {
+			export_buf_puts ( fp, "," );
+		}  else {
+			if ( job->num_selected[GEOM_TYPE_POINT] > 0 ) {
+				export_buf_puts ( fp, "," );
+			}
+		}
+	}
+	if ( job->GEOM_TYPE == GEOM_TYPE_POINT ) {
+		if ( i < ( gs->num_points - 1 ) ) {
+			export_buf_puts ( fp, "," );
+		}  else {
+			if ( job->num_selected[GEOM_TYPE_POINT_RAW] > 0 ) {
+				export_buf_puts ( fp, "," );
+			}
+		}
+	}
+	if ( job->GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+		if ( i < ( gs->num_points_raw - 1 ) ) {
+			export_buf_puts ( fp, "," );
+		}
+	}
+	export_buf_puts ( fp, "\n" );
+
+	return ( num_errors );
+}
+
+
 /*
  * Writes geometry store objects into a new, single GeoJSON object file
  * with several layers, one for each geometry type, if required.
@@ -1207,7 +1839,8 @@ int export_GeoJSON ( geom_store *gs, parser_desc *parser, options *opts )
 	int num_points = 0;
 	int num_points_raw = 0;
 	int num_lines = 0;
-	FILE *fp = NULL;
+	int num_selected[GEOM_TYPE_ALL];
+	export_buf *fp = NULL;
 	BOOLEAN exist_id = FALSE;
 	BOOLEAN exist_id_renamed = FALSE;
 
@@ -1259,347 +1892,169 @@ int export_GeoJSON ( geom_store *gs, parser_desc *parser, options *opts )
 			num_lines ++;
 		}
 	}
+	num_selected[GEOM_TYPE_POINT] = num_points;
+	num_selected[GEOM_TYPE_POINT_RAW] = num_points_raw;
+	num_selected[GEOM_TYPE_LINE] = num_lines;
+	num_selected[GEOM_TYPE_POLY] = selections_get_num_selected ( GEOM_TYPE_POLY, gs );
 
 	/* Attempt to create output file. */
-	fp = t_fopen_utf8 (gs->path_all, "w+");
+	fp = export_buf_open ( gs->path_all );
 	if ( fp != NULL )
 	{
 		int geom_id = 1;
-		double X,Y,Z;
-		char *xf,*yf,*zf;
-		int i, j, k, l, m;
 
 		/* write header to output file */
-		fprintf ( fp, "{ \"type\": \"FeatureCollection\",\n" );
-		fprintf ( fp, "  \"features\": [\n" );
+		export_buf_puts ( fp, "{ \"type\": \"FeatureCollection\",\n" );
+		export_buf_puts ( fp, "  \"features\": [\n" );
 
-		/* POLYGONS
-		 *
-		 * Polygons in GeoJSON are quite tricky, because for each part we need
-		 * store the boundaries/rings in a well-defined order: first the outer
-		 * boundary, then all holes.
-		 */
-		for (i = 0; i < gs->num_polygons; i ++ ) {
-			if ( gs->polygons[i].is_selected == TRUE ) {
-				/* Deciding between GeoJSON geometry types is also a little trickier:
-				 * A polygon is a MultiPolygon if it has at least two parts that are
-				 * _not_ holes. Otherwise it's a simple Polygon. */
-				BOOLEAN is_multi_part = FALSE;
-				int num_non_holes = 0;
-				for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
-					if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
-						num_non_holes ++;
-					}
-				}
-				if ( num_non_holes > 1 ) {
-					is_multi_part = TRUE;
-				}
+		/* POLYGONS */
+		num_errors += export_text_write_features ( fp, export_GeoJSON_write_record, GEOM_TYPE_POLY, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_POLY];
 
-				fprintf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
-				fprintf ( fp, "      \"geometry\": {\n" );
-				if ( is_multi_part ) {
-					fprintf	( fp, "        \"type\": \"MultiPolygon\",\n" );
-					fprintf	( fp, "        \"coordinates\": [\n" );
-				} else {
-					fprintf	( fp, "        \"type\": \"Polygon\",\n" );
-					fprintf	( fp, "        \"coordinates\": [\n" );
-				}
-				BOOLEAN hole_added = FALSE;
-				for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
-					/* Iterate over all polygon parts that are _not_ holes */
-					if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
-						hole_added = FALSE;
-						if ( is_multi_part ) {
-							fprintf	( fp, "          [\n" );
-							fprintf	( fp, "            [\n" );
-						} else {
-							fprintf	( fp, "          [\n" );
-						}
-						for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
-							X = gs->polygons[i].parts[j].X[k];
-							Y = gs->polygons[i].parts[j].Y[k];
-							xf = export_float_to_str(X);
-							yf = export_float_to_str(Y);
-							if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-								Z = gs->polygons[i].parts[j].Z[k];
-							} else {
-								Z = 0.0;
-							}
-							zf = export_float_to_str(Z);
-
-							if ( is_multi_part ) {
-								fprintf	( fp, "              [%s, %s, %s]", xf, yf, zf );
-							} else {
-								fprintf	( fp, "             [%s, %s, %s]", xf, yf, zf );
-							}
-							if ( k < (gs->polygons[i].parts[j].num_vertices-1) ) {
-								fprintf	( fp, "," );
-							}
-							fprintf	( fp, "\n" );
-							free ( xf );
-							free ( yf );
-							free ( zf );
-						}
-						if ( is_multi_part ) {
-							fprintf	( fp, "            ]" );
-						} else {
-							fprintf	( fp, "          ]" );
-						}
-						/* Iterate over all holes to see which ones are in this part. */
-						for ( k = 0; k < gs->polygons[i].num_parts; k++ ) {
-							if ( gs->polygons[i].parts[k].is_hole == TRUE ) {
-								geom_part *A = &gs->polygons[i].parts[k];
-								geom_part *B = &gs->polygons[i].parts[j];
-								if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
-									BOOLEAN lies_inside_hole = FALSE;
-									/* Eliminate holes that lie within another hole. */
-									for ( l = 0; l < gs->num_polygons && lies_inside_hole == FALSE; l++ ) {
-										for ( m = 0; m < gs->polygons[l].num_parts && lies_inside_hole == FALSE; m++ ) {
-											if ( gs->polygons[l].parts[m].is_hole == TRUE ) {
-												B = &gs->polygons[l].parts[m];
-												if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
-													lies_inside_hole = TRUE;
-												}
-											}
-										}
-									}
-									if ( lies_inside_hole == FALSE ) {
-										/* Add hole to current part. */
-										fprintf	( fp, ", [\n" );
-										for ( l = 0; l < gs->polygons[i].parts[k].num_vertices; l++ ) {
-											X = gs->polygons[i].parts[k].X[l];
-											Y = gs->polygons[i].parts[k].Y[l];
-											xf = export_float_to_str(X);
-											yf = export_float_to_str(Y);
-											if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-												Z = gs->polygons[i].parts[k].Z[l];
-											} else {
-												Z = 0.0;
-											}
-											zf = export_float_to_str(Z);
-
-											if ( is_multi_part ) {
-												fprintf	( fp, "             [%s, %s, %s]", xf, yf, zf );
-											} else {
-												fprintf	( fp, "             [%s, %s, %s]", xf, yf, zf );
-											}
-
-											if ( l < (gs->polygons[i].parts[k].num_vertices-1) ) {
-												fprintf	( fp, "," );
-											}
-											fprintf	( fp, "\n" );
-											free ( xf );
-											free ( yf );
-											free ( zf );
-										}
-										hole_added = TRUE; /* for line break in output file */
-										if ( is_multi_part ) {
-											fprintf	( fp, "            ]" );
-										} else {
-											fprintf	( fp, "          ]" );
-										}
-									}
-								}
-							}
-						}
-					} /* DONE (adding all holes to this part */
-					if ( hole_added == FALSE || j == gs->polygons[i].num_parts-1 ) {
-						fprintf	( fp, "\n" );
-						if ( is_multi_part == TRUE ) {
-							if ( j < gs->polygons[i].num_parts-1 ) {
-								fprintf	( fp, "          ],\n" );
-							} else {
-								fprintf	( fp, "          ]\n" );
-							}
-						}
-					}
-				} /* DONE (adding all parts) */
-				fprintf	( fp, "        ]\n" );
-				fprintf ( fp, "      },\n" );
-				/* write attributes (=properties) */
-				int att_errors =
-						export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_POLY,
-								i, geom_id, 0, parser, opts );
-				fprintf ( fp, "      }\n" );
-				fprintf ( fp, "    }" );
-				if ( i < gs->num_polygons-1 ) {
-					fprintf ( fp, "," );
-				} else {
-					if ( num_lines > 0 || num_points > 0 ) {
-						fprintf ( fp, "," );
-					}
-				}
-				fprintf ( fp, "\n" );
-				num_errors += att_errors;
-				geom_id ++;
-			}
-		}
-
-		/* LINES */
-		for (i = 0; i < gs->num_lines; i ++ ) {
-			if ( gs->lines[i].is_selected == TRUE ) {
-				BOOLEAN is_multi_part = FALSE;
-				if ( gs->lines[i].num_parts > 1 ) {
-					is_multi_part = TRUE;
-				}
-				fprintf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
-				fprintf ( fp, "      \"geometry\": {\n" );
-				if ( is_multi_part == TRUE ) {
-					fprintf	( fp, "        \"type\": \"MultiLineString\",\n" );
-					fprintf	( fp, "        \"coordinates\": [\n" );
-				} else {
-					fprintf	( fp, "        \"type\": \"LineString\",\n" );
-					fprintf	( fp, "        \"coordinates\":\n" );
-				}
-				for ( j = 0; j < gs->lines[i].num_parts; j++ ) {
-					if ( is_multi_part == TRUE ) {
-						fprintf	( fp, "          [\n" );
-					} else {
-						fprintf	( fp, "        [\n" );
-					}
-					for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
-						X = gs->lines[i].parts[j].X[k];
-						Y = gs->lines[i].parts[j].Y[k];
-						xf = export_float_to_str(X);
-						yf = export_float_to_str(Y);
-						if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-							Z = gs->lines[i].parts[j].Z[k];
-						} else {
-							Z = 0.0;
-						}
-						zf = export_float_to_str(Z);
-						if ( is_multi_part == TRUE ) {
-							fprintf	( fp, "             [%s, %s, %s]", xf, yf, zf );
-						} else {
-							fprintf	( fp, "           [%s, %s, %s]", xf, yf, zf );
-						}
-						if ( k < (gs->lines[i].parts[j].num_vertices-1) ) {
-							fprintf	( fp, "," );
-						}
-						fprintf	( fp, "\n" );
-						free ( xf );
-						free ( yf );
-						free ( zf );
-					}
-					if ( is_multi_part == TRUE ) {
-						if ( j < gs->lines[i].num_parts-1 ) {
-							fprintf	( fp, "          ],\n" );
-						} else {
-							fprintf	( fp, "          ]\n" );
-						}
-					}
-				}
-				/* DONE (adding all parts) */
-				fprintf	( fp, "        ]\n" );
-				fprintf ( fp, "      },\n" );
-				/* write attributes (=properties) */
-				int att_errors =
-						export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_LINE,
-								i, geom_id, 0, parser, opts );
-				fprintf ( fp, "      }\n" );
-				fprintf ( fp, "    }" );
-				if ( i < ( gs->num_lines - 1 ) ) {
-					fprintf ( fp, "," );
-				}  else {
-					if ( num_points > 0 ) {
-						fprintf ( fp, "," );
-					}
-				}
-				fprintf ( fp, "\n" );
-				num_errors += att_errors;
-				geom_id ++;
-			}
-		}
+		/* LINES */
+		num_errors += export_text_write_features ( fp, export_GeoJSON_write_record, GEOM_TYPE_LINE, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_LINE];
 
 		/* POINTS */
-		for (i = 0; i < gs->num_points; i ++ ) {
-			if ( gs->points[i].is_selected == TRUE ) {
-				X = gs->points[i].X;
-				Y = gs->points[i].Y;
-				xf = export_float_to_str(X);
-				yf = export_float_to_str(Y);
-				if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-					Z = gs->points[i].Z;
-				} else {
-					Z = 0.0;
-				}
-				zf = export_float_to_str(Z);
-				/* write point geometry */
-				fprintf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
-				fprintf ( fp, "      \"geometry\": {\n" );
-				fprintf	( fp, "        \"type\": \"Point\",\n" );
-				fprintf	( fp, "        \"coordinates\": [%s, %s, %s]\n", xf, yf, zf );
-				fprintf ( fp, "      },\n" );
-				free ( xf );
-				free ( yf );
-				free ( zf );
-				/* write attributes (=properties) */
-				int att_errors =
-						export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_POINT,
-								i, geom_id, 0, parser, opts );
-				fprintf ( fp, "      }\n" );
-				fprintf ( fp, "    }" );
-				if ( i < ( gs->num_points - 1 ) ) {
-					fprintf ( fp, "," );
-				}  else {
-					if ( num_points_raw > 0 ) {
-						fprintf ( fp, "," );
-					}
-				}
-				fprintf ( fp, "\n" );
-				num_errors += att_errors;
-				geom_id ++;
-			}
-		}
+		num_errors += export_text_write_features ( fp, export_GeoJSON_write_record, GEOM_TYPE_POINT, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_POINT];
 
 		/* RAW VERTICES */
-		for (i = 0; i < gs->num_points_raw; i ++ ) {
-			if ( gs->points_raw[i].is_selected == TRUE ) {
-				X = gs->points_raw[i].X;
-				Y = gs->points_raw[i].Y;
-				xf = export_float_to_str(X);
-				yf = export_float_to_str(Y);
-				if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-					Z = gs->points_raw[i].Z;
-				} else {
-					Z = 0.0;
-				}
-				zf = export_float_to_str(Z);
-				/* write point geometry */
-				fprintf ( fp, "    { \"type\": \"Feature\", \"id\": %i,\n", (geom_id)-1 );
-				fprintf ( fp, "      \"geometry\": {\n" );
-				fprintf	( fp, "        \"type\": \"Point\",\n" );
-				fprintf	( fp, "        \"coordinates\": [\n" );
-				fprintf	( fp, "           %s, %s, %s\n", xf, yf, zf );
-				fprintf	( fp, "        ]\n" );
-				fprintf ( fp, "      },\n" );
-				free ( xf );
-				free ( yf );
-				free ( zf );
-				/* write attributes (=properties) */
-				int att_errors =
-						export_GeoJSON_write_properties ( fp, gs, GEOM_TYPE_POINT_RAW,
-								i, geom_id, 0, parser, opts );
-				fprintf ( fp, "      }\n" );
-				fprintf ( fp, "    }" );
-				if ( i < ( gs->num_points_raw - 1 ) ) {
-					fprintf ( fp, "," );
-				}
-				fprintf ( fp, "\n" );
-				num_errors += att_errors;
-				geom_id ++;
-			}
-		}
+		num_errors += export_text_write_features ( fp, export_GeoJSON_write_record, GEOM_TYPE_POINT_RAW, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_POINT_RAW];
+
 		/* write footer to output file */
-		fprintf ( fp, "  ]\n" );
-		fprintf ( fp, "}\n" );
+		export_buf_puts ( fp, "  ]\n" );
+		export_buf_puts ( fp, "}\n" );
 	} else {
 		return ( 0 );
 	}
 
 	/* Close output file. */
 	if ( fp != NULL ) {
-		fclose (fp);
+		export_buf_close ( fp );
+	}
+
+	return ( num_errors );
+}
+
+
+/*
+ * Helper function for export_GeoJSONSeq_write_record (below).
+ * Removes all line breaks and the indentation that follows them
+ * from the first "len" chars of "str", as well as the indentation
+ * of the first line. This turns the pretty-printed output of
+ * export_GeoJSON_write_feature() into a single line. (Attribute
+ * values never contain line breaks, as they are read line by line.)
+ *
+ * Returns the new length of "str".
+ */
+size_t export_GeoJSONSeq_compact ( char *str, size_t len )
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	/* skip indentation of first line */
+	while ( i < len && ( str[i] == ' ' || str[i] == '\t' ) ) {
+		i ++;
+	}
+	while ( i < len ) {
+		if ( str[i] == '\n' ) {
+			i ++;
+			while ( i < len && ( str[i] == ' ' || str[i] == '\t' ) ) {
+				i ++;
+			}
+		} else {
+			str[n] = str[i];
+			n ++;
+			i ++;
+		}
+	}
+
+	return ( n );
+}
+
+
+/*
+ * Helper function for export_GeoJSONSeq (below): writes one feature
+ * as a single line (see export_text_write_features()).
+ */
+int export_GeoJSONSeq_write_record ( export_buf *fp, export_text_job *job, int i, int geom_id )
+{
+	size_t start;
+	int num_errors;
+
+
+	if ( job->opts->record_separator == TRUE ) {
+		export_buf_puts ( fp, "\x1e" );
+	}
+	/* job output is kept in memory, so it can be compacted in place */
+	start = fp->len;
+	num_errors = export_GeoJSON_write_feature ( fp, job->gs, job->GEOM_TYPE, i, geom_id, job->parser, job->opts );
+	fp->len = start + export_GeoJSONSeq_compact ( fp->data + start, fp->len - start );
+	export_buf_puts ( fp, "\n" );
+
+	return ( num_errors );
+}
+
+
+/*
+ * Writes geometry store objects into a new GeoJSON text sequence
+ * file ("GeoJSONL" or "GeoJSONSeq"): one complete GeoJSON feature
+ * per line, without an enclosing FeatureCollection. Such files can
+ * be processed feature by feature by streaming tools.
+ *
+ * Features (and their IDs) are exactly the same as in GeoJSON output.
+ * If option "--record-separator" is set, then each feature is preceded
+ * by an ASCII record separator, as required by RFC 8142.
+ *
+ * Returns number of attribute field errors.
+ */
+int export_GeoJSONSeq ( geom_store *gs, parser_desc *parser, options *opts )
+{
+	static const int geom_types[4] = { GEOM_TYPE_POLY, GEOM_TYPE_LINE, GEOM_TYPE_POINT, GEOM_TYPE_POINT_RAW };
+	int num_selected[GEOM_TYPE_ALL];
+	int num_errors = 0;
+	int geom_id = 1;
+	export_buf *fp = NULL;
+	int t;
+
+
+	/* Check if there is anything to export! */
+	if ( gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons < 1 )  {
+		err_show (ERR_NOTE,"");
+		err_show (ERR_WARN, _("\nNo valid geometries found. No output produced."));
+		return ( 0 );
+	}
+
+	/* Attempt to create output file (or to add to it, in incremental mode). */
+	if ( opts->incremental == TRUE ) {
+		fp = export_buf_open_append ( gs->path_all );
+		geom_id += opts->append_ids;
+	} else {
+		fp = export_buf_open ( gs->path_all );
+	}
+	if ( fp == NULL ) {
+		return ( 0 );
+	}
+
+	for ( t = 0; t < 4; t ++ ) {
+		num_selected[geom_types[t]] = selections_get_num_selected ( geom_types[t], gs );
+	}
+	for ( t = 0; t < 4; t ++ ) {
+		num_errors += export_text_write_features ( fp, export_GeoJSONSeq_write_record, geom_types[t], geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[geom_types[t]];
+	}
+
+	/* Close output file. */
+	if ( export_buf_close ( fp ) != 0 ) {
+		err_show (ERR_NOTE,"");
+		err_show (ERR_WARN, _("\nFailed to write GeoJSONL file\n(%s)."), gs->path_all );
 	}
 
 	return ( num_errors );
@@ -1609,7 +2064,7 @@ int export_GeoJSON ( geom_store *gs, parser_desc *parser, options *opts )
 /*
  * Creates content for the <description> member of KML Placemark.
  */
-void export_KML_write_description ( FILE *ft, geom_store *gs, int GEOM_TYPE,
+void export_KML_write_description ( export_buf *ft, geom_store *gs, int GEOM_TYPE,
 		unsigned int pk, unsigned int geom_id, int part_id,
 		parser_desc *parser, options *opts )
 {
@@ -1617,46 +2072,46 @@ void export_KML_write_description ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 		return;
 	}
 
-	fprintf ( ft, "        <description>\n" );
-	fprintf ( ft, "          <![CDATA[\n" );
-	fprintf ( ft, "            Generated by %s.<p>\n", t_get_prg_name_and_version());
-	fprintf ( ft, "          ]]>\n" );
+	export_buf_puts ( ft, "        <description>\n" );
+	export_buf_puts ( ft, "          <![CDATA[\n" );
+	export_buf_printf ( ft, "            Generated by %s.<p>\n", t_get_prg_name_and_version());
+	export_buf_puts ( ft, "          ]]>\n" );
 	if ( GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
-		fprintf ( ft, "          <![CDATA[" );
-		fprintf ( ft, "            Source:<b> %s</b><br>\n", gs->points_raw[pk].source );
-		fprintf ( ft, "            Line:<b> %u</b><br>\n", gs->points_raw[pk].line );
-		fprintf ( ft, "            True 3D:<b> %i</b><br>\n", gs->points_raw[pk].is_3D );
-		fprintf ( ft, "            X:<b> %.6f</b><br>\n", gs->points_raw[pk].X );
-		fprintf ( ft, "            Y:<b> %.6f</b><br>\n", gs->points_raw[pk].Y );
-		fprintf ( ft, "            Z:<b> %.6f</b>\n", gs->points_raw[pk].Z );
-		fprintf ( ft, "          ]]>\n" );
+		export_buf_puts ( ft, "          <![CDATA[" );
+		export_buf_printf ( ft, "            Source:<b> %s</b><br>\n", gs->points_raw[pk].source );
+		export_buf_printf ( ft, "            Line:<b> %u</b><br>\n", gs->points_raw[pk].line );
+		export_buf_printf ( ft, "            True 3D:<b> %i</b><br>\n", gs->points_raw[pk].is_3D );
+		export_buf_printf ( ft, "            X:<b> %.6f</b><br>\n", gs->points_raw[pk].X );
+		export_buf_printf ( ft, "            Y:<b> %.6f</b><br>\n", gs->points_raw[pk].Y );
+		export_buf_printf ( ft, "            Z:<b> %.6f</b>\n", gs->points_raw[pk].Z );
+		export_buf_puts ( ft, "          ]]>\n" );
 	}
 
 	if ( GEOM_TYPE == GEOM_TYPE_POINT ) {
-		fprintf ( ft, "          <![CDATA[" );
-		fprintf ( ft, "            Source:<b> %s</b><br>\n", gs->points[pk].source );
-		fprintf ( ft, "            Line:<b> %u</b><br>\n", gs->points[pk].line );
-		fprintf ( ft, "            True 3D:<b> %i</b><br>\n", gs->points[pk].is_3D );
-		fprintf ( ft, "            X:<b> %.6f</b><br>\n", gs->points[pk].X );
-		fprintf ( ft, "            Y:<b> %.6f</b><br>\n", gs->points[pk].Y );
-		fprintf ( ft, "            Z:<b> %.6f</b>\n", gs->points[pk].Z );
-		fprintf ( ft, "          ]]>\n" );
+		export_buf_puts ( ft, "          <![CDATA[" );
+		export_buf_printf ( ft, "            Source:<b> %s</b><br>\n", gs->points[pk].source );
+		export_buf_printf ( ft, "            Line:<b> %u</b><br>\n", gs->points[pk].line );
+		export_buf_printf ( ft, "            True 3D:<b> %i</b><br>\n", gs->points[pk].is_3D );
+		export_buf_printf ( ft, "            X:<b> %.6f</b><br>\n", gs->points[pk].X );
+		export_buf_printf ( ft, "            Y:<b> %.6f</b><br>\n", gs->points[pk].Y );
+		export_buf_printf ( ft, "            Z:<b> %.6f</b>\n", gs->points[pk].Z );
+		export_buf_puts ( ft, "          ]]>\n" );
 	}
 
 	if ( GEOM_TYPE == GEOM_TYPE_LINE ) {
-		fprintf ( ft, "          <![CDATA[" );
-		fprintf ( ft, "            Source:<b> %s</b><br>\n", gs->lines[pk].source );
-		fprintf ( ft, "            Line:<b> %u</b><br>\n", gs->lines[pk].line );
-		fprintf ( ft, "            True 3D:<b> %i</b><br>\n", gs->lines[pk].is_3D );
-		fprintf ( ft, "            Parts:<b> %u</b>\n", gs->lines[pk].num_parts );
-		fprintf ( ft, "          ]]>\n" );
+		export_buf_puts ( ft, "          <![CDATA[" );
+		export_buf_printf ( ft, "            Source:<b> %s</b><br>\n", gs->lines[pk].source );
+		export_buf_printf ( ft, "            Line:<b> %u</b><br>\n", gs->lines[pk].line );
+		export_buf_printf ( ft, "            True 3D:<b> %i</b><br>\n", gs->lines[pk].is_3D );
+		export_buf_printf ( ft, "            Parts:<b> %u</b>\n", gs->lines[pk].num_parts );
+		export_buf_puts ( ft, "          ]]>\n" );
 	}
 
 	if ( GEOM_TYPE == GEOM_TYPE_POLY ) {
-		fprintf ( ft, "          <![CDATA[" );
-		fprintf ( ft, "            Source:<b> %s</b><br>\n", gs->polygons[pk].source );
-		fprintf ( ft, "            Line:<b> %u</b><br>\n", gs->polygons[pk].line );
-		fprintf ( ft, "            True 3D:<b> %i</b><br>\n", gs->polygons[pk].is_3D );
+		export_buf_puts ( ft, "          <![CDATA[" );
+		export_buf_printf ( ft, "            Source:<b> %s</b><br>\n", gs->polygons[pk].source );
+		export_buf_printf ( ft, "            Line:<b> %u</b><br>\n", gs->polygons[pk].line );
+		export_buf_printf ( ft, "            True 3D:<b> %i</b><br>\n", gs->polygons[pk].is_3D );
 		int num_parts = 0;
 		int num_holes = 0;
 		int i;
@@ -1667,11 +2122,11 @@ void export_KML_write_description ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 				num_parts ++;
 			}
 		}
-		fprintf ( ft, "            Parts:<b> %i</b><br>\n", num_parts );
-		fprintf ( ft, "            Holes:<b> %i</b>\n", num_holes );
-		fprintf ( ft, "          ]]>\n" );
+		export_buf_printf ( ft, "            Parts:<b> %i</b><br>\n", num_parts );
+		export_buf_printf ( ft, "            Holes:<b> %i</b>\n", num_holes );
+		export_buf_puts ( ft, "          ]]>\n" );
 	}
-	fprintf ( ft, "        </description>\n" );
+	export_buf_puts ( ft, "        </description>\n" );
 }
 
 
@@ -1689,7 +2144,7 @@ void export_KML_write_description ( FILE *ft, geom_store *gs, int GEOM_TYPE,
  *
  * The return value is the total number of attribute data errors.
  */
-int export_KML_write_data ( FILE *ft, geom_store *gs, int GEOM_TYPE,
+int export_KML_write_data ( export_buf *ft, geom_store *gs, int GEOM_TYPE,
 		unsigned int pk, unsigned int geom_id, int part_id,
 		parser_desc *parser, options *opts )
 {
@@ -1760,11 +2215,11 @@ int export_KML_write_data ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 	/* reset error count to "0" */
 	err_count = 0;
 
-	fprintf ( ft, "        <ExtendedData>\n" );
-	fprintf ( ft, "          <SchemaData schemaUrl=\"#attributeTypeId\">\n" );
+	export_buf_puts ( ft, "        <ExtendedData>\n" );
+	export_buf_puts ( ft, "          <SchemaData schemaUrl=\"#attributeTypeId\">\n" );
 
 	/* first property is always the geom ID */
-	fprintf ( ft, "            <SimpleData name=\"%s\">%u</SimpleData>\n", "geom_id", geom_id - 1 );
+	export_buf_printf ( ft, "            <SimpleData name=\"%s\">%u</SimpleData>\n", "geom_id", geom_id - 1 );
 
 	int num_properties = 0;
 	while ( parser->fields[num_properties] != NULL ) {
@@ -1783,14 +2238,14 @@ int export_KML_write_data ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 						/* store "no data" representation */
 						if ( parser->empty_val_set == FALSE ) {
 							/* write default NULL value */
-							fprintf ( ft, "            <SimpleData name=\"%s\">\"\"</SimpleData>\n", field_name );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">\"\"</SimpleData>\n", field_name );
 						} else {
 							/* write user-defined NULL value */
-							fprintf ( ft, "            <SimpleData name=\"%s\">\"%s\"</SimpleData>\n", field_name, NULL_str );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">\"%s\"</SimpleData>\n", field_name, NULL_str );
 						}
 					} else {
 						/* write actual field contents */
-						fprintf ( ft, "            <SimpleData name=\"%s\">\"%s\"</SimpleData>\n", field_name, atts[i] );
+						export_buf_printf ( ft, "            <SimpleData name=\"%s\">\"%s\"</SimpleData>\n", field_name, atts[i] );
 					}
 				}
 				if ( parser->fields[i]->type == PARSER_FIELD_TYPE_INT ) {
@@ -1821,14 +2276,14 @@ int export_KML_write_data ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 						/* store "no data" representation */
 						if ( parser->empty_val_set == FALSE ) {
 							/* write default integer NULL value */
-							fprintf ( ft, "            <SimpleData name=\"%s\">0</SimpleData>\n", field_name );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">0</SimpleData>\n", field_name );
 						} else {
 							/* write user-defined NULL value */
-							fprintf ( ft, "            <SimpleData name=\"%s\">%i</SimpleData>\n", field_name, parser->empty_val );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">%i</SimpleData>\n", field_name, parser->empty_val );
 						}
 					} else {
 						/* write actual attribute value */
-						fprintf ( ft, "            <SimpleData name=\"%s\">%i</SimpleData>\n", field_name, i_value );
+						export_buf_printf ( ft, "            <SimpleData name=\"%s\">%i</SimpleData>\n", field_name, i_value );
 					}
 				}
 
@@ -1860,26 +2315,26 @@ int export_KML_write_data ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 						/* store "no data" representation */
 						if ( parser->empty_val_set == FALSE ) {
 							/* write default double NULL value */
-							fprintf ( ft, "            <SimpleData name=\"%s\">0.0</SimpleData>\n", field_name );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">0.0</SimpleData>\n", field_name );
 						} else {
 							/* write user-defined NULL value */
-							fprintf ( ft, "            <SimpleData name=\"%s\">%i.0</SimpleData>\n", field_name, parser->empty_val );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">%i.0</SimpleData>\n", field_name, parser->empty_val );
 						}
 					} else {
 						/* write actual attribute value */
 						if ( d_value == 0 ) {
-							fprintf ( ft, "            <SimpleData name=\"%s\">0.0</SimpleData>\n", field_name );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">0.0</SimpleData>\n", field_name );
 						} else {
-							char *d_str = export_float_to_str ( d_value );
-							fprintf ( ft, "            <SimpleData name=\"%s\">%s</SimpleData>\n", field_name, d_str );
-							free ( d_str );
+							char d_str[EXPORT_FLOAT_STR_LEN];
+							export_float_to_str ( d_value, d_str );
+							export_buf_printf ( ft, "            <SimpleData name=\"%s\">%s</SimpleData>\n", field_name, d_str );
 						}
 					}
 				}
 			}
 		}
-		fprintf ( ft, "          </SchemaData>\n" );
-		fprintf ( ft, "        </ExtendedData>\n" );
+		export_buf_puts ( ft, "          </SchemaData>\n" );
+		export_buf_puts ( ft, "        </ExtendedData>\n" );
 	}
 
 	if ( NULL_str != NULL ) {
@@ -1890,6 +2345,277 @@ int export_KML_write_data ( FILE *ft, geom_store *gs, int GEOM_TYPE,
 }
 
 
+/*
+ * Writes geometry "i" of type "GEOM_TYPE" in "gs" as a KML Placemark
+ * with ID "geom_id"-1, followed by an empty line.
+ *
+ * Returns number of attribute field errors.
+ */
+int export_KML_write_placemark ( export_buf *fp, geom_store *gs, int GEOM_TYPE, int i,
+		int geom_id, parser_desc *parser, options *opts )
+{
+	double X,Y,Z;
+	char xf[EXPORT_FLOAT_STR_LEN], yf[EXPORT_FLOAT_STR_LEN], zf[EXPORT_FLOAT_STR_LEN];
+	int j, k, l, m;
+	int att_errors = 0;
+
+
+	/* POINTS */
+	if ( GEOM_TYPE == GEOM_TYPE_POINT ) {
+		/* start new Point placemark */
+		export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+		export_buf_printf ( fp, "        <name>Point %i</name>\n", i+1 );
+		export_buf_puts ( fp, "        <styleUrl>#point</styleUrl>\n" );
+		/* write kml description member */
+		export_KML_write_description ( fp, gs, GEOM_TYPE_POINT, i, geom_id, 0, parser, opts );
+		/* attribute data */
+		att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_POINT, i, geom_id, 0, parser, opts );
+		/* DEBUG */
+		/*
+		X = ( gs->points[i].X - 3513040.0 );
+		Y = ( gs->points[i].Y - 5279880.0 );
+		X = X / 2.0;
+		Y = Y / 2.0;
+		 */
+		X = gs->points[i].X;
+		Y = gs->points[i].Y;
+		export_float_to_str ( X, xf );
+		export_float_to_str ( Y, yf );
+		if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+			Z = gs->points[i].Z;
+		} else {
+			Z = 0.0;
+		}
+		export_float_to_str ( Z, zf );
+		/* write point geometry */
+		export_buf_puts ( fp, "        <Point>\n" );
+		export_buf_printf ( fp, "          <coordinates>%s,%s,%s</coordinates>\n", xf, yf, zf );
+		export_buf_puts ( fp, "        </Point>\n" );
+		export_buf_puts ( fp, "      </Placemark>\n" );
+		export_buf_puts ( fp, "\n" );
+	}
+
+	/* LINES */
+	if ( GEOM_TYPE == GEOM_TYPE_LINE ) {
+		BOOLEAN is_multi_part = FALSE;
+		if ( gs->lines[i].num_parts > 1 ) {
+			is_multi_part = TRUE;
+		}
+		/* start new LineString placemark */
+		export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+		if ( is_multi_part == FALSE ) {
+			export_buf_printf ( fp, "        <name>Line %i (single part)</name>\n", i+1 );
+		} else {
+			export_buf_printf ( fp, "        <name>Line %i (multi part)</name>\n", i+1 );
+		}
+		export_buf_puts ( fp, "        <styleUrl>#line</styleUrl>\n" );
+		/* write kml description member */
+		export_KML_write_description ( fp, gs, GEOM_TYPE_LINE, i, geom_id, 0, parser, opts );
+		/* attribute data */
+		att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_LINE, i, geom_id, 0, parser, opts );
+		for ( j = 0; j < gs->lines[i].num_parts; j++ ) {
+			export_buf_puts ( fp, "        <LineString>\n" );
+			export_buf_puts ( fp, "          <altitudeMode>absolute</altitudeMode>\n" );
+			export_buf_puts ( fp, "          <coordinates>\n" );
+			for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
+				/* DEBUG */
+				/*
+				X = ( gs->lines[i].parts[j].X[k] - 3513040.0 );
+				Y = ( gs->lines[i].parts[j].Y[k] - 5279880.0 );
+				X = X / 2.0;
+				Y = Y / 2.0;
+				 */
+				X = gs->lines[i].parts[j].X[k];
+				Y = gs->lines[i].parts[j].Y[k];
+				export_float_to_str ( X, xf );
+				export_float_to_str ( Y, yf );
+				if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+					Z = gs->lines[i].parts[j].Z[k];
+				} else {
+					Z = 0.0;
+				}
+				export_float_to_str ( Z, zf );
+				export_buf_printf	( fp, "            %s,%s,%s\n", xf, yf, zf );
+			}
+			export_buf_puts ( fp, "          </coordinates>\n" );
+		}
+		export_buf_puts ( fp, "        </LineString>\n" );
+		export_buf_puts ( fp, "      </Placemark>\n" );
+		export_buf_puts ( fp, "\n" );
+	}
+
+	/* POLYGONS
+	 *
+	 * Polygons in KML are quite tricky, because for each part we need
+	 * store the boundaries/rings in a well-defined order: first the outer
+	 * boundary, then all holes.
+	 */
+	if ( GEOM_TYPE == GEOM_TYPE_POLY ) {
+
+		/* Multi-part polygons are represented by collecting :
+		 * A polygon is a MultiPolygon if it has at least two parts that are
+		 * _not_ holes. Otherwise it's a simple Polygon. */
+		BOOLEAN is_multi_part = FALSE;
+		int num_non_holes = 0;
+		for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
+			if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
+				num_non_holes ++;
+			}
+		}
+		if ( num_non_holes > 1 ) {
+			is_multi_part = TRUE;
+		}
+		/* start new Polygon placemark */
+		export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+		if ( is_multi_part == FALSE ) {
+			export_buf_printf ( fp, "        <name>Polygon %i (single part)</name>\n", i+1 );
+		} else {
+			export_buf_printf ( fp, "        <name>Polygon %i (multi part)</name>\n", i+1 );
+		}
+		export_buf_puts ( fp, "        <styleUrl>#polygon</styleUrl>\n" );
+		/* write kml description member */
+		export_KML_write_description ( fp, gs, GEOM_TYPE_POLY, i, geom_id, 0, parser, opts );
+		/* attribute data */
+		att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_POLY, i, geom_id, 0, parser, opts );
+		for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
+			/* Iterate over all polygon parts that are _not_ holes */
+			if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
+				export_buf_puts ( fp, "        <Polygon>\n" );
+				export_buf_puts ( fp, "          <altitudeMode>absolute</altitudeMode>\n" );
+				export_buf_puts ( fp, "          <outerBoundaryIs>\n" );
+				export_buf_puts ( fp, "            <LinearRing>\n" );
+				export_buf_puts ( fp, "              <coordinates>\n" );
+				for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
+					/* DEBUG */
+					/*
+					X = gs->polygons[i].parts[j].X[k] - 3513040.0;
+					Y = gs->polygons[i].parts[j].Y[k] - 5279880.0;
+					X = X / 2.0;
+					Y = Y / 2.0;
+					 */
+					X = gs->polygons[i].parts[j].X[k];
+					Y = gs->polygons[i].parts[j].Y[k];
+					export_float_to_str ( X, xf );
+					export_float_to_str ( Y, yf );
+					if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+						Z = gs->polygons[i].parts[j].Z[k];
+					} else {
+						Z = 0.0;
+					}
+					export_float_to_str ( Z, zf );
+					export_buf_printf	( fp, "                %s,%s,%s\n", xf, yf, zf );
+				}
+				export_buf_puts ( fp, "              </coordinates>\n" );
+				export_buf_puts ( fp, "            </LinearRing>\n" );
+				export_buf_puts ( fp, "          </outerBoundaryIs>\n" );
+				/* Iterate over all holes to see which ones are in this part. */
+				/* for ( k = 0; k < 0; k++ ) { */
+				for ( k = 0; k < gs->polygons[i].num_parts; k++ ) {
+					if ( gs->polygons[i].parts[k].is_hole == TRUE ) {
+						geom_part *A = &gs->polygons[i].parts[k];
+						geom_part *B = &gs->polygons[i].parts[j];
+						if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
+							BOOLEAN lies_inside_hole = FALSE;
+							/* Eliminate holes that lie within another hole. */
+							for ( l = 0; l < gs->num_polygons && lies_inside_hole == FALSE; l++ ) {
+								for ( m = 0; m < gs->polygons[l].num_parts && lies_inside_hole == FALSE; m++ ) {
+									if ( gs->polygons[l].parts[m].is_hole == TRUE ) {
+										B = &gs->polygons[l].parts[m];
+										if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
+											lies_inside_hole = TRUE;
+										}
+									}
+								}
+							}
+							if ( lies_inside_hole == FALSE ) {
+								/* Add hole to current part. */
+								export_buf_puts ( fp, "          <innerBoundaryIs>\n" );
+								export_buf_puts ( fp, "            <LinearRing>\n" );
+								export_buf_puts ( fp, "              <coordinates>\n" );
+								for ( l = 0; l < gs->polygons[i].parts[k].num_vertices; l++ ) {
+									/* DEBUG */
+									/*
+									X = gs->polygons[i].parts[k].X[l] - 3513040.0;
+									Y = gs->polygons[i].parts[k].Y[l] - 5279880.0;
+									X = X / 2.0;
+									Y = Y / 2.0;
+									 */
+									X = gs->polygons[i].parts[k].X[l];
+									Y = gs->polygons[i].parts[k].Y[l];
+									export_float_to_str ( X, xf );
+									export_float_to_str ( Y, yf );
+									if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+										Z = gs->polygons[i].parts[k].Z[l];
+									} else {
+										Z = 0.0;
+									}
+									export_float_to_str ( Z, zf );
+									export_buf_printf	( fp, "                %s,%s,%s\n", xf, yf, zf );
+								}
+								export_buf_puts ( fp, "              </coordinates>\n" );
+								export_buf_puts ( fp, "            </LinearRing>\n" );
+								export_buf_puts ( fp, "          </innerBoundaryIs>\n" );
+							}
+						}
+					}
+				}
+			} /* DONE (adding all holes to this part */
+		} /* DONE (adding all parts) */
+		export_buf_puts ( fp, "        </Polygon>\n" );
+		export_buf_puts ( fp, "      </Placemark>\n" );
+		export_buf_puts ( fp, "\n" );
+	}
+
+	/* RAW VERTICES */
+	if ( GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+		/* start new Point placemark */
+		export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+		export_buf_printf ( fp, "        <name>%i</name>\n", i+1 );
+		export_buf_puts ( fp, "        <visibility>0</visibility>\n"); /* hidden by default */
+		export_buf_puts ( fp, "        <styleUrl>#vertex</styleUrl>\n" );
+		/* write kml description member */
+		export_KML_write_description ( fp, gs, GEOM_TYPE_POINT_RAW, i, geom_id, 0, parser, opts );
+		/* attribute data */
+		att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_POINT_RAW, i, geom_id, 0, parser, opts );
+		/* DEBUG */
+		/*
+		X = ( gs->points_raw[i].X - 3513040.0 );
+		Y = ( gs->points_raw[i].Y - 5279880.0 );
+		X = X / 2.0;
+		Y = Y / 2.0;
+		 */
+		X = gs->points_raw[i].X;
+		Y = gs->points_raw[i].Y;
+		export_float_to_str ( X, xf );
+		export_float_to_str ( Y, yf );
+		if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+			Z = gs->points_raw[i].Z;
+		} else {
+			Z = 0.0;
+		}
+		export_float_to_str ( Z, zf );
+		/* write point geometry */
+		export_buf_puts ( fp, "        <Point>\n" );
+		export_buf_printf ( fp, "          <coordinates>%s,%s,%s</coordinates>\n", xf, yf, zf );
+		export_buf_puts ( fp, "        </Point>\n" );
+		export_buf_puts ( fp, "      </Placemark>\n" );
+		export_buf_puts ( fp, "\n" );
+	}
+
+	return ( att_errors );
+}
+
+
+/*
+ * Helper function for export_KML (below): writes one Placemark
+ * (see export_text_write_features()).
+ */
+int export_KML_write_record ( export_buf *fp, export_text_job *job, int i, int geom_id )
+{
+	return ( export_KML_write_placemark ( fp, job->gs, job->GEOM_TYPE, i, geom_id, job->parser, job->opts ) );
+}
+
+
 /*
  * Writes geometry store objects into a new, single KML XML file
  * with several layers, one for each geometry type, if required.
@@ -1909,8 +2635,9 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 	int num_points_raw = 0;
 	int num_lines = 0;
 	int num_polygons = 0;
+	int num_selected[GEOM_TYPE_ALL];
 
-	FILE *fp = NULL;
+	export_buf *fp = NULL;
 
 
 	/* Check if there is anything to export! */
@@ -1947,39 +2674,43 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 			num_polygons ++;
 		}
 	}
+	num_selected[GEOM_TYPE_POINT] = num_points;
+	num_selected[GEOM_TYPE_POINT_RAW] = num_points_raw;
+	num_selected[GEOM_TYPE_LINE] = num_lines;
+	num_selected[GEOM_TYPE_POLY] = num_polygons;
 
 	/* Attempt to create output file. */
-	fp = t_fopen_utf8 (gs->path_all, "w+");
+	fp = export_buf_open ( gs->path_all );
 	if ( fp != NULL ) {
 		int geom_id = 1;
 		double X,Y,Z;
-		char *xf,*yf,*zf;
-		int i, j, k, l, m;
+		char xf[EXPORT_FLOAT_STR_LEN], yf[EXPORT_FLOAT_STR_LEN], zf[EXPORT_FLOAT_STR_LEN];
+		int i, j;
 
 		/* write header to output file */
-		fprintf ( fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" );
-		fprintf ( fp, "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n" );
-		fprintf ( fp, "  <Document>\n" );
+		export_buf_puts ( fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" );
+		export_buf_puts ( fp, "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n" );
+		export_buf_puts ( fp, "  <Document>\n" );
 
-		fprintf ( fp, "    <name>%s_%s.kml (Survey2GIS KML export)</name> \n", opts->base, GEOM_TYPE_NAMES[GEOM_TYPE_ALL] );
+		export_buf_printf ( fp, "    <name>%s_%s.kml (Survey2GIS KML export)</name> \n", opts->base, GEOM_TYPE_NAMES[GEOM_TYPE_ALL] );
 
 		/* build attribute schema */
-		fprintf ( fp, "\n    <Schema name=\"attributeType\" id=\"attributeTypeId\">\n" );
-		fprintf ( fp, "      <SimpleField type=\"string\" name=\"geom_id\">\n" );
-		fprintf ( fp, "        <displayName><![CDATA[%s]]></displayName>\n", "geom_id (uint)" );
-		fprintf ( fp, "      </SimpleField>\n" );
+		export_buf_puts ( fp, "\n    <Schema name=\"attributeType\" id=\"attributeTypeId\">\n" );
+		export_buf_puts ( fp, "      <SimpleField type=\"string\" name=\"geom_id\">\n" );
+		export_buf_printf ( fp, "        <displayName><![CDATA[%s]]></displayName>\n", "geom_id (uint)" );
+		export_buf_puts ( fp, "      </SimpleField>\n" );
 		i = 0;
 		while ( parser->fields[i] != NULL ) {
 			if ( parser->fields[i]->skip == FALSE ) {
-				fprintf ( fp, "      <SimpleField type=\"%s\" name=\"%s\">\n",
+				export_buf_printf ( fp, "      <SimpleField type=\"%s\" name=\"%s\">\n",
 						PARSER_FIELD_TYPE_NAMES_KML[parser->fields[i]->type], parser->fields[i]->name );
-				fprintf ( fp, "        <displayName><![CDATA[%s (%s)]]></displayName>\n", parser->fields[i]->name,
+				export_buf_printf ( fp, "        <displayName><![CDATA[%s (%s)]]></displayName>\n", parser->fields[i]->name,
 						PARSER_FIELD_TYPE_NAMES[parser->fields[i]->type]);
-				fprintf ( fp, "      </SimpleField>\n" );
+				export_buf_puts ( fp, "      </SimpleField>\n" );
 			}
 			i ++;
 		}
-		fprintf ( fp, "    </Schema>\n" );
+		export_buf_puts ( fp, "    </Schema>\n" );
 
 		/* geometry styles
 		 * NOTE KML colour coding is quite braindead:
@@ -1990,445 +2721,192 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 		 *
 		 */
 		/* polygons */
-		fprintf ( fp, "\n    <Style id=\"polygon\">\n" );
-		fprintf ( fp, "      <LineStyle>\n" );
-		fprintf ( fp, "        <width>1.0</width>\n" );
-		fprintf ( fp, "        <color>ff595959</color>\n" );
-		fprintf ( fp, "      </LineStyle>\n" );
-		fprintf ( fp, "      <PolyStyle>\n" );
-		fprintf ( fp, "        <color>7d595959</color>\n" );
-		fprintf ( fp, "      </PolyStyle>\n" );
-		fprintf ( fp, "      <BalloonStyle>\n" );
-		fprintf ( fp, "        <text>\n" );
-		fprintf ( fp, "          <![CDATA[\n" );
-		fprintf ( fp, "            <h2>$[name]</h2>\n" );
-		fprintf ( fp, "            <h3>Description</h3>\n" );
-		fprintf ( fp, "            $[description]\n" );
-		fprintf ( fp, "            <h3>Data</h3>\n" );
-		fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
+		export_buf_puts ( fp, "\n    <Style id=\"polygon\">\n" );
+		export_buf_puts ( fp, "      <LineStyle>\n" );
+		export_buf_puts ( fp, "        <width>1.0</width>\n" );
+		export_buf_puts ( fp, "        <color>ff595959</color>\n" );
+		export_buf_puts ( fp, "      </LineStyle>\n" );
+		export_buf_puts ( fp, "      <PolyStyle>\n" );
+		export_buf_puts ( fp, "        <color>7d595959</color>\n" );
+		export_buf_puts ( fp, "      </PolyStyle>\n" );
+		export_buf_puts ( fp, "      <BalloonStyle>\n" );
+		export_buf_puts ( fp, "        <text>\n" );
+		export_buf_puts ( fp, "          <![CDATA[\n" );
+		export_buf_puts ( fp, "            <h2>$[name]</h2>\n" );
+		export_buf_puts ( fp, "            <h3>Description</h3>\n" );
+		export_buf_puts ( fp, "            $[description]\n" );
+		export_buf_puts ( fp, "            <h3>Data</h3>\n" );
+		export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
 		i = 0;
 		while ( parser->fields[i] != NULL ) {
 			if ( parser->fields[i]->skip == FALSE ) {
-				fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
+				export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
 						parser->fields[i]->name,
 						parser->fields[i]->name );
 			}
 			i ++;
 		}
-		fprintf ( fp, "          ]]>\n" );
-		fprintf ( fp, "        </text>\n" );
-		fprintf ( fp, "      </BalloonStyle>\n" );
-		fprintf ( fp, "    </Style>\n" );
+		export_buf_puts ( fp, "          ]]>\n" );
+		export_buf_puts ( fp, "        </text>\n" );
+		export_buf_puts ( fp, "      </BalloonStyle>\n" );
+		export_buf_puts ( fp, "    </Style>\n" );
 		/* lines */
-		fprintf ( fp, "    <Style id=\"line\">\n" );
-		fprintf ( fp, "      <LineStyle>\n" );
-		fprintf ( fp, "        <width>1.0</width>\n" );
-		fprintf ( fp, "        <color>ffffffff</color>\n" );
-		fprintf ( fp, "      </LineStyle>\n" );
-		fprintf ( fp, "      <BalloonStyle>\n" );
-		fprintf ( fp, "        <text>\n" );
-		fprintf ( fp, "          <![CDATA[\n" );
-		fprintf ( fp, "            <h2>$[name]</h2>\n" );
-		fprintf ( fp, "            <h3>Description</h3>\n" );
-		fprintf ( fp, "            $[description]\n" );
-		fprintf ( fp, "            <h3>Data</h3>\n" );
-		fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
+		export_buf_puts ( fp, "    <Style id=\"line\">\n" );
+		export_buf_puts ( fp, "      <LineStyle>\n" );
+		export_buf_puts ( fp, "        <width>1.0</width>\n" );
+		export_buf_puts ( fp, "        <color>ffffffff</color>\n" );
+		export_buf_puts ( fp, "      </LineStyle>\n" );
+		export_buf_puts ( fp, "      <BalloonStyle>\n" );
+		export_buf_puts ( fp, "        <text>\n" );
+		export_buf_puts ( fp, "          <![CDATA[\n" );
+		export_buf_puts ( fp, "            <h2>$[name]</h2>\n" );
+		export_buf_puts ( fp, "            <h3>Description</h3>\n" );
+		export_buf_puts ( fp, "            $[description]\n" );
+		export_buf_puts ( fp, "            <h3>Data</h3>\n" );
+		export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
 		i = 0;
 		while ( parser->fields[i] != NULL ) {
 			if ( parser->fields[i]->skip == FALSE ) {
-				fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
+				export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
 						parser->fields[i]->name,
 						parser->fields[i]->name );
 			}
 			i ++;
 		}
-		fprintf ( fp, "          ]]>\n" );
-		fprintf ( fp, "        </text>\n" );
-		fprintf ( fp, "      </BalloonStyle>\n" );
-		fprintf ( fp, "    </Style>\n" );
+		export_buf_puts ( fp, "          ]]>\n" );
+		export_buf_puts ( fp, "        </text>\n" );
+		export_buf_puts ( fp, "      </BalloonStyle>\n" );
+		export_buf_puts ( fp, "    </Style>\n" );
 		/* points */
-		fprintf ( fp, "    <Style id=\"point\">\n" );
-		fprintf ( fp, "      <LabelStyle>\n" );
-		fprintf ( fp, "        <scale>0.0</scale>\n" );
-		fprintf ( fp, "      </LabelStyle>\n" );
-		fprintf ( fp, "      <IconStyle>\n" );
-		fprintf ( fp, "        <scale>0.75</scale>\n" );
-		fprintf ( fp, "        <Icon>\n" );
-		fprintf ( fp, "          <href>http://maps.google.com/mapfiles/kml/shapes/placemark_circle.png</href>\n" );
-		fprintf ( fp, "        </Icon>\n" );
-		fprintf ( fp, "      </IconStyle>\n" );
-		fprintf ( fp, "      <BalloonStyle>\n" );
-		fprintf ( fp, "        <text>\n" );
-		fprintf ( fp, "          <![CDATA[\n" );
-		fprintf ( fp, "            <h2>$[name]</h2>\n" );
-		fprintf ( fp, "            <h3>Description</h3>\n" );
-		fprintf ( fp, "            $[description]\n" );
-		fprintf ( fp, "            <h3>Data</h3>\n" );
-		fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
+		export_buf_puts ( fp, "    <Style id=\"point\">\n" );
+		export_buf_puts ( fp, "      <LabelStyle>\n" );
+		export_buf_puts ( fp, "        <scale>0.0</scale>\n" );
+		export_buf_puts ( fp, "      </LabelStyle>\n" );
+		export_buf_puts ( fp, "      <IconStyle>\n" );
+		export_buf_puts ( fp, "        <scale>0.75</scale>\n" );
+		export_buf_puts ( fp, "        <Icon>\n" );
+		export_buf_puts ( fp, "          <href>http://maps.google.com/mapfiles/kml/shapes/placemark_circle.png</href>\n" );
+		export_buf_puts ( fp, "        </Icon>\n" );
+		export_buf_puts ( fp, "      </IconStyle>\n" );
+		export_buf_puts ( fp, "      <BalloonStyle>\n" );
+		export_buf_puts ( fp, "        <text>\n" );
+		export_buf_puts ( fp, "          <![CDATA[\n" );
+		export_buf_puts ( fp, "            <h2>$[name]</h2>\n" );
+		export_buf_puts ( fp, "            <h3>Description</h3>\n" );
+		export_buf_puts ( fp, "            $[description]\n" );
+		export_buf_puts ( fp, "            <h3>Data</h3>\n" );
+		export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
 		i = 0;
 		while ( parser->fields[i] != NULL ) {
 			if ( parser->fields[i]->skip == FALSE ) {
-				fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
+				export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
 						parser->fields[i]->name,
 						parser->fields[i]->name );
 			}
 			i ++;
 		}
-		fprintf ( fp, "          ]]>\n" );
-		fprintf ( fp, "        </text>\n" );
-		fprintf ( fp, "      </BalloonStyle>\n" );
-		fprintf ( fp, "    </Style>\n" );
+		export_buf_puts ( fp, "          ]]>\n" );
+		export_buf_puts ( fp, "        </text>\n" );
+		export_buf_puts ( fp, "      </BalloonStyle>\n" );
+		export_buf_puts ( fp, "    </Style>\n" );
 
 		/* vertices */
-		fprintf ( fp, "    <Style id=\"vertex\">\n" );
-		fprintf ( fp, "      <LabelStyle>\n" );
-		fprintf ( fp, "        <scale>0.5</scale>\n" );
-		fprintf ( fp, "      </LabelStyle>\n" );
-		fprintf ( fp, "      <IconStyle>\n" );
-		fprintf ( fp, "        <Icon>\n" );
-		fprintf ( fp, "          <href>http://maps.google.com/mapfiles/kml/shapes/placemark_circle_highlight.png</href>\n" );
-		fprintf ( fp, "        </Icon>\n" );
-		fprintf ( fp, "        <scale>0.5</scale>\n" );
-		fprintf ( fp, "      </IconStyle>\n" );
-		fprintf ( fp, "      <BalloonStyle>\n" );
-		fprintf ( fp, "        <text>\n" );
-		fprintf ( fp, "          <![CDATA[\n" );
-		fprintf ( fp, "            <h2>Vertex $[name]</h2>\n" );
-		fprintf ( fp, "            <h3>Description</h3>\n" );
-		fprintf ( fp, "            $[description]\n" );
-		fprintf ( fp, "            <h3>Data</h3>\n" );
-		fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
+		export_buf_puts ( fp, "    <Style id=\"vertex\">\n" );
+		export_buf_puts ( fp, "      <LabelStyle>\n" );
+		export_buf_puts ( fp, "        <scale>0.5</scale>\n" );
+		export_buf_puts ( fp, "      </LabelStyle>\n" );
+		export_buf_puts ( fp, "      <IconStyle>\n" );
+		export_buf_puts ( fp, "        <Icon>\n" );
+		export_buf_puts ( fp, "          <href>http://maps.google.com/mapfiles/kml/shapes/placemark_circle_highlight.png</href>\n" );
+		export_buf_puts ( fp, "        </Icon>\n" );
+		export_buf_puts ( fp, "        <scale>0.5</scale>\n" );
+		export_buf_puts ( fp, "      </IconStyle>\n" );
+		export_buf_puts ( fp, "      <BalloonStyle>\n" );
+		export_buf_puts ( fp, "        <text>\n" );
+		export_buf_puts ( fp, "          <![CDATA[\n" );
+		export_buf_puts ( fp, "            <h2>Vertex $[name]</h2>\n" );
+		export_buf_puts ( fp, "            <h3>Description</h3>\n" );
+		export_buf_puts ( fp, "            $[description]\n" );
+		export_buf_puts ( fp, "            <h3>Data</h3>\n" );
+		export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n", "geom_id", "geom_id" );
 		i = 0;
 		while ( parser->fields[i] != NULL ) {
 			if ( parser->fields[i]->skip == FALSE ) {
-				fprintf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
+				export_buf_printf ( fp, "            $[attributeType/%s/displayName]:<b> $[attributeType/%s]</b><br/>\n",
 						parser->fields[i]->name,
 						parser->fields[i]->name );
 			}
 			i ++;
 		}
-		fprintf ( fp, "          ]]>\n" );
-		fprintf ( fp, "        </text>\n" );
-		fprintf ( fp, "      </BalloonStyle>\n" );
-		fprintf ( fp, "    </Style>\n" );
+		export_buf_puts ( fp, "          ]]>\n" );
+		export_buf_puts ( fp, "        </text>\n" );
+		export_buf_puts ( fp, "      </BalloonStyle>\n" );
+		export_buf_puts ( fp, "    </Style>\n" );
 		/* labels */
-		fprintf ( fp, "    <Style id=\"label\">\n" );
-		fprintf ( fp, "      <LabelStyle>\n" );
-		fprintf ( fp, "        <scale>0.75</scale>\n" );
-		fprintf ( fp, "        <color>ff6dfffa</color>\n" );
-		fprintf ( fp, "      </LabelStyle>\n" );
-		fprintf ( fp, "      <IconStyle>\n" );
-		fprintf ( fp, "        <scale>0.0</scale>\n" );
-		fprintf ( fp, "      </IconStyle>\n" );
-		fprintf ( fp, "    </Style>\n" );
+		export_buf_puts ( fp, "    <Style id=\"label\">\n" );
+		export_buf_puts ( fp, "      <LabelStyle>\n" );
+		export_buf_puts ( fp, "        <scale>0.75</scale>\n" );
+		export_buf_puts ( fp, "        <color>ff6dfffa</color>\n" );
+		export_buf_puts ( fp, "      </LabelStyle>\n" );
+		export_buf_puts ( fp, "      <IconStyle>\n" );
+		export_buf_puts ( fp, "        <scale>0.0</scale>\n" );
+		export_buf_puts ( fp, "      </IconStyle>\n" );
+		export_buf_puts ( fp, "    </Style>\n" );
 
 		/* POINTS */
 		if ( num_points > 0 ) {
-			fprintf ( fp, "\n    <Folder>\n" );
-			fprintf ( fp, "      <name>Points (%i)</name>\n", num_points );
-		}
-		for (i = 0; i < gs->num_points; i ++ ) {
-			if ( gs->points[i].is_selected == TRUE ) {
-				/* start new Point placemark */
-				fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
-				fprintf ( fp, "        <name>Point %i</name>\n", i+1 );
-				fprintf ( fp, "        <styleUrl>#point</styleUrl>\n" );
-				/* write kml description member */
-				export_KML_write_description ( fp, gs, GEOM_TYPE_POINT, i, geom_id, 0, parser, opts );
-				/* attribute data */
-				int att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_POINT, i, geom_id, 0, parser, opts );
-				num_errors += att_errors;
-				/* DEBUG */
-				/*
-				X = ( gs->points[i].X - 3513040.0 );
-				Y = ( gs->points[i].Y - 5279880.0 );
-				X = X / 2.0;
-				Y = Y / 2.0;
-				 */
-				X = gs->points[i].X;
-				Y = gs->points[i].Y;
-				xf = export_float_to_str(X);
-				yf = export_float_to_str(Y);
-				if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-					Z = gs->points[i].Z;
-				} else {
-					Z = 0.0;
-				}
-				zf = export_float_to_str(Z);
-				/* write point geometry */
-				fprintf ( fp, "        <Point>\n" );
-				fprintf ( fp, "          <coordinates>%s,%s,%s</coordinates>\n", xf, yf, zf );
-				fprintf ( fp, "        </Point>\n" );
-				free ( xf );
-				free ( yf );
-				free ( zf );
-				fprintf ( fp, "      </Placemark>\n" );
-				fprintf ( fp, "\n" );
-				geom_id ++;
-			}
+			export_buf_puts ( fp, "\n    <Folder>\n" );
+			export_buf_printf ( fp, "      <name>Points (%i)</name>\n", num_points );
 		}
+		num_errors += export_text_write_features ( fp, export_KML_write_record, GEOM_TYPE_POINT, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_POINT];
 		if ( num_points > 0 ) {
-			fprintf ( fp, "    </Folder>\n" );
+			export_buf_puts ( fp, "    </Folder>\n" );
 		}
 
 		/* LINES */
 		if ( num_lines > 0 ) {
-			fprintf ( fp, "\n    <Folder>\n" );
-			fprintf ( fp, "      <name>Lines (%i)</name>\n", num_lines );
-		}
-		for (i = 0; i < gs->num_lines; i ++ ) {
-			if ( gs->lines[i].is_selected == TRUE ) {
-				BOOLEAN is_multi_part = FALSE;
-				if ( gs->lines[i].num_parts > 1 ) {
-					is_multi_part = TRUE;
-				}
-				/* start new LineString placemark */
-				fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
-				if ( is_multi_part == FALSE ) {
-					fprintf ( fp, "        <name>Line %i (single part)</name>\n", i+1 );
-				} else {
-					fprintf ( fp, "        <name>Line %i (multi part)</name>\n", i+1 );
-				}
-				fprintf ( fp, "        <styleUrl>#line</styleUrl>\n" );
-				/* write kml description member */
-				export_KML_write_description ( fp, gs, GEOM_TYPE_LINE, i, geom_id, 0, parser, opts );
-				/* attribute data */
-				int att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_LINE, i, geom_id, 0, parser, opts );
-				num_errors += att_errors;
-				for ( j = 0; j < gs->lines[i].num_parts; j++ ) {
-					fprintf ( fp, "        <LineString>\n" );
-					fprintf ( fp, "          <altitudeMode>absolute</altitudeMode>\n" );
-					fprintf ( fp, "          <coordinates>\n" );
-					for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
-						/* DEBUG */
-						/*
-						X = ( gs->lines[i].parts[j].X[k] - 3513040.0 );
-						Y = ( gs->lines[i].parts[j].Y[k] - 5279880.0 );
-						X = X / 2.0;
-						Y = Y / 2.0;
-						 */
-						X = gs->lines[i].parts[j].X[k];
-						Y = gs->lines[i].parts[j].Y[k];
-						xf = export_float_to_str(X);
-						yf = export_float_to_str(Y);
-						if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-							Z = gs->lines[i].parts[j].Z[k];
-						} else {
-							Z = 0.0;
-						}
-						zf = export_float_to_str(Z);
-						fprintf	( fp, "            %s,%s,%s\n", xf, yf, zf );
-						free ( xf );
-						free ( yf );
-						free ( zf );
-					}
-					fprintf ( fp, "          </coordinates>\n" );
-				}
-				fprintf ( fp, "        </LineString>\n" );
-				fprintf ( fp, "      </Placemark>\n" );
-				fprintf ( fp, "\n" );
-				geom_id ++;
-			}
+			export_buf_puts ( fp, "\n    <Folder>\n" );
+			export_buf_printf ( fp, "      <name>Lines (%i)</name>\n", num_lines );
 		}
+		num_errors += export_text_write_features ( fp, export_KML_write_record, GEOM_TYPE_LINE, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_LINE];
 		if ( num_polygons > 0 ) {
-			fprintf ( fp, "    </Folder>\n" );
+			export_buf_puts ( fp, "    </Folder>\n" );
 		}
 
-		/* POLYGONS
-		 *
-		 * Polygons in KML are quite tricky, because for each part we need
-		 * store the boundaries/rings in a well-defined order: first the outer
-		 * boundary, then all holes.
-		 */
+		/* POLYGONS */
 		if ( num_polygons > 0 ) {
-			fprintf ( fp, "\n    <Folder>\n" );
-			fprintf ( fp, "      <name>Polygons (%i)</name>\n", num_polygons );
+			export_buf_puts ( fp, "\n    <Folder>\n" );
+			export_buf_printf ( fp, "      <name>Polygons (%i)</name>\n", num_polygons );
+		}
+		num_errors += export_text_write_features ( fp, export_KML_write_record, GEOM_TYPE_POLY, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_POLY];
+		if ( num_polygons > 0 ) {
+			export_buf_puts ( fp, "    </Folder>\n" );
 		}
-		for (i = 0; i < gs->num_polygons; i ++ ) {
-			if ( gs->polygons[i].is_selected == TRUE ) {
 
-				/* Multi-part polygons are represented by collecting :
-				 * A polygon is a MultiPolygon if it has at least two parts that are
-				 * _not_ holes. Otherwise it's a simple Polygon. */
-				BOOLEAN is_multi_part = FALSE;
-				int num_non_holes = 0;
-				for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
-					if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
-						num_non_holes ++;
-					}
-				}
-				if ( num_non_holes > 1 ) {
-					is_multi_part = TRUE;
-				}
-				/* start new Polygon placemark */
-				fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
-				if ( is_multi_part == FALSE ) {
-					fprintf ( fp, "        <name>Polygon %i (single part)</name>\n", i+1 );
-				} else {
-					fprintf ( fp, "        <name>Polygon %i (multi part)</name>\n", i+1 );
-				}
-				fprintf ( fp, "        <styleUrl>#polygon</styleUrl>\n" );
-				/* write kml description member */
-				export_KML_write_description ( fp, gs, GEOM_TYPE_POLY, i, geom_id, 0, parser, opts );
-				/* attribute data */
-				int att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_POLY, i, geom_id, 0, parser, opts );
-				num_errors += att_errors;
-				for ( j = 0; j < gs->polygons[i].num_parts; j++ ) {
-					/* Iterate over all polygon parts that are _not_ holes */
-					if ( gs->polygons[i].parts[j].is_hole == FALSE ) {
-						fprintf ( fp, "        <Polygon>\n" );
-						fprintf ( fp, "          <altitudeMode>absolute</altitudeMode>\n" );
-						fprintf ( fp, "          <outerBoundaryIs>\n" );
-						fprintf ( fp, "            <LinearRing>\n" );
-						fprintf ( fp, "              <coordinates>\n" );
-						for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
-							/* DEBUG */
-							/*
-							X = gs->polygons[i].parts[j].X[k] - 3513040.0;
-							Y = gs->polygons[i].parts[j].Y[k] - 5279880.0;
-							X = X / 2.0;
-							Y = Y / 2.0;
-							 */
-							X = gs->polygons[i].parts[j].X[k];
-							Y = gs->polygons[i].parts[j].Y[k];
-							xf = export_float_to_str(X);
-							yf = export_float_to_str(Y);
-							if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-								Z = gs->polygons[i].parts[j].Z[k];
-							} else {
-								Z = 0.0;
-							}
-							zf = export_float_to_str(Z);
-							fprintf	( fp, "                %s,%s,%s\n", xf, yf, zf );
-							free ( xf );
-							free ( yf );
-							free ( zf );
-						}
-						fprintf ( fp, "              </coordinates>\n" );
-						fprintf ( fp, "            </LinearRing>\n" );
-						fprintf ( fp, "          </outerBoundaryIs>\n" );
-						/* Iterate over all holes to see which ones are in this part. */
-						/* for ( k = 0; k < 0; k++ ) { */
-						for ( k = 0; k < gs->polygons[i].num_parts; k++ ) {
-							if ( gs->polygons[i].parts[k].is_hole == TRUE ) {
-								geom_part *A = &gs->polygons[i].parts[k];
-								geom_part *B = &gs->polygons[i].parts[j];
-								if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
-									BOOLEAN lies_inside_hole = FALSE;
-									/* Eliminate holes that lie within another hole. */
-									for ( l = 0; l < gs->num_polygons && lies_inside_hole == FALSE; l++ ) {
-										for ( m = 0; m < gs->polygons[l].num_parts && lies_inside_hole == FALSE; m++ ) {
-											if ( gs->polygons[l].parts[m].is_hole == TRUE ) {
-												B = &gs->polygons[l].parts[m];
-												if ( geom_tools_part_in_part_2D ( A, B ) == TRUE ) {
-													lies_inside_hole = TRUE;
-												}
-											}
-										}
-									}
-									if ( lies_inside_hole == FALSE ) {
-										/* Add hole to current part. */
-										fprintf ( fp, "          <innerBoundaryIs>\n" );
-										fprintf ( fp, "            <LinearRing>\n" );
-										fprintf ( fp, "              <coordinates>\n" );
-										for ( l = 0; l < gs->polygons[i].parts[k].num_vertices; l++ ) {
-											/* DEBUG */
-											/*
-											X = gs->polygons[i].parts[k].X[l] - 3513040.0;
-											Y = gs->polygons[i].parts[k].Y[l] - 5279880.0;
-											X = X / 2.0;
-											Y = Y / 2.0;
-											 */
-											X = gs->polygons[i].parts[k].X[l];
-											Y = gs->polygons[i].parts[k].Y[l];
-											xf = export_float_to_str(X);
-											yf = export_float_to_str(Y);
-											if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-												Z = gs->polygons[i].parts[k].Z[l];
-											} else {
-												Z = 0.0;
-											}
-											zf = export_float_to_str(Z);
-											fprintf	( fp, "                %s,%s,%s\n", xf, yf, zf );
-											free ( xf );
-											free ( yf );
-											free ( zf );
-										}
-										fprintf ( fp, "              </coordinates>\n" );
-										fprintf ( fp, "            </LinearRing>\n" );
-										fprintf ( fp, "          </innerBoundaryIs>\n" );
-									}
-								}
-							}
-						}
-					} /* DONE (adding all holes to this part */
-				} /* DONE (adding all parts) */
-				fprintf ( fp, "        </Polygon>\n" );
-				fprintf ( fp, "      </Placemark>\n" );
-				fprintf ( fp, "\n" );
-				geom_id ++;
-			}
-		}
-		if ( num_polygons > 0 ) {
-			fprintf ( fp, "    </Folder>\n" );
-		}
-
-		/* RAW VERTICES */
-		if ( num_points_raw > 0 ) {
-			fprintf ( fp, "\n    <Folder>\n" );
-			fprintf ( fp, "      <name>Vertices (%i)</name>\n", num_points_raw );
-		}
-		for (i = 0; i < gs->num_points_raw; i ++ ) {
-			if ( gs->points_raw[i].is_selected == TRUE ) {
-				/* start new Point placemark */
-				fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
-				fprintf ( fp, "        <name>%i</name>\n", i+1 );
-				fprintf ( fp, "        <visibility>0</visibility>\n"); /* hidden by default */
-				fprintf ( fp, "        <styleUrl>#vertex</styleUrl>\n" );
-				/* write kml description member */
-				export_KML_write_description ( fp, gs, GEOM_TYPE_POINT_RAW, i, geom_id, 0, parser, opts );
-				/* attribute data */
-				int att_errors = export_KML_write_data ( fp, gs, GEOM_TYPE_POINT_RAW, i, geom_id, 0, parser, opts );
-				num_errors += att_errors;
-				/* DEBUG */
-				/*
-				X = ( gs->points_raw[i].X - 3513040.0 );
-				Y = ( gs->points_raw[i].Y - 5279880.0 );
-				X = X / 2.0;
-				Y = Y / 2.0;
-				 */
-				X = gs->points_raw[i].X;
-				Y = gs->points_raw[i].Y;
-				xf = export_float_to_str(X);
-				yf = export_float_to_str(Y);
-				if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-					Z = gs->points_raw[i].Z;
-				} else {
-					Z = 0.0;
-				}
-				zf = export_float_to_str(Z);
-				/* write point geometry */
-				fprintf ( fp, "        <Point>\n" );
-				fprintf ( fp, "          <coordinates>%s,%s,%s</coordinates>\n", xf, yf, zf );
-				fprintf ( fp, "        </Point>\n" );
-				free ( xf );
-				free ( yf );
-				free ( zf );
-				fprintf ( fp, "      </Placemark>\n" );
-				fprintf ( fp, "\n" );
-				geom_id ++;
-			}
-		}
-		if ( num_points_raw > 0 ) {
-			fprintf ( fp, "    </Folder>\n" );
-		}
-
-		/* LABELS */
-		int num_labels = 0;
-		for ( i = 0; i < gs->num_points; i ++ ) {
-			if ( gs->points[i].is_selected == TRUE ) {
-				if ( gs->points[i].has_label == TRUE ) {
-					num_labels ++;
+		/* RAW VERTICES */
+		if ( num_points_raw > 0 ) {
+			export_buf_puts ( fp, "\n    <Folder>\n" );
+			export_buf_printf ( fp, "      <name>Vertices (%i)</name>\n", num_points_raw );
+		}
+		num_errors += export_text_write_features ( fp, export_KML_write_record, GEOM_TYPE_POINT_RAW, geom_id,
+				num_selected, gs, parser, opts );
+		geom_id += num_selected[GEOM_TYPE_POINT_RAW];
+		if ( num_points_raw > 0 ) {
+			export_buf_puts ( fp, "    </Folder>\n" );
+		}
+
+		/* LABELS */
+		int num_labels = 0;
+		for ( i = 0; i < gs->num_points; i ++ ) {
+			if ( gs->points[i].is_selected == TRUE ) {
+				if ( gs->points[i].has_label == TRUE ) {
+					num_labels ++;
 				}
 			}
 		}
@@ -2470,14 +2948,14 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 				}
 				i ++;
 			}
-			fprintf ( fp, "\n    <Folder>\n" );
-			fprintf ( fp, "      <name>Labels (%i)</name>\n", num_labels );
+			export_buf_puts ( fp, "\n    <Folder>\n" );
+			export_buf_printf ( fp, "      <name>Labels (%i)</name>\n", num_labels );
 			/* labels for all geometries/parts go into one and the same KML folder */
 			for ( i = 0; i < gs->num_points; i ++ ) {
 				if ( gs->points[i].is_selected == TRUE ) {
 					if ( gs->points[i].has_label == TRUE ) {
 						atts = gs->points[i].atts;
-						fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+						export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
 						store_null = FALSE;
 						/* check for all conditions under which NULL data will be written */
 						if ( atts[label_field_idx] == NULL ) {
@@ -2486,14 +2964,14 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 						if ( store_null == TRUE ) {
 							/* store "no data" representation */
 							if ( parser->empty_val_set == FALSE ) {
-								fprintf ( fp, "        <name></name>\n" ); /* write NULL value as empty string */
+								export_buf_puts ( fp, "        <name></name>\n" ); /* write NULL value as empty string */
 							} else {
-								fprintf ( fp, "        <name>%s</name>\n", NULL_str ); /* write user-defined NULL value */
+								export_buf_printf ( fp, "        <name>%s</name>\n", NULL_str ); /* write user-defined NULL value */
 							}
 						} else {
-							fprintf ( fp, "        <name>%s</name>\n", atts[label_field_idx] ); /* write actual field contents */
+							export_buf_printf ( fp, "        <name>%s</name>\n", atts[label_field_idx] ); /* write actual field contents */
 						}
-						fprintf ( fp, "        <styleUrl>#label</styleUrl>\n" );
+						export_buf_puts ( fp, "        <styleUrl>#label</styleUrl>\n" );
 						/* DEBUG */
 						/*
 						X = ( gs->points[i].label_x - 3513040.0 );
@@ -2503,22 +2981,20 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 						 */
 						X = gs->points[i].label_x;
 						Y = gs->points[i].label_y;
-						xf = export_float_to_str(X);
-						yf = export_float_to_str(Y);
+						export_float_to_str ( X, xf );
+						export_float_to_str ( Y, yf );
 						if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
 							Z = gs->points[i].Z;
 						} else {
 							Z = 0.0;
 						}
-						zf = export_float_to_str(Z);
+						export_float_to_str ( Z, zf );
 						/* write point geometry */
-						fprintf ( fp, "        <Point>\n" );
-						fprintf ( fp, "          <coordinates>%s,%s</coordinates>\n", xf, yf );
-						fprintf ( fp, "        </Point>\n" );
-						free ( xf );
-						free ( yf );
-						fprintf ( fp, "      </Placemark>\n" );
-						fprintf ( fp, "\n" );
+						export_buf_puts ( fp, "        <Point>\n" );
+						export_buf_printf ( fp, "          <coordinates>%s,%s</coordinates>\n", xf, yf );
+						export_buf_puts ( fp, "        </Point>\n" );
+						export_buf_puts ( fp, "      </Placemark>\n" );
+						export_buf_puts ( fp, "\n" );
 						geom_id ++;
 					}
 				}
@@ -2528,7 +3004,7 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 					for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
 						if ( gs->lines[i].parts[j].has_label == TRUE ) {
 							atts = gs->lines[i].atts;
-							fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+							export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
 							store_null = FALSE;
 							/* check for all conditions under which NULL data will be written */
 							if ( atts[label_field_idx] == NULL ) {
@@ -2537,14 +3013,14 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 							if ( store_null == TRUE ) {
 								/* store "no data" representation */
 								if ( parser->empty_val_set == FALSE ) {
-									fprintf ( fp, "        <name></name>\n" ); /* write NULL value as empty string */
+									export_buf_puts ( fp, "        <name></name>\n" ); /* write NULL value as empty string */
 								} else {
-									fprintf ( fp, "        <name>%s</name>\n", NULL_str ); /* write user-defined NULL value */
+									export_buf_printf ( fp, "        <name>%s</name>\n", NULL_str ); /* write user-defined NULL value */
 								}
 							} else {
-								fprintf ( fp, "        <name>%s</name>\n", atts[label_field_idx] ); /* write actual field contents */
+								export_buf_printf ( fp, "        <name>%s</name>\n", atts[label_field_idx] ); /* write actual field contents */
 							}
-							fprintf ( fp, "        <styleUrl>#label</styleUrl>\n" );
+							export_buf_puts ( fp, "        <styleUrl>#label</styleUrl>\n" );
 							/* DEBUG */
 							/*
 							X = ( gs->lines[i].parts[j].label_x - 3513040.0 );
@@ -2554,16 +3030,14 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 							 */
 							X = gs->lines[i].parts[j].label_x;
 							Y = gs->lines[i].parts[j].label_y;
-							xf = export_float_to_str(X);
-							yf = export_float_to_str(Y);
+							export_float_to_str ( X, xf );
+							export_float_to_str ( Y, yf );
 							/* write point geometry */
-							fprintf ( fp, "        <Point>\n" );
-							fprintf ( fp, "          <coordinates>%s,%s</coordinates>\n", xf, yf );
-							fprintf ( fp, "        </Point>\n" );
-							free ( xf );
-							free ( yf );
-							fprintf ( fp, "      </Placemark>\n" );
-							fprintf ( fp, "\n" );
+							export_buf_puts ( fp, "        <Point>\n" );
+							export_buf_printf ( fp, "          <coordinates>%s,%s</coordinates>\n", xf, yf );
+							export_buf_puts ( fp, "        </Point>\n" );
+							export_buf_puts ( fp, "      </Placemark>\n" );
+							export_buf_puts ( fp, "\n" );
 							geom_id ++;
 						}
 					}
@@ -2574,7 +3048,7 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 					for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
 						if ( gs->polygons[i].parts[j].has_label == TRUE ) {
 							atts = gs->polygons[i].atts;
-							fprintf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
+							export_buf_printf ( fp, "      <Placemark id=\"%i\">\n", geom_id-1 );
 							store_null = FALSE;
 							/* check for all conditions under which NULL data will be written */
 							if ( atts[label_field_idx] == NULL ) {
@@ -2583,14 +3057,14 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 							if ( store_null == TRUE ) {
 								/* store "no data" representation */
 								if ( parser->empty_val_set == FALSE ) {
-									fprintf ( fp, "        <name></name>\n" ); /* write NULL value as empty string */
+									export_buf_puts ( fp, "        <name></name>\n" ); /* write NULL value as empty string */
 								} else {
-									fprintf ( fp, "        <name>%s</name>\n", NULL_str ); /* write user-defined NULL value */
+									export_buf_printf ( fp, "        <name>%s</name>\n", NULL_str ); /* write user-defined NULL value */
 								}
 							} else {
-								fprintf ( fp, "        <name>%s</name>\n", atts[label_field_idx] ); /* write actual field contents */
+								export_buf_printf ( fp, "        <name>%s</name>\n", atts[label_field_idx] ); /* write actual field contents */
 							}
-							fprintf ( fp, "        <styleUrl>#label</styleUrl>\n" );
+							export_buf_puts ( fp, "        <styleUrl>#label</styleUrl>\n" );
 							/* DEBUG */
 							/*
 							X = ( gs->polygons[i].parts[j].label_x - 3513040.0 );
@@ -2600,22 +3074,20 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 							 */
 							X = gs->polygons[i].parts[j].label_x;
 							Y = gs->polygons[i].parts[j].label_y;
-							xf = export_float_to_str(X);
-							yf = export_float_to_str(Y);
+							export_float_to_str ( X, xf );
+							export_float_to_str ( Y, yf );
 							/* write point geometry */
-							fprintf ( fp, "        <Point>\n" );
-							fprintf ( fp, "          <coordinates>%s,%s</coordinates>\n", xf, yf );
-							fprintf ( fp, "        </Point>\n" );
-							free ( xf );
-							free ( yf );
-							fprintf ( fp, "      </Placemark>\n" );
-							fprintf ( fp, "\n" );
+							export_buf_puts ( fp, "        <Point>\n" );
+							export_buf_printf ( fp, "          <coordinates>%s,%s</coordinates>\n", xf, yf );
+							export_buf_puts ( fp, "        </Point>\n" );
+							export_buf_puts ( fp, "      </Placemark>\n" );
+							export_buf_puts ( fp, "\n" );
 							geom_id ++;
 						}
 					}
 				}
 			}
-			fprintf ( fp, "    </Folder>\n" );
+			export_buf_puts ( fp, "    </Folder>\n" );
 			if ( NULL_str != NULL ) {
 				free ( NULL_str );
 			}
@@ -2623,15 +3095,15 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 
 
 		/* write footer to output file */
-		fprintf ( fp, "  </Document>\n" );
-		fprintf ( fp, "</kml>\n" );
+		export_buf_puts ( fp, "  </Document>\n" );
+		export_buf_puts ( fp, "</kml>\n" );
 	} else {
 		return ( 0 );
 	}
 
 	/* Close output file. */
 	if ( fp != NULL ) {
-		fclose (fp);
+		export_buf_close ( fp );
 	}
 
 	return ( num_errors );
@@ -2639,295 +3111,298 @@ int export_KML ( geom_store *gs, parser_desc *parser, options *opts )
 
 
 /*
- * Writes geometry store objects into new Shapefile(s), separated
- * by geometry type. Calls "export_shape_write_atts()" to create
- * attribute DBF data.
- *
- * By the time this function is called, "gs" must be a valid geometry
- * store and must contain only fully checked and built, valid geometries,
- * ready to be written to disk.
- *
- * Returns number of attribute field errors.
- * */
-int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
+ * Helper function for export_SHP_write_layer (below).
+ * If a spatial index has been requested, then this stores the
+ * bounding box of "geom", which has just been written to the
+ * Shapefile of "job" with shape ID "id".
+ */
+void export_SHP_index_add ( export_SHP_job *job, int id, SHPObject *geom )
 {
-	double *X,*Y,*Z;
-	SHPHandle points, points_raw, lines, polygons, labels;
-	DBFHandle points_atts, points_raw_atts, lines_atts, polygons_atts, labels_atts;
-	SHPObject *geom;
-	int i, j, k, num_errors;
-	int num_vertices;
+	export_SHP_bbox *bbox;
 
+	if ( job->opts->spatial_index == FALSE || id < 0 ) {
+		return;
+	}
 
-	/* Check if there is anything to export! */
-	if ( gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons < 1 )  {
-		err_show (ERR_NOTE,"");
-		err_show (ERR_WARN, _("\nNo valid geometries found. No output produced."));
-		return ( 0 );
+	if ( job->num_bboxes >= job->max_bboxes ) {
+		int max = job->max_bboxes > 0 ? job->max_bboxes * 2 : 1024;
+		bbox = realloc ( job->bboxes, sizeof (export_SHP_bbox) * max );
+		if ( bbox == NULL ) {
+			return;
+		}
+		job->bboxes = bbox;
+		job->max_bboxes = max;
 	}
+	bbox = &job->bboxes[job->num_bboxes];
+	bbox->id = id;
+	bbox->x_min = geom->dfXMin;
+	bbox->y_min = geom->dfYMin;
+	bbox->x_max = geom->dfXMax;
+	bbox->y_max = geom->dfYMax;
+	job->num_bboxes ++;
+}
 
-	/* CREATE ALL REQUIRED OUTPUT FILES */
 
-	/* Points */
-	if ( selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ) {
-		if ( gs->points[0].is_3D == TRUE && opts->force_2d == FALSE ) {
-			points = export_SHP_SHPCreate ( gs->path_points, SHPT_POINTZ );
-		} else {
-			points = export_SHP_SHPCreate ( gs->path_points, SHPT_POINT );
-		}
-		points_atts = export_SHP_DBFCreate( gs->path_points_atts );
-		if ( points_atts == NULL ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF output file for point data\n(%s)."),
-					gs->path_points_atts );
-			return ( 0 );
-		}
-		if ( export_SHP_make_DBF ( points_atts, parser, opts ) < 0 ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF schema for point data\n(%s)."),
-					gs->path_points_atts );
-			return ( 0 );
-		}
+/*
+ * Helper function for export_SHP_write_layer (below).
+ * Builds a 2D quadtree index from the bounding boxes collected by
+ * export_SHP_index_add(). The result is the same as what shapelib's
+ * SHPCreateTree() would produce by reading back the finished
+ * Shapefile, but no data has to be read from disk.
+ *
+ * Returns the new index, to be written by SHPWriteTree().
+ */
+SHPTree *export_SHP_index_make ( export_SHP_job *job )
+{
+	SHPTree *tree;
+	SHPObject shape;
+	double bounds_min[4], bounds_max[4];
+	int max_nodes;
+	int depth;
+	int i;
+
+	/* same tree depth as chosen by shapelib: approx. 8 shapes per node */
+	depth = 0;
+	max_nodes = 1;
+	while ( max_nodes * 4 < job->num_bboxes ) {
+		depth ++;
+		max_nodes = max_nodes * 2;
 	}
-	/* Raw points */
-	if ( selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ) > 0 ) {
-		if ( gs->points_raw[0].is_3D == TRUE && opts->force_2d == FALSE ) {
-			points_raw = export_SHP_SHPCreate ( gs->path_points_raw, SHPT_POINTZ );
-		} else {
-			points_raw = export_SHP_SHPCreate ( gs->path_points_raw, SHPT_POINT );
-		}
-		points_raw_atts = export_SHP_DBFCreate( gs->path_points_raw_atts );
-		if ( points_raw_atts == NULL ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF output file for raw vertex data\n(%s)."),
-					gs->path_points_atts );
-			return ( 0 );
-		}
-		if ( export_SHP_make_DBF ( points_raw_atts, parser, opts ) < 0 ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF schema for raw vertex data\n(%s)."),
-					gs->path_points_raw_atts );
-			return ( 0 );
-		}
+	if ( depth > MAX_DEFAULT_TREE_DEPTH ) {
+		depth = MAX_DEFAULT_TREE_DEPTH;
 	}
-	/* Lines */
-	if ( selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ) {
-		if ( gs->lines[0].is_3D == TRUE && opts->force_2d == FALSE ) {
-			lines = export_SHP_SHPCreate ( gs->path_lines, SHPT_ARCZ );
-		} else {
-			lines = export_SHP_SHPCreate ( gs->path_lines, SHPT_ARC );
-		}
-		lines_atts = export_SHP_DBFCreate( gs->path_lines_atts );
-		if ( lines_atts == NULL ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF output file for line data\n(%s)."),
-					gs->path_points_atts );
-			return ( 0 );
-		}
-		if ( export_SHP_make_DBF ( lines_atts, parser, opts ) < 0 ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF schema for line data\n(%s)."),
-					gs->path_lines_atts );
-			return ( 0 );
-		}
+
+	/* tree covers full extent of Shapefile */
+	SHPGetInfo ( job->shp, NULL, NULL, bounds_min, bounds_max );
+	tree = SHPCreateTree ( NULL, 2, depth, bounds_min, bounds_max );
+	if ( tree == NULL ) {
+		return ( NULL );
 	}
-	/* Polygons */
-	if ( selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0 ) {
-		if ( gs->polygons[0].is_3D == TRUE && opts->force_2d == FALSE ) {
-			polygons = export_SHP_SHPCreate ( gs->path_polys, SHPT_POLYGONZ );
-		} else {
-			polygons = export_SHP_SHPCreate ( gs->path_polys, SHPT_POLYGON );
-		}
-		polygons_atts = export_SHP_DBFCreate( gs->path_polys_atts );
-		if ( polygons_atts == NULL ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF output file for polygon data\n(%s)."),
-					gs->path_points_atts );
-			return ( 0 );
-		}
-		if ( export_SHP_make_DBF ( polygons_atts, parser, opts ) < 0 ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_EXIT, _("\nError creating DBF schema for polygon data\n(%s)."),
-					gs->path_polys_atts );
-			return ( 0 );
-		}
+
+	memset ( &shape, 0, sizeof (SHPObject) );
+	for ( i = 0; i < job->num_bboxes; i ++ ) {
+		shape.nShapeId = job->bboxes[i].id;
+		shape.dfXMin = job->bboxes[i].x_min;
+		shape.dfYMin = job->bboxes[i].y_min;
+		shape.dfXMax = job->bboxes[i].x_max;
+		shape.dfYMax = job->bboxes[i].y_max;
+		SHPTreeAddShapeId ( tree, &shape );
 	}
-	/* Labels (points) */
-	if ( opts->label_field != NULL ) {
-		if ( 	selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ||
-				selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ||
-				selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0
-		)
-		{
-			labels = export_SHP_SHPCreate ( gs->path_labels, SHPT_POINT );
-			labels_atts = export_SHP_DBFCreate( gs->path_labels_atts );
-			if ( labels_atts == NULL ) {
-				err_show (ERR_NOTE,"");
-				err_show (ERR_EXIT, _("\nError creating DBF output file for label data\n(%s)."),
-						gs->path_labels_atts );
-				return ( 0 );
-			}
-			if ( export_SHP_make_DBF_labels ( labels_atts, parser, opts ) < 0 ) {
-				err_show (ERR_NOTE,"");
-				err_show (ERR_EXIT, _("\nError creating DBF schema for label data\n(%s)."),
-						gs->path_labels_atts );
-				return ( 0 );
-			}
-		}
+	SHPTreeTrimExtraNodes ( tree );
+
+	return ( tree );
+}
+
+
+/*
+ * Helper function for export_SHP (below).
+ * Writes spatial index "tree" into a ".qix" file next to the
+ * Shapefile "shp_path" (which must end in ".shp").
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int export_SHP_index_write ( SHPTree *tree, const char *shp_path )
+{
+	char *qix_path;
+	char *path;
+	int result;
+
+	qix_path = strdup ( shp_path );
+	strcpy ( &qix_path[strlen (qix_path) - strlen (".shp")], ".qix" );
+	path = export_SHP_path_utf8_to_native ( qix_path );
+	free ( qix_path );
+	if ( path == NULL ) {
+		return ( -1 );
 	}
+	result = SHPWriteTree ( tree, (const char*) path );
+	free ( path );
 
-	/* WRITE GEOMETRIES TO SHAPEFILE(S) */
+	return ( result == TRUE ? 0 : -1 );
+}
 
-	num_errors = 0;
 
-	/* Points */
-	int obj = -1; /* Separate, unbroken DBF/SHP index. */
+/*
+ * Helper function for export_SHP (below).
+ * Writes all geometries and attributes of one layer (as given by
+ * "job->layer") into the already created Shapefile "job->shp" and
+ * its attribute table "job->dbf".
+ *
+ * This is run as one of several parallel jobs (one per layer),
+ * so all messages are stored in "job->messages" and the number
+ * of attribute field errors in "job->num_errors". If requested,
+ * the spatial index is built here, too, and stored in "job->index".
+ */
+void *export_SHP_write_layer ( void *arg )
+{
+	export_SHP_job *job = (export_SHP_job*) arg;
+	geom_store *gs = job->gs;
+	parser_desc *parser = job->parser;
+	options *opts = job->opts;
+	double *X,*Y,*Z;
+	SHPObject *geom;
+	int i, j, k;
+	int num_vertices;
+	int id;
+	int obj = job->dbf->num_records - 1; /* Separate, unbroken DBF/SHP index. */
+	err_queue *previous;
 
-	for (i = 0; i < gs->num_points; i ++ ) {
-		if ( gs->points[i].is_selected == TRUE ) {
-			obj ++;
-			X = malloc ( sizeof ( double ) );
-			Y = malloc ( sizeof ( double ) );
-			Z = malloc ( sizeof ( double ) );
-			X[0] = gs->points[i].X;
-			Y[0] = gs->points[i].Y;
-			Z[0] = gs->points[i].Z;
-			if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-				geom = SHPCreateSimpleObject ( SHPT_POINTZ, 1, X, Y, Z );
-			} else {
-				geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, NULL );
+
+	previous = err_queue_attach ( &job->messages );
+
+	/* Points */
+	if ( job->layer == EXPORT_SHP_LAYER_POINTS ) {
+		for (i = 0; i < gs->num_points; i ++ ) {
+			if ( gs->points[i].is_selected == TRUE ) {
+				obj ++;
+				X = malloc ( sizeof ( double ) );
+				Y = malloc ( sizeof ( double ) );
+				Z = malloc ( sizeof ( double ) );
+				X[0] = gs->points[i].X;
+				Y[0] = gs->points[i].Y;
+				Z[0] = gs->points[i].Z;
+				if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+					geom = SHPCreateSimpleObject ( SHPT_POINTZ, 1, X, Y, Z );
+				} else {
+					geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, NULL );
+				}
+				id = SHPWriteObject( job->shp, -1, geom );
+				export_SHP_index_add ( job, id, geom );
+				SHPDestroyObject( geom );
+				free ( X );
+				free ( Y );
+				free ( Z );
+				job->num_errors += export_SHP_write_atts (job->dbf, gs, GEOM_TYPE_POINT, i, obj, parser, opts);
 			}
-			SHPWriteObject( points, -1, geom );
-			SHPDestroyObject( geom );
-			free ( X );
-			free ( Y );
-			free ( Z );
-			num_errors += export_SHP_write_atts (points_atts, gs, GEOM_TYPE_POINT, i, obj, parser, opts);
 		}
 	}
 	/* Raw points */
-	obj = -1;
-	for (i = 0; i < gs->num_points_raw; i ++ ) {
-		if ( gs->points_raw[i].is_selected == TRUE ) {
-			obj ++;
-			X = malloc ( sizeof ( double ) );
-			Y = malloc ( sizeof ( double ) );
-			Z = malloc ( sizeof ( double ) );
-			X[0] = gs->points_raw[i].X;
-			Y[0] = gs->points_raw[i].Y;
-			Z[0] = gs->points_raw[i].Z;
-			if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-				geom = SHPCreateSimpleObject ( SHPT_POINTZ, 1, X, Y, Z );
-			} else {
-				geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, Z );
+	if ( job->layer == EXPORT_SHP_LAYER_POINTS_RAW ) {
+		for (i = 0; i < gs->num_points_raw; i ++ ) {
+			if ( gs->points_raw[i].is_selected == TRUE ) {
+				obj ++;
+				X = malloc ( sizeof ( double ) );
+				Y = malloc ( sizeof ( double ) );
+				Z = malloc ( sizeof ( double ) );
+				X[0] = gs->points_raw[i].X;
+				Y[0] = gs->points_raw[i].Y;
+				Z[0] = gs->points_raw[i].Z;
+				if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+					geom = SHPCreateSimpleObject ( SHPT_POINTZ, 1, X, Y, Z );
+				} else {
+					geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, Z );
+				}
+				id = SHPWriteObject( job->shp, -1, geom );
+				export_SHP_index_add ( job, id, geom );
+				SHPDestroyObject( geom );
+				free ( X );
+				free ( Y );
+				free ( Z );
+				job->num_errors += export_SHP_write_atts (job->dbf, gs, GEOM_TYPE_POINT_RAW, i, obj, parser, opts);
 			}
-			SHPWriteObject( points_raw, -1, geom );
-			SHPDestroyObject( geom );
-			free ( X );
-			free ( Y );
-			free ( Z );
-			num_errors += export_SHP_write_atts (points_raw_atts, gs, GEOM_TYPE_POINT_RAW, i, obj, parser, opts);
 		}
 	}
 	/* Lines */
-	obj = -1;
-	for (i = 0; i < gs->num_lines; i ++ ) {
-		if ( gs->lines[i].is_selected == TRUE ) {
-			int *start;
-			int vertex;
-
-			obj ++;
-			start = malloc ( sizeof (int) * gs->lines[i].num_parts );
-			num_vertices = 0;
-			/* get total number of vertices and starting index for each
-		       part of a multi-part line string. */
-			for ( j=0; j < gs->lines[i].num_parts; j++ ) {
-				start[j] = num_vertices;
-				num_vertices += gs->lines[i].parts[j].num_vertices;
-			}
-			X = malloc ( sizeof ( double ) * num_vertices );
-			Y = malloc ( sizeof ( double ) * num_vertices );
-			Z = malloc ( sizeof ( double ) * num_vertices );
-			vertex = 0;
-			for ( j=0; j < gs->lines[i].num_parts; j++ ) {
-				for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
-					X[vertex] = gs->lines[i].parts[j].X[k];
-					Y[vertex] = gs->lines[i].parts[j].Y[k];
-					if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-						Z[vertex] = gs->lines[i].parts[j].Z[k];
-					} else {
-						Z[vertex] = 0.0;
-					}
-					vertex ++;
+	if ( job->layer == EXPORT_SHP_LAYER_LINES ) {
+		for (i = 0; i < gs->num_lines; i ++ ) {
+			if ( gs->lines[i].is_selected == TRUE ) {
+				int *start;
+				int vertex;
+
+				obj ++;
+				start = malloc ( sizeof (int) * gs->lines[i].num_parts );
+				num_vertices = 0;
+				/* get total number of vertices and starting index for each
+			       part of a multi-part line string. */
+				for ( j=0; j < gs->lines[i].num_parts; j++ ) {
+					start[j] = num_vertices;
+					num_vertices += gs->lines[i].parts[j].num_vertices;
 				}
+				X = malloc ( sizeof ( double ) * num_vertices );
+				Y = malloc ( sizeof ( double ) * num_vertices );
+				Z = malloc ( sizeof ( double ) * num_vertices );
+				vertex = 0;
+				for ( j=0; j < gs->lines[i].num_parts; j++ ) {
+					for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
+						X[vertex] = gs->lines[i].parts[j].X[k];
+						Y[vertex] = gs->lines[i].parts[j].Y[k];
+						if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+							Z[vertex] = gs->lines[i].parts[j].Z[k];
+						} else {
+							Z[vertex] = 0.0;
+						}
+						vertex ++;
+					}
+				}
+				if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+					geom = SHPCreateObject ( SHPT_ARCZ, obj, gs->lines[i].num_parts, start, NULL, num_vertices, X, Y, Z, NULL );
+				} else {
+					geom = SHPCreateObject ( SHPT_ARC, obj, gs->lines[i].num_parts, start, NULL, num_vertices, X, Y, NULL, NULL );
+				}
+				id = SHPWriteObject( job->shp, -1, geom );
+				export_SHP_index_add ( job, id, geom );
+				SHPDestroyObject( geom );
+				free ( X );
+				free ( Y );
+				free ( Z );
+				free ( start );
+				job->num_errors += export_SHP_write_atts (job->dbf, gs, GEOM_TYPE_LINE, i, obj, parser, opts);
 			}
-			if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-				geom = SHPCreateObject ( SHPT_ARCZ, obj, gs->lines[i].num_parts, start, NULL, num_vertices, X, Y, Z, NULL );
-			} else {
-				geom = SHPCreateObject ( SHPT_ARC, obj, gs->lines[i].num_parts, start, NULL, num_vertices, X, Y, NULL, NULL );
-			}
-			SHPWriteObject( lines, -1, geom );
-			SHPDestroyObject( geom );
-			free ( X );
-			free ( Y );
-			free ( Z );
-			free ( start );
-			num_errors += export_SHP_write_atts (lines_atts, gs, GEOM_TYPE_LINE, i, obj, parser, opts);
 		}
 	}
 	/* Polygons */
-	obj = -1;
-	for (i = 0; i < gs->num_polygons; i ++ ) {
-		if ( gs->polygons[i].is_selected == TRUE ) {
-			int *start;
-			int vertex;
-
-			obj ++;
-			start = malloc ( sizeof (int) * gs->polygons[i].num_parts );
-			num_vertices = 0;
-			/* get total number of vertices and starting index for each
-		       part of a multi-part polygon. */
-			for ( j=0; j < gs->polygons[i].num_parts; j++ ) {
-				start[j] = num_vertices;
-				num_vertices += gs->polygons[i].parts[j].num_vertices;
-			}
-			X = malloc ( sizeof ( double ) * num_vertices );
-			Y = malloc ( sizeof ( double ) * num_vertices );
-			Z = malloc ( sizeof ( double ) * num_vertices );
-			vertex = 0;
-			for ( j=0; j < gs->polygons[i].num_parts; j++ ) {
-				for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
-					X[vertex] = gs->polygons[i].parts[j].X[k];
-					Y[vertex] = gs->polygons[i].parts[j].Y[k];
-					if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-						Z[vertex] = gs->polygons[i].parts[j].Z[k];
-					} else {
-						Z[vertex] = 0.0;
+	if ( job->layer == EXPORT_SHP_LAYER_POLYGONS ) {
+		for (i = 0; i < gs->num_polygons; i ++ ) {
+			if ( gs->polygons[i].is_selected == TRUE ) {
+				int *start;
+				int vertex;
+
+				obj ++;
+				start = malloc ( sizeof (int) * gs->polygons[i].num_parts );
+				num_vertices = 0;
+				/* get total number of vertices and starting index for each
+			       part of a multi-part polygon. */
+				for ( j=0; j < gs->polygons[i].num_parts; j++ ) {
+					start[j] = num_vertices;
+					num_vertices += gs->polygons[i].parts[j].num_vertices;
+				}
+				X = malloc ( sizeof ( double ) * num_vertices );
+				Y = malloc ( sizeof ( double ) * num_vertices );
+				Z = malloc ( sizeof ( double ) * num_vertices );
+				vertex = 0;
+				for ( j=0; j < gs->polygons[i].num_parts; j++ ) {
+					for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
+						X[vertex] = gs->polygons[i].parts[j].X[k];
+						Y[vertex] = gs->polygons[i].parts[j].Y[k];
+						if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+							Z[vertex] = gs->polygons[i].parts[j].Z[k];
+						} else {
+							Z[vertex] = 0.0;
+						}
+						vertex ++;
 					}
-					vertex ++;
 				}
+				if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+					/* shapelib will automatically figure out, whether a part is an outer or inner (hole) ring */
+					geom = SHPCreateObject ( SHPT_POLYGONZ, obj, gs->polygons[i].num_parts, start, NULL, num_vertices, X, Y, Z, NULL );
+				} else {
+					/* shapelib will automatically figure out, whether a part is an outer or inner (hole) ring */
+					geom = SHPCreateObject ( SHPT_POLYGON, obj, gs->polygons[i].num_parts, start, NULL, num_vertices, X, Y, NULL, NULL );
+				}
+				SHPRewindObject( job->shp, geom ); /* correct order of vertices in polygon */
+				id = SHPWriteObject( job->shp, -1, geom );
+				export_SHP_index_add ( job, id, geom );
+				SHPDestroyObject( geom );
+				free ( X );
+				free ( Y );
+				free ( Z );
+				free ( start );
+				job->num_errors += export_SHP_write_atts (job->dbf, gs, GEOM_TYPE_POLY, i, obj, parser, opts);
 			}
-			if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
-				/* shapelib will automatically figure out, whether a part is an outer or inner (hole) ring */
-				geom = SHPCreateObject ( SHPT_POLYGONZ, obj, gs->polygons[i].num_parts, start, NULL, num_vertices, X, Y, Z, NULL );
-			} else {
-				/* shapelib will automatically figure out, whether a part is an outer or inner (hole) ring */
-				geom = SHPCreateObject ( SHPT_POLYGON, obj, gs->polygons[i].num_parts, start, NULL, num_vertices, X, Y, NULL, NULL );
-			}
-			SHPRewindObject( polygons, geom ); /* correct order of vertices in polygon */
-			SHPWriteObject( polygons, -1, geom );
-			SHPDestroyObject( geom );
-			free ( X );
-			free ( Y );
-			free ( Z );
-			free ( start );
-			num_errors += export_SHP_write_atts (polygons_atts, gs, GEOM_TYPE_POLY, i, obj, parser, opts);
 		}
 	}
 	/* Labels (points) */
-	if ( opts->label_field != NULL ) {
-		obj = -1;
-		/* Labels for points. */
+	if ( job->layer == EXPORT_SHP_LAYER_LABELS ) {
+			/* Labels for points. */
 		if ( opts->label_mode_point != OPTIONS_LABEL_MODE_NONE ) {
 			for (i = 0; i < gs->num_points; i ++ ) {
 				if ( gs->points[i].is_selected == TRUE ) {
@@ -2940,12 +3415,13 @@ int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
 						Y[0] = gs->points[i].label_y;
 						Z[0] = 0.0;
 						geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, NULL );
-						SHPWriteObject( labels, -1, geom );
+						id = SHPWriteObject( job->shp, -1, geom );
+						export_SHP_index_add ( job, id, geom );
 						SHPDestroyObject( geom );
 						free ( X );
 						free ( Y );
 						free ( Z );
-						num_errors += export_SHP_write_atts_labels (labels_atts, gs, GEOM_TYPE_POINT, i, obj, parser, opts);
+						job->num_errors += export_SHP_write_atts_labels (job->dbf, gs, GEOM_TYPE_POINT, i, obj, parser, opts);
 					} else {
 						/* Warn: no label for this point. */
 						err_show (ERR_NOTE,"");
@@ -2969,12 +3445,13 @@ int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
 							Y[0] = gs->lines[i].parts[p].label_y;
 							Z[0] = 0.0;
 							geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, NULL );
-							SHPWriteObject( labels, -1, geom );
+							id = SHPWriteObject( job->shp, -1, geom );
+							export_SHP_index_add ( job, id, geom );
 							SHPDestroyObject( geom );
 							free ( X );
 							free ( Y );
 							free ( Z );
-							num_errors += export_SHP_write_atts_labels (labels_atts, gs, GEOM_TYPE_LINE, i, obj, parser, opts);
+							job->num_errors += export_SHP_write_atts_labels (job->dbf, gs, GEOM_TYPE_LINE, i, obj, parser, opts);
 						} else {
 							/* Warn: no label for this line (part). */
 							if ( opts->label_mode_line == OPTIONS_LABEL_MODE_CENTER ) {
@@ -3009,12 +3486,13 @@ int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
 							Y[0] = gs->polygons[i].parts[p].label_y;
 							Z[0] = 0.0;
 							geom = SHPCreateSimpleObject ( SHPT_POINT, 1, X, Y, NULL );
-							SHPWriteObject( labels, -1, geom );
+							id = SHPWriteObject( job->shp, -1, geom );
+							export_SHP_index_add ( job, id, geom );
 							SHPDestroyObject( geom );
 							free ( X );
 							free ( Y );
 							free ( Z );
-							num_errors += export_SHP_write_atts_labels (labels_atts, gs, GEOM_TYPE_POLY, i, obj, parser, opts);
+							job->num_errors += export_SHP_write_atts_labels (job->dbf, gs, GEOM_TYPE_POLY, i, obj, parser, opts);
 						} else {
 							if ( gs->polygons[i].parts[p].is_hole == FALSE ) {
 								/* Warn: no label for this polygon (part), even though it is not a hole. */
@@ -3038,60 +3516,2613 @@ int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
 		}
 	}
 
-
-	/* Warn if no labels were written */
-	if ( 	opts->label_mode_point == OPTIONS_LABEL_MODE_NONE &&
-			opts->label_mode_line == OPTIONS_LABEL_MODE_NONE &&
-			opts->label_mode_poly == OPTIONS_LABEL_MODE_NONE
-	)
-	{
+	/* build spatial index from bounding boxes */
+	if ( opts->spatial_index == TRUE ) {
+		job->index = export_SHP_index_make ( job );
+	}
+
+	err_queue_attach ( previous );
+
+	return ( NULL );
+}
+
+
+/*
+ * Writes geometry store objects into new Shapefile(s), separated
+ * by geometry type. Calls "export_shape_write_atts()" to create
+ * attribute DBF data.
+ *
+ * By the time this function is called, "gs" must be a valid geometry
+ * store and must contain only fully checked and built, valid geometries,
+ * ready to be written to disk.
+ *
+ * Returns number of attribute field errors.
+ * */
+int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
+{
+	SHPHandle points, points_raw, lines, polygons, labels;
+	DBFHandle points_atts, points_raw_atts, lines_atts, polygons_atts, labels_atts;
+	export_SHP_job jobs[EXPORT_SHP_NUM_LAYERS];
+	int i, num_jobs, num_threads, num_errors;
+
+
+	/* Check if there is anything to export! */
+	if ( gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons < 1 )  {
+		err_show (ERR_NOTE,"");
+		err_show (ERR_WARN, _("\nNo valid geometries found. No output produced."));
+		return ( 0 );
+	}
+
+	/* CREATE ALL REQUIRED OUTPUT FILES */
+
+	/* Points */
+	if ( selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ) {
+		if ( gs->points[0].is_3D == TRUE && opts->force_2d == FALSE ) {
+			points = export_SHP_SHPOpenOutput ( gs->path_points, SHPT_POINTZ, opts );
+		} else {
+			points = export_SHP_SHPOpenOutput ( gs->path_points, SHPT_POINT, opts );
+		}
+		points_atts = export_SHP_DBFOpenOutput ( gs->path_points_atts, opts );
+		if ( points_atts == NULL ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF output file for point data\n(%s)."),
+					gs->path_points_atts );
+			return ( 0 );
+		}
+		if ( DBFGetFieldCount ( points_atts ) == 0 && export_SHP_make_DBF ( points_atts, parser, opts ) < 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF schema for point data\n(%s)."),
+					gs->path_points_atts );
+			return ( 0 );
+		}
+	}
+	/* Raw points */
+	if ( selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ) > 0 ) {
+		if ( gs->points_raw[0].is_3D == TRUE && opts->force_2d == FALSE ) {
+			points_raw = export_SHP_SHPOpenOutput ( gs->path_points_raw, SHPT_POINTZ, opts );
+		} else {
+			points_raw = export_SHP_SHPOpenOutput ( gs->path_points_raw, SHPT_POINT, opts );
+		}
+		points_raw_atts = export_SHP_DBFOpenOutput ( gs->path_points_raw_atts, opts );
+		if ( points_raw_atts == NULL ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF output file for raw vertex data\n(%s)."),
+					gs->path_points_atts );
+			return ( 0 );
+		}
+		if ( DBFGetFieldCount ( points_raw_atts ) == 0 && export_SHP_make_DBF ( points_raw_atts, parser, opts ) < 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF schema for raw vertex data\n(%s)."),
+					gs->path_points_raw_atts );
+			return ( 0 );
+		}
+	}
+	/* Lines */
+	if ( selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ) {
+		if ( gs->lines[0].is_3D == TRUE && opts->force_2d == FALSE ) {
+			lines = export_SHP_SHPOpenOutput ( gs->path_lines, SHPT_ARCZ, opts );
+		} else {
+			lines = export_SHP_SHPOpenOutput ( gs->path_lines, SHPT_ARC, opts );
+		}
+		lines_atts = export_SHP_DBFOpenOutput ( gs->path_lines_atts, opts );
+		if ( lines_atts == NULL ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF output file for line data\n(%s)."),
+					gs->path_points_atts );
+			return ( 0 );
+		}
+		if ( DBFGetFieldCount ( lines_atts ) == 0 && export_SHP_make_DBF ( lines_atts, parser, opts ) < 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF schema for line data\n(%s)."),
+					gs->path_lines_atts );
+			return ( 0 );
+		}
+	}
+	/* Polygons */
+	if ( selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0 ) {
+		if ( gs->polygons[0].is_3D == TRUE && opts->force_2d == FALSE ) {
+			polygons = export_SHP_SHPOpenOutput ( gs->path_polys, SHPT_POLYGONZ, opts );
+		} else {
+			polygons = export_SHP_SHPOpenOutput ( gs->path_polys, SHPT_POLYGON, opts );
+		}
+		polygons_atts = export_SHP_DBFOpenOutput ( gs->path_polys_atts, opts );
+		if ( polygons_atts == NULL ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF output file for polygon data\n(%s)."),
+					gs->path_points_atts );
+			return ( 0 );
+		}
+		if ( DBFGetFieldCount ( polygons_atts ) == 0 && export_SHP_make_DBF ( polygons_atts, parser, opts ) < 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_EXIT, _("\nError creating DBF schema for polygon data\n(%s)."),
+					gs->path_polys_atts );
+			return ( 0 );
+		}
+	}
+	/* Labels (points) */
+	if ( opts->label_field != NULL ) {
+		if ( 	selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ||
+				selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ||
+				selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0
+		)
+		{
+			labels = export_SHP_SHPOpenOutput ( gs->path_labels, SHPT_POINT, opts );
+			labels_atts = export_SHP_DBFOpenOutput ( gs->path_labels_atts, opts );
+			if ( labels_atts == NULL ) {
+				err_show (ERR_NOTE,"");
+				err_show (ERR_EXIT, _("\nError creating DBF output file for label data\n(%s)."),
+						gs->path_labels_atts );
+				return ( 0 );
+			}
+			if ( DBFGetFieldCount ( labels_atts ) == 0 && export_SHP_make_DBF_labels ( labels_atts, parser, opts ) < 0 ) {
+				err_show (ERR_NOTE,"");
+				err_show (ERR_EXIT, _("\nError creating DBF schema for label data\n(%s)."),
+						gs->path_labels_atts );
+				return ( 0 );
+			}
+		}
+	}
+
+	/* WRITE GEOMETRIES TO SHAPEFILE(S) */
+
+	/* one writer job per layer */
+	num_jobs = 0;
+	if ( selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ) {
+		jobs[num_jobs].layer = EXPORT_SHP_LAYER_POINTS;
+		jobs[num_jobs].shp = points;
+		jobs[num_jobs].shp_path = gs->path_points;
+		jobs[num_jobs].dbf = export_dbf_create ( points_atts );
+		jobs[num_jobs].dbf_path = gs->path_points_atts;
+		num_jobs ++;
+	}
+	if ( selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ) > 0 ) {
+		jobs[num_jobs].layer = EXPORT_SHP_LAYER_POINTS_RAW;
+		jobs[num_jobs].shp = points_raw;
+		jobs[num_jobs].shp_path = gs->path_points_raw;
+		jobs[num_jobs].dbf = export_dbf_create ( points_raw_atts );
+		jobs[num_jobs].dbf_path = gs->path_points_raw_atts;
+		num_jobs ++;
+	}
+	if ( selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ) {
+		jobs[num_jobs].layer = EXPORT_SHP_LAYER_LINES;
+		jobs[num_jobs].shp = lines;
+		jobs[num_jobs].shp_path = gs->path_lines;
+		jobs[num_jobs].dbf = export_dbf_create ( lines_atts );
+		jobs[num_jobs].dbf_path = gs->path_lines_atts;
+		num_jobs ++;
+	}
+	if ( selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0 ) {
+		jobs[num_jobs].layer = EXPORT_SHP_LAYER_POLYGONS;
+		jobs[num_jobs].shp = polygons;
+		jobs[num_jobs].shp_path = gs->path_polys;
+		jobs[num_jobs].dbf = export_dbf_create ( polygons_atts );
+		jobs[num_jobs].dbf_path = gs->path_polys_atts;
+		num_jobs ++;
+	}
+	if ( opts->label_field != NULL ) {
+		if ( 	selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ||
+				selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ||
+				selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0
+		)
+		{
+			jobs[num_jobs].layer = EXPORT_SHP_LAYER_LABELS;
+			jobs[num_jobs].shp = labels;
+			jobs[num_jobs].shp_path = gs->path_labels;
+			jobs[num_jobs].dbf = export_dbf_create ( labels_atts );
+			jobs[num_jobs].dbf_path = gs->path_labels_atts;
+			num_jobs ++;
+		}
+	}
+	for ( i = 0; i < num_jobs; i ++ ) {
+		jobs[i].gs = gs;
+		jobs[i].parser = parser;
+		jobs[i].opts = opts;
+		jobs[i].num_errors = 0;
+		err_queue_init ( &jobs[i].messages );
+		jobs[i].bboxes = NULL;
+		jobs[i].num_bboxes = 0;
+		jobs[i].max_bboxes = 0;
+		jobs[i].index = NULL;
+	}
+
+	num_threads = opts->threads;
+#ifdef MINGW
+	/* DBF export of doubles temporarily changes the global
+	   numeric locale on Windows (see export_SHP_write_atts()). */
+	num_threads = 1;
+#endif
+	t_thread_run_pool ( export_SHP_write_layer, jobs, num_jobs, sizeof (export_SHP_job), num_threads );
+
+	/* show messages and sum up errors in fixed layer order */
+	num_errors = 0;
+	for ( i = 0; i < num_jobs; i ++ ) {
+		err_queue_flush ( &jobs[i].messages );
+		num_errors += jobs[i].num_errors;
+	}
+
+
+	/* Warn if no labels were written */
+	if ( 	opts->label_mode_point == OPTIONS_LABEL_MODE_NONE &&
+			opts->label_mode_line == OPTIONS_LABEL_MODE_NONE &&
+			opts->label_mode_poly == OPTIONS_LABEL_MODE_NONE
+	)
+	{
+		err_show (ERR_NOTE,"");
+		err_show (ERR_WARN, _("\nLabel mode for all geometries set to '%s'.\nLabel layer will be empty."),
+				OPTIONS_LABEL_MODE_NAMES[OPTIONS_LABEL_MODE_NONE]);
+	}
+
+	/* CREATE .GVA FILE FOR LABEL POINTS (OPTIONAL) */
+	if ( opts->label_field != NULL && gs->path_labels_gva != NULL ) {
+		int error = export_SHP_make_labels_GVA (gs->path_labels_gva);
+		if ( error < 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_WARN, _("\nFailed to create annotation settings file ('%s')."), gs->path_labels_gva);
+		}
+	}
+
+	/* WRITE SPATIAL INDEXES (OPTIONAL) AND CLOSE ALL OUTPUT FILES */
+	for ( i = 0; i < num_jobs; i ++ ) {
+		if ( opts->spatial_index == TRUE ) {
+			if ( jobs[i].index == NULL || export_SHP_index_write ( jobs[i].index, jobs[i].shp_path ) != 0 ) {
+				err_show (ERR_NOTE,"");
+				err_show (ERR_WARN, _("\nFailed to write spatial index for Shapefile\n(%s)."),
+						jobs[i].shp_path );
+			}
+			if ( jobs[i].index != NULL ) {
+				SHPDestroyTree ( jobs[i].index );
+			}
+			t_free ( jobs[i].bboxes );
+		}
+		SHPClose ( jobs[i].shp );
+		if ( export_dbf_close ( jobs[i].dbf ) != 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_WARN, _("\nFailed to write attribute data to DBF file\n(%s)."),
+					jobs[i].dbf_path );
+		}
+	}
+
+	return ( num_errors );
+}
+
+
+/*
+ * FLATGEOBUF EXPORT
+ *
+ * A FlatGeobuf file consists of eight magic bytes, a size-prefixed
+ * header, a packed Hilbert R-tree of the bounding boxes of all
+ * features and, finally, the features themselves, each one
+ * size-prefixed. Header and features are FlatBuffers tables,
+ * which are encoded by the small export_fb_* builder below.
+ * All numbers are stored in little endian byte order.
+ */
+
+/* magic bytes at start of file: "fgb", format version 3, "fgb", 0 */
+static const unsigned char EXPORT_FGB_MAGIC[8] =
+{ 0x66, 0x67, 0x62, 0x03, 0x66, 0x67, 0x62, 0x00 };
+
+
+/*
+ * Stores the lowest "len" bytes of "value" at "dst",
+ * in little endian byte order.
+ */
+void export_fb_encode ( unsigned char *dst, unsigned long long value, size_t len )
+{
+	size_t i;
+
+	for ( i = 0; i < len; i ++ ) {
+		dst[i] = (unsigned char) ( value & 0xFF );
+		value >>= 8;
+	}
+}
+
+
+/*
+ * Same as export_fb_encode(), but for an IEEE 754 double.
+ */
+void export_fb_encode_double ( unsigned char *dst, double value )
+{
+	unsigned long long bits;
+
+	memcpy ( &bits, &value, sizeof (double) );
+	export_fb_encode ( dst, bits, 8 );
+}
+
+
+/*
+ * Discards the contents of a FlatBuffers builder,
+ * so that it can be used to build a new buffer.
+ */
+void export_fb_clear ( export_fb *fb )
+{
+	fb->len = 0;
+	fb->min_align = 1;
+	fb->num_fields = 0;
+	fb->table_start = 0;
+}
+
+
+/*
+ * Creates a new, empty FlatBuffers builder.
+ */
+export_fb *export_fb_create ( void )
+{
+	export_fb *fb = malloc ( sizeof (export_fb) );
+
+	fb->size = EXPORT_BUF_SIZE;
+	fb->data = malloc ( sizeof (unsigned char) * fb->size );
+	export_fb_clear ( fb );
+
+	return ( fb );
+}
+
+
+/*
+ * Releases all memory of a FlatBuffers builder.
+ */
+void export_fb_destroy ( export_fb *fb )
+{
+	if ( fb == NULL ) {
+		return;
+	}
+	free ( fb->data );
+	free ( fb );
+}
+
+
+/*
+ * Prepends "len" bytes to the buffer contents.
+ * The buffer memory is grown as needed. Since the buffer is built
+ * back to front, existing contents are moved to the end of the
+ * new memory block.
+ */
+void export_fb_put ( export_fb *fb, const unsigned char *bytes, size_t len )
+{
+	if ( fb->len + len > fb->size ) {
+		size_t size = fb->size;
+		unsigned char *data;
+		while ( fb->len + len > size ) {
+			size *= 2;
+		}
+		data = malloc ( sizeof (unsigned char) * size );
+		memcpy ( data + size - fb->len, fb->data + fb->size - fb->len, fb->len );
+		free ( fb->data );
+		fb->data = data;
+		fb->size = size;
+	}
+	fb->len += len;
+	memcpy ( fb->data + fb->size - fb->len, bytes, len );
+}
+
+
+/*
+ * Prepends an unsigned integer of "len" bytes.
+ */
+void export_fb_put_uint ( export_fb *fb, unsigned long long value, size_t len )
+{
+	unsigned char bytes[8];
+
+	export_fb_encode ( bytes, value, len );
+	export_fb_put ( fb, bytes, len );
+}
+
+
+/*
+ * Prepends a double precision number.
+ */
+void export_fb_put_double ( export_fb *fb, double value )
+{
+	unsigned char bytes[8];
+
+	export_fb_encode_double ( bytes, value );
+	export_fb_put ( fb, bytes, 8 );
+}
+
+
+/*
+ * Prepends zero bytes, so that an object of "extra" bytes, which is
+ * to be prepended next, will be aligned to "align" bytes ("align"
+ * must be 1, 2, 4 or 8). Alignment is relative to the end of the
+ * buffer; export_fb_finish() makes sure that it also holds
+ * relative to the start.
+ */
+void export_fb_align ( export_fb *fb, size_t align, size_t extra )
+{
+	static const unsigned char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	size_t pad = ( align - ( ( fb->len + extra ) % align ) ) % align;
+
+	if ( align > fb->min_align ) {
+		fb->min_align = align;
+	}
+	if ( pad > 0 ) {
+		export_fb_put ( fb, zeros, pad );
+	}
+}
+
+
+/*
+ * Prepends an offset (which always points towards the end of the
+ * buffer) to the object "ref" that was added before.
+ */
+void export_fb_put_ref ( export_fb *fb, size_t ref )
+{
+	export_fb_align ( fb, 4, 0 );
+	export_fb_put_uint ( fb, (unsigned long long) ( fb->len + 4 - ref ), 4 );
+}
+
+
+/*
+ * Adds a NUL-terminated string and returns a reference to it.
+ */
+size_t export_fb_string ( export_fb *fb, const char *str )
+{
+	size_t len = strlen ( str );
+
+	export_fb_align ( fb, 4, len + 1 );
+	export_fb_put_uint ( fb, 0, 1 );
+	export_fb_put ( fb, (const unsigned char*) str, len );
+	export_fb_put_uint ( fb, len, 4 );
+
+	return ( fb->len );
+}
+
+
+/*
+ * Prepares the builder for a vector of "num" elements of "elem_size"
+ * bytes each. The elements must then be added in reverse order,
+ * followed by a call to export_fb_vector_end().
+ */
+void export_fb_vector_start ( export_fb *fb, size_t num, size_t elem_size )
+{
+	export_fb_align ( fb, 4, num * elem_size );
+	export_fb_align ( fb, elem_size, num * elem_size );
+}
+
+
+/*
+ * Completes a vector of "num" elements and returns a reference to it.
+ */
+size_t export_fb_vector_end ( export_fb *fb, size_t num )
+{
+	export_fb_put_uint ( fb, num, 4 );
+
+	return ( fb->len );
+}
+
+
+/*
+ * Adds a vector of "num" bytes and returns a reference to it.
+ */
+size_t export_fb_vector_bytes ( export_fb *fb, const unsigned char *bytes, size_t num )
+{
+	export_fb_vector_start ( fb, num, 1 );
+	export_fb_put ( fb, bytes, num );
+
+	return ( export_fb_vector_end ( fb, num ) );
+}
+
+
+/*
+ * Adds a vector of "num" doubles and returns a reference to it.
+ */
+size_t export_fb_vector_double ( export_fb *fb, const double *values, size_t num )
+{
+	size_t i;
+
+	export_fb_vector_start ( fb, num, 8 );
+	for ( i = num; i > 0; i -- ) {
+		export_fb_put_double ( fb, values[i-1] );
+	}
+
+	return ( export_fb_vector_end ( fb, num ) );
+}
+
+
+/*
+ * Adds a vector of references to "num" objects (e.g. tables)
+ * and returns a reference to it.
+ */
+size_t export_fb_vector_refs ( export_fb *fb, const size_t *refs, size_t num )
+{
+	size_t i;
+
+	export_fb_vector_start ( fb, num, 4 );
+	for ( i = num; i > 0; i -- ) {
+		export_fb_put_ref ( fb, refs[i-1] );
+	}
+
+	return ( export_fb_vector_end ( fb, num ) );
+}
+
+
+/*
+ * Starts a new table. All fields of the table must then be
+ * added (export_fb_field_*), followed by export_fb_table_end().
+ * Tables cannot be nested: all objects that a table refers to
+ * must be added before the table is started.
+ */
+void export_fb_table_start ( export_fb *fb )
+{
+	int i;
+
+	for ( i = 0; i < EXPORT_FB_MAX_FIELDS; i ++ ) {
+		fb->fields[i] = 0;
+	}
+	fb->num_fields = 0;
+	fb->table_start = fb->len;
+}
+
+
+/*
+ * Records the position of the field with index "field"
+ * (as given in the FlatBuffers schema) of the current table.
+ */
+void export_fb_field_set ( export_fb *fb, int field )
+{
+	fb->fields[field] = fb->len;
+	if ( field >= fb->num_fields ) {
+		fb->num_fields = field + 1;
+	}
+}
+
+
+/*
+ * Adds an unsigned integer (or boolean) field of "len" bytes
+ * to the current table.
+ */
+void export_fb_field_uint ( export_fb *fb, int field, unsigned long long value, size_t len )
+{
+	export_fb_align ( fb, len, 0 );
+	export_fb_put_uint ( fb, value, len );
+	export_fb_field_set ( fb, field );
+}
+
+
+/*
+ * Adds a field to the current table that refers to the
+ * object "ref" (string, vector or table).
+ */
+void export_fb_field_ref ( export_fb *fb, int field, size_t ref )
+{
+	export_fb_put_ref ( fb, ref );
+	export_fb_field_set ( fb, field );
+}
+
+
+/*
+ * Completes the current table: Adds the table's vtable (which
+ * stores the positions of all fields) and returns a reference
+ * to the table.
+ */
+size_t export_fb_table_end ( export_fb *fb )
+{
+	size_t table;
+	int i;
+
+	/* offset to vtable (set below) */
+	export_fb_align ( fb, 4, 0 );
+	export_fb_put_uint ( fb, 0, 4 );
+	table = fb->len;
+
+	/* vtable: own size, size of table and field positions */
+	for ( i = fb->num_fields - 1; i >= 0; i -- ) {
+		if ( fb->fields[i] > 0 ) {
+			export_fb_put_uint ( fb, table - fb->fields[i], 2 );
+		} else {
+			export_fb_put_uint ( fb, 0, 2 );
+		}
+	}
+	export_fb_put_uint ( fb, table - fb->table_start, 2 );
+	export_fb_put_uint ( fb, 4 + 2 * fb->num_fields, 2 );
+
+	/* The vtable directly precedes the table. */
+	export_fb_encode ( fb->data + fb->size - table, fb->len - table, 4 );
+
+	return ( table );
+}
+
+
+/*
+ * Completes the buffer with "root" as its root table.
+ * Returns a pointer to the start of the buffer, which is
+ * "fb->len" bytes long.
+ */
+unsigned char *export_fb_finish ( export_fb *fb, size_t root )
+{
+	export_fb_align ( fb, fb->min_align, 4 );
+	export_fb_put_ref ( fb, root );
+
+	return ( fb->data + fb->size - fb->len );
+}
+
+
+/*
+ * Writes the contents of "fb" (which must have been finished)
+ * to "fp", preceded by their size, as required for FlatGeobuf
+ * header and features.
+ */
+void export_FGB_write_buffer ( export_buf *fp, export_fb *fb )
+{
+	unsigned char size[4];
+
+	export_fb_encode ( size, fb->len, 4 );
+	export_buf_write ( fp, (const char*) size, 4 );
+	export_buf_write ( fp, (const char*) ( fb->data + fb->size - fb->len ), fb->len );
+}
+
+
+/*
+ * Sort function for qsort(): features with higher Hilbert values
+ * come first (as in the FlatGeobuf reference implementation).
+ * Ties are resolved by geom ID, so that output is reproducible.
+ */
+int export_FGB_compare_items ( const void *a, const void *b )
+{
+	const export_FGB_item *A = (const export_FGB_item*) a;
+	const export_FGB_item *B = (const export_FGB_item*) b;
+
+	if ( A->hilbert != B->hilbert ) {
+		return ( A->hilbert > B->hilbert ? -1 : 1 );
+	}
+	if ( A->geom_id != B->geom_id ) {
+		return ( A->geom_id < B->geom_id ? -1 : 1 );
+	}
+
+	return ( 0 );
+}
+
+
+/*
+ * Helper function for export_FGB_make_items (below).
+ * Extends the bounding box of "item" to include all parts of a
+ * line or polygon.
+ */
+void export_FGB_item_add_parts ( export_FGB_item *item, geom_part *parts, unsigned int num_parts )
+{
+	unsigned int j, k;
+
+	for ( j = 0; j < num_parts; j ++ ) {
+		for ( k = 0; k < parts[j].num_vertices; k ++ ) {
+			if ( parts[j].X[k] < item->x_min ) item->x_min = parts[j].X[k];
+			if ( parts[j].X[k] > item->x_max ) item->x_max = parts[j].X[k];
+			if ( parts[j].Y[k] < item->y_min ) item->y_min = parts[j].Y[k];
+			if ( parts[j].Y[k] > item->y_max ) item->y_max = parts[j].Y[k];
+		}
+	}
+}
+
+
+/*
+ * Creates a list of all selected geometries in "gs", in the same
+ * order (and with the same geom IDs) as in GeoJSON output, then
+ * sorts it along a Hilbert curve through all bounding box centers.
+ *
+ * The number of list items is stored in "num_items", the total
+ * extent of all items in "extent" (min. X, min. Y, max. X, max. Y).
+ * "has_z" is set to TRUE if at least one of the selected geometries
+ * has Z coordinates that must be exported.
+ *
+ * Returns the new list, which must be free'd by the caller.
+ */
+export_FGB_item *export_FGB_make_items ( geom_store *gs, options *opts, int *num_items,
+		double *extent, BOOLEAN *has_z )
+{
+	export_FGB_item *items;
+	export_FGB_item *item;
+	double width, height;
+	int num = 0;
+	int i;
+
+
+	items = malloc ( sizeof (export_FGB_item) *
+			( gs->num_polygons + gs->num_lines + gs->num_points + gs->num_points_raw + 1 ) );
+	*has_z = FALSE;
+
+	for ( i = 0; i < gs->num_polygons; i ++ ) {
+		if ( gs->polygons[i].is_selected == TRUE ) {
+			item = &items[num];
+			item->GEOM_TYPE = GEOM_TYPE_POLY;
+			item->pk = i;
+			item->geom_id = num;
+			item->x_min = item->y_min = DBL_MAX;
+			item->x_max = item->y_max = -DBL_MAX;
+			export_FGB_item_add_parts ( item, gs->polygons[i].parts, gs->polygons[i].num_parts );
+			if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+				*has_z = TRUE;
+			}
+			num ++;
+		}
+	}
+	for ( i = 0; i < gs->num_lines; i ++ ) {
+		if ( gs->lines[i].is_selected == TRUE ) {
+			item = &items[num];
+			item->GEOM_TYPE = GEOM_TYPE_LINE;
+			item->pk = i;
+			item->geom_id = num;
+			item->x_min = item->y_min = DBL_MAX;
+			item->x_max = item->y_max = -DBL_MAX;
+			export_FGB_item_add_parts ( item, gs->lines[i].parts, gs->lines[i].num_parts );
+			if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+				*has_z = TRUE;
+			}
+			num ++;
+		}
+	}
+	for ( i = 0; i < gs->num_points; i ++ ) {
+		if ( gs->points[i].is_selected == TRUE ) {
+			item = &items[num];
+			item->GEOM_TYPE = GEOM_TYPE_POINT;
+			item->pk = i;
+			item->geom_id = num;
+			item->x_min = item->x_max = gs->points[i].X;
+			item->y_min = item->y_max = gs->points[i].Y;
+			if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+				*has_z = TRUE;
+			}
+			num ++;
+		}
+	}
+	for ( i = 0; i < gs->num_points_raw; i ++ ) {
+		if ( gs->points_raw[i].is_selected == TRUE ) {
+			item = &items[num];
+			item->GEOM_TYPE = GEOM_TYPE_POINT_RAW;
+			item->pk = i;
+			item->geom_id = num;
+			item->x_min = item->x_max = gs->points_raw[i].X;
+			item->y_min = item->y_max = gs->points_raw[i].Y;
+			if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
+				*has_z = TRUE;
+			}
+			num ++;
+		}
+	}
+
+	/* total extent */
+	extent[0] = extent[1] = DBL_MAX;
+	extent[2] = extent[3] = -DBL_MAX;
+	for ( i = 0; i < num; i ++ ) {
+		/* geometries without vertices have no extent */
+		if ( items[i].x_min > items[i].x_max ) {
+			items[i].x_min = items[i].x_max = 0.0;
+			items[i].y_min = items[i].y_max = 0.0;
+		}
+		if ( items[i].x_min < extent[0] ) extent[0] = items[i].x_min;
+		if ( items[i].y_min < extent[1] ) extent[1] = items[i].y_min;
+		if ( items[i].x_max > extent[2] ) extent[2] = items[i].x_max;
+		if ( items[i].y_max > extent[3] ) extent[3] = items[i].y_max;
+	}
+
+	/* Hilbert sort */
+	width = extent[2] - extent[0];
+	height = extent[3] - extent[1];
+	for ( i = 0; i < num; i ++ ) {
+		unsigned int x = 0;
+		unsigned int y = 0;
+		if ( width > 0.0 ) {
+			x = (unsigned int) floor ( 65535.0 *
+					( ( items[i].x_min + items[i].x_max ) / 2.0 - extent[0] ) / width );
+		}
+		if ( height > 0.0 ) {
+			y = (unsigned int) floor ( 65535.0 *
+					( ( items[i].y_min + items[i].y_max ) / 2.0 - extent[1] ) / height );
+		}
+		items[i].hilbert = geom_tools_hilbert ( x, y );
+	}
+	qsort ( items, num, sizeof (export_FGB_item), export_FGB_compare_items );
+
+	*num_items = num;
+
+	return ( items );
+}
+
+
+/*
+ * Writes a packed Hilbert R-tree of all "items" (which must
+ * already be sorted and have their feature offsets set) to "fp".
+ *
+ * All nodes are stored level by level, starting with the root node.
+ * Each leaf node holds the bounding box and byte offset of one
+ * feature; each other node holds the combined bounding box of up to
+ * EXPORT_FGB_NODE_SIZE nodes on the next level, and the index of
+ * the first of these.
+ */
+void export_FGB_write_index ( export_buf *fp, export_FGB_item *items, int num_items )
+{
+	unsigned long long level_start[64]; /* index of first node of each level (leaves first) */
+	unsigned long long level_end[64];
+	unsigned long long num_nodes;
+	unsigned long long n;
+	unsigned long long pos, end, parent;
+	unsigned char node_bytes[EXPORT_FGB_NODE_BYTES];
+	double *bbox; /* 4 values per node */
+	unsigned long long *offset;
+	int num_levels;
+	int i, j;
+
+
+	/* number of nodes on each level */
+	n = num_items;
+	num_nodes = n;
+	num_levels = 0;
+	level_end[num_levels++] = n;
+	do {
+		n = ( n + EXPORT_FGB_NODE_SIZE - 1 ) / EXPORT_FGB_NODE_SIZE;
+		num_nodes += n;
+		level_end[num_levels++] = n;
+	} while ( n != 1 );
+	/* convert to node index ranges */
+	n = num_nodes;
+	for ( i = 0; i < num_levels; i ++ ) {
+		unsigned long long size = level_end[i];
+		n -= size;
+		level_start[i] = n;
+		level_end[i] = n + size;
+	}
+
+	/* leaves */
+	bbox = malloc ( sizeof (double) * 4 * num_nodes );
+	offset = malloc ( sizeof (unsigned long long) * num_nodes );
+	for ( i = 0; i < num_items; i ++ ) {
+		pos = level_start[0] + i;
+		bbox[pos*4] = items[i].x_min;
+		bbox[pos*4+1] = items[i].y_min;
+		bbox[pos*4+2] = items[i].x_max;
+		bbox[pos*4+3] = items[i].y_max;
+		offset[pos] = items[i].offset;
+	}
+
+	/* inner nodes, bottom up */
+	for ( i = 0; i < num_levels - 1; i ++ ) {
+		pos = level_start[i];
+		end = level_end[i];
+		parent = level_start[i+1];
+		while ( pos < end ) {
+			bbox[parent*4] = bbox[parent*4+1] = DBL_MAX;
+			bbox[parent*4+2] = bbox[parent*4+3] = -DBL_MAX;
+			offset[parent] = pos;
+			for ( j = 0; j < EXPORT_FGB_NODE_SIZE && pos < end; j ++, pos ++ ) {
+				if ( bbox[pos*4] < bbox[parent*4] ) bbox[parent*4] = bbox[pos*4];
+				if ( bbox[pos*4+1] < bbox[parent*4+1] ) bbox[parent*4+1] = bbox[pos*4+1];
+				if ( bbox[pos*4+2] > bbox[parent*4+2] ) bbox[parent*4+2] = bbox[pos*4+2];
+				if ( bbox[pos*4+3] > bbox[parent*4+3] ) bbox[parent*4+3] = bbox[pos*4+3];
+			}
+			parent ++;
+		}
+	}
+
+	for ( pos = 0; pos < num_nodes; pos ++ ) {
+		for ( j = 0; j < 4; j ++ ) {
+			export_fb_encode_double ( node_bytes + j * 8, bbox[pos*4+j] );
+		}
+		export_fb_encode ( node_bytes + 32, offset[pos], 8 );
+		export_buf_write ( fp, (const char*) node_bytes, EXPORT_FGB_NODE_BYTES );
+	}
+
+	free ( bbox );
+	free ( offset );
+}
+
+
+/*
+ * Stores the names and types (EXPORT_FGB_COL_*) of all attribute
+ * columns in "names" and "types", which must have room for
+ * PRG_MAX_FIELDS + 9 entries each.
+ *
+ * Attribute columns are: "geom_id", then the label properties
+ * (if a label field has been set), then all attribute fields of
+ * the parser, with column types matching the parser field types.
+ *
+ * Returns the number of columns.
+ */
+int export_FGB_get_columns ( parser_desc *parser, options *opts, const char **names, unsigned char *types )
+{
+	int num_columns = 0;
+	int i;
+
+
+	for ( i = 0; i < 9 + PRG_MAX_FIELDS; i ++ ) {
+		const char *col_name = NULL;
+		unsigned char col_type = EXPORT_FGB_COL_STRING;
+		if ( i == 0 ) {
+			col_name = "geom_id";
+			col_type = EXPORT_FGB_COL_INT;
+		} else if ( i < 9 ) {
+			if ( opts->label_field == NULL ) {
+				continue;
+			}
+			if ( i == 1 ) { col_name = LBL_FIELD_NAME_X; col_type = EXPORT_FGB_COL_DOUBLE; }
+			if ( i == 2 ) { col_name = LBL_FIELD_NAME_Y; col_type = EXPORT_FGB_COL_DOUBLE; }
+			if ( i == 3 ) { col_name = LBL_FIELD_NAME_TEXT; col_type = EXPORT_FGB_COL_STRING; }
+			if ( i == 4 ) { col_name = LBL_FIELD_NAME_FONT_TYPE; col_type = EXPORT_FGB_COL_STRING; }
+			if ( i == 5 ) { col_name = LBL_FIELD_NAME_FONT_STYLE; col_type = EXPORT_FGB_COL_INT; }
+			if ( i == 6 ) { col_name = LBL_FIELD_NAME_FONT_COLOR; col_type = EXPORT_FGB_COL_INT; }
+			if ( i == 7 ) { col_name = LBL_FIELD_NAME_FONT_SIZE; col_type = EXPORT_FGB_COL_DOUBLE; }
+			if ( i == 8 ) { col_name = LBL_FIELD_NAME_FONT_ROTATE; col_type = EXPORT_FGB_COL_DOUBLE; }
+		} else {
+			if ( parser->fields[i-9] == NULL ) {
+				break;
+			}
+			if ( parser->fields[i-9]->skip == TRUE ) {
+				continue;
+			}
+			col_name = parser->fields[i-9]->name;
+			if ( parser->fields[i-9]->type == PARSER_FIELD_TYPE_INT ) {
+				col_type = EXPORT_FGB_COL_INT;
+			}
+			if ( parser->fields[i-9]->type == PARSER_FIELD_TYPE_DOUBLE ) {
+				col_type = EXPORT_FGB_COL_DOUBLE;
+			}
+		}
+		names[num_columns] = col_name;
+		types[num_columns] = col_type;
+		num_columns ++;
+	}
+
+	return ( num_columns );
+}
+
+
+/*
+ * Writes the FlatGeobuf header to "fp", using "fb" to build it.
+ * See export_FGB_get_columns() for the attribute columns.
+ */
+void export_FGB_write_header ( export_buf *fp, export_fb *fb, parser_desc *parser, options *opts,
+		int num_items, double *extent, BOOLEAN has_z )
+{
+	const char *col_names[PRG_MAX_FIELDS + 9];
+	unsigned char col_types[PRG_MAX_FIELDS + 9];
+	size_t columns[PRG_MAX_FIELDS + 9];
+	size_t name;
+	size_t ref_name, ref_envelope, ref_columns;
+	int num_columns;
+	int i;
+
+
+	export_fb_clear ( fb );
+
+	/* columns */
+	num_columns = export_FGB_get_columns ( parser, opts, col_names, col_types );
+	for ( i = 0; i < num_columns; i ++ ) {
+		name = export_fb_string ( fb, col_names[i] );
+		/* table "Column": name (0), type (1) */
+		export_fb_table_start ( fb );
+		export_fb_field_ref ( fb, 0, name );
+		export_fb_field_uint ( fb, 1, col_types[i], 1 );
+		columns[i] = export_fb_table_end ( fb );
+	}
+	ref_columns = export_fb_vector_refs ( fb, columns, num_columns );
+
+	ref_name = export_fb_string ( fb, opts->base );
+	ref_envelope = 0;
+	if ( num_items > 0 ) {
+		ref_envelope = export_fb_vector_double ( fb, extent, 4 );
+	}
+
+	/* table "Header": name (0), envelope (1), geometry_type (2; default: "unknown"),
+	   has_z (3), columns (7), features_count (8), index_node_size (9; default: 16) */
+	export_fb_table_start ( fb );
+	export_fb_field_uint ( fb, 8, num_items, 8 );
+	if ( ref_envelope > 0 ) {
+		export_fb_field_ref ( fb, 1, ref_envelope );
+	}
+	export_fb_field_ref ( fb, 0, ref_name );
+	export_fb_field_ref ( fb, 7, ref_columns );
+	if ( num_items < 1 ) {
+		/* no index */
+		export_fb_field_uint ( fb, 9, 0, 2 );
+	} else {
+		export_fb_field_uint ( fb, 9, EXPORT_FGB_NODE_SIZE, 2 );
+	}
+	if ( has_z == TRUE ) {
+		export_fb_field_uint ( fb, 3, 1, 1 );
+	}
+	export_fb_finish ( fb, export_fb_table_end ( fb ) );
+
+	export_FGB_write_buffer ( fp, fb );
+}
+
+
+/*
+ * Adds a point geometry to "fb" and returns a reference to it.
+ */
+size_t export_FGB_make_point ( export_fb *fb, double X, double Y, double Z, BOOLEAN has_z )
+{
+	double xy[2];
+	size_t ref_xy, ref_z = 0;
+
+	if ( has_z == TRUE ) {
+		ref_z = export_fb_vector_double ( fb, &Z, 1 );
+	}
+	xy[0] = X;
+	xy[1] = Y;
+	ref_xy = export_fb_vector_double ( fb, xy, 2 );
+
+	/* table "Geometry": xy (1), z (2), type (6) */
+	export_fb_table_start ( fb );
+	export_fb_field_ref ( fb, 1, ref_xy );
+	if ( ref_z > 0 ) {
+		export_fb_field_ref ( fb, 2, ref_z );
+	}
+	export_fb_field_uint ( fb, 6, EXPORT_FGB_GEOM_POINT, 1 );
+
+	return ( export_fb_table_end ( fb ) );
+}
+
+
+/*
+ * Adds a geometry that consists of one or more vertex lists
+ * (line parts or polygon rings) to "fb" and returns a reference
+ * to it. "type" is the FlatGeobuf geometry type.
+ */
+size_t export_FGB_make_parts ( export_fb *fb, geom_part **parts, int num_parts,
+		BOOLEAN is_3D, BOOLEAN has_z, unsigned char type )
+{
+	size_t ref_ends = 0, ref_xy, ref_z = 0;
+	unsigned int num_vertices = 0;
+	unsigned int end;
+	int i, j;
+
+
+	for ( i = 0; i < num_parts; i ++ ) {
+		num_vertices += parts[i]->num_vertices;
+	}
+
+	/* end of each part (only required for more than one part) */
+	if ( num_parts > 1 ) {
+		end = num_vertices;
+		export_fb_vector_start ( fb, num_parts, 4 );
+		for ( i = num_parts - 1; i >= 0; i -- ) {
+			export_fb_put_uint ( fb, end, 4 );
+			end -= parts[i]->num_vertices;
+		}
+		ref_ends = export_fb_vector_end ( fb, num_parts );
+	}
+
+	/* Z coordinates */
+	if ( has_z == TRUE ) {
+		export_fb_vector_start ( fb, num_vertices, 8 );
+		for ( i = num_parts - 1; i >= 0; i -- ) {
+			for ( j = parts[i]->num_vertices - 1; j >= 0; j -- ) {
+				if ( is_3D == TRUE ) {
+					export_fb_put_double ( fb, parts[i]->Z[j] );
+				} else {
+					export_fb_put_double ( fb, 0.0 );
+				}
+			}
+		}
+		ref_z = export_fb_vector_end ( fb, num_vertices );
+	}
+
+	/* X/Y coordinates (interleaved) */
+	export_fb_vector_start ( fb, num_vertices * 2, 8 );
+	for ( i = num_parts - 1; i >= 0; i -- ) {
+		for ( j = parts[i]->num_vertices - 1; j >= 0; j -- ) {
+			export_fb_put_double ( fb, parts[i]->Y[j] );
+			export_fb_put_double ( fb, parts[i]->X[j] );
+		}
+	}
+	ref_xy = export_fb_vector_end ( fb, num_vertices * 2 );
+
+	/* table "Geometry": ends (0), xy (1), z (2), type (6) */
+	export_fb_table_start ( fb );
+	if ( ref_ends > 0 ) {
+		export_fb_field_ref ( fb, 0, ref_ends );
+	}
+	export_fb_field_ref ( fb, 1, ref_xy );
+	if ( ref_z > 0 ) {
+		export_fb_field_ref ( fb, 2, ref_z );
+	}
+	export_fb_field_uint ( fb, 6, type, 1 );
+
+	return ( export_fb_table_end ( fb ) );
+}
+
+
+/*
+ * Helper function for export_FGB_make_polygon (below).
+ * Returns TRUE if hole "k" of polygon "pk" lies within part "j"
+ * and not inside any other hole. These are the same rules that
+ * are used for GeoJSON and KML output.
+ */
+BOOLEAN export_FGB_hole_in_part ( geom_store *gs, unsigned int pk, unsigned int k, unsigned int j )
+{
+	geom_part *A = &gs->polygons[pk].parts[k];
+	int l, m;
+
+	if ( geom_tools_part_in_part_2D ( A, &gs->polygons[pk].parts[j] ) == FALSE ) {
+		return ( FALSE );
+	}
+	for ( l = 0; l < gs->num_polygons; l++ ) {
+		for ( m = 0; m < gs->polygons[l].num_parts; m++ ) {
+			if ( gs->polygons[l].parts[m].is_hole == TRUE ) {
+				if ( geom_tools_part_in_part_2D ( A, &gs->polygons[l].parts[m] ) == TRUE ) {
+					return ( FALSE );
+				}
+			}
+		}
+	}
+
+	return ( TRUE );
+}
+
+
+/*
+ * Adds polygon "pk" to "fb" and returns a reference to it.
+ * A polygon with more than one outer boundary becomes a
+ * FlatGeobuf "MultiPolygon", with one "Polygon" per outer
+ * boundary (and its holes).
+ */
+size_t export_FGB_make_polygon ( export_fb *fb, geom_store *gs, unsigned int pk, BOOLEAN has_z )
+{
+	geom_store_polygon *poly = &gs->polygons[pk];
+	geom_part **rings;
+	size_t *refs;
+	size_t ref_parts, result;
+	int num_outer = 0;
+	int num_rings;
+	unsigned int j, k;
+
+
+	rings = malloc ( sizeof (geom_part*) * ( poly->num_parts + 1 ) );
+	refs = malloc ( sizeof (size_t) * ( poly->num_parts + 1 ) );
+
+	for ( j = 0; j < poly->num_parts; j ++ ) {
+		if ( poly->parts[j].is_hole == FALSE ) {
+			/* outer boundary, followed by its holes */
+			num_rings = 0;
+			rings[num_rings++] = &poly->parts[j];
+			for ( k = 0; k < poly->num_parts; k ++ ) {
+				if ( poly->parts[k].is_hole == TRUE && export_FGB_hole_in_part ( gs, pk, k, j ) == TRUE ) {
+					rings[num_rings++] = &poly->parts[k];
+				}
+			}
+			refs[num_outer++] = export_FGB_make_parts ( fb, rings, num_rings, poly->is_3D, has_z,
+					EXPORT_FGB_GEOM_POLYGON );
+		}
+	}
+
+	if ( num_outer == 1 ) {
+		result = refs[0];
+	} else {
+		ref_parts = export_fb_vector_refs ( fb, refs, num_outer );
+		/* table "Geometry": type (6), parts (7) */
+		export_fb_table_start ( fb );
+		export_fb_field_ref ( fb, 7, ref_parts );
+		export_fb_field_uint ( fb, 6, EXPORT_FGB_GEOM_MULTIPOLYGON, 1 );
+		result = export_fb_table_end ( fb );
+	}
+
+	free ( rings );
+	free ( refs );
+
+	return ( result );
+}
+
+
+/*
+ * Property encoders: Append the value of column "col" to "props",
+ * as required for the "properties" member of a FlatGeobuf feature.
+ */
+void export_FGB_put_int ( export_buf *props, unsigned int col, int value )
+{
+	unsigned char bytes[6];
+
+	export_fb_encode ( bytes, col, 2 );
+	export_fb_encode ( bytes + 2, (unsigned int) value, 4 );
+	export_buf_write ( props, (const char*) bytes, 6 );
+}
+
+void export_FGB_put_double ( export_buf *props, unsigned int col, double value )
+{
+	unsigned char bytes[10];
+
+	export_fb_encode ( bytes, col, 2 );
+	export_fb_encode_double ( bytes + 2, value );
+	export_buf_write ( props, (const char*) bytes, 10 );
+}
+
+void export_FGB_put_string ( export_buf *props, unsigned int col, const char *value )
+{
+	unsigned char bytes[6];
+	size_t len = strlen ( value );
+
+	export_fb_encode ( bytes, col, 2 );
+	export_fb_encode ( bytes + 2, len, 4 );
+	export_buf_write ( props, (const char*) bytes, 6 );
+	export_buf_write ( props, value, len );
+}
+
+
+/*
+ * Encodes the attributes of one feature into "props" (which is
+ * cleared first), in the column order set up by
+ * export_FGB_write_header().
+ *
+ * Attribute values are converted and checked exactly as for GeoJSON
+ * output. Missing or invalid values are stored as the user-defined
+ * NULL value if there is one. Otherwise, they are left out, which
+ * makes them NULL values in FlatGeobuf.
+ *
+ * The return value is the total number of attribute data errors.
+ */
+int export_FGB_write_properties ( export_buf *props, geom_store *gs, export_FGB_item *item,
+		parser_desc *parser, options *opts )
+{
+	unsigned int err_count = 0;
+	char NULL_str[DBF_INTEGER_WIDTH + 1];
+	BOOLEAN store_null;
+	BOOLEAN c_error;
+	BOOLEAN c_overflow;
+	BOOLEAN has_label = FALSE;
+	double label_x = 0.0;
+	double label_y = 0.0;
+	const char *input = NULL;
+	unsigned int line = 0;
+	char **atts = NULL;
+	unsigned int col = 0;
+	unsigned int pk = item->pk;
+	int i;
+
+
+	props->len = 0;
+
+	/* string representation of user-defined NULL value */
+	if ( parser->empty_val_set == TRUE ) {
+		snprintf ( NULL_str, DBF_INTEGER_WIDTH, "%i", parser->empty_val );
+	}
+
+	/* get input source and line, attribute field contents and label (first part only) */
+	if ( item->GEOM_TYPE == GEOM_TYPE_POINT ) {
+		input = gs->points[pk].source;
+		line = gs->points[pk].line;
+		atts = gs->points[pk].atts;
+		has_label = gs->points[pk].has_label;
+		label_x = gs->points[pk].label_x;
+		label_y = gs->points[pk].label_y;
+	}
+	if ( item->GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+		input = gs->points_raw[pk].source;
+		line = gs->points_raw[pk].line;
+		atts = gs->points_raw[pk].atts;
+		has_label = gs->points_raw[pk].has_label;
+		label_x = gs->points_raw[pk].label_x;
+		label_y = gs->points_raw[pk].label_y;
+	}
+	if ( item->GEOM_TYPE == GEOM_TYPE_LINE ) {
+		input = gs->lines[pk].source;
+		line = gs->lines[pk].line;
+		atts = gs->lines[pk].atts;
+		has_label = gs->lines[pk].parts[0].has_label;
+		label_x = gs->lines[pk].parts[0].label_x;
+		label_y = gs->lines[pk].parts[0].label_y;
+	}
+	if ( item->GEOM_TYPE == GEOM_TYPE_POLY ) {
+		input = gs->polygons[pk].source;
+		line = gs->polygons[pk].line;
+		atts = gs->polygons[pk].atts;
+		has_label = gs->polygons[pk].parts[0].has_label;
+		label_x = gs->polygons[pk].parts[0].label_x;
+		label_y = gs->polygons[pk].parts[0].label_y;
+	}
+	if ( input == NULL )  {
+		input = "<NULL>";
+	} else {
+		if ( !strcmp ( "-", input ) ) {
+			input = "<console input stream>";
+		}
+	}
+
+	/* first property is always the geom ID */
+	export_FGB_put_int ( props, col++, item->geom_id );
+
+	/* label properties */
+	if ( opts->label_field != NULL ) {
+		if ( has_label == TRUE ) {
+			export_FGB_put_double ( props, col, label_x );
+			export_FGB_put_double ( props, col + 1, label_y );
+			i = 0;
+			while ( parser->fields[i] != NULL ) {
+				if ( !strcasecmp (parser->fields[i]->name, opts->label_field)  ) {
+					if ( atts[i] != NULL ) {
+						export_FGB_put_string ( props, col + 2, atts[i] );
+					} else if ( parser->empty_val_set == TRUE ) {
+						export_FGB_put_string ( props, col + 2, NULL_str );
+					}
+					break;
+				}
+				i ++;
+			}
+			export_FGB_put_string ( props, col + 3, LBL_FIELD_DEFAULT_FONT_TYPE );
+			export_FGB_put_int ( props, col + 4, LBL_FIELD_DEFAULT_FONT_STYLE );
+			export_FGB_put_int ( props, col + 5, LBL_FIELD_DEFAULT_FONT_COLOR );
+			export_FGB_put_double ( props, col + 6, LBL_FIELD_DEFAULT_FONT_SIZE );
+			export_FGB_put_double ( props, col + 7, LBL_FIELD_DEFAULT_FONT_ROTATE );
+		}
+		col += 8;
+	}
+
+	/* attribute fields */
+	for ( i = 0; parser->fields[i] != NULL; i ++ ) {
+		if ( parser->fields[i]->skip == TRUE ) {
+			continue;
+		}
+		if ( parser->fields[i]->type == PARSER_FIELD_TYPE_INT ) {
+			/*** INTEGER ***/
+			int i_value = parser_str_to_int_field ( parser, parser->fields[i]->name, atts[i], &c_error, &c_overflow );
+			store_null = FALSE;
+			/* check for all conditions under which NULL data will be written */
+			if ( c_error == TRUE && c_overflow == FALSE ) {
+				err_show ( ERR_NOTE, "" );
+				err_show ( ERR_WARN, _("\nRecord read from '%s', line %i\nValue for attribute '%s' is not a valid integer number\nNULL data written instead."),
+						input, line, parser->fields[i]->name);
+				store_null = TRUE;
+				err_count ++;
+			} else {
+				if ( c_overflow == TRUE ) {
+					err_show ( ERR_NOTE, "" );
+					err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nValue for attribute '%s' is too large (overflow).\nNULL data written instead."),
+							input, line, parser->fields[i]->name);
+					store_null = TRUE;
+					err_count ++;
+				} else {
+					if ( atts[i] == NULL ) {
+						store_null = TRUE;
+					}
+				}
+			}
+			if ( store_null == FALSE ) {
+				export_FGB_put_int ( props, col, i_value );
+			} else if ( parser->empty_val_set == TRUE ) {
+				export_FGB_put_int ( props, col, parser->empty_val );
+			}
+		} else if ( parser->fields[i]->type == PARSER_FIELD_TYPE_DOUBLE ) {
+			/*** DOUBLE ***/
+			double d_value = parser_str_to_dbl_field ( parser, parser->fields[i]->name, atts[i], opts->decimal_point[0], opts->decimal_group[0], &c_error, &c_overflow );
+			store_null = FALSE;
+			/* check for all conditions under which NULL data will be written */
+			if ( c_error == TRUE && c_overflow == FALSE ) {
+				err_show ( ERR_NOTE, "" );
+				err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nValue for attribute '%s' is not a valid number\nNULL data written instead."),
+						input, line, parser->fields[i]->name);
+				store_null = TRUE;
+				err_count ++;
+			} else {
+				if ( c_overflow == TRUE ) {
+					err_show ( ERR_NOTE, "" );
+					err_show ( ERR_WARN, _("\nRecord read from '%s', line %i:\nValue for attribute '%s' is too large (overflow).\nNULL data written instead."),
+							input, line, parser->fields[i]->name);
+					store_null = TRUE;
+					err_count ++;
+				} else {
+					if ( atts[i] == NULL ) {
+						store_null = TRUE;
+					}
+				}
+			}
+			if ( store_null == FALSE ) {
+				export_FGB_put_double ( props, col, d_value );
+			} else if ( parser->empty_val_set == TRUE ) {
+				export_FGB_put_double ( props, col, (double) parser->empty_val );
+			}
+		} else {
+			/*** TEXT ***/
+			if ( atts[i] != NULL ) {
+				export_FGB_put_string ( props, col, atts[i] );
+			} else if ( parser->empty_val_set == TRUE ) {
+				export_FGB_put_string ( props, col, NULL_str );
+			}
+		}
+		col ++;
+	}
+
+	return ( err_count );
+}
+
+
+/*
+ * Encodes one feature (geometry and attributes) and appends it to "out".
+ * "fb" and "props" are used as scratch buffers.
+ *
+ * Returns the number of attribute field errors.
+ */
+int export_FGB_write_feature ( export_buf *out, export_fb *fb, export_buf *props,
+		geom_store *gs, export_FGB_item *item, parser_desc *parser, options *opts, BOOLEAN has_z )
+{
+	size_t ref_geom = 0;
+	size_t ref_props = 0;
+	geom_part **parts;
+	unsigned int pk = item->pk;
+	unsigned int j;
+	int num_errors;
+
+
+	export_fb_clear ( fb );
+
+	if ( item->GEOM_TYPE == GEOM_TYPE_POINT ) {
+		ref_geom = export_FGB_make_point ( fb, gs->points[pk].X, gs->points[pk].Y,
+				gs->points[pk].is_3D == TRUE ? gs->points[pk].Z : 0.0, has_z );
+	}
+	if ( item->GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+		ref_geom = export_FGB_make_point ( fb, gs->points_raw[pk].X, gs->points_raw[pk].Y,
+				gs->points_raw[pk].is_3D == TRUE ? gs->points_raw[pk].Z : 0.0, has_z );
+	}
+	if ( item->GEOM_TYPE == GEOM_TYPE_LINE ) {
+		parts = malloc ( sizeof (geom_part*) * ( gs->lines[pk].num_parts + 1 ) );
+		for ( j = 0; j < gs->lines[pk].num_parts; j ++ ) {
+			parts[j] = &gs->lines[pk].parts[j];
+		}
+		ref_geom = export_FGB_make_parts ( fb, parts, gs->lines[pk].num_parts, gs->lines[pk].is_3D, has_z,
+				gs->lines[pk].num_parts > 1 ? EXPORT_FGB_GEOM_MULTILINESTRING : EXPORT_FGB_GEOM_LINESTRING );
+		free ( parts );
+	}
+	if ( item->GEOM_TYPE == GEOM_TYPE_POLY ) {
+		ref_geom = export_FGB_make_polygon ( fb, gs, pk, has_z );
+	}
+
+	num_errors = export_FGB_write_properties ( props, gs, item, parser, opts );
+	ref_props = export_fb_vector_bytes ( fb, (const unsigned char*) props->data, props->len );
+
+	/* table "Feature": geometry (0), properties (1) */
+	export_fb_table_start ( fb );
+	export_fb_field_ref ( fb, 0, ref_geom );
+	export_fb_field_ref ( fb, 1, ref_props );
+	export_fb_finish ( fb, export_fb_table_end ( fb ) );
+
+	export_FGB_write_buffer ( out, fb );
+
+	return ( num_errors );
+}
+
+
+/*
+ * Writes geometry store objects into a new, single FlatGeobuf file
+ * that holds all geometry types. As in GeoJSON output, each feature
+ * has its own geometry type and all features share the same set of
+ * attribute columns, typed according to the parser field types.
+ *
+ * Features are stored in the order of a Hilbert curve through their
+ * bounding box centers and are indexed by a packed Hilbert R-tree,
+ * so that readers can efficiently query them by location.
+ *
+ * By the time this function is called, "gs" must be a valid geometry
+ * store and must contain only fully checked and built, valid geometries,
+ * ready to be written to disk.
+ *
+ * If "force 2D" has been set, then no Z coordinates will be written.
+ *
+ * Returns number of attribute field errors.
+ */
+int export_FGB ( geom_store *gs, parser_desc *parser, options *opts )
+{
+	export_FGB_item *items;
+	export_buf *features;
+	export_buf *props;
+	export_buf *fp;
+	export_fb *fb;
+	double extent[4];
+	BOOLEAN has_z;
+	int num_items;
+	int num_errors = 0;
+	int i;
+
+
+	/* Check if there is anything to export! */
+	if ( gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons < 1 )  {
+		err_show (ERR_NOTE,"");
+		err_show (ERR_WARN, _("\nNo valid geometries found. No output produced."));
+		return ( 0 );
+	}
+
+	items = export_FGB_make_items ( gs, opts, &num_items, extent, &has_z );
+
+	/* The index must precede the features, but it can only be built
+	   once the offsets of all features are known: encode all features
+	   into memory first. */
+	fb = export_fb_create ();
+	props = export_buf_create ( NULL );
+	features = export_buf_create ( NULL );
+	for ( i = 0; i < num_items; i ++ ) {
+		items[i].offset = features->len;
+		num_errors += export_FGB_write_feature ( features, fb, props, gs, &items[i], parser, opts, has_z );
+	}
+
+	/* Attempt to create output file. */
+	fp = export_buf_open ( gs->path_all );
+	if ( fp != NULL ) {
+		export_buf_write ( fp, (const char*) EXPORT_FGB_MAGIC, 8 );
+		export_FGB_write_header ( fp, fb, parser, opts, num_items, extent, has_z );
+		if ( num_items > 0 ) {
+			export_FGB_write_index ( fp, items, num_items );
+		}
+		export_buf_flush ( fp );
+		if ( features->len > 0 && fwrite ( features->data, sizeof (char), features->len, fp->fp ) != features->len ) {
+			fp->error = TRUE;
+		}
+		if ( export_buf_close ( fp ) != 0 ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_WARN, _("\nFailed to write FlatGeobuf file\n(%s)."), gs->path_all );
+		}
+	}
+
+	export_buf_close ( features );
+	export_buf_close ( props );
+	export_fb_destroy ( fb );
+	free ( items );
+
+	return ( num_errors );
+}
+
+
+/*
+ * MAPBOX VECTOR TILE EXPORT
+ *
+ * Vector tiles are written as a pyramid of directories below the
+ * output path: "<zoom>/<column>/<row>.mvt", plus a TileJSON file
+ * "metadata.json" that describes the whole tile set. Each tile is a
+ * Protocol Buffers message with one layer per geometry type, encoded
+ * by the small export_pb_* functions below.
+ *
+ * Attribute values are encoded once, in advance, by the same code
+ * that is used for FlatGeobuf output. Tiles are independent of each
+ * other, so they are written by up to "opts->threads" parallel threads.
+ */
+
+
+/*
+ * Appends "value" to "buf" as a Protocol Buffers varint.
+ */
+void export_pb_varint ( export_buf *buf, unsigned long long value )
+{
+	char bytes[10];
+	size_t len = 0;
+
+	while ( value > 0x7F ) {
+		bytes[len++] = (char) ( ( value & 0x7F ) | 0x80 );
+		value >>= 7;
+	}
+	bytes[len++] = (char) value;
+	export_buf_write ( buf, bytes, len );
+}
+
+
+/*
+ * Appends the key (field number and wire type) of a field to "buf".
+ */
+void export_pb_key ( export_buf *buf, int field, int wire_type )
+{
+	export_pb_varint ( buf, ( (unsigned long long) field << 3 ) | wire_type );
+}
+
+
+/*
+ * Appends a length-delimited field (string, message or packed
+ * repeated field) with contents "data" to "buf".
+ */
+void export_pb_bytes ( export_buf *buf, int field, const char *data, size_t len )
+{
+	export_pb_key ( buf, field, EXPORT_PB_BYTES );
+	export_pb_varint ( buf, len );
+	export_buf_write ( buf, data, len );
+}
+
+
+/*
+ * Returns the ZigZag encoding of a signed integer, as used for
+ * "sint" fields and for the parameters of geometry commands.
+ */
+unsigned int export_pb_zigzag ( int value )
+{
+	return ( ( (unsigned int) value << 1 ) ^ ( value < 0 ? 0xFFFFFFFFu : 0u ) );
+}
+
+
+/*
+ * Reads a number of "len" bytes, stored in little endian byte order,
+ * from "src". This is the reverse of export_fb_encode().
+ */
+unsigned long long export_MVT_decode ( const unsigned char *src, size_t len )
+{
+	unsigned long long value = 0;
+
+	while ( len > 0 ) {
+		len --;
+		value = ( value << 8 ) | src[len];
+	}
+
+	return ( value );
+}
+
+
+/*
+ * Converts a coordinate pair of the output data, which are either
+ * Web Mercator meters ("web" = TRUE) or lon/lat degrees, to normalised
+ * Web Mercator coordinates "wx", "wy" (0.0 to 1.0, from the top left
+ * corner of the world). Latitudes beyond the poles of the Web Mercator
+ * map are clamped.
+ */
+void export_MVT_normalise ( double X, double Y, BOOLEAN web, double *wx, double *wy )
+{
+	double lat;
+
+	if ( web == TRUE ) {
+		*wx = ( X + EXPORT_MVT_HALF_WORLD ) / ( 2.0 * EXPORT_MVT_HALF_WORLD );
+		*wy = ( EXPORT_MVT_HALF_WORLD - Y ) / ( 2.0 * EXPORT_MVT_HALF_WORLD );
+	} else {
+		lat = Y;
+		if ( lat > EXPORT_MVT_MAX_LAT ) lat = EXPORT_MVT_MAX_LAT;
+		if ( lat < -EXPORT_MVT_MAX_LAT ) lat = -EXPORT_MVT_MAX_LAT;
+		lat = lat * REPROJ_PI / 180.0;
+		*wx = ( X + 180.0 ) / 360.0;
+		*wy = ( 1.0 - log ( tan ( lat ) + 1.0 / cos ( lat ) ) / REPROJ_PI ) / 2.0;
+	}
+
+	if ( *wx < 0.0 ) *wx = 0.0;
+	if ( *wx > 1.0 ) *wx = 1.0;
+	if ( *wy < 0.0 ) *wy = 0.0;
+	if ( *wy > 1.0 ) *wy = 1.0;
+}
+
+
+/*
+ * Helper function for export_MVT_make_items (below).
+ * Adds "num_vertices" vertices to "item", as a new part (lines),
+ * ring (polygons) or single point. The vertices are converted to
+ * normalised Web Mercator coordinates and the bounding box of
+ * "item" is extended to include them.
+ */
+void export_MVT_item_add ( export_MVT_item *item, double *X, double *Y, unsigned int num_vertices,
+		BOOLEAN outer, BOOLEAN web )
+{
+	int num = 0;
+	unsigned int k;
+
+
+	for ( k = 0; k < (unsigned int) item->num_rings; k ++ ) {
+		num += item->ring_len[k];
+	}
+	item->ring_len = realloc ( item->ring_len, sizeof (int) * ( item->num_rings + 1 ) );
+	item->ring_outer = realloc ( item->ring_outer, sizeof (BOOLEAN) * ( item->num_rings + 1 ) );
+	item->X = realloc ( item->X, sizeof (double) * ( num + num_vertices + 1 ) );
+	item->Y = realloc ( item->Y, sizeof (double) * ( num + num_vertices + 1 ) );
+	item->ring_len[item->num_rings] = num_vertices;
+	item->ring_outer[item->num_rings] = outer;
+	item->num_rings ++;
+
+	for ( k = 0; k < num_vertices; k ++ ) {
+		export_MVT_normalise ( X[k], Y[k], web, &item->X[num], &item->Y[num] );
+		if ( item->X[num] < item->x_min ) item->x_min = item->X[num];
+		if ( item->X[num] > item->x_max ) item->x_max = item->X[num];
+		if ( item->Y[num] < item->y_min ) item->y_min = item->Y[num];
+		if ( item->Y[num] > item->y_max ) item->y_max = item->Y[num];
+		num ++;
+	}
+}
+
+
+/*
+ * Creates a list of all selected geometries in "gs", in the same
+ * order (and with the same geom IDs) as in GeoJSON output, with all
+ * vertices converted to normalised Web Mercator coordinates.
+ * Polygon rings are stored as outer boundaries, each one followed
+ * by its holes.
+ *
+ * The number of list items is stored in "num_items".
+ *
+ * Returns the new list, which must be free'd by the caller,
+ * using export_MVT_free_items().
+ */
+export_MVT_item *export_MVT_make_items ( geom_store *gs, BOOLEAN web, int *num_items )
+{
+	export_MVT_item *items;
+	export_MVT_item *item;
+	geom_store_polygon *poly;
+	int num = 0;
+	unsigned int j, k;
+	int i;
+
+
+	items = malloc ( sizeof (export_MVT_item) *
+			( gs->num_polygons + gs->num_lines + gs->num_points + gs->num_points_raw + 1 ) );
+
+	for ( i = 0; i < gs->num_polygons + gs->num_lines + gs->num_points + gs->num_points_raw; i ++ ) {
+		int GEOM_TYPE = GEOM_TYPE_POLY;
+		int pk = i;
+		if ( pk >= gs->num_polygons ) {
+			GEOM_TYPE = GEOM_TYPE_LINE;
+			pk -= gs->num_polygons;
+			if ( pk >= gs->num_lines ) {
+				GEOM_TYPE = GEOM_TYPE_POINT;
+				pk -= gs->num_lines;
+				if ( pk >= gs->num_points ) {
+					GEOM_TYPE = GEOM_TYPE_POINT_RAW;
+					pk -= gs->num_points;
+				}
+			}
+		}
+		if ( ( GEOM_TYPE == GEOM_TYPE_POLY && gs->polygons[pk].is_selected == FALSE ) ||
+				( GEOM_TYPE == GEOM_TYPE_LINE && gs->lines[pk].is_selected == FALSE ) ||
+				( GEOM_TYPE == GEOM_TYPE_POINT && gs->points[pk].is_selected == FALSE ) ||
+				( GEOM_TYPE == GEOM_TYPE_POINT_RAW && gs->points_raw[pk].is_selected == FALSE ) ) {
+			continue;
+		}
+		item = &items[num];
+		item->GEOM_TYPE = GEOM_TYPE;
+		item->pk = pk;
+		item->geom_id = num;
+		item->x_min = item->y_min = DBL_MAX;
+		item->x_max = item->y_max = -DBL_MAX;
+		item->num_rings = 0;
+		item->ring_len = NULL;
+		item->ring_outer = NULL;
+		item->X = NULL;
+		item->Y = NULL;
+		item->props = 0;
+		item->props_len = 0;
+		if ( GEOM_TYPE == GEOM_TYPE_POLY ) {
+			poly = &gs->polygons[pk];
+			for ( j = 0; j < poly->num_parts; j ++ ) {
+				if ( poly->parts[j].is_hole == FALSE ) {
+					/* outer boundary, followed by its holes */
+					export_MVT_item_add ( item, poly->parts[j].X, poly->parts[j].Y,
+							poly->parts[j].num_vertices, TRUE, web );
+					for ( k = 0; k < poly->num_parts; k ++ ) {
+						if ( poly->parts[k].is_hole == TRUE && export_FGB_hole_in_part ( gs, pk, k, j ) == TRUE ) {
+							export_MVT_item_add ( item, poly->parts[k].X, poly->parts[k].Y,
+									poly->parts[k].num_vertices, FALSE, web );
+						}
+					}
+				}
+			}
+		}
+		if ( GEOM_TYPE == GEOM_TYPE_LINE ) {
+			for ( j = 0; j < gs->lines[pk].num_parts; j ++ ) {
+				export_MVT_item_add ( item, gs->lines[pk].parts[j].X, gs->lines[pk].parts[j].Y,
+						gs->lines[pk].parts[j].num_vertices, TRUE, web );
+			}
+		}
+		if ( GEOM_TYPE == GEOM_TYPE_POINT ) {
+			export_MVT_item_add ( item, &gs->points[pk].X, &gs->points[pk].Y, 1, TRUE, web );
+		}
+		if ( GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+			export_MVT_item_add ( item, &gs->points_raw[pk].X, &gs->points_raw[pk].Y, 1, TRUE, web );
+		}
+		num ++;
+	}
+
+	*num_items = num;
+
+	return ( items );
+}
+
+
+/*
+ * Releases all memory held by a list of "num_items" items
+ * created by export_MVT_make_items().
+ */
+void export_MVT_free_items ( export_MVT_item *items, int num_items )
+{
+	int i;
+
+	for ( i = 0; i < num_items; i ++ ) {
+		free ( items[i].ring_len );
+		free ( items[i].ring_outer );
+		free ( items[i].X );
+		free ( items[i].Y );
+	}
+	free ( items );
+}
+
+
+/*
+ * Sorting function for tile entries: by tile, then by feature.
+ */
+int export_MVT_compare_entries ( const void *a, const void *b )
+{
+	const export_MVT_entry *A = (const export_MVT_entry*) a;
+	const export_MVT_entry *B = (const export_MVT_entry*) b;
+
+	if ( A->tile != B->tile ) {
+		return ( A->tile < B->tile ? -1 : 1 );
+	}
+	if ( A->item != B->item ) {
+		return ( A->item < B->item ? -1 : 1 );
+	}
+
+	return ( 0 );
+}
+
+
+/*
+ * Returns the index of the tile (column or row) that contains the
+ * normalised coordinate "w" at a zoom level with "n" tiles per side.
+ */
+unsigned int export_MVT_tile_index ( double w, double n )
+{
+	double t = floor ( w * n );
+
+	if ( t < 0.0 ) {
+		return ( 0 );
+	}
+	if ( t > n - 1.0 ) {
+		return ( (unsigned int) ( n - 1.0 ) );
+	}
+
+	return ( (unsigned int) t );
+}
+
+
+/*
+ * Creates a list of entries for all tiles of zoom level "z" and
+ * all features in "items" that overlap them (including the tile
+ * buffer), sorted by tile and feature.
+ *
+ * The number of list entries is stored in "num_entries".
+ *
+ * Returns the new list, which must be free'd by the caller.
+ */
+export_MVT_entry *export_MVT_make_entries ( const export_MVT_item *items, int num_items, int z,
+		int *num_entries )
+{
+	export_MVT_entry *entries;
+	double n = ldexp ( 1.0, z );
+	double buffer = (double) EXPORT_MVT_BUFFER / ( (double) EXPORT_MVT_EXTENT * n );
+	unsigned int x, y, x_min, y_min, x_max, y_max;
+	int max = num_items + 1;
+	int num = 0;
+	int i;
+
+
+	entries = malloc ( sizeof (export_MVT_entry) * max );
+
+	for ( i = 0; i < num_items; i ++ ) {
+		if ( items[i].num_rings < 1 || items[i].x_min > items[i].x_max ) {
+			continue;
+		}
+		x_min = export_MVT_tile_index ( items[i].x_min - buffer, n );
+		x_max = export_MVT_tile_index ( items[i].x_max + buffer, n );
+		y_min = export_MVT_tile_index ( items[i].y_min - buffer, n );
+		y_max = export_MVT_tile_index ( items[i].y_max + buffer, n );
+		for ( x = x_min; x <= x_max; x ++ ) {
+			for ( y = y_min; y <= y_max; y ++ ) {
+				if ( num >= max ) {
+					max *= 2;
+					entries = realloc ( entries, sizeof (export_MVT_entry) * max );
+				}
+				entries[num].tile = ( (unsigned long long) x << 32 ) | y;
+				entries[num].item = i;
+				num ++;
+			}
+		}
+	}
+
+	qsort ( entries, num, sizeof (export_MVT_entry), export_MVT_compare_entries );
+
+	*num_entries = num;
+
+	return ( entries );
+}
+
+
+/*
+ * Appends a vertex to a list of vertices.
+ */
+void export_MVT_points_add ( export_MVT_points *pts, double X, double Y )
+{
+	if ( pts->num >= pts->max ) {
+		pts->max = pts->max * 2 + 16;
+		pts->X = realloc ( pts->X, sizeof (double) * pts->max );
+		pts->Y = realloc ( pts->Y, sizeof (double) * pts->max );
+	}
+	pts->X[pts->num] = X;
+	pts->Y[pts->num] = Y;
+	pts->num ++;
+}
+
+
+/*
+ * Clips the closed ring "in" against one boundary of the tile
+ * (Sutherland-Hodgman) and stores the result in "out".
+ * "axis" selects the coordinate (0 = X, 1 = Y), "limit" the
+ * boundary and "upper" whether this is the upper boundary.
+ */
+void export_MVT_clip_ring ( export_MVT_points *in, export_MVT_points *out, int axis, double limit, BOOLEAN upper )
+{
+	double *A, *B;
+	double t;
+	BOOLEAN inside, prev_inside;
+	int i, prev;
+
+
+	out->num = 0;
+	if ( in->num < 1 ) {
+		return;
+	}
+	A = axis == 0 ? in->X : in->Y;
+	B = axis == 0 ? in->Y : in->X;
+
+	prev = in->num - 1;
+	prev_inside = upper == TRUE ? A[prev] <= limit : A[prev] >= limit;
+	for ( i = 0; i < in->num; i ++ ) {
+		inside = upper == TRUE ? A[i] <= limit : A[i] >= limit;
+		if ( inside != prev_inside ) {
+			/* edge crosses boundary: add intersection */
+			t = ( limit - A[prev] ) / ( A[i] - A[prev] );
+			if ( axis == 0 ) {
+				export_MVT_points_add ( out, limit, B[prev] + t * ( B[i] - B[prev] ) );
+			} else {
+				export_MVT_points_add ( out, B[prev] + t * ( B[i] - B[prev] ), limit );
+			}
+		}
+		if ( inside == TRUE ) {
+			export_MVT_points_add ( out, in->X[i], in->Y[i] );
+		}
+		prev = i;
+		prev_inside = inside;
+	}
+}
+
+
+/*
+ * Clips the line segment from "x0", "y0" to "x1", "y1" against the
+ * square from "lo" to "hi" (Liang-Barsky). The parameters of the
+ * clipped end points along the segment (0.0 to 1.0) are stored in
+ * "t0" and "t1".
+ *
+ * Returns FALSE if the segment lies completely outside of the square.
+ */
+BOOLEAN export_MVT_clip_segment ( double x0, double y0, double x1, double y1, double lo, double hi,
+		double *t0, double *t1 )
+{
+	double p[4], q[4];
+	double r;
+	int i;
+
+
+	p[0] = x0 - x1; q[0] = x0 - lo;
+	p[1] = x1 - x0; q[1] = hi - x0;
+	p[2] = y0 - y1; q[2] = y0 - lo;
+	p[3] = y1 - y0; q[3] = hi - y0;
+	*t0 = 0.0;
+	*t1 = 1.0;
+	for ( i = 0; i < 4; i ++ ) {
+		if ( p[i] == 0.0 ) {
+			if ( q[i] < 0.0 ) {
+				return ( FALSE );
+			}
+		} else {
+			r = q[i] / p[i];
+			if ( p[i] < 0.0 ) {
+				if ( r > *t1 ) return ( FALSE );
+				if ( r > *t0 ) *t0 = r;
+			} else {
+				if ( r < *t0 ) return ( FALSE );
+				if ( r < *t1 ) *t1 = r;
+			}
+		}
+	}
+
+	return ( TRUE );
+}
+
+
+/*
+ * Appends the geometry commands for one line part (closed = FALSE)
+ * or polygon ring (closed = TRUE) to "geom". Vertices are rounded to
+ * integer tile coordinates first, and repeated vertices are dropped.
+ * Outer rings are written with positive, holes ("outer" = FALSE) with
+ * negative area, as required by the MVT specification. The cursor
+ * position "cx", "cy" is updated.
+ *
+ * Returns FALSE if nothing was written, because the part degenerated
+ * to a single vertex or the ring to zero area.
+ */
+BOOLEAN export_MVT_put_path ( export_buf *geom, export_MVT_points *pts, BOOLEAN closed, BOOLEAN outer,
+		int *cx, int *cy )
+{
+	double area = 0.0;
+	int num = 0;
+	int i, j;
+
+
+	for ( i = 0; i < pts->num; i ++ ) {
+		double X = floor ( pts->X[i] + 0.5 );
+		double Y = floor ( pts->Y[i] + 0.5 );
+		if ( num == 0 || X != pts->X[num-1] || Y != pts->Y[num-1] ) {
+			pts->X[num] = X;
+			pts->Y[num] = Y;
+			num ++;
+		}
+	}
+	if ( closed == TRUE ) {
+		while ( num > 1 && pts->X[num-1] == pts->X[0] && pts->Y[num-1] == pts->Y[0] ) {
+			num --;
+		}
+		if ( num < 3 ) {
+			return ( FALSE );
+		}
+		for ( i = 0; i < num; i ++ ) {
+			j = ( i + 1 ) % num;
+			area += pts->X[i] * pts->Y[j] - pts->X[j] * pts->Y[i];
+		}
+		if ( area == 0.0 ) {
+			return ( FALSE );
+		}
+		if ( ( outer == TRUE && area < 0.0 ) || ( outer == FALSE && area > 0.0 ) ) {
+			/* reverse orientation */
+			for ( i = 0, j = num - 1; i < j; i ++, j -- ) {
+				double tmp = pts->X[i]; pts->X[i] = pts->X[j]; pts->X[j] = tmp;
+				tmp = pts->Y[i]; pts->Y[i] = pts->Y[j]; pts->Y[j] = tmp;
+			}
+		}
+	} else if ( num < 2 ) {
+		return ( FALSE );
+	}
+
+	for ( i = 0; i < num; i ++ ) {
+		int X = (int) pts->X[i];
+		int Y = (int) pts->Y[i];
+		if ( i == 0 ) {
+			/* MoveTo, one vertex */
+			export_pb_varint ( geom, ( 1 << 3 ) | 1 );
+		}
+		if ( i == 1 ) {
+			/* LineTo, all other vertices */
+			export_pb_varint ( geom, ( (unsigned int) ( num - 1 ) << 3 ) | 2 );
+		}
+		export_pb_varint ( geom, export_pb_zigzag ( X - *cx ) );
+		export_pb_varint ( geom, export_pb_zigzag ( Y - *cy ) );
+		*cx = X;
+		*cy = Y;
+	}
+	if ( closed == TRUE ) {
+		/* ClosePath */
+		export_pb_varint ( geom, ( 1 << 3 ) | 7 );
+	}
+
+	return ( TRUE );
+}
+
+
+/*
+ * Encodes the geometry of "item" for tile "x", "y" of zoom level "z"
+ * into "geom" (which is cleared first), as a sequence of geometry
+ * commands, clipped to the tile (including its buffer).
+ * "a" and "b" are used as scratch buffers.
+ *
+ * Returns the MVT geometry type or 0 if nothing of the feature is
+ * left inside the tile.
+ */
+int export_MVT_make_geometry ( export_buf *geom, const export_MVT_item *item, int z, unsigned int x, unsigned int y,
+		export_MVT_points *a, export_MVT_points *b )
+{
+	double scale = ldexp ( (double) EXPORT_MVT_EXTENT, z );
+	double ox = (double) x * EXPORT_MVT_EXTENT;
+	double oy = (double) y * EXPORT_MVT_EXTENT;
+	double lo = -EXPORT_MVT_BUFFER;
+	double hi = EXPORT_MVT_EXTENT + EXPORT_MVT_BUFFER;
+	double t0, t1;
+	BOOLEAN outer_ok = FALSE;
+	BOOLEAN open;
+	int cx = 0;
+	int cy = 0;
+	int first = 0;
+	int r, k;
+
+
+	geom->len = 0;
+
+	if ( item->GEOM_TYPE == GEOM_TYPE_POINT || item->GEOM_TYPE == GEOM_TYPE_POINT_RAW ) {
+		double X = floor ( item->X[0] * scale - ox + 0.5 );
+		double Y = floor ( item->Y[0] * scale - oy + 0.5 );
+		if ( X < lo || X > hi || Y < lo || Y > hi ) {
+			return ( 0 );
+		}
+		/* MoveTo, one vertex */
+		export_pb_varint ( geom, ( 1 << 3 ) | 1 );
+		export_pb_varint ( geom, export_pb_zigzag ( (int) X ) );
+		export_pb_varint ( geom, export_pb_zigzag ( (int) Y ) );
+		return ( EXPORT_MVT_GEOM_POINT );
+	}
+
+	for ( r = 0; r < item->num_rings; r ++ ) {
+		const double *X = &item->X[first];
+		const double *Y = &item->Y[first];
+		int len = item->ring_len[r];
+		first += len;
+		if ( item->GEOM_TYPE == GEOM_TYPE_LINE ) {
+			/* clip each segment, start a new part wherever the line leaves the tile */
+			a->num = 0;
+			open = FALSE;
+			for ( k = 0; k + 1 < len; k ++ ) {
+				double x0 = X[k] * scale - ox;
+				double y0 = Y[k] * scale - oy;
+				double x1 = X[k+1] * scale - ox;
+				double y1 = Y[k+1] * scale - oy;
+				if ( export_MVT_clip_segment ( x0, y0, x1, y1, lo, hi, &t0, &t1 ) == FALSE ) {
+					if ( open == TRUE ) {
+						export_MVT_put_path ( geom, a, FALSE, TRUE, &cx, &cy );
+						a->num = 0;
+						open = FALSE;
+					}
+					continue;
+				}
+				if ( open == FALSE || t0 > 0.0 ) {
+					if ( open == TRUE ) {
+						export_MVT_put_path ( geom, a, FALSE, TRUE, &cx, &cy );
+						a->num = 0;
+					}
+					export_MVT_points_add ( a, x0 + t0 * ( x1 - x0 ), y0 + t0 * ( y1 - y0 ) );
+					open = TRUE;
+				}
+				export_MVT_points_add ( a, x0 + t1 * ( x1 - x0 ), y0 + t1 * ( y1 - y0 ) );
+				if ( t1 < 1.0 ) {
+					export_MVT_put_path ( geom, a, FALSE, TRUE, &cx, &cy );
+					a->num = 0;
+					open = FALSE;
+				}
+			}
+			if ( open == TRUE ) {
+				export_MVT_put_path ( geom, a, FALSE, TRUE, &cx, &cy );
+			}
+		}
+		if ( item->GEOM_TYPE == GEOM_TYPE_POLY ) {
+			/* holes of an outer ring that has been dropped are dropped, too */
+			if ( item->ring_outer[r] == FALSE && outer_ok == FALSE ) {
+				continue;
+			}
+			a->num = 0;
+			for ( k = 0; k < len; k ++ ) {
+				export_MVT_points_add ( a, X[k] * scale - ox, Y[k] * scale - oy );
+			}
+			export_MVT_clip_ring ( a, b, 0, lo, FALSE );
+			export_MVT_clip_ring ( b, a, 0, hi, TRUE );
+			export_MVT_clip_ring ( a, b, 1, lo, FALSE );
+			export_MVT_clip_ring ( b, a, 1, hi, TRUE );
+			if ( export_MVT_put_path ( geom, a, TRUE, item->ring_outer[r], &cx, &cy ) == FALSE ) {
+				if ( item->ring_outer[r] == TRUE ) {
+					outer_ok = FALSE;
+				}
+			} else if ( item->ring_outer[r] == TRUE ) {
+				outer_ok = TRUE;
+			}
+		}
+	}
+
+	if ( geom->len < 1 ) {
+		return ( 0 );
+	}
+
+	return ( item->GEOM_TYPE == GEOM_TYPE_LINE ? EXPORT_MVT_GEOM_LINESTRING : EXPORT_MVT_GEOM_POLYGON );
+}
+
+
+/*
+ * Returns the index of "value" (an encoded "Value" message) in the
+ * value table "vt" of a layer, adding it if it is not there yet.
+ */
+int export_MVT_value_index ( export_MVT_values *vt, const char *value, size_t len )
+{
+	unsigned int hash = 2166136261u;
+	unsigned int slot;
+	size_t i;
+	int j;
+
+
+	/* grow hash table, to keep it at most half full */
+	if ( ( vt->num + 1 ) * 2 > vt->hash_size ) {
+		vt->hash_size = vt->hash_size < 64 ? 64 : vt->hash_size * 2;
+		vt->hash = realloc ( vt->hash, sizeof (int) * vt->hash_size );
+		for ( j = 0; j < vt->hash_size; j ++ ) {
+			vt->hash[j] = 0;
+		}
+		for ( j = 0; j < vt->num; j ++ ) {
+			unsigned int h = 2166136261u;
+			for ( i = 0; i < vt->len[j]; i ++ ) {
+				h = ( h ^ (unsigned char) vt->data->data[vt->offset[j] + i] ) * 16777619u;
+			}
+			slot = h & ( vt->hash_size - 1 );
+			while ( vt->hash[slot] != 0 ) {
+				slot = ( slot + 1 ) & ( vt->hash_size - 1 );
+			}
+			vt->hash[slot] = j + 1;
+		}
+	}
+
+	/* FNV-1a */
+	for ( i = 0; i < len; i ++ ) {
+		hash = ( hash ^ (unsigned char) value[i] ) * 16777619u;
+	}
+	slot = hash & ( vt->hash_size - 1 );
+	while ( vt->hash[slot] != 0 ) {
+		j = vt->hash[slot] - 1;
+		if ( vt->len[j] == len && memcmp ( vt->data->data + vt->offset[j], value, len ) == 0 ) {
+			return ( j );
+		}
+		slot = ( slot + 1 ) & ( vt->hash_size - 1 );
+	}
+
+	if ( vt->num >= vt->max ) {
+		vt->max = vt->max * 2 + 16;
+		vt->offset = realloc ( vt->offset, sizeof (size_t) * vt->max );
+		vt->len = realloc ( vt->len, sizeof (size_t) * vt->max );
+	}
+	vt->offset[vt->num] = vt->data->len;
+	vt->len[vt->num] = len;
+	export_buf_write ( vt->data, value, len );
+	vt->hash[slot] = vt->num + 1;
+	vt->num ++;
+
+	return ( vt->num - 1 );
+}
+
+
+/*
+ * Converts the encoded properties of one feature (see
+ * export_FGB_write_properties()) to MVT "Value" messages
+ * and appends their key and value indices to "tags".
+ */
+void export_MVT_make_tags ( export_buf *tags, export_buf *value, export_MVT_values *vt,
+		const unsigned char *props, size_t len, const unsigned char *types )
+{
+	size_t pos = 0;
+	unsigned int col;
+	size_t str_len;
+
+
+	tags->len = 0;
+	while ( pos + 2 <= len ) {
+		col = (unsigned int) export_MVT_decode ( props + pos, 2 );
+		pos += 2;
+		value->len = 0;
+		if ( types[col] == EXPORT_FGB_COL_INT ) {
+			/* sint_value (6) */
+			export_pb_key ( value, 6, EXPORT_PB_VARINT );
+			export_pb_varint ( value, export_pb_zigzag ( (int) (unsigned int) export_MVT_decode ( props + pos, 4 ) ) );
+			pos += 4;
+		} else if ( types[col] == EXPORT_FGB_COL_DOUBLE ) {
+			/* double_value (3): same byte order as in FlatGeobuf */
+			export_pb_key ( value, 3, EXPORT_PB_FIXED64 );
+			export_buf_write ( value, (const char*) props + pos, 8 );
+			pos += 8;
+		} else {
+			/* string_value (1) */
+			str_len = (size_t) export_MVT_decode ( props + pos, 4 );
+			export_pb_bytes ( value, 1, (const char*) props + pos + 4, str_len );
+			pos += 4 + str_len;
+		}
+		export_pb_varint ( tags, col );
+		export_pb_varint ( tags, export_MVT_value_index ( vt, value->data, value->len ) );
+	}
+}
+
+
+/*
+ * Thread function for export_MVT() (below): encodes and writes one
+ * tile, with one layer for each geometry type that has at least one
+ * feature in it. Empty tiles are not written.
+ * All messages are kept in the job's queue, until all tiles of the
+ * same zoom level have been written.
+ */
+void *export_MVT_write_tile ( void *arg )
+{
+	export_MVT_job *job = (export_MVT_job*) arg;
+	export_buf *tile, *layer, *feature, *geom, *tags, *value;
+	export_MVT_points a, b;
+	export_MVT_values vt;
+	char *path;
+	FILE *fp;
+	int GEOM_TYPE;
+	int type;
+	int i;
+	err_queue *previous;
+
+
+	previous = err_queue_attach ( &job->messages );
+
+	tile = export_buf_create ( NULL );
+	layer = export_buf_create ( NULL );
+	feature = export_buf_create ( NULL );
+	geom = export_buf_create ( NULL );
+	tags = export_buf_create ( NULL );
+	value = export_buf_create ( NULL );
+	a.X = a.Y = b.X = b.Y = NULL;
+	a.num = a.max = b.num = b.max = 0;
+	vt.data = export_buf_create ( NULL );
+	vt.offset = vt.len = NULL;
+	vt.hash = NULL;
+	vt.max = vt.hash_size = 0;
+
+	for ( GEOM_TYPE = GEOM_TYPE_POINT; GEOM_TYPE <= GEOM_TYPE_POINT_RAW; GEOM_TYPE ++ ) {
+		layer->len = 0;
+		vt.data->len = 0;
+		vt.num = 0;
+		for ( i = 0; i < vt.hash_size; i ++ ) {
+			vt.hash[i] = 0;
+		}
+		/* features (2) */
+		for ( i = 0; i < job->num_entries; i ++ ) {
+			const export_MVT_item *item = &job->items[job->entries[i].item];
+			if ( item->GEOM_TYPE != GEOM_TYPE ) {
+				continue;
+			}
+			type = export_MVT_make_geometry ( geom, item, job->z, job->x, job->y, &a, &b );
+			if ( type == 0 ) {
+				continue;
+			}
+			export_MVT_make_tags ( tags, value, &vt, (const unsigned char*) job->props->data + item->props,
+					item->props_len, job->types );
+			/* message "Feature": id (1), tags (2), type (3), geometry (4) */
+			feature->len = 0;
+			export_pb_key ( feature, 1, EXPORT_PB_VARINT );
+			export_pb_varint ( feature, item->geom_id );
+			export_pb_bytes ( feature, 2, tags->data, tags->len );
+			export_pb_key ( feature, 3, EXPORT_PB_VARINT );
+			export_pb_varint ( feature, type );
+			export_pb_bytes ( feature, 4, geom->data, geom->len );
+			export_pb_bytes ( layer, 2, feature->data, feature->len );
+		}
+		if ( layer->len < 1 ) {
+			continue;
+		}
+		/* message "Layer": version (15), name (1), keys (3), values (4), extent (5) */
+		export_pb_key ( layer, 15, EXPORT_PB_VARINT );
+		export_pb_varint ( layer, 2 );
+		export_pb_bytes ( layer, 1, EXPORT_MVT_LAYER_NAMES[GEOM_TYPE], strlen ( EXPORT_MVT_LAYER_NAMES[GEOM_TYPE] ) );
+		for ( i = 0; i < job->num_keys; i ++ ) {
+			export_pb_bytes ( layer, 3, job->keys[i], strlen ( job->keys[i] ) );
+		}
+		for ( i = 0; i < vt.num; i ++ ) {
+			export_pb_bytes ( layer, 4, vt.data->data + vt.offset[i], vt.len[i] );
+		}
+		export_pb_key ( layer, 5, EXPORT_PB_VARINT );
+		export_pb_varint ( layer, EXPORT_MVT_EXTENT );
+		/* message "Tile": layers (3) */
+		export_pb_bytes ( tile, 3, layer->data, layer->len );
+	}
+
+	if ( tile->len > 0 ) {
+		path = malloc ( sizeof (char) * ( strlen ( job->path ) + 64 ) );
+		sprintf ( path, "%s%c%i%c%u%c%u.mvt", job->path, PRG_FILE_SEPARATOR, job->z,
+				PRG_FILE_SEPARATOR, job->x, PRG_FILE_SEPARATOR, job->y );
+		fp = t_fopen_utf8 ( path, "wb" );
+		if ( fp == NULL || fwrite ( tile->data, sizeof (char), tile->len, fp ) != tile->len ) {
+			err_show (ERR_NOTE,"");
+			err_show (ERR_WARN, _("\nFailed to write vector tile\n(%s)."), path );
+		} else {
+			job->written = TRUE;
+		}
+		if ( fp != NULL ) {
+			fclose ( fp );
+		}
+		free ( path );
+	}
+
+	export_buf_close ( tile );
+	export_buf_close ( layer );
+	export_buf_close ( feature );
+	export_buf_close ( geom );
+	export_buf_close ( tags );
+	export_buf_close ( value );
+	export_buf_close ( vt.data );
+	free ( vt.offset );
+	free ( vt.len );
+	free ( vt.hash );
+	free ( a.X );
+	free ( a.Y );
+	free ( b.X );
+	free ( b.Y );
+
+	err_queue_attach ( previous );
+
+	return ( NULL );
+}
+
+
+/*
+ * Writes a TileJSON description of the tile set into the file
+ * "metadata.json" in the tile pyramid root directory "path".
+ * "extent" is the extent of all features in normalised
+ * coordinates (min. X, min. Y, max. X, max. Y).
+ */
+void export_MVT_write_metadata ( const char *path, const export_MVT_item *items, int num_items,
+		const double *extent, const char **keys, const unsigned char *types, int num_keys, options *opts )
+{
+	export_buf *fp;
+	char *file;
+	double bounds[4];
+	BOOLEAN first_layer = TRUE;
+	int GEOM_TYPE;
+	int i;
+
+
+	file = malloc ( sizeof (char) * ( strlen ( path ) + 16 ) );
+	sprintf ( file, "%s%cmetadata.json", path, PRG_FILE_SEPARATOR );
+
+	/* bounds in lon/lat: west, south, east, north */
+	bounds[0] = extent[0] * 360.0 - 180.0;
+	bounds[1] = atan ( sinh ( REPROJ_PI * ( 1.0 - 2.0 * extent[3] ) ) ) * 180.0 / REPROJ_PI;
+	bounds[2] = extent[2] * 360.0 - 180.0;
+	bounds[3] = atan ( sinh ( REPROJ_PI * ( 1.0 - 2.0 * extent[1] ) ) ) * 180.0 / REPROJ_PI;
+
+	fp = export_buf_open ( file );
+	if ( fp == NULL ) {
+		free ( file );
+		return;
+	}
+	export_buf_puts ( fp, "{\n" );
+	export_buf_puts ( fp, "  \"tilejson\": \"3.0.0\",\n" );
+	export_buf_printf ( fp, "  \"name\": \"%s\",\n", opts->base );
+	export_buf_puts ( fp, "  \"tiles\": [\"{z}/{x}/{y}.mvt\"],\n" );
+	export_buf_printf ( fp, "  \"minzoom\": %i,\n", opts->min_zoom );
+	export_buf_printf ( fp, "  \"maxzoom\": %i,\n", opts->max_zoom );
+	export_buf_puts ( fp, "  \"bounds\": [" );
+	for ( i = 0; i < 4; i ++ ) {
+		export_buf_put_float ( fp, bounds[i] );
+		export_buf_puts ( fp, i < 3 ? ", " : "],\n" );
+	}
+	export_buf_puts ( fp, "  \"center\": [" );
+	export_buf_put_float ( fp, ( bounds[0] + bounds[2] ) / 2.0 );
+	export_buf_puts ( fp, ", " );
+	export_buf_put_float ( fp, ( bounds[1] + bounds[3] ) / 2.0 );
+	export_buf_printf ( fp, ", %i],\n", opts->min_zoom );
+	export_buf_puts ( fp, "  \"vector_layers\": [" );
+	for ( GEOM_TYPE = GEOM_TYPE_POINT; GEOM_TYPE <= GEOM_TYPE_POINT_RAW; GEOM_TYPE ++ ) {
+		for ( i = 0; i < num_items; i ++ ) {
+			if ( items[i].GEOM_TYPE == GEOM_TYPE ) {
+				break;
+			}
+		}
+		if ( i >= num_items ) {
+			continue;
+		}
+		export_buf_printf ( fp, "%s\n    { \"id\": \"%s\", \"minzoom\": %i, \"maxzoom\": %i, \"fields\": {",
+				first_layer == TRUE ? "" : ",", EXPORT_MVT_LAYER_NAMES[GEOM_TYPE], opts->min_zoom, opts->max_zoom );
+		for ( i = 0; i < num_keys; i ++ ) {
+			export_buf_printf ( fp, "%s \"%s\": \"%s\"", i > 0 ? "," : "", keys[i],
+					types[i] == EXPORT_FGB_COL_STRING ? "String" : "Number" );
+		}
+		export_buf_puts ( fp, " } }" );
+		first_layer = FALSE;
+	}
+	export_buf_puts ( fp, "\n  ]\n}\n" );
+
+	if ( export_buf_close ( fp ) != 0 ) {
 		err_show (ERR_NOTE,"");
-		err_show (ERR_WARN, _("\nLabel mode for all geometries set to '%s'.\nLabel layer will be empty."),
-				OPTIONS_LABEL_MODE_NAMES[OPTIONS_LABEL_MODE_NONE]);
+		err_show (ERR_WARN, _("\nFailed to write vector tile metadata\n(%s)."), file );
 	}
+	free ( file );
+}
 
-	/* CREATE .GVA FILE FOR LABEL POINTS (OPTIONAL) */
-	if ( opts->label_field != NULL && gs->path_labels_gva != NULL ) {
-		int error = export_SHP_make_labels_GVA (gs->path_labels_gva);
-		if ( error < 0 ) {
-			err_show (ERR_NOTE,"");
-			err_show (ERR_WARN, _("\nFailed to create annotation settings file ('%s')."), gs->path_labels_gva);
-		}
-	}
 
-	/* CLOSE ALL OUTPUT FILES */
+/*
+ * Writes geometry store objects into a pyramid of Mapbox Vector Tiles,
+ * for all zoom levels from "opts->min_zoom" to "opts->max_zoom".
+ * Each tile has one layer per geometry type; all layers share the
+ * same set of attributes as in FlatGeobuf output.
+ *
+ * The output data must be either lat/lon or Web Mercator coordinates.
+ * The caller must check this.
+ *
+ * By the time this function is called, "gs" must be a valid geometry
+ * store and must contain only fully checked and built, valid geometries,
+ * ready to be written to disk. The tile pyramid root directory
+ * ("gs->path_all") must exist.
+ *
+ * Returns number of attribute field errors.
+ */
+int export_MVT ( geom_store *gs, parser_desc *parser, options *opts )
+{
+	export_MVT_item *items;
+	export_MVT_entry *entries;
+	export_MVT_job *jobs;
+	export_FGB_item fgb_item;
+	export_buf *props;
+	export_buf *scratch;
+	const char *keys[PRG_MAX_FIELDS + 9];
+	unsigned char types[PRG_MAX_FIELDS + 9];
+	char *dir;
+	double extent[4];
+	unsigned int x, prev_x;
+	int num_items, num_entries, num_jobs, num_keys;
+	int num_tiles = 0;
+	int num_errors = 0;
+	int z;
+	int i;
+
 
-	/* Points */
-	if ( selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ) {
-		SHPClose ( points );
-		DBFClose ( points_atts );
-	}
-	/* Raw points */
-	if ( selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ) > 0 ) {
-		SHPClose ( points_raw );
-		DBFClose ( points_raw_atts );
-	}
-	/* Lines */
-	if ( selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ) {
-		SHPClose ( lines );
-		DBFClose ( lines_atts );
+	/* Check if there is anything to export! */
+	if ( gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons < 1 )  {
+		err_show (ERR_NOTE,"");
+		err_show (ERR_WARN, _("\nNo valid geometries found. No output produced."));
+		return ( 0 );
 	}
-	/* Polygons */
-	if ( selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0 ) {
-		SHPClose ( polygons );
-		DBFClose ( polygons_atts );
+
+	items = export_MVT_make_items ( gs, reproj_srs_out_web ( opts ), &num_items );
+	num_keys = export_FGB_get_columns ( parser, opts, keys, types );
+
+	/* Encode all attributes in advance, as in FlatGeobuf output,
+	   so that warnings appear only once and in feature order. */
+	props = export_buf_create ( NULL );
+	scratch = export_buf_create ( NULL );
+	extent[0] = extent[1] = DBL_MAX;
+	extent[2] = extent[3] = -DBL_MAX;
+	for ( i = 0; i < num_items; i ++ ) {
+		fgb_item.GEOM_TYPE = items[i].GEOM_TYPE;
+		fgb_item.pk = items[i].pk;
+		fgb_item.geom_id = items[i].geom_id;
+		num_errors += export_FGB_write_properties ( scratch, gs, &fgb_item, parser, opts );
+		items[i].props = props->len;
+		items[i].props_len = scratch->len;
+		export_buf_write ( props, scratch->data, scratch->len );
+		if ( items[i].num_rings > 0 ) {
+			if ( items[i].x_min < extent[0] ) extent[0] = items[i].x_min;
+			if ( items[i].y_min < extent[1] ) extent[1] = items[i].y_min;
+			if ( items[i].x_max > extent[2] ) extent[2] = items[i].x_max;
+			if ( items[i].y_max > extent[3] ) extent[3] = items[i].y_max;
+		}
 	}
-	/* Labels (points) */
-	if ( opts->label_field != NULL ) {
-		if ( 	selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ||
-				selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ||
-				selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0
-		)
-		{
-			SHPClose ( labels );
-			DBFClose ( labels_atts );
+	export_buf_close ( scratch );
+
+	dir = malloc ( sizeof (char) * ( strlen ( gs->path_all ) + 32 ) );
+	for ( z = opts->min_zoom; z <= opts->max_zoom; z ++ ) {
+		entries = export_MVT_make_entries ( items, num_items, z, &num_entries );
+		/* one job per tile */
+		jobs = malloc ( sizeof (export_MVT_job) * ( num_entries + 1 ) );
+		num_jobs = 0;
+		prev_x = 0;
+		for ( i = 0; i < num_entries; i ++ ) {
+			if ( i > 0 && entries[i].tile == entries[i-1].tile ) {
+				jobs[num_jobs-1].num_entries ++;
+				continue;
+			}
+			x = (unsigned int) ( entries[i].tile >> 32 );
+			/* create directories for zoom level and tile column */
+			if ( i == 0 ) {
+				sprintf ( dir, "%s%c%i", gs->path_all, PRG_FILE_SEPARATOR, z );
+				t_mkdir_utf8 ( dir );
+			}
+			if ( i == 0 || x != prev_x ) {
+				sprintf ( dir, "%s%c%i%c%u", gs->path_all, PRG_FILE_SEPARATOR, z, PRG_FILE_SEPARATOR, x );
+				if ( t_mkdir_utf8 ( dir ) != 0 ) {
+					err_show (ERR_NOTE,"");
+					err_show (ERR_WARN, _("\nFailed to create directory for vector tiles\n(%s)."), dir );
+				}
+				prev_x = x;
+			}
+			jobs[num_jobs].z = z;
+			jobs[num_jobs].x = x;
+			jobs[num_jobs].y = (unsigned int) ( entries[i].tile & 0xFFFFFFFF );
+			jobs[num_jobs].entries = &entries[i];
+			jobs[num_jobs].num_entries = 1;
+			jobs[num_jobs].items = items;
+			jobs[num_jobs].props = props;
+			jobs[num_jobs].keys = keys;
+			jobs[num_jobs].types = types;
+			jobs[num_jobs].num_keys = num_keys;
+			jobs[num_jobs].path = gs->path_all;
+			jobs[num_jobs].written = FALSE;
+			err_queue_init ( &jobs[num_jobs].messages );
+			num_jobs ++;
+		}
+		t_thread_run_pool ( export_MVT_write_tile, jobs, num_jobs, sizeof (export_MVT_job), opts->threads );
+		for ( i = 0; i < num_jobs; i ++ ) {
+			err_queue_flush ( &jobs[i].messages );
+			if ( jobs[i].written == TRUE ) {
+				num_tiles ++;
+			}
 		}
+		free ( jobs );
+		free ( entries );
+	}
+	free ( dir );
+
+	if ( num_items > 0 && extent[0] <= extent[2] ) {
+		export_MVT_write_metadata ( gs->path_all, items, num_items, extent, keys, types, num_keys, opts );
 	}
+	err_show (ERR_NOTE, _("\nWrote %i vector tiles into '%s'."), num_tiles, gs->path_all );
+
+	export_buf_close ( props );
+	export_MVT_free_items ( items, num_items );
 
 	return ( num_errors );
 }
@@ -3102,36 +6133,460 @@ int export_SHP ( geom_store *gs, parser_desc *parser, options *opts )
  * point numbers to text files (DXF, KML, GeoJSON) and need to
  * ensure that the number always use English number format and no
  * grouping characters.
- * 
- * Takes a floating point number and makes a new string from it
- * that can be written into the exported text file.
  *
- * Return value is _always_ a newly allocated char* that must be free'd
- * by the caller!
+ * Takes a floating point number and writes it into "dst", which
+ * must have room for at least EXPORT_FLOAT_STR_LEN chars.
+ * The number is written with EXPORT_TEXT_DECIMAL_PLACES decimal places,
+ * exactly as "%.6f" would in the "C" locale, except that "0" is
+ * written as "0".
+ *
+ * This is called for every single coordinate, so it avoids snprintf()
+ * whenever the rounding of the last decimal place is unambiguous.
+ *
+ * Returns the length of the string written to "dst".
  */
-char *export_float_to_str ( double f ) {
-	char buf[PRG_MAX_STR_LEN];
-	char *p;
-	char *val;
-	double integral;
-	double fractional;
+int export_float_to_str ( double f, char *dst ) {
+	static const double scale = 1e6; /* 10^EXPORT_TEXT_DECIMAL_PLACES */
+	char digits[32];
+	double scaled;
+	double r;
+	unsigned long long n;
+	int len = 0;
+	int num_digits = 0;
+	int i;
 
-	val = malloc ( sizeof (char) * PRG_MAX_STR_LEN);
 
 	if ( f == 0 ) {
-		snprintf (val,PRG_MAX_STR_LEN,"0");
-		return ( val );
+		dst[0] = '0';
+		dst[1] = '\0';
+		return ( 1 );
+	}
+
+	scaled = fabs ( f ) * scale;
+	r = floor ( scaled + 0.5 );
+	/* Fall back to snprintf() for huge numbers, NaN/infinity, and for values
+	 * so close to a rounding boundary that the product above may have been
+	 * rounded to the wrong side of it. */
+	if ( !( scaled < 9.0e15 ) ||
+			fabs ( fabs ( scaled - floor ( scaled ) ) - 0.5 ) <= scaled * 4.0 * DBL_EPSILON ) {
+		return ( snprintf ( dst, EXPORT_FLOAT_STR_LEN, "%.*f", EXPORT_TEXT_DECIMAL_PLACES, f ) );
+	}
+
+	/* collect digits, least significant first */
+	n = (unsigned long long) r;
+	do {
+		digits[num_digits++] = (char) ( '0' + ( n % 10 ) );
+		n /= 10;
+	} while ( n > 0 );
+	while ( num_digits <= EXPORT_TEXT_DECIMAL_PLACES ) {
+		digits[num_digits++] = '0'; /* leading zeros, e.g. "0.000123" */
+	}
+
+	if ( f < 0 ) {
+		dst[len++] = '-';
+	}
+	for ( i = num_digits - 1; i >= EXPORT_TEXT_DECIMAL_PLACES; i-- ) {
+		dst[len++] = digits[i];
+	}
+	dst[len++] = '.';
+	for ( ; i >= 0; i-- ) {
+		dst[len++] = digits[i];
+	}
+	dst[len] = '\0';
+
+	return ( len );
+}
+
+
+/*
+ * Creates a new output buffer for text formats.
+ * If "fp" is not NULL, then all buffered text will be written to that
+ * file whenever the buffer is full, and on export_buf_flush().
+ * If "fp" is NULL, then all text is collected in memory.
+ */
+export_buf *export_buf_create ( FILE *fp )
+{
+	export_buf *buf = malloc ( sizeof (export_buf) );
+
+	buf->fp = fp;
+	buf->size = EXPORT_BUF_SIZE;
+	buf->data = malloc ( sizeof (char) * buf->size );
+	buf->len = 0;
+	buf->error = FALSE;
+
+	return ( buf );
+}
+
+
+/*
+ * Opens a text file for writing (UTF-8 path name) and returns
+ * a new output buffer for it, or NULL if the file cannot be opened.
+ */
+export_buf *export_buf_open ( const char *path )
+{
+	FILE *fp = t_fopen_utf8 ( path, "w+" );
+
+	if ( fp == NULL ) {
+		return ( NULL );
+	}
+
+	return ( export_buf_create ( fp ) );
+}
+
+
+/*
+ * Like export_buf_open() (above), but keeps the current contents of
+ * the file (if any) and appends all new text to them.
+ */
+export_buf *export_buf_open_append ( const char *path )
+{
+	FILE *fp = t_fopen_utf8 ( path, "a" );
+
+	if ( fp == NULL ) {
+		return ( NULL );
+	}
+
+	return ( export_buf_create ( fp ) );
+}
+
+
+/*
+ * Writes all buffered text to the output file (if any).
+ */
+void export_buf_flush ( export_buf *buf )
+{
+	if ( buf->fp == NULL || buf->len == 0 ) {
+		return;
+	}
+	if ( fwrite ( buf->data, sizeof (char), buf->len, buf->fp ) != buf->len ) {
+		buf->error = TRUE;
+	}
+	buf->len = 0;
+}
+
+
+/*
+ * Makes sure that there is room for at least "len" more chars
+ * (plus a terminating NUL) in the buffer.
+ */
+void export_buf_reserve ( export_buf *buf, size_t len )
+{
+	if ( buf->len + len + 1 <= buf->size ) {
+		return;
+	}
+	export_buf_flush ( buf );
+	if ( buf->len + len + 1 > buf->size ) {
+		while ( buf->len + len + 1 > buf->size ) {
+			buf->size *= 2;
+		}
+		buf->data = realloc ( buf->data, sizeof (char) * buf->size );
+	}
+}
+
+
+/*
+ * Appends "len" chars from "str" to the buffer.
+ */
+void export_buf_write ( export_buf *buf, const char *str, size_t len )
+{
+	export_buf_reserve ( buf, len );
+	memcpy ( buf->data + buf->len, str, len );
+	buf->len += len;
+}
+
+
+/*
+ * Appends a string to the buffer.
+ */
+void export_buf_puts ( export_buf *buf, const char *str )
+{
+	export_buf_write ( buf, str, strlen ( str ) );
+}
+
+
+/*
+ * Appends formatted text to the buffer (same as fprintf()).
+ * Text is formatted directly into the buffer.
+ */
+void export_buf_printf ( export_buf *buf, const char *format, ... )
+{
+	va_list args;
+	int len;
+
+	va_start ( args, format );
+	len = vsnprintf ( buf->data + buf->len, buf->size - buf->len, format, args );
+	va_end ( args );
+	if ( len < 0 ) {
+		buf->error = TRUE;
+		return;
+	}
+	if ( buf->len + len < buf->size ) {
+		buf->len += len;
+		return;
+	}
+	/* did not fit: make room and format again */
+	export_buf_reserve ( buf, len );
+	va_start ( args, format );
+	vsnprintf ( buf->data + buf->len, buf->size - buf->len, format, args );
+	va_end ( args );
+	buf->len += len;
+}
+
+
+/*
+ * Appends a floating point number to the buffer, formatted
+ * by export_float_to_str().
+ */
+void export_buf_put_float ( export_buf *buf, double f )
+{
+	export_buf_reserve ( buf, EXPORT_FLOAT_STR_LEN );
+	buf->len += export_float_to_str ( f, buf->data + buf->len );
+}
+
+
+/*
+ * Flushes the buffer, closes the output file (if any) and releases
+ * the buffer's memory. Returns 0 on success, or EOF if any write failed.
+ */
+int export_buf_close ( export_buf *buf )
+{
+	int result = 0;
+
+	if ( buf == NULL ) {
+		return ( 0 );
+	}
+	export_buf_flush ( buf );
+	if ( buf->fp != NULL ) {
+		if ( fclose ( buf->fp ) != 0 ) {
+			buf->error = TRUE;
+		}
+	}
+	if ( buf->error == TRUE ) {
+		result = EOF;
+	}
+	free ( buf->data );
+	free ( buf );
+
+	return ( result );
+}
+
+
+/*
+ * Creates a bulk record writer for the attribute table "dbf",
+ * which must have been created with export_SHP_DBFCreate() and
+ * must already have all its fields (see export_SHP_make_DBF()).
+ * If "dbf" already has records (see export_SHP_DBFOpenOutput()),
+ * then new records will be appended after them.
+ *
+ * The writer formats attribute values exactly like shapelib's
+ * DBFWrite*Attribute() functions, but only supports appending
+ * records in sequence. Records are collected in a large buffer
+ * and written to disk in blocks. The file header is written
+ * only once, when the writer is closed (export_dbf_close()).
+ */
+export_dbf *export_dbf_create ( DBFHandle dbf )
+{
+	export_dbf *out = malloc ( sizeof (export_dbf) );
+	int num;
+
+	out->dbf = dbf;
+	/* buffer holds a whole number of records */
+	num = EXPORT_DBF_BUF_SIZE / dbf->nRecordLength;
+	if ( num < 1 ) {
+		num = 1;
+	}
+	out->size = (size_t) num * (size_t) dbf->nRecordLength;
+	out->data = malloc ( sizeof (char) * out->size );
+	out->len = 0;
+	out->num_records = dbf->nRecords;
+	out->error = FALSE;
+
+	return ( out );
+}
+
+
+/*
+ * Writes all complete records in the buffer of "out" to disk.
+ * Records are written to the position that they would have in
+ * a DBF file written by shapelib.
+ */
+void export_dbf_flush ( export_dbf *out )
+{
+	DBFHandle dbf = out->dbf;
+	SAOffset first;
+	SAOffset offset;
+
+	if ( out->len == 0 ) {
+		return;
 	}
+	first = out->num_records - (SAOffset) ( out->len / dbf->nRecordLength );
+	offset = dbf->nHeaderLength + first * dbf->nRecordLength;
+	if ( 	dbf->sHooks.FSeek ( dbf->fp, offset, SEEK_SET ) != 0 ||
+			dbf->sHooks.FWrite ( out->data, out->len, 1, dbf->fp ) != 1 ) {
+		out->error = TRUE;
+	}
+	out->len = 0;
+}
+
+
+/*
+ * Helper function for the export_dbf_write_*() functions (below):
+ * This is a version of shapelib's DBFWriteAttribute() for the bulk
+ * writer "out". It formats "value" into field "field" of record "rec",
+ * which must be either the last record written or the next new one.
+ * "value" is a pointer to a double for numeric fields, to a string
+ * for all others, or NULL to write a NULL value.
+ *
+ * Returns TRUE on success, FALSE if the value had to be truncated
+ * or could not be stored at all.
+ */
+BOOLEAN export_dbf_write ( export_dbf *out, int rec, int field, void *value )
+{
+	DBFHandle dbf = out->dbf;
+	char *dst;
+	char str[400], format[20];
+	int j;
+	BOOLEAN result = TRUE;
+
+
+	if ( field < 0 || field >= dbf->nFields ) {
+		return ( FALSE );
+	}
+
+	if ( rec == out->num_records ) {
+		/* brand new record */
+		if ( out->len + dbf->nRecordLength > out->size ) {
+			export_dbf_flush ( out );
+		}
+		memset ( out->data + out->len, ' ', dbf->nRecordLength );
+		out->len += dbf->nRecordLength;
+		out->num_records ++;
+	} else {
+		/* only the current record may still be changed */
+		if ( rec != out->num_records - 1 || out->len == 0 ) {
+			return ( FALSE );
+		}
+	}
+
+	dst = out->data + ( out->len - dbf->nRecordLength ) + dbf->panFieldOffset[field];
+
+	/* NULL value representation (same as in shapelib) */
+	if ( value == NULL ) {
+		char null_char = ' ';
+		if ( dbf->pachFieldType[field] == 'N' || dbf->pachFieldType[field] == 'F' ) {
+			null_char = '*';
+		}
+		if ( dbf->pachFieldType[field] == 'D' ) {
+			null_char = '0';
+		}
+		if ( dbf->pachFieldType[field] == 'L' ) {
+			null_char = '?';
+		}
+		memset ( dst, null_char, dbf->panFieldSize[field] );
+		return ( TRUE );
+	}
+
+	switch ( dbf->pachFieldType[field] ) {
+	case 'D':
+	case 'N':
+	case 'F':
+		{
+			int width = dbf->panFieldSize[field];
+			if ( (int) sizeof (str) - 2 < width ) {
+				width = sizeof (str) - 2;
+			}
+			if ( dbf->panFieldDecimals[field] == 0 ) {
+				snprintf ( format, sizeof (format), "%%%dd", width );
+				snprintf ( str, sizeof (str), format, (int) *((double*) value) );
+			} else {
+				snprintf ( format, sizeof (format), "%%%d.%df", width, dbf->panFieldDecimals[field] );
+				snprintf ( str, sizeof (str), format, *((double*) value) );
+			}
+			if ( (int) strlen (str) > dbf->panFieldSize[field] ) {
+				str[dbf->panFieldSize[field]] = '\0';
+				result = FALSE;
+			}
+			memcpy ( dst, str, strlen (str) );
+		}
+		break;
+	case 'L':
+		if ( 	dbf->panFieldSize[field] >= 1 &&
+				( *((char*) value) == 'F' || *((char*) value) == 'T' ) ) {
+			*dst = *((char*) value);
+		}
+		break;
+	default:
+		if ( (int) strlen ( (char*) value ) > dbf->panFieldSize[field] ) {
+			j = dbf->panFieldSize[field];
+			result = FALSE;
+		} else {
+			memset ( dst, ' ', dbf->panFieldSize[field] );
+			j = strlen ( (char*) value );
+		}
+		memcpy ( dst, (char*) value, j );
+		break;
+	}
+
+	return ( result );
+}
+
+
+/*
+ * Attribute writing functions for the bulk DBF writer. These
+ * work just like their shapelib counterparts DBFWriteStringAttribute(),
+ * DBFWriteIntegerAttribute(), DBFWriteDoubleAttribute() and
+ * DBFWriteNULLAttribute().
+ */
+BOOLEAN export_dbf_write_string ( export_dbf *out, int rec, int field, const char *value )
+{
+	return ( export_dbf_write ( out, rec, field, (void*) value ) );
+}
+
+BOOLEAN export_dbf_write_int ( export_dbf *out, int rec, int field, int value )
+{
+	double d_value = value;
+
+	return ( export_dbf_write ( out, rec, field, (void*) &d_value ) );
+}
+
+BOOLEAN export_dbf_write_double ( export_dbf *out, int rec, int field, double value )
+{
+	return ( export_dbf_write ( out, rec, field, (void*) &value ) );
+}
+
+BOOLEAN export_dbf_write_null ( export_dbf *out, int rec, int field )
+{
+	return ( export_dbf_write ( out, rec, field, NULL ) );
+}
 
-	fractional = modf(f, &integral);
 
-	snprintf (buf,PRG_MAX_STR_LEN,"%f",fractional);
-	p = buf;
-	p++;
-	p++;
-	snprintf (val,PRG_MAX_STR_LEN,"%i.%s",(int)integral,p);
+/*
+ * Writes all remaining records to disk, then updates the file
+ * header and closes the attribute table. Destroys "out".
+ *
+ * Returns 0 on success, EOF if there was a write error.
+ */
+int export_dbf_close ( export_dbf *out )
+{
+	int result = 0;
+
+	if ( out == NULL ) {
+		return ( 0 );
+	}
+	export_dbf_flush ( out );
+	/* let shapelib write the header with the final record count */
+	if ( out->num_records > 0 ) {
+		out->dbf->nRecords = out->num_records;
+		out->dbf->bUpdated = TRUE;
+	}
+	DBFClose ( out->dbf );
+	if ( out->error == TRUE ) {
+		result = EOF;
+	}
+	free ( out->data );
+	free ( out );
 
-	return ( val );
+	return ( result );
 }
 
 
@@ -3150,7 +6605,7 @@ char *export_float_to_str ( double f ) {
  *
  * The return value is the total number of attribute data errors.
  */
-int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
+int export_DXF_write_atts ( 	export_buf *ft, geom_store *gs, int GEOM_TYPE,
 		unsigned int pk, unsigned int geom_id,
 		parser_desc *parser, options *opts )
 {
@@ -3236,7 +6691,7 @@ int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
 	err_count = 0;
 
 	/* first field is always the geom ID */
-	fprintf (ft, "%u", geom_id-1); /* geom ID starts at "0" in text output */
+	export_buf_printf (ft, "%u", geom_id-1); /* geom ID starts at "0" in text output */
 
 	/* now all other fields */
 	field_num = 0;
@@ -3249,14 +6704,14 @@ int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write default NULL value */
-						fprintf (ft, ";\"\"");
+						export_buf_puts (ft, ";\"\"");
 					} else {
 						/* write user-defined NULL value */
-						fprintf (ft, ";\"%s\"", NULL_str);
+						export_buf_printf (ft, ";\"%s\"", NULL_str);
 					}
 				} else {
 					/* write actual field contents */
-					fprintf (ft, ";\"%s\"", atts[field_num]);
+					export_buf_printf (ft, ";\"%s\"", atts[field_num]);
 				}
 			}
 
@@ -3288,14 +6743,14 @@ int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write default integer NULL value */
-						fprintf (ft, ";0");
+						export_buf_puts (ft, ";0");
 					} else {
 						/* write user-defined NULL value */
-						fprintf (ft, ";%i", parser->empty_val);
+						export_buf_printf (ft, ";%i", parser->empty_val);
 					}
 				} else {
 					/* write actual attribute value */
-					fprintf (ft, ";%i", i_value);
+					export_buf_printf (ft, ";%i", i_value);
 				}
 			}
 
@@ -3327,19 +6782,19 @@ int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
 					/* store "no data" representation */
 					if ( parser->empty_val_set == FALSE ) {
 						/* write default double NULL value */
-						fprintf (ft, ";0");
+						export_buf_puts (ft, ";0");
 					} else {
 						/* write user-defined NULL value */
-						fprintf (ft, ";%i", parser->empty_val);
+						export_buf_printf (ft, ";%i", parser->empty_val);
 					}
 				} else {
 					/* write actual attribute value */
 					if ( d_value == 0 ) {
-						fprintf (ft, ";0");
+						export_buf_puts (ft, ";0");
 					} else {
-						char *d_str = export_float_to_str ( d_value );
-						fprintf (ft, ";%s", d_str );
-						free ( d_str );
+						char d_str[EXPORT_FLOAT_STR_LEN];
+						export_float_to_str ( d_value, d_str );
+						export_buf_printf (ft, ";%s", d_str );
 					}
 				}
 			}
@@ -3347,7 +6802,7 @@ int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
 		field_num ++;
 	}
 
-	fprintf (ft, "\n");
+	export_buf_puts (ft, "\n");
 
 	if ( NULL_str != NULL ) {
 		free ( NULL_str );
@@ -3365,27 +6820,27 @@ int export_DXF_write_atts ( 	FILE *ft, geom_store *gs, int GEOM_TYPE,
  * Returns NULL on error, otherwise a valid file handle that can be
  * use to write to the attribute table.
  */
-FILE *export_DXF_make_TXT ( parser_desc *parser, char *path )
+export_buf *export_DXF_make_TXT ( parser_desc *parser, char *path )
 {
-	FILE *ft;
+	export_buf *ft;
 	int field_num;
 
 
 	/* attempt to open text file for writing */
-	ft = t_fopen_utf8 (path, "w+");
+	ft = export_buf_open ( path );
 	if ( ft == NULL ) return (ft);
 
 	/* write header with field names */
 	/* GEOM_ID will always be the first field */
-	fprintf (ft, "geom_id");
+	export_buf_puts (ft, "geom_id");
 	field_num = 0;
 	while ( parser->fields[field_num] != NULL ) {
 		if ( parser->fields[field_num]->skip == FALSE ) {
-			fprintf (ft, ";%s", parser->fields[field_num]->name);
+			export_buf_printf (ft, ";%s", parser->fields[field_num]->name);
 		}
 		field_num ++;
 	}
-	fprintf (ft, "\n");
+	export_buf_puts (ft, "\n");
 
 	return (ft);
 }
@@ -3395,86 +6850,86 @@ FILE *export_DXF_make_TXT ( parser_desc *parser, char *path )
  * Helper function for export_DXF():
  * Returns a valid, open file handle on success, NULL on error
  */
-FILE *dxf_write_header ( geom_store *gs, char *path ) {
-	FILE *fp;
-	fp = t_fopen_utf8 (path, "w+");
+export_buf *dxf_write_header ( geom_store *gs, char *path ) {
+	export_buf *fp;
+	fp = export_buf_open ( path );
 
 	/* write DXF header to output file */
 	if ( fp != NULL ) {
-		char *f;
+		char f[EXPORT_FLOAT_STR_LEN];
 		/* DXF producer ID */
-		fprintf ( fp, "999\n" );
-		fprintf ( fp, "DXF by %s\n", t_get_prg_name_and_version() );
+		export_buf_puts ( fp, "999\n" );
+		export_buf_printf ( fp, "DXF by %s\n", t_get_prg_name_and_version() );
 
 		/* DXF header start */
-		fprintf ( fp, "  0\n" );
-		fprintf ( fp, "SECTION\n" );
-		fprintf ( fp, "  2\n" );
-		fprintf ( fp, "HEADER\n" );
+		export_buf_puts ( fp, "  0\n" );
+		export_buf_puts ( fp, "SECTION\n" );
+		export_buf_puts ( fp, "  2\n" );
+		export_buf_puts ( fp, "HEADER\n" );
 
 		/* AutoCAD DB maint. version  */
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$ACADMAINTVER\n" );
-		fprintf ( fp, " 70\n" );
-		fprintf ( fp, "  6\n" ); /* maint. release 6 */
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$ACADMAINTVER\n" );
+		export_buf_puts ( fp, " 70\n" );
+		export_buf_puts ( fp, "  6\n" ); /* maint. release 6 */
 
 		/* fill mode */
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$FILLMODE\n" );
-		fprintf ( fp, " 70\n" );
-		fprintf ( fp, "  1\n" ); /* fill hatched areas if conditions are met */
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$FILLMODE\n" );
+		export_buf_puts ( fp, " 70\n" );
+		export_buf_puts ( fp, "  1\n" ); /* fill hatched areas if conditions are met */
 
 		/* viewport limits (2D setting) */
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$LIMMIN\n" );
-		fprintf ( fp, " 10\n" );
-		f = export_float_to_str(gs->min_x); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, " 20\n" );
-		f = export_float_to_str(gs->min_y); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$LIMMAX\n" );
-		fprintf ( fp, " 10\n" );
-		f = export_float_to_str(gs->max_x); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, " 20\n" );
-		f = export_float_to_str(gs->max_y); fprintf ( fp, "%s\n", f); free (f);
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$LIMMIN\n" );
+		export_buf_puts ( fp, " 10\n" );
+		export_float_to_str ( gs->min_x, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, " 20\n" );
+		export_float_to_str ( gs->min_y, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$LIMMAX\n" );
+		export_buf_puts ( fp, " 10\n" );
+		export_float_to_str ( gs->max_x, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, " 20\n" );
+		export_float_to_str ( gs->max_y, f ); export_buf_printf ( fp, "%s\n", f);
 
 		/* block size limits (3D setting) */
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$EXTMIN\n" );
-		fprintf ( fp, " 10\n" );
-		f = export_float_to_str(gs->min_x); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, " 20\n" );
-		f = export_float_to_str(gs->min_y); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, " 30\n" );
-		f = export_float_to_str(gs->min_z); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$EXTMAX\n" );
-		fprintf ( fp, " 10\n" );
-		f = export_float_to_str(gs->max_x); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, " 20\n" );
-		f = export_float_to_str(gs->max_y); fprintf ( fp, "%s\n", f); free (f);
-		fprintf ( fp, " 30\n" );
-		f = export_float_to_str(gs->max_z); fprintf ( fp, "%s\n", f); free (f);
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$EXTMIN\n" );
+		export_buf_puts ( fp, " 10\n" );
+		export_float_to_str ( gs->min_x, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, " 20\n" );
+		export_float_to_str ( gs->min_y, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, " 30\n" );
+		export_float_to_str ( gs->min_z, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$EXTMAX\n" );
+		export_buf_puts ( fp, " 10\n" );
+		export_float_to_str ( gs->max_x, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, " 20\n" );
+		export_float_to_str ( gs->max_y, f ); export_buf_printf ( fp, "%s\n", f);
+		export_buf_puts ( fp, " 30\n" );
+		export_float_to_str ( gs->max_z, f ); export_buf_printf ( fp, "%s\n", f);
 
 		/* global point size */
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$PDSIZE\n" );
-		fprintf ( fp, " 40\n" );
-		fprintf ( fp, " 0.0\n" );
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$PDSIZE\n" );
+		export_buf_puts ( fp, " 40\n" );
+		export_buf_puts ( fp, " 0.0\n" );
 
 		/* insertion anchor for block */
-		fprintf ( fp, "  9\n" );
-		fprintf ( fp, "$INSBASE\n" );
-		fprintf ( fp, " 10\n" );
-		fprintf ( fp, "0.0\n" ); /* anchor at 0/0/0 */
-		fprintf ( fp, " 20\n" );
-		fprintf ( fp, "0.0\n" ); /* anchor at 0/0/0 */
-		fprintf ( fp, " 30\n" );
-		fprintf ( fp, "0.0\n" ); /* anchor at 0/0/0 */
+		export_buf_puts ( fp, "  9\n" );
+		export_buf_puts ( fp, "$INSBASE\n" );
+		export_buf_puts ( fp, " 10\n" );
+		export_buf_puts ( fp, "0.0\n" ); /* anchor at 0/0/0 */
+		export_buf_puts ( fp, " 20\n" );
+		export_buf_puts ( fp, "0.0\n" ); /* anchor at 0/0/0 */
+		export_buf_puts ( fp, " 30\n" );
+		export_buf_puts ( fp, "0.0\n" ); /* anchor at 0/0/0 */
 
 		/* end of header */
-		fprintf ( fp, "  0\n" );
-		fprintf ( fp, "ENDSEC\n" );
+		export_buf_puts ( fp, "  0\n" );
+		export_buf_puts ( fp, "ENDSEC\n" );
 
 	}
 
@@ -3525,17 +6980,17 @@ char *dxf_get_field_layer_name ( parser_desc *parser, int field_num ) {
  * "color" is just any integer > 0. Use "-1" to hide the layer by default (not all CAD
  * respect this).
  */
-void dxf_write_layer ( const char layer[], int color, FILE *fp ) {
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "LAYER\n" );
-	fprintf ( fp, "  2\n" );
-	fprintf ( fp, "%s\n", layer );
-	fprintf ( fp, " 70\n" );
-	fprintf ( fp, "    64\n" );
-	fprintf ( fp, " 62\n" );
-	fprintf ( fp, "     %i\n", color );
-	fprintf ( fp, "  6\n" );
-	fprintf ( fp, "CONTINUOUS\n" );
+void dxf_write_layer ( const char layer[], int color, export_buf *fp ) {
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "LAYER\n" );
+	export_buf_puts ( fp, "  2\n" );
+	export_buf_printf ( fp, "%s\n", layer );
+	export_buf_puts ( fp, " 70\n" );
+	export_buf_puts ( fp, "    64\n" );
+	export_buf_puts ( fp, " 62\n" );
+	export_buf_printf ( fp, "     %i\n", color );
+	export_buf_puts ( fp, "  6\n" );
+	export_buf_puts ( fp, "CONTINUOUS\n" );
 }
 
 
@@ -3546,7 +7001,7 @@ void dxf_write_layer ( const char layer[], int color, FILE *fp ) {
  * and layers that are referenced later by the actual
  * drawing objects ("ENTITIES") that will be created by export_DXF().
  */
-void dxf_write_tables ( geom_store *gs, parser_desc *parser, FILE *fp, options *opts ) {
+void dxf_write_tables ( geom_store *gs, parser_desc *parser, export_buf *fp, options *opts ) {
 	int num_layers;
 	int color;
 	int i;
@@ -3569,40 +7024,40 @@ void dxf_write_tables ( geom_store *gs, parser_desc *parser, FILE *fp, options *
 	color = 1;
 
 	/* LINE STYLES */
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "SECTION\n" );
-	fprintf ( fp, "  2\n" );
-	fprintf ( fp, "TABLES\n" );
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "TABLE\n" );
-	fprintf ( fp, "  2\n" );
-	fprintf ( fp, "LTYPE\n" );
-	fprintf ( fp, " 70\n" );
-	fprintf ( fp, "     1\n" );
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "LTYPE\n" );
-	fprintf ( fp, "  2\n" );
-	fprintf ( fp, "CONTINUOUS\n" );
-	fprintf ( fp, " 70\n" );
-	fprintf ( fp, "    64\n" );
-	fprintf ( fp, "  3\n" );
-	fprintf ( fp, "Solid line\n" );
-	fprintf ( fp, " 72\n" );
-	fprintf ( fp, "    65\n" );
-	fprintf ( fp, " 73\n" );
-	fprintf ( fp, "     0\n" );
-	fprintf ( fp, " 40\n" );
-	fprintf ( fp, "0.0\n" );
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "ENDTAB\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "SECTION\n" );
+	export_buf_puts ( fp, "  2\n" );
+	export_buf_puts ( fp, "TABLES\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "TABLE\n" );
+	export_buf_puts ( fp, "  2\n" );
+	export_buf_puts ( fp, "LTYPE\n" );
+	export_buf_puts ( fp, " 70\n" );
+	export_buf_puts ( fp, "     1\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "LTYPE\n" );
+	export_buf_puts ( fp, "  2\n" );
+	export_buf_puts ( fp, "CONTINUOUS\n" );
+	export_buf_puts ( fp, " 70\n" );
+	export_buf_puts ( fp, "    64\n" );
+	export_buf_puts ( fp, "  3\n" );
+	export_buf_puts ( fp, "Solid line\n" );
+	export_buf_puts ( fp, " 72\n" );
+	export_buf_puts ( fp, "    65\n" );
+	export_buf_puts ( fp, " 73\n" );
+	export_buf_puts ( fp, "     0\n" );
+	export_buf_puts ( fp, " 40\n" );
+	export_buf_puts ( fp, "0.0\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "ENDTAB\n" );
 
 	/* LAYERS (as required) */
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "TABLE\n" );
-	fprintf ( fp, "  2\n" );
-	fprintf ( fp, "LAYER\n" );
-	fprintf ( fp, " 70\n" );
-	fprintf ( fp, "      %i\n", num_layers ); /* layer "0" included */
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "TABLE\n" );
+	export_buf_puts ( fp, "  2\n" );
+	export_buf_puts ( fp, "LAYER\n" );
+	export_buf_puts ( fp, " 70\n" );
+	export_buf_printf ( fp, "      %i\n", num_layers ); /* layer "0" included */
 	/* layer "0" (mandatory) */
 	dxf_write_layer ( "0", color, fp );
 	color ++;
@@ -3652,10 +7107,10 @@ void dxf_write_tables ( geom_store *gs, parser_desc *parser, FILE *fp, options *
 	}
 
 	/* close TABLES section */
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "ENDTAB\n" );
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "ENDSEC\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "ENDTAB\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "ENDSEC\n" );
 }
 
 
@@ -3663,15 +7118,15 @@ void dxf_write_tables ( geom_store *gs, parser_desc *parser, FILE *fp, options *
  * Helper function for export_DXF():
  * Writes terminating lines (EOF) to DXF and closes file handle.
  */
-void dxf_write_footer ( FILE *fp ) {
+void dxf_write_footer ( export_buf *fp ) {
 
 	if ( fp == NULL )
 		return;
 
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "EOF\n" );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "EOF\n" );
 
-	fclose (fp);
+	export_buf_close ( fp );
 }
 
 
@@ -3683,47 +7138,43 @@ void dxf_write_footer ( FILE *fp ) {
  * Default is to label by "geom_id"; if "geom_id" is passed as "-1", then the point is
  * labeled using its coordinates instead (useful for raw point labels).
  */
-void dxf_write_label ( FILE *fp, const char layer[],
+void dxf_write_label ( export_buf *fp, const char layer[],
 		int geom_id, double size, double X, double Y, double Z ) {
-	char *xf,*yf,*zf,*sf;
-
-
-	xf = export_float_to_str(X);
-	yf = export_float_to_str(Y);
-	zf = export_float_to_str(Z);
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "TEXT\n" );
-	fprintf ( fp, "  8\n" );
-	fprintf ( fp, "%s\n", layer );
-	fprintf ( fp, " 10\n" );
-	fprintf ( fp, "%s\n", xf );
-	fprintf ( fp, " 20\n" );
-	fprintf ( fp, "%s\n", yf );
-	fprintf ( fp, " 30\n" );
-	fprintf ( fp, "%s\n", zf );
-	fprintf ( fp, " 40\n" );
-	sf = export_float_to_str(size);
-	fprintf ( fp, "%s\n", sf ); /* font size */
-	free (sf);
-	fprintf ( fp, "  1\n" );
+	char xf[EXPORT_FLOAT_STR_LEN], yf[EXPORT_FLOAT_STR_LEN], zf[EXPORT_FLOAT_STR_LEN], sf[EXPORT_FLOAT_STR_LEN];
+
+
+	export_float_to_str ( X, xf );
+	export_float_to_str ( Y, yf );
+	export_float_to_str ( Z, zf );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "TEXT\n" );
+	export_buf_puts ( fp, "  8\n" );
+	export_buf_printf ( fp, "%s\n", layer );
+	export_buf_puts ( fp, " 10\n" );
+	export_buf_printf ( fp, "%s\n", xf );
+	export_buf_puts ( fp, " 20\n" );
+	export_buf_printf ( fp, "%s\n", yf );
+	export_buf_puts ( fp, " 30\n" );
+	export_buf_printf ( fp, "%s\n", zf );
+	export_buf_puts ( fp, " 40\n" );
+	export_float_to_str ( size, sf );
+	export_buf_printf ( fp, "%s\n", sf ); /* font size */
+	export_buf_puts ( fp, "  1\n" );
 	if ( geom_id > -1 ) {
 		/* label by geom_id */
-		fprintf ( fp, "%i\n", geom_id );
+		export_buf_printf ( fp, "%i\n", geom_id );
 	} else {
 		/* label by coordinates */
-		fprintf ( fp, "%s; %s; %s\n", xf, yf, zf ); /* label string */
-	}
-	fprintf ( fp, " 72\n" );
-	fprintf ( fp, "     4\n" );
-	fprintf ( fp, " 11\n" );
-	fprintf ( fp, "%s\n", xf );
-	fprintf ( fp, " 21\n" );
-	fprintf ( fp, "%s\n", yf );
-	fprintf ( fp, " 31\n" );
-	fprintf ( fp, "%s\n", zf );
-	free (xf);
-	free (yf);
-	free (zf);
+		export_buf_printf ( fp, "%s; %s; %s\n", xf, yf, zf ); /* label string */
+	}
+	export_buf_puts ( fp, " 72\n" );
+	export_buf_puts ( fp, "     4\n" );
+	export_buf_puts ( fp, " 11\n" );
+	export_buf_printf ( fp, "%s\n", xf );
+	export_buf_puts ( fp, " 21\n" );
+	export_buf_printf ( fp, "%s\n", yf );
+	export_buf_puts ( fp, " 31\n" );
+	export_buf_printf ( fp, "%s\n", zf );
 }
 
 
@@ -3733,40 +7184,36 @@ void dxf_write_label ( FILE *fp, const char layer[],
  * "layer" must be one of the constant strings defined in "export.c" ("DXF_LAYER_NAME_*").
  * or one of the auto-generated layer names for field label layers.
  */
-void dxf_write_label_text ( FILE *fp, const char layer[],
+void dxf_write_label_text ( export_buf *fp, const char layer[],
 		const char *label, double size, double X, double Y, double Z ) {
-	char *xf,*yf,*zf,*sf;
-
-	xf = export_float_to_str(X);
-	yf = export_float_to_str(Y);
-	zf = export_float_to_str(Z);
-	fprintf ( fp, "  0\n" );
-	fprintf ( fp, "TEXT\n" );
-	fprintf ( fp, "  8\n" );
-	fprintf ( fp, "%s\n", layer );
-	fprintf ( fp, " 10\n" );
-	fprintf ( fp, "%s\n", xf );
-	fprintf ( fp, " 20\n" );
-	fprintf ( fp, "%s\n", yf );
-	fprintf ( fp, " 30\n" );
-	fprintf ( fp, "%s\n", zf );
-	fprintf ( fp, " 40\n" );
-	sf = export_float_to_str(size);
-	fprintf ( fp, "%s\n", sf ); /* font size */
-	free (sf);
-	fprintf ( fp, "  1\n" );
-	fprintf ( fp, "%s\n", label ); /* label string */
-	fprintf ( fp, " 72\n" );
-	fprintf ( fp, "     4\n" );
-	fprintf ( fp, " 11\n" );
-	fprintf ( fp, "%s\n", xf );
-	fprintf ( fp, " 21\n" );
-	fprintf ( fp, "%s\n", yf );
-	fprintf ( fp, " 31\n" );
-	fprintf ( fp, "%s\n", zf );
-	free (xf);
-	free (yf);
-	free (zf);
+	char xf[EXPORT_FLOAT_STR_LEN], yf[EXPORT_FLOAT_STR_LEN], zf[EXPORT_FLOAT_STR_LEN], sf[EXPORT_FLOAT_STR_LEN];
+
+	export_float_to_str ( X, xf );
+	export_float_to_str ( Y, yf );
+	export_float_to_str ( Z, zf );
+	export_buf_puts ( fp, "  0\n" );
+	export_buf_puts ( fp, "TEXT\n" );
+	export_buf_puts ( fp, "  8\n" );
+	export_buf_printf ( fp, "%s\n", layer );
+	export_buf_puts ( fp, " 10\n" );
+	export_buf_printf ( fp, "%s\n", xf );
+	export_buf_puts ( fp, " 20\n" );
+	export_buf_printf ( fp, "%s\n", yf );
+	export_buf_puts ( fp, " 30\n" );
+	export_buf_printf ( fp, "%s\n", zf );
+	export_buf_puts ( fp, " 40\n" );
+	export_float_to_str ( size, sf );
+	export_buf_printf ( fp, "%s\n", sf ); /* font size */
+	export_buf_puts ( fp, "  1\n" );
+	export_buf_printf ( fp, "%s\n", label ); /* label string */
+	export_buf_puts ( fp, " 72\n" );
+	export_buf_puts ( fp, "     4\n" );
+	export_buf_puts ( fp, " 11\n" );
+	export_buf_printf ( fp, "%s\n", xf );
+	export_buf_puts ( fp, " 21\n" );
+	export_buf_printf ( fp, "%s\n", yf );
+	export_buf_puts ( fp, " 31\n" );
+	export_buf_printf ( fp, "%s\n", zf );
 }
 
 
@@ -3787,12 +7234,12 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 {
 	double *X,*Y,*Z;
 	double X_mean, Y_mean, Z_mean;
-	char *xf,*yf,*zf;
+	char xf[EXPORT_FLOAT_STR_LEN], yf[EXPORT_FLOAT_STR_LEN], zf[EXPORT_FLOAT_STR_LEN];
 	int i, j, k, l, v, num_errors, att_errors;
 	char *dxf_layer_name;
 	int num_vertices;
-	FILE *fatts;
-	FILE *fdxf;
+	export_buf *fatts;
+	export_buf *fdxf;
 	char **atts;
 
 
@@ -3830,10 +7277,10 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 	/* WRITE GEOMETRIES TO DXF */
 
 	/* start DXF section "ENTITIES" (drawing objects) */
-	fprintf ( fdxf, "  0\n" );
-	fprintf ( fdxf, "SECTION\n" );
-	fprintf ( fdxf, "  2\n" );
-	fprintf ( fdxf, "ENTITIES\n" );
+	export_buf_puts ( fdxf, "  0\n" );
+	export_buf_puts ( fdxf, "SECTION\n" );
+	export_buf_puts ( fdxf, "  2\n" );
+	export_buf_puts ( fdxf, "ENTITIES\n" );
 
 	num_errors = 0;
 
@@ -3857,44 +7304,41 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 			vertex = 0;
 			for ( j=0; j < gs->polygons[i].num_parts; j++ ) {
 				if (gs->polygons[i].parts[j].is_hole == FALSE ) { /* we do not process polygon holes in DXF */
-					fprintf ( fdxf, "  0\n" );
-					fprintf ( fdxf, "POLYLINE\n" );
-					fprintf ( fdxf, "  5\n" );
-					fprintf ( fdxf, "%u\n", gs->polygons[i].geom_id ); /* OBJECT HANDLE */
-					fprintf ( fdxf, "  8\n" );
-					fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_AREA) );
-					fprintf ( fdxf, " 66\n" );
-					fprintf ( fdxf, "  1\n" );
+					export_buf_puts ( fdxf, "  0\n" );
+					export_buf_puts ( fdxf, "POLYLINE\n" );
+					export_buf_puts ( fdxf, "  5\n" );
+					export_buf_printf ( fdxf, "%u\n", gs->polygons[i].geom_id ); /* OBJECT HANDLE */
+					export_buf_puts ( fdxf, "  8\n" );
+					export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_AREA) );
+					export_buf_puts ( fdxf, " 66\n" );
+					export_buf_puts ( fdxf, "  1\n" );
 					for ( k = 0; k < gs->polygons[i].parts[j].num_vertices; k++ ) {
 						X[vertex] = gs->polygons[i].parts[j].X[k];
 						Y[vertex] = gs->polygons[i].parts[j].Y[k];
-						xf = export_float_to_str(X[vertex]);
-						yf = export_float_to_str(Y[vertex]);
+						export_float_to_str ( X[vertex], xf );
+						export_float_to_str ( Y[vertex], yf );
 						if ( gs->polygons[i].is_3D == TRUE && opts->force_2d == FALSE ) {
 							Z[vertex] = gs->polygons[i].parts[j].Z[k];
 						} else {
 							Z[vertex] = 0.0;
 						}
-						zf = export_float_to_str(Z[vertex]);
-						fprintf ( fdxf, "  0\n" );
-						fprintf ( fdxf, "VERTEX\n" );
-						fprintf ( fdxf, "  8\n" );
-						fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_AREA) );
-						fprintf ( fdxf, " 10\n" );
-						fprintf ( fdxf, "%s\n", xf );
-						fprintf ( fdxf, " 20\n" );
-						fprintf ( fdxf, "%s\n", yf );
-						fprintf ( fdxf, " 30\n" );
-						fprintf ( fdxf, "%s\n", zf );
-						free ( xf );
-						free ( yf );
-						free ( zf );
+						export_float_to_str ( Z[vertex], zf );
+						export_buf_puts ( fdxf, "  0\n" );
+						export_buf_puts ( fdxf, "VERTEX\n" );
+						export_buf_puts ( fdxf, "  8\n" );
+						export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_AREA) );
+						export_buf_puts ( fdxf, " 10\n" );
+						export_buf_printf ( fdxf, "%s\n", xf );
+						export_buf_puts ( fdxf, " 20\n" );
+						export_buf_printf ( fdxf, "%s\n", yf );
+						export_buf_puts ( fdxf, " 30\n" );
+						export_buf_printf ( fdxf, "%s\n", zf );
 						vertex ++;
 					}
-					fprintf ( fdxf, "  0\n" );
-					fprintf ( fdxf, "SEQEND\n" );
-					fprintf ( fdxf, "  8\n" );
-					fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_AREA) );
+					export_buf_puts ( fdxf, "  0\n" );
+					export_buf_puts ( fdxf, "SEQEND\n" );
+					export_buf_puts ( fdxf, "  8\n" );
+					export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_AREA) );
 					/* area label (per part): place label at centroid */
 					X_mean = 0;
 					Y_mean = 0;
@@ -3955,44 +7399,41 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 			Z = malloc ( sizeof ( double ) * num_vertices );
 			vertex = 0;
 			for ( j=0; j < gs->lines[i].num_parts; j++ ) {
-				fprintf ( fdxf, "  0\n" );
-				fprintf ( fdxf, "POLYLINE\n" );
-				fprintf ( fdxf, "  5\n" );
-				fprintf ( fdxf, "%u\n", gs->lines[i].geom_id ); /* OBJECT HANDLE */
-				fprintf ( fdxf, "  8\n" );
-				fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_LINE) );
-				fprintf ( fdxf, " 66\n" );
-				fprintf ( fdxf, "  1\n" );
+				export_buf_puts ( fdxf, "  0\n" );
+				export_buf_puts ( fdxf, "POLYLINE\n" );
+				export_buf_puts ( fdxf, "  5\n" );
+				export_buf_printf ( fdxf, "%u\n", gs->lines[i].geom_id ); /* OBJECT HANDLE */
+				export_buf_puts ( fdxf, "  8\n" );
+				export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_LINE) );
+				export_buf_puts ( fdxf, " 66\n" );
+				export_buf_puts ( fdxf, "  1\n" );
 				for ( k = 0; k < gs->lines[i].parts[j].num_vertices; k++ ) {
 					X[vertex] = gs->lines[i].parts[j].X[k];
 					Y[vertex] = gs->lines[i].parts[j].Y[k];
-					xf = export_float_to_str(X[vertex]);
-					yf = export_float_to_str(Y[vertex]);
+					export_float_to_str ( X[vertex], xf );
+					export_float_to_str ( Y[vertex], yf );
 					if ( gs->lines[i].is_3D == TRUE && opts->force_2d == FALSE ) {
 						Z[vertex] = gs->lines[i].parts[j].Z[k];
 					} else {
 						Z[vertex] = 0.0;
 					}
-					zf = export_float_to_str(Z[vertex]);
-					fprintf ( fdxf, "  0\n" );
-					fprintf ( fdxf, "VERTEX\n" );
-					fprintf ( fdxf, "  8\n" );
-					fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_LINE) );
-					fprintf ( fdxf, " 10\n" );
-					fprintf ( fdxf, "%s\n", xf );
-					fprintf ( fdxf, " 20\n" );
-					fprintf ( fdxf, "%s\n", yf );
-					fprintf ( fdxf, " 30\n" );
-					fprintf ( fdxf, "%s\n", zf );
-					free ( xf );
-					free ( yf );
-					free ( zf );
+					export_float_to_str ( Z[vertex], zf );
+					export_buf_puts ( fdxf, "  0\n" );
+					export_buf_puts ( fdxf, "VERTEX\n" );
+					export_buf_puts ( fdxf, "  8\n" );
+					export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_LINE) );
+					export_buf_puts ( fdxf, " 10\n" );
+					export_buf_printf ( fdxf, "%s\n", xf );
+					export_buf_puts ( fdxf, " 20\n" );
+					export_buf_printf ( fdxf, "%s\n", yf );
+					export_buf_puts ( fdxf, " 30\n" );
+					export_buf_printf ( fdxf, "%s\n", zf );
 					vertex ++;
 				}
-				fprintf ( fdxf, "  0\n" );
-				fprintf ( fdxf, "SEQEND\n" );
-				fprintf ( fdxf, "  8\n" );
-				fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_LINE) );
+				export_buf_puts ( fdxf, "  0\n" );
+				export_buf_puts ( fdxf, "SEQEND\n" );
+				export_buf_puts ( fdxf, "  8\n" );
+				export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_LINE) );
 				/* line label (per part): place label at central vertex */
 				X_mean = X[(gs->lines[i].parts[j].num_vertices / 2) - 1];
 				if ( X_mean < 0 ) X_mean = 0;
@@ -4036,30 +7477,27 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 			Z = malloc ( sizeof ( double ) );
 			X[0] = gs->points[i].X;
 			Y[0] = gs->points[i].Y;
-			xf = export_float_to_str(X[0]);
-			yf = export_float_to_str(Y[0]);
+			export_float_to_str ( X[0], xf );
+			export_float_to_str ( Y[0], yf );
 			if ( gs->points[i].is_3D == TRUE && opts->force_2d == FALSE ) {
 				Z[0] = gs->points[i].Z;
 			} else {
 				Z[0] = 0.0;
 			}
-			zf = export_float_to_str(Z[0]);
+			export_float_to_str ( Z[0], zf );
 			/* actual points */
-			fprintf ( fdxf, "  0\n" );
-			fprintf ( fdxf, "POINT\n" );
-			fprintf ( fdxf, "  5\n" );
-			fprintf ( fdxf, "%u\n", gs->points[i].geom_id ); /* OBJECT HANDLE */
-			fprintf ( fdxf, "  8\n" );
-			fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_POINT) );
-			fprintf ( fdxf, " 10\n" );
-			fprintf ( fdxf, "%s\n", xf );
-			fprintf ( fdxf, " 20\n" );
-			fprintf ( fdxf, "%s\n", yf );
-			fprintf ( fdxf, " 30\n" );
-			fprintf ( fdxf, "%s\n", zf );
-			free ( xf );
-			free ( yf );
-			free ( zf );
+			export_buf_puts ( fdxf, "  0\n" );
+			export_buf_puts ( fdxf, "POINT\n" );
+			export_buf_puts ( fdxf, "  5\n" );
+			export_buf_printf ( fdxf, "%u\n", gs->points[i].geom_id ); /* OBJECT HANDLE */
+			export_buf_puts ( fdxf, "  8\n" );
+			export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_POINT) );
+			export_buf_puts ( fdxf, " 10\n" );
+			export_buf_printf ( fdxf, "%s\n", xf );
+			export_buf_puts ( fdxf, " 20\n" );
+			export_buf_printf ( fdxf, "%s\n", yf );
+			export_buf_puts ( fdxf, " 30\n" );
+			export_buf_printf ( fdxf, "%s\n", zf );
 			/* point labels (attach geom ID) */
 			dxf_write_label ( fdxf, _(DXF_LAYER_NAME_POINT_LABELS),
 					gs->points[i].geom_id-1, DXF_LABEL_SIZE_POINT, X[0], Y[0], Z[0] );
@@ -4095,30 +7533,27 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 			Z = malloc ( sizeof ( double ) );
 			X[0] = gs->points_raw[i].X;
 			Y[0] = gs->points_raw[i].Y;
-			xf = export_float_to_str(X[0]);
-			yf = export_float_to_str(Y[0]);
+			export_float_to_str ( X[0], xf );
+			export_float_to_str ( Y[0], yf );
 			if ( gs->points_raw[i].is_3D == TRUE && opts->force_2d == FALSE ) {
 				Z[0] = gs->points_raw[i].Z;
 			} else {
 				Z[0] = 0.0;
 			}
-			zf = export_float_to_str(Z[0]);
+			export_float_to_str ( Z[0], zf );
 			/* actual raw points */
-			fprintf ( fdxf, "  0\n" );
-			fprintf ( fdxf, "POINT\n" );
-			fprintf ( fdxf, "  5\n" );
-			fprintf ( fdxf, "%u\n", gs->points_raw[i].geom_id ); /* OBJECT HANDLE */
-			fprintf ( fdxf, "  8\n" );
-			fprintf ( fdxf, "%s\n", _(DXF_LAYER_NAME_RAW) );
-			fprintf ( fdxf, " 10\n" );
-			fprintf ( fdxf, "%s\n", xf );
-			fprintf ( fdxf, " 20\n" );
-			fprintf ( fdxf, "%s\n", yf );
-			fprintf ( fdxf, " 30\n" );
-			fprintf ( fdxf, "%s\n", zf );
-			free ( xf );
-			free ( yf );
-			free ( zf );
+			export_buf_puts ( fdxf, "  0\n" );
+			export_buf_puts ( fdxf, "POINT\n" );
+			export_buf_puts ( fdxf, "  5\n" );
+			export_buf_printf ( fdxf, "%u\n", gs->points_raw[i].geom_id ); /* OBJECT HANDLE */
+			export_buf_puts ( fdxf, "  8\n" );
+			export_buf_printf ( fdxf, "%s\n", _(DXF_LAYER_NAME_RAW) );
+			export_buf_puts ( fdxf, " 10\n" );
+			export_buf_printf ( fdxf, "%s\n", xf );
+			export_buf_puts ( fdxf, " 20\n" );
+			export_buf_printf ( fdxf, "%s\n", yf );
+			export_buf_puts ( fdxf, " 30\n" );
+			export_buf_printf ( fdxf, "%s\n", zf );
 			/* raw point labels (attach coordinates) */
 			dxf_write_label ( fdxf, _(DXF_LAYER_NAME_RAW_LABELS),
 					-1, DXF_LABEL_SIZE_RAW, X[0], Y[0], Z[0] );
@@ -4216,11 +7651,11 @@ int export_DXF ( geom_store *gs, parser_desc *parser, options *opts )
 	}
 
 	/* close DXF section "ENTITIES" (drawing objects) */
-	fprintf ( fdxf, "  0\n" );
-	fprintf ( fdxf, "ENDSEC\n" );
+	export_buf_puts ( fdxf, "  0\n" );
+	export_buf_puts ( fdxf, "ENDSEC\n" );
 
 	/* close attributes output file */
-	fclose ( fatts );
+	export_buf_close ( fatts );
 
 	/* write DXF footer and close */
 	dxf_write_footer ( fdxf );
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "errors.h"
 #include "geom.h"
 #include "global.h"
 #include "options.h"
@@ -37,6 +38,18 @@
 /* constant width for an integer number (DBF) */
 #define DBF_INTEGER_WIDTH	9
 
+/* initial size of output buffers for text formats (bytes) */
+#define EXPORT_BUF_SIZE		65536
+
+/* size of record buffers for DBF attribute tables (bytes) */
+#define EXPORT_DBF_BUF_SIZE	1048576
+
+/* number of decimal places for floating point numbers in text formats */
+#define EXPORT_TEXT_DECIMAL_PLACES	6
+
+/* max. length of a floating point number written by export_float_to_str() */
+#define EXPORT_FLOAT_STR_LEN	400
+
 /* label field positions */
 #define LBL_FIELD_POS_TEXT 				1
 #define LBL_FIELD_POS_FONT_TYPE			2
@@ -71,16 +84,327 @@
 #define LBL_FIELD_GEOM_TYPE_POLY		2
 
 
+/*
+ * Output buffer for text formats (GeoJSON, KML, DXF).
+ * Text is collected in a memory buffer and written to "fp"
+ * in large blocks (or kept in memory if "fp" is NULL).
+ */
+typedef struct export_buf export_buf;
+struct export_buf
+{
+	FILE *fp; /* output file or NULL */
+	char *data; /* buffered text (not NUL-terminated) */
+	size_t len; /* number of chars in "data" */
+	size_t size; /* allocated size of "data" */
+	BOOLEAN error; /* TRUE if writing to "fp" failed */
+};
+
+/* create an output buffer for a file (or memory, if "fp" is NULL) */
+export_buf *export_buf_create ( FILE *fp );
+
+/* append text to an output buffer */
+void export_buf_write ( export_buf *buf, const char *str, size_t len );
+void export_buf_puts ( export_buf *buf, const char *str );
+void export_buf_printf ( export_buf *buf, const char *format, ... );
+void export_buf_put_float ( export_buf *buf, double f );
+
+/* write buffered text to file */
+void export_buf_flush ( export_buf *buf );
+
+/* flush, close file and destroy output buffer */
+int export_buf_close ( export_buf *buf );
+
+/* number of geometries formatted by one text export job */
+#define EXPORT_TEXT_JOB_SIZE		256
+
+/* max. number of text export jobs per thread that are kept in memory at a time */
+#define EXPORT_TEXT_JOBS_PER_THREAD	4
+
+/*
+ * Arguments and results of one text export job: formats the selected
+ * geometries in one range of a geometry store into a private memory
+ * buffer (see export_text_write_features()).
+ */
+typedef struct export_text_job export_text_job;
+struct export_text_job
+{
+	int (*write) ( export_buf*, export_text_job*, int, int ); /* formats one geometry (index, geom ID) */
+	int GEOM_TYPE; /* type of geometries to write (GEOM_TYPE_*) */
+	int first; /* index of first geometry in range */
+	int last; /* index of last geometry in range + 1 */
+	int geom_id; /* geom ID of first selected geometry in range */
+	const int *num_selected; /* number of selected geometries, for each type */
+	geom_store *gs; /* geometry store to export (read-only) */
+	parser_desc *parser; /* parser description (read-only) */
+	options *opts; /* program options (read-only) */
+	export_buf *buf; /* formatted output, in memory (result) */
+	int num_errors; /* number of attribute field errors (result) */
+	err_queue messages; /* messages produced while formatting this range */
+};
+
+/* write all selected geometries of one type, formatted in parallel */
+int export_text_write_features ( export_buf *fp, int (*write) ( export_buf*, export_text_job*, int, int ),
+		int GEOM_TYPE, int geom_id, const int *num_selected,
+		geom_store *gs, parser_desc *parser, options *opts );
+
+/*
+ * Bulk writer for DBF attribute tables. Records are formatted
+ * exactly as shapelib would do it, but collected in a buffer
+ * and appended to the file in large blocks.
+ */
+typedef struct export_dbf export_dbf;
+struct export_dbf
+{
+	DBFHandle dbf; /* shapelib handle (field definitions and file) */
+	char *data; /* buffered records (last one is the current record) */
+	size_t len; /* number of bytes in "data" */
+	size_t size; /* allocated size of "data" */
+	int num_records; /* total number of records (incl. those already on disk) */
+	BOOLEAN error; /* TRUE if writing to disk failed */
+};
+
+/* create a bulk record writer for a new DBF attribute table */
+export_dbf *export_dbf_create ( DBFHandle dbf );
+
+/* write attribute values (records can only be appended) */
+BOOLEAN export_dbf_write_string ( export_dbf *out, int rec, int field, const char *value );
+BOOLEAN export_dbf_write_int ( export_dbf *out, int rec, int field, int value );
+BOOLEAN export_dbf_write_double ( export_dbf *out, int rec, int field, double value );
+BOOLEAN export_dbf_write_null ( export_dbf *out, int rec, int field );
+
+/* write all records and header, close file and destroy writer */
+int export_dbf_close ( export_dbf *out );
+
+/*
+ * Shapefile layers written by export_SHP(). Each layer
+ * is written by its own job (see export_SHP_job below).
+ */
+#define EXPORT_SHP_LAYER_POINTS		0
+#define EXPORT_SHP_LAYER_POINTS_RAW	1
+#define EXPORT_SHP_LAYER_LINES		2
+#define EXPORT_SHP_LAYER_POLYGONS	3
+#define EXPORT_SHP_LAYER_LABELS		4
+#define EXPORT_SHP_NUM_LAYERS		5
+
+/*
+ * Bounding box of one shape, as collected for the
+ * Shapefile spatial index (option "--spatial-index").
+ */
+typedef struct export_SHP_bbox export_SHP_bbox;
+struct export_SHP_bbox
+{
+	int id; /* shape ID (record number) in Shapefile */
+	double x_min, y_min, x_max, y_max;
+};
+
+/*
+ * Arguments and results of one Shapefile layer writer job.
+ */
+typedef struct export_SHP_job export_SHP_job;
+struct export_SHP_job
+{
+	int layer; /* layer to write (EXPORT_SHP_LAYER_*) */
+	SHPHandle shp; /* output Shapefile for this layer */
+	const char *shp_path; /* path of Shapefile (for spatial index and messages) */
+	export_dbf *dbf; /* output attribute table for this layer */
+	const char *dbf_path; /* path of attribute table (for messages) */
+	geom_store *gs; /* geometry store to export (read-only) */
+	parser_desc *parser; /* parser description (read-only) */
+	options *opts; /* program options (read-only) */
+	int num_errors; /* number of attribute field errors (result) */
+	err_queue messages; /* messages produced while writing this layer */
+	export_SHP_bbox *bboxes; /* bounding boxes of all shapes written (spatial index only) */
+	int num_bboxes; /* number of bounding boxes in "bboxes" */
+	int max_bboxes; /* number of bounding boxes allocated */
+	SHPTree *index; /* spatial index of this layer (result) or NULL */
+};
+
+/*
+ * Minimal FlatBuffers encoder for FlatGeobuf output.
+ * Like the reference implementation, it builds each buffer
+ * back to front: child objects (strings, vectors, sub-tables)
+ * must be added before the table that refers to them.
+ * Objects are referred to by their distance from the end
+ * of the buffer, as returned by the export_fb_* functions.
+ */
+#define EXPORT_FB_MAX_FIELDS	16 /* max. number of fields per table */
+
+typedef struct export_fb export_fb;
+struct export_fb
+{
+	unsigned char *data; /* buffer memory; contents occupy the last "len" bytes */
+	size_t len; /* number of bytes in use */
+	size_t size; /* allocated size of "data" */
+	size_t min_align; /* largest alignment required by any object */
+	size_t fields[EXPORT_FB_MAX_FIELDS]; /* positions of fields in current table (0 = not set) */
+	int num_fields; /* number of field slots used in current table */
+	size_t table_start; /* value of "len" when current table was started */
+};
+
+/* FlatGeobuf geometry types (subset) */
+#define EXPORT_FGB_GEOM_UNKNOWN			0
+#define EXPORT_FGB_GEOM_POINT			1
+#define EXPORT_FGB_GEOM_LINESTRING		2
+#define EXPORT_FGB_GEOM_POLYGON			3
+#define EXPORT_FGB_GEOM_MULTILINESTRING	5
+#define EXPORT_FGB_GEOM_MULTIPOLYGON	6
+
+/* FlatGeobuf attribute column types (subset) */
+#define EXPORT_FGB_COL_INT		5
+#define EXPORT_FGB_COL_DOUBLE	10
+#define EXPORT_FGB_COL_STRING	11
+
+/* number of children per node of the packed Hilbert R-tree */
+#define EXPORT_FGB_NODE_SIZE	16
+
+/* size of one packed R-tree node on disk (4 doubles and one offset) */
+#define EXPORT_FGB_NODE_BYTES	40
+
+/*
+ * One feature in a FlatGeobuf file: its source geometry,
+ * bounding box and position on the Hilbert curve.
+ */
+typedef struct export_FGB_item export_FGB_item;
+struct export_FGB_item
+{
+	int GEOM_TYPE; /* geometry type (GEOM_TYPE_*) */
+	unsigned int pk; /* index of geometry in store */
+	unsigned int geom_id; /* value of "geom_id" attribute */
+	double x_min, y_min, x_max, y_max; /* 2D bounding box */
+	unsigned int hilbert; /* Hilbert value of bounding box center */
+	unsigned long long offset; /* byte offset of feature (after header and index) */
+};
+
+/*
+ * Mapbox Vector Tiles: tiles have a resolution of EXPORT_MVT_EXTENT
+ * units per side and include geometries up to EXPORT_MVT_BUFFER units
+ * outside of their boundaries (to avoid rendering artifacts).
+ */
+#define EXPORT_MVT_EXTENT	4096
+#define EXPORT_MVT_BUFFER	64
+
+/* half the circumference of the Web Mercator sphere (meters) */
+#define EXPORT_MVT_HALF_WORLD	20037508.342789244
+/* latitude limits of the Web Mercator map (degrees) */
+#define EXPORT_MVT_MAX_LAT		85.0511287798066
+
+/* Protocol Buffers wire types */
+#define EXPORT_PB_VARINT	0
+#define EXPORT_PB_FIXED64	1
+#define EXPORT_PB_BYTES		2
+
+/* MVT geometry types */
+#define EXPORT_MVT_GEOM_POINT		1
+#define EXPORT_MVT_GEOM_LINESTRING	2
+#define EXPORT_MVT_GEOM_POLYGON		3
+
+/* MVT layer names, for each geometry type (GEOM_TYPE_*) */
+static const char EXPORT_MVT_LAYER_NAMES[][12] =
+{ "points", "lines", "polygons", "vertices", "" };
+
+/*
+ * One feature to be written into vector tiles. All coordinates
+ * are normalised Web Mercator coordinates (0.0 to 1.0, from the
+ * top left corner of the world).
+ */
+typedef struct export_MVT_item export_MVT_item;
+struct export_MVT_item
+{
+	int GEOM_TYPE; /* geometry type (GEOM_TYPE_*) */
+	unsigned int pk; /* index of geometry in store */
+	unsigned int geom_id; /* value of "geom_id" attribute */
+	double x_min, y_min, x_max, y_max; /* 2D bounding box */
+	int num_rings; /* number of parts (lines) or rings (polygons) */
+	int *ring_len; /* number of vertices in each part or ring */
+	BOOLEAN *ring_outer; /* polygons: TRUE for outer rings (each followed by its holes) */
+	double *X; /* vertices of all parts/rings */
+	double *Y;
+	size_t props; /* offset of encoded properties (in shared buffer) */
+	size_t props_len; /* length of encoded properties */
+};
+
+/*
+ * A feature that overlaps a vector tile.
+ */
+typedef struct export_MVT_entry export_MVT_entry;
+struct export_MVT_entry
+{
+	unsigned long long tile; /* tile column (upper 32 bits) and row (lower 32 bits) */
+	unsigned int item; /* index of feature */
+};
+
+/*
+ * A list of vertices (in tile coordinates), for clipping.
+ */
+typedef struct export_MVT_points export_MVT_points;
+struct export_MVT_points
+{
+	double *X;
+	double *Y;
+	int num; /* number of vertices in list */
+	int max; /* number of vertices allocated */
+};
+
+/*
+ * The distinct attribute values of one vector tile layer,
+ * each one encoded as a "Value" message, and a hash table
+ * for finding them.
+ */
+typedef struct export_MVT_values export_MVT_values;
+struct export_MVT_values
+{
+	export_buf *data; /* all encoded values */
+	size_t *offset; /* start of each value in "data" */
+	size_t *len; /* length of each value */
+	int num; /* number of values */
+	int max; /* number of values allocated */
+	int *hash; /* hash table: value index + 1 or 0 for empty slots */
+	int hash_size; /* number of hash table slots (power of two) */
+};
+
+/*
+ * Arguments and results of one vector tile writer job.
+ */
+typedef struct export_MVT_job export_MVT_job;
+struct export_MVT_job
+{
+	int z; /* zoom level */
+	unsigned int x, y; /* tile column and row */
+	const export_MVT_entry *entries; /* features that overlap this tile */
+	int num_entries; /* number of entries */
+	const export_MVT_item *items; /* all features (read-only) */
+	const export_buf *props; /* encoded properties of all features (read-only) */
+	const char **keys; /* names of all properties (read-only) */
+	const unsigned char *types; /* types of all properties (EXPORT_FGB_COL_*; read-only) */
+	int num_keys; /* number of property names */
+	const char *path; /* output directory (tile pyramid root) */
+	BOOLEAN written; /* TRUE if tile was written (result) */
+	err_queue messages; /* messages produced while writing this tile */
+};
+
 /* export all data stores to SHP */
 int export_SHP ( geom_store *gs, parser_desc *parser, options *opts );
 
+/* restore a Shapefile and its attribute table to the sizes of an earlier run */
+int export_SHP_rollback ( const char *shp_path, const char *dbf_path,
+		long shp_size, long shx_size, long dbf_size );
+
 /* export all data stores to DXF */
 int export_DXF ( geom_store *gs, parser_desc *parser, options *opts );
 
 /* export all data stores to GeoJSON */
 int export_GeoJSON ( geom_store *gs, parser_desc *parser, options *opts );
 
+/* export all data stores to GeoJSON text sequence (one feature per line) */
+int export_GeoJSONSeq ( geom_store *gs, parser_desc *parser, options *opts );
+
 /* export all data stores to KML */
 int export_KML ( geom_store *gs, parser_desc *parser, options *opts );
 
+/* export all data stores to FlatGeobuf */
+int export_FGB ( geom_store *gs, parser_desc *parser, options *opts );
+
+/* export all data stores to a pyramid of Mapbox Vector Tiles */
+int export_MVT ( geom_store *gs, parser_desc *parser, options *opts );
+
 #endif /* EXPORT_H */
@@ -71,6 +71,20 @@ int inc_geom_id (parser_data_store *storage, int i) {
 }
 
 
+/* Returns the geom ID that will be assigned to the next geometry. */
+unsigned int geom_get_next_id ( void ) {
+	return (GEOM_ID);
+}
+
+
+/* Sets the geom ID to assign to the next geometry. This is used
+ * to continue the numbering of an earlier run (incremental mode).
+ */
+void geom_set_next_id ( unsigned int id ) {
+	GEOM_ID = id;
+}
+
+
 /* Merges (multiplexes) data within one storage object into geometry sets,
  * using mode "end". In this mode, every measurement of a line or polygon
  * must be concluded with a geometry marker. The marker must be part of the
@@ -96,7 +110,7 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 
 	for (i = 0; i < storage->slot; i++) {
 		/* multiplex valid geometries only */
-		if (storage->records[i].is_valid == TRUE) {
+		if ( storage->flags[i] & PARSER_RECORD_VALID ) {
 			/* look for geometry tag */
 			if (storage->records[i].tag != NULL) {
 				if (DEBUG == TRUE) {
@@ -112,8 +126,8 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 					if (DEBUG == TRUE)
 						fprintf(stderr, "GEOM M'PLEX: found POINT tag \n");
 					/* make this a single-point geometry */
-					storage->records[i].geom_id = GEOM_ID;
-					storage->records[i].geom_type = GEOM_TYPE_POINT;
+					storage->geom_id[i] = GEOM_ID;
+					storage->geom_type[i] = GEOM_TYPE_POINT;
 					storage->num_points++;
 					num_multiplexed ++;
 					if ( inc_geom_id (storage,i) < 0 ) return ( -1 );
@@ -140,14 +154,14 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 							abort = FALSE;
 
 							while (abort == FALSE && j >= 0
-									&& storage->records[j].is_valid == TRUE
+									&& ( storage->flags[j] & PARSER_RECORD_VALID )
 									&& !strcmp(p, storage->records[j].key)) {
 								if (j < i && storage->records[j].tag != NULL) {
 									/* abort if another tag was found */
 									abort = TRUE;
 								} else {
 									vertices++;
-									storage->records[j].geom_id = GEOM_ID;
+									storage->geom_id[j] = GEOM_ID;
 									if ( j == 0 ) /* guard against unsigned int overflow! */
 										abort = TRUE;
 									j--;
@@ -158,7 +172,7 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 					/* line must have at least two vertices */
 					if (vertices >= 2) {
 						for (j = 0; j < vertices; j++) {
-							storage->records[i - j].geom_type
+							storage->geom_type[i - j]
 							= GEOM_TYPE_LINE;
 						}
 						if ( inc_geom_id (storage,i) < 0 ) return ( -1 );
@@ -179,9 +193,9 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 									storage->records[i].line);
 						}
 						/* invalidate records */
-						storage->records[i].is_valid = FALSE;
+						storage->flags[i] &= ~PARSER_RECORD_VALID;
 						for (j = 1; j < vertices; j++) {
-							storage->records[i - j].is_valid = FALSE;
+							storage->flags[i - j] &= ~PARSER_RECORD_VALID;
 						}
 					}
 				}
@@ -206,14 +220,14 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 							j = i;
 							abort = FALSE;
 							while (abort == FALSE && j >= 0
-									&& storage->records[j].is_valid == TRUE
+									&& ( storage->flags[j] & PARSER_RECORD_VALID )
 									&& !strcmp(p, storage->records[j].key)) {
 								if (j < i && storage->records[j].tag != NULL) {
 									/* abort if another tag was found */
 									abort = TRUE;
 								} else {
 									vertices++;
-									storage->records[j].geom_id = GEOM_ID;
+									storage->geom_id[j] = GEOM_ID;
 									if ( j == 0 ) /* guard against unsigned int overflow! */
 										abort = TRUE;
 									j--;
@@ -224,7 +238,7 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 					/* polygon must have at least three vertices */
 					if (vertices >= 3) {
 						for (j = 0; j < vertices; j++) {
-							storage->records[i - j].geom_type
+							storage->geom_type[i - j]
 							= GEOM_TYPE_POLY;
 						}
 						if ( inc_geom_id (storage,i) < 0 ) return ( -1 );
@@ -245,9 +259,9 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 									storage->records[i].line);
 						}
 						/* invalidate records */
-						storage->records[i].is_valid = FALSE;
+						storage->flags[i] &= ~PARSER_RECORD_VALID;
 						for (j = 1; j < vertices; j++) {
-							storage->records[i - j].is_valid = FALSE;
+							storage->flags[i - j] &= ~PARSER_RECORD_VALID;
 						}
 					}
 				}
@@ -258,14 +272,14 @@ int geom_multiplex_mode_end (parser_data_store *storage, parser_desc *parser) {
 	/* PASS 2: collect all untagged records that have not yet been assigned to a geometry */
 	for (i = 0; i < storage->slot; i++) {
 		/* multiplex valid geometries only */
-		if (storage->records[i].is_valid == TRUE) {
+		if ( storage->flags[i] & PARSER_RECORD_VALID ) {
 			/* look for geometry tag */
 			if (storage->records[i].tag == NULL) {
-				if (storage->records[i].geom_type == GEOM_TYPE_NONE) {
+				if (storage->geom_type[i] == GEOM_TYPE_NONE) {
 					/* action depends on whether we are running in strict mode or not */
 					if (parser->tag_strict == FALSE) {
-						storage->records[i].geom_id = GEOM_ID;
-						storage->records[i].geom_type = GEOM_TYPE_POINT;
+						storage->geom_id[i] = GEOM_ID;
+						storage->geom_type[i] = GEOM_TYPE_POINT;
 						storage->num_points++;
 						num_multiplexed ++;
 						if ( inc_geom_id (storage,i) < 0 ) return ( -1 );
@@ -345,8 +359,8 @@ int close_geometry ( 	BOOLEAN is_point, BOOLEAN is_line, BOOLEAN is_poly,
 				}
 				/* invalidate the entire geometry */
 				for (j = 0; j < num_vertices+skip; j++) {
-					storage->records[i - j].is_valid = FALSE;
-					storage->records[i - j].geom_id = -1;
+					storage->flags[i - j] &= ~PARSER_RECORD_VALID;
+					storage->geom_id[i - j] = -1;
 				}
 			}
 		} else {
@@ -366,8 +380,8 @@ int close_geometry ( 	BOOLEAN is_point, BOOLEAN is_line, BOOLEAN is_poly,
 			}
 			/* invalidate the entire geometry */
 			for (j = 0; j < num_vertices+skip; j++) {
-				storage->records[i - j].is_valid = FALSE;
-				storage->records[i - j].geom_id = -1;
+				storage->flags[i - j] &= ~PARSER_RECORD_VALID;
+				storage->geom_id[i - j] = -1;
 			}
 		}
 	}
@@ -381,15 +395,15 @@ int close_geometry ( 	BOOLEAN is_point, BOOLEAN is_line, BOOLEAN is_poly,
 			 * valid point lines that confuse the parser.
 			 * We keep those in and let the geometry builder
 			 * get rid of them afterwards. */
-			if ( storage->records[i - j].is_valid == TRUE ) { /* guard against rubbish lines */
-				storage->records[i - j].geom_type = GEOM_TYPE_POINT;
-				storage->records[i - j].geom_id = GEOM_ID;
+			if ( storage->flags[i - j] & PARSER_RECORD_VALID ) { /* guard against rubbish lines */
+				storage->geom_type[i - j] = GEOM_TYPE_POINT;
+				storage->geom_id[i - j] = GEOM_ID;
 			} else {
-				storage->records[i - j].geom_type = GEOM_TYPE_NONE;
-				storage->records[i - j].geom_id = -1;
+				storage->geom_type[i - j] = GEOM_TYPE_NONE;
+				storage->geom_id[i - j] = -1;
 			}
 		}
-		storage->records[i].geom_type = GEOM_TYPE_POINT;
+		storage->geom_type[i] = GEOM_TYPE_POINT;
 		storage->num_points++;
 		num_multiplexed ++;
 		if ( inc_geom_id (storage,i) < 0 ) return ( -1 );
@@ -414,17 +428,17 @@ int close_geometry ( 	BOOLEAN is_point, BOOLEAN is_line, BOOLEAN is_poly,
 			}
 			/* invalidate the entire geometry */
 			for (j = 0; j < num_vertices+skip; j++) {
-				storage->records[i - j].is_valid = FALSE;
-				storage->records[i - j].geom_id = -1;
+				storage->flags[i - j] &= ~PARSER_RECORD_VALID;
+				storage->geom_id[i - j] = -1;
 			}
 		} else {
 			for (j = 0; j < num_vertices+skip; j++) {
-				if ( storage->records[i - j].is_valid == TRUE ) { /* guard against rubbish lines */
-					storage->records[i - j].geom_type = GEOM_TYPE_LINE;
-					storage->records[i - j].geom_id = GEOM_ID;
+				if ( storage->flags[i - j] & PARSER_RECORD_VALID ) { /* guard against rubbish lines */
+					storage->geom_type[i - j] = GEOM_TYPE_LINE;
+					storage->geom_id[i - j] = GEOM_ID;
 				} else {
-					storage->records[i - j].geom_type = GEOM_TYPE_NONE;
-					storage->records[i - j].geom_id = -1;
+					storage->geom_type[i - j] = GEOM_TYPE_NONE;
+					storage->geom_id[i - j] = -1;
 				}
 			}
 			storage->num_lines++;
@@ -451,17 +465,17 @@ int close_geometry ( 	BOOLEAN is_point, BOOLEAN is_line, BOOLEAN is_poly,
 			}
 			/* invalidate the entire geometry */
 			for (j = 0; j < num_vertices+skip; j++) {
-				storage->records[i - j].is_valid = FALSE;
-				storage->records[i - j].geom_id = -1;
+				storage->flags[i - j] &= ~PARSER_RECORD_VALID;
+				storage->geom_id[i - j] = -1;
 			}
 		} else {
 			for (j = 0; j < num_vertices+skip; j++) {
-				if ( storage->records[i - j].is_valid == TRUE ) { /* guard against rubbish lines */
-					storage->records[i - j].geom_type = GEOM_TYPE_POLY;
-					storage->records[i - j].geom_id = GEOM_ID;
+				if ( storage->flags[i - j] & PARSER_RECORD_VALID ) { /* guard against rubbish lines */
+					storage->geom_type[i - j] = GEOM_TYPE_POLY;
+					storage->geom_id[i - j] = GEOM_ID;
 				} else {
-					storage->records[i - j].geom_type = GEOM_TYPE_NONE;
-					storage->records[i - j].geom_id = -1;
+					storage->geom_type[i - j] = GEOM_TYPE_NONE;
+					storage->geom_id[i - j] = -1;
 				}
 			}
 			storage->num_polygons++;
@@ -521,7 +535,7 @@ int geom_multiplex_mode_min (parser_data_store *storage, parser_desc *parser) {
 	skip = 0;
 
 	for (i = 0; i < storage->slot; i++) {
-		if (storage->records[i].is_valid == TRUE) {
+		if ( storage->flags[i] & PARSER_RECORD_VALID ) {
 			BOOLEAN is_complete = FALSE;
 			BOOLEAN is_reduced = FALSE;
 			/* Multiplex only valid geometries.
@@ -571,7 +585,7 @@ int geom_multiplex_mode_min (parser_data_store *storage, parser_desc *parser) {
 			if ( is_reduced == FALSE && is_complete == FALSE ) {
 				/* Invalid line!? Skip! */
 				skip ++;
-				storage->records[i].is_valid = FALSE;
+				storage->flags[i] &= ~PARSER_RECORD_VALID;
 				err_show (ERR_NOTE,"");
 				if (strcmp(storage->input, "-") != 0) {
 					err_show (ERR_WARN,
@@ -612,7 +626,7 @@ int geom_multiplex_mode_min (parser_data_store *storage, parser_desc *parser) {
 				} else {
 					if ( open ) {
 						/* add one vertex to currently open geometry */
-						storage->records[i].geom_id = GEOM_ID;
+						storage->geom_id[i] = GEOM_ID;
 						num_vertices ++;
 						/*
 						if ( DEBUG ) {
@@ -788,15 +802,15 @@ int geom_multiplex_mode_max (parser_data_store *storage, parser_desc *parser) {
 	/* loop over all (potentially) allocated data slots in the current geometry store */
 	for (i = 0; i < storage->slot; i++) {
 		/* multiplex valid geometries only */
-		if (storage->records[i].is_valid == TRUE) {
+		if ( storage->flags[i] & PARSER_RECORD_VALID ) {
 
 			/* DEBUG */
 			/*
 			if ( DEBUG == TRUE ) {
-				fprintf ( stderr, "DEBUG: [%d] {%f, %f, %f} tag='%s' key='%s' valid=%i empty=%i\n",
-						i, storage->records[i].x, storage->records[i].y, storage->records[i].z,
+				fprintf ( stderr, "DEBUG: [%d] {%f, %f, %f} tag='%s' key='%s' flags=%i\n",
+						i, storage->x[i], storage->y[i], storage->z[i],
 						storage->records[i].tag, storage->records[i].key,
-						storage->records[i].is_valid, storage->records[i].is_empty);
+						storage->flags[i]);
 			}
 			 */
 
@@ -825,8 +839,8 @@ int geom_multiplex_mode_max (parser_data_store *storage, parser_desc *parser) {
 						fprintf ( stderr, "GEOM ID = %d\n", GEOM_ID);
 					}
 					 */
-					storage->records[i].geom_id = GEOM_ID;
-					storage->records[i].geom_type = GEOM_TYPE_POINT;
+					storage->geom_id[i] = GEOM_ID;
+					storage->geom_type[i] = GEOM_TYPE_POINT;
 					storage->num_points++;
 					num_multiplexed ++;
 					/*
@@ -863,7 +877,7 @@ int geom_multiplex_mode_max (parser_data_store *storage, parser_desc *parser) {
 							/* this is the first vertex of the first complex geometry */
 							last_key = storage->records[i].key;
 							last_tag = storage->records[i].tag;
-							storage->records[i].geom_id = GEOM_ID;
+							storage->geom_id[i] = GEOM_ID;
 							/*
 							if ( DEBUG ) {
 								num_vertices ++;
@@ -877,9 +891,9 @@ int geom_multiplex_mode_max (parser_data_store *storage, parser_desc *parser) {
 							 */
 							if ( parser_is_tag ( parser, PARSER_GEOM_TAG_LINE, (const char*)storage->records[i].tag )) {
 							//if ( !strcmp(storage->records[i].tag, parser->geom_tag_line) ) { DELETE ME
-								storage->records[i].geom_type = GEOM_TYPE_LINE;
+								storage->geom_type[i] = GEOM_TYPE_LINE;
 							} else {
-								storage->records[i].geom_type = GEOM_TYPE_POLY;
+								storage->geom_type[i] = GEOM_TYPE_POLY;
 							}
 							open = TRUE;
 						} else {
@@ -892,7 +906,7 @@ int geom_multiplex_mode_max (parser_data_store *storage, parser_desc *parser) {
 									parser_is_tag ( parser, PARSER_GEOM_TAG_POLY, (const char*)storage->records[i].tag ))
 								) {
 								last_tag = storage->records[i].tag;
-								storage->records[i].geom_id = GEOM_ID;
+								storage->geom_id[i] = GEOM_ID;
 								/*
 								if ( DEBUG ) {
 									num_vertices ++;
@@ -907,9 +921,9 @@ int geom_multiplex_mode_max (parser_data_store *storage, parser_desc *parser) {
 								 */
 								if ( parser_is_tag ( parser, PARSER_GEOM_TAG_LINE, (const char*)storage->records[i].tag )) {
 								//if ( !strcmp(storage->records[i].tag, parser->geom_tag_line) ) { DELETE ME
-									storage->records[i].geom_type = GEOM_TYPE_LINE;
+									storage->geom_type[i] = GEOM_TYPE_LINE;
 								} else {
-									storage->records[i].geom_type = GEOM_TYPE_POLY;
+									storage->geom_type[i] = GEOM_TYPE_POLY;
 								}
 								open = TRUE;
 							} else {
@@ -998,15 +1012,15 @@ int geom_multiplex_mode_none (parser_data_store *storage, parser_desc *parser) {
 
 	for (i = 0; i < storage->slot; i++) {
 		/* multiplex valid geometries only */
-		if (storage->records[i].is_valid == TRUE) {
+		if ( storage->flags[i] & PARSER_RECORD_VALID ) {
 			/*
 			if ( DEBUG ) {
 				fprintf (stderr,"[%i] POINT.\n", storage->records[i].line);
 			}
 			 */
 			/* make this a single-point geometry */
-			storage->records[i].geom_id = GEOM_ID;
-			storage->records[i].geom_type = GEOM_TYPE_POINT;
+			storage->geom_id[i] = GEOM_ID;
+			storage->geom_type[i] = GEOM_TYPE_POINT;
 			storage->num_points++;
 			num_multiplexed ++;
 			if ( inc_geom_id (storage,i) < 0 ) return ( -1 );
@@ -1060,19 +1074,19 @@ int geom_multiplex(parser_data_store *storage, parser_desc *parser) {
 	/*
 	if (DEBUG == TRUE) {
 		for (i = 0; i < storage->num_records; i++) {
-			if (storage->records[i].is_empty == FALSE) {
-				if (storage->records[i].is_valid == FALSE) {
+			if (!( storage->flags[i] & PARSER_RECORD_EMPTY )) {
+				if (!( storage->flags[i] & PARSER_RECORD_VALID )) {
 					fprintf(stderr, "[%i, %s] = INVALID\n", i + 1,
 							storage->records[i].contents[0]);
 				} else {
-					if (storage->records[i].geom_type == GEOM_TYPE_NONE) {
+					if (storage->geom_type[i] == GEOM_TYPE_NONE) {
 						fprintf(stderr, "[%i, %s] = UNASSIGNED\n", i + 1,
 								storage->records[i].contents[0]);
 					} else {
 						fprintf(stderr, "[%i, %s] = %s [%i]\n", i + 1,
 								storage->records[i].contents[0],
-								GEOM_TYPE_NAMES[storage->records[i].geom_type],
-								storage->records[i].geom_id);
+								GEOM_TYPE_NAMES[storage->geom_type[i]],
+								storage->geom_id[i]);
 					}
 				}
 			}
@@ -1332,6 +1346,35 @@ void geom_store_free_paths ( geom_store *gs )
 }
 
 
+/*
+ * Makes "view" share all geometries of "gs", but with output
+ * paths of its own (initially none). This allows writing the
+ * same geometries to more than one output format.
+ *
+ * The view must not outlive "gs". Release it with
+ * geom_store_free_paths() only: the geometries are still
+ * owned (and eventually destroyed) by "gs".
+ */
+void geom_store_view ( geom_store *view, geom_store *gs )
+{
+	*view = *gs;
+
+	view->path_points = NULL;
+	view->path_points_atts = NULL;
+	view->path_points_raw = NULL;
+	view->path_points_raw_atts = NULL;
+	view->path_lines = NULL;
+	view->path_lines_atts = NULL;
+	view->path_polys = NULL;
+	view->path_polys_atts = NULL;
+	view->path_all = NULL;
+	view->path_all_atts = NULL;
+	view->path_labels = NULL;
+	view->path_labels_atts = NULL;
+	view->path_labels_gva = NULL;
+}
+
+
 /*
  * Create output paths for Shapefile format output.
  *
@@ -1452,7 +1495,8 @@ int geom_store_make_paths_shp ( geom_store *gs, options *opts, char *error )
 	/* This is assuming that we have at least one output file! */
 	if ( check_path != NULL ) {
 		errno = 0;
-		FILE *check = t_fopen_utf8 ( check_path, "w" );
+		/* in incremental mode, existing output must be kept */
+		FILE *check = t_fopen_utf8 ( check_path, opts->incremental == TRUE ? "a" : "w" );
 		if ( check == NULL ) {
 			err_show (ERR_NOTE,"");
 			if ( errno != 0 ) {
@@ -1660,6 +1704,113 @@ int geom_store_make_paths_kml ( geom_store *gs, options *opts, char *error )
 }
 
 
+/*
+ * Create output path for formats that store all geometry types
+ * in one file with the file name extension "ext" (e.g. ".fgb").
+ *
+ * Returns "0" if OK, "-1" on error.
+ * In addition, if error is non-NULL, then a precise
+ * description of the error will be stored in the _pre-allocated_
+ * memory pointed to by "error".
+ */
+int geom_store_make_paths_all ( geom_store *gs, options *opts, const char *ext, char *error )
+{
+	char fs[3];
+	int len;
+	char *check_path;
+	FILE *check;
+
+
+	/* create output paths */
+	fs[0] = PRG_FILE_SEPARATOR;
+	fs[1] = '\0';
+	len = strlen ( opts->output ) + strlen ( fs ) + strlen ( opts->base ) + strlen ( "_" )
+										+ strlen (GEOM_TYPE_NAMES[GEOM_TYPE_ALL])  + strlen (ext) + 1;
+	gs->path_all = malloc ( sizeof ( char ) * len);
+	gs->path_all[0] = '\0';
+	strcat ( gs->path_all, opts->output );
+	strcat ( gs->path_all, fs );
+	strcat ( gs->path_all, opts->base );
+	strcat ( gs->path_all, "_" );
+	strcat ( gs->path_all, GEOM_TYPE_NAMES[GEOM_TYPE_ALL] );
+	strcat ( gs->path_all, ext );
+
+	/* check if output path is writeable */
+	check_path = gs->path_all;
+
+	errno = 0;
+	/* in incremental mode, existing output must be kept */
+	check = t_fopen_utf8 ( check_path, opts->incremental == TRUE ? "a" : "w" );
+	if ( check == NULL ) {
+		err_show (ERR_NOTE,"");
+		if ( errno != 0 ) {
+			if ( error != NULL ) {
+				snprintf ( error, PRG_MAX_STR_LEN, "%s (%s).", strerror (errno), opts->output );
+			}
+			geom_store_free_paths (gs);
+			return (-1);
+		}
+		else {
+			if ( error != NULL ) {
+				snprintf ( error, PRG_MAX_STR_LEN, _("Cannot write output into '%s'.\nCheck that the directory exists and is writable."),
+						opts->output );
+			}
+			geom_store_free_paths (gs);
+			return (-1);
+		}
+	}
+	fclose ( check );
+
+	return ( 0 );
+}
+
+
+/*
+ * Creates the output path for a vector tile pyramid: a directory
+ * named like the single output file of formats that store all
+ * geometry types together (see geom_store_make_paths_all()),
+ * but without extension. The directory is created here (if it
+ * does not exist yet), which also checks that it is writable.
+ *
+ * Returns -1 on error, 0 otherwise.
+ */
+int geom_store_make_paths_tiles ( geom_store *gs, options *opts, char *error )
+{
+	char fs[3];
+	int len;
+
+
+	fs[0] = PRG_FILE_SEPARATOR;
+	fs[1] = '\0';
+	len = strlen ( opts->output ) + strlen ( fs ) + strlen ( opts->base ) + strlen ( "_" )
+										+ strlen (GEOM_TYPE_NAMES[GEOM_TYPE_ALL]) + 1;
+	gs->path_all = malloc ( sizeof ( char ) * len);
+	gs->path_all[0] = '\0';
+	strcat ( gs->path_all, opts->output );
+	strcat ( gs->path_all, fs );
+	strcat ( gs->path_all, opts->base );
+	strcat ( gs->path_all, "_" );
+	strcat ( gs->path_all, GEOM_TYPE_NAMES[GEOM_TYPE_ALL] );
+
+	errno = 0;
+	if ( t_mkdir_utf8 ( gs->path_all ) != 0 ) {
+		err_show (ERR_NOTE,"");
+		if ( error != NULL ) {
+			if ( errno != 0 ) {
+				snprintf ( error, PRG_MAX_STR_LEN, "%s (%s).", strerror (errno), gs->path_all );
+			} else {
+				snprintf ( error, PRG_MAX_STR_LEN, _("Cannot write output into '%s'.\nCheck that the directory exists and is writable."),
+						opts->output );
+			}
+		}
+		geom_store_free_paths (gs);
+		return (-1);
+	}
+
+	return ( 0 );
+}
+
+
 /*
  * Create output file names for geometries and attributes,
  * based on output file format.
@@ -1689,6 +1840,18 @@ int geom_store_make_paths ( geom_store *gs, options *opts, char *error )
 		result = geom_store_make_paths_kml ( gs, opts, error );
 	}
 
+	if ( !strcasecmp (PRG_OUTPUT_DESC[opts->format], PRG_OUTPUT_DESC[PRG_OUTPUT_FGB]) ) {
+		result = geom_store_make_paths_all ( gs, opts, ".fgb", error );
+	}
+
+	if ( !strcasecmp (PRG_OUTPUT_DESC[opts->format], PRG_OUTPUT_DESC[PRG_OUTPUT_GEOJSONL]) ) {
+		result = geom_store_make_paths_all ( gs, opts, ".geojsonl", error );
+	}
+
+	if ( !strcasecmp (PRG_OUTPUT_DESC[opts->format], PRG_OUTPUT_DESC[PRG_OUTPUT_MVT]) ) {
+		result = geom_store_make_paths_tiles ( gs, opts, error );
+	}
+
 	return ( result );
 }
 
@@ -3987,7 +4150,7 @@ int geom_store_build ( 	geom_store *gs, parser_data_store **ds,
 		parser_desc *parser, options *opts)
 {
 	double *X,*Y,*Z;
-	parser_record *rec, *vertex, *first;
+	parser_record *rec;
 	unsigned int m, i, j, k;
 	unsigned int num_errors;
 	char error[PRG_MAX_STR_LEN];
@@ -4008,8 +4171,8 @@ int geom_store_build ( 	geom_store *gs, parser_data_store **ds,
 		else {
 			/* go through records in data store and write them to output */
 			for ( i = 0; i < ds[m]->num_records; i++) {
-				if ( 	ds[m]->records[i].is_empty == FALSE && ds[m]->records[i].is_valid == TRUE &&
-						ds[m]->records[i].geom_type != GEOM_TYPE_NONE && ds[m]->records[i].written_out == FALSE )
+				if ( 	!( ds[m]->flags[i] & PARSER_RECORD_EMPTY ) && ( ds[m]->flags[i] & PARSER_RECORD_VALID ) &&
+						ds[m]->geom_type[i] != GEOM_TYPE_NONE && !( ds[m]->flags[i] & PARSER_RECORD_WRITTEN_OUT ) )
 				{
 					rec = &ds[m]->records[i];
 
@@ -4018,8 +4181,8 @@ int geom_store_build ( 	geom_store *gs, parser_data_store **ds,
 						 * of vertex and write it out as a simple point.
 						 */
 						/* RAW POINTS */
-						if ( rec->geom_type == GEOM_TYPE_POINT ) {
-							if ( geom_store_add_point_raw ( gs, parser, rec->geom_id, rec->x, rec->y, rec->z,
+						if ( ds[m]->geom_type[i] == GEOM_TYPE_POINT ) {
+							if ( geom_store_add_point_raw ( gs, parser, ds[m]->geom_id[i], ds[m]->x[i], ds[m]->y[i], ds[m]->z[i],
 									rec->part_id,
 									rec->contents, ds[m]->input, rec->line,
 									TRUE, error, opts )
@@ -4033,57 +4196,53 @@ int geom_store_build ( 	geom_store *gs, parser_data_store **ds,
 							}
 						}
 						/* RAW LINE VERTICES (AS POINTS) */
-						if ( rec->geom_type == GEOM_TYPE_LINE ) {
+						if ( ds[m]->geom_type[i] == GEOM_TYPE_LINE ) {
 							j = i;
-							vertex = rec;
 							while ( j < ds[m]->num_records &&
-									vertex->geom_id == rec->geom_id )
+									ds[m]->geom_id[j] == ds[m]->geom_id[i] )
 							{
-								if ( geom_store_add_point_raw ( gs, parser, rec->geom_id, vertex->x, vertex->y, vertex->z,
-										vertex->part_id,
-										vertex->contents, ds[m]->input, vertex->line,
+								if ( geom_store_add_point_raw ( gs, parser, ds[m]->geom_id[i], ds[m]->x[j], ds[m]->y[j], ds[m]->z[j],
+										ds[m]->records[j].part_id,
+										ds[m]->records[j].contents, ds[m]->input, ds[m]->records[j].line,
 										TRUE, error, opts )
 										== FALSE ) {
 									err_show (ERR_NOTE,"");
 									err_show (ERR_WARN, _("\nCould not store line vertex from '%s', line %i.\nReason: %s"),
-											ds[m]->input, vertex->line, error );
+											ds[m]->input, ds[m]->records[j].line, error );
 									num_errors ++;
 								} else {
 									gs->is_empty = FALSE;
 								}
 								j ++;
-								vertex ++;
 							}
 						}
 						/* RAW POLYGON VERTICES (AS POINTS) */
-						if ( rec->geom_type == GEOM_TYPE_POLY ) {
+						if ( ds[m]->geom_type[i] == GEOM_TYPE_POLY ) {
 							j = i;
-							vertex = rec;
 							while ( j < ds[m]->num_records &&
-									vertex->geom_id == rec->geom_id )
+									ds[m]->geom_id[j] == ds[m]->geom_id[i] )
 							{
-								if ( geom_store_add_point_raw ( gs, parser, rec->geom_id, vertex->x, vertex->y, vertex->z,
-										vertex->part_id,
-										vertex->contents, ds[m]->input, vertex->line,
+								if ( geom_store_add_point_raw ( gs, parser, ds[m]->geom_id[i], ds[m]->x[j], ds[m]->y[j], ds[m]->z[j],
+										ds[m]->records[j].part_id,
+										ds[m]->records[j].contents, ds[m]->input, ds[m]->records[j].line,
 										TRUE, error, opts )
 										== FALSE ) {
 									err_show (ERR_NOTE,"");
 									err_show (ERR_WARN, _("\nCould not store polygon vertex from '%s', line %i.\nReason: %s"),
-											ds[m]->input, vertex->line, error );
+											ds[m]->input, ds[m]->records[j].line, error );
 									num_errors ++;
 								} else {
 									gs->is_empty = FALSE;
 								}
 								j ++;
-								vertex ++;
 							}
 						}
 					}
 
 					/* POINTS */
-					if ( rec->geom_type == GEOM_TYPE_POINT ) {
+					if ( ds[m]->geom_type[i] == GEOM_TYPE_POINT ) {
 						/* write geometry data */
-						if ( geom_store_add_point ( gs, parser, rec->geom_id, rec->x, rec->y, rec->z,
+						if ( geom_store_add_point ( gs, parser, ds[m]->geom_id[i], ds[m]->x[i], ds[m]->y[i], ds[m]->z[i],
 								rec->part_id,
 								rec->contents, ds[m]->input, rec->line,
 								TRUE, error, opts )
@@ -4095,42 +4254,38 @@ int geom_store_build ( 	geom_store *gs, parser_data_store **ds,
 						} else {
 							gs->is_empty = FALSE;
 						}
-						rec->written_out = TRUE;
+						ds[m]->flags[i] |= PARSER_RECORD_WRITTEN_OUT;
 					}
 
 					/* LINES */
-					if ( rec->geom_type == GEOM_TYPE_LINE ) {
+					if ( ds[m]->geom_type[i] == GEOM_TYPE_LINE ) {
 						/* pass 1: get number of vertices */
 						j = i;
 						k = 0;
-						vertex = rec;
 						while ( j < ds[m]->num_records &&
-								vertex->geom_id == rec->geom_id &&
-								vertex->part_id == rec->part_id )
+								ds[m]->geom_id[j] == ds[m]->geom_id[i] &&
+								ds[m]->records[j].part_id == rec->part_id )
 						{
-							if ( vertex->is_valid == TRUE )
+							if ( ds[m]->flags[j] & PARSER_RECORD_VALID )
 								k ++;
 							j ++;
-							vertex ++;
 						}
 						/* pass 2: convert vertices to array of doubles */
 						X = malloc ( sizeof (double) * k ); Y = malloc ( sizeof (double) * k ); Z = malloc ( sizeof (double) * k );
 						j = i;
 						k = 0;
-						vertex = rec;
 						while ( j < ds[m]->num_records &&
-								vertex->geom_id == rec->geom_id &&
-								vertex->part_id == rec->part_id )
+								ds[m]->geom_id[j] == ds[m]->geom_id[i] &&
+								ds[m]->records[j].part_id == rec->part_id )
 						{
-							if ( vertex->is_valid == TRUE ) {
-								X[k] = vertex->x; Y[k] = vertex->y; Z[k] = vertex->z;
-								vertex->written_out = TRUE;
+							if ( ds[m]->flags[j] & PARSER_RECORD_VALID ) {
+								X[k] = ds[m]->x[j]; Y[k] = ds[m]->y[j]; Z[k] = ds[m]->z[j];
+								ds[m]->flags[j] |= PARSER_RECORD_WRITTEN_OUT;
 								k ++;
 							}
 							j ++;
-							vertex ++;
 						}
-						if ( geom_store_add_line ( gs, parser, rec->geom_id, k, X, Y, Z,
+						if ( geom_store_add_line ( gs, parser, ds[m]->geom_id[i], k, X, Y, Z,
 								rec->part_id,
 								rec->contents, ds[m]->input, rec->line,
 								TRUE, error, opts )
@@ -4146,43 +4301,36 @@ int geom_store_build ( 	geom_store *gs, parser_data_store **ds,
 					}
 
 					/* POLYGONS */
-					if ( rec->geom_type == GEOM_TYPE_POLY ) {
+					if ( ds[m]->geom_type[i] == GEOM_TYPE_POLY ) {
 						/* pass 1: get number of vertices */
 						j = i;
 						k = 0;
-						vertex = rec;
 						while ( j < ds[m]->num_records &&
-								vertex->geom_id == rec->geom_id &&
-								vertex->part_id == rec->part_id )
+								ds[m]->geom_id[j] == ds[m]->geom_id[i] &&
+								ds[m]->records[j].part_id == rec->part_id )
 						{
-							if ( vertex->is_valid == TRUE )
+							if ( ds[m]->flags[j] & PARSER_RECORD_VALID )
 								k ++;
 							j ++;
-							vertex ++;
 						}
 						/* pass 2: convert vertices to array of doubles */
 						X = malloc ( sizeof (double) * (k+1) ); Y = malloc ( sizeof (double) * (k+1) ); Z = malloc ( sizeof (double) * (k+1) );
 						j = i;
 						k = 0;
-						vertex = rec;
-						first = NULL;
 						while ( j < ds[m]->num_records &&
-								vertex->geom_id == rec->geom_id &&
-								vertex->part_id == rec->part_id )
+								ds[m]->geom_id[j] == ds[m]->geom_id[i] &&
+								ds[m]->records[j].part_id == rec->part_id )
 						{
-							if ( first == NULL )
-								first = vertex; /* remember first vertex */
-							if ( vertex->is_valid == TRUE ) {
-								X[k] = vertex->x; Y[k] = vertex->y; Z[k] = vertex->z;
-								vertex->written_out = TRUE;
+							if ( ds[m]->flags[j] & PARSER_RECORD_VALID ) {
+								X[k] = ds[m]->x[j]; Y[k] = ds[m]->y[j]; Z[k] = ds[m]->z[j];
+								ds[m]->flags[j] |= PARSER_RECORD_WRITTEN_OUT;
 								k ++;
 							}
 							j ++;
-							vertex ++;
 						}
 						/* original Shapefile specs demand that last vertex = first vertex */
-						X[k] = first->x; Y[k] = first->y; Z[k] = first->z;
-						if ( geom_store_add_poly ( gs, parser, rec->geom_id, k+1, X, Y, Z,
+						X[k] = ds[m]->x[i]; Y[k] = ds[m]->y[i]; Z[k] = ds[m]->z[i];
+						if ( geom_store_add_poly ( gs, parser, ds[m]->geom_id[i], k+1, X, Y, Z,
 								rec->part_id,
 								rec->contents, ds[m]->input, rec->line,
 								TRUE, error, opts )
@@ -4345,8 +4493,8 @@ void geom_topology_invalidate(parser_data_store *ds, options *opts) {
 		return;
 
 	for (i = 0; i < ds->num_records; i++) {
-		ds->records[i].geom_id = 0;
-		ds->records[i].geom_type = GEOM_TYPE_NONE;
+		ds->geom_id[i] = 0;
+		ds->geom_type[i] = GEOM_TYPE_NONE;
 		ds->num_points = 0;
 		ds->num_lines = 0;
 		ds->num_polygons = 0;
@@ -4397,108 +4545,104 @@ int geom_topology_remove_duplicates ( parser_data_store *ds, options *opts, BOOL
 	/* go backwards through all valid geometries and remove duplicate vertices */
 	int i;
 	for (i = ds->num_records - 1; i >= 0; i--) {
-		parser_record *rec = &ds->records[i];
-		if (rec->is_empty == FALSE && rec->is_valid == TRUE && rec->geom_type != GEOM_TYPE_NONE)
+		if (!( ds->flags[i] & PARSER_RECORD_EMPTY ) && ( ds->flags[i] & PARSER_RECORD_VALID ) && ds->geom_type[i] != GEOM_TYPE_NONE)
 		{
 			/* points */
-			if (rec->geom_type == GEOM_TYPE_POINT) {
+			if (ds->geom_type[i] == GEOM_TYPE_POINT) {
 				/* go through all other point geometries and make sure there are no duplicates */
 				int j;
 				for (j = 0; j < ds->num_records; j++) {
-					parser_record *comp = &ds->records[j];
-					if (comp->is_empty == FALSE && comp->is_valid == TRUE
-							&& comp->geom_type == GEOM_TYPE_POINT && comp
-							!= rec) {
+					if (!( ds->flags[j] & PARSER_RECORD_EMPTY ) && ( ds->flags[j] & PARSER_RECORD_VALID )
+							&& ds->geom_type[j] == GEOM_TYPE_POINT && j
+							!= i) {
 						/* invalidate this point if it is a duplicate (always use 3D distance for points) */
-						d = (sqrt(pow((rec->x - comp->x), 2) + pow((rec->y - comp->y), 2) + pow((rec->z - comp->z), 2)));
+						d = (sqrt(pow((ds->x[i] - ds->x[j]), 2) + pow((ds->y[i] - ds->y[j]), 2) + pow((ds->z[i] - ds->z[j]), 2)));
 						if (d <= opts->tolerance) {
 							err_show(ERR_NOTE, "");
 							if ( d == 0.0 ) {
 								err_show(
 										ERR_WARN,
 										_("\nPoint read from '%s' (line %i) failed topology check:\nCoordinates are identical with line %i (tolerance=%f).\nPoint deleted."),
-										input, comp->line, rec->line, opts->tolerance);
+										input, ds->records[j].line, ds->records[i].line, opts->tolerance);
 							} else {
 								err_show(
 										ERR_WARN,
 										_("\nPoint read from '%s' (line %i) failed topology check:\nCoordinates too close to line %i (tolerance=%f).\nPoint deleted."),
-										input, comp->line, rec->line, opts->tolerance);
+										input, ds->records[j].line, ds->records[i].line, opts->tolerance);
 							}
-							comp->is_valid = FALSE;
+							ds->flags[j] &= ~PARSER_RECORD_VALID;
 							count++;
 						}
 					}
 				}
 			}
 			/* lines */
-			if (rec->geom_type == GEOM_TYPE_LINE) {
+			if (ds->geom_type[i] == GEOM_TYPE_LINE) {
 				int j;
 				for (j = 0; j < ds->num_records; j++) {
 					/* check all vertices in the same line string */
-					parser_record *comp = &ds->records[j];
-					if (comp->is_empty == FALSE && comp->is_valid == TRUE
-							&& comp->geom_type == GEOM_TYPE_LINE
-							&& comp->geom_id == rec->geom_id && comp != rec ) {
+					if (!( ds->flags[j] & PARSER_RECORD_EMPTY ) && ( ds->flags[j] & PARSER_RECORD_VALID )
+							&& ds->geom_type[j] == GEOM_TYPE_LINE
+							&& ds->geom_id[j] == ds->geom_id[i] && j != i ) {
 						/* invalidate this point if it is a duplicate */
 						if ( in3D == TRUE )
-							d = (sqrt(pow((rec->x - comp->x), 2) + pow((rec->y
-									- comp->y), 2) + pow((rec->z - comp->z), 2)));
+							d = (sqrt(pow((ds->x[i] - ds->x[j]), 2) + pow((ds->y[i]
+									- ds->y[j]), 2) + pow((ds->z[i] - ds->z[j]), 2)));
 						else
-							d = (sqrt(pow((rec->x - comp->x), 2) + pow((rec->y
-									- comp->y), 2) ));
+							d = (sqrt(pow((ds->x[i] - ds->x[j]), 2) + pow((ds->y[i]
+									- ds->y[j]), 2) ));
 						if (d <= opts->tolerance) {
 							err_show(ERR_NOTE, "");
 							if ( d == 0.0 ) {
 								err_show(
 										ERR_WARN,
 										_("\nLine vertex read from '%s' (line %i) failed topology check:\nCoordinates are identical with line %i (tolerance=%f).\nVertex deleted."),
-										input, comp->line, rec->line,
+										input, ds->records[j].line, ds->records[i].line,
 										opts->tolerance);
 							} else {
 								err_show(
 										ERR_WARN,
 										_("\nLine vertex read from '%s' (line %i) failed topology check:\nCoordinates too close to line %i (tolerance=%f).\nVertex deleted."),
-										input, comp->line, rec->line,
+										input, ds->records[j].line, ds->records[i].line,
 										opts->tolerance);
 							}
-							comp->is_valid = FALSE;
+							ds->flags[j] &= ~PARSER_RECORD_VALID;
 							count++;
 						}
 					}
 				}
 			}
 			/* polygons */
-			if (rec->geom_type == GEOM_TYPE_POLY) {
+			if (ds->geom_type[i] == GEOM_TYPE_POLY) {
 				int j;
 				for (j = 0; j < ds->num_records; j++) {
-					parser_record *comp = &ds->records[j];
 					/* check all vertices in the same polygon */
-					if (comp->is_empty == FALSE && comp->is_valid == TRUE
-							&& comp->geom_type == GEOM_TYPE_POLY
-							&& comp->geom_id == rec->geom_id && comp != rec ) {
+					if (!( ds->flags[j] & PARSER_RECORD_EMPTY ) && ( ds->flags[j] & PARSER_RECORD_VALID )
+							&& ds->geom_type[j] == GEOM_TYPE_POLY
+							&& ds->geom_id[j] == ds->geom_id[i] && j != i ) {
 						/* invalidate this point if it is a duplicate */
 						if ( in3D == TRUE )
-							d = (sqrt(pow((rec->x - comp->x), 2) + pow((rec->y
-									- comp->y), 2) + pow((rec->z - comp->z), 2)));
+							d = (sqrt(pow((ds->x[i] - ds->x[j]), 2) + pow((ds->y[i]
+									- ds->y[j]), 2) + pow((ds->z[i] - ds->z[j]), 2)));
 						else
-							d = (sqrt(pow((rec->x - comp->x), 2) + pow((rec->y
-									- comp->y), 2) ));
+							d = (sqrt(pow((ds->x[i] - ds->x[j]), 2) + pow((ds->y[i]
+									- ds->y[j]), 2) ));
 						if (d <= opts->tolerance) {
 							err_show(ERR_NOTE, "");
 							if ( d == 0.0 ) {
 								err_show(
 										ERR_WARN,
 										_("\nPolygon vertex read from '%s' (line %i) failed topology check:\nCoordinates are identical with line %i (tolerance=%f).\nVertex deleted."),
-										input, comp->line, rec->line,
+										input, ds->records[j].line, ds->records[i].line,
 										opts->tolerance);
 							} else {
 								err_show(
 										ERR_WARN,
 										_("\nPolygon vertex read from '%s' (line %i) failed topology check:\nCoordinates too close to line %i (tolerance=%f).\nVertex deleted."),
-										input, comp->line, rec->line,
+										input, ds->records[j].line, ds->records[i].line,
 										opts->tolerance);
 							}
-							comp->is_valid = FALSE;
+							ds->flags[j] &= ~PARSER_RECORD_VALID;
 							count++;
 						}
 					}
@@ -4538,15 +4682,14 @@ int geom_topology_remove_splinters (unsigned int min, int geom_type,
 	/* go through all geometries and find the type we need */
 	unsigned int i;
 	for (i = 0; i < ds->num_records; i++) {
-		parser_record *rec = &ds->records[i];
-		if (rec->is_empty == FALSE && rec->is_valid == TRUE && rec->geom_type
+		if (!( ds->flags[i] & PARSER_RECORD_EMPTY ) && ( ds->flags[i] & PARSER_RECORD_VALID ) && ds->geom_type[i]
 				!= GEOM_TYPE_NONE) {
-			if (rec->geom_type == geom_type) {
+			if (ds->geom_type[i] == geom_type) {
 				vertices = 0;
 				unsigned int j;
 				for (j = 0; j < ds->num_records; j++) {
-					if (ds->records[j].geom_id == rec->geom_id
-							&& ds->records[j].is_valid == TRUE) {
+					if (ds->geom_id[j] == ds->geom_id[i]
+							&& ( ds->flags[j] & PARSER_RECORD_VALID )) {
 						vertices++;
 					}
 				}
@@ -4557,11 +4700,11 @@ int geom_topology_remove_splinters (unsigned int min, int geom_type,
 					err_show(
 							ERR_WARN,
 							_("\nLine or polygon read from '%s' (up to line %i) failed topology check:\nNot enough vertices. Geometry deleted."),
-							input, rec->line, rec->line);
+							input, ds->records[i].line, ds->records[i].line);
 					unsigned int j;
 					for (j = 0; j < ds->num_records; j++) {
-						if (ds->records[j].geom_id == rec->geom_id) {
-							ds->records[j].is_valid = FALSE;
+						if (ds->geom_id[j] == ds->geom_id[i]) {
+							ds->flags[j] &= ~PARSER_RECORD_VALID;
 						}
 					}
 					count++;
@@ -4719,6 +4862,226 @@ void geom_tools_update_bboxes ( geom_store *gs )
 }
 
 
+/*
+ * Returns the position of (x,y) on a Hilbert curve that fills
+ * a 2^16 x 2^16 grid. This is the same algorithm as used by the
+ * FlatGeobuf reference implementation (after "Fast Hilbert curve
+ * generation, sorting, and range queries" by Rawrunprotected).
+ */
+unsigned int geom_tools_hilbert ( unsigned int x, unsigned int y )
+{
+	unsigned int a = x ^ y;
+	unsigned int b = 0xFFFF ^ a;
+	unsigned int c = 0xFFFF ^ ( x | y );
+	unsigned int d = x & ( y ^ 0xFFFF );
+	unsigned int A = a | ( b >> 1 );
+	unsigned int B = ( a >> 1 ) ^ a;
+	unsigned int C = ( ( c >> 1 ) ^ ( b & ( d >> 1 ) ) ) ^ c;
+	unsigned int D = ( ( a & ( c >> 1 ) ) ^ ( d >> 1 ) ) ^ d;
+	unsigned int i0, i1;
+
+	a = A; b = B; c = C; d = D;
+	A = ( ( a & ( a >> 2 ) ) ^ ( b & ( b >> 2 ) ) );
+	B = ( ( a & ( b >> 2 ) ) ^ ( b & ( ( a ^ b ) >> 2 ) ) );
+	C ^= ( ( a & ( c >> 2 ) ) ^ ( b & ( d >> 2 ) ) );
+	D ^= ( ( b & ( c >> 2 ) ) ^ ( ( a ^ b ) & ( d >> 2 ) ) );
+
+	a = A; b = B; c = C; d = D;
+	A = ( ( a & ( a >> 4 ) ) ^ ( b & ( b >> 4 ) ) );
+	B = ( ( a & ( b >> 4 ) ) ^ ( b & ( ( a ^ b ) >> 4 ) ) );
+	C ^= ( ( a & ( c >> 4 ) ) ^ ( b & ( d >> 4 ) ) );
+	D ^= ( ( b & ( c >> 4 ) ) ^ ( ( a ^ b ) & ( d >> 4 ) ) );
+
+	a = A; b = B; c = C; d = D;
+	C ^= ( ( a & ( c >> 8 ) ) ^ ( b & ( d >> 8 ) ) );
+	D ^= ( ( b & ( c >> 8 ) ) ^ ( ( a ^ b ) & ( d >> 8 ) ) );
+
+	a = C ^ ( C >> 1 );
+	b = D ^ ( D >> 1 );
+
+	i0 = x ^ y;
+	i1 = b | ( 0xFFFF ^ ( i0 | a ) );
+
+	i0 = ( i0 | ( i0 << 8 ) ) & 0x00FF00FF;
+	i0 = ( i0 | ( i0 << 4 ) ) & 0x0F0F0F0F;
+	i0 = ( i0 | ( i0 << 2 ) ) & 0x33333333;
+	i0 = ( i0 | ( i0 << 1 ) ) & 0x55555555;
+
+	i1 = ( i1 | ( i1 << 8 ) ) & 0x00FF00FF;
+	i1 = ( i1 | ( i1 << 4 ) ) & 0x0F0F0F0F;
+	i1 = ( i1 | ( i1 << 2 ) ) & 0x33333333;
+	i1 = ( i1 | ( i1 << 1 ) ) & 0x55555555;
+
+	return ( ( i1 << 1 ) | i0 );
+}
+
+
+/*
+ * Position of one geometry on the Hilbert curve and its
+ * original index in the geometry store (for geom_store_sort_hilbert()).
+ */
+typedef struct geom_hilbert_key geom_hilbert_key;
+struct geom_hilbert_key
+{
+	unsigned int hilbert;
+	unsigned int idx;
+};
+
+
+/*
+ * Helper function for geom_tools_sort_hilbert() (below).
+ * Orders keys by Hilbert position, then by original index,
+ * so that the sort order is stable.
+ */
+int geom_tools_compare_hilbert ( const void *a, const void *b )
+{
+	const geom_hilbert_key *A = (const geom_hilbert_key*) a;
+	const geom_hilbert_key *B = (const geom_hilbert_key*) b;
+
+	if ( A->hilbert != B->hilbert ) {
+		return ( A->hilbert < B->hilbert ? -1 : 1 );
+	}
+	if ( A->idx != B->idx ) {
+		return ( A->idx < B->idx ? -1 : 1 );
+	}
+	return ( 0 );
+}
+
+
+/*
+ * Helper function for geom_store_sort_hilbert() (below).
+ * Sorts an array of "num" geometries of "size" bytes each by the Hilbert
+ * position of their centres "cx[]" and "cy[]", which are mapped to the
+ * Hilbert grid using "extent" (min. X, min. Y, max. X, max. Y).
+ */
+void geom_tools_sort_hilbert ( void *geoms, size_t size, unsigned int num,
+		const double *cx, const double *cy, const double *extent )
+{
+	geom_hilbert_key *keys;
+	char *copy;
+	double width = extent[2] - extent[0];
+	double height = extent[3] - extent[1];
+	unsigned int i;
+
+
+	if ( num < 2 ) {
+		return;
+	}
+
+	keys = malloc ( sizeof (geom_hilbert_key) * num );
+	for ( i = 0; i < num; i ++ ) {
+		unsigned int x = 0;
+		unsigned int y = 0;
+		if ( width > 0.0 ) {
+			x = (unsigned int) floor ( 65535.0 * ( cx[i] - extent[0] ) / width );
+		}
+		if ( height > 0.0 ) {
+			y = (unsigned int) floor ( 65535.0 * ( cy[i] - extent[1] ) / height );
+		}
+		keys[i].hilbert = geom_tools_hilbert ( x, y );
+		keys[i].idx = i;
+	}
+	qsort ( keys, num, sizeof (geom_hilbert_key), geom_tools_compare_hilbert );
+
+	/* move geometries into new order */
+	copy = malloc ( size * num );
+	memcpy ( copy, geoms, size * num );
+	for ( i = 0; i < num; i ++ ) {
+		memcpy ( (char*) geoms + ( size * i ), copy + ( size * keys[i].idx ), size );
+	}
+
+	free ( copy );
+	free ( keys );
+}
+
+
+/*
+ * Sorts the points, raw vertices, lines and polygons in "gs" along
+ * a Hilbert curve, so that geometries which are close to each other
+ * in space are also close to each other in the output. The curve is
+ * laid over the extent of all geometries, and each geometry is
+ * represented by its location (points) or the centre of its bounding
+ * box (lines and polygons).
+ *
+ * This only changes the order of geometries in their arrays, so it
+ * must be called after all topological operations that refer to
+ * geometries by their array index.
+ */
+void geom_store_sort_hilbert ( geom_store *gs )
+{
+	double *cx[GEOM_TYPE_ALL];
+	double *cy[GEOM_TYPE_ALL];
+	unsigned int num[GEOM_TYPE_ALL];
+	double extent[4];
+	BOOLEAN extent_set = FALSE;
+	unsigned int i;
+	int t;
+
+
+	if ( gs == NULL ) {
+		return;
+	}
+
+	num[GEOM_TYPE_POINT] = gs->num_points;
+	num[GEOM_TYPE_POINT_RAW] = gs->num_points_raw;
+	num[GEOM_TYPE_LINE] = gs->num_lines;
+	num[GEOM_TYPE_POLY] = gs->num_polygons;
+
+	/* geometry centres */
+	for ( t = 0; t < GEOM_TYPE_ALL; t ++ ) {
+		cx[t] = malloc ( sizeof (double) * ( num[t] + 1 ) );
+		cy[t] = malloc ( sizeof (double) * ( num[t] + 1 ) );
+	}
+	for ( i = 0; i < gs->num_points; i ++ ) {
+		cx[GEOM_TYPE_POINT][i] = gs->points[i].X;
+		cy[GEOM_TYPE_POINT][i] = gs->points[i].Y;
+	}
+	for ( i = 0; i < gs->num_points_raw; i ++ ) {
+		cx[GEOM_TYPE_POINT_RAW][i] = gs->points_raw[i].X;
+		cy[GEOM_TYPE_POINT_RAW][i] = gs->points_raw[i].Y;
+	}
+	for ( i = 0; i < gs->num_lines; i ++ ) {
+		cx[GEOM_TYPE_LINE][i] = ( gs->lines[i].bbox_x1 + gs->lines[i].bbox_x2 ) / 2.0;
+		cy[GEOM_TYPE_LINE][i] = ( gs->lines[i].bbox_y1 + gs->lines[i].bbox_y2 ) / 2.0;
+	}
+	for ( i = 0; i < gs->num_polygons; i ++ ) {
+		cx[GEOM_TYPE_POLY][i] = ( gs->polygons[i].bbox_x1 + gs->polygons[i].bbox_x2 ) / 2.0;
+		cy[GEOM_TYPE_POLY][i] = ( gs->polygons[i].bbox_y1 + gs->polygons[i].bbox_y2 ) / 2.0;
+	}
+
+	/* common extent of all geometry types */
+	for ( t = 0; t < GEOM_TYPE_ALL; t ++ ) {
+		for ( i = 0; i < num[t]; i ++ ) {
+			if ( extent_set == FALSE ) {
+				extent[0] = extent[2] = cx[t][i];
+				extent[1] = extent[3] = cy[t][i];
+				extent_set = TRUE;
+			}
+			if ( cx[t][i] < extent[0] ) extent[0] = cx[t][i];
+			if ( cy[t][i] < extent[1] ) extent[1] = cy[t][i];
+			if ( cx[t][i] > extent[2] ) extent[2] = cx[t][i];
+			if ( cy[t][i] > extent[3] ) extent[3] = cy[t][i];
+		}
+	}
+
+	if ( extent_set == TRUE ) {
+		geom_tools_sort_hilbert ( gs->points, sizeof (geom_store_point), gs->num_points,
+				cx[GEOM_TYPE_POINT], cy[GEOM_TYPE_POINT], extent );
+		geom_tools_sort_hilbert ( gs->points_raw, sizeof (geom_store_point), gs->num_points_raw,
+				cx[GEOM_TYPE_POINT_RAW], cy[GEOM_TYPE_POINT_RAW], extent );
+		geom_tools_sort_hilbert ( gs->lines, sizeof (geom_store_line), gs->num_lines,
+				cx[GEOM_TYPE_LINE], cy[GEOM_TYPE_LINE], extent );
+		geom_tools_sort_hilbert ( gs->polygons, sizeof (geom_store_polygon), gs->num_polygons,
+				cx[GEOM_TYPE_POLY], cy[GEOM_TYPE_POLY], extent );
+	}
+
+	for ( t = 0; t < GEOM_TYPE_ALL; t ++ ) {
+		free ( cx[t] );
+		free ( cy[t] );
+	}
+}
+
+
 /* Retrieves all coordinate values stored in a ring of a 'multclip' polygon structure,
  * and their count. The parameter 'coord_idx' determine which coordinates are
  * retrieved:
@@ -5103,10 +5466,10 @@ geom_coords_3d *geom_topology_poly_check_z_interpolate ( geom_multclip_poly *org
 								break;
 							}
 						}
-						/* get "right" neighbour */
+						/* get "right" neighbour (last slot of 'z_coords' is the closing vertex) */
 						int rn = cur_v;
 						double rn_z = z_coords[cur_v];
-						while ( rn < count ) {
+						while ( rn < count - 1 ) {
 							rn ++;
 							if ( z_coords[rn] <= max_Z ) {
 								rn_z = z_coords[rn];
@@ -5255,6 +5618,7 @@ BOOLEAN geom_topology_mpoly_place_vertex ( geom_multclip_poly *A, double Nx, dou
 				return ( FALSE );
 			}
 			geom_tools_part_destroy (A->outer);
+			free (A->outer);
 			A->outer = new_part;
 			return (TRUE);
 		}
@@ -5282,6 +5646,7 @@ BOOLEAN geom_topology_mpoly_place_vertex ( geom_multclip_poly *A, double Nx, dou
 					return ( FALSE );
 				}
 				geom_tools_part_destroy (A->inner[r]);
+				free (A->inner[r]);
 				A->inner[r] = new_part;
 				return (TRUE);
 			}
@@ -5753,9 +6118,9 @@ BOOLEAN geom_topology_poly_intersect (geom_multclip_poly *A, geom_multclip_poly
 						just be skipped by geom_topology_poly_place_vertex().
 						 */
 						int num_added = 0;
-						geom_store_polygon *candidate = gs->polygons;
-						for ( i = 1; i < gs->num_polygons; i++ ) {
-							if (( gs->polygons[i].is_selected == TRUE ) && ( gs->polygons[i].is_empty == FALSE ) && i != B_poly_id ) {
+						for ( i = 0; i < gs->num_polygons; i++ ) {
+							geom_store_polygon *candidate = &gs->polygons[i];
+							if (( candidate->is_selected == TRUE ) && ( candidate->is_empty == FALSE ) && i != B_poly_id ) {
 								if ( DEBUG ) {
 									fprintf (stderr, "CHECK: %i.\n", candidate->geom_id);
 								}
@@ -5771,6 +6136,7 @@ BOOLEAN geom_topology_poly_intersect (geom_multclip_poly *A, geom_multclip_poly
 										for ( v=0; v < num_new_v; v++) {
 											geom_part *new_part = geom_topology_part_place_vertex ( old_part, store[v].X, store[v].Y, store[v].Z, GEOM_PREC_PLACE_P_SEG );
 											if ( new_part != NULL ) {
+												int w;
 												if ( DEBUG ) {
 													fprintf (stderr, "\t\tNUM VERTICES OLD: %i.\n", old_part->num_vertices);
 													fprintf (stderr, "\t\tNUM VERTICES NEW: %i.\n", new_part->num_vertices);
@@ -5784,13 +6150,14 @@ BOOLEAN geom_topology_poly_intersect (geom_multclip_poly *A, geom_multclip_poly
 												old_part->Y = malloc ( sizeof (double) * new_part->num_vertices );
 												old_part->Z = malloc ( sizeof (double) * new_part->num_vertices );
 												/* copy vertices from new to old */
-												for ( i = 0; i < old_part->num_vertices; i ++ ) {
-													old_part->X[i] = new_part->X[i];
-													old_part->Y[i] = new_part->Y[i];
-													old_part->Z[i] = new_part->Z[i];
+												for ( w = 0; w < old_part->num_vertices; w ++ ) {
+													old_part->X[w] = new_part->X[w];
+													old_part->Y[w] = new_part->Y[w];
+													old_part->Z[w] = new_part->Z[w];
 												}
 												/* free vertex memory */
 												geom_tools_part_destroy (new_part);
+												free (new_part);
 												num_added ++;
 											}
 										}
@@ -5798,7 +6165,6 @@ BOOLEAN geom_topology_poly_intersect (geom_multclip_poly *A, geom_multclip_poly
 									}
 								}
 							}
-							candidate++;
 						}
 						/* Warn if no additional vertices were placed. */
 						if ( num_added < 1 ) {
@@ -6244,16 +6610,20 @@ unsigned int geom_topology_poly_remove_overlap_2D ( geom_store *gs, parser_desc
 								}
 								/* Clean up B! */
 								geom_tools_part_destroy (poly_B.outer);
+								t_free (poly_B.outer);
 								for ( r = 0; r < poly_B.num_inner; r ++ ) {
 									geom_tools_part_destroy (poly_B.inner[r]);
+									t_free (poly_B.inner[r]);
 								}
 								t_free (poly_B.inner);
 								t_free (poly_B.org_inner);
 							}
 							/* Clean up A! */
 							geom_tools_part_destroy (poly_A.outer);
+							t_free (poly_A.outer);
 							for ( r = 0; r < poly_A.num_inner; r ++ ) {
 								geom_tools_part_destroy (poly_A.inner[r]);
+								t_free (poly_A.inner[r]);
 							}
 							t_free (poly_A.inner);
 							t_free (poly_A.org_inner);
@@ -6603,7 +6973,7 @@ unsigned int geom_topology_intersections_2D_detect ( geom_store *gs, options *op
 		for ( i = 0; i < gs->num_lines; i++ ) {
 			if ( gs->lines[i].is_selected == TRUE && gs->lines[i].is_empty == FALSE ) {
 				for ( j = 0; j < gs->num_polygons; j++ ) {
-					if ( gs->polygons[j].is_selected == TRUE && gs->lines[j].is_empty == FALSE ) {
+					if ( gs->polygons[j].is_selected == TRUE && gs->polygons[j].is_empty == FALSE ) {
 						/* DEBUG */
 						if ( DEBUG == TRUE ) {
 							/* fprintf ( stderr, "\n\t\t %i-%i\n", i, j); */
@@ -6626,7 +6996,7 @@ unsigned int geom_topology_intersections_2D_detect ( geom_store *gs, options *op
 									B_extended = geom_tools_part_duplicate (B);
 									if ( B_extended != NULL ) {
 										/* undershoots will not be found if two segments are in the same geometry part */
-										if ( ( gs->lines[i].geom_id != gs->lines[j].geom_id) || ( k != l) ) {
+										if ( ( gs->lines[i].geom_id != gs->polygons[j].geom_id) || ( k != l) ) {
 											/* check for intersection between extended segments: first segment of A */
 											p0_x = A_extended_first->X[0];
 											p0_y = A_extended_first->Y[0];
@@ -7284,6 +7654,616 @@ void geom_tools_sort_part_reverse ( geom_part *poly_part )
 }
 
 
+/*
+ * LINE AND POLYGON SIMPLIFICATION
+ *
+ * Lines and polygon rings are simplified after topological cleaning,
+ * using either the Douglas-Peucker or the Visvalingam-Whyatt
+ * algorithm. Vertices whose position is used more than once (by
+ * another part or twice within the same part) are never removed or
+ * moved: these are the nodes and shared boundary vertices created by
+ * snapping and by adding intersection vertices. Each section of a part
+ * between two such vertices is simplified on its own.
+ *
+ * This preserves shared boundaries and line nodes, but it is not a
+ * full topology-preserving simplification: A simplified section is
+ * not checked against other sections, so it may cross another line
+ * or boundary (or another section of the same part) that it did not
+ * cross before, if the tolerance is larger than their distance.
+ */
+
+/*
+ * All distinct vertex positions of lines and polygons, stored in an
+ * open addressing hash table, with a flag for positions that are used
+ * more than once.
+ */
+typedef struct geom_simplify_index geom_simplify_index;
+struct geom_simplify_index
+{
+	double *X;
+	double *Y;
+	BOOLEAN *used; /* FALSE for empty slots */
+	BOOLEAN *shared; /* TRUE if position is used more than once */
+	unsigned int size; /* number of slots (power of two) */
+};
+
+/*
+ * One range of lines or polygons to simplify, to be run by
+ * a worker thread, with private scratch memory.
+ */
+typedef struct geom_simplify_job geom_simplify_job;
+struct geom_simplify_job
+{
+	geom_store *gs;
+	int geom_type; /* GEOM_TYPE_LINE or GEOM_TYPE_POLY */
+	int first; /* index of first object to process */
+	int last; /* index of last object to process + 1 */
+	double tolerance; /* max. distance (Douglas-Peucker) or sqrt. of min. area (Visvalingam-Whyatt) */
+	int mode; /* OPTIONS_SIMPLIFY_MODE_* */
+	const geom_simplify_index *index; /* shared vertex positions (read-only) */
+	unsigned int num_removed; /* number of vertices removed (result) */
+	/* scratch memory for one part */
+	unsigned int scratch_size;
+	BOOLEAN *keep;
+	int *stack;
+	int *prev;
+	int *next;
+	int *heap;
+	int *pos;
+	double *area;
+};
+
+
+/*
+ * Helper function for the vertex index: returns the first
+ * hash table slot to probe for position "X", "Y".
+ */
+unsigned int geom_simplify_hash ( double X, double Y, unsigned int size )
+{
+	unsigned long long a, b;
+
+	/* -0.0 and 0.0 are the same position */
+	if ( X == 0.0 ) X = 0.0;
+	if ( Y == 0.0 ) Y = 0.0;
+	memcpy ( &a, &X, sizeof (double) );
+	memcpy ( &b, &Y, sizeof (double) );
+	a = ( a ^ ( b * 0x9E3779B97F4A7C15ULL ) ) * 0xBF58476D1CE4E5B9ULL;
+
+	return ( (unsigned int) ( a >> 32 ) & ( size - 1 ) );
+}
+
+
+/*
+ * Adds the position of vertex "X", "Y" to the vertex index or
+ * marks it as shared if it is already there.
+ */
+void geom_simplify_index_add ( geom_simplify_index *idx, double X, double Y )
+{
+	unsigned int slot = geom_simplify_hash ( X, Y, idx->size );
+
+	while ( idx->used[slot] == TRUE ) {
+		if ( idx->X[slot] == X && idx->Y[slot] == Y ) {
+			idx->shared[slot] = TRUE;
+			return;
+		}
+		slot = ( slot + 1 ) & ( idx->size - 1 );
+	}
+	idx->X[slot] = X;
+	idx->Y[slot] = Y;
+	idx->used[slot] = TRUE;
+	idx->shared[slot] = FALSE;
+}
+
+
+/*
+ * Returns TRUE if the position of vertex "X", "Y" is used
+ * more than once.
+ */
+BOOLEAN geom_simplify_index_shared ( const geom_simplify_index *idx, double X, double Y )
+{
+	unsigned int slot = geom_simplify_hash ( X, Y, idx->size );
+
+	while ( idx->used[slot] == TRUE ) {
+		if ( idx->X[slot] == X && idx->Y[slot] == Y ) {
+			return ( idx->shared[slot] );
+		}
+		slot = ( slot + 1 ) & ( idx->size - 1 );
+	}
+
+	return ( FALSE );
+}
+
+
+/*
+ * Helper function for geom_simplify_index_create() (below):
+ * adds all vertices of "part" to the index. The closing vertex
+ * of a polygon ring does not count as a second use of the
+ * position of the first vertex.
+ */
+void geom_simplify_index_add_part ( geom_simplify_index *idx, geom_part *part, BOOLEAN is_ring )
+{
+	unsigned int n = part->num_vertices;
+	unsigned int k;
+
+	if ( is_ring == TRUE && n > 1 && part->X[0] == part->X[n-1] && part->Y[0] == part->Y[n-1] ) {
+		n --;
+	}
+	for ( k = 0; k < n; k ++ ) {
+		geom_simplify_index_add ( idx, part->X[k], part->Y[k] );
+	}
+}
+
+
+/*
+ * Creates an index of the vertex positions of all lines
+ * and polygons in "gs".
+ */
+geom_simplify_index *geom_simplify_index_create ( geom_store *gs )
+{
+	geom_simplify_index *idx;
+	unsigned int num_vertices = 0;
+	unsigned int i, j;
+
+
+	for ( i = 0; i < gs->num_lines; i ++ ) {
+		for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
+			num_vertices += gs->lines[i].parts[j].num_vertices;
+		}
+	}
+	for ( i = 0; i < gs->num_polygons; i ++ ) {
+		for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
+			num_vertices += gs->polygons[i].parts[j].num_vertices;
+		}
+	}
+
+	idx = malloc ( sizeof (geom_simplify_index) );
+	/* keep hash table at most half full */
+	idx->size = 64;
+	while ( idx->size < num_vertices * 2 ) {
+		idx->size *= 2;
+	}
+	idx->X = malloc ( sizeof (double) * idx->size );
+	idx->Y = malloc ( sizeof (double) * idx->size );
+	idx->used = calloc ( idx->size, sizeof (BOOLEAN) );
+	idx->shared = malloc ( sizeof (BOOLEAN) * idx->size );
+
+	for ( i = 0; i < gs->num_lines; i ++ ) {
+		for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
+			geom_simplify_index_add_part ( idx, &gs->lines[i].parts[j], FALSE );
+		}
+	}
+	for ( i = 0; i < gs->num_polygons; i ++ ) {
+		for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
+			geom_simplify_index_add_part ( idx, &gs->polygons[i].parts[j], TRUE );
+		}
+	}
+
+	return ( idx );
+}
+
+
+/*
+ * Releases all memory held by a vertex index.
+ */
+void geom_simplify_index_destroy ( geom_simplify_index *idx )
+{
+	free ( idx->X );
+	free ( idx->Y );
+	free ( idx->used );
+	free ( idx->shared );
+	free ( idx );
+}
+
+
+/*
+ * Makes sure that the scratch memory of "job" can hold
+ * data for "size" vertices.
+ */
+void geom_simplify_reserve ( geom_simplify_job *job, unsigned int size )
+{
+	if ( size <= job->scratch_size ) {
+		return;
+	}
+	job->scratch_size = size;
+	job->keep = realloc ( job->keep, sizeof (BOOLEAN) * size );
+	job->stack = realloc ( job->stack, sizeof (int) * size * 2 );
+	job->prev = realloc ( job->prev, sizeof (int) * size );
+	job->next = realloc ( job->next, sizeof (int) * size );
+	job->heap = realloc ( job->heap, sizeof (int) * size );
+	job->pos = realloc ( job->pos, sizeof (int) * size );
+	job->area = realloc ( job->area, sizeof (double) * size );
+}
+
+
+/*
+ * Returns the distance of vertex "k" from the straight
+ * line segment between vertices "a" and "b" (2D).
+ */
+double geom_simplify_dist ( geom_part *part, unsigned int a, unsigned int b, unsigned int k )
+{
+	double dx = part->X[b] - part->X[a];
+	double dy = part->Y[b] - part->Y[a];
+	double len2 = dx * dx + dy * dy;
+	double t;
+
+	if ( len2 <= 0.0 ) {
+		return ( sqrt ( ( part->X[k] - part->X[a] ) * ( part->X[k] - part->X[a] ) +
+				( part->Y[k] - part->Y[a] ) * ( part->Y[k] - part->Y[a] ) ) );
+	}
+	t = ( ( part->X[k] - part->X[a] ) * dx + ( part->Y[k] - part->Y[a] ) * dy ) / len2;
+	if ( t < 0.0 ) t = 0.0;
+	if ( t > 1.0 ) t = 1.0;
+
+	return ( sqrt ( ( part->X[a] + t * dx - part->X[k] ) * ( part->X[a] + t * dx - part->X[k] ) +
+			( part->Y[a] + t * dy - part->Y[k] ) * ( part->Y[a] + t * dy - part->Y[k] ) ) );
+}
+
+
+/*
+ * Returns the area of the triangle formed by vertices "a", "b" and "c" (2D).
+ */
+double geom_simplify_area ( geom_part *part, unsigned int a, unsigned int b, unsigned int c )
+{
+	return ( fabs ( ( part->X[b] - part->X[a] ) * ( part->Y[c] - part->Y[a] ) -
+			( part->X[c] - part->X[a] ) * ( part->Y[b] - part->Y[a] ) ) / 2.0 );
+}
+
+
+/*
+ * Douglas-Peucker simplification of the section between vertices
+ * "a" and "b" (exclusive) of "part": marks all vertices in
+ * job->keep[] that must be kept. Vertex indices run modulo "m",
+ * so that a section may wrap around the start of a polygon ring.
+ */
+void geom_simplify_section_dp ( geom_simplify_job *job, geom_part *part, int a, int b, int m )
+{
+	int num = 0;
+	int k, k_max;
+	double d, d_max;
+
+
+	job->stack[num++] = a;
+	job->stack[num++] = b;
+	while ( num > 0 ) {
+		b = job->stack[--num];
+		a = job->stack[--num];
+		d_max = -1.0;
+		k_max = -1;
+		for ( k = a + 1; k < b; k ++ ) {
+			d = geom_simplify_dist ( part, a % m, b % m, k % m );
+			if ( d > d_max ) {
+				d_max = d;
+				k_max = k;
+			}
+		}
+		if ( k_max >= 0 && d_max > job->tolerance ) {
+			job->keep[k_max % m] = TRUE;
+			job->stack[num++] = a;
+			job->stack[num++] = k_max;
+			job->stack[num++] = k_max;
+			job->stack[num++] = b;
+		}
+	}
+}
+
+
+/*
+ * Helper functions for geom_simplify_section_vw() (below):
+ * restore the heap order of job->heap[] (ordered by job->area[])
+ * after the area at heap position "i" has decreased (up) or
+ * increased (down).
+ */
+void geom_simplify_heap_up ( geom_simplify_job *job, int i )
+{
+	int parent;
+	int tmp;
+
+	while ( i > 0 ) {
+		parent = ( i - 1 ) / 2;
+		if ( job->area[job->heap[parent]] <= job->area[job->heap[i]] ) {
+			break;
+		}
+		tmp = job->heap[parent]; job->heap[parent] = job->heap[i]; job->heap[i] = tmp;
+		job->pos[job->heap[parent]] = parent;
+		job->pos[job->heap[i]] = i;
+		i = parent;
+	}
+}
+
+void geom_simplify_heap_down ( geom_simplify_job *job, int i, int num )
+{
+	int child;
+	int tmp;
+
+	while ( ( child = 2 * i + 1 ) < num ) {
+		if ( child + 1 < num && job->area[job->heap[child+1]] < job->area[job->heap[child]] ) {
+			child ++;
+		}
+		if ( job->area[job->heap[i]] <= job->area[job->heap[child]] ) {
+			break;
+		}
+		tmp = job->heap[child]; job->heap[child] = job->heap[i]; job->heap[i] = tmp;
+		job->pos[job->heap[child]] = child;
+		job->pos[job->heap[i]] = i;
+		i = child;
+	}
+}
+
+
+/*
+ * Visvalingam-Whyatt simplification of the section between vertices
+ * "a" and "b" (exclusive) of "part": repeatedly removes the vertex
+ * with the smallest effective area, as long as that area is smaller
+ * than the square of the tolerance. Updates job->keep[] accordingly.
+ * Vertex indices run modulo "m", as in geom_simplify_section_dp().
+ *
+ * All scratch arrays are indexed by the position within the section
+ * (0 = "a").
+ */
+void geom_simplify_section_vw ( geom_simplify_job *job, geom_part *part, int a, int b, int m )
+{
+	double min_area = job->tolerance * job->tolerance;
+	double removed;
+	int len = b - a + 1;
+	int num = 0;
+	int i, p, q;
+
+
+	for ( i = 0; i < len; i ++ ) {
+		job->prev[i] = i - 1;
+		job->next[i] = i + 1;
+	}
+	for ( i = 1; i < len - 1; i ++ ) {
+		job->keep[( a + i ) % m] = TRUE;
+		job->area[i] = geom_simplify_area ( part, ( a + i - 1 ) % m, ( a + i ) % m, ( a + i + 1 ) % m );
+		job->heap[num] = i;
+		job->pos[i] = num;
+		num ++;
+		geom_simplify_heap_up ( job, num - 1 );
+	}
+
+	while ( num > 0 && job->area[job->heap[0]] < min_area ) {
+		/* remove vertex with smallest area from heap and from section */
+		i = job->heap[0];
+		removed = job->area[i];
+		num --;
+		job->heap[0] = job->heap[num];
+		job->pos[job->heap[0]] = 0;
+		geom_simplify_heap_down ( job, 0, num );
+		job->keep[( a + i ) % m] = FALSE;
+		p = job->prev[i];
+		q = job->next[i];
+		job->next[p] = q;
+		job->prev[q] = p;
+		/* update neighbours; effective areas never decrease */
+		if ( p > 0 ) {
+			job->area[p] = geom_simplify_area ( part, ( a + job->prev[p] ) % m, ( a + p ) % m, ( a + q ) % m );
+			if ( job->area[p] < removed ) job->area[p] = removed;
+			geom_simplify_heap_up ( job, job->pos[p] );
+			geom_simplify_heap_down ( job, job->pos[p], num );
+		}
+		if ( q < len - 1 ) {
+			job->area[q] = geom_simplify_area ( part, ( a + p ) % m, ( a + q ) % m, ( a + job->next[q] ) % m );
+			if ( job->area[q] < removed ) job->area[q] = removed;
+			geom_simplify_heap_up ( job, job->pos[q] );
+			geom_simplify_heap_down ( job, job->pos[q], num );
+		}
+	}
+}
+
+
+/*
+ * Simplifies one line part or polygon ring ("is_ring" = TRUE) in place.
+ * Shared vertices and the end vertices of lines are always kept.
+ * A ring that would be left with fewer than three distinct vertices
+ * is not changed at all.
+ *
+ * Returns the number of vertices removed.
+ */
+unsigned int geom_simplify_part ( geom_simplify_job *job, geom_part *part, BOOLEAN is_ring )
+{
+	unsigned int n = part->num_vertices;
+	int m = (int) n; /* number of distinct vertices (without closing vertex) */
+	BOOLEAN closed = FALSE;
+	int num_anchors = 0;
+	int num_kept = 0;
+	int a, b, k;
+
+
+	if ( is_ring == TRUE && n > 1 && part->X[0] == part->X[n-1] && part->Y[0] == part->Y[n-1] ) {
+		closed = TRUE;
+		m --;
+	}
+	if ( m < ( is_ring == TRUE ? 4 : 3 ) ) {
+		return ( 0 );
+	}
+	geom_simplify_reserve ( job, m + 1 );
+
+	/* anchors: shared vertices, start of ring, end vertices of lines */
+	for ( k = 0; k < m; k ++ ) {
+		job->keep[k] = geom_simplify_index_shared ( job->index, part->X[k], part->Y[k] );
+	}
+	job->keep[0] = TRUE;
+	if ( is_ring == FALSE ) {
+		job->keep[m-1] = TRUE;
+	}
+	for ( k = 0; k < m; k ++ ) {
+		if ( job->keep[k] == TRUE ) {
+			num_anchors ++;
+		}
+	}
+	if ( is_ring == TRUE && num_anchors < 2 ) {
+		/* also anchor the vertex farthest from the start of the ring */
+		double d, d_max = -1.0;
+		int k_max = 1;
+		for ( k = 1; k < m; k ++ ) {
+			d = geom_simplify_dist ( part, 0, 0, k );
+			if ( d > d_max ) {
+				d_max = d;
+				k_max = k;
+			}
+		}
+		job->keep[k_max] = TRUE;
+	}
+
+	/* simplify each section between two anchors (for rings: including the last one) */
+	a = 0;
+	for ( b = 1; b <= ( is_ring == TRUE ? m : m - 1 ); b ++ ) {
+		if ( job->keep[b % m] == TRUE ) {
+			if ( b - a > 1 ) {
+				if ( job->mode == OPTIONS_SIMPLIFY_MODE_VISVALINGAM ) {
+					geom_simplify_section_vw ( job, part, a, b, m );
+				} else {
+					geom_simplify_section_dp ( job, part, a, b, m );
+				}
+			}
+			a = b;
+		}
+	}
+
+	for ( k = 0; k < m; k ++ ) {
+		if ( job->keep[k] == TRUE ) {
+			num_kept ++;
+		}
+	}
+	if ( num_kept == m || ( is_ring == TRUE && num_kept < 3 ) ) {
+		return ( 0 );
+	}
+
+	/* compact vertex lists */
+	num_kept = 0;
+	for ( k = 0; k < m; k ++ ) {
+		if ( job->keep[k] == TRUE ) {
+			part->X[num_kept] = part->X[k];
+			part->Y[num_kept] = part->Y[k];
+			part->Z[num_kept] = part->Z[k];
+			num_kept ++;
+		}
+	}
+	if ( closed == TRUE ) {
+		part->X[num_kept] = part->X[0];
+		part->Y[num_kept] = part->Y[0];
+		part->Z[num_kept] = part->Z[0];
+		num_kept ++;
+	}
+	part->num_vertices = num_kept;
+
+	return ( n - num_kept );
+}
+
+
+/*
+ * Thread function for geom_topology_simplify_2D() (below):
+ * simplifies all selected lines or polygons in the range
+ * of one job. This does not produce any messages.
+ */
+void *geom_simplify_job_run ( void *arg )
+{
+	geom_simplify_job *job = (geom_simplify_job*) arg;
+	unsigned int j;
+	int i;
+
+	for ( i = job->first; i < job->last; i ++ ) {
+		if ( job->geom_type == GEOM_TYPE_LINE ) {
+			if ( job->gs->lines[i].is_selected == TRUE ) {
+				for ( j = 0; j < job->gs->lines[i].num_parts; j ++ ) {
+					job->num_removed += geom_simplify_part ( job, &job->gs->lines[i].parts[j], FALSE );
+				}
+			}
+		} else {
+			if ( job->gs->polygons[i].is_selected == TRUE ) {
+				for ( j = 0; j < job->gs->polygons[i].num_parts; j ++ ) {
+					job->num_removed += geom_simplify_part ( job, &job->gs->polygons[i].parts[j], TRUE );
+				}
+			}
+		}
+	}
+
+	return ( NULL );
+}
+
+
+/*
+ * Simplifies all selected lines and polygons, using separate
+ * tolerances for lines and polygons ("opts->simplify_lines",
+ * "opts->simplify_polys"; 0.0 = no simplification) and the
+ * algorithm set by "opts->simplify_mode". See the comments
+ * at the start of this section.
+ *
+ * Work is split into ranges of geometries, which are
+ * processed by up to "opts->threads" parallel threads.
+ * Bounding boxes must be updated afterwards.
+ *
+ * Returns the total number of vertices removed.
+ */
+unsigned int geom_topology_simplify_2D ( geom_store *gs, options *opts )
+{
+	geom_simplify_index *idx;
+	geom_simplify_job *jobs;
+	unsigned int num_removed = 0;
+	int max_jobs, num_jobs = 0;
+	int geom_type, num_objs, n;
+	int i;
+
+
+	if ( opts->simplify_lines <= 0.0 && opts->simplify_polys <= 0.0 ) {
+		return ( 0 );
+	}
+
+	idx = geom_simplify_index_create ( gs );
+
+	max_jobs = opts->threads * 4;
+	if ( max_jobs < 1 ) {
+		max_jobs = 1;
+	}
+	jobs = malloc ( sizeof (geom_simplify_job) * max_jobs * 2 );
+	for ( geom_type = GEOM_TYPE_LINE; geom_type <= GEOM_TYPE_POLY; geom_type ++ ) {
+		double tolerance = geom_type == GEOM_TYPE_LINE ? opts->simplify_lines : opts->simplify_polys;
+		num_objs = geom_type == GEOM_TYPE_LINE ? gs->num_lines : gs->num_polygons;
+		if ( tolerance <= 0.0 || num_objs < 1 ) {
+			continue;
+		}
+		n = max_jobs < num_objs ? max_jobs : num_objs;
+		for ( i = 0; i < n; i ++ ) {
+			geom_simplify_job *job = &jobs[num_jobs++];
+			job->gs = gs;
+			job->geom_type = geom_type;
+			job->first = (int) ( ( (long) num_objs * i ) / n );
+			job->last = (int) ( ( (long) num_objs * ( i + 1 ) ) / n );
+			job->tolerance = tolerance;
+			job->mode = opts->simplify_mode;
+			job->index = idx;
+			job->num_removed = 0;
+			job->scratch_size = 0;
+			job->keep = NULL;
+			job->stack = NULL;
+			job->prev = NULL;
+			job->next = NULL;
+			job->heap = NULL;
+			job->pos = NULL;
+			job->area = NULL;
+		}
+	}
+
+	t_thread_run_pool ( geom_simplify_job_run, jobs, num_jobs, sizeof (geom_simplify_job), opts->threads );
+
+	for ( i = 0; i < num_jobs; i ++ ) {
+		num_removed += jobs[i].num_removed;
+		free ( jobs[i].keep );
+		free ( jobs[i].stack );
+		free ( jobs[i].prev );
+		free ( jobs[i].next );
+		free ( jobs[i].heap );
+		free ( jobs[i].pos );
+		free ( jobs[i].area );
+	}
+	free ( jobs );
+	geom_simplify_index_destroy ( idx );
+
+	return ( num_removed );
+}
+
+
 /*
  * This function sorts the vertices of all polygons into a
  * defined order (different output formats require different
@@ -7607,10 +8587,10 @@ void geom_reorient_local_xz(parser_data_store *storage) {
 	{
 		int i;
 		for ( i = 0; i < storage->num_records; i ++ ) {
-			if ( storage->records[i].is_empty == FALSE && storage->records[i].is_valid == TRUE ) {
+			if ( !( storage->flags[i] & PARSER_RECORD_EMPTY ) && ( storage->flags[i] & PARSER_RECORD_VALID ) ) {
 				refPoint = i;
-				minX = storage->records[i].x; /* proper X minimum will be determined in the next step */
-				maxX = storage->records[i].x; /* ditto */
+				minX = storage->x[i]; /* proper X minimum will be determined in the next step */
+				maxX = storage->x[i]; /* ditto */
 				minXIdx = i;
 				maxXIdx = i;
 				break;
@@ -7629,13 +8609,13 @@ void geom_reorient_local_xz(parser_data_store *storage) {
 		BOOLEAN maxSet = FALSE;
 		/* get maximal Z difference between reference point and any other */
 		for ( i = 0; i < storage->num_records; i ++ ) {
-			if ( storage->records[i].is_empty == FALSE && storage->records[i].is_valid == TRUE ) {
+			if ( !( storage->flags[i] & PARSER_RECORD_EMPTY ) && ( storage->flags[i] & PARSER_RECORD_VALID ) ) {
 				if ( i != refPoint ) {
 					if ( maxSet == FALSE ) {
-						maxDZ = fabs(storage->records[refPoint].z - storage->records[i].z);
+						maxDZ = fabs(storage->z[refPoint] - storage->z[i]);
 						maxSet = TRUE;
 					} else {
-						double d = fabs(storage->records[refPoint].z - storage->records[i].z);
+						double d = fabs(storage->z[refPoint] - storage->z[i]);
 						if (d > maxDZ) {
 							maxDZ = d;
 						}
@@ -7651,9 +8631,9 @@ void geom_reorient_local_xz(parser_data_store *storage) {
 
 		/* normalize weights to range [0;1] */
 		for ( i = 0; i < storage->num_records; i ++ ) {
-			if ( storage->records[i].is_empty == FALSE && storage->records[i].is_valid == TRUE ) {
+			if ( !( storage->flags[i] & PARSER_RECORD_EMPTY ) && ( storage->flags[i] & PARSER_RECORD_VALID ) ) {
 				if ( i != refPoint ) {
-					double d = fabs(storage->records[refPoint].z - storage->records[i].z);
+					double d = fabs(storage->z[refPoint] - storage->z[i]);
 					double norm = d / maxDZ;
 					weights[i] = 1 - (norm);
 				}
@@ -7667,17 +8647,17 @@ void geom_reorient_local_xz(parser_data_store *storage) {
 		{
 			int i;
 			for ( i = 0; i < storage->num_records; i ++ ) {
-				if ( storage->records[i].is_empty == FALSE && storage->records[i].is_valid == TRUE ) {
+				if ( !( storage->flags[i] & PARSER_RECORD_EMPTY ) && ( storage->flags[i] & PARSER_RECORD_VALID ) ) {
 					if ( i != refPoint ) {
 						/* compute weighted sum of X deltas */
-						sumOfDists += (storage->records[i].x - storage->records[refPoint].x) * weights[i];
+						sumOfDists += (storage->x[i] - storage->x[refPoint]) * weights[i];
 						/* update min/max stats */
-						if ( storage->records[i].x < minX ) {
-							minX = storage->records[i].x;
+						if ( storage->x[i] < minX ) {
+							minX = storage->x[i];
 							minXIdx = i;
 						}
-						if ( storage->records[i].x > maxX ) {
-							maxX = storage->records[i].x;
+						if ( storage->x[i] > maxX ) {
+							maxX = storage->x[i];
 							maxXIdx = i;
 						}
 					}
@@ -7710,33 +8690,33 @@ void geom_reorient_local_xz(parser_data_store *storage) {
 	{
 		int i;
 		for ( i = 0; i < storage->num_records; i ++ ) {
-			if ( storage->records[i].is_empty == FALSE && storage->records[i].is_valid == TRUE ) {
+			if ( !( storage->flags[i] & PARSER_RECORD_EMPTY ) && ( storage->flags[i] & PARSER_RECORD_VALID ) ) {
 				/* set transformed coordinates (NOTE: coordinates of reference point are set _after_ this loop!) */
 				if ( i != refPoint ) {
 					double x_new;
 					double y_new;
 					double z_new;
 					/* new X is straight line distance between X/Y of this measurement and the reference point */
-					double t1 = storage->records[refPoint].x - storage->records[i].x;
-					double t2 = storage->records[refPoint].y - storage->records[i].y;
+					double t1 = storage->x[refPoint] - storage->x[i];
+					double t2 = storage->y[refPoint] - storage->y[i];
 					x_new = sqrt( (t1*t1) + (t2*t2) ); /* argument is always positive */
 					/* new Y is old Z */
-					y_new = storage->records[i].z;
+					y_new = storage->z[i];
 					/* Z simply becomes "0.0" */
 					z_new = 0.0;
 					/* store new coordinates */
-					storage->records[i].x = x_new;
-					storage->records[i].y = y_new;
-					storage->records[i].z = z_new;
+					storage->x[i] = x_new;
+					storage->y[i] = y_new;
+					storage->z[i] = z_new;
 				}
 			}
 		}
 	}
 
 	/* coordinates of reference point are always "0/z/0" */
-	storage->records[refPoint].x = 0.0;
-	storage->records[refPoint].y = storage->records[refPoint].z;
-	storage->records[refPoint].z = 0.0;
+	storage->x[refPoint] = 0.0;
+	storage->y[refPoint] = storage->z[refPoint];
+	storage->z[refPoint] = 0.0;
 
 	/* clean up */
 	t_free ( weights );
@@ -7754,7 +8734,7 @@ BOOLEAN geom_ds_has_z(parser_data_store *storage) {
 	double min;
 	double max;
 	for ( i = 0; i < storage->num_records ; i ++ ) {
-		double z = storage->records[i].z;
+		double z = storage->z[i];
 		if ( i == 0 ) {
 			min = z;
 			max = z;
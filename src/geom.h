@@ -319,6 +319,10 @@ struct geom_coords_3d
 };
 
 
+/* get/set the geom ID for the next geometry (shared by all input files) */
+unsigned int geom_get_next_id ( void );
+void geom_set_next_id ( unsigned int id );
+
 /* multiplex raw data records into geometries with 1 to n vertices */
 int geom_multiplex ( parser_data_store *storage, parser_desc *parser );
 
@@ -329,9 +333,15 @@ geom_store *geom_store_new ();
 int geom_store_build ( geom_store *gs, parser_data_store **ds,
 		parser_desc *parser, options *opts);
 
+/* share geometries with another store that has its own output paths */
+void geom_store_view ( geom_store *view, geom_store *gs );
+
 /* create output file paths */
 int geom_store_make_paths ( geom_store *gs, options *opts, char *error );
 
+/* release output file paths */
+void geom_store_free_paths ( geom_store *gs );
+
 /* destroy geometry store, releasing memory */
 void geom_store_destroy ( geom_store *gs );
 
@@ -367,6 +377,9 @@ unsigned int geom_topology_intersections_2D_detect ( geom_store *gs, options *op
 unsigned int geom_topology_clean_dangles_2D ( geom_store *gs, options *opts, unsigned int *topo_errors,
 		unsigned int *num_detected, unsigned int *num_added );
 
+/* simplify lines and polygons, keeping shared vertices in place */
+unsigned int geom_topology_simplify_2D ( geom_store *gs, options *opts );
+
 /* sort vertices in polygons */
 unsigned int geom_topology_sort_vertices ( geom_store *gs, int mode );
 
@@ -374,6 +387,13 @@ unsigned int geom_topology_sort_vertices ( geom_store *gs, int mode );
 int geom_tools_parts_intersection_2D ( geom_part* A, geom_part* B, geom_store *gs,
 		int geom_type, unsigned int geom_id, unsigned int part_idx, BOOLEAN check_only );
 
+/* check if two 2D line segments intersect and return the intersection point */
+BOOLEAN geom_tools_line_intersection_2D (double p0_x, double p0_y, double p1_x, double p1_y,
+		double p2_x, double p2_y, double p3_x, double p3_y, double *i_x, double *i_y);
+
+/* check if a point lies within a polygon part */
+BOOLEAN geom_tools_point_in_part_2D ( double X, double Y, geom_store_polygon *polygon, unsigned int part );
+
 /* check if polygon part A lies completely within polygon part B */
 BOOLEAN geom_tools_part_in_part_2D ( geom_part *A, geom_part *B );
 
@@ -390,6 +410,15 @@ void geom_reorient_local_xz(parser_data_store *storage);
 /* update bounding boxes */
 void geom_tools_update_bboxes (geom_store *gs);
 
+/* position of a point on a Hilbert curve (2^16 x 2^16 grid) */
+unsigned int geom_tools_hilbert ( unsigned int x, unsigned int y );
+
+/* sort all geometries in spatial (Hilbert curve) order */
+void geom_store_sort_hilbert ( geom_store *gs );
+
+/* determine vertex order (winding) of a polygon part */
+int geom_get_vertex_order ( geom_part *poly );
+
 /* resort vertices of a polygon part into 'reverse' order */
 void geom_tools_sort_part_reverse ( geom_part *poly_part );
 
@@ -77,14 +77,19 @@ typedef unsigned short BOOLEAN;
 #define PRG_OUTPUT_DXF			1
 #define PRG_OUTPUT_GEOJSON		2
 #define PRG_OUTPUT_KML			3
+#define PRG_OUTPUT_FGB			4
+#define PRG_OUTPUT_GEOJSONL		5
+#define PRG_OUTPUT_MVT			6
+
+#define PRG_OUTPUT_NUM			7 /* number of output formats */
 
 #define PRG_OUTPUT_DEFAULT		PRG_OUTPUT_SHP
 
-static const char PRG_OUTPUT_EXT[][8] =
-{ "shp", "dxf", "geojson", "kml", "" };
+static const char PRG_OUTPUT_EXT[][10] =
+{ "shp", "dxf", "geojson", "kml", "fgb", "geojsonl", "mvt", "" };
 
 static const char PRG_OUTPUT_DESC[][255] =
-{ "Esri(tm) Shapefile", "AutoCAD(tm) Drawing Exchange Format", "GeoJSON Object", "Keyhole Markup Language", "" };
+{ "Esri(tm) Shapefile", "AutoCAD(tm) Drawing Exchange Format", "GeoJSON Object", "Keyhole Markup Language", "FlatGeobuf", "GeoJSON Text Sequence", "Mapbox Vector Tiles", "" };
 
 /* Parsing limits */
 #define PRG_MAX_SELECTIONS		255 /* Maximum number of selections */
@@ -0,0 +1,818 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	incremental.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Incremental mode ("--incremental"): processes only the data
+ * 				that has been appended to a growing input file since the
+ * 				last run.
+ *
+ * 				See incremental.h for details.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "global.h"
+
+#include "errors.h"
+#include "export.h"
+#include "geom.h"
+#include "i18n.h"
+#include "incremental.h"
+#include "options.h"
+#include "parser.h"
+#include "selections.h"
+#include "tools.h"
+
+
+/*
+ * Helper function: adds "len" bytes to the FNV-1a hash "hash".
+ * Returns the new hash value.
+ */
+unsigned long incremental_hash ( unsigned long hash, const char *data, size_t len )
+{
+	size_t i;
+
+	for ( i = 0; i < len; i ++ ) {
+		hash ^= (unsigned char) data[i];
+		hash = ( hash * 16777619UL ) & 0xffffffffUL;
+	}
+
+	return ( hash );
+}
+
+
+/*
+ * Helper function: returns the hash of "len" bytes of the file "path",
+ * starting at byte "offset". Returns 0 if the file cannot be read.
+ */
+unsigned long incremental_hash_file ( const char *path, long offset, long len )
+{
+	FILE *fp;
+	char buf[INCREMENTAL_HASH_LEN];
+	unsigned long hash = 2166136261UL;
+	size_t n;
+
+
+	fp = t_fopen_utf8 ( path, "rb" );
+	if ( fp == NULL ) {
+		return ( 0 );
+	}
+	if ( fseek ( fp, offset, SEEK_SET ) != 0 ) {
+		fclose ( fp );
+		return ( 0 );
+	}
+	while ( len > 0 ) {
+		n = fread ( buf, sizeof (char), len < (long) sizeof (buf) ? (size_t) len : sizeof (buf), fp );
+		if ( n < 1 ) {
+			break;
+		}
+		hash = incremental_hash ( hash, buf, n );
+		len -= (long) n;
+	}
+	fclose ( fp );
+
+	return ( hash );
+}
+
+
+/*
+ * Helper function: returns the hash of everything that determines the
+ * output of a run, apart from the input data: all options, the output
+ * and input file names and the contents of the parser schema file.
+ */
+unsigned long incremental_hash_config ( options *opts )
+{
+	unsigned long hash = 2166136261UL;
+	int i;
+
+
+	for ( i = 1; i < opts->argc; i ++ ) {
+		if ( opts->argv[i] != NULL ) {
+			hash = incremental_hash ( hash, opts->argv[i], strlen (opts->argv[i]) + 1 );
+		}
+	}
+	hash = incremental_hash ( hash, opts->output, strlen (opts->output) + 1 );
+	hash = incremental_hash ( hash, opts->base, strlen (opts->base) + 1 );
+	hash = incremental_hash ( hash, opts->input[0], strlen (opts->input[0]) + 1 );
+	if ( opts->schema_file != NULL ) {
+		long size = t_file_size_utf8 ( opts->schema_file );
+		if ( size > 0 ) {
+			hash ^= incremental_hash_file ( opts->schema_file, 0, size );
+		}
+	}
+
+	return ( hash );
+}
+
+
+/*
+ * Helper function: gets the paths of all output layers in "gs", as
+ * they were set by geom_store_make_paths(). For each layer, "paths"
+ * receives the main file and, for Shapefiles, the ".shx" and ".dbf"
+ * files (NULL otherwise). The ".shx" paths are newly allocated.
+ *
+ * Returns the number of layers.
+ */
+int incremental_get_layers ( geom_store *gs, options *opts, char *paths[INCREMENTAL_MAX_OUTPUTS][3] )
+{
+	char *shp[INCREMENTAL_MAX_OUTPUTS];
+	char *dbf[INCREMENTAL_MAX_OUTPUTS];
+	int i, num;
+
+
+	if ( opts->format != PRG_OUTPUT_SHP ) {
+		paths[0][0] = gs->path_all;
+		paths[0][1] = NULL;
+		paths[0][2] = NULL;
+		return ( 1 );
+	}
+
+	shp[0] = gs->path_points;
+	dbf[0] = gs->path_points_atts;
+	shp[1] = gs->path_points_raw;
+	dbf[1] = gs->path_points_raw_atts;
+	shp[2] = gs->path_lines;
+	dbf[2] = gs->path_lines_atts;
+	shp[3] = gs->path_polys;
+	dbf[3] = gs->path_polys_atts;
+	shp[4] = gs->path_labels;
+	dbf[4] = gs->path_labels_atts;
+	num = 0;
+	for ( i = 0; i < INCREMENTAL_MAX_OUTPUTS; i ++ ) {
+		if ( shp[i] != NULL && dbf[i] != NULL ) {
+			paths[num][0] = shp[i];
+			paths[num][1] = strdup ( shp[i] );
+			strcpy ( &paths[num][1][strlen (shp[i]) - strlen (".shp")], ".shx" );
+			paths[num][2] = dbf[i];
+			num ++;
+		}
+	}
+
+	return ( num );
+}
+
+
+/*
+ * Helper function: releases the memory allocated by incremental_get_layers().
+ */
+void incremental_free_layers ( char *paths[INCREMENTAL_MAX_OUTPUTS][3], int num )
+{
+	int i;
+
+	for ( i = 0; i < num; i ++ ) {
+		t_free ( paths[i][1] );
+	}
+}
+
+
+/*
+ * Helper function for incremental_begin(): reads the checkpoint file
+ * "cp->path" into "cp".
+ *
+ * Returns FALSE if the file does not exist or cannot be parsed.
+ */
+BOOLEAN incremental_read ( incremental_checkpoint *cp )
+{
+	FILE *fp;
+	char line[PRG_MAX_PATH_LENGTH+PRG_MAX_STR_LEN];
+	BOOLEAN valid;
+	long size[3];
+	int pos;
+
+
+	fp = t_fopen_utf8 ( cp->path, "r" );
+	if ( fp == NULL ) {
+		return ( FALSE );
+	}
+
+	valid = FALSE;
+	if ( fgets ( line, sizeof (line), fp ) != NULL && !strncmp ( line, INCREMENTAL_HEADER, strlen (INCREMENTAL_HEADER) ) ) {
+		valid = TRUE;
+	}
+	while ( valid == TRUE && fgets ( line, sizeof (line), fp ) != NULL ) {
+		char *p = strchr ( line, '\n' );
+		if ( p == NULL ) {
+			valid = FALSE;
+			break;
+		}
+		*p = '\0';
+		if ( strlen (line) > 0 && line[strlen (line)-1] == '\r' ) {
+			line[strlen (line)-1] = '\0';
+		}
+		if ( sscanf ( line, "config %lx", &cp->config ) == 1 ) {
+			continue;
+		}
+		if ( sscanf ( line, "input %ld %lx %lx", &cp->end_offset, &cp->head, &cp->tail ) == 3 ) {
+			continue;
+		}
+		if ( sscanf ( line, "resume %ld %u", &cp->offset, &cp->line ) == 2 ) {
+			continue;
+		}
+		if ( sscanf ( line, "next_id %u", &cp->next_id ) == 1 ) {
+			continue;
+		}
+		if ( sscanf ( line, "features %u", &cp->num_features ) == 1 ) {
+			continue;
+		}
+		size[0] = size[1] = size[2] = 0;
+		pos = 0;
+		if ( 	sscanf ( line, "shp %ld %ld %ld %n", &size[0], &size[1], &size[2], &pos ) == 3 ||
+				sscanf ( line, "text %ld %n", &size[0], &pos ) == 1 ) {
+			if ( pos < 1 || cp->num_outputs >= INCREMENTAL_MAX_OUTPUTS ) {
+				valid = FALSE;
+				break;
+			}
+			cp->outputs[cp->num_outputs].path = strdup ( &line[pos] );
+			cp->outputs[cp->num_outputs].size[0] = size[0];
+			cp->outputs[cp->num_outputs].size[1] = size[1];
+			cp->outputs[cp->num_outputs].size[2] = size[2];
+			cp->num_outputs ++;
+			continue;
+		}
+		valid = FALSE;
+	}
+	fclose ( fp );
+
+	if ( cp->line < 1 || cp->offset < 0 || cp->offset > cp->end_offset ) {
+		valid = FALSE;
+	}
+
+	return ( valid );
+}
+
+
+/*
+ * Helper function for incremental_begin(): checks that all output
+ * files of the earlier run still exist and are at least as large as
+ * they were at the end of that run.
+ */
+BOOLEAN incremental_outputs_ok ( incremental_checkpoint *cp )
+{
+	int i, j;
+	char *shx;
+	long size[3];
+
+
+	for ( i = 0; i < cp->num_outputs; i ++ ) {
+		size[0] = t_file_size_utf8 ( cp->outputs[i].path );
+		size[1] = 0;
+		size[2] = 0;
+		if ( cp->outputs[i].size[1] > 0 ) {
+			char *dbf;
+			/* Shapefile */
+			shx = strdup ( cp->outputs[i].path );
+			dbf = strdup ( cp->outputs[i].path );
+			if ( strlen (shx) > strlen (".shp") ) {
+				strcpy ( &shx[strlen (shx) - strlen (".shp")], ".shx" );
+				strcpy ( &dbf[strlen (dbf) - strlen (".shp")], ".dbf" );
+			}
+			size[1] = t_file_size_utf8 ( shx );
+			size[2] = t_file_size_utf8 ( dbf );
+			free ( shx );
+			free ( dbf );
+		}
+		for ( j = 0; j < 3; j ++ ) {
+			if ( size[j] < cp->outputs[i].size[j] ) {
+				return ( FALSE );
+			}
+		}
+	}
+
+	return ( TRUE );
+}
+
+
+/*
+ * Creates the checkpoint for processing the one input file in "opts"
+ * and decides where to start reading it: If there is a valid checkpoint
+ * file from an earlier run with the same options, and the input file
+ * has only grown since then, then reading continues where that run
+ * stopped. Otherwise, all data will be processed (and all output files
+ * will be written anew).
+ *
+ * This also sets the geom ID to continue with (see geom_set_next_id()).
+ *
+ * Returns a new checkpoint, or NULL on fatal error (with a message).
+ */
+incremental_checkpoint *incremental_begin ( options *opts )
+{
+	incremental_checkpoint *cp;
+	const char *reason = NULL;
+	long size;
+	long len;
+	int i;
+
+
+	if ( opts->num_input != 1 || opts->input_streams != NULL || !strcmp ( opts->input[0], "-" ) ) {
+		err_show ( ERR_EXIT, _("\nIncremental mode requires exactly one input file (not \"stdin\").") );
+		return ( NULL );
+	}
+
+	cp = malloc ( sizeof (incremental_checkpoint) );
+	cp->path = malloc ( sizeof (char) * ( strlen (opts->output) + strlen (opts->base) + strlen (INCREMENTAL_EXTENSION) + 2 ) );
+	sprintf ( cp->path, "%s%c%s%s", opts->output, PRG_FILE_SEPARATOR, opts->base, INCREMENTAL_EXTENSION );
+	cp->config = 0;
+	cp->resume = FALSE;
+	cp->no_new_data = FALSE;
+	cp->offset = 0;
+	cp->line = 1;
+	cp->end_offset = 0;
+	cp->head = 0;
+	cp->tail = 0;
+	cp->next_id = 0;
+	cp->num_features = 0;
+	cp->num_outputs = 0;
+	cp->num_held = 0;
+	cp->held = NULL;
+	for ( i = 0; i < GEOM_TYPE_ALL; i ++ ) {
+		cp->selected[i] = NULL;
+	}
+
+	/* check everything that must not have changed since the earlier run */
+	size = t_file_size_utf8 ( opts->input[0] );
+	if ( incremental_read ( cp ) == FALSE ) {
+		reason = _("no valid checkpoint");
+	} else if ( cp->config != incremental_hash_config ( opts ) ) {
+		reason = _("options or parser schema changed");
+	} else if ( size < cp->end_offset ) {
+		reason = _("input file changed");
+	} else {
+		len = cp->end_offset < INCREMENTAL_HASH_LEN ? cp->end_offset : INCREMENTAL_HASH_LEN;
+		if ( 	incremental_hash_file ( opts->input[0], 0, len ) != cp->head ||
+				incremental_hash_file ( opts->input[0], cp->end_offset - len, len ) != cp->tail ) {
+			reason = _("input file changed");
+		} else if ( incremental_outputs_ok ( cp ) == FALSE ) {
+			reason = _("output files changed");
+		}
+	}
+
+	if ( reason != NULL ) {
+		/* process all data */
+		for ( i = 0; i < cp->num_outputs; i ++ ) {
+			free ( cp->outputs[i].path );
+		}
+		cp->num_outputs = 0;
+		cp->num_features = 0;
+		cp->offset = 0;
+		cp->line = 1;
+		err_show ( ERR_NOTE, _("\nIncremental mode: processing all data (%s)."), reason );
+	} else {
+		cp->resume = TRUE;
+		geom_set_next_id ( cp->next_id );
+		if ( size == cp->end_offset ) {
+			cp->no_new_data = TRUE;
+			err_show ( ERR_NOTE, _("\nIncremental mode: no new data in input file '%s'."), opts->input[0] );
+		} else {
+			err_show ( ERR_NOTE, _("\nIncremental mode: continuing from line %u of input file '%s'."),
+					cp->line, opts->input[0] );
+		}
+	}
+	cp->config = incremental_hash_config ( opts );
+
+	return ( cp );
+}
+
+
+/*
+ * Sets up data store "storage" so that parser_consume_input()
+ * starts reading where the earlier run stopped.
+ */
+void incremental_set_start ( incremental_checkpoint *cp, parser_data_store *storage )
+{
+	storage->start_offset = cp->offset;
+	storage->start_line = cp->line;
+}
+
+
+/*
+ * Helper function for incremental_hold(): returns the index of the
+ * first record of the geometry that is still open at the end of
+ * "storage" (i.e. that may be continued by records that are appended
+ * to the input later on), or "storage->slot" if there is none.
+ * Which geometry this is depends on the tagging mode (see parser.h).
+ */
+unsigned int incremental_find_open ( parser_data_store *storage, parser_desc *parser )
+{
+	parser_record *rec = storage->records;
+	int last, i;
+
+
+	/* last valid record */
+	last = (int) storage->slot - 1;
+	while ( last >= 0 && !( storage->flags[last] & PARSER_RECORD_VALID ) ) {
+		last --;
+	}
+	if ( last < 0 ) {
+		return ( storage->slot );
+	}
+
+	if ( parser->tag_mode == PARSER_TAG_MODE_MIN ) {
+		/* all records from the last line or polygon tag on */
+		for ( i = (int) storage->slot - 1; i >= 0; i -- ) {
+			if ( rec[i].tag != NULL ) {
+				if ( 	parser_is_tag ( parser, PARSER_GEOM_TAG_LINE, (const char*) rec[i].tag ) ||
+						parser_is_tag ( parser, PARSER_GEOM_TAG_POLY, (const char*) rec[i].tag ) ) {
+					return ( (unsigned int) i );
+				}
+				break;
+			}
+		}
+	}
+
+	if ( parser->tag_mode == PARSER_TAG_MODE_MAX ) {
+		/* all records from the first vertex of the last line or polygon
+		   on, if that is not followed by records with other keys */
+		int first = -1;
+		for ( i = last; i >= 0; i -- ) {
+			if ( 	( storage->flags[i] & PARSER_RECORD_VALID ) && rec[i].tag != NULL && rec[i].key != NULL &&
+					( parser_is_tag ( parser, PARSER_GEOM_TAG_LINE, (const char*) rec[i].tag ) ||
+					  parser_is_tag ( parser, PARSER_GEOM_TAG_POLY, (const char*) rec[i].tag ) ) ) {
+				if ( first >= 0 && strcmp ( rec[i].key, rec[first].key ) != 0 ) {
+					break;
+				}
+				first = i;
+			}
+		}
+		if ( first >= 0 ) {
+			return ( (unsigned int) first );
+		}
+	}
+
+	if ( parser->tag_mode == PARSER_TAG_MODE_END ) {
+		/* untagged records at the end that share the key of the last
+		   one: a line or polygon tag may still follow */
+		int first = -1;
+		for ( i = last; i >= 0; i -- ) {
+			if ( 	!( storage->flags[i] & PARSER_RECORD_VALID ) || rec[i].tag != NULL || rec[i].key == NULL ||
+					strcmp ( rec[i].key, rec[last].key ) != 0 ) {
+				break;
+			}
+			first = i;
+		}
+		if ( first >= 0 ) {
+			return ( (unsigned int) first );
+		}
+	}
+
+	return ( storage->slot );
+}
+
+
+/*
+ * Helper function for qsort() and bsearch(): compares two geom IDs.
+ */
+int incremental_compare_ids ( const void *a, const void *b )
+{
+	unsigned int id_a = *((const unsigned int*) a);
+	unsigned int id_b = *((const unsigned int*) b);
+
+	if ( id_a < id_b ) {
+		return ( -1 );
+	}
+	if ( id_a > id_b ) {
+		return ( 1 );
+	}
+	return ( 0 );
+}
+
+
+/*
+ * Helper function: returns TRUE if the geometry "geom_id" is held
+ * back (see incremental_hold()).
+ */
+BOOLEAN incremental_is_held ( incremental_checkpoint *cp, unsigned int geom_id )
+{
+	if ( cp->num_held < 1 ) {
+		return ( FALSE );
+	}
+	return ( bsearch ( &geom_id, cp->held, cp->num_held, sizeof (unsigned int), incremental_compare_ids ) != NULL );
+}
+
+
+/*
+ * Finds the geometry that is still open at the end of the input data
+ * in "storage" (after multiplexing and fusing multi-part geometries)
+ * and sets the point at which the next run must start reading again:
+ * at the first line of the open geometry, or after the last complete
+ * line read, if there is none. The geometries read from the lines that
+ * will be read again are "held": they will be written after all others
+ * (see incremental_select()).
+ *
+ * If the open geometry has been fused with earlier parts of a multi-part
+ * geometry, then it cannot be held (the earlier parts would not be read
+ * again): it is then treated like all others.
+ */
+void incremental_hold ( incremental_checkpoint *cp, parser_data_store *storage,
+		parser_desc *parser, options *opts )
+{
+	parser_record *rec = storage->records;
+	unsigned int first;
+	unsigned int i;
+	FILE *fp;
+	char *line;
+	int err_no;
+
+
+	cp->next_id = geom_get_next_id ();
+	cp->end_offset = storage->end_offset;
+
+	first = incremental_find_open ( storage, parser );
+
+	/* collect IDs of all geometries that will be read again */
+	cp->num_held = 0;
+	if ( first < storage->slot ) {
+		cp->held = malloc ( sizeof (unsigned int) * ( storage->slot - first ) );
+		for ( i = first; i < storage->slot; i ++ ) {
+			if ( ( storage->flags[i] & PARSER_RECORD_VALID ) && storage->geom_type[i] != GEOM_TYPE_NONE ) {
+				cp->held[cp->num_held] = storage->geom_id[i];
+				cp->num_held ++;
+			}
+		}
+		qsort ( cp->held, cp->num_held, sizeof (unsigned int), incremental_compare_ids );
+		/* cannot hold parts of multi-part geometries that started earlier */
+		for ( i = 0; i < first; i ++ ) {
+			if ( 	( storage->flags[i] & PARSER_RECORD_VALID ) && storage->geom_type[i] != GEOM_TYPE_NONE &&
+					incremental_is_held ( cp, storage->geom_id[i] ) == TRUE ) {
+				first = storage->slot;
+				cp->num_held = 0;
+				break;
+			}
+		}
+	}
+
+	if ( first >= storage->slot ) {
+		/* nothing open: continue after the last line */
+		cp->offset = storage->end_offset;
+		cp->line = storage->end_line;
+		return;
+	}
+
+	/* find the byte offset of the first line of the open geometry */
+#ifdef MINGW
+	fp = t_fopen_utf8 ( opts->input[0], "rt" );
+#else
+	fp = t_fopen_utf8 ( opts->input[0], "r" );
+#endif
+	if ( fp == NULL || fseek ( fp, storage->start_offset, SEEK_SET ) != 0 ) {
+		/* close first: err_show() does not return in a library context */
+		err_no = errno;
+		if ( fp != NULL ) {
+			fclose ( fp );
+		}
+		err_show ( ERR_EXIT, _("Cannot open input file for reading ('%s').\nReason: %s"),
+				opts->input[0], strerror (err_no));
+		return;
+	}
+	line = malloc ( sizeof (char) * PARSER_MAX_FILE_LINE_LENGTH );
+	cp->line = storage->start_line;
+	cp->offset = storage->start_offset;
+	while ( cp->line < rec[first].line && fgets ( line, PARSER_MAX_FILE_LINE_LENGTH, fp ) != NULL ) {
+		cp->line ++;
+		cp->offset = ftell ( fp );
+	}
+	free ( line );
+	fclose ( fp );
+}
+
+
+/*
+ * Restores all output files to the sizes recorded in the checkpoint:
+ * Everything written after that (i.e. the geometries held back by the
+ * earlier run or output of an interrupted run) is removed. Output files
+ * that are not in the checkpoint are deleted.
+ *
+ * "gs" must have its output paths set (see geom_store_make_paths()).
+ *
+ * Returns 0 on success, -1 on error (with a message).
+ */
+int incremental_rollback ( incremental_checkpoint *cp, geom_store *gs, options *opts )
+{
+	char *paths[INCREMENTAL_MAX_OUTPUTS][3];
+	char failed[PRG_MAX_PATH_LENGTH];
+	int num, i, j;
+	int result = 0;
+	long size[3];
+
+
+	num = incremental_get_layers ( gs, opts, paths );
+	for ( i = 0; i < num && result == 0; i ++ ) {
+		size[0] = size[1] = size[2] = 0;
+		for ( j = 0; j < cp->num_outputs; j ++ ) {
+			if ( !strcmp ( cp->outputs[j].path, paths[i][0] ) ) {
+				size[0] = cp->outputs[j].size[0];
+				size[1] = cp->outputs[j].size[1];
+				size[2] = cp->outputs[j].size[2];
+				break;
+			}
+		}
+		if ( paths[i][1] != NULL ) {
+			result = export_SHP_rollback ( paths[i][0], paths[i][2], size[0], size[1], size[2] );
+		} else if ( size[0] <= 0 ) {
+			t_remove_utf8 ( paths[i][0] );
+		} else {
+			result = t_truncate_utf8 ( paths[i][0], size[0] );
+		}
+		if ( result != 0 ) {
+			snprintf ( failed, PRG_MAX_PATH_LENGTH, "%s", paths[i][0] );
+		}
+	}
+	incremental_free_layers ( paths, num );
+
+	if ( result != 0 ) {
+		err_show ( ERR_EXIT, _("\nCannot restore output file '%s' to its state after the last run.\nDelete the output files to process all data again."),
+				failed );
+	}
+
+	return ( result );
+}
+
+
+/*
+ * Helper function for incremental_select(): applies the selection
+ * "mode" to one geometry.
+ */
+BOOLEAN incremental_select_geom ( incremental_checkpoint *cp, int GEOM_TYPE, int i,
+		unsigned int geom_id, int mode )
+{
+	if ( cp->selected[GEOM_TYPE][i] == FALSE ) {
+		return ( FALSE );
+	}
+	if ( mode == INCREMENTAL_SELECT_FINISHED ) {
+		return ( incremental_is_held ( cp, geom_id ) == FALSE );
+	}
+	if ( mode == INCREMENTAL_SELECT_HELD ) {
+		return ( incremental_is_held ( cp, geom_id ) );
+	}
+	return ( TRUE );
+}
+
+
+/*
+ * Selects geometries in "gs" for one export pass, according to "mode":
+ * INCREMENTAL_SELECT_FINISHED selects only those that will not be read
+ * again, INCREMENTAL_SELECT_HELD only those that will (see
+ * incremental_hold()). INCREMENTAL_SELECT_ALL restores the selection
+ * that was made before the first call (see selections_apply_all()).
+ * Geometries that were not selected in the first place never are.
+ *
+ * Returns the number of geometries selected.
+ */
+int incremental_select ( incremental_checkpoint *cp, geom_store *gs, int mode )
+{
+	int num[GEOM_TYPE_ALL];
+	int i, num_selected;
+
+
+	num[GEOM_TYPE_POINT] = gs->num_points;
+	num[GEOM_TYPE_LINE] = gs->num_lines;
+	num[GEOM_TYPE_POLY] = gs->num_polygons;
+	num[GEOM_TYPE_POINT_RAW] = gs->num_points_raw;
+
+	/* keep original selection */
+	if ( cp->selected[GEOM_TYPE_POINT] == NULL ) {
+		for ( i = 0; i < GEOM_TYPE_ALL; i ++ ) {
+			cp->selected[i] = malloc ( sizeof (BOOLEAN) * ( num[i] + 1 ) );
+		}
+		for ( i = 0; i < gs->num_points; i ++ )
+			cp->selected[GEOM_TYPE_POINT][i] = gs->points[i].is_selected;
+		for ( i = 0; i < gs->num_lines; i ++ )
+			cp->selected[GEOM_TYPE_LINE][i] = gs->lines[i].is_selected;
+		for ( i = 0; i < gs->num_polygons; i ++ )
+			cp->selected[GEOM_TYPE_POLY][i] = gs->polygons[i].is_selected;
+		for ( i = 0; i < gs->num_points_raw; i ++ )
+			cp->selected[GEOM_TYPE_POINT_RAW][i] = gs->points_raw[i].is_selected;
+	}
+
+	for ( i = 0; i < gs->num_points; i ++ )
+		gs->points[i].is_selected = incremental_select_geom ( cp, GEOM_TYPE_POINT, i, gs->points[i].geom_id, mode );
+	for ( i = 0; i < gs->num_lines; i ++ )
+		gs->lines[i].is_selected = incremental_select_geom ( cp, GEOM_TYPE_LINE, i, gs->lines[i].geom_id, mode );
+	for ( i = 0; i < gs->num_polygons; i ++ )
+		gs->polygons[i].is_selected = incremental_select_geom ( cp, GEOM_TYPE_POLY, i, gs->polygons[i].geom_id, mode );
+	for ( i = 0; i < gs->num_points_raw; i ++ )
+		gs->points_raw[i].is_selected = incremental_select_geom ( cp, GEOM_TYPE_POINT_RAW, i, gs->points_raw[i].geom_id, mode );
+
+	num_selected = 0;
+	for ( i = 0; i < GEOM_TYPE_ALL; i ++ ) {
+		num_selected += selections_get_num_selected ( i, gs );
+	}
+
+	return ( num_selected );
+}
+
+
+/*
+ * Takes the current sizes of all output files of "gs" as the new
+ * checkpoint state: the next run will cut off everything written
+ * after this. "num_features" features have been added to the output.
+ */
+void incremental_commit ( incremental_checkpoint *cp, geom_store *gs, options *opts, int num_features )
+{
+	char *paths[INCREMENTAL_MAX_OUTPUTS][3];
+	int num, i, j;
+
+
+	for ( i = 0; i < cp->num_outputs; i ++ ) {
+		free ( cp->outputs[i].path );
+	}
+	cp->num_outputs = 0;
+
+	num = incremental_get_layers ( gs, opts, paths );
+	for ( i = 0; i < num; i ++ ) {
+		long size = t_file_size_utf8 ( paths[i][0] );
+		if ( size <= 0 ) {
+			continue;
+		}
+		cp->outputs[cp->num_outputs].path = strdup ( paths[i][0] );
+		cp->outputs[cp->num_outputs].size[0] = size;
+		for ( j = 1; j < 3; j ++ ) {
+			cp->outputs[cp->num_outputs].size[j] = 0;
+			if ( paths[i][j] != NULL ) {
+				cp->outputs[cp->num_outputs].size[j] = t_file_size_utf8 ( paths[i][j] );
+			}
+		}
+		cp->num_outputs ++;
+	}
+	incremental_free_layers ( paths, num );
+
+	cp->num_features += num_features;
+}
+
+
+/*
+ * Writes the checkpoint file, after all output has been written.
+ *
+ * Returns 0 on success, -1 on error (with a warning).
+ */
+int incremental_end ( incremental_checkpoint *cp, options *opts )
+{
+	FILE *fp;
+	long len;
+	int i;
+
+
+	len = cp->end_offset < INCREMENTAL_HASH_LEN ? cp->end_offset : INCREMENTAL_HASH_LEN;
+	cp->head = incremental_hash_file ( opts->input[0], 0, len );
+	cp->tail = incremental_hash_file ( opts->input[0], cp->end_offset - len, len );
+
+	fp = t_fopen_utf8 ( cp->path, "w" );
+	if ( fp == NULL ) {
+		err_show ( ERR_WARN, _("\nCannot write checkpoint file '%s'.\nReason: %s"), cp->path, strerror (errno) );
+		return ( -1 );
+	}
+	fprintf ( fp, "%s\n", INCREMENTAL_HEADER );
+	fprintf ( fp, "config %lx\n", cp->config );
+	fprintf ( fp, "input %ld %lx %lx\n", cp->end_offset, cp->head, cp->tail );
+	fprintf ( fp, "resume %ld %u\n", cp->offset, cp->line );
+	fprintf ( fp, "next_id %u\n", cp->next_id );
+	fprintf ( fp, "features %u\n", cp->num_features );
+	for ( i = 0; i < cp->num_outputs; i ++ ) {
+		if ( cp->outputs[i].size[1] > 0 ) {
+			fprintf ( fp, "shp %ld %ld %ld %s\n", cp->outputs[i].size[0], cp->outputs[i].size[1],
+					cp->outputs[i].size[2], cp->outputs[i].path );
+		} else {
+			fprintf ( fp, "text %ld %s\n", cp->outputs[i].size[0], cp->outputs[i].path );
+		}
+	}
+	if ( fclose ( fp ) != 0 ) {
+		err_show ( ERR_WARN, _("\nCannot write checkpoint file '%s'.\nReason: %s"), cp->path, strerror (errno) );
+		return ( -1 );
+	}
+
+	return ( 0 );
+}
+
+
+/*
+ * Releases all memory of checkpoint "cp".
+ */
+void incremental_destroy ( incremental_checkpoint *cp )
+{
+	int i;
+
+	if ( cp == NULL ) {
+		return;
+	}
+	for ( i = 0; i < cp->num_outputs; i ++ ) {
+		free ( cp->outputs[i].path );
+	}
+	for ( i = 0; i < GEOM_TYPE_ALL; i ++ ) {
+		t_free ( cp->selected[i] );
+	}
+	t_free ( cp->held );
+	free ( cp->path );
+	free ( cp );
+}
@@ -0,0 +1,125 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	incremental.h
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Incremental mode ("--incremental"): processes only the data
+ * 				that has been appended to a growing input file since the
+ * 				last run.
+ *
+ * 				A checkpoint file next to the output records up to which
+ * 				line the input has been read, the geometry ID to continue
+ * 				with and the size of each output file. The next run checks
+ * 				that the input still starts (and continues) as it did, reads
+ * 				only the lines after that point and appends the new features
+ * 				to the existing output files.
+ *
+ * 				The last geometry of a run may still be continued by the
+ * 				next measurements. It is written last, after the checkpoint
+ * 				sizes of the output files have been taken. The next run cuts
+ * 				it off again and reads its lines once more, together with
+ * 				the new ones.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include "global.h"
+
+#include "geom.h"
+#include "options.h"
+#include "parser.h"
+
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+/* extension of the checkpoint file ("<output>/<base>.checkpoint") */
+#define INCREMENTAL_EXTENSION	".checkpoint"
+
+/* first line of a checkpoint file (includes format version) */
+#define INCREMENTAL_HEADER		"survey2gis checkpoint 1"
+
+/* number of bytes at the start and the end of the input that must not change */
+#define INCREMENTAL_HASH_LEN	4096
+
+/* max. number of output layers (one file each, or Shapefile with .shx and .dbf) */
+#define INCREMENTAL_MAX_OUTPUTS	5
+
+/* selections made by incremental_select() */
+#define INCREMENTAL_SELECT_FINISHED	0 /* only geometries that cannot change any more */
+#define INCREMENTAL_SELECT_HELD		1 /* only geometries that may still be continued */
+#define INCREMENTAL_SELECT_ALL		2 /* restore original selection */
+
+/*
+ * Committed size of one output layer.
+ */
+typedef struct incremental_output incremental_output;
+struct incremental_output
+{
+	char *path; /* Shapefile (".shp") or text output file */
+	long size[3]; /* sizes of ".shp", ".shx" and ".dbf" files (Shapefile) or of the text file */
+};
+
+/*
+ * State of incremental processing of one input file.
+ */
+typedef struct incremental_checkpoint incremental_checkpoint;
+struct incremental_checkpoint
+{
+	char *path; /* checkpoint file */
+	unsigned long config; /* hash of options, file names and parser schema */
+	BOOLEAN resume; /* TRUE if continuing an earlier run */
+	BOOLEAN no_new_data; /* TRUE if the input has not grown since the earlier run */
+	long offset; /* byte offset in input at which reading (re)starts */
+	unsigned int line; /* number of the line that starts there */
+	long end_offset; /* the earlier run read the input up to here */
+	unsigned long head, tail; /* hashes of the first and last bytes read */
+	unsigned int next_id; /* geom ID to continue with */
+	unsigned int num_features; /* number of features written and finished */
+	int num_outputs; /* number of output layers with committed sizes */
+	incremental_output outputs[INCREMENTAL_MAX_OUTPUTS];
+	/* the following are only used during one run */
+	int num_held; /* number of geometries that may still be continued */
+	unsigned int *held; /* their geom IDs (sorted) */
+	BOOLEAN *selected[GEOM_TYPE_ALL]; /* original selection state (by geometry type) */
+};
+
+/* add bytes to an FNV-1a hash (also used for snapshots) */
+unsigned long incremental_hash ( unsigned long hash, const char *data, size_t len );
+
+/* hash part of a file (also used for snapshots) */
+unsigned long incremental_hash_file ( const char *path, long offset, long len );
+
+/* read and check the checkpoint of an earlier run (if any) */
+incremental_checkpoint *incremental_begin ( options *opts );
+
+/* make a data store continue where the earlier run stopped */
+void incremental_set_start ( incremental_checkpoint *cp, parser_data_store *storage );
+
+/* find geometries that may still be continued and the next starting point */
+void incremental_hold ( incremental_checkpoint *cp, parser_data_store *storage,
+		parser_desc *parser, options *opts );
+
+/* remove everything from the output files that was written after the checkpoint */
+int incremental_rollback ( incremental_checkpoint *cp, geom_store *gs, options *opts );
+
+/* select geometries for one export pass; returns number selected */
+int incremental_select ( incremental_checkpoint *cp, geom_store *gs, int mode );
+
+/* take the sizes of all output files as the new checkpoint */
+void incremental_commit ( incremental_checkpoint *cp, geom_store *gs, options *opts, int num_features );
+
+/* write the checkpoint file */
+int incremental_end ( incremental_checkpoint *cp, options *opts );
+
+/* release all memory of a checkpoint */
+void incremental_destroy ( incremental_checkpoint *cp );
+
+#endif /* INCREMENTAL_H */
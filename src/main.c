@@ -22,8 +22,6 @@
  */
 
 
-#define MAIN
-
 #include <errno.h>
 #include <libgen.h>
 #include <math.h>
@@ -34,6 +32,7 @@
 
 #include "global.h"
 
+#include "batch.h"
 #include "errors.h"
 #include "export.h"
 #include "selections.h"
@@ -45,12 +44,10 @@
 #include "options.h"
 #include "reproj.h"
 #include "parser.h"
+#include "s2g.h"
+#include "serve.h"
 #include "tools.h"
-
-/* these are defined 'extern' in global.h */
-char *PRG_NAME_CLI;
-char *PRG_PATH_CLI;
-char *PRG_DIR_CLI;
+#include "watch.h"
 
 #ifdef GUI
 #include "logo.xpm"
@@ -166,6 +163,9 @@ void show_init_msg ( options *opts )
 		srs_out = strdup(srs_in);
 	}
 	err_show (ERR_NOTE, _("\tOutput SRS: '%s'"), srs_out);
+	if ( opts->proj_approx > 0.0 ) {
+		err_show (ERR_NOTE, _("\tApproximate reprojection, max. error in metres: %f"), opts->proj_approx);
+	}
 	free(srs_in);
 	free(srs_out);
 	err_show (ERR_NOTE, _("Output orientation: %s"), OPTIONS_ORIENT_MODE_NAMES[opts->orient_mode]);
@@ -191,6 +191,11 @@ void show_init_msg ( options *opts )
 	} else {
 		err_show (ERR_NOTE, _("Snapping dist. (line nodes): %f"), opts->dangling);
 	}
+	if ( opts->simplify_lines > 0.0 || opts->simplify_polys > 0.0 ) {
+		err_show (ERR_NOTE, _("Simplification tolerance (lines): %f"), opts->simplify_lines);
+		err_show (ERR_NOTE, _("Simplification tolerance (polygons): %f"), opts->simplify_polys);
+		err_show (ERR_NOTE, _("Simplification mode: %s"), OPTIONS_SIMPLIFY_MODE_NAMES[opts->simplify_mode]);
+	}
 	if ( opts->offset_x == 0 ) {
 		err_show (ERR_NOTE, _("X coordinate offset: 0"), opts->offset_x);
 	} else {
@@ -224,287 +229,22 @@ void show_init_msg ( options *opts )
 		err_show (ERR_NOTE, _("Parser running in 'strict' mode."));
 	if ( opts->force_english == TRUE )
 		err_show (ERR_NOTE, _("Messages and decimal notation set to English."));
+	if ( opts->spatial_index == TRUE )
+		err_show (ERR_NOTE, _("Spatial index files (.qix) will be written for Shapefile output."));
+	if ( opts->record_separator == TRUE )
+		err_show (ERR_NOTE, _("GeoJSONL features will start with a record separator (RFC 8142)."));
+	if ( opts->hilbert_order == TRUE )
+		err_show (ERR_NOTE, _("Output features will be sorted in spatial (Hilbert curve) order."));
+	if ( opts->profile == TRUE && opts->output != NULL && opts->base != NULL )
+		err_show (ERR_NOTE, _("Run-time profile will be saved as: %s%c%s_profile.json"),
+				opts->output, PRG_FILE_SEPARATOR, opts->base );
+	if ( options_has_format ( opts, PRG_OUTPUT_MVT ) == TRUE )
+		err_show (ERR_NOTE, _("Vector tile zoom levels: %i to %i"), opts->min_zoom, opts->max_zoom);
+	err_show (ERR_NOTE, _("Max. number of parallel threads: %i"), opts->threads);
 	err_show (ERR_NOTE, _("\n* Processing messages follow below.\n"));
 }
 
 
-/*
- * Clean label attribute field contents of any excess tokens (if required).
- */
-void clean_label_atts ( options *opts, parser_desc* parser, geom_store *gs ) {
-	if (opts->label_field != NULL ) {
-		{
-			int i = 0;
-			int j = 0;
-			int label_field_idx = -1;
-			char **atts = NULL;
-			while ( parser->fields[i] != NULL ) {
-				if ( !strcasecmp (parser->fields[i]->name, opts->label_field)  ) {
-					label_field_idx = i;
-					break;
-				}
-				i ++;
-			}
-			if ( label_field_idx >= 0 ) {
-				for ( j = 0; j < parser_get_num_tags ( parser, GEOM_TYPE_POINT ); j ++ ) {
-				//if ( parser->geom_tag_point != NULL ) { DELETE ME
-					//char *geom_tag = parser->geom_tag_point; DELETE ME
-					const char *geom_tag = parser_get_tag ( parser, GEOM_TYPE_POINT, j );
-					int geom_tag_len = strlen(geom_tag);
-					for ( i = 0; i < gs->num_points; i ++ ) {
-						if ( gs->points[i].is_selected == TRUE ) {
-							if ( gs->points[i].has_label == TRUE ) {
-								atts = gs->points[i].atts;
-								if ( atts[label_field_idx] != NULL ) {
-									char *content = t_str_pack (atts[label_field_idx]); /* get trimmed copy of field content */
-									if ( content != NULL && strlen (content) > 0 ) {
-										if ( strlen (content) > geom_tag_len ) {
-											/* There may be something here, other than the tag. */
-											char *tag = strstr(content,geom_tag);
-											if ( tag != NULL ) {
-												/* Tag found: Attempt to remove! */
-												int position = tag - content;
-												if ( position == 0 ) {
-													/* geom tag is at beginning of content */
-													int p;
-													for ( p = 0; p < geom_tag_len; p ++ ) {
-														tag ++; /* move pointer by one char */
-													}
-													char *purged = t_str_pack (tag); /* we are now positioned after the tag */
-													if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
-														/* swap for new content */
-														t_free (atts[label_field_idx]);
-														atts[label_field_idx] = purged;
-													}
-													t_free (content);
-												}
-												else if ( position == ( strlen(content) - geom_tag_len ) ) {
-													/* geom tag is at end of content */
-													*tag = '\0'; /* cut off here */
-													char *purged = t_str_pack (content);
-													if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
-														/* swap for new content */
-														t_free (atts[label_field_idx]);
-														atts[label_field_idx] = purged;
-													}
-													t_free (content);
-												}
-												/* in all other cases: we can do nothing */
-											}
-										}
-									}
-								}
-							}
-						}
-					}
-				}
-				for ( j = 0; j < parser_get_num_tags ( parser, GEOM_TYPE_LINE ); j ++ ) {
-				//if ( parser->geom_tag_line != NULL ) { DELETE ME
-					//char *geom_tag = parser->geom_tag_line; DELETE ME
-					const char *geom_tag = parser_get_tag ( parser, GEOM_TYPE_LINE, j );
-					int geom_tag_len = strlen(geom_tag);
-					for ( i = 0; i < gs->num_lines; i ++ ) {
-						if ( gs->lines[i].is_selected == TRUE ) {
-							int j;
-							for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
-								if ( gs->lines[i].parts[j].has_label == TRUE ) {
-									atts = gs->lines[i].atts;
-									if ( atts[label_field_idx] != NULL ) {
-										char *content = t_str_pack (atts[label_field_idx]); /* get trimmed copy of field content */
-										if ( content != NULL && strlen (content) > 0 ) {
-											if ( strlen (content) > geom_tag_len ) {
-												/* There may be something here, other than the tag. */
-												char *tag = strstr(content,geom_tag);
-												if ( tag != NULL ) {
-													/* Tag found: Attempt to remove! */
-													int position = tag - content;
-													if ( position == 0 ) {
-														/* geom tag is at beginning of content */
-														int p;
-														for ( p = 0; p < geom_tag_len; p ++ ) {
-															tag ++; /* move pointer by one char */
-														}
-														char *purged = t_str_pack (tag); /* we are now positioned after the tag */
-														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
-															/* swap for new content */
-															t_free (atts[label_field_idx]);
-															atts[label_field_idx] = purged;
-														}
-														t_free (content);
-													}
-													else if ( position == ( strlen(content) - geom_tag_len ) ) {
-														/* geom tag is at end of content */
-														*tag = '\0'; /* cut off here */
-														char *purged = t_str_pack (content);
-														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
-															/* swap for new content */
-															t_free (atts[label_field_idx]);
-															atts[label_field_idx] = purged;
-														}
-														t_free (content);
-													}
-													/* in all other cases: we can do nothing */
-												}
-											}
-										}
-									}
-								}
-							}
-						}
-					}
-				}
-				for ( j = 0; j < parser_get_num_tags ( parser, GEOM_TYPE_POLY ); j ++ ) {
-				//if ( parser->geom_tag_poly != NULL ) { DELETE ME
-					//char *geom_tag = parser->geom_tag_poly; DELETE ME
-					const char *geom_tag = parser_get_tag ( parser, GEOM_TYPE_POLY, j );
-					int geom_tag_len = strlen(geom_tag);
-					for ( i = 0; i < gs->num_polygons; i ++ ) {
-						if ( gs->polygons[i].is_selected == TRUE ) {
-							int j;
-							for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
-								if ( gs->polygons[i].parts[j].has_label == TRUE ) {
-									atts = gs->polygons[i].atts;
-									if ( atts[label_field_idx] != NULL ) {
-										char *content = t_str_pack (atts[label_field_idx]); /* get trimmed copy of field content */
-										if ( content != NULL && strlen (content) > 0 ) {
-											if ( strlen (content) > geom_tag_len ) {
-												/* There may be something here, other than the tag. */
-												char *tag = strstr(content,geom_tag);
-												if ( tag != NULL ) {
-													/* Tag found: Attempt to remove! */
-													int position = tag - content;
-													if ( position == 0 ) {
-														/* geom tag is at beginning of content */
-														int p;
-														for ( p = 0; p < geom_tag_len; p ++ ) {
-															tag ++; /* move pointer by one char */
-														}
-														char *purged = t_str_pack (tag); /* we are now positioned after the tag */
-														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
-															/* swap for new content */
-															t_free (atts[label_field_idx]);
-															atts[label_field_idx] = purged;
-														}
-														t_free (content);
-													}
-													else if ( position == ( strlen(content) - geom_tag_len ) ) {
-														/* geom tag is at end of content */
-														*tag = '\0'; /* cut off here */
-														char *purged = t_str_pack (content);
-														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
-															/* swap for new content */
-															t_free (atts[label_field_idx]);
-															atts[label_field_idx] = purged;
-														}
-														t_free (content);
-													}
-													/* in all other cases: we can do nothing */
-												}
-											}
-										}
-									}
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-	} /* DONE (remove geom markers from label fields) */
-}
-
-
-/*
- * Show processing statistics after job is done.
- */
-void show_stats ( unsigned int *topo_errors, options *opts, parser_data_store **storage ) {
-	int i, j;
-	unsigned int *num_total_lines;
-	unsigned int *num_invalid_lines;
-	unsigned int *num_points_rec;
-	unsigned int *num_lines_rec;
-	unsigned int *num_polygons_rec;
-	unsigned int *num_unassigned;
-
-
-	/* initialize validation statistics */
-	num_total_lines = malloc ( sizeof (unsigned int) * opts->num_input );
-	num_invalid_lines = malloc ( sizeof (unsigned int) * opts->num_input );
-	num_points_rec = malloc ( sizeof (unsigned int) * opts->num_input );
-	num_lines_rec = malloc ( sizeof (unsigned int) * opts->num_input );
-	num_polygons_rec = malloc ( sizeof (unsigned int) * opts->num_input );
-	num_unassigned = malloc ( sizeof (unsigned int) * opts->num_input );
-	for ( i=0; i < opts->num_input ; i ++ ) {
-		num_total_lines[i] = 0;
-		num_invalid_lines[i] = 0;
-		num_points_rec[i] = 0;
-		num_lines_rec[i] = 0;
-		num_polygons_rec[i] = 0;
-		num_unassigned[i] = 0;
-	}
-
-	/* get statistics */
-	for ( i=0; i < opts->num_input ; i ++ ) {
-		for ( j=0; j < storage[i]->num_records; j++ ) {
-			if ( 	storage[i]->records[j].is_empty == FALSE	) {
-				num_total_lines[i] ++;
-			}
-			if ( 	storage[i]->records[j].is_valid == FALSE &&
-					storage[i]->records[j].is_empty == FALSE	) {
-				num_invalid_lines[i] ++;
-			}
-			if ( 	storage[i]->records[j].is_valid == TRUE &&
-					storage[i]->records[j].is_empty == FALSE &&
-					storage[i]->records[j].geom_type == GEOM_TYPE_NONE ) {
-				num_unassigned[i] ++;
-			}
-			if ( 	storage[i]->records[j].is_valid == TRUE &&
-					storage[i]->records[j].is_empty == FALSE &&
-					storage[i]->records[j].geom_type == GEOM_TYPE_POINT ) {
-				num_points_rec[i] ++;
-			}
-			if ( 	storage[i]->records[j].is_valid == TRUE &&
-					storage[i]->records[j].is_empty == FALSE &&
-					storage[i]->records[j].geom_type == GEOM_TYPE_LINE ) {
-				num_lines_rec[i] ++;
-			}
-			if ( 	storage[i]->records[j].is_valid == TRUE &&
-					storage[i]->records[j].is_empty == FALSE &&
-					storage[i]->records[j].geom_type == GEOM_TYPE_POLY ) {
-				num_polygons_rec[i] ++;
-			}
-		}
-	}
-
-	/* log data statistics */
-	err_show (ERR_NOTE,_("\nParsing of %i input data source(s) completed. Validation statistics below."), opts->num_input );
-	for ( i = 0; i < opts->num_input; i ++ ) {
-		err_show (ERR_NOTE, "" );
-		if ( !strcmp (opts->input[i], "-") ) {
-			err_show (ERR_NOTE,_("%i\tData read from console input stream."), i+1 );
-		} else {
-			err_show (ERR_NOTE,_("%i\tData read from file \"%s\"."), i+1, opts->input[i] );
-		}
-		err_show (ERR_NOTE,_("\tTotal records/lines read: %i"), num_total_lines[i] );
-		err_show (ERR_NOTE,_("\tNumber of invalid records: %i"), num_invalid_lines[i] );
-		err_show (ERR_NOTE,_("\tNumber of valid records: %i"), storage[i]->slot - num_invalid_lines[i] );
-		err_show (ERR_NOTE,_("\t\tAssigned to %i points: %i"), storage[i]->num_points, num_points_rec[i] );
-		err_show (ERR_NOTE,_("\t\tAssigned to %i lines/parts: %i"), storage[i]->num_lines, num_lines_rec[i] );
-		err_show (ERR_NOTE,_("\t\tAssigned to %i polygons/parts: %i"), storage[i]->num_polygons, num_polygons_rec[i] );
-		err_show (ERR_NOTE,_("\t\tNot assigned to any geometry: %i"), num_unassigned[i] );
-		err_show (ERR_NOTE,_("\tTotal topological error count: %i"), topo_errors[i] );
-	}
-
-	/* free memory for data statistics */
-	free ( num_total_lines );
-	free ( num_invalid_lines );
-	free ( num_points_rec );
-	free ( num_lines_rec );
-	free ( num_polygons_rec );
-	free ( num_unassigned );
-}
-
-
 /*
  * Runs all program operations once, outputs result(s) if any.
  */
@@ -514,32 +254,11 @@ void run_once ( options *opts, GtkWidget *parent )
 void run_once ( options *opts )
 #endif
 {
-	int i;
 	int error;
-	char error_msg[PRG_MAX_STR_LEN] = "";
-	unsigned int *topo_errors;
-	unsigned int topo_errors_after_fusion = 0;
-	unsigned int duplicate_records;
-	unsigned int build_errors;
-	unsigned int fused_records;
-	unsigned int overlays = 0;
-	unsigned int removed_overlaps = 0;
-	unsigned int snaps_poly = 0;
-	unsigned int detected_intersections_ll = 0;
-	unsigned int detected_intersections_lp = 0;
-	unsigned int detected_intersections_pp = 0;
-	unsigned int self_intersects_lines = 0;
-	unsigned int self_intersects_polygons = 0;
-	unsigned int added_intersections_ll = 0;
-	unsigned int added_intersections_lp = 0;
-	unsigned int added_intersections_pp = 0;
-	unsigned int snapped_line_dangles = 0;
-	unsigned int reversed_vertex_lists = 0;
-	int bad_attributes;
+	t_profile prof; /* run-time profile (only if requested) */
 
 	parser_desc *parser;
-	parser_data_store **storage; /* data storage for each input file */
-	geom_store *gs;
+	s2g_run run = { 0, NULL, NULL, NULL, NULL, 0, NULL }; /* data produced by this run */
 
 
 #ifdef GUI
@@ -592,6 +311,9 @@ void run_once ( options *opts )
 	/* initialization message with program name, version number and numeric notation, as well as schema used */
 	show_init_msg ( opts );
 
+	/* start measuring run-time profile (if requested) */
+	t_profile_init ( &prof, opts->profile );
+
 	/* initialize reprojection engine */
 	reproj_init( opts );
 
@@ -621,491 +343,26 @@ void run_once ( options *opts )
 		return;
 	}
 
-	/* validate parser schema */
-	error = parser_desc_validate ( parser, opts );
-
-	/* only continue, if the parser is OK */
-	if ( error != 0 ) {
+	/* validate parser schema, check other settings */
+	if ( s2g_prepare ( opts, parser ) != S2G_OK ) {
 		parser_desc_destroy (parser);
 		return;
 	}
+	t_profile_stop ( &prof, "schema", -1 );
 
-	/* Check reprojection settings (if any)
-	 * We run this function as early as possible, because only after
-	 * it has completed can we safely query 'opts' for SRS data of
-	 * any kind!
-	 */
-
-	int reproj = reproj_parse_opts (opts);
-	if ( reproj != REPROJ_STATUS_OK ) {
-		/* a suitable error message will already have been produced by reproj_parse_opts() */
-		/* we only need to clean up and exit */
-		/* TODO: we have a lot of return statements that need to be checked for memory leaks */
-		return;
-	}
-
-	/* check that label field is valid */
-	if ( opts->label_field != NULL ) {
-		BOOLEAN found = FALSE;
-		for ( i = 0; i < PRG_MAX_FIELDS; i ++ ) {
-			if ( parser->fields[i] != NULL ) {
-				if ( !strcasecmp ( opts->label_field, parser->fields[i]->name ) ) {
-					found = TRUE;
-					break;
-				}
-			}
-		}
-		if ( found == FALSE ) {
-			err_show ( ERR_EXIT, _("\nLabel field \"%s\" not found in parser definition."), opts->label_field);
-			parser_desc_destroy (parser);
-			return;
-		}
-	}
-
-	/* validate selection expressions */
-	if ( selections_validate ( opts, parser ) == FALSE ) {
-		parser_desc_destroy (parser);
-		return;
-	}
-
-	/* create data storage objects */
-	storage = malloc ( sizeof ( parser_data_store* ) * opts->num_input );
-	for ( i=0; i < opts->num_input ; i ++ ) {
-		storage[i] = parser_data_store_create ( opts->input[i], parser,  opts );
-		if ( storage[i] == NULL ) {
-			err_show ( ERR_EXIT, _("\nFailed to create data storage object for data source #%i."), i+1 );
-			/* release data storage */
-			for ( i=0; i < opts->num_input ; i ++ ) {
-				if ( storage[i] != NULL )
-					parser_data_store_destroy ( storage[i] );
-			}
-			free ( storage );
-			/* release parser object */
-			parser_desc_destroy (parser);
-			return;
-		}
-	}
-
-	/* process input file(s) */
-	parser_consume_input ( parser, opts, storage );
-
-	/* Past this point we have valid input file records and coordinates for every measurement! */
-
-	/* Reproject data to change axis orientation (if requested). */
-	/* This must be done _before_ geom_store_build(), so that label point positions */
-	/* can be computed correctly later on! */
-	if ( opts->orient_mode == OPTIONS_ORIENT_MODE_LOCAL_XZ ) {
-		if ( reproj_srs_in_latlon(opts) == TRUE ) {
-			err_show ( ERR_EXIT, _("\nOrientation mode '%s' not supported for lat/lon input data."),
-					OPTIONS_ORIENT_MODE_NAMES[OPTIONS_ORIENT_MODE_LOCAL_XZ]);
-			free ( storage );
-			parser_desc_destroy (parser);
-			return;
-		}
-		/* check that a Z coordinate field has been declared */
-		if ( parser->coor_z == NULL ) {
-			err_show ( ERR_EXIT, _("\nCannot create local X-Z output for 2D input without Z field.") );
-			free ( storage );
-			parser_desc_destroy (parser);
-			return;
-		}
-		if ( opts->num_input > 1 ) {
-			err_show ( ERR_EXIT, _("\nCannot create local X-Z output for more than one data source."));
-			free ( storage );
-			parser_desc_destroy (parser);
-			return;
-		}
-		/* check that there is actual Z data */
-		if ( geom_ds_has_z (storage[0]) == FALSE ) {
-			err_show ( ERR_EXIT, _("\nCannot create local X-Z output: Z extent of data is '0.0'."));
-			free ( storage );
-			parser_desc_destroy (parser);
-			return;
-		}
-
-		/* perform re-orientation on first datastore ONLY */
-		geom_reorient_local_xz(storage[0]);
-	}
-
-	/* Basic geometry processing:
-	 * 1. Assign geom_id to all records that form a geometry.
-	 * 2. Eliminate duplicate coordinates, zero-length lines and zero-area polygons ("splinters").
-	 * 3. Snap coordinates
-	 */
-	/* TODO: Improve snapping and thresholding of points for lat/lon data*/
-	if ( reproj_srs_in_latlon(opts) == TRUE ) {
-		if ( opts->tolerance > 0.0 ) {
-			err_show (ERR_WARN, _("\nTopological cleaning of lat/lon data has limited accuracy."));
-			err_show (ERR_WARN, _("Results of eliminating duplicate vertices may be insufficient."));
-		}
-		if ( opts->snapping > 0.0 ) {
-			err_show (ERR_WARN, _("\nTopological cleaning of lat/lon data has limited accuracy."));
-			err_show (ERR_WARN, _("Results of snapping vertices may be insufficient."));
-		}
-	}
-	topo_errors = malloc ( sizeof ( unsigned int ) * opts->num_input );
-	for ( i=0; i < opts->num_input ; i ++ ) {
-		/* LEVEL: ALL */
-		topo_errors[i] = 0;
-		/* multiplex geometries into points, lines and polygons */
-		geom_multiplex ( storage[i], parser );
-		/* remove duplicate vertices */
-		topo_errors[i] += geom_topology_remove_duplicates ( storage[i], opts, FALSE );
-		/* remove splintered geometries */
-		topo_errors[i] += geom_topology_remove_splinters_lines ( storage[i], opts );
-		topo_errors[i] += geom_topology_remove_splinters_polygons ( storage[i], opts );
-	}
-
-	/* fuse multi-part geometries: assign a "part_id" to all
-	 * parts of a "master" geometry. */
-	fused_records = parser_ds_fuse ( storage, opts, parser );
-
-	/* evaluate "unique" attributes across ALL input data */
-	duplicate_records = parser_ds_validate_unique ( storage, opts, parser );
-
-	/* Advanced geometry processing */
-	gs = geom_store_new ();
-	/* 1. Build points, lines and polygons (also multi-part). */
-	build_errors = geom_store_build ( gs, storage, parser, opts );
-	if ( (gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons) < 1 ) {
-		err_show (ERR_EXIT, _("\nNo valid input data found. Aborting."));
-		free ( topo_errors );
-		free ( storage );
-		parser_desc_destroy (parser);
-		geom_store_destroy ( gs );
-		return;
-	}
-
-	/* apply selections (if any) to built geometries */
-	if ( selections_get_count ( opts ) > 0 ) {
-		selections_apply_all ( opts, parser, gs );
-		if ( selections_get_num_selected ( GEOM_TYPE_ALL, gs ) < 1 ) {
-			err_show (ERR_EXIT, _("\nNo valid input data left after selecting. Aborting."));
-			free ( topo_errors );
-			free ( storage );
-			parser_desc_destroy (parser);
-			geom_store_destroy ( gs );
-			return;
-		}
-	}
-
-	if ( geom_store_make_paths ( gs, opts, &error_msg[0] ) == 0 ) {
-
-		/* self-intersections can be present in lat/lon and X/Y data */
-		for ( i = 0; i < gs->num_lines; i ++ ) {
-			int j;
-			for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
-				self_intersects_lines += gs->lines[i].parts[j].err_self_intersects;
-			}
-		}
-		for ( i = 0; i < gs->num_polygons; i ++ ) {
-			int j;
-			for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
-				self_intersects_polygons += gs->polygons[i].parts[j].err_self_intersects;
-			}
-		}
-
-		/* Most topo operations are untested for lat/lon data: WARN. */
-		if ( opts->topo_level > OPTIONS_TOPO_LEVEL_NONE && reproj_srs_in_latlon(opts) == TRUE ) {
-			err_show (ERR_WARN, _("\nHigh-level topological cleaning of lat/lon data not implemented."));
-			err_show (ERR_WARN, _("Output data may suffer from topological defects."));
-		}
-		
-		/* Run the following only if topological cleaning is enabled. */
-		if ( opts->topo_level > OPTIONS_TOPO_LEVEL_NONE ) {
-			/* LEVEL: BASIC AND ABOVE */
-			/* Snap polygon boundaries */
-			snaps_poly = geom_topology_snap_boundaries_2D ( gs, opts );
-			geom_tools_update_bboxes (gs); /* update bounding boxes */
-			
-			/* Perform geometric AND operation to subtract polygon overlap areas */
-			if ( opts->topo_level > OPTIONS_TOPO_LEVEL_BASIC ) {
-				/* LEVEL: FULL */
-				removed_overlaps = geom_topology_poly_remove_overlap_2D ( gs, parser, opts );
-				geom_tools_update_bboxes (gs); /* update bounding boxes */
-			}
-
-			/* Stamp holes into overlaid polygons. */
-			overlays = geom_topology_poly_overlay_2D ( gs, parser );
-
-			/* Add intersection vertices at line/line intersections. */
-			detected_intersections_ll = geom_topology_intersections_2D_detect ( gs, opts, GEOM_INTERSECT_LINE_LINE,
-					&added_intersections_ll, &topo_errors_after_fusion );
+	/* process input file(s) and create output */
+	error = s2g_run_pipeline ( opts, parser, &prof, &run );
 
-			/* Add intersection vertices at line/polygon boundary intersections. */
-			detected_intersections_lp = geom_topology_intersections_2D_detect ( gs, opts, GEOM_INTERSECT_LINE_POLY,
-					&added_intersections_lp, &topo_errors_after_fusion );
-
-			/* Add intersection vertices at polygon boundary/polygon boundary intersections. */
-			detected_intersections_pp = geom_topology_intersections_2D_detect ( gs, opts, GEOM_INTERSECT_POLY_POLY,
-					&added_intersections_pp, &topo_errors_after_fusion );
-
-			/* Clean dangling line nodes. */
-			if ( opts->topo_level > OPTIONS_TOPO_LEVEL_BASIC ) {
-				/* LEVEL: FULL */
-				snapped_line_dangles += geom_topology_clean_dangles_2D ( gs, opts, &topo_errors_after_fusion,
-						&detected_intersections_ll, &added_intersections_ll );
-				geom_tools_update_bboxes (gs); /* update bounding boxes */
-			}
-		}
-		/* Unify vertex orders for polyons. */
-		if ( opts->format == PRG_OUTPUT_KML	) {
-			/* KML requires ccw vertex winding */
-			reversed_vertex_lists += geom_topology_sort_vertices ( gs, GEOM_WINDING_CCW );
-		} else {
-			/* default mode is auto-winding */
-			reversed_vertex_lists += geom_topology_sort_vertices ( gs, GEOM_WINDING_AUTO );
-		}
-		/* DEBUG */
-		/* geom_store_print ( gs, FALSE ); */
-	} else {
-		if ( strlen (error_msg) > 0 ) {
-			err_show (ERR_EXIT, _("\nUnable to create output file. Error was: '%s'."), error_msg );
-		}
-		free ( topo_errors );
-		free ( storage );
-		parser_desc_destroy (parser);
-		if ( gs != NULL ) {
-			geom_store_destroy ( gs );
-		}
-		return;
-	}
-
-	/* Reproject if required. */
-	reproj = reproj_need_reprojection ( opts );
-	if ( reproj == REPROJ_ACTION_ERROR ) {
-		/* error message already produced by reproj_need_reprojection() */
-		free ( topo_errors );
-		free ( storage );
-		parser_desc_destroy (parser);
-		geom_store_destroy ( gs );
-		return;
-	}
-	if ( reproj == REPROJ_ACTION_REPROJECT ) {
-		if ( opts->orient_mode == OPTIONS_ORIENT_MODE_LOCAL_XZ ) {
-			err_show (ERR_EXIT, _("\nCannot combine mode '%s' with reprojection. Aborting."),
-					OPTIONS_ORIENT_MODE_NAMES[opts->orient_mode]);
-			free ( topo_errors );
-			free ( storage );
-			parser_desc_destroy (parser);
-			geom_store_destroy ( gs );
-			return;
-		}
-		int reproj_status = reproj_do( opts, gs );
-		if ( reproj_status == REPROJ_STATUS_ERROR ) {
-			err_show (ERR_EXIT, _("\nFailed to reproject data. Aborting."));
-			free ( topo_errors );
-			free ( storage );
-			parser_desc_destroy (parser);
-			geom_store_destroy ( gs );
-			return;
-		}
-	}
-
-	/* remove geometry marker from label field contents, if required */
-	clean_label_atts ( opts, parser, gs );
-
-	/* create output */
-	if ( opts->format == PRG_OUTPUT_SHP	) {
-		err_show (ERR_NOTE, _("\nOutput format: %s"), PRG_OUTPUT_DESC[PRG_OUTPUT_SHP] );
-		bad_attributes = export_SHP ( gs, parser, opts );
-	} else if ( opts->format == PRG_OUTPUT_DXF	) {
-		err_show (ERR_NOTE, _("\nOutput format: %s"), PRG_OUTPUT_DESC[PRG_OUTPUT_DXF] );
-		bad_attributes = export_DXF ( gs, parser, opts );
-	} else if ( opts->format == PRG_OUTPUT_GEOJSON	) {
-		err_show (ERR_NOTE, _("\nOutput format: %s"), PRG_OUTPUT_DESC[PRG_OUTPUT_GEOJSON] );
-		/* Warn or fail if input or output SRS is not lat/lon. */
-		if ( reproj_srs_out_latlon(opts) == FALSE && reproj_srs_in_latlon(opts) == FALSE ) {
-			if ( opts->strict == TRUE ) {
-				err_show ( ERR_EXIT, "\nOutput format '%s' only available for lat/lon data in 'strict' mode. Aborting.",
-						PRG_OUTPUT_DESC[PRG_OUTPUT_GEOJSON] );
-				for ( i=0; i < opts->num_input ; i ++ ) {
-					parser_data_store_destroy ( storage[i] );
-				}
-				free ( topo_errors );
-				free ( storage );
-				parser_desc_destroy (parser);
-				geom_store_destroy ( gs );
-				return;
-			} else {
-				err_show ( ERR_WARN, "\nOutput format '%s' with data other than lat/lon is not standard-conforming.",
-						PRG_OUTPUT_DESC[PRG_OUTPUT_GEOJSON] );
-			}
-		}
-		bad_attributes = export_GeoJSON ( gs, parser, opts );
-	} else if ( opts->format == PRG_OUTPUT_KML	) {
-		err_show (ERR_NOTE, _("\nOutput format: %s"), PRG_OUTPUT_DESC[PRG_OUTPUT_KML] );
-		/* Fail if input or output SRS is not lat/lon. */
-		if ( reproj_srs_out_latlon(opts) == FALSE && reproj_srs_in_latlon(opts) == FALSE ) {
-			err_show ( ERR_EXIT, "\nOutput format '%s' only available for lat/lon data. Aborting.",
-					PRG_OUTPUT_DESC[PRG_OUTPUT_KML] );
-			for ( i=0; i < opts->num_input ; i ++ ) {
-				parser_data_store_destroy ( storage[i] );
-			}
-			free ( topo_errors );
-			free ( storage );
-			parser_desc_destroy (parser);
-			geom_store_destroy ( gs );
-			return;
-		}
-		bad_attributes = export_KML ( gs, parser, opts );
-	} else {
-		err_show ( ERR_EXIT, "\nOutput format not yet implemented. Aborting." );
-		/* release data storage */
-		for ( i=0; i < opts->num_input ; i ++ ) {
-			parser_data_store_destroy ( storage[i] );
-		}
-		free ( topo_errors );
-		free ( storage );
-		parser_desc_destroy (parser);
-		geom_store_destroy ( gs );
-		return;
-	}
-
-	/* show final statistics for each input file */
-	show_stats ( topo_errors, opts, storage );
-	free ( topo_errors );
-
-	/* selection statistics */
-	err_show (ERR_NOTE, _("\nSelected for export:"));
-	err_show (ERR_NOTE, _("\tPoints: %i."), selections_get_num_selected ( GEOM_TYPE_POINT, gs ));
-	if ( opts->dump_raw == TRUE ) {
-		err_show (ERR_NOTE, _("\tRaw points: %i."), selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ));
-	}
-	err_show (ERR_NOTE, _("\tLines: %i."), selections_get_num_selected ( GEOM_TYPE_LINE, gs ));
-	err_show (ERR_NOTE, _("\tPolygons: %i."), selections_get_num_selected ( GEOM_TYPE_POLY, gs ));
-	/* show total data extent */
-	if ( reproj == TRUE ) {
-		err_show (ERR_NOTE, _("\nTotal data extent (after reprojection):"));
-	} else {
-		err_show (ERR_NOTE, _("\nTotal data extent:"));
-	}
-	err_show (ERR_NOTE, _("\tX range: from %f to %f."), gs->min_x, gs->max_x);
-	err_show (ERR_NOTE, _("\tY range: from %f to %f."), gs->min_y, gs->max_y);
-	if ( opts->force_2d == FALSE ) {
-		err_show (ERR_NOTE, _("\tZ range: from %f to %f."), gs->min_z, gs->max_z);
-	}
-
-	/* show summmary statistics for all input files */
-	err_show (ERR_NOTE, _("\nParts added to multi-part geometries: %i"), fused_records );
-
-	if ( build_errors > 0 )
-		err_show (ERR_NOTE, _("\nGeometry build errors: %i"), build_errors );
-
-	if ( duplicate_records > 0 )
-		err_show (ERR_NOTE, _("\nInput contained duplicate attribute values that should be unique."));
-
-	if ( bad_attributes > 0 )
-		err_show (ERR_NOTE, _("\nAttribute write errors: %i"), bad_attributes );
-
-	err_show (ERR_NOTE, _("\nDetected line self-intersections: %i"), self_intersects_lines );
-
-	err_show (ERR_NOTE, _("\nDetected polygon self-intersections: %i"), self_intersects_polygons );
-
-	err_show (ERR_NOTE, _("\nDetected polygon overlays: %i"), overlays );
-
-	err_show (ERR_NOTE, _("\nRemoved polygon overlap areas: %i"), removed_overlaps );
-
-	err_show (ERR_NOTE, _("\nSnapped polygon boundary vertices: %i"), snaps_poly );
-
-	err_show (ERR_NOTE, _("\nDetected line/line intersections: %i"), detected_intersections_ll );
-
-	err_show (ERR_NOTE, _("\nAdded vertices at line/line intersections: %i"), added_intersections_ll );
-
-	err_show (ERR_NOTE, _("\nDetected line/polygon intersections: %i"), detected_intersections_lp );
-
-	err_show (ERR_NOTE, _("\nAdded vertices at line/polygon intersections: %i"), added_intersections_lp );
-
-	err_show (ERR_NOTE, _("\nDetected polygon/polygon intersections: %i"), detected_intersections_pp );
-
-	err_show (ERR_NOTE, _("\nAdded vertices at polygon/polygon intersections: %i"), added_intersections_pp );
-
-	err_show (ERR_NOTE, _("\nSnapped dangling line nodes: %i"), snapped_line_dangles );
-
-	err_show (ERR_NOTE, _("\nCorrected vertex order of polygon boundaries and holes: %i"), reversed_vertex_lists );
-
-	err_show (ERR_NOTE, _("\nAdditional topological errors in built geometries: %i"), topo_errors_after_fusion );
-
-	/* check for any output produced */
-	if ( (gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons) > 0 ) {
-		err_show (ERR_NOTE, _("\nOutput files produced:") );
-		if ( OPTIONS_GUI_MODE == TRUE ) {
-			fprintf (stderr, "<OUTPUT_FORMAT>%s</OUTPUT_FORMAT>\n", PRG_OUTPUT_DESC[opts->format]);
-		}
-		/* if ( gs->num_points > 0 ) { */
-		if ( selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ) {
-			if ( gs->path_points != NULL ) {
-				err_show (ERR_NOTE, _("\t%s"), gs->path_points);
-				if ( OPTIONS_GUI_MODE == TRUE ) {
-					fprintf (stderr, "<OUTPUT_POINTS>%s</OUTPUT_POINTS>\n", gs->path_points);
-				}
-			}
-		}
-		if ( selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ) > 0 ) {
-			/* if ( gs->num_points_raw > 0 ) { */
-			if ( gs->path_points_raw != NULL ) {
-				err_show (ERR_NOTE, _("\t%s"), gs->path_points_raw);
-				if ( OPTIONS_GUI_MODE == TRUE ) {
-					fprintf (stderr, "<OUTPUT_POINTS_RAW>%s</OUTPUT_POINTS_RAW>\n", gs->path_points_raw);
-				}
-			}
-		}
-		if ( selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ) {
-			/* if ( gs->num_lines > 0 ) { */
-			if ( gs->path_lines != NULL ) {
-				err_show (ERR_NOTE, _("\t%s"), gs->path_lines);
-				if ( OPTIONS_GUI_MODE == TRUE ) {
-					fprintf (stderr, "<OUTPUT_LINES>%s</OUTPUT_LINES>\n", gs->path_lines);
-				}
-			}
-		}
-		if ( selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0 ) {
-			/* if ( gs->num_polygons > 0 ) { */
-			if ( gs->path_polys != NULL ) {
-				err_show (ERR_NOTE, _("\t%s"), gs->path_polys);
-				if ( OPTIONS_GUI_MODE == TRUE ) {
-					fprintf (stderr, "<OUTPUT_POLYGONS>%s</OUTPUT_POLYGONS>\n", gs->path_polys);
-				}
-			}
-		}
-		if ( opts->label_field != NULL ) {
-			if ( gs->path_labels != NULL ) {
-				err_show (ERR_NOTE, _("\t%s"), gs->path_labels);
-				if ( OPTIONS_GUI_MODE == TRUE ) {
-					fprintf (stderr, "<OUTPUT_LABELS>%s</OUTPUT_LABELS>\n", gs->path_labels);
-				}
-			}
-		}
-		if ( gs->path_all != NULL ) {
-			err_show (ERR_NOTE, _("\t%s"), gs->path_all);
-			if ( OPTIONS_GUI_MODE == TRUE ) {
-				fprintf (stderr, "<OUTPUT_ALL>%s</OUTPUT_ALL>\n", gs->path_all);
-			}
-		}
-		if ( gs->path_all_atts != NULL ) {
-			err_show (ERR_NOTE, _("\t%s"), gs->path_all_atts);
-			if ( OPTIONS_GUI_MODE == TRUE ) {
-				fprintf (stderr, "<OUTPUT_ALL_ATTS>%s</OUTPUT_ALL_ATTS>\n", gs->path_all_atts);
-			}
-		}
-	} else {
-		err_show (ERR_NOTE, _("\nNo output files produced.") );
-	}
-
-	/* release data storage */
-	for ( i=0; i < opts->num_input ; i ++ ) {
-		parser_data_store_destroy ( storage[i] );
-	}
-	free ( storage );
+	/* release data storage and geometry store */
+	s2g_run_free ( &run );
 
 	/* release parser object */
 	parser_desc_destroy (parser);
 
-	/* release geometry store */
-	geom_store_destroy ( gs );
-
 	/* SUCCESS */
-	err_close ();
+	if ( error == S2G_OK ) {
+		err_close ();
+	}
 }
 
 
@@ -1478,6 +735,8 @@ int process_gui_options ( options *opts )
 			if (!strcmp(gtk_combo_box_get_active_text(GTK_COMBO_BOX(
 					f_format->combo_box)), PRG_OUTPUT_DESC[i])) {
 				opts->format = i;
+				opts->formats[0] = i;
+				opts->num_formats = 1;
 				break;
 			}
 			i++;
@@ -2111,6 +1370,36 @@ int main(int argc, char *argv[])
 		exit (PRG_EXIT_OK);
 	}
 
+	/* batch mode: run all jobs from the job list, then exit */
+	if ( opts->batch != NULL ) {
+		OPTIONS_GUI_MODE = FALSE;
+		i = batch_run ( opts );
+		options_destroy (opts);
+		reproj_free_cache ();
+		i18n_free ();
+		return ( i > 0 ? PRG_EXIT_ERR : PRG_EXIT_OK );
+	}
+
+	/* server mode: serve job requests until terminated */
+	if ( opts->serve != NULL ) {
+		OPTIONS_GUI_MODE = FALSE;
+		i = serve_run ( opts );
+		options_destroy (opts);
+		reproj_free_cache ();
+		i18n_free ();
+		return ( i > 0 ? PRG_EXIT_ERR : PRG_EXIT_OK );
+	}
+
+	/* watch mode: convert again after each change, until terminated */
+	if ( opts->watch == TRUE ) {
+		OPTIONS_GUI_MODE = FALSE;
+		i = watch_run ( opts );
+		options_destroy (opts);
+		reproj_free_cache ();
+		i18n_free ();
+		return ( i > 0 ? PRG_EXIT_ERR : PRG_EXIT_OK );
+	}
+
 #ifdef GUI
 	/*
 	 * If we have GUI support, then we must now decide
@@ -2146,6 +1435,9 @@ int main(int argc, char *argv[])
 	/* release memory for prg options */
 	options_destroy (opts);
 
+	/* release cached EPSG definitions and SRS objects */
+	reproj_free_cache ();
+
 	/* release mem for i18n */
 	i18n_free ();
 
@@ -42,6 +42,22 @@
 #define ARG_ID_WGS84_TRANS_RZ	2007
 #define ARG_ID_WGS84_TRANS_DS	2008
 #define ARG_ID_WGS84_TRANS_GRID	2009
+#define ARG_ID_PROJ_APPROX		2010
+#define ARG_ID_THREADS			3000
+#define ARG_ID_SPATIAL_INDEX	3001
+#define ARG_ID_RECORD_SEPARATOR	3002
+#define ARG_ID_HILBERT_ORDER	3003
+#define ARG_ID_MIN_ZOOM		3004
+#define ARG_ID_MAX_ZOOM		3005
+#define ARG_ID_SIMPLIFY_LINES	3006
+#define ARG_ID_SIMPLIFY_POLYS	3007
+#define ARG_ID_SIMPLIFY_MODE	3008
+#define ARG_ID_PROFILE			3009
+#define ARG_ID_BATCH			3010
+#define ARG_ID_SERVE			3011
+#define ARG_ID_INCREMENTAL		3012
+#define ARG_ID_WATCH			3013
+#define ARG_ID_SNAPSHOT			3014
 
 /*
  * Print usage instructions, then exit.
@@ -62,7 +78,7 @@ in ASCII format and convert them to common GIS and CAD output formats.\n"));
 	fprintf (stdout, _("  -p, --parser=\t\tname of file with parsing schema (required)\n"));
 	fprintf (stdout, _("  -o, --output=\t\tdirectory name for output file(s) (required)\n"));
 	fprintf (stdout, _("  -n, --name=\t\tbase name for output file(s) (required)\n"));
-	fprintf (stdout, _("  -f, --format=\t\toutput format (see list below; default: \"%s\")\n"),
+	fprintf (stdout, _("  -f, --format=\t\toutput format(s) (see list below; default: \"%s\")\n"),
 			PRG_OUTPUT_EXT[PRG_OUTPUT_DEFAULT]);
 	i = 0;
 	while ( strcmp ( PRG_OUTPUT_EXT[i],"" ) != 0 ) {
@@ -98,6 +114,16 @@ in ASCII format and convert them to common GIS and CAD output formats.\n"));
 	fprintf (stdout, _("  -t, --tolerance=\tdistance threshold for coordinates (default: %.1f)\n"), OPTIONS_DEFAULT_TOLERANCE);
 	fprintf (stdout, _("  -s, --snapping=\tsnapping dist. for boundary nodes (default: %.1f = off)\n"), OPTIONS_DEFAULT_SNAPPING);
 	fprintf (stdout, _("  -D, --dangling=\tsnapping dist. for line dangles (default: %.1f = off)\n"), OPTIONS_DEFAULT_DANGLING);
+	fprintf (stdout, _("      --simplify-lines=\tsimplification tolerance for lines (default: %.1f = off)\n"), OPTIONS_DEFAULT_SIMPLIFY_LINES);
+	fprintf (stdout, _("      --simplify-polys=\tsimplification tolerance for polygons (default: %.1f = off)\n"), OPTIONS_DEFAULT_SIMPLIFY_POLYS);
+	fprintf (stdout, _("      --simplify-mode=\tsimplification algorithm (default: \"%s\")\n"), OPTIONS_SIMPLIFY_MODE_NAMES[OPTIONS_DEFAULT_SIMPLIFY_MODE]);
+	i = 0;
+	while ( strcmp ( OPTIONS_SIMPLIFY_MODE_NAMES[i],"" ) != 0 ) {
+		fprintf (stdout, _("  \t\t\t\"%s\" (%s)\n"), OPTIONS_SIMPLIFY_MODE_NAMES[i], gettext(OPTIONS_SIMPLIFY_MODE_DESC[i]) );
+		i ++;
+	}
+	fprintf (stdout, _("  \t\t\t(only shared boundaries and line nodes are preserved;\n"));
+	fprintf (stdout, _("  \t\t\tnew crossings between simplified sections are possible)\n"));
 	fprintf (stdout, _("  -x, --x-offset=\tconstant offset to add to x coordinates (default: %.1f)\n"), OPTIONS_DEFAULT_OFFSET_X);
 	fprintf (stdout, _("  -y, --y-offset=\tconstant offset to add to y coordinates (default: %.1f)\n"), OPTIONS_DEFAULT_OFFSET_Y);
 	fprintf (stdout, _("  -z, --z-offset=\tconstant offset to add to z coordinates (default: %.1f)\n"), OPTIONS_DEFAULT_OFFSET_Z);
@@ -109,6 +135,20 @@ in ASCII format and convert them to common GIS and CAD output formats.\n"));
 	fprintf (stdout, _("  -c, --strict\t\tuse stricter input validation\n"));
 	fprintf (stdout, _("  -v, --validate-parser\tvalidate parser schema and exit\n"));
 	fprintf (stdout, "  -e, --english\t\tforce English messages and numeric notation\n");
+	fprintf (stdout, _("      --threads=\tmax. number of parallel threads (default: %i = one per CPU)\n"), OPTIONS_DEFAULT_THREADS);
+	fprintf (stdout, _("      --spatial-index\twrite spatial index (.qix) for Shapefile output\n"));
+	fprintf (stdout, _("      --record-separator\tstart each GeoJSONL feature with a record separator (RFC 8142)\n"));
+	fprintf (stdout, _("      --hilbert-order\twrite features in spatial (Hilbert curve) order\n"));
+	fprintf (stdout, _("      --min-zoom=\tlowest zoom level for vector tiles (default: %i)\n"), OPTIONS_DEFAULT_MIN_ZOOM);
+	fprintf (stdout, _("      --max-zoom=\thighest zoom level for vector tiles (default: %i)\n"), OPTIONS_DEFAULT_MAX_ZOOM);
+	fprintf (stdout, _("      --profile		report time and memory used by each processing stage\n"));
+	fprintf (stdout, _("      --batch=\t\trun all jobs listed in this file (see below)\n"));
+#ifndef MINGW
+	fprintf (stdout, _("      --serve=\t\tserve job requests on this Unix domain socket (see below)\n"));
+#endif
+	fprintf (stdout, _("      --incremental\tonly process data appended to the input file since the last run\n"));
+	fprintf (stdout, _("      --watch\t\tconvert again whenever input or parser schema files change\n"));
+	fprintf (stdout, _("      --snapshot=\tkeep parsed input data in this file for later runs (see below)\n"));
 #ifdef GUI
 	fprintf (stdout, _("  -u, --show-gui\talways show GUI form\n"));
 #endif
@@ -124,6 +164,7 @@ in ASCII format and convert them to common GIS and CAD output formats.\n"));
 	fprintf (stdout, _("  --proj-rz=\t\tdatum transform to WGS 84 (Z rotation; default: %.1f)\n"), OPTIONS_DEFAULT_WGS84_TRANS_RZ);
 	fprintf (stdout, _("  --proj-ds=\t\tdatum transform to WGS 84 (scaling; default: %.1f)\n"), OPTIONS_DEFAULT_WGS84_TRANS_DS);
 	fprintf (stdout, _("  --proj-grid=\t\tlocal datum transformation grid (file name)\n"));
+	fprintf (stdout, _("  --proj-approx=\tmax. error for approximate reprojection, in metres (default: %.1f = exact)\n"), OPTIONS_DEFAULT_PROJ_APPROX);
 	fprintf (stdout, _("\nGeometries and attributes will be read from one or more input files.\n"));
 	fprintf (stdout, _("\nWith no input file(s), data will be read from the \"stdin\" stream.\n"));
 	fprintf (stdout, _("The combined output will be written into at least one output file.\n"));
@@ -132,6 +173,40 @@ more than one output file with a common base name may be produced.\n"));
 	fprintf (stdout, _("Duplicate measurements will not be stored in the output file(s).\n"));
 	fprintf (stdout, _("The \"--tolerance=\" setting determines the threshold of distance above\n\
 which two coordinates are considered to be distinct.\n"));
+	fprintf (stdout, _("\nSeveral output formats can be given, separated by commas (e.g. \"-f shp,kml\").\n\
+The input is then processed only once, and all formats are written at the same\n\
+time. Reprojection settings apply to all of them.\n"));
+	fprintf (stdout, _("\nWith \"--batch=\", all jobs listed in the given file will be run, using\n\
+the same options, parser schema and reprojection settings. Each line of the\n\
+job list has the form:\n\
+  <output folder> <base name> <input file> [<input file> ...] [-- <option> ...]\n\
+Options after \"--\" override those of the command line for that job only.\n\
+Quote names that contain spaces (\"...\"). Lines starting with \"#\" are ignored.\n\
+Messages of each job will be written to \"<output folder>/<base name>.log\".\n\
+\"--threads=\" sets the max. number of jobs that run at the same time.\n"));
+#ifndef MINGW
+	fprintf (stdout, _("\nWith \"--serve=\", the program keeps running and accepts job requests on\n\
+the given socket: one JSON object per connection, on one line, e.g.:\n\
+  {\"id\": \"1\", \"schema\": \"desc.txt\", \"output\": \"out\", \"base\": \"site\",\n\
+   \"input\": [\"data.dat\"], \"options\": [\"-f\", \"geojson\"]}\n\
+All messages and the final result are sent back as JSON objects (one per line).\n\
+Parser schemas and reprojection settings are kept ready for later requests.\n"));
+#endif
+	fprintf (stdout, _("\nWith \"--incremental\", a checkpoint file \"<output>/<base>.checkpoint\" records\n\
+how much of the input file has been processed. The next run with the same options\n\
+reads only the lines appended since then and adds the new features to the existing\n\
+output (Shapefile or GeoJSONL). A geometry that may still continue is rewritten on\n\
+the next run. Features already written are not re-checked against new ones.\n\
+If the input file has been changed otherwise, all data is processed again.\n"));
+	fprintf (stdout, _("\nWith \"--watch\", the program keeps running and converts the input again\n\
+after the input files or the parser schema have changed (stop with Ctrl+C).\n\
+Output is first written to the folder \"<output>/<base>.watch\", then each file\n\
+replaces the one in the output folder at once. Together with \"--incremental\",\n\
+only appended data is processed.\n"));
+	fprintf (stdout, _("\nWith \"--snapshot=\", the parsed and cleaned input data is saved to the given\n\
+file. Later runs with the same input files, parser schema and parsing options\n\
+(e.g. to write another output format) load it from there instead of parsing the\n\
+input again. Messages about invalid input records are only shown when parsing.\n"));
 	fprintf (stdout, _("\nThis program is free software under the GNU General Public License (>=v2).\n\
 Read http://www.gnu.org/licenses/gpl.html for details."));
 	fprintf (stdout, _("\nVersion %s\n"), t_get_prg_version());
@@ -152,8 +227,12 @@ options *options_create (int argc, char *argv[])
 	newOpts->cmd_name = NULL;
 	newOpts->schema_file = NULL;
 	newOpts->input = NULL;
+	newOpts->input_streams = NULL;
+	newOpts->append_ids = 0;
 	newOpts->num_input = 0;
 	newOpts->format = 0;
+	newOpts->formats[0] = 0;
+	newOpts->num_formats = 1;
 	for ( i=0; i < PRG_MAX_SELECTIONS; i ++ ) {
 		newOpts->selection[i] = NULL;
 	}
@@ -218,6 +297,28 @@ options *options_create (int argc, char *argv[])
 	newOpts->wgs84_trans_ds_str = malloc (len );
 	t_dbl_to_str (newOpts->wgs84_trans_ds, newOpts->wgs84_trans_ds_str);
 	newOpts->wgs84_trans_grid = NULL;
+	newOpts->proj_approx = OPTIONS_DEFAULT_PROJ_APPROX;
+	newOpts->proj_approx_str = malloc (len );
+	t_dbl_to_str (newOpts->proj_approx, newOpts->proj_approx_str);
+	newOpts->threads = OPTIONS_DEFAULT_THREADS;
+	newOpts->spatial_index = FALSE;
+	newOpts->record_separator = FALSE;
+	newOpts->hilbert_order = FALSE;
+	newOpts->profile = FALSE;
+	newOpts->batch = NULL;
+	newOpts->serve = NULL;
+	newOpts->incremental = FALSE;
+	newOpts->watch = FALSE;
+	newOpts->snapshot = NULL;
+	newOpts->min_zoom = OPTIONS_DEFAULT_MIN_ZOOM;
+	newOpts->max_zoom = OPTIONS_DEFAULT_MAX_ZOOM;
+	newOpts->simplify_lines = OPTIONS_DEFAULT_SIMPLIFY_LINES;
+	newOpts->simplify_lines_str = malloc (len );
+	t_dbl_to_str (newOpts->simplify_lines, newOpts->simplify_lines_str);
+	newOpts->simplify_polys = OPTIONS_DEFAULT_SIMPLIFY_POLYS;
+	newOpts->simplify_polys_str = malloc (len );
+	t_dbl_to_str (newOpts->simplify_polys, newOpts->simplify_polys_str);
+	newOpts->simplify_mode = OPTIONS_DEFAULT_SIMPLIFY_MODE;
 	newOpts->force_2d = FALSE;
 	newOpts->strict = FALSE;
 	newOpts->force_english = FALSE;
@@ -260,6 +361,12 @@ void options_destroy ( options *opts )
 		}
 		if ( opts->log != NULL )
 			free ( opts->log );
+		if ( opts->batch != NULL )
+			free ( opts->batch );
+		if ( opts->serve != NULL )
+			free ( opts->serve );
+		if ( opts->snapshot != NULL )
+			free ( opts->snapshot );
 		if ( opts->input != NULL ) {
 			int i = 0;
 			while ( opts->input[i] != NULL ) {
@@ -284,12 +391,9 @@ void options_destroy ( options *opts )
 		if ( opts->proj4_data_dir != NULL ) {
 			free (opts->proj4_data_dir);
 		}
-		if ( opts->proj4_in != NULL ) {
-			pj_free (opts->proj4_in);
-		}
-		if ( opts->proj4_out != NULL ) {
-			pj_free (opts->proj4_out);
-		}
+		/* proj4_in and proj4_out are owned by the SRS cache (see reproj_free_cache()) */
+		opts->proj4_in = NULL;
+		opts->proj4_out = NULL;
 		if ( opts->wgs84_trans_grid != NULL ) {
 			free (opts->wgs84_trans_grid);
 		}
@@ -307,6 +411,12 @@ void options_destroy ( options *opts )
 		opts->wgs84_trans_rz_str = NULL;
 		free ( opts->wgs84_trans_ds_str );
 		opts->wgs84_trans_ds_str = NULL;
+		free ( opts->proj_approx_str );
+		opts->proj_approx_str = NULL;
+		free ( opts->simplify_lines_str );
+		opts->simplify_lines_str = NULL;
+		free ( opts->simplify_polys_str );
+		opts->simplify_polys_str = NULL;
 		/* remove references to CLI options */
 		opts->argc = 0;
 		opts->argv = NULL;
@@ -318,6 +428,24 @@ void options_destroy ( options *opts )
 }
 
 
+/*
+ * Returns TRUE if "format" (PRG_OUTPUT_*) is one of the output
+ * formats to write, FALSE otherwise.
+ */
+BOOLEAN options_has_format ( options *opts, int format )
+{
+	int i;
+
+	for ( i = 0; i < opts->num_formats; i ++ ) {
+		if ( opts->formats[i] == format ) {
+			return ( TRUE );
+		}
+	}
+
+	return ( FALSE );
+}
+
+
 /*
  * Cross-plattform option parsing helper function:
  * 
@@ -414,6 +542,22 @@ int options_parse ( options *opts )
 			{ "proj-rz", required_argument, NULL, ARG_ID_WGS84_TRANS_RZ },
 			{ "proj-ds", required_argument, NULL, ARG_ID_WGS84_TRANS_DS },
 			{ "proj-grid", required_argument, NULL, ARG_ID_WGS84_TRANS_GRID },
+			{ "proj-approx", required_argument, NULL, ARG_ID_PROJ_APPROX },
+			{ "threads", required_argument, NULL, ARG_ID_THREADS },
+			{ "spatial-index", no_argument, NULL, ARG_ID_SPATIAL_INDEX },
+			{ "record-separator", no_argument, NULL, ARG_ID_RECORD_SEPARATOR },
+			{ "hilbert-order", no_argument, NULL, ARG_ID_HILBERT_ORDER },
+			{ "profile", no_argument, NULL, ARG_ID_PROFILE },
+			{ "batch", required_argument, NULL, ARG_ID_BATCH },
+			{ "serve", required_argument, NULL, ARG_ID_SERVE },
+			{ "incremental", no_argument, NULL, ARG_ID_INCREMENTAL },
+			{ "watch", no_argument, NULL, ARG_ID_WATCH },
+			{ "snapshot", required_argument, NULL, ARG_ID_SNAPSHOT },
+			{ "min-zoom", required_argument, NULL, ARG_ID_MIN_ZOOM },
+			{ "max-zoom", required_argument, NULL, ARG_ID_MAX_ZOOM },
+			{ "simplify-lines", required_argument, NULL, ARG_ID_SIMPLIFY_LINES },
+			{ "simplify-polys", required_argument, NULL, ARG_ID_SIMPLIFY_POLYS },
+			{ "simplify-mode", required_argument, NULL, ARG_ID_SIMPLIFY_MODE },
 #ifdef GUI
 			{ "show-gui", 0, NULL, 'u' },
 #endif
@@ -454,6 +598,13 @@ int options_parse ( options *opts )
 	char *v_proj_rz=NULL;
 	char *v_proj_ds=NULL;
 	char *v_proj_grid=NULL;
+	char *v_proj_approx=NULL;
+	char *v_threads=NULL;
+	char *v_min_zoom=NULL;
+	char *v_max_zoom=NULL;
+	char *v_simplify_lines=NULL;
+	char *v_simplify_polys=NULL;
+	char *v_simplify_mode=NULL;
 	char *p;
 
 
@@ -494,7 +645,14 @@ int options_parse ( options *opts )
 	if ( opts->just_dump_help == FALSE ) {
 
 		static const char *optString = "p:o:n:f:L:O:T:S:l:t:s:D:y:z:d:i:g:2rcvehu";
-		int option = getopt_long ( opts->argc, opts->argv, optString, long_options, &option_index );
+		int option;
+
+		/* restart the scan (options may be parsed more than once per process) */
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+		optreset = 1;
+#endif
+		optind = 1;
+		option = getopt_long ( opts->argc, opts->argv, optString, long_options, &option_index );
 
 		while ( option  != -1 ) {
 
@@ -634,6 +792,34 @@ int options_parse ( options *opts )
 					v_proj_grid = NULL;
 					err_show ( ERR_EXIT, _("No datum grid file given (option '--proj-grid')."));
 				}
+				if (optopt == ARG_ID_PROJ_APPROX) {
+					v_proj_approx = NULL;
+					err_show ( ERR_EXIT, _("No max. reprojection error given (option '--proj-approx')."));
+				}
+				if (optopt == ARG_ID_THREADS) {
+					v_threads = NULL;
+					err_show ( ERR_EXIT, _("Number of threads not given (option '--threads')."));
+				}
+				if (optopt == ARG_ID_MIN_ZOOM) {
+					v_min_zoom = NULL;
+					err_show ( ERR_EXIT, _("Lowest zoom level not given (option '--min-zoom')."));
+				}
+				if (optopt == ARG_ID_MAX_ZOOM) {
+					v_max_zoom = NULL;
+					err_show ( ERR_EXIT, _("Highest zoom level not given (option '--max-zoom')."));
+				}
+				if (optopt == ARG_ID_SIMPLIFY_LINES) {
+					v_simplify_lines = NULL;
+					err_show ( ERR_EXIT, _("No simplification tolerance for lines given (option '--simplify-lines')."));
+				}
+				if (optopt == ARG_ID_SIMPLIFY_POLYS) {
+					v_simplify_polys = NULL;
+					err_show ( ERR_EXIT, _("No simplification tolerance for polygons given (option '--simplify-polys')."));
+				}
+				if (optopt == ARG_ID_SIMPLIFY_MODE) {
+					v_simplify_mode = NULL;
+					err_show ( ERR_EXIT, _("No simplification mode given (option '--simplify-mode')."));
+				}
 				num_errors ++;
 			}
 
@@ -1000,6 +1186,154 @@ int options_parse ( options *opts )
 				}
 			}
 
+			/* max. error for approximate reprojection */
+			if ( option == ARG_ID_PROJ_APPROX ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					v_proj_approx = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--proj-approx=");
+					num_errors ++;
+				}
+			}
+
+			/* number of parallel threads */
+			if ( option == ARG_ID_THREADS ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					if ( v_threads != NULL )
+						free ( v_threads );
+					v_threads = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--threads=");
+					num_errors ++;
+				}
+			}
+
+			/* spatial index for Shapefile output */
+			if ( option == ARG_ID_SPATIAL_INDEX ) {
+				opts->spatial_index = TRUE;
+				num_valid_opts ++;
+			}
+
+			/* record separators for GeoJSONL output */
+			if ( option == ARG_ID_RECORD_SEPARATOR ) {
+				opts->record_separator = TRUE;
+				num_valid_opts ++;
+			}
+
+			/* spatial order of output features */
+			if ( option == ARG_ID_HILBERT_ORDER ) {
+				opts->hilbert_order = TRUE;
+				num_valid_opts ++;
+			}
+
+			/* run-time profile */
+			if ( option == ARG_ID_PROFILE ) {
+				opts->profile = TRUE;
+				num_valid_opts ++;
+			}
+
+			/* batch job list */
+			if ( option == ARG_ID_BATCH ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					if ( opts->batch != NULL )
+						free ( opts->batch );
+					opts->batch = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--batch=");
+					num_errors ++;
+				}
+			}
+
+			/* job server socket */
+			if ( option == ARG_ID_SERVE ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					if ( opts->serve != NULL )
+						free ( opts->serve );
+					opts->serve = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--serve=");
+					num_errors ++;
+				}
+			}
+
+			/* process only new input data */
+			if ( option == ARG_ID_INCREMENTAL ) {
+				opts->incremental = TRUE;
+				num_valid_opts ++;
+			}
+
+			/* convert again after changes */
+			if ( option == ARG_ID_WATCH ) {
+				opts->watch = TRUE;
+				num_valid_opts ++;
+			}
+
+			/* snapshot of parsed input data */
+			if ( option == ARG_ID_SNAPSHOT ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					if ( opts->snapshot != NULL )
+						free ( opts->snapshot );
+					opts->snapshot = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--snapshot=");
+					num_errors ++;
+				}
+			}
+
+			/* zoom levels for vector tiles */
+			if ( option == ARG_ID_MIN_ZOOM ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					v_min_zoom = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--min-zoom=");
+					num_errors ++;
+				}
+			}
+			if ( option == ARG_ID_MAX_ZOOM ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					v_max_zoom = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--max-zoom=");
+					num_errors ++;
+				}
+			}
+
+			/* simplification tolerances and mode */
+			if ( option == ARG_ID_SIMPLIFY_LINES ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					v_simplify_lines = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--simplify-lines=");
+					num_errors ++;
+				}
+			}
+			if ( option == ARG_ID_SIMPLIFY_POLYS ) {
+				if ( optarg != NULL && strlen (optarg) > 0 ) {
+					v_simplify_polys = options_get_optarg (optarg);
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--simplify-polys=");
+					num_errors ++;
+				}
+			}
+			if ( option == ARG_ID_SIMPLIFY_MODE ) {
+				if ( optarg != NULL && strlen ( optarg ) > 0 ) {
+					v_simplify_mode = t_str_pack (t_str_to_lower(options_get_optarg (optarg)));
+					num_valid_opts ++;
+				} else {
+					err_show ( ERR_EXIT, _("Missing option value (option '%s')."), "--simplify-mode=");
+					num_errors ++;
+				}
+			}
+
 			option = getopt_long ( opts->argc, opts->argv, optString, long_options, &option_index );
 
 		}
@@ -1044,6 +1378,12 @@ int options_parse ( options *opts )
 #endif
 	}
 
+	/* in batch and server mode, output folder and base name are given per job */
+	if ( opts->batch != NULL || opts->serve != NULL ) {
+		o_given = TRUE;
+		n_given = TRUE;
+	}
+
 #ifndef GUI
 	if ( o_given == FALSE ) {
 		err_show ( ERR_EXIT, _("Incomplete command line: option \"-o\" must be specified.") );
@@ -1094,6 +1434,32 @@ int options_parse ( options *opts )
 		opts->base = NULL;
 	}
 
+	if ( opts->batch != NULL && t_is_legal_path (opts->batch) == FALSE ) {
+		err_show ( ERR_EXIT, _("\"%s\" is not a valid job list file name."), opts->batch);
+		num_errors ++;
+		free ( opts->batch );
+		opts->batch = NULL;
+	}
+
+	if ( opts->serve != NULL && t_is_legal_path (opts->serve) == FALSE ) {
+		err_show ( ERR_EXIT, _("\"%s\" is not a valid socket file name."), opts->serve);
+		num_errors ++;
+		free ( opts->serve );
+		opts->serve = NULL;
+	}
+
+	if ( opts->batch != NULL && opts->serve != NULL ) {
+		err_show ( ERR_EXIT, _("Options '%s' and '%s' cannot be used together."), "--batch=", "--serve=");
+		num_errors ++;
+	}
+
+	if ( opts->snapshot != NULL && t_is_legal_path (opts->snapshot) == FALSE ) {
+		err_show ( ERR_EXIT, _("\"%s\" is not a valid snapshot file name."), opts->snapshot);
+		num_errors ++;
+		free ( opts->snapshot );
+		opts->snapshot = NULL;
+	}
+
 	if ( opts->log != NULL && t_is_legal_path (opts->log) == FALSE ) {
 		err_show ( ERR_EXIT, _("\"%s\" is not a valid log file name."), opts->log);
 		num_errors ++;
@@ -1207,21 +1573,43 @@ int options_parse ( options *opts )
 	}
 
 	if ( v_format != NULL ) {
-		BOOLEAN found = FALSE;
-		int i = 0;
-		while ( strcmp ( PRG_OUTPUT_EXT[i],"" ) != 0 ) {
-			if ( !strcasecmp ( PRG_OUTPUT_EXT[i], v_format ) ) {
-				opts->format = i;
-				found = TRUE;
-				free (v_format);
-				break;
+		/* one format or a comma-separated list of formats */
+		char *name = v_format;
+		char *next;
+		opts->num_formats = 0;
+		while ( name != NULL ) {
+			BOOLEAN found = FALSE;
+			int i = 0;
+			next = strchr ( name, ',' );
+			if ( next != NULL ) {
+				*next = '\0';
+				next ++;
 			}
-			i ++;
+			while ( strcmp ( PRG_OUTPUT_EXT[i],"" ) != 0 ) {
+				if ( !strcasecmp ( PRG_OUTPUT_EXT[i], name ) ) {
+					found = TRUE;
+					break;
+				}
+				i ++;
+			}
+			if ( found == FALSE ) {
+				err_show ( ERR_EXIT, _("The specified output format \"%s\" is unknown."), name);
+				num_errors ++;
+			} else if ( options_has_format ( opts, i ) == TRUE ) {
+				err_show ( ERR_EXIT, _("Output format \"%s\" given more than once."), name);
+				num_errors ++;
+			} else {
+				opts->formats[opts->num_formats] = i;
+				opts->num_formats ++;
+			}
+			name = next;
 		}
-		if ( found == FALSE ) {
-			err_show ( ERR_EXIT, _("The specified output format \"%s\" is unknown."), v_format);
-			num_errors ++;
+		if ( opts->num_formats < 1 ) {
+			opts->formats[0] = opts->format;
+			opts->num_formats = 1;
 		}
+		opts->format = opts->formats[0];
+		free (v_format);
 	}
 
 	if ( v_tolerance != NULL ) {
@@ -1544,6 +1932,132 @@ int options_parse ( options *opts )
 		}
 	}
 
+	if ( v_proj_approx != NULL ) {
+		opts->proj_approx = t_str_to_dbl (v_proj_approx, 0, 0, &error, NULL );
+		snprintf ( opts->proj_approx_str, PRG_MAX_STR_LEN, "%s", v_proj_approx );
+		free ( v_proj_approx );
+		if ( error == TRUE ) {
+			err_show ( ERR_EXIT, _("The specified max. reprojection error is not a valid number."));
+			num_errors ++;
+			opts->proj_approx = OPTIONS_DEFAULT_PROJ_APPROX;
+			t_dbl_to_str (opts->proj_approx, opts->proj_approx_str);
+		}
+	}
+	if ( opts->proj_approx < 0.0 ) {
+		err_show ( ERR_EXIT, _("Max. reprojection error must be 0 or a positive number."));
+		num_errors ++;
+		opts->proj_approx = OPTIONS_DEFAULT_PROJ_APPROX;
+		t_dbl_to_str (opts->proj_approx, opts->proj_approx_str);
+	}
+
+	if ( v_threads != NULL ) {
+		opts->threads = t_str_to_int (v_threads, &error, NULL );
+		free ( v_threads );
+		if ( error == TRUE ) {
+			err_show ( ERR_EXIT, _("Specified number of threads is not a valid number."));
+			num_errors ++;
+			opts->threads = OPTIONS_DEFAULT_THREADS;
+		}
+	}
+
+	if ( opts->threads < 0 ) {
+		err_show ( ERR_EXIT, _("Number of threads must be 0 or a positive number."));
+		num_errors ++;
+		opts->threads = OPTIONS_DEFAULT_THREADS;
+	}
+
+	if ( v_min_zoom != NULL ) {
+		opts->min_zoom = t_str_to_int (v_min_zoom, &error, NULL );
+		free ( v_min_zoom );
+		if ( error == TRUE ) {
+			err_show ( ERR_EXIT, _("Specified lowest zoom level is not a valid number."));
+			num_errors ++;
+			opts->min_zoom = OPTIONS_DEFAULT_MIN_ZOOM;
+		}
+	}
+	if ( v_max_zoom != NULL ) {
+		opts->max_zoom = t_str_to_int (v_max_zoom, &error, NULL );
+		free ( v_max_zoom );
+		if ( error == TRUE ) {
+			err_show ( ERR_EXIT, _("Specified highest zoom level is not a valid number."));
+			num_errors ++;
+			opts->max_zoom = OPTIONS_DEFAULT_MAX_ZOOM;
+		}
+	}
+	if ( opts->min_zoom < 0 || opts->min_zoom > OPTIONS_MAX_ZOOM ||
+			opts->max_zoom < 0 || opts->max_zoom > OPTIONS_MAX_ZOOM ) {
+		err_show ( ERR_EXIT, _("Zoom levels must be in range 0 to %i."), OPTIONS_MAX_ZOOM);
+		num_errors ++;
+		opts->min_zoom = OPTIONS_DEFAULT_MIN_ZOOM;
+		opts->max_zoom = OPTIONS_DEFAULT_MAX_ZOOM;
+	}
+	if ( opts->min_zoom > opts->max_zoom ) {
+		err_show ( ERR_EXIT, _("Lowest zoom level must not be higher than highest zoom level."));
+		num_errors ++;
+		opts->min_zoom = OPTIONS_DEFAULT_MIN_ZOOM;
+		opts->max_zoom = OPTIONS_DEFAULT_MAX_ZOOM;
+	}
+
+	if ( v_simplify_lines != NULL ) {
+		opts->simplify_lines = t_str_to_dbl (v_simplify_lines, 0, 0, &error, NULL );
+		snprintf ( opts->simplify_lines_str, PRG_MAX_STR_LEN, "%s", v_simplify_lines );
+		free ( v_simplify_lines );
+		if ( error == TRUE ) {
+			err_show ( ERR_EXIT, _("The specified simplification tolerance for lines is not a valid number."));
+			num_errors ++;
+			opts->simplify_lines = OPTIONS_DEFAULT_SIMPLIFY_LINES;
+			t_dbl_to_str (opts->simplify_lines, opts->simplify_lines_str);
+		}
+	}
+	if ( opts->simplify_lines < 0.0 ) {
+		err_show ( ERR_EXIT, _("Simplification tolerance for lines must be 0 or a positive number."));
+		num_errors ++;
+		opts->simplify_lines = OPTIONS_DEFAULT_SIMPLIFY_LINES;
+		t_dbl_to_str (opts->simplify_lines, opts->simplify_lines_str);
+	}
+
+	if ( v_simplify_polys != NULL ) {
+		opts->simplify_polys = t_str_to_dbl (v_simplify_polys, 0, 0, &error, NULL );
+		snprintf ( opts->simplify_polys_str, PRG_MAX_STR_LEN, "%s", v_simplify_polys );
+		free ( v_simplify_polys );
+		if ( error == TRUE ) {
+			err_show ( ERR_EXIT, _("The specified simplification tolerance for polygons is not a valid number."));
+			num_errors ++;
+			opts->simplify_polys = OPTIONS_DEFAULT_SIMPLIFY_POLYS;
+			t_dbl_to_str (opts->simplify_polys, opts->simplify_polys_str);
+		}
+	}
+	if ( opts->simplify_polys < 0.0 ) {
+		err_show ( ERR_EXIT, _("Simplification tolerance for polygons must be 0 or a positive number."));
+		num_errors ++;
+		opts->simplify_polys = OPTIONS_DEFAULT_SIMPLIFY_POLYS;
+		t_dbl_to_str (opts->simplify_polys, opts->simplify_polys_str);
+	}
+
+	if ( v_simplify_mode != NULL ) {
+		BOOLEAN valid = FALSE;
+		int i = 0;
+		while ( strlen (OPTIONS_SIMPLIFY_MODE_NAMES[i]) > 0 ) {
+			if ( !strcasecmp ( OPTIONS_SIMPLIFY_MODE_NAMES[i], v_simplify_mode ) ) {
+				opts->simplify_mode = i;
+				valid = TRUE;
+				break;
+			}
+			i ++;
+		}
+		if ( valid == FALSE ) {
+			err_show ( ERR_EXIT, _("Invalid simplification mode ('%s')."), v_simplify_mode );
+			num_errors ++;
+		}
+		free ( v_simplify_mode );
+		v_simplify_mode = NULL;
+	}
+
+	/* "0" means: use one thread per CPU */
+	if ( opts->threads == 0 ) {
+		opts->threads = t_get_num_cpus ();
+	}
+
 	/* All other tokens are input files and need to be added
 	 * to the input files list.
 	 */
@@ -1571,6 +2085,72 @@ int options_parse ( options *opts )
 		opts->input[j] = NULL;
 	}
 
+	if ( opts->batch != NULL && opts->num_input > 0 ) {
+		err_show ( ERR_EXIT, _("Input files must be given in the job list (option '%s')."), "--batch=");
+		num_errors ++;
+	}
+
+	if ( opts->serve != NULL && opts->num_input > 0 ) {
+		err_show ( ERR_EXIT, _("Input files must be given in the job requests (option '%s')."), "--serve=");
+		num_errors ++;
+	}
+
+	if ( opts->incremental == TRUE ) {
+		if ( opts->num_formats > 1 || ( opts->format != PRG_OUTPUT_SHP && opts->format != PRG_OUTPUT_GEOJSONL ) ) {
+			err_show ( ERR_EXIT, _("Option '%s' requires output format \"%s\" or \"%s\"."), "--incremental",
+					PRG_OUTPUT_EXT[PRG_OUTPUT_SHP], PRG_OUTPUT_EXT[PRG_OUTPUT_GEOJSONL]);
+			num_errors ++;
+		}
+		if ( opts->spatial_index == TRUE ) {
+			err_show ( ERR_EXIT, _("Options '%s' and '%s' cannot be used together."), "--incremental", "--spatial-index");
+			num_errors ++;
+		}
+		if ( opts->orient_mode == OPTIONS_ORIENT_MODE_LOCAL_XZ ) {
+			err_show ( ERR_EXIT, _("Option '%s' cannot be used with orientation mode '%s'."), "--incremental",
+					OPTIONS_ORIENT_MODE_NAMES[OPTIONS_ORIENT_MODE_LOCAL_XZ]);
+			num_errors ++;
+		}
+		if ( opts->batch == NULL && opts->serve == NULL &&
+				( opts->num_input != 1 || !strcmp (opts->input[0], "-") ) ) {
+			err_show ( ERR_EXIT, _("Option '%s' requires exactly one input file (not \"stdin\")."), "--incremental");
+			num_errors ++;
+		}
+	}
+
+	if ( opts->watch == TRUE ) {
+		if ( opts->batch != NULL || opts->serve != NULL ) {
+			err_show ( ERR_EXIT, _("Option '%s' cannot be used together with '%s' or '%s'."), "--watch",
+					"--batch=", "--serve=");
+			num_errors ++;
+		}
+		for ( i = 0; i < opts->num_input; i ++ ) {
+			if ( opts->input[i] != NULL && !strcmp (opts->input[i], "-") ) {
+				err_show ( ERR_EXIT, _("Option '%s' cannot be used with input from \"stdin\"."), "--watch");
+				num_errors ++;
+				break;
+			}
+		}
+	}
+
+	if ( opts->snapshot != NULL ) {
+		if ( opts->batch != NULL || opts->serve != NULL ) {
+			err_show ( ERR_EXIT, _("Option '%s' cannot be used together with '%s' or '%s'."), "--snapshot=",
+					"--batch=", "--serve=");
+			num_errors ++;
+		}
+		if ( opts->incremental == TRUE ) {
+			err_show ( ERR_EXIT, _("Options '%s' and '%s' cannot be used together."), "--snapshot=", "--incremental");
+			num_errors ++;
+		}
+		for ( i = 0; i < opts->num_input; i ++ ) {
+			if ( opts->input[i] != NULL && !strcmp (opts->input[i], "-") ) {
+				err_show ( ERR_EXIT, _("Option '%s' cannot be used with input from \"stdin\"."), "--snapshot=");
+				num_errors ++;
+				break;
+			}
+		}
+	}
+
 	opts->empty = FALSE;
 
 #ifdef GUI
@@ -16,6 +16,8 @@
  ***************************************************************************/
 
 
+#include <stdio.h>
+
 #include "global.h"
 
 
@@ -32,6 +34,10 @@
 #define OPTIONS_ORIENT_MODE_WORLD_XYZ	0
 #define OPTIONS_ORIENT_MODE_LOCAL_XZ	1
 
+/* line simplification algorithms */
+#define OPTIONS_SIMPLIFY_MODE_DOUGLAS		0
+#define OPTIONS_SIMPLIFY_MODE_VISVALINGAM	1
+
 /* levels of topological corrections */
 #define OPTIONS_TOPO_LEVEL_NONE			0
 #define OPTIONS_TOPO_LEVEL_BASIC		1
@@ -52,11 +58,21 @@
 #define OPTIONS_DEFAULT_WGS84_TRANS_RY 		0.0
 #define OPTIONS_DEFAULT_WGS84_TRANS_RZ 		0.0
 #define OPTIONS_DEFAULT_WGS84_TRANS_DS 		1.0
+#define OPTIONS_DEFAULT_PROJ_APPROX 		0.0 /* 0.0 = exact reprojection */
 #define OPTIONS_DEFAULT_LABEL_MODE_POINT	OPTIONS_LABEL_MODE_CENTER
 #define OPTIONS_DEFAULT_LABEL_MODE_LINE		OPTIONS_LABEL_MODE_CENTER
 #define OPTIONS_DEFAULT_LABEL_MODE_POLY		OPTIONS_LABEL_MODE_CENTER
 #define OPTIONS_DEFAULT_ORIENT_MODE			OPTIONS_ORIENT_MODE_WORLD_XYZ
 #define OPTIONS_DEFAULT_TOPO_LEVEL			OPTIONS_TOPO_LEVEL_FULL
+#define OPTIONS_DEFAULT_THREADS				0 /* 0 = one per CPU */
+#define OPTIONS_DEFAULT_MIN_ZOOM			14
+#define OPTIONS_DEFAULT_MAX_ZOOM			20
+#define OPTIONS_DEFAULT_SIMPLIFY_LINES		0.0 /* 0.0 = off */
+#define OPTIONS_DEFAULT_SIMPLIFY_POLYS		0.0 /* 0.0 = off */
+#define OPTIONS_DEFAULT_SIMPLIFY_MODE		OPTIONS_SIMPLIFY_MODE_DOUGLAS
+
+/* highest zoom level for vector tiles */
+#define OPTIONS_MAX_ZOOM					24
 
 /*
  * GETTEXT NOTES:
@@ -107,6 +123,20 @@ static const char OPTIONS_ORIENT_MODE_DESC[][100] = {
 		""
 };
 
+/* simplification mode names (not case sensitive) */
+static const char OPTIONS_SIMPLIFY_MODE_NAMES[][12] = {
+		"douglas",
+		"visvalingam",
+		""
+};
+
+/* simplification mode descriptions */
+static const char OPTIONS_SIMPLIFY_MODE_DESC[][100] = {
+		gettext_noop ("Douglas-Peucker: max. distance"),
+		gettext_noop ("Visvalingam-Whyatt: min. area (squared distance)"),
+		""
+};
+
 /* topology level names (not case sensitive) */
 static const char OPTIONS_TOPO_LEVEL_NAMES[][10] = {
 		"none",
@@ -130,6 +160,7 @@ BOOLEAN OPTIONS_GUI_MODE;
 BOOLEAN OPTIONS_FORCE_ENGLISH;
 #else
 extern BOOLEAN OPTIONS_GUI_MODE;
+extern BOOLEAN OPTIONS_FORCE_ENGLISH;
 #endif
 
 typedef struct options options;
@@ -170,7 +201,9 @@ struct options
 	char *offset_z_str; /* copy of the original (string) option value */
 	char decimal_point[2]; /* user-specified char or empty */
 	char decimal_group[2]; /* user-specified char or empty */
-	unsigned short format; /* output file format (see OPTIONS_FORMAT_* above) */
+	unsigned short format; /* output file format (see OPTIONS_FORMAT_* above); first of "formats" */
+	unsigned short formats[PRG_OUTPUT_NUM]; /* all output formats to write (in the order given) */
+	int num_formats; /* number of formats in "formats" (at least one) */
 	BOOLEAN force_2d; /* always export data as 2D (default: FALSE) */
 	BOOLEAN strict; /* use strict input parsing (default: FALSE) */
 	BOOLEAN force_english; /* force English messages and numeric notation (default: FALSE)? */
@@ -198,10 +231,31 @@ struct options
 	double wgs84_trans_ds; /* datum transformation from WGS84 (scaling) */
 	char *wgs84_trans_ds_str; /* copy of the original (string) option value */
 	char *wgs84_trans_grid; /* datum transformation from WGS84 (grid file name) */
+	double proj_approx; /* max. error of approximate reprojection (0.0 = exact) */
+	char *proj_approx_str; /* copy of the original (string) option value */
+	int threads; /* max. number of parallel worker threads (always >= 1 after parsing) */
+	BOOLEAN spatial_index; /* write a spatial index (.qix) for each Shapefile (default: FALSE) */
+	BOOLEAN record_separator; /* start each GeoJSONL feature with RFC 8142 record separator (default: FALSE) */
+	BOOLEAN hilbert_order; /* sort geometries along a Hilbert curve before export (default: FALSE) */
+	int min_zoom; /* lowest zoom level for vector tile output */
+	int max_zoom; /* highest zoom level for vector tile output */
+	double simplify_lines; /* simplification tolerance for lines (0.0 = off) */
+	char *simplify_lines_str; /* copy of the original (string) option value */
+	double simplify_polys; /* simplification tolerance for polygons (0.0 = off) */
+	char *simplify_polys_str; /* copy of the original (string) option value */
+	int simplify_mode; /* simplification algorithm (see OPTIONS_SIMPLIFY_MODE_* above) */
+	BOOLEAN profile; /* report time and memory used by each processing stage (default: FALSE) */
+	char *batch; /* file with a list of jobs to run (NULL = normal mode) */
+	char *serve; /* socket on which to serve job requests (NULL = normal mode) */
+	BOOLEAN incremental; /* only process data appended to the input since the last run (default: FALSE) */
+	BOOLEAN watch; /* convert again whenever input or schema files change (default: FALSE) */
+	char *snapshot; /* file that keeps the parsed input data for later runs (NULL = none) */
 	/* internally used, not visible from CLI */
 	void *window; /* this is only used in GUI mode, to display error dialogs */
 	int argc; /* value of original CLI options counter */
 	char **argv; /* reference to original CLI options array */
+	FILE **input_streams; /* NULL, or an already opened stream for each input (not closed after reading) */
+	unsigned int append_ids; /* number of features already in output file (incremental mode) */
 	BOOLEAN empty;
 };
 
@@ -217,5 +271,8 @@ int options_parse ( options *opts );
 /* destroy an options object */
 void options_destroy ( options *opts );
 
+/* check if an output format is one of those to write */
+BOOLEAN options_has_format ( options *opts, int format );
+
 #endif /* OPTIONS_H */
 
@@ -26,6 +26,7 @@
 #include "i18n.h"
 #include "options.h"
 #include "parser.h"
+#include "snapshot.h"
 #include "tools.h"
 
 
@@ -39,23 +40,59 @@ void parser_field_destroy ( parser_field *field );
 
 
 /*
- * Set the contents of a parser record to default values.
+ * Changes the capacity of a data store to "num_records" records
+ * (all columns, see parser_data_store). Records added by this
+ * are set to default values (i.e. empty).
+ *
+ * Returns 0 if OK, 1 if out of memory (the data store is left
+ * as it was in that case).
  */
-void parser_record_init ( parser_record *rec ) {
-	rec->line = -1;
-	rec->contents = NULL;
-	rec->skip = NULL;
-	rec->x = 0.0;
-	rec->y = 0.0;
-	rec->z = 0.0;
-	rec->geom_id = 0;
-	rec->part_id = 0;
-	rec->tag = NULL;
-	rec->key = NULL;
-	rec->geom_type = GEOM_TYPE_NONE;
-	rec->written_out = FALSE;
-	rec->is_valid = FALSE;
-	rec->is_empty = TRUE;
+int parser_data_store_resize ( parser_data_store *ds, unsigned int num_records ) {
+	void *new_mem;
+	unsigned int n;
+	unsigned int i;
+
+	n = num_records > 0 ? num_records : 1;
+
+	new_mem = realloc ( (void*) ds->x, sizeof (double) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->x = (double*) new_mem;
+	new_mem = realloc ( (void*) ds->y, sizeof (double) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->y = (double*) new_mem;
+	new_mem = realloc ( (void*) ds->z, sizeof (double) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->z = (double*) new_mem;
+	new_mem = realloc ( (void*) ds->geom_id, sizeof (unsigned int) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->geom_id = (unsigned int*) new_mem;
+	new_mem = realloc ( (void*) ds->geom_type, sizeof (short int) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->geom_type = (short int*) new_mem;
+	new_mem = realloc ( (void*) ds->flags, sizeof (unsigned char) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->flags = (unsigned char*) new_mem;
+	new_mem = realloc ( (void*) ds->records, sizeof (parser_record) * n );
+	if ( new_mem == NULL ) return ( 1 );
+	ds->records = (parser_record*) new_mem;
+
+	for ( i = ds->num_records; i < num_records; i ++ ) {
+		ds->x[i] = 0.0;
+		ds->y[i] = 0.0;
+		ds->z[i] = 0.0;
+		ds->geom_id[i] = 0;
+		ds->geom_type[i] = GEOM_TYPE_NONE;
+		ds->flags[i] = PARSER_RECORD_EMPTY;
+		ds->records[i].line = -1;
+		ds->records[i].contents = NULL;
+		ds->records[i].skip = NULL;
+		ds->records[i].tag = NULL;
+		ds->records[i].key = NULL;
+		ds->records[i].part_id = 0;
+	}
+	ds->num_records = num_records;
+
+	return ( 0 );
 }
 
 
@@ -88,27 +125,35 @@ parser_data_store *parser_data_store_create ( const char *input, parser_desc *pa
 	ds->offset_x = opts->offset_x;
 	ds->offset_y = opts->offset_y;
 	ds->offset_z = opts->offset_z;
+	ds->start_offset = 0;
+	ds->start_line = 1;
+	ds->end_offset = 0;
+	ds->end_line = 1;
 	i = 0;
 	while ( parser->fields[i] != NULL)
 		i++;
 	ds->num_fields = i;
-	ds->num_records = PARSER_DATA_STORE_CHUNK;
+	ds->num_records = 0;
 	ds->num_points = 0;
 	ds->num_lines = 0;
 	ds->num_polygons = 0;
 	ds->space_left = PARSER_DATA_STORE_CHUNK;
-	ds->records = malloc ( sizeof (parser_record) * PARSER_DATA_STORE_CHUNK );
-	if ( ds->records == NULL ) {
-		free ( ds );
-		return ( NULL );
-	}
-	for ( i = 0; i < PARSER_DATA_STORE_CHUNK; i++ ) {
-		parser_record_init ( &ds->records[i] );
-	}
+	ds->x = NULL;
+	ds->y = NULL;
+	ds->z = NULL;
+	ds->geom_id = NULL;
+	ds->geom_type = NULL;
+	ds->flags = NULL;
+	ds->records = NULL;
 	ds->output_points = NULL;
 	ds->output_points_raw = NULL;
 	ds->output_lines = NULL;
 	ds->output_polygons = NULL;
+	ds->snapshot = NULL;
+	if ( parser_data_store_resize ( ds, PARSER_DATA_STORE_CHUNK ) != 0 ) {
+		parser_data_store_destroy ( ds );
+		return ( NULL );
+	}
 	return ( ds );
 }
 
@@ -125,25 +170,35 @@ void parser_data_store_destroy ( parser_data_store *ds )
 	if ( ds->input != NULL )
 		free ( ds->input );
 
-	for ( i = 0; i < ds->num_records; i ++ ) {
-		if ( ds->records[i].is_empty == TRUE ) {
-			free ( ds->records[i].contents );
-		} else {
-			if ( ds->records[i].contents != NULL ) {
-				for ( j = 0; j < ds->num_fields; j ++ ) {
-					if ( ds->records[i].contents[j] != NULL ) {
-						free ( ds->records[i].contents[j] );
+	if ( ds->snapshot != NULL ) {
+		snapshot_release ( ds->snapshot );
+	} else {
+		for ( i = 0; i < ds->num_records; i ++ ) {
+			if ( ds->flags[i] & PARSER_RECORD_EMPTY ) {
+				free ( ds->records[i].contents );
+			} else {
+				if ( ds->records[i].contents != NULL ) {
+					for ( j = 0; j < ds->num_fields; j ++ ) {
+						if ( ds->records[i].contents[j] != NULL ) {
+							free ( ds->records[i].contents[j] );
+						}
 					}
+					free ( ds->records[i].contents );
+				}
+				if ( ds->records[i].tag != NULL )
+					free ( ds->records[i].tag );
+				if ( ds->records[i].skip != NULL ) {
+					free ( ds->records[i].skip );
 				}
-				free ( ds->records[i].contents );
-			}
-			if ( ds->records[i].tag != NULL )
-				free ( ds->records[i].tag );
-			if ( ds->records[i].skip != NULL ) {
-				free ( ds->records[i].skip );
 			}
 		}
 	}
+	free ( ds->x );
+	free ( ds->y );
+	free ( ds->z );
+	free ( ds->geom_id );
+	free ( ds->geom_type );
+	free ( ds->flags );
 	free ( ds->records );
 	if ( ds->output_points != NULL)
 		free ( ds->output_points );
@@ -186,26 +241,17 @@ int parser_record_store ( 	const char **contents, int num_fields_read, unsigned
 			fprintf ( stderr, "STORE: allocating %i more slots.\n", PARSER_DATA_STORE_CHUNK );
 		}
 		/* out of storage space: get more mem */
-		void *new_mem;
-		new_mem = realloc ( (void*) ds->records, sizeof ( parser_record ) *
-				( ds->num_records + PARSER_DATA_STORE_CHUNK ) );
-		if ( new_mem == NULL ) {
+		if ( parser_data_store_resize ( ds, ds->num_records + PARSER_DATA_STORE_CHUNK ) != 0 ) {
 			err_msg_set (_("Out of storage memory."));
 			return ( 1 );
 		}
-		ds->records = (parser_record*) new_mem;
-		/* initialize new empty records */
-		for ( i=ds->num_records; i < PARSER_DATA_STORE_CHUNK+ds->num_records; i ++ ) {
-			parser_record_init ( &ds->records[i] );
-		}
 		ds->space_left = PARSER_DATA_STORE_CHUNK;
-		ds->num_records += PARSER_DATA_STORE_CHUNK;
 		if ( DEBUG == TRUE ) {
 			fprintf ( stderr, "STORE: new capacity: %ui.\n", ds->num_records );
 		}
 	}
 
-	if ( ds->records[ds->slot].is_empty == FALSE ) {
+	if ( !( ds->flags[ds->slot] & PARSER_RECORD_EMPTY ) ) {
 		/* slot taken: this is an error */
 		err_msg_set (_("Storage slot already contains data."));
 		return ( 1 );
@@ -254,7 +300,7 @@ int parser_record_store ( 	const char **contents, int num_fields_read, unsigned
 		}
 	}
 	ds->records[ds->slot].line = line_no;
-	ds->records[ds->slot].is_empty = FALSE;
+	ds->flags[ds->slot] &= ~PARSER_RECORD_EMPTY;
 
 	ds->records[ds->slot].skip = malloc (sizeof(BOOLEAN) * ds->num_fields);
 	for ( i = 0; i < ds->num_fields; i ++ ) {
@@ -507,7 +553,7 @@ int parser_record_validate_store_coords ( 	unsigned int slot, int num_fields_rea
 				valid = FALSE;
 			}
 			if ( valid == TRUE ) {
-				ds->records[slot].x = dvalue + opts->offset_x;
+				ds->x[slot] = dvalue + opts->offset_x;
 			}
 		}
 		/* Y coordinate */
@@ -530,9 +576,9 @@ int parser_record_validate_store_coords ( 	unsigned int slot, int num_fields_rea
 				valid = FALSE;
 			}
 			if ( valid == TRUE ) {
-				ds->records[slot].y = dvalue + opts->offset_y;
+				ds->y[slot] = dvalue + opts->offset_y;
 				/* DEBUG */
-				/* fprintf (stderr,"STORED Y = %.3f\n", ds->records[slot].y); */
+				/* fprintf (stderr,"STORED Y = %.3f\n", ds->y[slot]); */
 			}
 		}
 		/* Z coordinate */
@@ -555,20 +601,20 @@ int parser_record_validate_store_coords ( 	unsigned int slot, int num_fields_rea
 				valid = FALSE;
 			}
 			if ( valid == TRUE ) {
-				ds->records[slot].z = dvalue + opts->offset_z;
+				ds->z[slot] = dvalue + opts->offset_z;
 			}
 		}
 	}
 	/* set Z to constant "0" + Z offset if we have 2D coordinates */
 	if ( valid == TRUE && parser->coor_z == NULL ) {
-		ds->records[slot].z = opts->offset_z;
+		ds->z[slot] = opts->offset_z;
 	}
 
 	if ( DEBUG == TRUE && valid == TRUE ) {
 		fprintf ( stderr, "VALIDATE: coordinates = {%.4f, %.4f, %.4f}\n",
-				ds->records[slot].x,
-				ds->records[slot].y,
-				ds->records[slot].z);
+				ds->x[slot],
+				ds->y[slot],
+				ds->z[slot]);
 	}
 
 	/* check for correct data types (try conversion) */
@@ -684,7 +730,11 @@ int parser_record_validate_store_coords ( 	unsigned int slot, int num_fields_rea
 		}
 	}
 
-	ds->records[slot].is_valid = valid;
+	if ( valid == TRUE ) {
+		ds->flags[slot] |= PARSER_RECORD_VALID;
+	} else {
+		ds->flags[slot] &= ~PARSER_RECORD_VALID;
+	}
 
 	free ( input );
 	return ( 0 );
@@ -729,29 +779,29 @@ unsigned int parser_ds_fuse ( parser_data_store **storage, options *opts, parser
 	for ( i = 0 ; i < opts->num_input; i ++ ) {
 		int part = 0;
 		for ( j = 0; j < storage[i]->num_records; j ++ ) {
-			if ( 	storage[i]->records[j].is_empty == FALSE &&
-					storage[i]->records[j].is_valid == TRUE )
+			if ( 	!( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) &&
+					( storage[i]->flags[j] & PARSER_RECORD_VALID ) )
 			{
 				/* we got a valid record: check if there are any more with the
 				 * same key and geom type */
 				for ( k = 0; k < opts->num_input; k ++ ) {
 					for ( l = 0 ; l < storage[k]->num_records ; l ++ ) {
 						if ( 	( l != j || k != i  ) &&
-								storage[k]->records[l].is_empty == FALSE &&
-								storage[k]->records[l].geom_type != GEOM_TYPE_POINT &&
-								storage[k]->records[l].geom_type != GEOM_TYPE_NONE &&
-								storage[i]->records[j].geom_type == storage[k]->records[l].geom_type &&
-								storage[k]->records[l].geom_id != storage[i]->records[j].geom_id &&
+								!( storage[k]->flags[l] & PARSER_RECORD_EMPTY ) &&
+								storage[k]->geom_type[l] != GEOM_TYPE_POINT &&
+								storage[k]->geom_type[l] != GEOM_TYPE_NONE &&
+								storage[i]->geom_type[j] == storage[k]->geom_type[l] &&
+								storage[k]->geom_id[l] != storage[i]->geom_id[j] &&
 								!strcmp ( 	storage[i]->records[j].contents[key],
 										storage[k]->records[l].contents[key]  ) )
 						{
 							/* found one: fuse it! */
-							if ( old_geom_id_1 != storage[i]->records[j].geom_id ) {
-								old_geom_id_1 = storage[i]->records[j].geom_id;
+							if ( old_geom_id_1 != storage[i]->geom_id[j] ) {
+								old_geom_id_1 = storage[i]->geom_id[j];
 								part = 0;
 							}
-							if ( old_geom_id_2 != storage[k]->records[l].geom_id ) {
-								old_geom_id_2 = storage[k]->records[l].geom_id;
+							if ( old_geom_id_2 != storage[k]->geom_id[l] ) {
+								old_geom_id_2 = storage[k]->geom_id[l];
 								part ++;
 								err_show ( ERR_NOTE, _("\n\nMerging geometry #'%s' (read from '%s', line %i+) with\ngeometry #'%s' (read from '%s', line %i+),\nas part %i"),
 										storage[i]->records[j].contents[key], opts->input[k], storage[k]->records[l].line,
@@ -759,7 +809,7 @@ unsigned int parser_ds_fuse ( parser_data_store **storage, options *opts, parser
 										part);
 								num_fused ++;
 							}
-							storage[k]->records[l].geom_id = storage[i]->records[j].geom_id;
+							storage[k]->geom_id[l] = storage[i]->geom_id[j];
 							storage[k]->records[l].part_id = part;
 						}
 					}
@@ -792,15 +842,15 @@ unsigned int parser_ds_validate_unique ( parser_data_store **storage, options *o
 		if ( parser->fields[i]->unique == TRUE ) {
 			for ( j = 0 ; j < opts->num_input; j ++ ) {
 				for ( k = 0; k < storage[j]->num_records; k ++ ) {
-					if ( 	storage[j]->records[k].is_empty == FALSE &&
-							storage[j]->records[k].is_valid == TRUE )
+					if ( 	!( storage[j]->flags[k] & PARSER_RECORD_EMPTY ) &&
+							( storage[j]->flags[k] & PARSER_RECORD_VALID ) )
 					{
 						for ( l = 0; l < opts->num_input; l ++ ) {
 							for ( m = 0 ; m < storage[l]->num_records ; m ++ ) {
 								if ( 	( m != k || l != j  ) &&
-										storage[l]->records[m].is_empty == FALSE &&
-										storage[l]->records[m].is_valid == TRUE &&
-										storage[l]->records[m].geom_id != storage[j]->records[k].geom_id &&
+										!( storage[l]->flags[m] & PARSER_RECORD_EMPTY ) &&
+										( storage[l]->flags[m] & PARSER_RECORD_VALID ) &&
+										storage[l]->geom_id[m] != storage[j]->geom_id[k] &&
 										!strcmp ( 	storage[j]->records[k].contents[i],
 												storage[l]->records[m].contents[i]  ) )
 								{
@@ -3384,6 +3434,39 @@ int parser_desc_validate ( parser_desc *parser, options *opts )
 }
 
 
+/*
+ * Helper function for parser_consume_input() (below):
+ * Releases the memory of an input run that is about to be aborted
+ * with a fatal error and closes the input file (unless it is "stdin"
+ * or a stream opened by the caller). This must be done before the
+ * error is shown: In a library context, err_show() does not return
+ * from an error of type ERR_EXIT.
+ *
+ * Only the first "num_fields" entries of "contents" are freed (pass
+ * 0 if they have not been set, yet). Any of the other pointers may
+ * be NULL.
+ */
+void parser_consume_abort ( char **contents, int num_fields, char *line,
+		char *buffer, char *buffer_reduced, FILE *in, options *opts )
+{
+	int j;
+
+
+	if ( contents != NULL ) {
+		for ( j = 0; j < num_fields; j ++ ) {
+			if ( contents[j] != NULL )
+				free ( contents[j] );
+		}
+		free ( contents );
+	}
+	t_free ( line );
+	t_free ( buffer );
+	t_free ( buffer_reduced );
+	if ( in != NULL && in != stdin && opts->input_streams == NULL )
+		fclose ( in );
+}
+
+
 /*
  * Main function that reads all input data and parses it for both
  * geometries and attribute values.
@@ -3392,6 +3475,7 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 {
 	int num_fields;
 	int error;
+	int err_no;
 	int i, j, k, len, len_reduced;
 	parser_field *field, *field_reduced;
 	int current_field, current_field_reduced;
@@ -3414,7 +3498,10 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 	for ( i=0; i < opts->num_input ; i ++ ) {
 
 		/* file name "-" means "read from stdin" */
-		if ( !strcmp ( opts->input[i], "-" ) ) {
+		if ( opts->input_streams != NULL ) {
+			/* stream opened by caller (see s2g_process_buffer()) */
+			in = opts->input_streams[i];
+		} else if ( !strcmp ( opts->input[i], "-" ) ) {
 			in = stdin;
 		} else {
 			/* attempt to open current input file */
@@ -3424,17 +3511,34 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 			in = t_fopen_utf8 ( opts->input[i], "r" );
 #endif			
 			if ( in == NULL ) {
+				err_no = errno;
+				parser_consume_abort ( contents, 0, NULL, NULL, NULL, NULL, opts );
 				err_show ( ERR_EXIT, _("Cannot open input file for reading ('%s').\nReason: %s"),
-						opts->input[i], strerror (errno));
-				free ( contents );
+						opts->input[i], strerror (err_no));
+				return;
+			}
+		}
+
+		/* continue where an earlier run stopped (incremental mode) */
+		if ( storage[i]->start_offset > 0 ) {
+			if ( fseek ( in, storage[i]->start_offset, SEEK_SET ) != 0 ) {
+				err_no = errno;
+				parser_consume_abort ( contents, 0, NULL, NULL, NULL, in, opts );
+				err_show ( ERR_EXIT, _("Cannot read input file from byte offset %li ('%s').\nReason: %s"),
+						storage[i]->start_offset, opts->input[i], strerror (err_no));
 				return;
 			}
 		}
 
 		char *line = malloc ( sizeof (char) * PARSER_MAX_FILE_LINE_LENGTH);
-		unsigned int line_no = 1;
+		unsigned int line_no = storage[i]->start_line;
+		BOOLEAN is_incomplete = FALSE;
 
 		unsigned int valid_line_no = 0; /* the first valid line is one that has the same number of fields as specified by parser description */
+		if ( storage[i]->start_offset > 0 ) {
+			/* an earlier run has already read valid lines (incremental mode) */
+			valid_line_no = 1;
+		}
 
 		/* parse lines in current file */
 		while ( fgets ( line, PARSER_MAX_FILE_LINE_LENGTH, in ) ) {
@@ -3446,19 +3550,21 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 			p = index ( line, '\n');
 			if ( p == NULL ) {
 				if ( strlen ( line ) > (PARSER_MAX_FILE_LINE_LENGTH-1) ) {
+					parser_consume_abort ( contents, num_fields, line, NULL, NULL, in, opts );
 					if ( in != stdin ) {
 						err_show ( ERR_EXIT, _("Line too long in input file '%s' (line no.: %i).\nThe maximum line length allowed is: %i characters."),
 								opts->input[i], line_no, PARSER_MAX_FILE_LINE_LENGTH);
-						free ( line );
-						free ( contents );
 						return;
 					} else {
 						err_show ( ERR_EXIT, _("Input line too long.\nThe maximum line length allowed is: %i characters."),
 								PARSER_MAX_FILE_LINE_LENGTH);
-						free ( line );
-						free ( contents );
 						return;
 					}
+				} else if ( opts->incremental == TRUE ) {
+					/* The last line may still be in the process of being
+					   written: leave it for the next run. */
+					is_incomplete = TRUE;
+					break;
 				} else {
 					/* add a line terminator */
 					line[strlen(line)] = '\n';
@@ -3645,17 +3751,14 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 				/* store record */
 				error = parser_record_store ( (const char**) contents, current_field+1, line_no, storage[i], parser, opts );
 				if ( error != 0 ) {
+					parser_consume_abort ( contents, num_fields, line, buffer, buffer_reduced, in, opts );
 					if ( in != stdin ) {
 						err_show ( ERR_EXIT, _("Error storing data from file '%s' (line no.: %i):\n%s"),
 								opts->input[i], line_no, err_msg );
-						free ( line );
-						free ( contents );
 						return;
 					} else {
 						err_show ( ERR_EXIT, _("Error storing data (line no.: %i):\n%s"),
 								line_no, err_msg );
-						free ( line );
-						free ( contents );
 						return;
 					}
 				}
@@ -3663,17 +3766,14 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 				/* validate record and store coordinates */
 				error = parser_record_validate_store_coords ( storage[i]->slot-1, current_field+1, storage[i], parser, opts );
 				if ( error != 0 ) {
+					parser_consume_abort ( contents, num_fields, line, buffer, buffer_reduced, in, opts );
 					if ( in != stdin ) {
 						err_show ( ERR_EXIT, _("Error validating data from file '%s' (line no.: %i):\n%s"),
 								opts->input[i], line_no, err_msg );
-						free ( line );
-						free ( contents );
 						return;
 					} else {
 						err_show ( ERR_EXIT, _("Error validating data (line no.: %i):\n%s"),
 								line_no, err_msg );
-						free ( line );
-						free ( contents );
 						return;
 					}
 				}
@@ -3691,9 +3791,18 @@ void parser_consume_input ( parser_desc *parser, options *opts, parser_data_stor
 
 		} /* END (parse lines in current file) */
 
+		/* remember where to continue reading (incremental mode) */
+		if ( opts->incremental == TRUE ) {
+			storage[i]->end_offset = ftell ( in );
+			if ( is_incomplete == TRUE ) {
+				storage[i]->end_offset -= (long) strlen ( line );
+			}
+			storage[i]->end_line = line_no;
+		}
+
 		/* done with this file */
 		free ( line );
-		if ( in != stdin )
+		if ( in != stdin && opts->input_streams == NULL )
 			fclose ( in );
 	} /* END (loop through all input files) */
 	free ( contents );
@@ -200,6 +200,11 @@ static const char PARSER_MODE_NAMES[][5] =
 /* default data store memory chunk size */
 #define PARSER_DATA_STORE_CHUNK	100
 
+/* record flags (see parser_data_store) */
+#define PARSER_RECORD_WRITTEN_OUT	1 /* record has been written to output file */
+#define PARSER_RECORD_VALID			2 /* record has been validated and is OK */
+#define PARSER_RECORD_EMPTY			4 /* empty record (slot not used yet) */
+
 /* Forward declarations. See below for explanations */
 typedef struct parser_field parser_field;
 typedef struct parser_desc parser_desc;
@@ -287,23 +292,19 @@ struct parser_desc
 
 
 /*
- * This structure stores one (validated) record
- * from one of the input files, plus metadata.
+ * This structure stores the field values and other metadata of
+ * one record from one of the input files. Coordinates, geometry
+ * ID and type and the record's flags are stored in the columns
+ * of the data store (see below).
  */
 struct parser_record
 {
 	unsigned int line; /* the line of the input file/stdin this was read from */
 	char **contents; /* the original field values, as read from input file */
 	BOOLEAN *skip; /* TRUE for any field that can be missing in tag mode "min" */
-	double x, y, z; /* the recorded coordinates (for quick access) */
 	char *tag; /* geometry tag or NULL */
 	char *key; /* key field or NULL */
-	unsigned int geom_id; /* the ID of the geometry set this data belongs to */
 	unsigned int part_id; /* consecutive part no. for multi-part geoms 0=main part */
-	short int geom_type; /* geometry type (see geom.h), or -1 if unassigned */
-	BOOLEAN written_out; /* TRUE if this record has been written and to output file */
-	BOOLEAN is_valid; /* TRUE only if this record has been validated and is OK */
-	BOOLEAN is_empty; /* TRUE if this is an empty record */
 };
 
 
@@ -324,13 +325,29 @@ struct parser_data_store
 	unsigned int space_left; /* number of records for which there is still space */
 	int num_fields; /* number of fields in each record (according to parser schema) */
 	double offset_x, offset_y, offset_z; /* user-defined coordinate offsets */
-	parser_record *records; /* array of stored records */
+	long start_offset; /* byte offset in input at which to start reading (incremental mode) */
+	unsigned int start_line; /* number of the line that starts there */
+	long end_offset; /* byte offset after the last complete line read (incremental mode) */
+	unsigned int end_line; /* number of the line that starts there */
+	/* Stored records: the fields that are read in every pass over
+	 * the records (building, cleaning and checking geometries) have
+	 * one array each, so that these passes do not have to read the
+	 * field values and other metadata as well. All arrays have
+	 * "num_records" elements. */
+	double *x, *y, *z; /* the recorded coordinates */
+	unsigned int *geom_id; /* the ID of the geometry set each record belongs to */
+	short int *geom_type; /* geometry type (see geom.h), or -1 if unassigned */
+	unsigned char *flags; /* PARSER_RECORD_* flags */
+	parser_record *records; /* field values and metadata */
 	/* the following can be NULL or the full paths of the output files produced
 	 * from the data in this data store: */
 	char *output_points;
 	char *output_points_raw;
 	char *output_lines;
 	char *output_polygons;
+	/* NULL, or the snapshot that this data store was loaded from (see snapshot.h);
+	 * it owns the field values, tags and keys of all records */
+	struct snapshot_data *snapshot;
 };
 
 
@@ -368,6 +385,9 @@ parser_data_store *parser_data_store_create ( const char *input, parser_desc *pa
 /* releases all memory associated with a data store */
 void parser_data_store_destroy ( parser_data_store *ds );
 
+/* changes the number of records that a data store has space for */
+int parser_data_store_resize ( parser_data_store *ds, unsigned int num_records );
+
 /* main function that reads the input files and parses them,
  * storing the data in a data store for each input data source */
 void parser_consume_input ( parser_desc *parser, options *opts, parser_data_store **storage );
@@ -33,6 +33,14 @@
 #include <math.h>
 #include <errno.h>
 
+#if !defined(_WIN32) && !defined(_WIN32_WCE)
+#  define PJ_GRIDINFO_MMAP
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 #ifdef _WIN32_WCE
 /* assert.h includes all Windows API headers and causes 'LP' name clash.
  * Here assert we disable assert() for Windows CE.
@@ -74,6 +82,130 @@ static void swap_words( unsigned char *data, int word_size, int word_count )
     }
 }
 
+/************************************************************************/
+/*                          get_float() / get_double()                  */
+/*                                                                      */
+/*      Fetch a (possibly byte swapped) value from unaligned data.      */
+/************************************************************************/
+
+static float get_float( const unsigned char *data, int must_swap )
+
+{
+    float value;
+
+    memcpy( &value, data, 4 );
+    if( must_swap )
+        swap_words( (unsigned char *) &value, 4, 1 );
+
+    return value;
+}
+
+static double get_double( const unsigned char *data, int must_swap )
+
+{
+    double value;
+
+    memcpy( &value, data, 8 );
+    if( must_swap )
+        swap_words( (unsigned char *) &value, 8, 1 );
+
+    return value;
+}
+
+/************************************************************************/
+/*                          pj_gridinfo_map()                           */
+/*                                                                      */
+/*      Memory map a range of bytes of the grid file, read-only.        */
+/*      Pages are only read from disk when they are first accessed,     */
+/*      and they are shared with the file system cache, so they do      */
+/*      not count against the heap.  Returns a pointer to the first     */
+/*      requested byte, or NULL if the file cannot be mapped (on        */
+/*      platforms without mmap(), or if an application file API is      */
+/*      installed).  Callers fall back to reading the file then.        */
+/************************************************************************/
+
+static const unsigned char *pj_gridinfo_map( projCtx ctx, PJ_GRIDINFO *gi,
+                                             long offset, size_t size,
+                                             int sequential,
+                                             void **map_base,
+                                             size_t *map_size )
+
+{
+#ifdef PJ_GRIDINFO_MMAP
+    char   fname[MAX_PATH_FILENAME+1];
+    PAFile fid;
+    struct stat st;
+    long   page_offset;
+    int    fd;
+    void   *base;
+
+    *map_base = NULL;
+    *map_size = 0;
+
+    if( ctx->fileapi != pj_get_default_fileapi() || size == 0 )
+        return NULL;
+
+    /* resolve the file name using the usual search rules */
+    fid = pj_open_lib_ex( ctx, gi->filename, "rb", fname, sizeof(fname) );
+    if( fid == NULL )
+        return NULL;
+    pj_ctx_fclose( ctx, fid );
+
+    fd = open( fname, O_RDONLY );
+    if( fd < 0 )
+        return NULL;
+
+    if( fstat( fd, &st ) != 0 || offset < 0
+        || (size_t) st.st_size < (size_t) offset + size )
+    {
+        close( fd );
+        return NULL;
+    }
+
+    page_offset = offset % sysconf( _SC_PAGESIZE );
+    base = mmap( NULL, size + page_offset, PROT_READ, MAP_PRIVATE,
+                 fd, offset - page_offset );
+    close( fd );
+
+    if( base == MAP_FAILED )
+        return NULL;
+
+#ifdef MADV_SEQUENTIAL
+    if( sequential )
+        madvise( base, size + page_offset, MADV_SEQUENTIAL );
+#endif
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+            "pj_gridinfo_map(%s): mapped %ld bytes at offset %ld",
+            fname, (long) size, offset );
+
+    *map_base = base;
+    *map_size = size + page_offset;
+
+    return ((const unsigned char *) base) + page_offset;
+#else
+    (void) ctx; (void) gi; (void) offset; (void) size; (void) sequential;
+    *map_base = NULL;
+    *map_size = 0;
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                         pj_gridinfo_unmap()                          */
+/************************************************************************/
+
+static void pj_gridinfo_unmap( void *map_base, size_t map_size )
+
+{
+#ifdef PJ_GRIDINFO_MMAP
+    if( map_base != NULL )
+        munmap( map_base, map_size );
+#else
+    (void) map_base; (void) map_size;
+#endif
+}
+
 /************************************************************************/
 /*                          pj_gridinfo_free()                          */
 /************************************************************************/
@@ -95,6 +227,14 @@ void pj_gridinfo_free( projCtx ctx, PJ_GRIDINFO *gi )
         }
     }
 
+    if( gi->map_base != NULL )
+    {
+        /* ct->cvs points into the mapping, it is not on the heap */
+        pj_gridinfo_unmap( gi->map_base, gi->map_size );
+        if( gi->ct != NULL )
+            gi->ct->cvs = NULL;
+    }
+
     if( gi->ct != NULL )
         nad_free( gi->ct );
 
@@ -117,6 +257,9 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
 
 {
     struct CTABLE ct_tmp;
+    const unsigned char *data;
+    void   *map_base;
+    size_t map_size;
 
     if( gi == NULL || gi->ct == NULL )
         return 0;
@@ -138,6 +281,19 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         PAFile fid;
         int result;
 
+        /* data is stored in native FLP layout: use the mapping directly */
+        data = pj_gridinfo_map( ctx, gi, sizeof(struct CTABLE),
+                                sizeof(FLP) * gi->ct->lim.lam * gi->ct->lim.phi,
+                                0, &map_base, &map_size );
+        if( data != NULL )
+        {
+            gi->map_base = map_base;
+            gi->map_size = map_size;
+            gi->ct->cvs = (FLP *) data;
+            pj_release_lock();
+            return 1;
+        }
+
         fid = pj_open_lib( ctx, gi->filename, "rb" );
 
         if( fid == NULL )
@@ -165,6 +321,22 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         PAFile fid;
         int result;
 
+        /* data is stored as LSB FLP values: use the mapping directly
+           unless we would have to swap them */
+        data = NULL;
+        if( IS_LSB )
+            data = pj_gridinfo_map( ctx, gi, 160,
+                                    sizeof(FLP) * gi->ct->lim.lam * gi->ct->lim.phi,
+                                    0, &map_base, &map_size );
+        if( data != NULL )
+        {
+            gi->map_base = map_base;
+            gi->map_size = map_size;
+            gi->ct->cvs = (FLP *) data;
+            pj_release_lock();
+            return 1;
+        }
+
         fid = pj_open_lib( ctx, gi->filename, "rb" );
 
         if( fid == NULL )
@@ -197,6 +369,45 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         int	row;
         PAFile fid;
 
+        /* convert directly from a mapping of the file, if possible */
+        data = pj_gridinfo_map( ctx, gi, gi->grid_offset,
+                                (size_t) gi->ct->lim.lam * gi->ct->lim.phi * 16,
+                                1, &map_base, &map_size );
+        if( data != NULL )
+        {
+            ct_tmp.cvs = (FLP *) pj_malloc(gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP));
+            if( ct_tmp.cvs == NULL )
+            {
+                pj_gridinfo_unmap( map_base, map_size );
+                pj_ctx_set_errno( ctx, -38 );
+                pj_release_lock();
+                return 0;
+            }
+
+            for( row = 0; row < gi->ct->lim.phi; row++ )
+            {
+                int	    i;
+                FLP     *cvs;
+
+                /* rows are stored e-w in the file: fill ours backwards */
+                cvs = ct_tmp.cvs + (row+1) * gi->ct->lim.lam - 1;
+                for( i = 0; i < gi->ct->lim.lam; i++ )
+                {
+                    cvs->phi = get_double( data, IS_LSB ) * ((M_PI/180.0) / 3600.0);
+                    cvs->lam = get_double( data + 8, IS_LSB ) * ((M_PI/180.0) / 3600.0);
+                    data += 16;
+                    cvs--;
+                }
+            }
+
+            pj_gridinfo_unmap( map_base, map_size );
+
+            gi->ct->cvs = ct_tmp.cvs;
+            pj_release_lock();
+
+            return 1;
+        }
+
         fid = pj_open_lib( ctx, gi->filename, "rb" );
 
         if( fid == NULL )
@@ -275,6 +486,45 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         pj_log( ctx, PJ_LOG_DEBUG_MINOR,
                 "NTv2 - loading grid %s", gi->ct->id );
 
+        /* convert directly from a mapping of this subgrid, if possible */
+        data = pj_gridinfo_map( ctx, gi, gi->grid_offset,
+                                (size_t) gi->ct->lim.lam * gi->ct->lim.phi * 16,
+                                1, &map_base, &map_size );
+        if( data != NULL )
+        {
+            ct_tmp.cvs = (FLP *) pj_malloc(gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP));
+            if( ct_tmp.cvs == NULL )
+            {
+                pj_gridinfo_unmap( map_base, map_size );
+                pj_ctx_set_errno( ctx, -38 );
+                pj_release_lock();
+                return 0;
+            }
+
+            for( row = 0; row < gi->ct->lim.phi; row++ )
+            {
+                int	    i;
+                FLP     *cvs;
+
+                /* rows are stored e-w in the file: fill ours backwards */
+                cvs = ct_tmp.cvs + (row+1) * gi->ct->lim.lam - 1;
+                for( i = 0; i < gi->ct->lim.lam; i++ )
+                {
+                    cvs->phi = get_float( data, gi->must_swap ) * ((M_PI/180.0) / 3600.0);
+                    cvs->lam = get_float( data + 4, gi->must_swap ) * ((M_PI/180.0) / 3600.0);
+                    data += 16; /* skip accuracy values */
+                    cvs--;
+                }
+            }
+
+            pj_gridinfo_unmap( map_base, map_size );
+
+            gi->ct->cvs = ct_tmp.cvs;
+            pj_release_lock();
+
+            return 1;
+        }
+
         fid = pj_open_lib( ctx, gi->filename, "rb" );
 
         if( fid == NULL )
@@ -348,6 +598,35 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         int   words = gi->ct->lim.lam * gi->ct->lim.phi;
         PAFile fid;
 
+        /* convert directly from a mapping of the file, if possible */
+        data = pj_gridinfo_map( ctx, gi, gi->grid_offset,
+                                (size_t) words * sizeof(float),
+                                1, &map_base, &map_size );
+        if( data != NULL )
+        {
+            float *values;
+            int   i;
+
+            ct_tmp.cvs = (FLP *) pj_malloc(words*sizeof(float));
+            if( ct_tmp.cvs == NULL )
+            {
+                pj_gridinfo_unmap( map_base, map_size );
+                pj_ctx_set_errno( ctx, -38 );
+                pj_release_lock();
+                return 0;
+            }
+
+            values = (float *) ct_tmp.cvs;
+            for( i = 0; i < words; i++ )
+                values[i] = get_float( data + i * 4, IS_LSB );
+
+            pj_gridinfo_unmap( map_base, map_size );
+
+            gi->ct->cvs = ct_tmp.cvs;
+            pj_release_lock();
+            return 1;
+        }
+
         fid = pj_open_lib( ctx, gi->filename, "rb" );
 
         if( fid == NULL )
@@ -91,11 +91,15 @@ void pj_set_searchpath ( int count, const char **path )
 }
 
 /************************************************************************/
-/*                            pj_open_lib()                             */
+/*                           pj_open_lib_ex()                           */
+/*                                                                      */
+/*      Like pj_open_lib(), but also returns the name of the file       */
+/*      that was actually opened in out_full_name (if not NULL).        */
 /************************************************************************/
 
 PAFile
-pj_open_lib(projCtx ctx, const char *name, const char *mode) {
+pj_open_lib_ex(projCtx ctx, const char *name, const char *mode,
+               char *out_full_name, size_t out_full_name_size) {
     char fname[MAX_PATH_FILENAME+1];
     const char *sysname;
     PAFile fid;
@@ -165,8 +169,23 @@ pj_open_lib(projCtx ctx, const char *name, const char *mode) {
             name, sysname,
             fid == NULL ? "failed" : "succeeded" );
 
+    if( fid != NULL && out_full_name != NULL && out_full_name_size > 0 )
+    {
+        strncpy( out_full_name, sysname, out_full_name_size - 1 );
+        out_full_name[out_full_name_size - 1] = '\0';
+    }
+
     return(fid);
 #else
     return NULL;
 #endif /* _WIN32_WCE */
 }
+
+/************************************************************************/
+/*                            pj_open_lib()                             */
+/************************************************************************/
+
+PAFile
+pj_open_lib(projCtx ctx, const char *name, const char *mode) {
+    return pj_open_lib_ex( ctx, name, mode, NULL, 0 );
+}
@@ -167,6 +167,7 @@ void   pj_ctx_fclose(projCtx ctx, PAFile file);
 char  *pj_ctx_fgets(projCtx ctx, char *line, int size, PAFile file);
 
 PAFile pj_open_lib(projCtx, const char *, const char *);
+PAFile pj_open_lib_ex(projCtx, const char *, const char *, char *, size_t);
 
 int pj_run_selftests (int verbosity);
 
@@ -441,6 +441,10 @@ typedef struct _pj_gi {
 
     struct _pj_gi *next;
     struct _pj_gi *child;
+
+    void  *map_base;    /* memory mapping that ct->cvs points into, or NULL
+                           if ct->cvs is on the heap */
+    size_t map_size;    /* size of map_base */
 } PJ_GRIDINFO;
 
 typedef struct {
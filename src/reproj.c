@@ -17,6 +17,8 @@
 
 
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -30,6 +32,241 @@
 #include "reproj.h"
 #include "tools.h"
 
+/* In-memory index of the PROJ.4 EPSG database file (loaded on first lookup, sorted by EPSG code) */
+static char *REPROJ_EPSG_PATH = NULL;
+static reproj_epsg_entry *REPROJ_EPSG_INDEX = NULL;
+static int REPROJ_EPSG_INDEX_LEN = 0;
+static BOOLEAN REPROJ_EPSG_INDEX_LOADED = FALSE;
+
+/* Cache of initialized SRS objects, keyed by PROJ.4 definition string */
+static reproj_pj_entry *REPROJ_PJ_CACHE = NULL;
+static int REPROJ_PJ_CACHE_LEN = 0;
+
+/* Protects all of the above */
+static pthread_mutex_t REPROJ_CACHE_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * Drops the in-memory EPSG index (if any).
+ * Caller must hold REPROJ_CACHE_LOCK.
+ */
+void reproj_epsg_index_free ( void )
+{
+	int i;
+	for ( i = 0; i < REPROJ_EPSG_INDEX_LEN; i ++ ) {
+		t_free ( REPROJ_EPSG_INDEX[i].def );
+	}
+	t_free ( REPROJ_EPSG_INDEX );
+	REPROJ_EPSG_INDEX = NULL;
+	REPROJ_EPSG_INDEX_LEN = 0;
+	REPROJ_EPSG_INDEX_LOADED = FALSE;
+}
+
+
+/*
+ * Sets the path to the PROJ.4 EPSG database file.
+ * The in-memory index is dropped if the path changes.
+ */
+void reproj_epsg_set_path ( const char *path )
+{
+	pthread_mutex_lock ( &REPROJ_CACHE_LOCK );
+	if ( REPROJ_EPSG_PATH == NULL || strcmp ( REPROJ_EPSG_PATH, path ) ) {
+		reproj_epsg_index_free ();
+		t_free ( REPROJ_EPSG_PATH );
+		REPROJ_EPSG_PATH = strdup ( path );
+	}
+	pthread_mutex_unlock ( &REPROJ_CACHE_LOCK );
+}
+
+
+/*
+ * Helper for qsort() and bsearch(): compares two EPSG index entries by code.
+ */
+int reproj_epsg_compare ( const void *a, const void *b )
+{
+	int code_a = ((const reproj_epsg_entry*) a)->code;
+	int code_b = ((const reproj_epsg_entry*) b)->code;
+
+	if ( code_a < code_b ) {
+		return ( -1 );
+	}
+	if ( code_a > code_b ) {
+		return ( 1 );
+	}
+	return ( 0 );
+}
+
+
+/*
+ * Reads the entire PROJ.4 EPSG database file into memory and sorts
+ * it by EPSG code. Each entry in the file has the form:
+ *
+ *   <code> +proj=... +no_defs  <>
+ *
+ * Comment lines (starting with '#') and malformed lines are skipped.
+ * This happens only once, so that all following lookups are binary
+ * searches instead of linear scans of the file.
+ *
+ * Caller must hold REPROJ_CACHE_LOCK.
+ */
+void reproj_epsg_index_load ( void )
+{
+	FILE *fp;
+	char line[REPROJ_EPSG_MAX_LINE_LEN];
+	int max_len = 0;
+
+
+	REPROJ_EPSG_INDEX_LOADED = TRUE;
+	if ( REPROJ_EPSG_PATH == NULL ) {
+		return;
+	}
+#ifdef MINGW
+	fp = t_fopen_utf8 ( REPROJ_EPSG_PATH, "rt" );
+#else
+	fp = t_fopen_utf8 ( REPROJ_EPSG_PATH, "r" );
+#endif
+	if ( fp == NULL ) {
+		return;
+	}
+
+	while ( fgets ( line, REPROJ_EPSG_MAX_LINE_LEN, fp ) != NULL ) {
+		char *start = line;
+		char *end = NULL;
+		while ( *start == ' ' || *start == '\t' ) {
+			start ++;
+		}
+		if ( *start != '<' ) {
+			continue; /* comment or empty line */
+		}
+		int code = (int) strtol ( start + 1, &end, 10 );
+		if ( end == start + 1 || *end != '>' ) {
+			continue;
+		}
+		start = end + 1;
+		/* definition ends with "<>" */
+		end = strstr ( start, "<>" );
+		if ( end == NULL ) {
+			continue;
+		}
+		while ( *start == ' ' || *start == '\t' ) {
+			start ++;
+		}
+		while ( end > start && ( *(end-1) == ' ' || *(end-1) == '\t' ) ) {
+			end --;
+		}
+		if ( end == start ) {
+			continue;
+		}
+		if ( REPROJ_EPSG_INDEX_LEN >= max_len ) {
+			max_len = ( max_len == 0 ) ? 1024 : max_len * 2;
+			REPROJ_EPSG_INDEX = realloc ( REPROJ_EPSG_INDEX, sizeof (reproj_epsg_entry) * max_len );
+		}
+		REPROJ_EPSG_INDEX[REPROJ_EPSG_INDEX_LEN].code = code;
+		REPROJ_EPSG_INDEX[REPROJ_EPSG_INDEX_LEN].def = malloc ( sizeof (char) * ( end - start + 1 ) );
+		strncpy ( REPROJ_EPSG_INDEX[REPROJ_EPSG_INDEX_LEN].def, start, end - start );
+		REPROJ_EPSG_INDEX[REPROJ_EPSG_INDEX_LEN].def[end - start] = '\0';
+		REPROJ_EPSG_INDEX_LEN ++;
+	}
+	fclose ( fp );
+
+	if ( REPROJ_EPSG_INDEX_LEN > 1 ) {
+		qsort ( REPROJ_EPSG_INDEX, REPROJ_EPSG_INDEX_LEN, sizeof (reproj_epsg_entry), reproj_epsg_compare );
+	}
+}
+
+
+/*
+ * Returns the PROJ.4 definition string for an EPSG code, as found
+ * in the PROJ.4 EPSG database file, or NULL if there is no such code
+ * (or no database). The returned string must not be modified or
+ * free'd by the caller. It remains valid until reproj_free_cache()
+ * is called.
+ */
+const char *reproj_epsg_lookup ( int code )
+{
+	reproj_epsg_entry key;
+	reproj_epsg_entry *found = NULL;
+
+
+	pthread_mutex_lock ( &REPROJ_CACHE_LOCK );
+	if ( REPROJ_EPSG_INDEX_LOADED == FALSE ) {
+		reproj_epsg_index_load ();
+	}
+	if ( REPROJ_EPSG_INDEX_LEN > 0 ) {
+		key.code = code;
+		found = bsearch ( &key, REPROJ_EPSG_INDEX, REPROJ_EPSG_INDEX_LEN, sizeof (reproj_epsg_entry), reproj_epsg_compare );
+	}
+	pthread_mutex_unlock ( &REPROJ_CACHE_LOCK );
+
+	if ( found == NULL ) {
+		return ( NULL );
+	}
+	return ( found->def );
+}
+
+
+/*
+ * Returns an SRS object initialized from a PROJ.4 definition string.
+ * Objects are cached by definition string, so repeated runs with the
+ * same SRS do not initialize PROJ.4 again.
+ *
+ * The returned object is owned by the cache: it must not be passed
+ * to pj_free(). It remains valid until reproj_free_cache() is called.
+ *
+ * Returns NULL on error (pj_errno is set by PROJ.4 in that case).
+ */
+projPJ reproj_pj_init ( const char *def )
+{
+	projPJ pj = NULL;
+	int i;
+
+
+	pthread_mutex_lock ( &REPROJ_CACHE_LOCK );
+	for ( i = 0; i < REPROJ_PJ_CACHE_LEN; i ++ ) {
+		if ( !strcmp ( REPROJ_PJ_CACHE[i].def, def ) ) {
+			pj = REPROJ_PJ_CACHE[i].pj;
+			break;
+		}
+	}
+	if ( pj == NULL ) {
+		pj = pj_init_plus ( def );
+		if ( pj != NULL ) {
+			REPROJ_PJ_CACHE = realloc ( REPROJ_PJ_CACHE, sizeof (reproj_pj_entry) * ( REPROJ_PJ_CACHE_LEN + 1 ) );
+			REPROJ_PJ_CACHE[REPROJ_PJ_CACHE_LEN].def = strdup ( def );
+			REPROJ_PJ_CACHE[REPROJ_PJ_CACHE_LEN].pj = pj;
+			REPROJ_PJ_CACHE_LEN ++;
+		}
+	}
+	pthread_mutex_unlock ( &REPROJ_CACHE_LOCK );
+
+	return ( pj );
+}
+
+
+/*
+ * Releases the EPSG index and all cached SRS objects.
+ * SRS objects obtained from reproj_pj_init() become invalid.
+ */
+void reproj_free_cache ( void )
+{
+	int i;
+
+
+	pthread_mutex_lock ( &REPROJ_CACHE_LOCK );
+	reproj_epsg_index_free ();
+	t_free ( REPROJ_EPSG_PATH );
+	REPROJ_EPSG_PATH = NULL;
+	for ( i = 0; i < REPROJ_PJ_CACHE_LEN; i ++ ) {
+		t_free ( REPROJ_PJ_CACHE[i].def );
+		pj_free ( REPROJ_PJ_CACHE[i].pj );
+	}
+	t_free ( REPROJ_PJ_CACHE );
+	REPROJ_PJ_CACHE = NULL;
+	REPROJ_PJ_CACHE_LEN = 0;
+	pthread_mutex_unlock ( &REPROJ_CACHE_LOCK );
+}
+
+
 /*
  *
  * Initalizes reprojection system and checks internal "database" for consistency.
@@ -85,6 +322,10 @@ void reproj_init( options *opts ) {
 				err_show ( ERR_WARN, _("\nPROJ.4 EPSG database file not found/readable. EPSG conversions might not be available.\nPROJ.4 EPSG path was: '%s'."),buf);
 				return;
 			}
+			fclose ( fp );
+			/* EPSG lookups will use an in-memory index of this file */
+			reproj_epsg_set_path ( buf );
+			t_free ( buf );
 		}
 		char **search_path;
 		search_path = malloc ( sizeof(char*) );
@@ -425,18 +666,23 @@ int reproj_parse_opts( options *opts ) {
 							err_show ( ERR_NOTE, "\n");
 							err_show ( ERR_WARN, _("\nConverted EPSG ID %i in SRS definition to PROJ.4 SRS string.\nConversion may incur loss of information. Please verify result."), code );
 						}
-						/* convert EPSG code to PROJ.4 string: '+init=epsg:nnnnn' */
+						/* convert EPSG code to PROJ.4 string: use the indexed EPSG database,
+						 * or let PROJ.4 resolve '+init=epsg:nnnnn' if the code is not in the index. */
 						t_free ( current );
+						const char *def = reproj_epsg_lookup ( code );
+						if ( def != NULL ) {
+							current = strdup ( def );
+						} else {
+							current = (char*) malloc(sizeof(char) * PRG_MAX_STR_LEN);
+							snprintf(current,PRG_MAX_STR_LEN,"+init=epsg:%i",code);
+						}
 						if ( i > 0 ) {
 							t_free (opts->proj_out); /* replace current SRS output string with EPSG code */
-							opts->proj_out = (char*) malloc(sizeof(char) * PRG_MAX_STR_LEN);
-							current = opts->proj_out;
+							opts->proj_out = current;
 						} else {
 							t_free (opts->proj_in); /* replace current SRS input string with EPSG code */
-							opts->proj_in = (char*) malloc(sizeof(char) * PRG_MAX_STR_LEN);
-							current = opts->proj_in;
+							opts->proj_in = current;
 						}
-						snprintf(current,PRG_MAX_STR_LEN,"+init=epsg:%i",code);
 						if ( code == 3857 ) {
 							/* If we have a Web Mercator system then we need to remember that! */
 							if ( i > 0 ) {
@@ -468,7 +714,7 @@ int reproj_parse_opts( options *opts ) {
 	/* Expand SRS definitions into full, explicit PROJ.4 strings */
 	if ( opts->proj_in != NULL ) {
 		projPJ pj_in;
-		if (!(pj_in = pj_init_plus((const char*)opts->proj_in)) ) {
+		if (!(pj_in = reproj_pj_init((const char*)opts->proj_in)) ) {
 			err_show ( ERR_EXIT, _("\nInvalid input SRS definition.\nPROJ.4 message: %s"),
 					pj_strerrno( pj_errno ) );
 			return(REPROJ_STATUS_ERROR);
@@ -479,11 +725,10 @@ int reproj_parse_opts( options *opts ) {
 			opts->proj_in = tmp;
 			err_show (ERR_NOTE,_("\nInput SRS (expanded): '%s'"), opts->proj_in);
 		}
-		pj_free (pj_in);
 	}
 	if ( opts->proj_out != NULL ) {
 		projPJ pj_out;
-		if (!(pj_out = pj_init_plus((const char*)opts->proj_out)) ) {
+		if (!(pj_out = reproj_pj_init((const char*)opts->proj_out)) ) {
 			err_show ( ERR_EXIT, _("\nInvalid output SRS definition.\nPROJ.4 message: %s"),
 					pj_strerrno( pj_errno ) );
 			return(REPROJ_STATUS_ERROR);
@@ -494,7 +739,6 @@ int reproj_parse_opts( options *opts ) {
 			opts->proj_out = tmp;
 			err_show (ERR_NOTE,_("Output SRS (expanded): '%s'"), opts->proj_out);
 		}
-		pj_free (pj_out);
 	}
 
 	/* DEBUG */
@@ -768,7 +1012,7 @@ int reproj_parse_opts( options *opts ) {
 
 	/* convert final SRS strings to PROJ.4 structs */
 	if ( srs_in_final != NULL ) {
-		if (!(opts->proj4_in = pj_init_plus((const char*)srs_in_final) )) {
+		if (!(opts->proj4_in = reproj_pj_init((const char*)srs_in_final) )) {
 			t_free (towgs84_str);
 			t_free (nadgrids_str);
 			t_free (srs_in_final);
@@ -778,7 +1022,7 @@ int reproj_parse_opts( options *opts ) {
 		}
 	}
 	if ( srs_out_final != NULL ) {
-		if (!(opts->proj4_out = pj_init_plus((const char*)srs_out_final) )) {
+		if (!(opts->proj4_out = reproj_pj_init((const char*)srs_out_final) )) {
 			t_free (towgs84_str);
 			t_free (nadgrids_str);
 			t_free (srs_in_final);
@@ -915,6 +1159,37 @@ BOOLEAN reproj_srs_out_latlon ( options *opts ) {
 }
 
 
+/*
+ * Checks if the output SRS currently in use is Web Mercator
+ * (EPSG:3857), i.e. a Mercator projection on a sphere with the
+ * semi-major axis of WGS 84 as radius.
+ * Returns TRUE if so, FALSE otherwise.
+ *
+ * NOTE: reproj_parse_opts() must have run before this!
+ */
+BOOLEAN reproj_srs_out_web ( options *opts ) {
+	BOOLEAN result = FALSE;
+	char *def;
+
+	if ( opts == NULL || opts->proj4_out == NULL ) {
+		return ( FALSE );
+	}
+	def = pj_get_def ( opts->proj4_out, 0 );
+	if ( def != NULL ) {
+		/* make sure that each token is followed by a blank */
+		char *tokens = malloc ( sizeof (char) * ( strlen ( def ) + 2 ) );
+		sprintf ( tokens, "%s ", def );
+		if ( strstr ( tokens, "+proj=merc " ) != NULL &&
+				strstr ( tokens, "+a=6378137 " ) != NULL && strstr ( tokens, "+b=6378137 " ) != NULL ) {
+			result = TRUE;
+		}
+		free ( tokens );
+		pj_dalloc ( def );
+	}
+	return ( result );
+}
+
+
 /*
  * Converts a value from degrees to radians.
  */
@@ -1097,6 +1372,688 @@ void reproj_update_extent(geom_store *gs) {
 }
 
 
+/*
+ * Transforms a single coordinate tuple in-place, using PROJ.4 and
+ * the SRS objects of "job". "Z" may be NULL.
+ *
+ * Returns the PROJ.4 error code (0 = no error).
+ */
+int reproj_do_point_exact ( reproj_job *job, double *X, double *Y, double *Z )
+{
+	if ( job->in_latlon == TRUE ) {
+		/* pj_transform() expects lat/lon data to be in radians */
+		*X = reproj_deg_to_rad (*X);
+		*Y = reproj_deg_to_rad (*Y);
+	}
+	int error = pj_transform( job->proj4_in, job->proj4_out, 1, 1, X, Y, Z);
+	if ( error != 0 ) {
+		return ( error );
+	}
+	if ( job->out_latlon == TRUE ) {
+		/* pj_transform() has produced lat/lon data in radians */
+		*X = reproj_rad_to_deg (*X);
+		*Y = reproj_rad_to_deg (*Y);
+	}
+	return ( 0 );
+}
+
+
+/*
+ * Helper function for reproj_approx_point() and reproj_approx_refine():
+ * Interpolates transformed coordinates within a cell: bilinear in X/Y
+ * on both height levels, then linear between the levels.
+ * Input coordinate "z" is ignored if the grid has only one level.
+ */
+void reproj_approx_interpolate ( reproj_approx *approx, reproj_approx_cell *cell,
+		double x, double y, double z, double *X, double *Y, double *Z )
+{
+	double u = ( x - cell->x1 ) / ( cell->x2 - cell->x1 );
+	double v = ( y - cell->y1 ) / ( cell->y2 - cell->y1 );
+	double w[4];
+	double iX[2], iY[2], iZ[2];
+	double t = 0.0;
+	int l, k;
+
+	w[0] = ( 1.0 - u ) * ( 1.0 - v );
+	w[1] = u * ( 1.0 - v );
+	w[2] = u * v;
+	w[3] = ( 1.0 - u ) * v;
+	for ( l = 0; l < approx->num_levels; l ++ ) {
+		iX[l] = 0.0;
+		iY[l] = 0.0;
+		iZ[l] = 0.0;
+		for ( k = 0; k < 4; k ++ ) {
+			iX[l] += w[k] * cell->X[l][k];
+			iY[l] += w[k] * cell->Y[l][k];
+			iZ[l] += w[k] * cell->Z[l][k];
+		}
+	}
+
+	if ( approx->num_levels < 2 ) {
+		*X = iX[0];
+		*Y = iY[0];
+		*Z = iZ[0];
+		return;
+	}
+
+	t = ( z - approx->z[0] ) / ( approx->z[1] - approx->z[0] );
+	*X = iX[0] + t * ( iX[1] - iX[0] );
+	*Y = iY[0] + t * ( iY[1] - iY[0] );
+	*Z = iZ[0] + t * ( iZ[1] - iZ[0] );
+}
+
+
+/*
+ * Helper function for reproj_approx_create() and reproj_approx_refine():
+ * Exactly transforms point "x/y" at all height levels of the grid and
+ * stores the results in "X/Y/Z[level][idx]".
+ *
+ * Returns the PROJ.4 error code (0 = no error).
+ */
+int reproj_approx_eval ( reproj_job *job, reproj_approx *approx, double x, double y,
+		double X[2][9], double Y[2][9], double Z[2][9], int idx )
+{
+	int l;
+
+	for ( l = 0; l < approx->num_levels; l ++ ) {
+		X[l][idx] = x;
+		Y[l][idx] = y;
+		Z[l][idx] = approx->z[l];
+		int error = reproj_do_point_exact ( job, &X[l][idx], &Y[l][idx], &Z[l][idx] );
+		if ( error != 0 ) {
+			return ( error );
+		}
+	}
+
+	return ( 0 );
+}
+
+
+/*
+ * Helper function for reproj_approx_create():
+ * Creates a new cell with the given bounds and (already transformed)
+ * corner coordinates, taken from positions "c0..c3" of "X/Y/Z".
+ * Corner order: lower left, lower right, upper right, upper left.
+ */
+reproj_approx_cell *reproj_approx_cell_create ( double x1, double y1, double x2, double y2,
+		double X[2][9], double Y[2][9], double Z[2][9], int c0, int c1, int c2, int c3 )
+{
+	reproj_approx_cell *cell = malloc ( sizeof (reproj_approx_cell) );
+	int corner[4];
+	int l, k;
+
+	corner[0] = c0; corner[1] = c1; corner[2] = c2; corner[3] = c3;
+	cell->x1 = x1;
+	cell->y1 = y1;
+	cell->x2 = x2;
+	cell->y2 = y2;
+	for ( k = 0; k < 4; k ++ ) {
+		for ( l = 0; l < 2; l ++ ) {
+			cell->X[l][k] = X[l][corner[k]];
+			cell->Y[l][k] = Y[l][corner[k]];
+			cell->Z[l][k] = Z[l][corner[k]];
+		}
+		cell->child[k] = NULL;
+	}
+	cell->exact = FALSE;
+
+	return ( cell );
+}
+
+
+/*
+ * Helper function for reproj_approx_refine():
+ * Returns TRUE if interpolation at "x/y/z" is within the error limits,
+ * when compared to the exactly transformed "eX/eY/eZ". Updates "err_max".
+ */
+BOOLEAN reproj_approx_check ( reproj_approx *approx, reproj_approx_cell *cell,
+		double x, double y, double z, double eX, double eY, double eZ, double *err_max )
+{
+	double iX, iY, iZ;
+
+	reproj_approx_interpolate ( approx, cell, x, y, z, &iX, &iY, &iZ );
+	double err_xy = sqrt ( ( iX - eX ) * ( iX - eX ) + ( iY - eY ) * ( iY - eY ) );
+	if ( err_xy > *err_max ) {
+		*err_max = err_xy;
+	}
+
+	return ( err_xy <= approx->max_err_xy && fabs ( iZ - eZ ) <= approx->max_err_z );
+}
+
+
+/*
+ * Helper function for reproj_approx_create():
+ * Checks how well interpolation within "cell" matches the exact
+ * transformation at the cell's center and edge midpoints (on all height
+ * levels, plus the center at medium height). If the error exceeds the
+ * limits, the cell is split into four sub-cells, which are then checked
+ * recursively. The corners of the sub-cells are exactly the points that
+ * have just been tested, so no transformation is wasted.
+ *
+ * Cells that cannot be approximated (max. depth or cell count reached,
+ * or PROJ.4 error at a test point) are flagged for exact transformation.
+ */
+void reproj_approx_refine ( reproj_job *job, reproj_approx *approx, reproj_approx_cell *cell, int depth )
+{
+	/* 9 points: 4 corners, then midpoints of bottom, right, top and left edges, then center */
+	double x[9], y[9];
+	double X[2][9], Y[2][9], Z[2][9];
+	double cx = ( cell->x1 + cell->x2 ) / 2.0;
+	double cy = ( cell->y1 + cell->y2 ) / 2.0;
+	double err_cell = 0.0;
+	BOOLEAN fits = TRUE;
+	int l, k;
+
+	for ( k = 0; k < 4; k ++ ) {
+		for ( l = 0; l < 2; l ++ ) {
+			X[l][k] = cell->X[l][k];
+			Y[l][k] = cell->Y[l][k];
+			Z[l][k] = cell->Z[l][k];
+		}
+	}
+	x[4] = cx;			y[4] = cell->y1;
+	x[5] = cell->x2;	y[5] = cy;
+	x[6] = cx;			y[6] = cell->y2;
+	x[7] = cell->x1;	y[7] = cy;
+	x[8] = cx;			y[8] = cy;
+
+	for ( k = 4; k < 9; k ++ ) {
+		if ( reproj_approx_eval ( job, approx, x[k], y[k], X, Y, Z, k ) != 0 ) {
+			/* cannot check this cell */
+			cell->exact = TRUE;
+			approx->num_cells ++;
+			approx->num_exact ++;
+			return;
+		}
+		for ( l = 0; l < approx->num_levels; l ++ ) {
+			if ( reproj_approx_check ( approx, cell, x[k], y[k], approx->z[l],
+					X[l][k], Y[l][k], Z[l][k], &err_cell ) == FALSE ) {
+				fits = FALSE;
+			}
+		}
+	}
+
+	if ( approx->num_levels > 1 ) {
+		/* check linearity between levels at the center */
+		double zm = ( approx->z[0] + approx->z[1] ) / 2.0;
+		double eX = cx;
+		double eY = cy;
+		double eZ = zm;
+		if ( reproj_do_point_exact ( job, &eX, &eY, &eZ ) != 0 ||
+				reproj_approx_check ( approx, cell, cx, cy, zm, eX, eY, eZ, &err_cell ) == FALSE ) {
+			fits = FALSE;
+		}
+	}
+
+	if ( fits == TRUE && depth >= REPROJ_APPROX_MIN_DEPTH ) {
+		/* good enough: leaf cell */
+		approx->num_cells ++;
+		if ( err_cell > approx->err_found ) {
+			approx->err_found = err_cell;
+		}
+		return;
+	}
+
+	if ( depth >= REPROJ_APPROX_MAX_DEPTH || approx->num_cells + 4 > REPROJ_APPROX_MAX_CELLS ) {
+		/* give up refining: use exact transformation within this cell */
+		cell->exact = TRUE;
+		approx->num_cells ++;
+		approx->num_exact ++;
+		return;
+	}
+
+	/* split into four sub-cells (same order as corners) */
+	cell->child[0] = reproj_approx_cell_create ( cell->x1, cell->y1, cx, cy, X, Y, Z, 0, 4, 8, 7 );
+	cell->child[1] = reproj_approx_cell_create ( cx, cell->y1, cell->x2, cy, X, Y, Z, 4, 1, 5, 8 );
+	cell->child[2] = reproj_approx_cell_create ( cx, cy, cell->x2, cell->y2, X, Y, Z, 8, 5, 2, 6 );
+	cell->child[3] = reproj_approx_cell_create ( cell->x1, cy, cx, cell->y2, X, Y, Z, 7, 8, 6, 3 );
+	for ( k = 0; k < 4; k ++ ) {
+		reproj_approx_refine ( job, approx, cell->child[k], depth + 1 );
+	}
+}
+
+
+/*
+ * Releases a cell of the approximation grid and all its sub-cells.
+ */
+void reproj_approx_cell_destroy ( reproj_approx_cell *cell )
+{
+	int k;
+
+	if ( cell == NULL ) {
+		return;
+	}
+	for ( k = 0; k < 4; k ++ ) {
+		reproj_approx_cell_destroy ( cell->child[k] );
+	}
+	free ( cell );
+}
+
+
+/*
+ * Releases an approximation grid.
+ */
+void reproj_approx_destroy ( reproj_approx *approx )
+{
+	if ( approx == NULL ) {
+		return;
+	}
+	reproj_approx_cell_destroy ( approx->root );
+	free ( approx );
+}
+
+
+/*
+ * Creates an adaptive grid for approximate reprojection of all data within
+ * the extent of "gs". The exact transformation is evaluated (using the
+ * PROJ.4 objects of "job") on the grid nodes, and coordinates in between
+ * are interpolated bilinearly. Grid cells are refined until the error at
+ * their test points (edge midpoints and center) is below "opts->proj_approx"
+ * (horizontal and vertical; for lat/lon output, the horizontal error is
+ * converted from metres to degrees).
+ *
+ * Since datum transformations also depend on the height, the grid has two
+ * levels: the lowest and the highest Z value in the data (including 0, which
+ * is used for label points). Heights in between are interpolated linearly.
+ *
+ * Returns the new grid or NULL if no approximation is possible (degenerate
+ * extent or PROJ.4 error at a corner), in which case exact reprojection
+ * must be used.
+ */
+reproj_approx *reproj_approx_create ( reproj_job *job, geom_store *gs, options *opts )
+{
+	reproj_approx *approx;
+	double X[2][9], Y[2][9], Z[2][9];
+
+	if ( gs->max_x <= gs->min_x || gs->max_y <= gs->min_y ) {
+		return ( NULL );
+	}
+
+	approx = malloc ( sizeof (reproj_approx) );
+	approx->z[0] = gs->min_z < 0.0 ? gs->min_z : 0.0;
+	approx->z[1] = gs->max_z > 0.0 ? gs->max_z : 0.0;
+	approx->num_levels = ( approx->z[1] > approx->z[0] ) ? 2 : 1;
+	approx->max_err_xy = opts->proj_approx;
+	if ( reproj_srs_out_latlon(opts) == TRUE ) {
+		approx->max_err_xy = opts->proj_approx / REPROJ_APPROX_METRES_PER_DEG;
+	}
+	approx->max_err_z = opts->proj_approx;
+	approx->err_found = 0.0;
+	approx->num_cells = 0;
+	approx->num_exact = 0;
+	approx->root = NULL;
+
+	/* transform corners */
+	memset ( X, 0, sizeof (X) );
+	memset ( Y, 0, sizeof (Y) );
+	memset ( Z, 0, sizeof (Z) );
+	if (	reproj_approx_eval ( job, approx, gs->min_x, gs->min_y, X, Y, Z, 0 ) != 0 ||
+			reproj_approx_eval ( job, approx, gs->max_x, gs->min_y, X, Y, Z, 1 ) != 0 ||
+			reproj_approx_eval ( job, approx, gs->max_x, gs->max_y, X, Y, Z, 2 ) != 0 ||
+			reproj_approx_eval ( job, approx, gs->min_x, gs->max_y, X, Y, Z, 3 ) != 0 ) {
+		free ( approx );
+		return ( NULL );
+	}
+
+	approx->root = reproj_approx_cell_create ( gs->min_x, gs->min_y, gs->max_x, gs->max_y,
+			X, Y, Z, 0, 1, 2, 3 );
+	reproj_approx_refine ( job, approx, approx->root, 0 );
+
+	return ( approx );
+}
+
+
+/*
+ * Transforms a single coordinate tuple in-place, using the approximation
+ * grid. If "Z" is NULL, then the point is taken to be at height 0, as
+ * with exact transformation.
+ *
+ * Returns TRUE on success, FALSE if the coordinates lie outside the grid
+ * or within a cell that requires exact transformation.
+ */
+BOOLEAN reproj_approx_point ( reproj_approx *approx, double *X, double *Y, double *Z )
+{
+	reproj_approx_cell *cell = approx->root;
+	double z = 0.0;
+	double iZ;
+
+	if ( *X < cell->x1 || *X > cell->x2 || *Y < cell->y1 || *Y > cell->y2 ) {
+		return ( FALSE );
+	}
+	if ( Z != NULL ) {
+		z = *Z;
+	}
+	if ( z < approx->z[0] || z > approx->z[1] ) {
+		return ( FALSE );
+	}
+	while ( cell->child[0] != NULL ) {
+		double cx = ( cell->x1 + cell->x2 ) / 2.0;
+		double cy = ( cell->y1 + cell->y2 ) / 2.0;
+		if ( *Y < cy ) {
+			cell = ( *X < cx ) ? cell->child[0] : cell->child[1];
+		} else {
+			cell = ( *X < cx ) ? cell->child[3] : cell->child[2];
+		}
+	}
+	if ( cell->exact == TRUE ) {
+		return ( FALSE );
+	}
+
+	reproj_approx_interpolate ( approx, cell, *X, *Y, z, X, Y, &iZ );
+	if ( Z != NULL ) {
+		*Z = iZ;
+	}
+
+	return ( TRUE );
+}
+
+
+/*
+ * Helper function for reproj_do_job():
+ * Transforms a single coordinate tuple in-place. "Z" may be NULL.
+ * Uses the approximation grid of the job, if there is one, and
+ * exact transformation otherwise.
+ *
+ * Returns the PROJ.4 error code (0 = no error).
+ */
+int reproj_do_point ( reproj_job *job, double *X, double *Y, double *Z )
+{
+	if ( job->approx != NULL && reproj_approx_point ( job->approx, X, Y, Z ) == TRUE ) {
+		return ( 0 );
+	}
+	return ( reproj_do_point_exact ( job, X, Y, Z ) );
+}
+
+
+/*
+ * Helper function for reproj_do_job():
+ * Transforms all vertices of a line or polygon part in-place,
+ * and then its label point (if any).
+ *
+ * Returns the PROJ.4 error code (0 = no error). If there is
+ * an error, then "label_failed" will be set to TRUE if it
+ * occurred while transforming the label point.
+ */
+int reproj_do_part ( reproj_job *job, geom_part *part, BOOLEAN *label_failed )
+{
+	*label_failed = FALSE;
+	if ( job->approx != NULL ) {
+		/* approximate: vertex by vertex */
+		int i;
+		for ( i=0; i < part->num_vertices; i ++ ) {
+			int error = reproj_do_point ( job, &part->X[i], &part->Y[i], &part->Z[i] );
+			if ( error != 0 ) {
+				return ( error );
+			}
+		}
+		if ( part->has_label == TRUE ) {
+			int error = reproj_do_point ( job, &part->label_x, &part->label_y, NULL );
+			if ( error != 0 ) {
+				*label_failed = TRUE;
+				return ( error );
+			}
+		}
+		return ( 0 );
+	}
+	if ( job->in_latlon == TRUE ) {
+		/* pj_transform() expects lat/lon data to be in radians */
+		reproj_deg_to_rad_part(part);
+	}
+	int error = pj_transform( job->proj4_in, job->proj4_out, part->num_vertices, 1,
+			part->X, part->Y, part->Z );
+	if ( error != 0 ) {
+		return ( error );
+	}
+	if ( job->out_latlon == TRUE ) {
+		/* pj_transform() has produced lat/lon data in radians */
+		reproj_rad_to_deg_part(part);
+	}
+	if ( part->has_label == TRUE ) {
+		/* also transform label point (if any) */
+		error = reproj_do_point ( job, &part->label_x, &part->label_y, NULL );
+		if ( error != 0 ) {
+			*label_failed = TRUE;
+			return ( error );
+		}
+	}
+	return ( 0 );
+}
+
+
+/*
+ * Worker function for reproj_do(): Reprojects all objects of type
+ * job->geom_type with indices job->first .. job->last-1.
+ *
+ * This runs in its own thread, using only the PROJ.4 context and
+ * SRS objects stored in the job. It does not produce any messages.
+ * Processing stops at the first error, which is recorded in the job.
+ */
+void *reproj_do_job ( void *arg )
+{
+	reproj_job *job = (reproj_job*) arg;
+	geom_store *gs = job->gs;
+	int i;
+
+	job->error = 0;
+	for ( i = job->first; i < job->last && job->error == 0; i ++ ) {
+		if ( job->geom_type == GEOM_TYPE_POINT || job->geom_type == GEOM_TYPE_POINT_RAW ) {
+			geom_store_point *point = &gs->points[i];
+			if ( job->geom_type == GEOM_TYPE_POINT_RAW ) {
+				point = &gs->points_raw[i];
+			}
+			job->error = reproj_do_point ( job, &point->X, &point->Y, &point->Z );
+			if ( job->error == 0 && point->has_label == TRUE ) {
+				/* also transform label point (if any) */
+				job->error = reproj_do_point ( job, &point->label_x, &point->label_y, NULL );
+				job->error_label = ( job->error != 0 );
+			}
+			job->error_obj = i;
+		} else {
+			int num_parts = 0;
+			geom_part *parts = NULL;
+			if ( job->geom_type == GEOM_TYPE_LINE ) {
+				num_parts = gs->lines[i].num_parts;
+				parts = gs->lines[i].parts;
+			} else {
+				num_parts = gs->polygons[i].num_parts;
+				parts = gs->polygons[i].parts;
+			}
+			int j;
+			for ( j=0; j < num_parts && job->error == 0; j ++ ) {
+				job->error = reproj_do_part ( job, &parts[j], &job->error_label );
+				job->error_obj = i;
+				job->error_part = j;
+			}
+		}
+	}
+
+	return ( NULL );
+}
+
+
+/*
+ * Helper function for reproj_do():
+ * Returns the number of vertices in a line or polygon. This is used
+ * as a measure of the work load when splitting objects into jobs.
+ */
+int reproj_get_num_vertices ( geom_store *gs, int geom_type, int idx )
+{
+	int num_vertices = 0;
+	int num_parts;
+	geom_part *parts;
+	int j;
+
+	if ( geom_type == GEOM_TYPE_LINE ) {
+		num_parts = gs->lines[idx].num_parts;
+		parts = gs->lines[idx].parts;
+	} else {
+		num_parts = gs->polygons[idx].num_parts;
+		parts = gs->polygons[idx].parts;
+	}
+	for ( j=0; j < num_parts; j ++ ) {
+		num_vertices += parts[j].num_vertices;
+	}
+
+	return ( num_vertices );
+}
+
+
+/*
+ * Helper function for reproj_do():
+ * Splits all "num_objs" objects of type "geom_type" into "num_jobs" consecutive
+ * ranges of similar work load, runs the jobs in parallel and checks for errors.
+ *
+ * Returns the index of the (first) job that failed, or -1 if all went well.
+ */
+int reproj_do_parallel ( reproj_job *jobs, int num_jobs, geom_store *gs, int geom_type, int num_objs )
+{
+	int i;
+
+	if ( num_jobs > num_objs ) {
+		num_jobs = num_objs;
+	}
+
+	if ( geom_type == GEOM_TYPE_LINE || geom_type == GEOM_TYPE_POLY ) {
+		/* split by number of vertices */
+		double total = 0.0;
+		for ( i=0; i < num_objs; i ++ ) {
+			total += (double) reproj_get_num_vertices ( gs, geom_type, i );
+		}
+		double sum = 0.0;
+		int job = 0;
+		jobs[0].first = 0;
+		for ( i=0; i < num_objs; i ++ ) {
+			sum += (double) reproj_get_num_vertices ( gs, geom_type, i );
+			if ( job < num_jobs-1 && sum >= ( total * (double)(job+1) ) / (double) num_jobs ) {
+				jobs[job].last = i+1;
+				job ++;
+				jobs[job].first = i+1;
+			}
+		}
+		jobs[job].last = num_objs;
+		num_jobs = job+1;
+	} else {
+		/* split by number of points */
+		for ( i=0; i < num_jobs; i ++ ) {
+			jobs[i].first = (int) (( (long) num_objs * i ) / num_jobs);
+			jobs[i].last = (int) (( (long) num_objs * (i+1) ) / num_jobs);
+		}
+	}
+
+	for ( i=0; i < num_jobs; i ++ ) {
+		jobs[i].gs = gs;
+		jobs[i].geom_type = geom_type;
+		jobs[i].error = 0;
+		jobs[i].error_obj = 0;
+		jobs[i].error_part = 0;
+		jobs[i].error_label = FALSE;
+	}
+
+	t_thread_run ( reproj_do_job, jobs, num_jobs, sizeof (reproj_job) );
+
+	/* jobs cover consecutive ranges: the first failed job has the first failed object */
+	for ( i=0; i < num_jobs; i ++ ) {
+		if ( jobs[i].error != 0 ) {
+			return ( i );
+		}
+	}
+
+	return ( -1 );
+}
+
+
+/*
+ * Helper function for reproj_do():
+ * Releases all private PROJ.4 objects held by the jobs, then the
+ * jobs array itself. Jobs without a private context use the SRS
+ * objects in the program options, which are left untouched.
+ */
+void reproj_free_jobs ( reproj_job *jobs, int num_jobs )
+{
+	int i;
+	for ( i=0; i < num_jobs; i ++ ) {
+		if ( jobs[i].ctx != NULL ) {
+			if ( jobs[i].proj4_in != NULL ) {
+				pj_free ( jobs[i].proj4_in );
+			}
+			if ( jobs[i].proj4_out != NULL ) {
+				pj_free ( jobs[i].proj4_out );
+			}
+			pj_ctx_free ( jobs[i].ctx );
+		}
+	}
+	free ( jobs );
+}
+
+
+/*
+ * Helper function for reproj_do():
+ * Creates up to "num_jobs" reprojection jobs, each with its own PROJ.4
+ * context and its own copies of the input and output SRS.
+ *
+ * Returns the number of jobs that could be created (at least 1). If
+ * no private SRS could be created at all, then the only job will use
+ * the SRS objects in "opts" (and the default PROJ.4 context).
+ */
+int reproj_create_jobs ( options *opts, reproj_job **jobs_out, int num_jobs )
+{
+	reproj_job *jobs;
+	char *def_in;
+	char *def_out;
+	int i;
+
+	if ( num_jobs < 1 ) {
+		num_jobs = 1;
+	}
+
+	jobs = calloc ( num_jobs, sizeof (reproj_job) );
+	def_in = pj_get_def ( opts->proj4_in, 0 );
+	def_out = pj_get_def ( opts->proj4_out, 0 );
+	for ( i=0; i < num_jobs; i ++ ) {
+		jobs[i].in_latlon = reproj_srs_in_latlon(opts);
+		jobs[i].out_latlon = reproj_srs_out_latlon(opts);
+		jobs[i].ctx = pj_ctx_alloc ();
+		if ( jobs[i].ctx != NULL && def_in != NULL && def_out != NULL ) {
+			jobs[i].proj4_in = pj_init_plus_ctx ( jobs[i].ctx, def_in );
+			jobs[i].proj4_out = pj_init_plus_ctx ( jobs[i].ctx, def_out );
+		}
+		if ( jobs[i].proj4_in == NULL || jobs[i].proj4_out == NULL ) {
+			/* cannot create more private copies: use what we have */
+			if ( jobs[i].proj4_in != NULL ) {
+				pj_free ( jobs[i].proj4_in );
+			}
+			if ( jobs[i].proj4_out != NULL ) {
+				pj_free ( jobs[i].proj4_out );
+			}
+			if ( jobs[i].ctx != NULL ) {
+				pj_ctx_free ( jobs[i].ctx );
+			}
+			jobs[i].ctx = NULL;
+			jobs[i].proj4_in = NULL;
+			jobs[i].proj4_out = NULL;
+			break;
+		}
+	}
+	if ( def_in != NULL ) {
+		pj_dalloc ( def_in );
+	}
+	if ( def_out != NULL ) {
+		pj_dalloc ( def_out );
+	}
+
+	if ( i == 0 ) {
+		/* fall back to shared SRS objects (single thread) */
+		err_show ( ERR_NOTE, _("\nCould not create private PROJ.4 contexts. Reprojecting in a single thread.") );
+		jobs[0].proj4_in = opts->proj4_in;
+		jobs[0].proj4_out = opts->proj4_out;
+		i = 1;
+	}
+
+	*jobs_out = jobs;
+	return ( i );
+}
+
+
 /*
  * Performs reprojection. User _must_ call reproj_parst_opts()
  * prior to this function to ensure that SRS strings and datum
@@ -1105,6 +2062,15 @@ void reproj_update_extent(geom_store *gs) {
  * Reprojection is done using PROJ.4' pj_transform():
  * https://github.com/OSGeo/proj.4/wiki/pj_transform
  *
+ * The work is split into up to "opts->threads" parallel jobs per
+ * geometry type. Each job runs in its own thread and uses its own
+ * PROJ.4 context (projCtx), as required for thread-safe use of
+ * PROJ.4. Results are identical to those of sequential processing.
+ *
+ * If "opts->proj_approx" is > 0, then coordinates are interpolated
+ * from an adaptive grid of exactly transformed points instead (see
+ * reproj_approx_create()).
+ *
  * Return values:
  *   1 = No error and reprojection performed (=REPROJ_STATUS_OK)
  *   0 = No error, but also no reprojection performed (=REPROJ_STATUS_NONE)
@@ -1112,223 +2078,114 @@ void reproj_update_extent(geom_store *gs) {
  */
 int reproj_do( options *opts, geom_store *gs ) {
 
+	reproj_job *jobs = NULL;
+	reproj_approx *approx = NULL;
+	reproj_job fail;
+	int num_jobs = 0;
+	int failed = -1;
+	int i;
+
 	if ( gs == NULL || gs->is_empty == TRUE ) {
 		err_show ( ERR_WARN, _("\nEmpty or missing geometry store. Reprojection skipped.") );
 		return (REPROJ_STATUS_NONE);
 	}
 
+	num_jobs = reproj_create_jobs ( opts, &jobs, opts->threads );
+
+	/* set up approximation grid (if requested) */
+	if ( opts->proj_approx > 0.0 ) {
+		approx = reproj_approx_create ( &jobs[0], gs, opts );
+		if ( approx == NULL ) {
+			err_show ( ERR_NOTE, _("\nCannot set up approximate reprojection for this data. Using exact reprojection.") );
+		} else {
+			err_show ( ERR_NOTE, _("\nApproximate reprojection: %i grid cells (%i with exact reprojection).\nMax. error at grid test points: %f (limit: %f)."),
+					approx->num_cells, approx->num_exact, approx->err_found, approx->max_err_xy );
+		}
+		for ( i=0; i < num_jobs; i ++ ) {
+			jobs[i].approx = approx;
+		}
+	}
+
 	/* POINTS */
 	if ( gs->num_points > 0 ) {
 		err_show ( ERR_NOTE, _("\nReprojecting %i points in current geometry store."), gs->num_points );
-		int i;
-		for ( i=0; i < gs->num_points; i ++ ) {
-			double X[1];
-			double Y[1];
-			double Z[1];
-			X[0] = gs->points[i].X;
-			Y[0] = gs->points[i].Y;
-			Z[0] = gs->points[i].Z;
-			if ( reproj_srs_in_latlon(opts) ) {
-				/* pj_transform() expects lat/lon data to be in radians */
-				X[0] = reproj_deg_to_rad (X[0]);
-				Y[0] = reproj_deg_to_rad (Y[0]);
-			}
-			int error = pj_transform( opts->proj4_in, opts->proj4_out, 1, 1, X, Y, Z);
-			if ( error != 0 ) {
-				err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-				err_show ( ERR_EXIT, _("\nReprojection failed at point #%i."), i+1);
-				return (REPROJ_STATUS_ERROR);
-			}
-			if ( reproj_srs_out_latlon(opts) ) {
-				/* pj_transform() has produced lat/lon data in radians */
-				X[0] = reproj_rad_to_deg (X[0]);
-				Y[0] = reproj_rad_to_deg (Y[0]);
-			}
-			/* re-write point coordinates from reprojected values */
-			gs->points[i].X = X[0];
-			gs->points[i].Y = Y[0];
-			gs->points[i].Z = Z[0];
-			if ( gs->points[i].has_label == TRUE ) {
-				/* also transform label point (if any) */
-				double X[1];
-				double Y[1];
-				X[0] = gs->points[i].label_x;
-				Y[0] = gs->points[i].label_y;
-				if ( reproj_srs_in_latlon(opts) ) {
-					X[0] = reproj_deg_to_rad (X[0]);
-					Y[0] = reproj_deg_to_rad (Y[0]);
-				}
-				int error = pj_transform( opts->proj4_in, opts->proj4_out, 1, 1, X, Y, NULL);
-				if ( error != 0 ) {
-					err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-					err_show ( ERR_EXIT, _("\nReprojection of label point failed at point #%i."), i+1);
-					return (REPROJ_STATUS_ERROR);
-				}
-				if ( reproj_srs_out_latlon(opts) ) {
-					X[0] = reproj_rad_to_deg (X[0]);
-					Y[0] = reproj_rad_to_deg (Y[0]);
-				}
-				gs->points[i].label_x = X[0];
-				gs->points[i].label_y = Y[0];
+		failed = reproj_do_parallel ( jobs, num_jobs, gs, GEOM_TYPE_POINT, gs->num_points );
+		if ( failed >= 0 ) {
+			/* release first: err_show() does not return in a library context */
+			fail = jobs[failed];
+			reproj_free_jobs ( jobs, num_jobs );
+			reproj_approx_destroy ( approx );
+			err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(fail.error));
+			if ( fail.error_label == TRUE ) {
+				err_show ( ERR_EXIT, _("\nReprojection of label point failed at point #%i."), fail.error_obj+1);
+			} else {
+				err_show ( ERR_EXIT, _("\nReprojection failed at point #%i."), fail.error_obj+1);
 			}
+			return (REPROJ_STATUS_ERROR);
 		}
 	}
 
 	/* RAW POINTS */
 	if ( gs->num_points_raw > 0 ) {
 		err_show ( ERR_NOTE, _("\nReprojecting %i raw vertices in current geometry store."), gs->num_points_raw );
-		int i;
-		for ( i=0; i < gs->num_points_raw; i ++ ) {
-			double X[1];
-			double Y[1];
-			double Z[1];
-			X[0] = gs->points_raw[i].X;
-			Y[0] = gs->points_raw[i].Y;
-			Z[0] = gs->points_raw[i].Z;
-			if ( reproj_srs_in_latlon(opts) ) {
-				/* pj_transform() expects lat/lon data to be in radians */
-				X[0] = reproj_deg_to_rad (X[0]);
-				Y[0] = reproj_deg_to_rad (Y[0]);
-			}
-			int error = pj_transform( opts->proj4_in, opts->proj4_out, 1, 1, X, Y, Z);
-			if ( error != 0 ) {
-				err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-				err_show ( ERR_EXIT, _("\nReprojection failed at raw vertex #%i."), i+1);
-				return (REPROJ_STATUS_ERROR);
-			}
-			if ( reproj_srs_out_latlon(opts) ) {
-				/* pj_transform() has produced lat/lon data in radians */
-				X[0] = reproj_rad_to_deg (X[0]);
-				Y[0] = reproj_rad_to_deg (Y[0]);
-			}
-			/* re-write point coordinates from reprojected values */
-			gs->points_raw[i].X = X[0];
-			gs->points_raw[i].Y = Y[0];
-			gs->points_raw[i].Z = Z[0];
-			if ( gs->points_raw[i].has_label == TRUE ) {
-				/* also transform label point (if any) */
-				double X[1];
-				double Y[1];
-				X[0] = gs->points_raw[i].label_x;
-				Y[0] = gs->points_raw[i].label_y;
-				if ( reproj_srs_in_latlon(opts) ) {
-					X[0] = reproj_deg_to_rad (X[0]);
-					Y[0] = reproj_deg_to_rad (Y[0]);
-				}
-				int error = pj_transform( opts->proj4_in, opts->proj4_out, 1, 1, X, Y, NULL);
-				if ( error != 0 ) {
-					err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-					err_show ( ERR_EXIT, _("\nReprojection of label point failed at raw vertex #%i."), i+1);
-					return (REPROJ_STATUS_ERROR);
-				}
-				if ( reproj_srs_out_latlon(opts) ) {
-					X[0] = reproj_rad_to_deg (X[0]);
-					Y[0] = reproj_rad_to_deg (Y[0]);
-				}
-				gs->points_raw[i].label_x = X[0];
-				gs->points_raw[i].label_y = Y[0];
+		failed = reproj_do_parallel ( jobs, num_jobs, gs, GEOM_TYPE_POINT_RAW, gs->num_points_raw );
+		if ( failed >= 0 ) {
+			fail = jobs[failed];
+			reproj_free_jobs ( jobs, num_jobs );
+			reproj_approx_destroy ( approx );
+			err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(fail.error));
+			if ( fail.error_label == TRUE ) {
+				err_show ( ERR_EXIT, _("\nReprojection of label point failed at raw vertex #%i."), fail.error_obj+1);
+			} else {
+				err_show ( ERR_EXIT, _("\nReprojection failed at raw vertex #%i."), fail.error_obj+1);
 			}
+			return (REPROJ_STATUS_ERROR);
 		}
 	}
 
 	/* LINES */
 	if ( gs->num_lines > 0 ) {
 		err_show ( ERR_NOTE, _("\nReprojecting %i lines in current geometry store."), gs->num_lines );
-		int i;
-		for ( i=0; i < gs->num_lines; i ++ ) {
-			int j;
-			for ( j=0; j < gs->lines[i].num_parts; j ++ ) {
-				if ( reproj_srs_in_latlon(opts) ) {
-					/* pj_transform() expects lat/lon data to be in radians */
-					reproj_deg_to_rad_part(&gs->lines[i].parts[j]);
-				}
-				int error = pj_transform( opts->proj4_in, opts->proj4_out, gs->lines[i].parts[j].num_vertices, 1,
-								&gs->lines[i].parts[j].X[0], &gs->lines[i].parts[j].Y[0], &gs->lines[i].parts[j].Z[0] );
-				if ( error != 0 ) {
-					err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-					err_show ( ERR_EXIT, _("\nReprojection failed at line #%i, part #%i."), i+1, j+1);
-					return (REPROJ_STATUS_ERROR);
-				}
-				if ( reproj_srs_out_latlon(opts) ) {
-					/* pj_transform() has produced lat/lon data in radians */
-					reproj_rad_to_deg_part(&gs->lines[i].parts[j]);
-				}
-				if ( gs->lines[i].parts[j].has_label == TRUE ) {
-					/* also transform label point (if any) */
-					double X[1];
-					double Y[1];
-					X[0] = gs->lines[i].parts[j].label_x;
-					Y[0] = gs->lines[i].parts[j].label_y;
-					if ( reproj_srs_in_latlon(opts) ) {
-						X[0] = reproj_deg_to_rad (X[0]);
-						Y[0] = reproj_deg_to_rad (Y[0]);
-					}
-					int error = pj_transform( opts->proj4_in, opts->proj4_out, 1, 1, X, Y, NULL);
-					if ( error != 0 ) {
-						err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-						err_show ( ERR_EXIT, _("\nReprojection of label point failed at line #%i, part #%i."), i+1, j+1);
-						return (REPROJ_STATUS_ERROR);
-					}
-					if ( reproj_srs_out_latlon(opts) ) {
-						X[0] = reproj_rad_to_deg (X[0]);
-						Y[0] = reproj_rad_to_deg (Y[0]);
-					}
-					gs->lines[i].parts[j].label_x = X[0];
-					gs->lines[i].parts[j].label_y = Y[0];
-				}
+		failed = reproj_do_parallel ( jobs, num_jobs, gs, GEOM_TYPE_LINE, gs->num_lines );
+		if ( failed >= 0 ) {
+			fail = jobs[failed];
+			reproj_free_jobs ( jobs, num_jobs );
+			reproj_approx_destroy ( approx );
+			err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(fail.error));
+			if ( fail.error_label == TRUE ) {
+				err_show ( ERR_EXIT, _("\nReprojection of label point failed at line #%i, part #%i."),
+						fail.error_obj+1, fail.error_part+1);
+			} else {
+				err_show ( ERR_EXIT, _("\nReprojection failed at line #%i, part #%i."),
+						fail.error_obj+1, fail.error_part+1);
 			}
+			return (REPROJ_STATUS_ERROR);
 		}
 	}
 
 	/* POLYGONS */
 	if ( gs->num_polygons > 0 ) {
 		err_show ( ERR_NOTE, _("\nReprojecting %i polygons in current geometry store."), gs->num_polygons );
-		int i;
-		for ( i=0; i < gs->num_polygons; i ++ ) {
-			int j;
-			for ( j=0; j < gs->polygons[i].num_parts; j ++ ) {
-				if ( reproj_srs_in_latlon(opts) ) {
-					/* pj_transform() expects lat/lon data to be in radians */
-					reproj_deg_to_rad_part(&gs->polygons[i].parts[j]);
-				}
-				int error = pj_transform( opts->proj4_in, opts->proj4_out, gs->polygons[i].parts[j].num_vertices, 1,
-						gs->polygons[i].parts[j].X, gs->polygons[i].parts[j].Y, gs->polygons[i].parts[j].Z );
-				if ( error != 0 ) {
-					err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-					err_show ( ERR_EXIT, _("\nReprojection failed at polygon #%i, part #%i."), i+1, j+1);
-					return (REPROJ_STATUS_ERROR);
-				}
-				if ( reproj_srs_out_latlon(opts) ) {
-					/* pj_transform() has produced lat/lon data in radians */
-					reproj_rad_to_deg_part(&gs->polygons[i].parts[j]);
-				}
-				if ( gs->polygons[i].parts[j].has_label == TRUE ) {
-					/* also transform label point (if any) */
-					double X[1];
-					double Y[1];
-					X[0] = gs->polygons[i].parts[j].label_x;
-					Y[0] = gs->polygons[i].parts[j].label_y;
-					if ( reproj_srs_in_latlon(opts) ) {
-						X[0] = reproj_deg_to_rad (X[0]);
-						Y[0] = reproj_deg_to_rad (Y[0]);
-					}
-					int error = pj_transform( opts->proj4_in, opts->proj4_out, 1, 1, X, Y, NULL);
-					if ( error != 0 ) {
-						err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(error));
-						err_show ( ERR_EXIT, _("\nReprojection of label point failed at polygon #%i, part #%i."), i+1, j+1);
-						return (REPROJ_STATUS_ERROR);
-					}
-					if ( reproj_srs_out_latlon(opts) ) {
-						X[0] = reproj_rad_to_deg (X[0]);
-						Y[0] = reproj_rad_to_deg (Y[0]);
-					}
-					gs->polygons[i].parts[j].label_x = X[0];
-					gs->polygons[i].parts[j].label_y = Y[0];
-				}
+		failed = reproj_do_parallel ( jobs, num_jobs, gs, GEOM_TYPE_POLY, gs->num_polygons );
+		if ( failed >= 0 ) {
+			fail = jobs[failed];
+			reproj_free_jobs ( jobs, num_jobs );
+			reproj_approx_destroy ( approx );
+			err_show ( ERR_NOTE, _("PROJ.4 error:'%s'"), pj_strerrno(fail.error));
+			if ( fail.error_label == TRUE ) {
+				err_show ( ERR_EXIT, _("\nReprojection of label point failed at polygon #%i, part #%i."),
+						fail.error_obj+1, fail.error_part+1);
+			} else {
+				err_show ( ERR_EXIT, _("\nReprojection failed at polygon #%i, part #%i."),
+						fail.error_obj+1, fail.error_part+1);
 			}
+			return (REPROJ_STATUS_ERROR);
 		}
 	}
 
+	reproj_free_jobs ( jobs, num_jobs );
+	reproj_approx_destroy ( approx );
+
 	reproj_update_extent(gs);
 
 	return (REPROJ_STATUS_OK);
@@ -602,9 +602,92 @@ static const int REPROJ_SHORTCUT_EPSG[] =
 #define REPROJ_STATUS_NONE			 0
 #define REPROJ_STATUS_OK			 1
 
+/* max. length of a line in the PROJ.4 EPSG database file */
+#define REPROJ_EPSG_MAX_LINE_LEN	1024
+
+/* One entry of the in-memory EPSG database index */
+typedef struct reproj_epsg_entry reproj_epsg_entry;
+struct reproj_epsg_entry
+{
+	int code; /* EPSG code */
+	char *def; /* PROJ.4 definition string */
+};
+
+/* One entry of the cache of initialized SRS objects */
+typedef struct reproj_pj_entry reproj_pj_entry;
+struct reproj_pj_entry
+{
+	char *def; /* PROJ.4 definition string, as passed to pj_init_plus() */
+	projPJ pj; /* SRS object initialized from "def" */
+};
+
+/* Limits for approximate reprojection grid refinement:
+ * cells are always split at least MIN_DEPTH times, and never more than MAX_DEPTH times. */
+#define REPROJ_APPROX_MIN_DEPTH		2
+#define REPROJ_APPROX_MAX_DEPTH		16
+/* max. number of cells in an approximation grid */
+#define REPROJ_APPROX_MAX_CELLS		65536
+
+/* length of one degree of latitude (in metres), used to convert a
+ * max. error into degrees if the output SRS is lat/lon */
+#define REPROJ_APPROX_METRES_PER_DEG	111319.49
+
+/* A cell of the adaptive approximation grid (quadtree).
+ * Corners are stored in the order: lower left, lower right,
+ * upper right, upper left; for each of the grid's height levels. */
+typedef struct reproj_approx_cell reproj_approx_cell;
+struct reproj_approx_cell
+{
+	double x1, y1, x2, y2; /* cell bounds (input SRS) */
+	double X[2][4]; /* exactly transformed corner coordinates (output SRS) */
+	double Y[2][4];
+	double Z[2][4];
+	BOOLEAN exact; /* TRUE if no sufficient approximation was found for this cell */
+	reproj_approx_cell *child[4]; /* sub-cells (all NULL for leaf cells) */
+};
+
+/* Approximation grid for the extent of a geometry store */
+typedef struct reproj_approx reproj_approx;
+struct reproj_approx
+{
+	reproj_approx_cell *root; /* top-level cell covering the store's extent */
+	double z[2]; /* input heights of the grid levels */
+	int num_levels; /* number of height levels (1 if all heights are the same) */
+	double max_err_xy; /* max. horizontal error (output SRS units) */
+	double max_err_z; /* max. vertical error */
+	double err_found; /* largest horizontal error found at any test point of a leaf cell */
+	int num_cells; /* total number of leaf cells */
+	int num_exact; /* number of leaf cells that use exact transformation */
+};
+
+/* One chunk of reprojection work, to be run by a worker thread.
+ * Each job has its own PROJ.4 context and SRS objects, so that
+ * no PROJ.4 state is shared between threads. */
+typedef struct reproj_job reproj_job;
+struct reproj_job
+{
+	geom_store *gs; /* geometry store to reproject (in-place) */
+	int geom_type; /* type of objects to process (GEOM_TYPE_*) */
+	int first; /* index of first object to process */
+	int last; /* index of last object to process + 1 */
+	BOOLEAN in_latlon; /* TRUE if input SRS is lat/lon */
+	BOOLEAN out_latlon; /* TRUE if output SRS is lat/lon */
+	projCtx ctx; /* private PROJ.4 context of this job */
+	projPJ proj4_in; /* input SRS, initialized within "ctx" */
+	projPJ proj4_out; /* output SRS, initialized within "ctx" */
+	reproj_approx *approx; /* approximation grid (shared, read-only) or NULL */
+	int error; /* PROJ.4 error code of first failure (0 = no error) */
+	int error_obj; /* index of object that failed */
+	int error_part; /* index of part that failed (lines and polygons) */
+	BOOLEAN error_label; /* TRUE if label point failed, FALSE if geometry failed */
+};
+
 /* initalizes reprojection system (call first!) */
 void reproj_init( options *opt );
 
+/* release all cached EPSG definitions and SRS objects */
+void reproj_free_cache ( void );
+
 /* parse reprojection options */
 int reproj_parse_opts( options *opts );
 
@@ -620,4 +703,7 @@ BOOLEAN reproj_srs_in_latlon (options *opts);
 /* checks if the output SRS is lat/lon */
 BOOLEAN reproj_srs_out_latlon (options *opts);
 
+/* check if output SRS is Web Mercator */
+BOOLEAN reproj_srs_out_web (options *opts);
+
 #endif /* REPROJ_H */
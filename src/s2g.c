@@ -0,0 +1,1978 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	s2g.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	The complete processing pipeline (parsing, geometry building,
+ * 				topological cleaning, reprojection and export) and a
+ * 				library interface to it ("libsurvey2gis").
+ *
+ * 				See s2g.h for details.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+/* all global variables live here, so that they are part of the library */
+#define MAIN
+
+#include <errno.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "global.h"
+
+#include "errors.h"
+#include "export.h"
+#include "selections.h"
+#include "geom.h"
+#include "gui_form.h"
+#include "i18n.h"
+#include "options.h"
+#include "reproj.h"
+#include "parser.h"
+#include "s2g.h"
+#include "snapshot.h"
+#include "tools.h"
+
+/* these are defined 'extern' in global.h */
+char *PRG_NAME_CLI;
+char *PRG_PATH_CLI;
+char *PRG_DIR_CLI;
+
+
+/*
+ * Clean label attribute field contents of any excess tokens (if required).
+ */
+void clean_label_atts ( options *opts, parser_desc* parser, geom_store *gs ) {
+	if (opts->label_field != NULL ) {
+		{
+			int i = 0;
+			int j = 0;
+			int label_field_idx = -1;
+			char **atts = NULL;
+			while ( parser->fields[i] != NULL ) {
+				if ( !strcasecmp (parser->fields[i]->name, opts->label_field)  ) {
+					label_field_idx = i;
+					break;
+				}
+				i ++;
+			}
+			if ( label_field_idx >= 0 ) {
+				for ( j = 0; j < parser_get_num_tags ( parser, GEOM_TYPE_POINT ); j ++ ) {
+				//if ( parser->geom_tag_point != NULL ) { DELETE ME
+					//char *geom_tag = parser->geom_tag_point; DELETE ME
+					const char *geom_tag = parser_get_tag ( parser, GEOM_TYPE_POINT, j );
+					int geom_tag_len = strlen(geom_tag);
+					for ( i = 0; i < gs->num_points; i ++ ) {
+						if ( gs->points[i].is_selected == TRUE ) {
+							if ( gs->points[i].has_label == TRUE ) {
+								atts = gs->points[i].atts;
+								if ( atts[label_field_idx] != NULL ) {
+									char *content = t_str_pack (atts[label_field_idx]); /* get trimmed copy of field content */
+									if ( content != NULL && strlen (content) > 0 ) {
+										if ( strlen (content) > geom_tag_len ) {
+											/* There may be something here, other than the tag. */
+											char *tag = strstr(content,geom_tag);
+											if ( tag != NULL ) {
+												/* Tag found: Attempt to remove! */
+												int position = tag - content;
+												if ( position == 0 ) {
+													/* geom tag is at beginning of content */
+													int p;
+													for ( p = 0; p < geom_tag_len; p ++ ) {
+														tag ++; /* move pointer by one char */
+													}
+													char *purged = t_str_pack (tag); /* we are now positioned after the tag */
+													if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
+														/* swap for new content */
+														t_free (atts[label_field_idx]);
+														atts[label_field_idx] = purged;
+													} else {
+														t_free (purged);
+													}
+												}
+												else if ( position == ( strlen(content) - geom_tag_len ) ) {
+													/* geom tag is at end of content */
+													*tag = '\0'; /* cut off here */
+													char *purged = t_str_pack (content);
+													if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
+														/* swap for new content */
+														t_free (atts[label_field_idx]);
+														atts[label_field_idx] = purged;
+													} else {
+														t_free (purged);
+													}
+												}
+												/* in all other cases: we can do nothing */
+											}
+										}
+									}
+									t_free (content);
+								}
+							}
+						}
+					}
+				}
+				for ( j = 0; j < parser_get_num_tags ( parser, GEOM_TYPE_LINE ); j ++ ) {
+				//if ( parser->geom_tag_line != NULL ) { DELETE ME
+					//char *geom_tag = parser->geom_tag_line; DELETE ME
+					const char *geom_tag = parser_get_tag ( parser, GEOM_TYPE_LINE, j );
+					int geom_tag_len = strlen(geom_tag);
+					for ( i = 0; i < gs->num_lines; i ++ ) {
+						if ( gs->lines[i].is_selected == TRUE ) {
+							int j;
+							for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
+								if ( gs->lines[i].parts[j].has_label == TRUE ) {
+									atts = gs->lines[i].atts;
+									if ( atts[label_field_idx] != NULL ) {
+										char *content = t_str_pack (atts[label_field_idx]); /* get trimmed copy of field content */
+										if ( content != NULL && strlen (content) > 0 ) {
+											if ( strlen (content) > geom_tag_len ) {
+												/* There may be something here, other than the tag. */
+												char *tag = strstr(content,geom_tag);
+												if ( tag != NULL ) {
+													/* Tag found: Attempt to remove! */
+													int position = tag - content;
+													if ( position == 0 ) {
+														/* geom tag is at beginning of content */
+														int p;
+														for ( p = 0; p < geom_tag_len; p ++ ) {
+															tag ++; /* move pointer by one char */
+														}
+														char *purged = t_str_pack (tag); /* we are now positioned after the tag */
+														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
+															/* swap for new content */
+															t_free (atts[label_field_idx]);
+															atts[label_field_idx] = purged;
+														} else {
+															t_free (purged);
+														}
+													}
+													else if ( position == ( strlen(content) - geom_tag_len ) ) {
+														/* geom tag is at end of content */
+														*tag = '\0'; /* cut off here */
+														char *purged = t_str_pack (content);
+														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
+															/* swap for new content */
+															t_free (atts[label_field_idx]);
+															atts[label_field_idx] = purged;
+														} else {
+															t_free (purged);
+														}
+													}
+													/* in all other cases: we can do nothing */
+												}
+											}
+										}
+										t_free (content);
+									}
+								}
+							}
+						}
+					}
+				}
+				for ( j = 0; j < parser_get_num_tags ( parser, GEOM_TYPE_POLY ); j ++ ) {
+				//if ( parser->geom_tag_poly != NULL ) { DELETE ME
+					//char *geom_tag = parser->geom_tag_poly; DELETE ME
+					const char *geom_tag = parser_get_tag ( parser, GEOM_TYPE_POLY, j );
+					int geom_tag_len = strlen(geom_tag);
+					for ( i = 0; i < gs->num_polygons; i ++ ) {
+						if ( gs->polygons[i].is_selected == TRUE ) {
+							int j;
+							for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
+								if ( gs->polygons[i].parts[j].has_label == TRUE ) {
+									atts = gs->polygons[i].atts;
+									if ( atts[label_field_idx] != NULL ) {
+										char *content = t_str_pack (atts[label_field_idx]); /* get trimmed copy of field content */
+										if ( content != NULL && strlen (content) > 0 ) {
+											if ( strlen (content) > geom_tag_len ) {
+												/* There may be something here, other than the tag. */
+												char *tag = strstr(content,geom_tag);
+												if ( tag != NULL ) {
+													/* Tag found: Attempt to remove! */
+													int position = tag - content;
+													if ( position == 0 ) {
+														/* geom tag is at beginning of content */
+														int p;
+														for ( p = 0; p < geom_tag_len; p ++ ) {
+															tag ++; /* move pointer by one char */
+														}
+														char *purged = t_str_pack (tag); /* we are now positioned after the tag */
+														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
+															/* swap for new content */
+															t_free (atts[label_field_idx]);
+															atts[label_field_idx] = purged;
+														} else {
+															t_free (purged);
+														}
+													}
+													else if ( position == ( strlen(content) - geom_tag_len ) ) {
+														/* geom tag is at end of content */
+														*tag = '\0'; /* cut off here */
+														char *purged = t_str_pack (content);
+														if ( purged != NULL && strlen (purged) > 0 ) { /* anything left? */
+															/* swap for new content */
+															t_free (atts[label_field_idx]);
+															atts[label_field_idx] = purged;
+														} else {
+															t_free (purged);
+														}
+													}
+													/* in all other cases: we can do nothing */
+												}
+											}
+										}
+										t_free (content);
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	} /* DONE (remove geom markers from label fields) */
+}
+
+
+/*
+ * Show processing statistics after job is done.
+ */
+void show_stats ( unsigned int *topo_errors, options *opts, parser_data_store **storage ) {
+	int i, j;
+	unsigned int *num_total_lines;
+	unsigned int *num_invalid_lines;
+	unsigned int *num_points_rec;
+	unsigned int *num_lines_rec;
+	unsigned int *num_polygons_rec;
+	unsigned int *num_unassigned;
+
+
+	/* initialize validation statistics */
+	num_total_lines = malloc ( sizeof (unsigned int) * opts->num_input );
+	num_invalid_lines = malloc ( sizeof (unsigned int) * opts->num_input );
+	num_points_rec = malloc ( sizeof (unsigned int) * opts->num_input );
+	num_lines_rec = malloc ( sizeof (unsigned int) * opts->num_input );
+	num_polygons_rec = malloc ( sizeof (unsigned int) * opts->num_input );
+	num_unassigned = malloc ( sizeof (unsigned int) * opts->num_input );
+	for ( i=0; i < opts->num_input ; i ++ ) {
+		num_total_lines[i] = 0;
+		num_invalid_lines[i] = 0;
+		num_points_rec[i] = 0;
+		num_lines_rec[i] = 0;
+		num_polygons_rec[i] = 0;
+		num_unassigned[i] = 0;
+	}
+
+	/* get statistics */
+	for ( i=0; i < opts->num_input ; i ++ ) {
+		for ( j=0; j < storage[i]->num_records; j++ ) {
+			if ( 	!( storage[i]->flags[j] & PARSER_RECORD_EMPTY )	) {
+				num_total_lines[i] ++;
+			}
+			if ( 	!( storage[i]->flags[j] & PARSER_RECORD_VALID ) &&
+					!( storage[i]->flags[j] & PARSER_RECORD_EMPTY )	) {
+				num_invalid_lines[i] ++;
+			}
+			if ( 	( storage[i]->flags[j] & PARSER_RECORD_VALID ) &&
+					!( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) &&
+					storage[i]->geom_type[j] == GEOM_TYPE_NONE ) {
+				num_unassigned[i] ++;
+			}
+			if ( 	( storage[i]->flags[j] & PARSER_RECORD_VALID ) &&
+					!( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) &&
+					storage[i]->geom_type[j] == GEOM_TYPE_POINT ) {
+				num_points_rec[i] ++;
+			}
+			if ( 	( storage[i]->flags[j] & PARSER_RECORD_VALID ) &&
+					!( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) &&
+					storage[i]->geom_type[j] == GEOM_TYPE_LINE ) {
+				num_lines_rec[i] ++;
+			}
+			if ( 	( storage[i]->flags[j] & PARSER_RECORD_VALID ) &&
+					!( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) &&
+					storage[i]->geom_type[j] == GEOM_TYPE_POLY ) {
+				num_polygons_rec[i] ++;
+			}
+		}
+	}
+
+	/* log data statistics */
+	err_show (ERR_NOTE,_("\nParsing of %i input data source(s) completed. Validation statistics below."), opts->num_input );
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		err_show (ERR_NOTE, "" );
+		if ( !strcmp (opts->input[i], "-") ) {
+			err_show (ERR_NOTE,_("%i\tData read from console input stream."), i+1 );
+		} else {
+			err_show (ERR_NOTE,_("%i\tData read from file \"%s\"."), i+1, opts->input[i] );
+		}
+		err_show (ERR_NOTE,_("\tTotal records/lines read: %i"), num_total_lines[i] );
+		err_show (ERR_NOTE,_("\tNumber of invalid records: %i"), num_invalid_lines[i] );
+		err_show (ERR_NOTE,_("\tNumber of valid records: %i"), storage[i]->slot - num_invalid_lines[i] );
+		err_show (ERR_NOTE,_("\t\tAssigned to %i points: %i"), storage[i]->num_points, num_points_rec[i] );
+		err_show (ERR_NOTE,_("\t\tAssigned to %i lines/parts: %i"), storage[i]->num_lines, num_lines_rec[i] );
+		err_show (ERR_NOTE,_("\t\tAssigned to %i polygons/parts: %i"), storage[i]->num_polygons, num_polygons_rec[i] );
+		err_show (ERR_NOTE,_("\t\tNot assigned to any geometry: %i"), num_unassigned[i] );
+		err_show (ERR_NOTE,_("\tTotal topological error count: %i"), topo_errors[i] );
+	}
+
+	/* free memory for data statistics */
+	free ( num_total_lines );
+	free ( num_invalid_lines );
+	free ( num_points_rec );
+	free ( num_lines_rec );
+	free ( num_polygons_rec );
+	free ( num_unassigned );
+}
+
+
+/*
+ * Helper function for show_profile():
+ * Writes one profile stage as a JSON object.
+ * Times are written as integer microseconds, so that the
+ * output does not depend on the current numeric locale.
+ */
+void show_profile_json_stage ( FILE *fp, const t_profile_stage *stage ) {
+	fprintf ( fp, "{ \"name\": \"%s\", \"wall_us\": %.0f, \"cpu_us\": %.0f, ",
+			stage->name, stage->wall * 1000000.0, stage->cpu * 1000000.0 );
+	if ( stage->max_rss < 0 ) {
+		fprintf ( fp, "\"max_rss_kb\": null, " );
+	} else {
+		fprintf ( fp, "\"max_rss_kb\": %li, ", stage->max_rss );
+	}
+	if ( stage->count < 0 ) {
+		fprintf ( fp, "\"count\": null, " );
+	} else {
+		fprintf ( fp, "\"count\": %li, ", stage->count );
+	}
+	fprintf ( fp, "\"calls\": %i }", stage->calls );
+}
+
+
+/*
+ * Show run-time profile after job is done:
+ * A table of processing stages is shown along with the other
+ * messages, and the same data is written to a JSON file
+ * "<base>_profile.json" in the output folder.
+ */
+void show_profile ( const t_profile *prof, options *opts ) {
+	t_profile_stage total;
+	char path[PRG_MAX_PATH_LENGTH];
+	char *version;
+	FILE *fp;
+	int i;
+
+	if ( prof == NULL || prof->enabled == FALSE ) {
+		return;
+	}
+
+	t_profile_total ( prof, &total );
+
+	/* table */
+	err_show (ERR_NOTE, _("\nRun-time profile:"));
+	err_show (ERR_NOTE, _("\t%-14s %10s %10s %14s %10s"), _("Stage"), _("Wall (s)"), _("CPU (s)"),
+			_("Peak RSS (KiB)"), _("Count"));
+	for ( i = 0; i <= prof->num_stages; i ++ ) {
+		const t_profile_stage *stage = ( i < prof->num_stages ) ? &prof->stages[i] : &total;
+		char rss[PRG_MAX_STR_LEN];
+		char count[PRG_MAX_STR_LEN];
+		if ( stage->max_rss < 0 ) {
+			snprintf ( rss, PRG_MAX_STR_LEN, "-" );
+		} else {
+			snprintf ( rss, PRG_MAX_STR_LEN, "%li", stage->max_rss );
+		}
+		if ( stage->count < 0 ) {
+			snprintf ( count, PRG_MAX_STR_LEN, "-" );
+		} else {
+			snprintf ( count, PRG_MAX_STR_LEN, "%li", stage->count );
+		}
+		err_show (ERR_NOTE, "\t%-14s %10.3f %10.3f %14s %10s", stage->name, stage->wall, stage->cpu,
+				rss, count );
+	}
+
+	/* JSON */
+	if ( opts->output == NULL || opts->base == NULL ) {
+		return;
+	}
+	snprintf ( path, PRG_MAX_PATH_LENGTH, "%s%c%s_profile.json", opts->output, PRG_FILE_SEPARATOR, opts->base );
+	fp = t_fopen_utf8 ( path, "w" );
+	if ( fp == NULL ) {
+		err_show (ERR_WARN, _("\nCannot write run-time profile to '%s': %s"), path, strerror (errno) );
+		return;
+	}
+	version = t_get_prg_version ();
+	fprintf ( fp, "{\n" );
+	fprintf ( fp, "  \"program\": \"%s\",\n", PRG_CMD_NAME );
+	fprintf ( fp, "  \"version\": \"%s\",\n", version );
+	fprintf ( fp, "  \"threads\": %i,\n", opts->threads );
+	fprintf ( fp, "  \"inputs\": %i,\n", opts->num_input );
+	fprintf ( fp, "  \"stages\": [\n" );
+	for ( i = 0; i < prof->num_stages; i ++ ) {
+		fprintf ( fp, "    " );
+		show_profile_json_stage ( fp, &prof->stages[i] );
+		fprintf ( fp, "%s\n", ( i < prof->num_stages - 1 ) ? "," : "" );
+	}
+	fprintf ( fp, "  ],\n" );
+	fprintf ( fp, "  \"total\": " );
+	show_profile_json_stage ( fp, &total );
+	fprintf ( fp, "\n}\n" );
+	fclose ( fp );
+	free ( version );
+	err_show (ERR_NOTE, _("\tProfile saved as: %s"), path );
+}
+
+/*
+ * Releases all data of a pipeline run (see s2g_run_pipeline()).
+ * Afterwards, "run" is empty and can be used for another run.
+ */
+void s2g_run_free ( s2g_run *run )
+{
+	int i;
+
+	if ( run->storage != NULL ) {
+		for ( i=0; i < run->num_input ; i ++ ) {
+			if ( run->storage[i] != NULL )
+				parser_data_store_destroy ( run->storage[i] );
+		}
+		free ( run->storage );
+	}
+	if ( run->topo_errors != NULL ) {
+		free ( run->topo_errors );
+	}
+	if ( run->gs != NULL ) {
+		geom_store_destroy ( run->gs );
+	}
+	if ( run->checkpoint != NULL ) {
+		incremental_destroy ( run->checkpoint );
+	}
+	if ( run->exports != NULL ) {
+		for ( i=0; i < run->num_exports ; i ++ ) {
+			geom_store_free_paths ( &run->exports[i].gs );
+			err_queue_free ( &run->exports[i].messages );
+		}
+		free ( run->exports );
+	}
+	run->num_input = 0;
+	run->storage = NULL;
+	run->topo_errors = NULL;
+	run->gs = NULL;
+	run->checkpoint = NULL;
+	run->num_exports = 0;
+	run->exports = NULL;
+}
+
+
+/*
+ * Checks that the parser schema, reprojection, label field and selection
+ * settings can be used together. Must be run once (and successfully), after
+ * the parser schema has been read and before s2g_run_pipeline() is run.
+ *
+ * Returns S2G_OK or S2G_ERROR. In the latter case, a suitable error
+ * message will already have been produced.
+ */
+int s2g_prepare ( options *opts, parser_desc *parser )
+{
+	int i;
+	int error;
+
+
+	/* validate parser schema */
+	error = parser_desc_validate ( parser, opts );
+
+	/* only continue, if the parser is OK */
+	if ( error != 0 ) {
+		return (S2G_ERROR);
+	}
+
+	/* Check reprojection settings (if any)
+	 * We run this function as early as possible, because only after
+	 * it has completed can we safely query 'opts' for SRS data of
+	 * any kind!
+	 */
+
+	int reproj = reproj_parse_opts (opts);
+	if ( reproj != REPROJ_STATUS_OK ) {
+		/* a suitable error message will already have been produced by reproj_parse_opts() */
+		return (S2G_ERROR);
+	}
+
+	/* check that label field is valid */
+	if ( opts->label_field != NULL ) {
+		BOOLEAN found = FALSE;
+		for ( i = 0; i < PRG_MAX_FIELDS; i ++ ) {
+			if ( parser->fields[i] != NULL ) {
+				if ( !strcasecmp ( opts->label_field, parser->fields[i]->name ) ) {
+					found = TRUE;
+					break;
+				}
+			}
+		}
+		if ( found == FALSE ) {
+			err_show ( ERR_EXIT, _("\nLabel field \"%s\" not found in parser definition."), opts->label_field);
+			return (S2G_ERROR);
+		}
+	}
+
+	/* validate selection expressions */
+	if ( selections_validate ( opts, parser ) == FALSE ) {
+		return (S2G_ERROR);
+	}
+
+	return (S2G_OK);
+}
+
+
+/*
+ * Helper function for s2g_export() and s2g_export_all(): checks
+ * that output "format" can be used with the reprojection settings
+ * in "opts".
+ *
+ * Returns S2G_OK or S2G_ERROR. In the latter case, a suitable error
+ * message will already have been produced.
+ */
+int s2g_check_format ( options *opts, int format )
+{
+	if ( format < PRG_OUTPUT_SHP || format > PRG_OUTPUT_MVT ) {
+		err_show ( ERR_EXIT, "\nOutput format not yet implemented. Aborting." );
+		return (S2G_ERROR);
+	}
+
+	if ( format == PRG_OUTPUT_GEOJSON || format == PRG_OUTPUT_GEOJSONL ) {
+		/* Fail if input or output SRS is not lat/lon (strict mode only). */
+		if ( reproj_srs_out_latlon(opts) == FALSE && reproj_srs_in_latlon(opts) == FALSE ) {
+			if ( opts->strict == TRUE ) {
+				err_show ( ERR_EXIT, "\nOutput format '%s' only available for lat/lon data in 'strict' mode. Aborting.",
+						PRG_OUTPUT_DESC[format] );
+				return (S2G_ERROR);
+			}
+		}
+	} else if ( format == PRG_OUTPUT_KML	) {
+		/* Fail if input or output SRS is not lat/lon. */
+		if ( reproj_srs_out_latlon(opts) == FALSE && reproj_srs_in_latlon(opts) == FALSE ) {
+			err_show ( ERR_EXIT, "\nOutput format '%s' only available for lat/lon data. Aborting.",
+					PRG_OUTPUT_DESC[PRG_OUTPUT_KML] );
+			return (S2G_ERROR);
+		}
+	} else if ( format == PRG_OUTPUT_MVT	) {
+		/* Fail if output data is neither lat/lon nor Web Mercator
+		   (that of the output SRS, if data is reprojected). */
+		BOOLEAN tiles_ok;
+		if ( opts->proj4_out != NULL ) {
+			tiles_ok = reproj_srs_out_latlon(opts) == TRUE || reproj_srs_out_web(opts) == TRUE;
+		} else {
+			tiles_ok = reproj_srs_in_latlon(opts);
+		}
+		if ( tiles_ok == FALSE ) {
+			err_show ( ERR_EXIT, "\nOutput format '%s' only available for lat/lon or Web Mercator data. Aborting.",
+					PRG_OUTPUT_DESC[PRG_OUTPUT_MVT] );
+			return (S2G_ERROR);
+		}
+	}
+
+	return (S2G_OK);
+}
+
+
+/*
+ * Helper function for s2g_run_pipeline(): writes all selected
+ * geometries in "gs" to the output format set in "opts".
+ * The number of attribute write errors is stored in "bad_attributes".
+ *
+ * Returns S2G_OK or S2G_ERROR. In the latter case, a suitable error
+ * message will already have been produced.
+ */
+int s2g_export ( geom_store *gs, parser_desc *parser, options *opts, int *bad_attributes )
+{
+	if ( opts->format < PRG_OUTPUT_SHP || opts->format > PRG_OUTPUT_MVT ) {
+		err_show ( ERR_EXIT, "\nOutput format not yet implemented. Aborting." );
+		return (S2G_ERROR);
+	}
+
+	err_show (ERR_NOTE, _("\nOutput format: %s"), PRG_OUTPUT_DESC[opts->format] );
+
+	if ( s2g_check_format ( opts, opts->format ) != S2G_OK ) {
+		return (S2G_ERROR);
+	}
+
+	if ( opts->format == PRG_OUTPUT_SHP	) {
+		*bad_attributes = export_SHP ( gs, parser, opts );
+	} else if ( opts->format == PRG_OUTPUT_DXF	) {
+		*bad_attributes = export_DXF ( gs, parser, opts );
+	} else if ( opts->format == PRG_OUTPUT_GEOJSON || opts->format == PRG_OUTPUT_GEOJSONL ) {
+		/* Warn if input or output SRS is not lat/lon. */
+		if ( reproj_srs_out_latlon(opts) == FALSE && reproj_srs_in_latlon(opts) == FALSE ) {
+			err_show ( ERR_WARN, "\nOutput format '%s' with data other than lat/lon is not standard-conforming.",
+					PRG_OUTPUT_DESC[opts->format] );
+		}
+		if ( opts->format == PRG_OUTPUT_GEOJSON ) {
+			*bad_attributes = export_GeoJSON ( gs, parser, opts );
+		} else {
+			*bad_attributes = export_GeoJSONSeq ( gs, parser, opts );
+		}
+	} else if ( opts->format == PRG_OUTPUT_KML	) {
+		*bad_attributes = export_KML ( gs, parser, opts );
+	} else if ( opts->format == PRG_OUTPUT_FGB	) {
+		*bad_attributes = export_FGB ( gs, parser, opts );
+	} else if ( opts->format == PRG_OUTPUT_MVT	) {
+		*bad_attributes = export_MVT ( gs, parser, opts );
+	}
+
+	return (S2G_OK);
+}
+
+
+/*
+ * Helper function for s2g_export_all():
+ * Writes the geometries of one export job, storing all
+ * messages in the job's queue.
+ */
+void *s2g_export_job_run ( void *arg )
+{
+	s2g_export_job *job = (s2g_export_job*) arg;
+	err_queue *previous;
+	int i;
+
+	previous = err_queue_attach ( &job->messages );
+	job->status = s2g_export ( &job->gs, job->parser, &job->opts, &job->bad_attributes );
+	err_queue_attach ( previous );
+
+	/* a fatal error does not stop a worker: check for one */
+	for ( i = 0; i < job->messages.num; i ++ ) {
+		if ( job->messages.types[i] == ERR_EXIT ) {
+			job->status = S2G_ERROR;
+		}
+	}
+
+	return ( NULL );
+}
+
+
+/*
+ * Helper function for s2g_run_pipeline(): writes all selected
+ * geometries in "gs" to each of the output formats set in "opts".
+ *
+ * All formats are checked before anything is written. Each format
+ * then gets an export job (stored in "run", so that it will be
+ * released by s2g_run_free()) with its own output paths and its
+ * own copy of the options. The jobs share the geometries, which
+ * the exporters only read, and run in parallel. KML is written
+ * last, after the polygon vertices have been put into the counter
+ * clockwise order that it requires.
+ *
+ * The total number of attribute write errors is stored in "bad_attributes",
+ * the number of polygon rings that were reversed for KML is added to
+ * "reversed_vertex_lists".
+ *
+ * Returns S2G_OK or S2G_ERROR. In the latter case, a suitable error
+ * message will already have been produced.
+ */
+int s2g_export_all ( geom_store *gs, parser_desc *parser, options *opts, s2g_run *run,
+		int *bad_attributes, unsigned int *reversed_vertex_lists )
+{
+	char error_msg[PRG_MAX_STR_LEN];
+	s2g_export_job *job;
+	BOOLEAN kml = FALSE;
+	int num_parallel;
+	int max_threads;
+	int status;
+	int i, j;
+
+
+	/* write nothing, if any of the formats cannot be used */
+	for ( i = 0; i < opts->num_formats; i ++ ) {
+		if ( s2g_check_format ( opts, opts->formats[i] ) != S2G_OK ) {
+			return (S2G_ERROR);
+		}
+		if ( opts->formats[i] == PRG_OUTPUT_KML ) {
+			kml = TRUE;
+		}
+	}
+
+	/* set up one job per format (KML last) */
+	run->exports = malloc ( sizeof (s2g_export_job) * opts->num_formats );
+	run->num_exports = 0;
+	num_parallel = kml == TRUE ? opts->num_formats - 1 : opts->num_formats;
+	j = 0;
+	for ( i = 0; i < opts->num_formats; i ++ ) {
+		if ( opts->formats[i] == PRG_OUTPUT_KML ) {
+			job = &run->exports[num_parallel];
+		} else {
+			job = &run->exports[j];
+			j ++;
+		}
+		run->num_exports ++;
+		geom_store_view ( &job->gs, gs );
+		job->parser = parser;
+		job->opts = *opts;
+		job->opts.format = opts->formats[i];
+		job->opts.formats[0] = opts->formats[i];
+		job->opts.num_formats = 1;
+		job->bad_attributes = 0;
+		job->status = S2G_OK;
+		err_queue_init ( &job->messages );
+	}
+	for ( i = 0; i < run->num_exports; i ++ ) {
+		error_msg[0] = '\0';
+		if ( geom_store_make_paths ( &run->exports[i].gs, &run->exports[i].opts, &error_msg[0] ) != 0 ) {
+			if ( strlen (error_msg) > 0 ) {
+				err_show (ERR_EXIT, _("\nUnable to create output file. Error was: '%s'."), error_msg );
+			}
+			return (S2G_ERROR);
+		}
+	}
+
+	/* share the threads between the jobs that run in parallel */
+	max_threads = opts->threads;
+#ifdef MINGW
+	/* Shapefile export switches the process' numeric locale
+	   (see export_SHP_write_atts()): run one job at a time */
+	if ( options_has_format ( opts, PRG_OUTPUT_SHP ) == TRUE ) {
+		max_threads = 1;
+	}
+#endif
+	for ( i = 0; i < num_parallel; i ++ ) {
+		run->exports[i].opts.threads = opts->threads / ( num_parallel < max_threads ? num_parallel : max_threads );
+	}
+	t_thread_run_pool ( s2g_export_job_run, run->exports, num_parallel, sizeof (s2g_export_job), max_threads );
+	for ( i = 0; i < num_parallel; i ++ ) {
+		err_queue_flush ( &run->exports[i].messages );
+	}
+
+	/* KML requires ccw vertex winding */
+	if ( kml == TRUE ) {
+		*reversed_vertex_lists += geom_topology_sort_vertices ( gs, GEOM_WINDING_CCW );
+		s2g_export_job_run ( &run->exports[num_parallel] );
+		err_queue_flush ( &run->exports[num_parallel].messages );
+	}
+
+	status = S2G_OK;
+	*bad_attributes = 0;
+	for ( i = 0; i < run->num_exports; i ++ ) {
+		*bad_attributes += run->exports[i].bad_attributes;
+		if ( run->exports[i].status != S2G_OK ) {
+			status = S2G_ERROR;
+		}
+	}
+
+	return (status);
+}
+
+
+/*
+ * Helper function for s2g_run_pipeline(): lists the output
+ * files written for the output format set in "opts".
+ */
+void s2g_show_outputs ( geom_store *gs, options *opts )
+{
+	if ( OPTIONS_GUI_MODE == TRUE ) {
+		fprintf (stderr, "<OUTPUT_FORMAT>%s</OUTPUT_FORMAT>\n", PRG_OUTPUT_DESC[opts->format]);
+	}
+	/* if ( gs->num_points > 0 ) { */
+	if ( selections_get_num_selected ( GEOM_TYPE_POINT, gs ) > 0 ) {
+		if ( gs->path_points != NULL ) {
+			err_show (ERR_NOTE, _("\t%s"), gs->path_points);
+			if ( OPTIONS_GUI_MODE == TRUE ) {
+				fprintf (stderr, "<OUTPUT_POINTS>%s</OUTPUT_POINTS>\n", gs->path_points);
+			}
+		}
+	}
+	if ( selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ) > 0 ) {
+		/* if ( gs->num_points_raw > 0 ) { */
+		if ( gs->path_points_raw != NULL ) {
+			err_show (ERR_NOTE, _("\t%s"), gs->path_points_raw);
+			if ( OPTIONS_GUI_MODE == TRUE ) {
+				fprintf (stderr, "<OUTPUT_POINTS_RAW>%s</OUTPUT_POINTS_RAW>\n", gs->path_points_raw);
+			}
+		}
+	}
+	if ( selections_get_num_selected ( GEOM_TYPE_LINE, gs ) > 0 ) {
+		/* if ( gs->num_lines > 0 ) { */
+		if ( gs->path_lines != NULL ) {
+			err_show (ERR_NOTE, _("\t%s"), gs->path_lines);
+			if ( OPTIONS_GUI_MODE == TRUE ) {
+				fprintf (stderr, "<OUTPUT_LINES>%s</OUTPUT_LINES>\n", gs->path_lines);
+			}
+		}
+	}
+	if ( selections_get_num_selected ( GEOM_TYPE_POLY, gs ) > 0 ) {
+		/* if ( gs->num_polygons > 0 ) { */
+		if ( gs->path_polys != NULL ) {
+			err_show (ERR_NOTE, _("\t%s"), gs->path_polys);
+			if ( OPTIONS_GUI_MODE == TRUE ) {
+				fprintf (stderr, "<OUTPUT_POLYGONS>%s</OUTPUT_POLYGONS>\n", gs->path_polys);
+			}
+		}
+	}
+	if ( opts->label_field != NULL ) {
+		if ( gs->path_labels != NULL ) {
+			err_show (ERR_NOTE, _("\t%s"), gs->path_labels);
+			if ( OPTIONS_GUI_MODE == TRUE ) {
+				fprintf (stderr, "<OUTPUT_LABELS>%s</OUTPUT_LABELS>\n", gs->path_labels);
+			}
+		}
+	}
+	if ( gs->path_all != NULL ) {
+		err_show (ERR_NOTE, _("\t%s"), gs->path_all);
+		if ( OPTIONS_GUI_MODE == TRUE ) {
+			fprintf (stderr, "<OUTPUT_ALL>%s</OUTPUT_ALL>\n", gs->path_all);
+		}
+	}
+	if ( gs->path_all_atts != NULL ) {
+		err_show (ERR_NOTE, _("\t%s"), gs->path_all_atts);
+		if ( OPTIONS_GUI_MODE == TRUE ) {
+			fprintf (stderr, "<OUTPUT_ALL_ATTS>%s</OUTPUT_ALL_ATTS>\n", gs->path_all_atts);
+		}
+	}
+}
+
+
+/*
+ * Helper function for s2g_run_pipeline(): shows warnings about the
+ * limited accuracy of cleaning lat/lon data (if required).
+ */
+void s2g_warn_latlon ( options *opts )
+{
+	if ( reproj_srs_in_latlon(opts) == TRUE ) {
+		if ( opts->tolerance > 0.0 ) {
+			err_show (ERR_WARN, _("\nTopological cleaning of lat/lon data has limited accuracy."));
+			err_show (ERR_WARN, _("Results of eliminating duplicate vertices may be insufficient."));
+		}
+		if ( opts->snapping > 0.0 ) {
+			err_show (ERR_WARN, _("\nTopological cleaning of lat/lon data has limited accuracy."));
+			err_show (ERR_WARN, _("Results of snapping vertices may be insufficient."));
+		}
+	}
+}
+
+
+/*
+ * Helper function for s2g_run_pipeline(): reads all input files into
+ * new data stores (stored in "run"), then assigns records to geometries,
+ * removes duplicate vertices and splinters, fuses multi-part geometries
+ * and checks unique attributes. "fused_records" and "duplicate_records"
+ * receive the results of the last two steps.
+ *
+ * Returns S2G_OK or S2G_ERROR. In the latter case, a suitable error
+ * message will already have been produced.
+ */
+int s2g_parse_input ( options *opts, parser_desc *parser, t_profile *prof, s2g_run *run,
+		incremental_checkpoint *cp, unsigned int *fused_records, unsigned int *duplicate_records )
+{
+	int i;
+	unsigned int *topo_errors;
+	parser_data_store **storage;
+
+
+	/* create data storage objects */
+	storage = malloc ( sizeof ( parser_data_store* ) * opts->num_input );
+	for ( i=0; i < opts->num_input ; i ++ ) {
+		storage[i] = NULL;
+	}
+	run->storage = storage;
+	run->num_input = opts->num_input;
+	for ( i=0; i < opts->num_input ; i ++ ) {
+		storage[i] = parser_data_store_create ( opts->input[i], parser,  opts );
+		if ( storage[i] == NULL ) {
+			err_show ( ERR_EXIT, _("\nFailed to create data storage object for data source #%i."), i+1 );
+			return (S2G_ERROR);
+		}
+	}
+	if ( cp != NULL ) {
+		incremental_set_start ( cp, storage[0] );
+	}
+
+	/* process input file(s) */
+	parser_consume_input ( parser, opts, storage );
+	if ( prof->enabled == TRUE ) {
+		long num_records = 0;
+		for ( i=0; i < opts->num_input ; i ++ ) {
+			num_records += storage[i]->num_records;
+		}
+		t_profile_stop ( prof, "parse", num_records );
+	}
+
+	/* Past this point we have valid input file records and coordinates for every measurement! */
+
+	/* Reproject data to change axis orientation (if requested). */
+	/* This must be done _before_ geom_store_build(), so that label point positions */
+	/* can be computed correctly later on! */
+	if ( opts->orient_mode == OPTIONS_ORIENT_MODE_LOCAL_XZ ) {
+		if ( reproj_srs_in_latlon(opts) == TRUE ) {
+			err_show ( ERR_EXIT, _("\nOrientation mode '%s' not supported for lat/lon input data."),
+					OPTIONS_ORIENT_MODE_NAMES[OPTIONS_ORIENT_MODE_LOCAL_XZ]);
+			return (S2G_ERROR);
+		}
+		/* check that a Z coordinate field has been declared */
+		if ( parser->coor_z == NULL ) {
+			err_show ( ERR_EXIT, _("\nCannot create local X-Z output for 2D input without Z field.") );
+			return (S2G_ERROR);
+		}
+		if ( opts->num_input > 1 ) {
+			err_show ( ERR_EXIT, _("\nCannot create local X-Z output for more than one data source."));
+			return (S2G_ERROR);
+		}
+		/* check that there is actual Z data */
+		if ( geom_ds_has_z (storage[0]) == FALSE ) {
+			err_show ( ERR_EXIT, _("\nCannot create local X-Z output: Z extent of data is '0.0'."));
+			return (S2G_ERROR);
+		}
+
+		/* perform re-orientation on first datastore ONLY */
+		geom_reorient_local_xz(storage[0]);
+		t_profile_stop ( prof, "reorient", -1 );
+	}
+
+	/* Basic geometry processing:
+	 * 1. Assign geom_id to all records that form a geometry.
+	 * 2. Eliminate duplicate coordinates, zero-length lines and zero-area polygons ("splinters").
+	 * 3. Snap coordinates
+	 */
+	/* TODO: Improve snapping and thresholding of points for lat/lon data*/
+	s2g_warn_latlon ( opts );
+	topo_errors = malloc ( sizeof ( unsigned int ) * opts->num_input );
+	run->topo_errors = topo_errors;
+	for ( i=0; i < opts->num_input ; i ++ ) {
+		/* LEVEL: ALL */
+		topo_errors[i] = 0;
+		/* multiplex geometries into points, lines and polygons */
+		t_profile_start ( prof );
+		geom_multiplex ( storage[i], parser );
+		t_profile_stop ( prof, "multiplex", -1 );
+		/* remove duplicate vertices */
+		topo_errors[i] += geom_topology_remove_duplicates ( storage[i], opts, FALSE );
+		/* remove splintered geometries */
+		topo_errors[i] += geom_topology_remove_splinters_lines ( storage[i], opts );
+		topo_errors[i] += geom_topology_remove_splinters_polygons ( storage[i], opts );
+		t_profile_stop ( prof, "dedupe", topo_errors[i] );
+	}
+
+	/* fuse multi-part geometries: assign a "part_id" to all
+	 * parts of a "master" geometry. */
+	*fused_records = parser_ds_fuse ( storage, opts, parser );
+	t_profile_stop ( prof, "fuse", *fused_records );
+
+	/* evaluate "unique" attributes across ALL input data */
+	*duplicate_records = parser_ds_validate_unique ( storage, opts, parser );
+	t_profile_stop ( prof, "unique", *duplicate_records );
+
+	return (S2G_OK);
+}
+
+
+/*
+ * Runs the processing pipeline on all input files in "opts":
+ * Parses the input (or loads it from a snapshot), builds and cleans geometries, reprojects
+ * them (if required) and writes the output, then shows the
+ * processing statistics and the run-time profile (if enabled).
+ *
+ * "parser" must have passed s2g_prepare() with the same "opts".
+ * All data produced is stored in "run" (which must be empty
+ * on entry) and must be released by the caller, using
+ * s2g_run_free(), whether the run was successful or not.
+ *
+ * Returns S2G_OK or S2G_ERROR. In the latter case, a suitable error
+ * message will already have been produced.
+ */
+int s2g_run_pipeline ( options *opts, parser_desc *parser, t_profile *prof, s2g_run *run )
+{
+	int i;
+	char error_msg[PRG_MAX_STR_LEN] = "";
+	unsigned int *topo_errors;
+	unsigned int topo_errors_after_fusion = 0;
+	unsigned int duplicate_records;
+	unsigned int build_errors;
+	unsigned int fused_records;
+	unsigned int overlays = 0;
+	unsigned int removed_overlaps = 0;
+	unsigned int snaps_poly = 0;
+	unsigned int detected_intersections_ll = 0;
+	unsigned int detected_intersections_lp = 0;
+	unsigned int detected_intersections_pp = 0;
+	unsigned int self_intersects_lines = 0;
+	unsigned int self_intersects_polygons = 0;
+	unsigned int added_intersections_ll = 0;
+	unsigned int added_intersections_lp = 0;
+	unsigned int added_intersections_pp = 0;
+	unsigned int snapped_line_dangles = 0;
+	unsigned int simplified_vertices = 0;
+	unsigned int reversed_vertex_lists = 0;
+	int bad_attributes;
+	int reproj;
+
+	parser_data_store **storage; /* data storage for each input file */
+	geom_store *gs;
+	incremental_checkpoint *cp = NULL;
+
+
+	/* every run numbers its geometries from 1 (see geom_multiplex()) */
+	geom_set_next_id ( 1 );
+
+	/* incremental mode: continue where the last run stopped */
+	if ( opts->incremental == TRUE ) {
+		cp = incremental_begin ( opts );
+		if ( cp == NULL ) {
+			return (S2G_ERROR);
+		}
+		run->checkpoint = cp;
+		if ( cp->no_new_data == TRUE ) {
+			return (S2G_OK);
+		}
+	}
+
+	/* snapshot: use the data parsed by an earlier run, if it is still valid */
+	storage = NULL;
+	if ( opts->snapshot != NULL && opts->input_streams == NULL ) {
+		t_profile_start ( prof );
+		topo_errors = malloc ( sizeof ( unsigned int ) * opts->num_input );
+		storage = snapshot_load ( opts, parser, topo_errors, &fused_records, &duplicate_records );
+		if ( storage != NULL ) {
+			run->storage = storage;
+			run->num_input = opts->num_input;
+			run->topo_errors = topo_errors;
+			t_profile_stop ( prof, "snapshot", -1 );
+			s2g_warn_latlon ( opts );
+		} else {
+			free ( topo_errors );
+		}
+	}
+
+	/* otherwise: parse input and do the basic geometry processing */
+	if ( storage == NULL ) {
+		if ( s2g_parse_input ( opts, parser, prof, run, cp, &fused_records, &duplicate_records ) != S2G_OK ) {
+			return (S2G_ERROR);
+		}
+		storage = run->storage;
+		topo_errors = run->topo_errors;
+		if ( opts->snapshot != NULL && opts->input_streams == NULL ) {
+			snapshot_save ( opts, parser, storage, topo_errors, fused_records, duplicate_records );
+			t_profile_stop ( prof, "snapshot", -1 );
+		}
+	}
+
+	/* incremental mode: hold back the last geometry, if it may still be continued */
+	if ( cp != NULL ) {
+		incremental_hold ( cp, storage[0], parser, opts );
+	}
+
+	/* Advanced geometry processing */
+	gs = geom_store_new ();
+	run->gs = gs;
+	/* 1. Build points, lines and polygons (also multi-part). */
+	build_errors = geom_store_build ( gs, storage, parser, opts );
+	t_profile_stop ( prof, "build", build_errors );
+	if ( (gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons) < 1 ) {
+		if ( cp != NULL ) {
+			/* nothing to add: keep the checkpoint as it is */
+			err_show (ERR_NOTE, _("\nNo valid input data found in new data."));
+			return (S2G_OK);
+		}
+		err_show (ERR_EXIT, _("\nNo valid input data found. Aborting."));
+		return (S2G_ERROR);
+	}
+
+	/* apply selections (if any) to built geometries */
+	if ( selections_get_count ( opts ) > 0 ) {
+		t_profile_start ( prof );
+		selections_apply_all ( opts, parser, gs );
+		t_profile_stop ( prof, "selection", selections_get_num_selected ( GEOM_TYPE_ALL, gs ) );
+		if ( selections_get_num_selected ( GEOM_TYPE_ALL, gs ) < 1 ) {
+			if ( cp != NULL ) {
+				err_show (ERR_NOTE, _("\nNo valid input data left in new data after selecting."));
+				return (S2G_OK);
+			}
+			err_show (ERR_EXIT, _("\nNo valid input data left after selecting. Aborting."));
+			return (S2G_ERROR);
+		}
+	}
+
+	if ( geom_store_make_paths ( gs, opts, &error_msg[0] ) == 0 ) {
+
+		/* self-intersections can be present in lat/lon and X/Y data */
+		for ( i = 0; i < gs->num_lines; i ++ ) {
+			int j;
+			for ( j = 0; j < gs->lines[i].num_parts; j ++ ) {
+				self_intersects_lines += gs->lines[i].parts[j].err_self_intersects;
+			}
+		}
+		for ( i = 0; i < gs->num_polygons; i ++ ) {
+			int j;
+			for ( j = 0; j < gs->polygons[i].num_parts; j ++ ) {
+				self_intersects_polygons += gs->polygons[i].parts[j].err_self_intersects;
+			}
+		}
+
+		/* Most topo operations are untested for lat/lon data: WARN. */
+		if ( opts->topo_level > OPTIONS_TOPO_LEVEL_NONE && reproj_srs_in_latlon(opts) == TRUE ) {
+			err_show (ERR_WARN, _("\nHigh-level topological cleaning of lat/lon data not implemented."));
+			err_show (ERR_WARN, _("Output data may suffer from topological defects."));
+		}
+		
+		/* Run the following only if topological cleaning is enabled. */
+		if ( opts->topo_level > OPTIONS_TOPO_LEVEL_NONE ) {
+			/* LEVEL: BASIC AND ABOVE */
+			/* Snap polygon boundaries */
+			t_profile_start ( prof );
+			snaps_poly = geom_topology_snap_boundaries_2D ( gs, opts );
+			geom_tools_update_bboxes (gs); /* update bounding boxes */
+			t_profile_stop ( prof, "snap", snaps_poly );
+			
+			/* Perform geometric AND operation to subtract polygon overlap areas */
+			if ( opts->topo_level > OPTIONS_TOPO_LEVEL_BASIC ) {
+				/* LEVEL: FULL */
+				removed_overlaps = geom_topology_poly_remove_overlap_2D ( gs, parser, opts );
+				geom_tools_update_bboxes (gs); /* update bounding boxes */
+				t_profile_stop ( prof, "overlap", removed_overlaps );
+			}
+
+			/* Stamp holes into overlaid polygons. */
+			overlays = geom_topology_poly_overlay_2D ( gs, parser );
+			t_profile_stop ( prof, "overlay", overlays );
+
+			/* Add intersection vertices at line/line intersections. */
+			detected_intersections_ll = geom_topology_intersections_2D_detect ( gs, opts, GEOM_INTERSECT_LINE_LINE,
+					&added_intersections_ll, &topo_errors_after_fusion );
+			t_profile_stop ( prof, "intersect_ll", detected_intersections_ll );
+
+			/* Add intersection vertices at line/polygon boundary intersections. */
+			detected_intersections_lp = geom_topology_intersections_2D_detect ( gs, opts, GEOM_INTERSECT_LINE_POLY,
+					&added_intersections_lp, &topo_errors_after_fusion );
+			t_profile_stop ( prof, "intersect_lp", detected_intersections_lp );
+
+			/* Add intersection vertices at polygon boundary/polygon boundary intersections. */
+			detected_intersections_pp = geom_topology_intersections_2D_detect ( gs, opts, GEOM_INTERSECT_POLY_POLY,
+					&added_intersections_pp, &topo_errors_after_fusion );
+			t_profile_stop ( prof, "intersect_pp", detected_intersections_pp );
+
+			/* Clean dangling line nodes. */
+			if ( opts->topo_level > OPTIONS_TOPO_LEVEL_BASIC ) {
+				/* LEVEL: FULL */
+				snapped_line_dangles += geom_topology_clean_dangles_2D ( gs, opts, &topo_errors_after_fusion,
+						&detected_intersections_ll, &added_intersections_ll );
+				geom_tools_update_bboxes (gs); /* update bounding boxes */
+				t_profile_stop ( prof, "dangles", snapped_line_dangles );
+			}
+		}
+		/* Simplify lines and polygons (shared vertices stay in place). */
+		if ( opts->simplify_lines > 0.0 || opts->simplify_polys > 0.0 ) {
+			t_profile_start ( prof );
+			simplified_vertices = geom_topology_simplify_2D ( gs, opts );
+			geom_tools_update_bboxes (gs); /* update bounding boxes */
+			t_profile_stop ( prof, "simplify", simplified_vertices );
+		}
+		/* Unify vertex orders for polyons. */
+		t_profile_start ( prof );
+		if ( opts->format == PRG_OUTPUT_KML && opts->num_formats == 1 ) {
+			/* KML requires ccw vertex winding (see s2g_export_all() for more than one format) */
+			reversed_vertex_lists += geom_topology_sort_vertices ( gs, GEOM_WINDING_CCW );
+		} else {
+			/* default mode is auto-winding */
+			reversed_vertex_lists += geom_topology_sort_vertices ( gs, GEOM_WINDING_AUTO );
+		}
+		t_profile_stop ( prof, "winding", reversed_vertex_lists );
+		/* DEBUG */
+		/* geom_store_print ( gs, FALSE ); */
+	} else {
+		if ( strlen (error_msg) > 0 ) {
+			err_show (ERR_EXIT, _("\nUnable to create output file. Error was: '%s'."), error_msg );
+		}
+		return (S2G_ERROR);
+	}
+
+	/* Sort geometries in spatial order, if required.
+	   (Bounding boxes are only valid before reprojection.) */
+	if ( opts->hilbert_order == TRUE ) {
+		t_profile_start ( prof );
+		geom_store_sort_hilbert ( gs );
+		t_profile_stop ( prof, "hilbert", -1 );
+	}
+
+	/* Reproject if required. */
+	reproj = reproj_need_reprojection ( opts );
+	if ( reproj == REPROJ_ACTION_ERROR ) {
+		/* error message already produced by reproj_need_reprojection() */
+		return (S2G_ERROR);
+	}
+	if ( reproj == REPROJ_ACTION_REPROJECT ) {
+		if ( opts->orient_mode == OPTIONS_ORIENT_MODE_LOCAL_XZ ) {
+			err_show (ERR_EXIT, _("\nCannot combine mode '%s' with reprojection. Aborting."),
+					OPTIONS_ORIENT_MODE_NAMES[opts->orient_mode]);
+			return (S2G_ERROR);
+		}
+		t_profile_start ( prof );
+		int reproj_status = reproj_do( opts, gs );
+		t_profile_stop ( prof, "reproject", -1 );
+		if ( reproj_status == REPROJ_STATUS_ERROR ) {
+			err_show (ERR_EXIT, _("\nFailed to reproject data. Aborting."));
+			return (S2G_ERROR);
+		}
+	}
+
+	/* remove geometry marker from label field contents, if required */
+	clean_label_atts ( opts, parser, gs );
+
+	/* create output */
+	t_profile_start ( prof );
+	if ( cp != NULL ) {
+		/* incremental mode: cut off anything written after the last checkpoint,
+		   then append finished geometries, take new checkpoint, append the rest */
+		int num_selected;
+		if ( incremental_rollback ( cp, gs, opts ) != 0 ) {
+			return (S2G_ERROR);
+		}
+		bad_attributes = 0;
+		num_selected = incremental_select ( cp, gs, INCREMENTAL_SELECT_FINISHED );
+		if ( num_selected > 0 ) {
+			opts->append_ids = cp->num_features;
+			if ( s2g_export ( gs, parser, opts, &bad_attributes ) != S2G_OK ) {
+				return (S2G_ERROR);
+			}
+		}
+		incremental_commit ( cp, gs, opts, num_selected );
+		if ( incremental_select ( cp, gs, INCREMENTAL_SELECT_HELD ) > 0 ) {
+			int bad_held = 0;
+			opts->append_ids = cp->num_features;
+			if ( s2g_export ( gs, parser, opts, &bad_held ) != S2G_OK ) {
+				return (S2G_ERROR);
+			}
+			bad_attributes += bad_held;
+		}
+		incremental_select ( cp, gs, INCREMENTAL_SELECT_ALL );
+		incremental_end ( cp, opts );
+	} else if ( opts->num_formats > 1 ) {
+		if ( s2g_export_all ( gs, parser, opts, run, &bad_attributes, &reversed_vertex_lists ) != S2G_OK ) {
+			return (S2G_ERROR);
+		}
+	} else {
+		if ( s2g_export ( gs, parser, opts, &bad_attributes ) != S2G_OK ) {
+			return (S2G_ERROR);
+		}
+	}
+
+	t_profile_stop ( prof, "export", bad_attributes );
+
+	/* show final statistics for each input file */
+	show_stats ( topo_errors, opts, storage );
+
+	/* selection statistics */
+	err_show (ERR_NOTE, _("\nSelected for export:"));
+	err_show (ERR_NOTE, _("\tPoints: %i."), selections_get_num_selected ( GEOM_TYPE_POINT, gs ));
+	if ( opts->dump_raw == TRUE ) {
+		err_show (ERR_NOTE, _("\tRaw points: %i."), selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs ));
+	}
+	err_show (ERR_NOTE, _("\tLines: %i."), selections_get_num_selected ( GEOM_TYPE_LINE, gs ));
+	err_show (ERR_NOTE, _("\tPolygons: %i."), selections_get_num_selected ( GEOM_TYPE_POLY, gs ));
+	/* show total data extent */
+	if ( reproj == TRUE ) {
+		err_show (ERR_NOTE, _("\nTotal data extent (after reprojection):"));
+	} else {
+		err_show (ERR_NOTE, _("\nTotal data extent:"));
+	}
+	err_show (ERR_NOTE, _("\tX range: from %f to %f."), gs->min_x, gs->max_x);
+	err_show (ERR_NOTE, _("\tY range: from %f to %f."), gs->min_y, gs->max_y);
+	if ( opts->force_2d == FALSE ) {
+		err_show (ERR_NOTE, _("\tZ range: from %f to %f."), gs->min_z, gs->max_z);
+	}
+
+	/* show summmary statistics for all input files */
+	err_show (ERR_NOTE, _("\nParts added to multi-part geometries: %i"), fused_records );
+
+	if ( build_errors > 0 )
+		err_show (ERR_NOTE, _("\nGeometry build errors: %i"), build_errors );
+
+	if ( duplicate_records > 0 )
+		err_show (ERR_NOTE, _("\nInput contained duplicate attribute values that should be unique."));
+
+	if ( bad_attributes > 0 )
+		err_show (ERR_NOTE, _("\nAttribute write errors: %i"), bad_attributes );
+
+	err_show (ERR_NOTE, _("\nDetected line self-intersections: %i"), self_intersects_lines );
+
+	err_show (ERR_NOTE, _("\nDetected polygon self-intersections: %i"), self_intersects_polygons );
+
+	err_show (ERR_NOTE, _("\nDetected polygon overlays: %i"), overlays );
+
+	err_show (ERR_NOTE, _("\nRemoved polygon overlap areas: %i"), removed_overlaps );
+
+	err_show (ERR_NOTE, _("\nSnapped polygon boundary vertices: %i"), snaps_poly );
+
+	err_show (ERR_NOTE, _("\nDetected line/line intersections: %i"), detected_intersections_ll );
+
+	err_show (ERR_NOTE, _("\nAdded vertices at line/line intersections: %i"), added_intersections_ll );
+
+	err_show (ERR_NOTE, _("\nDetected line/polygon intersections: %i"), detected_intersections_lp );
+
+	err_show (ERR_NOTE, _("\nAdded vertices at line/polygon intersections: %i"), added_intersections_lp );
+
+	err_show (ERR_NOTE, _("\nDetected polygon/polygon intersections: %i"), detected_intersections_pp );
+
+	err_show (ERR_NOTE, _("\nAdded vertices at polygon/polygon intersections: %i"), added_intersections_pp );
+
+	err_show (ERR_NOTE, _("\nSnapped dangling line nodes: %i"), snapped_line_dangles );
+
+	if ( opts->simplify_lines > 0.0 || opts->simplify_polys > 0.0 ) {
+		err_show (ERR_NOTE, _("\nVertices removed by simplification: %i"), simplified_vertices );
+	}
+
+	err_show (ERR_NOTE, _("\nCorrected vertex order of polygon boundaries and holes: %i"), reversed_vertex_lists );
+
+	err_show (ERR_NOTE, _("\nAdditional topological errors in built geometries: %i"), topo_errors_after_fusion );
+
+	/* check for any output produced */
+	if ( (gs->num_points + gs->num_points_raw + gs->num_lines + gs->num_polygons) > 0 ) {
+		err_show (ERR_NOTE, _("\nOutput files produced:") );
+		if ( run->num_exports > 0 ) {
+			for ( i = 0; i < run->num_exports; i ++ ) {
+				s2g_show_outputs ( &run->exports[i].gs, &run->exports[i].opts );
+			}
+		} else {
+			s2g_show_outputs ( gs, opts );
+		}
+	} else {
+		err_show (ERR_NOTE, _("\nNo output files produced.") );
+	}
+
+	/* show run-time profile (if requested) */
+	show_profile ( prof, opts );
+
+
+	return (S2G_OK);
+}
+
+
+/*
+ * LIBRARY INTERFACE
+ */
+
+
+/*
+ * Helper function for s2g_context_create():
+ * Initializes the process-wide settings, unless this
+ * has already been done by the host program (or
+ * an earlier context).
+ */
+void s2g_init ( void )
+{
+	if ( PRG_NAME_CLI != NULL ) {
+		return;
+	}
+
+	PRG_NAME_CLI = strdup(PRG_NAME_DEFAULT);
+	PRG_PATH_CLI = strdup("");
+	PRG_DIR_CLI = strdup("");
+
+	/* the library never shows the GUI */
+	OPTIONS_GUI_MODE = FALSE;
+	OPTIONS_FORCE_ENGLISH = FALSE;
+
+	/* initialize i18n translation engine */
+	i18n_init ();
+}
+
+
+/*
+ * Helper function for all library functions that may produce messages:
+ * Discards the messages of the last call, then makes sure that all new
+ * messages go to the context's queue and that fatal errors return to
+ * the context's trap (which must be set by the caller, right after this).
+ */
+void s2g_call_begin ( s2g_context *ctx )
+{
+	err_queue_free ( &ctx->msgs );
+	if ( ctx->error != NULL ) {
+		free ( ctx->error );
+		ctx->error = NULL;
+	}
+	err_queue_attach ( &ctx->msgs );
+	err_trap_attach ( &ctx->trap );
+}
+
+
+/*
+ * Helper function for all library functions that may produce messages:
+ * Restores normal message handling and returns "status".
+ * If "status" is S2G_ERROR, then the last error message is kept
+ * as the context's error message (see s2g_get_error()).
+ */
+int s2g_call_end ( s2g_context *ctx, int status )
+{
+	int i;
+
+	err_trap_attach ( NULL );
+	err_queue_attach ( NULL );
+
+	if ( status != S2G_OK ) {
+		for ( i = ctx->msgs.num-1; i >= 0; i -- ) {
+			if ( ctx->msgs.types[i] == ERR_EXIT ) {
+				ctx->error = strdup ( ctx->msgs.msgs[i] );
+				break;
+			}
+		}
+		if ( ctx->error == NULL ) {
+			ctx->error = strdup ( _("Processing failed.") );
+		}
+	}
+
+	return (status);
+}
+
+
+/*
+ * Helper function for s2g_process_files() and s2g_process_buffer():
+ * Releases the settings and data of the current run, so that the
+ * context is ready for the next one.
+ */
+void s2g_call_reset ( s2g_context *ctx )
+{
+	int i;
+	options *opts = ctx->opts;
+
+	s2g_run_free ( &ctx->run );
+
+	if ( opts->input_streams != NULL ) {
+		for ( i = 0; i < opts->num_input; i ++ ) {
+			if ( opts->input_streams[i] != NULL )
+				fclose ( opts->input_streams[i] );
+		}
+		free ( opts->input_streams );
+		opts->input_streams = NULL;
+	}
+	if ( opts->input != NULL ) {
+		for ( i = 0; opts->input[i] != NULL; i ++ ) {
+			free ( opts->input[i] );
+		}
+		free ( opts->input );
+		opts->input = NULL;
+	}
+	opts->num_input = 0;
+	if ( opts->output != NULL ) {
+		free ( opts->output );
+		opts->output = NULL;
+	}
+	if ( opts->base != NULL ) {
+		free ( opts->base );
+		opts->base = NULL;
+	}
+}
+
+
+/*
+ * Helper function for s2g_process_files() and s2g_process_buffer():
+ * Releases the summary of the previous run.
+ */
+void s2g_result_clear ( s2g_result *result )
+{
+	int i;
+
+	for ( i = 0; i < S2G_MAX_OUTPUT_FILES; i ++ ) {
+		if ( result->output_files[i] != NULL ) {
+			free ( result->output_files[i] );
+		}
+	}
+	memset ( result, 0, sizeof (s2g_result) );
+}
+
+
+/*
+ * Helper function for s2g_result_set():
+ * Adds one output file name to the summary.
+ */
+void s2g_result_add_file ( s2g_result *result, const char *path )
+{
+	int i;
+
+	if ( path == NULL ) {
+		return;
+	}
+	for ( i = 0; i < S2G_MAX_OUTPUT_FILES; i ++ ) {
+		if ( result->output_files[i] == NULL ) {
+			result->output_files[i] = strdup ( path );
+			return;
+		}
+	}
+}
+
+
+/*
+ * Helper function for s2g_result_set():
+ * Adds the names of the output files in "gs" to the summary.
+ */
+void s2g_result_add_files ( s2g_result *result, geom_store *gs, options *opts )
+{
+	if ( result->num_points > 0 )
+		s2g_result_add_file ( result, gs->path_points );
+	if ( result->num_points_raw > 0 )
+		s2g_result_add_file ( result, gs->path_points_raw );
+	if ( result->num_lines > 0 )
+		s2g_result_add_file ( result, gs->path_lines );
+	if ( result->num_polygons > 0 )
+		s2g_result_add_file ( result, gs->path_polys );
+	if ( opts->label_field != NULL )
+		s2g_result_add_file ( result, gs->path_labels );
+	s2g_result_add_file ( result, gs->path_all );
+	s2g_result_add_file ( result, gs->path_all_atts );
+}
+
+
+/*
+ * Helper function for s2g_process_files() and s2g_process_buffer():
+ * Fills in the summary of a successful run. The counts and file names
+ * are the same as those reported by the command line program.
+ */
+void s2g_result_set ( s2g_context *ctx )
+{
+	int i, j;
+	s2g_run *run = &ctx->run;
+	s2g_result *result = &ctx->result;
+	geom_store *gs = run->gs;
+
+
+	for ( i = 0; i < run->num_input; i ++ ) {
+		for ( j = 0; j < run->storage[i]->num_records; j ++ ) {
+			if ( !( run->storage[i]->flags[j] & PARSER_RECORD_EMPTY ) ) {
+				result->num_records ++;
+				if ( !( run->storage[i]->flags[j] & PARSER_RECORD_VALID ) ) {
+					result->num_invalid ++;
+				}
+			}
+		}
+		result->num_topo_errors += run->topo_errors[i];
+	}
+
+	if ( gs == NULL ) {
+		/* incremental mode, no new data */
+		return;
+	}
+
+	result->num_points = selections_get_num_selected ( GEOM_TYPE_POINT, gs );
+	result->num_points_raw = selections_get_num_selected ( GEOM_TYPE_POINT_RAW, gs );
+	result->num_lines = selections_get_num_selected ( GEOM_TYPE_LINE, gs );
+	result->num_polygons = selections_get_num_selected ( GEOM_TYPE_POLY, gs );
+
+	if ( run->num_exports > 0 ) {
+		for ( i = 0; i < run->num_exports; i ++ ) {
+			s2g_result_add_files ( result, &run->exports[i].gs, ctx->opts );
+		}
+	} else {
+		s2g_result_add_files ( result, gs, ctx->opts );
+	}
+}
+
+
+/*
+ * Helper function for s2g_process_files() and s2g_process_buffer():
+ * Sets output folder and base name for the next run. If either is
+ * NULL, then the one given at setup time is used.
+ *
+ * Returns S2G_OK or S2G_ERROR (with a message in the context's queue).
+ */
+int s2g_set_output ( s2g_context *ctx, const char *output, const char *base )
+{
+	options *opts = ctx->opts;
+	int len;
+
+
+	if ( output == NULL )
+		output = ctx->output;
+	if ( base == NULL )
+		base = ctx->base;
+
+	if ( output == NULL || t_is_legal_path (output) == FALSE ) {
+		err_show ( ERR_EXIT, _("\"%s\" is not a valid directory (folder) name."), output == NULL ? "" : output );
+		return (S2G_ERROR);
+	}
+	if ( base == NULL || t_is_legal_name (base) == FALSE ) {
+		err_show ( ERR_EXIT, _("\"%s\" is not a valid output file (base) name."), base == NULL ? "" : base );
+		return (S2G_ERROR);
+	}
+
+	opts->output = strdup ( output );
+	opts->base = strdup ( base );
+
+	/* remove any trailing file separator char(s) from output folder path */
+	len = strlen(opts->output);
+	len--;
+	while ( len > 0 && opts->output[len] == PRG_FILE_SEPARATOR ) {
+		opts->output[len] = '\0';
+		len--;
+	}
+
+	return (S2G_OK);
+}
+
+
+/*
+ * Helper function for s2g_process_files() and s2g_process_buffer():
+ * Runs the pipeline with the input and output settings already
+ * stored in the context's options.
+ */
+int s2g_process ( s2g_context *ctx )
+{
+	t_profile prof;
+	int status;
+
+
+	t_profile_init ( &prof, ctx->opts->profile );
+	status = s2g_run_pipeline ( ctx->opts, ctx->parser, &prof, &ctx->run );
+	if ( status == S2G_OK ) {
+		s2g_result_set ( ctx );
+	}
+
+	return (status);
+}
+
+
+/*
+ * Helper function for s2g_context_setup():
+ * Releases the parser schema after a failed setup, so that
+ * the context cannot be used for processing.
+ */
+void s2g_setup_abort ( s2g_context *ctx )
+{
+	if ( ctx->parser != NULL ) {
+		parser_desc_destroy ( ctx->parser );
+		ctx->parser = NULL;
+	}
+}
+
+
+/*
+ * Creates a new, empty library context.
+ * The context must be set up with s2g_context_setup() before
+ * any data can be processed with it.
+ */
+s2g_context *s2g_context_create ( void )
+{
+	s2g_context *ctx;
+
+
+	s2g_init ();
+
+	ctx = malloc ( sizeof (s2g_context) );
+	memset ( ctx, 0, sizeof (s2g_context) );
+	err_queue_init ( &ctx->msgs );
+
+	return (ctx);
+}
+
+
+/*
+ * Sets up a library context: "argc" and "argv" are the same as for the
+ * command line program ("argv[0]" is ignored, "argv" must be NULL
+ * terminated). They must at least specify a parser schema file ("-p").
+ * The schema is read and validated and the reprojection settings are
+ * checked, once, for all later runs with this context.
+ *
+ * Input file names, if any, are ignored. Output folder ("-o") and base
+ * name ("-n") are required, as on the command line: they are used for
+ * all runs that do not give their own. Help ("-h") and schema dump ("-v")
+ * are not available, and messages are never written to a log file.
+ *
+ * Returns S2G_OK or S2G_ERROR. A context can only be set up once.
+ */
+int s2g_context_setup ( s2g_context *ctx, int argc, char *argv[] )
+{
+	int num_errors;
+	int i;
+
+
+	s2g_call_begin ( ctx );
+	if ( setjmp ( ctx->trap ) != 0 ) {
+		return ( s2g_call_end ( ctx, S2G_ERROR ) );
+	}
+
+	if ( ctx->opts != NULL ) {
+		err_show ( ERR_EXIT, _("Library context has already been set up.") );
+	}
+
+	/* from here on, a failed setup leaves the context without a schema */
+	if ( setjmp ( ctx->trap ) != 0 ) {
+		s2g_setup_abort ( ctx );
+		return ( s2g_call_end ( ctx, S2G_ERROR ) );
+	}
+
+	/* private copy of the options */
+	ctx->argc = argc;
+	ctx->argv = malloc ( sizeof (char*) * (argc+1) );
+	for ( i = 0; i < argc; i ++ ) {
+		ctx->argv[i] = strdup ( argv[i] == NULL ? "" : argv[i] );
+	}
+	ctx->argv[argc] = NULL;
+
+	ctx->opts = options_create ( ctx->argc, ctx->argv );
+
+	for ( i = 0; i < ctx->argc; i++  ) {
+		if (!strcmp ( "--english", ctx->argv[i]) ||
+				!strcmp ( "-e", ctx->argv[i] )  )
+		{
+			OPTIONS_FORCE_ENGLISH = TRUE;
+			ctx->opts->force_english = TRUE;
+		}
+		if (!strcmp ( "--help", ctx->argv[i]) ||
+				!strcmp ( "-h", ctx->argv[i] )  )
+		{
+			err_show ( ERR_EXIT, _("Option '%s' cannot be used here."), ctx->argv[i] );
+		}
+	}
+	if ( ctx->opts->force_english == TRUE ) {
+		i18n_force_english();
+	}
+
+	/* report all invalid options, then fail: options_parse() would leak
+	   its option values if a fatal error did not return */
+	err_trap_attach ( NULL );
+	num_errors = options_parse ( ctx->opts );
+	err_trap_attach ( &ctx->trap );
+	if ( num_errors > 0 ) {
+		s2g_setup_abort ( ctx );
+		return ( s2g_call_end ( ctx, S2G_ERROR ) );
+	}
+	if ( ctx->opts->just_dump_parser == TRUE ) {
+		err_show ( ERR_EXIT, _("Option '%s' cannot be used here."), "-v" );
+	}
+
+	/* keep default output settings; each run sets its own */
+	if ( ctx->opts->output != NULL )
+		ctx->output = strdup ( ctx->opts->output );
+	if ( ctx->opts->base != NULL )
+		ctx->base = strdup ( ctx->opts->base );
+	s2g_call_reset ( ctx );
+
+	/* initialize reprojection engine */
+	reproj_init( ctx->opts );
+
+	/* read and check parser schema */
+	ctx->parser = parser_desc_create ();
+	parser_desc_set ( ctx->parser, ctx->opts );
+	if ( ctx->parser->empty == TRUE ) {
+		err_show ( ERR_EXIT, _("Parser schema is empty.") );
+	}
+	if ( s2g_prepare ( ctx->opts, ctx->parser ) != S2G_OK ) {
+		s2g_setup_abort ( ctx );
+		return ( s2g_call_end ( ctx, S2G_ERROR ) );
+	}
+
+	return ( s2g_call_end ( ctx, S2G_OK ) );
+}
+
+
+/*
+ * Processes one or more input files with a library context that
+ * has been set up successfully. Output is written to folder "output",
+ * using base name "base" (either can be NULL, to use the ones given
+ * at setup time).
+ *
+ * Returns S2G_OK or S2G_ERROR. Data produced by the run has been
+ * released either way, but the summary of a successful run can be
+ * read with s2g_get_result().
+ */
+int s2g_process_files ( s2g_context *ctx, const char *output, const char *base,
+		int num_input, const char **input )
+{
+	int i;
+
+
+	s2g_call_begin ( ctx );
+	if ( setjmp ( ctx->trap ) != 0 ) {
+		s2g_call_reset ( ctx );
+		return ( s2g_call_end ( ctx, S2G_ERROR ) );
+	}
+
+	s2g_result_clear ( &ctx->result );
+	if ( ctx->parser == NULL ) {
+		err_show ( ERR_EXIT, _("Library context has not been set up.") );
+	}
+	if ( num_input < 1 ) {
+		err_show ( ERR_EXIT, _("No input files.") );
+	}
+	for ( i = 0; i < num_input; i ++ ) {
+		if ( input[i] == NULL || t_is_legal_path (input[i]) == FALSE ) {
+			err_show ( ERR_EXIT, _("\"%s\" is not a valid file path."), input[i] == NULL ? "" : input[i] );
+		}
+	}
+
+	if ( s2g_set_output ( ctx, output, base ) == S2G_OK ) {
+		ctx->opts->input = malloc ( sizeof (char*) * (num_input+1) );
+		for ( i = 0; i < num_input; i ++ ) {
+			ctx->opts->input[i] = strdup ( input[i] );
+		}
+		ctx->opts->input[num_input] = NULL;
+		ctx->opts->num_input = num_input;
+		if ( s2g_process ( ctx ) == S2G_OK ) {
+			s2g_call_reset ( ctx );
+			return ( s2g_call_end ( ctx, S2G_OK ) );
+		}
+	}
+
+	s2g_call_reset ( ctx );
+	return ( s2g_call_end ( ctx, S2G_ERROR ) );
+}
+
+
+/*
+ * Same as s2g_process_files(), but the input data is read from
+ * memory: "data" holds "len" bytes of input (in the same format
+ * as an input file). "name" is only used in messages.
+ */
+int s2g_process_buffer ( s2g_context *ctx, const char *output, const char *base,
+		const char *name, const char *data, size_t len )
+{
+	FILE *in;
+
+
+	s2g_call_begin ( ctx );
+	if ( setjmp ( ctx->trap ) != 0 ) {
+		s2g_call_reset ( ctx );
+		return ( s2g_call_end ( ctx, S2G_ERROR ) );
+	}
+
+	s2g_result_clear ( &ctx->result );
+	if ( ctx->parser == NULL ) {
+		err_show ( ERR_EXIT, _("Library context has not been set up.") );
+	}
+	if ( data == NULL || len < 1 ) {
+		err_show ( ERR_EXIT, _("No input data.") );
+	}
+
+	if ( s2g_set_output ( ctx, output, base ) == S2G_OK ) {
+		/* turn buffer into a stream for the parser */
+#ifdef MINGW
+		in = tmpfile ();
+		if ( in != NULL ) {
+			if ( fwrite ( data, 1, len, in ) != len ) {
+				fclose ( in );
+				in = NULL;
+			} else {
+				rewind ( in );
+			}
+		}
+#else
+		in = fmemopen ( (void*) data, len, "r" );
+#endif
+		if ( in == NULL ) {
+			err_show ( ERR_EXIT, _("Cannot open input buffer for reading.\nReason: %s"),
+					strerror (errno));
+		}
+		ctx->opts->input = malloc ( sizeof (char*) * 2 );
+		ctx->opts->input[0] = strdup ( name == NULL ? "-" : name );
+		ctx->opts->input[1] = NULL;
+		ctx->opts->input_streams = malloc ( sizeof (FILE*) );
+		ctx->opts->input_streams[0] = in;
+		ctx->opts->num_input = 1;
+		if ( s2g_process ( ctx ) == S2G_OK ) {
+			s2g_call_reset ( ctx );
+			return ( s2g_call_end ( ctx, S2G_OK ) );
+		}
+	}
+
+	s2g_call_reset ( ctx );
+	return ( s2g_call_end ( ctx, S2G_ERROR ) );
+}
+
+
+/*
+ * Returns the number of messages (notes, warnings and errors)
+ * produced by the last library call.
+ */
+int s2g_get_num_messages ( s2g_context *ctx )
+{
+	return ( ctx->msgs.num );
+}
+
+
+/*
+ * Returns message no. "i" (0 = first) produced by the last library
+ * call, and stores its type (ERR_NOTE, ERR_WARN or ERR_EXIT) in "type"
+ * (if not NULL). Returns NULL if there is no such message.
+ * The message remains valid until the next library call.
+ */
+const char *s2g_get_message ( s2g_context *ctx, int i, unsigned short *type )
+{
+	if ( i < 0 || i >= ctx->msgs.num ) {
+		return (NULL);
+	}
+	if ( type != NULL ) {
+		*type = ctx->msgs.types[i];
+	}
+	return ( ctx->msgs.msgs[i] );
+}
+
+
+/*
+ * Returns the error message, if the last library call failed.
+ * Returns NULL otherwise.
+ */
+const char *s2g_get_error ( s2g_context *ctx )
+{
+	return ( ctx->error );
+}
+
+
+/*
+ * Returns the summary of the last successful run (all counts are
+ * "0" and the list of output files is empty, if the last run failed).
+ */
+const s2g_result *s2g_get_result ( s2g_context *ctx )
+{
+	return ( &ctx->result );
+}
+
+
+/*
+ * Sets a function that will be called with each message (and its
+ * type) as soon as a library call produces it, e.g. to show the
+ * progress of a long run. The messages will still be available
+ * via s2g_get_message(), after the call. Pass NULL to remove
+ * the function.
+ */
+void s2g_set_message_hook ( s2g_context *ctx, err_queue_hook hook, void *data )
+{
+	err_queue_set_hook ( &ctx->msgs, hook, data );
+}
+
+
+/*
+ * Destroys a library context and releases all its memory.
+ * Process-wide caches (reprojection objects, EPSG definitions)
+ * are kept for other contexts.
+ */
+void s2g_context_destroy ( s2g_context *ctx )
+{
+	int i;
+
+
+	if ( ctx == NULL ) {
+		return;
+	}
+
+	if ( ctx->opts != NULL ) {
+		s2g_call_reset ( ctx );
+		options_destroy ( ctx->opts );
+	}
+	if ( ctx->parser != NULL ) {
+		parser_desc_destroy ( ctx->parser );
+	}
+	if ( ctx->argv != NULL ) {
+		for ( i = 0; i < ctx->argc; i ++ ) {
+			free ( ctx->argv[i] );
+		}
+		free ( ctx->argv );
+	}
+	if ( ctx->output != NULL )
+		free ( ctx->output );
+	if ( ctx->base != NULL )
+		free ( ctx->base );
+	err_queue_free ( &ctx->msgs );
+	if ( ctx->error != NULL )
+		free ( ctx->error );
+	s2g_result_clear ( &ctx->result );
+	free ( ctx );
+}
@@ -0,0 +1,164 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	s2g.h
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	The complete processing pipeline (parsing, geometry building,
+ * 				topological cleaning, reprojection and export) and a
+ * 				library interface to it ("libsurvey2gis").
+ *
+ * 				The library interface keeps all settings, the parsed schema
+ * 				and the reprojection setup in a context object, so that
+ * 				any number of input files or memory buffers can be
+ * 				converted in-process without repeating that setup. Fatal
+ * 				errors end the current call (instead of the process) and
+ * 				all messages are returned to the caller.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <setjmp.h>
+#include <stdio.h>
+
+#include "global.h"
+
+#include "errors.h"
+#include "geom.h"
+#include "incremental.h"
+#include "options.h"
+#include "parser.h"
+#include "tools.h"
+
+
+#ifndef S2G_H
+#define S2G_H
+
+/* return values of all library functions */
+#define S2G_OK		0
+#define S2G_ERROR	1
+
+/* max. number of output file names reported in a result */
+#define S2G_MAX_OUTPUT_FILES	64
+
+/*
+ * Writing the geometries of a run to one of several output
+ * formats ("--format=" with more than one format).
+ */
+typedef struct s2g_export_job s2g_export_job;
+struct s2g_export_job
+{
+	geom_store gs; /* view of the run's geometries, with this format's output paths */
+	parser_desc *parser;
+	options opts; /* copy of the run's options, for this format only */
+	int bad_attributes; /* attribute write errors */
+	int status; /* S2G_OK or S2G_ERROR */
+	err_queue messages; /* messages produced while writing */
+};
+
+/*
+ * Data produced while processing one set of input files.
+ * All of this is released by s2g_run_free(), even if the
+ * run was interrupted by a fatal error.
+ */
+typedef struct s2g_run s2g_run;
+struct s2g_run
+{
+	int num_input; /* number of data stores in "storage" */
+	parser_data_store **storage; /* data storage for each input file */
+	unsigned int *topo_errors; /* topological error count for each input file */
+	geom_store *gs; /* built geometries */
+	incremental_checkpoint *checkpoint; /* incremental mode state (or NULL) */
+	int num_exports; /* number of jobs in "exports" */
+	s2g_export_job *exports; /* one job for each output format (if more than one) */
+};
+
+/*
+ * Summary of the last successful run of a library context.
+ */
+typedef struct s2g_result s2g_result;
+struct s2g_result
+{
+	unsigned int num_records; /* input records read (all inputs) */
+	unsigned int num_invalid; /* invalid input records (all inputs) */
+	unsigned int num_points; /* points selected for export */
+	unsigned int num_points_raw; /* raw vertices selected for export */
+	unsigned int num_lines; /* lines selected for export */
+	unsigned int num_polygons; /* polygons selected for export */
+	unsigned int num_topo_errors; /* topological errors (all inputs) */
+	char *output_files[S2G_MAX_OUTPUT_FILES+1]; /* NULL terminated list of files written */
+};
+
+/*
+ * A library context. Create with s2g_context_create(), set up once
+ * with s2g_context_setup(), then run s2g_process_files() and/or
+ * s2g_process_buffer() as often as needed.
+ *
+ * Contexts are not thread-safe: Like the command line program, the
+ * pipeline uses some process-wide state (numeric locale, 2D mode).
+ * Only one context may be processing at any time.
+ */
+typedef struct s2g_context s2g_context;
+struct s2g_context
+{
+	int argc; /* private copy of the options used in s2g_context_setup() */
+	char **argv;
+	options *opts; /* settings shared by all runs */
+	char *output; /* default output folder and base name (from setup options, may be NULL) */
+	char *base;
+	parser_desc *parser; /* parsed and validated schema (NULL until setup succeeded) */
+	err_queue msgs; /* messages produced by the last call */
+	char *error; /* last fatal error message (NULL if none) */
+	s2g_result result; /* summary of last run */
+	s2g_run run; /* data of the current run */
+	jmp_buf trap; /* return point for fatal errors */
+};
+
+/* release all data of a pipeline run */
+void s2g_run_free ( s2g_run *run );
+
+/* run the processing pipeline on the input files in "opts" */
+int s2g_run_pipeline ( options *opts, parser_desc *parser, t_profile *prof, s2g_run *run );
+
+/* check the schema and the reprojection, label and selection settings */
+int s2g_prepare ( options *opts, parser_desc *parser );
+
+/* create a new, empty library context */
+s2g_context *s2g_context_create ( void );
+
+/* parse options, load schema and set up reprojection for a library context */
+int s2g_context_setup ( s2g_context *ctx, int argc, char *argv[] );
+
+/* process a list of input files with a library context */
+int s2g_process_files ( s2g_context *ctx, const char *output, const char *base,
+		int num_input, const char **input );
+
+/* process input data from a memory buffer with a library context */
+int s2g_process_buffer ( s2g_context *ctx, const char *output, const char *base,
+		const char *name, const char *data, size_t len );
+
+/* get the number of messages produced by the last library call */
+int s2g_get_num_messages ( s2g_context *ctx );
+
+/* get one message (and its type) produced by the last library call */
+const char *s2g_get_message ( s2g_context *ctx, int i, unsigned short *type );
+
+/* get the fatal error message of the last library call (or NULL) */
+const char *s2g_get_error ( s2g_context *ctx );
+
+/* get the summary of the last successful run */
+const s2g_result *s2g_get_result ( s2g_context *ctx );
+
+/* pass each message of later library calls to "hook" as soon as it is produced */
+void s2g_set_message_hook ( s2g_context *ctx, err_queue_hook hook, void *data );
+
+/* destroy a library context */
+void s2g_context_destroy ( s2g_context *ctx );
+
+#endif /* S2G_H */
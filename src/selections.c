@@ -882,9 +882,9 @@ BOOLEAN selection_apply_one ( short seltype, BOOLEAN case_sensitive, short field
 			char *upper_expr = t_str_to_upper ( expr );
 			if ( strstr ( upper_content, upper_expr ) != 0 ) {
 				match = TRUE;
-				free ( upper_content );
-				free ( upper_expr );
 			}
+			free ( upper_content );
+			free ( upper_expr );
 		}
 	}
 
@@ -135,6 +135,9 @@ short selection_get_geomtype ( char *seltype );
 /* Apply all specified selections to a geometry store */
 void selections_apply_all ( options *opt, parser_desc *parser, geom_store *gs );
 
+/* Check if a field value passes one selection expression */
+BOOLEAN selection_apply_one ( short seltype, BOOLEAN case_sensitive, short field_type, char *content, char *expr );
+
 /* Return total number of selected geometry of a specified type */
 int selections_get_num_selected ( short geom_type, geom_store *gs );
 
@@ -0,0 +1,1031 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	serve.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Server mode: accepts job requests on a Unix domain
+ * 				socket ("--serve=").
+ *
+ * 				See serve.h for details.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef MINGW
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "global.h"
+
+#include "errors.h"
+#include "i18n.h"
+#include "options.h"
+#include "s2g.h"
+#include "serve.h"
+#include "tools.h"
+
+
+#ifdef MINGW
+
+/*
+ * There are no Unix domain sockets (and no fork()) on Windows.
+ */
+int serve_run ( options *opts )
+{
+	err_show ( ERR_EXIT, _("Option '%s' is not available on this system."), "--serve=" );
+	return (1);
+}
+
+#else
+
+/* set by the signal handler, to shut down the server */
+static volatile sig_atomic_t SERVE_STOP = 0;
+
+
+/*
+ * Signal handler: Ends the server loop after the current request.
+ */
+void serve_stop ( int sig )
+{
+	SERVE_STOP = 1;
+}
+
+
+/*
+ * JSON REQUEST PARSING
+ * Only what is needed to read a job request: an object with
+ * string and string array members. Members of other types
+ * are skipped.
+ */
+
+
+/*
+ * Helper function for all JSON parsing functions:
+ * Moves "p" past any white space.
+ */
+void serve_json_skip_ws ( const char **p )
+{
+	while ( **p != '\0' && isspace ( (unsigned char) **p ) ) {
+		(*p) ++;
+	}
+}
+
+
+/*
+ * Reads a JSON string at "p" (which must point to the opening quote)
+ * and moves "p" past it. Escaped characters are decoded (\u escapes
+ * into UTF-8). Returns a new string or NULL if the string is invalid.
+ */
+char *serve_json_string ( const char **p )
+{
+	char *str;
+	const char *s = *p;
+	unsigned int code;
+	int len = 0;
+	int i;
+
+
+	if ( *s != '"' ) {
+		return (NULL);
+	}
+	s ++;
+	/* the decoded string is never longer than the encoded one */
+	str = malloc ( sizeof (char) * (strlen (s) + 1) );
+	while ( *s != '"' ) {
+		if ( *s == '\0' || (unsigned char) *s < 0x20 ) {
+			free ( str );
+			return (NULL);
+		}
+		if ( *s != '\\' ) {
+			str[len++] = *s++;
+			continue;
+		}
+		s ++;
+		switch ( *s ) {
+			case '"': str[len++] = '"'; break;
+			case '\\': str[len++] = '\\'; break;
+			case '/': str[len++] = '/'; break;
+			case 'b': str[len++] = '\b'; break;
+			case 'f': str[len++] = '\f'; break;
+			case 'n': str[len++] = '\n'; break;
+			case 'r': str[len++] = '\r'; break;
+			case 't': str[len++] = '\t'; break;
+			case 'u':
+				code = 0;
+				for ( i = 1; i <= 4; i ++ ) {
+					if ( !isxdigit ( (unsigned char) s[i] ) ) {
+						free ( str );
+						return (NULL);
+					}
+					code = code * 16 + ( isdigit ( (unsigned char) s[i] ) ?
+							s[i] - '0' : tolower ( (unsigned char) s[i] ) - 'a' + 10 );
+				}
+				s += 4;
+				if ( code < 0x80 ) {
+					str[len++] = (char) code;
+				} else if ( code < 0x800 ) {
+					str[len++] = (char) (0xC0 | (code >> 6));
+					str[len++] = (char) (0x80 | (code & 0x3F));
+				} else {
+					str[len++] = (char) (0xE0 | (code >> 12));
+					str[len++] = (char) (0x80 | ((code >> 6) & 0x3F));
+					str[len++] = (char) (0x80 | (code & 0x3F));
+				}
+				break;
+			default:
+				free ( str );
+				return (NULL);
+		}
+		s ++;
+	}
+	str[len] = '\0';
+	*p = s + 1;
+
+	return (str);
+}
+
+
+/*
+ * Skips any JSON value at "p" (including nested arrays and objects).
+ * Returns FALSE if the value is invalid.
+ */
+BOOLEAN serve_json_skip ( const char **p )
+{
+	char *str;
+	char open;
+
+
+	serve_json_skip_ws ( p );
+	if ( **p == '"' ) {
+		str = serve_json_string ( p );
+		if ( str == NULL ) {
+			return (FALSE);
+		}
+		free ( str );
+		return (TRUE);
+	}
+	if ( **p == '[' || **p == '{' ) {
+		open = **p;
+		(*p) ++;
+		serve_json_skip_ws ( p );
+		if ( **p == ( open == '[' ? ']' : '}' ) ) {
+			(*p) ++;
+			return (TRUE);
+		}
+		while ( 1 ) {
+			if ( open == '{' ) {
+				str = serve_json_string ( p );
+				if ( str == NULL ) {
+					return (FALSE);
+				}
+				free ( str );
+				serve_json_skip_ws ( p );
+				if ( **p != ':' ) {
+					return (FALSE);
+				}
+				(*p) ++;
+			}
+			if ( serve_json_skip ( p ) == FALSE ) {
+				return (FALSE);
+			}
+			serve_json_skip_ws ( p );
+			if ( **p == ',' ) {
+				(*p) ++;
+				serve_json_skip_ws ( p );
+				continue;
+			}
+			if ( **p == ( open == '[' ? ']' : '}' ) ) {
+				(*p) ++;
+				return (TRUE);
+			}
+			return (FALSE);
+		}
+	}
+	/* number or literal */
+	if ( **p == '\0' || strchr ( ",]}", **p ) != NULL ) {
+		return (FALSE);
+	}
+	while ( **p != '\0' && strchr ( ",]} \t\r\n", **p ) == NULL ) {
+		(*p) ++;
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Reads a JSON array of strings at "p". Stores the number of
+ * strings in "num". Returns a new, NULL terminated list of strings
+ * or NULL if the array is invalid.
+ */
+char **serve_json_string_array ( const char **p, int *num )
+{
+	char **list;
+	char *str;
+
+
+	*num = 0;
+	if ( **p != '[' ) {
+		return (NULL);
+	}
+	(*p) ++;
+	list = malloc ( sizeof (char*) );
+	list[0] = NULL;
+	serve_json_skip_ws ( p );
+	if ( **p == ']' ) {
+		(*p) ++;
+		return (list);
+	}
+	while ( 1 ) {
+		serve_json_skip_ws ( p );
+		str = serve_json_string ( p );
+		if ( str == NULL ) {
+			break;
+		}
+		list = realloc ( list, sizeof (char*) * (*num + 2) );
+		list[*num] = str;
+		list[*num + 1] = NULL;
+		(*num) ++;
+		serve_json_skip_ws ( p );
+		if ( **p == ',' ) {
+			(*p) ++;
+			continue;
+		}
+		if ( **p == ']' ) {
+			(*p) ++;
+			return (list);
+		}
+		break;
+	}
+
+	/* invalid array */
+	while ( *num > 0 ) {
+		(*num) --;
+		free ( list[*num] );
+	}
+	free ( list );
+
+	return (NULL);
+}
+
+
+/*
+ * Releases all memory of a job request.
+ */
+void serve_request_free ( serve_request *req )
+{
+	int i;
+
+
+	t_free ( req->id );
+	t_free ( req->schema );
+	t_free ( req->output );
+	t_free ( req->base );
+	for ( i = 0; i < req->num_input; i ++ ) {
+		free ( req->input[i] );
+	}
+	t_free ( req->input );
+	for ( i = 0; i < req->num_opts; i ++ ) {
+		free ( req->opts[i] );
+	}
+	t_free ( req->opts );
+	memset ( req, 0, sizeof (serve_request) );
+}
+
+
+/*
+ * Reads job request "text" (a JSON object) into "req".
+ * Returns NULL on success, or a description of the error.
+ */
+const char *serve_request_parse ( const char *text, serve_request *req )
+{
+	const char *p = text;
+	char *key;
+	char **str;
+	const char *error = NULL;
+	BOOLEAN done;
+
+
+	memset ( req, 0, sizeof (serve_request) );
+
+	serve_json_skip_ws ( &p );
+	if ( *p != '{' ) {
+		return (_("Job request is not a JSON object."));
+	}
+	p ++;
+	serve_json_skip_ws ( &p );
+	done = ( *p == '}' );
+	while ( done == FALSE ) {
+		serve_json_skip_ws ( &p );
+		key = serve_json_string ( &p );
+		if ( key == NULL ) {
+			return (_("Invalid JSON in job request."));
+		}
+		serve_json_skip_ws ( &p );
+		if ( *p != ':' ) {
+			free ( key );
+			return (_("Invalid JSON in job request."));
+		}
+		p ++;
+		serve_json_skip_ws ( &p );
+		/* known members */
+		str = NULL;
+		if ( !strcmp ( key, "id" ) )
+			str = &req->id;
+		if ( !strcmp ( key, "schema" ) )
+			str = &req->schema;
+		if ( !strcmp ( key, "output" ) )
+			str = &req->output;
+		if ( !strcmp ( key, "base" ) )
+			str = &req->base;
+		if ( str != NULL ) {
+			t_free ( *str );
+			*str = serve_json_string ( &p );
+			if ( *str == NULL ) {
+				error = _("Members 'id', 'schema', 'output' and 'base' of job request must be strings.");
+			}
+		} else if ( !strcmp ( key, "input" ) || !strcmp ( key, "options" ) ) {
+			char ***list = !strcmp ( key, "input" ) ? &req->input : &req->opts;
+			int *num = !strcmp ( key, "input" ) ? &req->num_input : &req->num_opts;
+			if ( *list != NULL ) {
+				error = _("Duplicate member in job request.");
+			} else {
+				*list = serve_json_string_array ( &p, num );
+				if ( *list == NULL ) {
+					error = _("Members 'input' and 'options' of job request must be arrays of strings.");
+				}
+			}
+		} else if ( serve_json_skip ( &p ) == FALSE ) {
+			error = _("Invalid JSON in job request.");
+		}
+		free ( key );
+		if ( error != NULL ) {
+			return (error);
+		}
+		serve_json_skip_ws ( &p );
+		if ( *p != ',' && *p != '}' ) {
+			return (_("Invalid JSON in job request."));
+		}
+		done = ( *p == '}' );
+		p ++;
+	}
+
+	if ( req->num_input < 1 ) {
+		return (_("Job request has no input files."));
+	}
+
+	return (NULL);
+}
+
+
+/*
+ * RESPONSES
+ */
+
+
+/*
+ * Writes "str" as a JSON string (with quotes and escapes).
+ */
+void serve_json_puts ( FILE *fp, const char *str )
+{
+	const unsigned char *s = (const unsigned char*) str;
+
+
+	fputc ( '"', fp );
+	for ( ; *s != '\0'; s ++ ) {
+		if ( *s == '"' || *s == '\\' ) {
+			fputc ( '\\', fp );
+			fputc ( *s, fp );
+		} else if ( *s == '\n' ) {
+			fputs ( "\\n", fp );
+		} else if ( *s == '\r' ) {
+			fputs ( "\\r", fp );
+		} else if ( *s == '\t' ) {
+			fputs ( "\\t", fp );
+		} else if ( *s < 0x20 ) {
+			fprintf ( fp, "\\u%04x", *s );
+		} else {
+			fputc ( *s, fp );
+		}
+	}
+	fputc ( '"', fp );
+}
+
+
+/*
+ * Helper function for all response functions:
+ * Writes the start of a response object, with the request ID
+ * (if any) and the response type.
+ */
+void serve_response_begin ( FILE *fp, const char *id, const char *type )
+{
+	fprintf ( fp, "{" );
+	if ( id != NULL ) {
+		fprintf ( fp, "\"id\": " );
+		serve_json_puts ( fp, id );
+		fprintf ( fp, ", " );
+	}
+	fprintf ( fp, "\"type\": \"%s\"", type );
+}
+
+
+/*
+ * Message hook for the job's library context: Sends each message
+ * to the client right away, so it can follow the job's progress.
+ */
+void serve_send_message ( unsigned short type, const char *msg, void *data )
+{
+	FILE *fp = (FILE*) data;
+	const char *name = "note";
+
+
+	if ( type == ERR_EXIT )
+		name = "error";
+	if ( type == ERR_WARN )
+		name = "warning";
+	if ( type == ERR_DBUG )
+		name = "debug";
+
+	/* skip empty lines (used for spacing on the console) */
+	while ( *msg == '\n' ) {
+		msg ++;
+	}
+	if ( *msg == '\0' ) {
+		return;
+	}
+
+	serve_response_begin ( fp, NULL, name );
+	fprintf ( fp, ", \"message\": " );
+	serve_json_puts ( fp, msg );
+	fprintf ( fp, "}\n" );
+	fflush ( fp );
+}
+
+
+/*
+ * Sends the final result of a job request: If "ctx" is not
+ * NULL, then the summary of its last run is included.
+ */
+void serve_send_result ( FILE *fp, const char *id, const char *error, s2g_context *ctx )
+{
+	const s2g_result *res;
+	int i;
+
+
+	serve_response_begin ( fp, id, "result" );
+	if ( error != NULL ) {
+		fprintf ( fp, ", \"status\": \"error\", \"error\": " );
+		serve_json_puts ( fp, error );
+		fprintf ( fp, "}\n" );
+		fflush ( fp );
+		return;
+	}
+
+	res = s2g_get_result ( ctx );
+	fprintf ( fp, ", \"status\": \"ok\"" );
+	fprintf ( fp, ", \"records\": %u, \"invalid\": %u", res->num_records, res->num_invalid );
+	fprintf ( fp, ", \"points\": %u, \"points_raw\": %u", res->num_points, res->num_points_raw );
+	fprintf ( fp, ", \"lines\": %u, \"polygons\": %u", res->num_lines, res->num_polygons );
+	fprintf ( fp, ", \"topo_errors\": %u", res->num_topo_errors );
+	fprintf ( fp, ", \"output_files\": [" );
+	for ( i = 0; res->output_files[i] != NULL; i ++ ) {
+		if ( i > 0 ) {
+			fprintf ( fp, ", " );
+		}
+		serve_json_puts ( fp, res->output_files[i] );
+	}
+	fprintf ( fp, "]}\n" );
+	fflush ( fp );
+}
+
+
+/*
+ * CACHE OF PARSED SCHEMAS
+ */
+
+
+/*
+ * Helper function for serve_get_context():
+ * Releases one cache entry.
+ */
+void serve_cached_free ( serve_cached *c )
+{
+	int i;
+
+
+	for ( i = 0; i < c->num_opts; i ++ ) {
+		free ( c->opts[i] );
+	}
+	t_free ( c->opts );
+	s2g_context_destroy ( c->ctx );
+	memset ( c, 0, sizeof (serve_cached) );
+}
+
+
+/*
+ * Helper function for serve_get_context():
+ * Checks if the schema file of a cached context is still the same
+ * as at setup time.
+ */
+BOOLEAN serve_cached_is_current ( serve_cached *c )
+{
+	struct stat st;
+	const char *schema = c->ctx->opts->schema_file;
+
+
+	if ( schema == NULL ) {
+		return (TRUE);
+	}
+	if ( stat ( schema, &st ) != 0 ) {
+		return (FALSE);
+	}
+
+	return ( st.st_mtime == c->mtime && st.st_size == c->size );
+}
+
+
+/*
+ * Returns a library context that has been set up with the command
+ * line options, plus the options (and schema) of request "req".
+ * Contexts are kept in "cache" and reused until their schema file
+ * changes. When the cache is full, the least recently used one
+ * is replaced.
+ *
+ * Returns NULL if setup fails. The error message is then stored
+ * in "error" (a new string).
+ */
+s2g_context *serve_get_context ( serve_cached *cache, int *num_cached, unsigned long req_no,
+		options *opts, serve_request *req, char **error )
+{
+	int num_opts;
+	char **req_opts;
+	int argc;
+	char **argv;
+	serve_cached *c = NULL;
+	struct stat st;
+	const char *msg;
+	int i, j;
+
+
+	/* options for this request: own options and schema (last, so it wins) */
+	num_opts = req->num_opts + ( req->schema != NULL ? 2 : 0 );
+	req_opts = malloc ( sizeof (char*) * (num_opts + 1) );
+	for ( i = 0; i < req->num_opts; i ++ ) {
+		req_opts[i] = strdup ( req->opts[i] );
+	}
+	if ( req->schema != NULL ) {
+		req_opts[i++] = strdup ( "-p" );
+		req_opts[i++] = strdup ( req->schema );
+	}
+	req_opts[num_opts] = NULL;
+
+	/* look for a context with the same options */
+	for ( i = 0; i < *num_cached; i ++ ) {
+		if ( cache[i].num_opts != num_opts ) {
+			continue;
+		}
+		for ( j = 0; j < num_opts; j ++ ) {
+			if ( strcmp ( cache[i].opts[j], req_opts[j] ) ) {
+				break;
+			}
+		}
+		if ( j == num_opts ) {
+			c = &cache[i];
+			break;
+		}
+	}
+
+	if ( c != NULL ) {
+		if ( serve_cached_is_current ( c ) == TRUE ) {
+			for ( j = 0; j < num_opts; j ++ ) {
+				free ( req_opts[j] );
+			}
+			free ( req_opts );
+			c->used = req_no;
+			return ( c->ctx );
+		}
+		/* schema has changed: set up again */
+		err_show ( ERR_NOTE, _("Parser schema '%s' has changed. Reading it again."),
+				c->ctx->opts->schema_file );
+		serve_cached_free ( c );
+	} else {
+		if ( *num_cached < SERVE_MAX_CACHED ) {
+			c = &cache[*num_cached];
+			(*num_cached) ++;
+		} else {
+			c = &cache[0];
+			for ( i = 1; i < *num_cached; i ++ ) {
+				if ( cache[i].used < c->used ) {
+					c = &cache[i];
+				}
+			}
+			serve_cached_free ( c );
+		}
+	}
+
+	/* set up a new context */
+	argv = malloc ( sizeof (char*) * (opts->argc + num_opts + 2) );
+	argc = 0;
+	for ( i = 0; i < opts->argc; i ++ ) {
+		argv[argc++] = opts->argv[i];
+	}
+	argv[argc++] = "--threads=1";
+	for ( i = 0; i < num_opts; i ++ ) {
+		argv[argc++] = req_opts[i];
+	}
+	argv[argc] = NULL;
+
+	c->num_opts = num_opts;
+	c->opts = req_opts;
+	c->ctx = s2g_context_create ();
+	c->used = req_no;
+	if ( s2g_context_setup ( c->ctx, argc, argv ) != S2G_OK ) {
+		msg = s2g_get_error ( c->ctx );
+		while ( *msg == '\n' ) {
+			msg ++;
+		}
+		*error = strdup ( msg );
+		free ( argv );
+		/* don't keep failed setups */
+		serve_cached_free ( c );
+		if ( c == &cache[*num_cached - 1] ) {
+			(*num_cached) --;
+		} else {
+			*c = cache[*num_cached - 1];
+			memset ( &cache[*num_cached - 1], 0, sizeof (serve_cached) );
+			(*num_cached) --;
+		}
+		return (NULL);
+	}
+	free ( argv );
+
+	c->mtime = 0;
+	c->size = 0;
+	if ( c->ctx->opts->schema_file != NULL && stat ( c->ctx->opts->schema_file, &st ) == 0 ) {
+		c->mtime = st.st_mtime;
+		c->size = st.st_size;
+	}
+
+	return ( c->ctx );
+}
+
+
+/*
+ * SERVER
+ */
+
+
+/*
+ * Creates the server socket at "path" and starts listening.
+ * A stale socket file (with no server behind it) is replaced.
+ * Exits with an error message on failure.
+ */
+int serve_listen ( const char *path )
+{
+	struct sockaddr_un addr;
+	int sock;
+	int probe;
+
+
+	if ( strlen ( path ) >= sizeof ( addr.sun_path ) ) {
+		err_show ( ERR_EXIT, _("Socket file name is too long ('%s')."), path );
+		return (-1);
+	}
+	memset ( &addr, 0, sizeof (struct sockaddr_un) );
+	addr.sun_family = AF_UNIX;
+	strcpy ( addr.sun_path, path );
+
+	sock = socket ( AF_UNIX, SOCK_STREAM, 0 );
+	if ( sock < 0 ) {
+		err_show ( ERR_EXIT, _("Cannot create socket.\nReason: %s"), strerror (errno) );
+		return (-1);
+	}
+	if ( bind ( sock, (struct sockaddr*) &addr, sizeof (struct sockaddr_un) ) != 0 ) {
+		if ( errno == EADDRINUSE ) {
+			/* is there a server? */
+			probe = socket ( AF_UNIX, SOCK_STREAM, 0 );
+			if ( probe >= 0 && connect ( probe, (struct sockaddr*) &addr, sizeof (struct sockaddr_un) ) != 0 ) {
+				close ( probe );
+				probe = -1;
+				unlink ( path );
+				if ( bind ( sock, (struct sockaddr*) &addr, sizeof (struct sockaddr_un) ) == 0 ) {
+					errno = 0;
+				}
+			} else if ( probe >= 0 ) {
+				close ( probe );
+				errno = EADDRINUSE;
+			}
+		}
+		if ( errno != 0 ) {
+			err_show ( ERR_EXIT, _("Cannot bind socket to '%s'.\nReason: %s"), path, strerror (errno) );
+			close ( sock );
+			return (-1);
+		}
+	}
+	if ( listen ( sock, SERVE_BACKLOG ) != 0 ) {
+		err_show ( ERR_EXIT, _("Cannot listen on socket '%s'.\nReason: %s"), path, strerror (errno) );
+		close ( sock );
+		return (-1);
+	}
+
+	return (sock);
+}
+
+
+/*
+ * Reads one job request (everything up to the first line break or
+ * the end of input) from client connection "fd".
+ * Returns a new string or NULL if no complete request was received.
+ */
+char *serve_read_request ( int fd )
+{
+	char *buf;
+	size_t len = 0;
+	ssize_t n;
+	char *nl;
+
+
+	buf = malloc ( sizeof (char) * (SERVE_MAX_REQUEST_LEN + 1) );
+	while ( len < SERVE_MAX_REQUEST_LEN ) {
+		n = read ( fd, buf + len, SERVE_MAX_REQUEST_LEN - len );
+		if ( n < 0 && errno == EINTR && SERVE_STOP == 0 ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			break;
+		}
+		buf[len+n] = '\0';
+		nl = strchr ( buf + len, '\n' );
+		len += n;
+		if ( nl != NULL ) {
+			*nl = '\0';
+			return (buf);
+		}
+	}
+	if ( len > 0 && len < SERVE_MAX_REQUEST_LEN ) {
+		buf[len] = '\0';
+		return (buf);
+	}
+	free ( buf );
+
+	return (NULL);
+}
+
+
+/*
+ * Worker process: Runs the job for request "req" with library
+ * context "ctx" and sends all messages and the result to the
+ * client connection "fd". Does not return.
+ */
+void serve_exec ( int fd, s2g_context *ctx, serve_request *req )
+{
+	FILE *fp;
+	int status;
+
+
+	fp = fdopen ( fd, "w" );
+	if ( fp == NULL ) {
+		_exit ( PRG_EXIT_ERR );
+	}
+	s2g_set_message_hook ( ctx, serve_send_message, fp );
+	status = s2g_process_files ( ctx, req->output, req->base,
+			req->num_input, (const char**) req->input );
+	s2g_set_message_hook ( ctx, NULL, NULL );
+	if ( status == S2G_OK ) {
+		serve_send_result ( fp, req->id, NULL, ctx );
+	} else {
+		serve_send_result ( fp, req->id, s2g_get_error ( ctx ), NULL );
+	}
+	fclose ( fp );
+
+	_exit ( status == S2G_OK ? PRG_EXIT_OK : PRG_EXIT_ERR );
+}
+
+
+/*
+ * Helper function for serve_run():
+ * Waits for running jobs to finish ("block" = FALSE: only collects
+ * those that have already finished) and reports their status.
+ * Returns the number of jobs that are still running.
+ */
+int serve_collect ( long *pids, unsigned long *req_nos, int max, int running, BOOLEAN block )
+{
+	pid_t pid;
+	int wstatus;
+	int i;
+
+
+	while ( running > 0 ) {
+		pid = waitpid ( -1, &wstatus, block == TRUE ? 0 : WNOHANG );
+		if ( pid < 0 && errno == EINTR ) {
+			if ( SERVE_STOP != 0 && block == FALSE ) {
+				break;
+			}
+			continue;
+		}
+		if ( pid <= 0 ) {
+			break;
+		}
+		for ( i = 0; i < max; i ++ ) {
+			if ( pids[i] == (long) pid ) {
+				if ( WIFEXITED ( wstatus ) && WEXITSTATUS ( wstatus ) == PRG_EXIT_OK ) {
+					err_show ( ERR_NOTE, _("Request %lu completed."), req_nos[i] );
+				} else if ( WIFSIGNALED ( wstatus ) ) {
+					err_show ( ERR_WARN, _("Request %lu was terminated by signal %i."),
+							req_nos[i], WTERMSIG ( wstatus ) );
+				} else {
+					err_show ( ERR_NOTE, _("Request %lu failed."), req_nos[i] );
+				}
+				pids[i] = 0;
+				running --;
+				break;
+			}
+		}
+		/* only block for one job */
+		block = FALSE;
+	}
+
+	return (running);
+}
+
+
+/*
+ * Serves job requests on the Unix domain socket given in "opts"
+ * (option "--serve="), until the program receives SIGINT or SIGTERM.
+ * Up to "opts->threads" jobs run at the same time, each in its own
+ * worker process that starts off with a copy of the parsed schema,
+ * reprojection setup and SRS caches of the server.
+ *
+ * Returns "0" after a normal shutdown.
+ */
+int serve_run ( options *opts )
+{
+	serve_cached cache[SERVE_MAX_CACHED];
+	int num_cached = 0;
+	serve_request req;
+	s2g_context *ctx;
+	struct sigaction sa;
+	struct timeval tv;
+	unsigned long req_no = 0;
+	unsigned long *req_nos;
+	long *pids;
+	int running = 0;
+	int sock, fd;
+	char *text;
+	char *error;
+	const char *parse_error;
+	FILE *fp;
+	pid_t pid;
+	int i;
+
+
+	memset ( cache, 0, sizeof (cache) );
+
+	err_log_init ( opts );
+
+	/* clean shutdown on SIGINT and SIGTERM; a client that hangs up must not stop us */
+	memset ( &sa, 0, sizeof (struct sigaction) );
+	sa.sa_handler = serve_stop;
+	sigemptyset ( &sa.sa_mask );
+	sigaction ( SIGINT, &sa, NULL );
+	sigaction ( SIGTERM, &sa, NULL );
+	signal ( SIGPIPE, SIG_IGN );
+
+	sock = serve_listen ( opts->serve );
+
+	pids = malloc ( sizeof (long) * opts->threads );
+	req_nos = malloc ( sizeof (unsigned long) * opts->threads );
+	for ( i = 0; i < opts->threads; i ++ ) {
+		pids[i] = 0;
+		req_nos[i] = 0;
+	}
+
+	err_show ( ERR_NOTE, _("Serving job requests on '%s' (max. %i at a time)."),
+			opts->serve, opts->threads );
+
+	while ( SERVE_STOP == 0 ) {
+		running = serve_collect ( pids, req_nos, opts->threads, running, FALSE );
+		fd = accept ( sock, NULL, NULL );
+		if ( fd < 0 ) {
+			if ( errno == EINTR || errno == ECONNABORTED ) {
+				continue;
+			}
+			err_show ( ERR_WARN, _("Cannot accept connection.\nReason: %s"), strerror (errno) );
+			break;
+		}
+
+		/* don't let a slow client block the server */
+		tv.tv_sec = SERVE_REQUEST_TIMEOUT;
+		tv.tv_usec = 0;
+		setsockopt ( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (struct timeval) );
+
+		req_no ++;
+		text = serve_read_request ( fd );
+		if ( text == NULL ) {
+			err_show ( ERR_WARN, _("Request %lu: No valid job request received."), req_no );
+			close ( fd );
+			continue;
+		}
+		parse_error = serve_request_parse ( text, &req );
+		free ( text );
+		error = NULL;
+		ctx = NULL;
+		if ( parse_error != NULL ) {
+			error = strdup ( parse_error );
+		} else {
+			ctx = serve_get_context ( cache, &num_cached, req_no, opts, &req, &error );
+		}
+		if ( ctx == NULL ) {
+			err_show ( ERR_WARN, _("Request %lu: %s"), req_no, error );
+			fp = fdopen ( fd, "w" );
+			if ( fp != NULL ) {
+				serve_send_result ( fp, req.id, error, NULL );
+				fclose ( fp );
+			} else {
+				close ( fd );
+			}
+			free ( error );
+			serve_request_free ( &req );
+			continue;
+		}
+
+		err_show ( ERR_NOTE, _("Request %lu: %s%c%s (%i input file(s))."), req_no,
+				req.output != NULL ? req.output : ctx->output, PRG_FILE_SEPARATOR,
+				req.base != NULL ? req.base : ctx->base, req.num_input );
+
+		/* wait for a free worker */
+		if ( running >= opts->threads ) {
+			running = serve_collect ( pids, req_nos, opts->threads, running, TRUE );
+		}
+
+		/* don't let the worker inherit buffered output */
+		fflush ( NULL );
+		pid = fork ();
+		if ( pid == 0 ) {
+			close ( sock );
+			serve_exec ( fd, ctx, &req );
+		}
+		if ( pid < 0 ) {
+			err_show ( ERR_WARN, _("Request %lu: Cannot start job.\nReason: %s"),
+					req_no, strerror (errno) );
+			fp = fdopen ( fd, "w" );
+			if ( fp != NULL ) {
+				serve_send_result ( fp, req.id, strerror (errno), NULL );
+				fclose ( fp );
+			} else {
+				close ( fd );
+			}
+		} else {
+			close ( fd );
+			for ( i = 0; i < opts->threads; i ++ ) {
+				if ( pids[i] == 0 ) {
+					pids[i] = (long) pid;
+					req_nos[i] = req_no;
+					break;
+				}
+			}
+			running ++;
+		}
+		serve_request_free ( &req );
+	}
+
+	/* shut down: let running jobs finish */
+	err_show ( ERR_NOTE, _("Shutting down.") );
+	close ( sock );
+	unlink ( opts->serve );
+	SERVE_STOP = 0;
+	while ( running > 0 ) {
+		running = serve_collect ( pids, req_nos, opts->threads, running, TRUE );
+	}
+
+	for ( i = 0; i < num_cached; i ++ ) {
+		serve_cached_free ( &cache[i] );
+	}
+	free ( pids );
+	free ( req_nos );
+	err_close ();
+
+	return (0);
+}
+
+#endif
@@ -0,0 +1,90 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	serve.h
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Server mode: accepts job requests on a Unix domain
+ * 				socket ("--serve=").
+ *
+ * 				Each connection carries one job request: a JSON object
+ * 				on a single line, with the output folder and base name,
+ * 				the input files and, optionally, a parser schema and
+ * 				options that override those of the command line. All
+ * 				messages of the job and its final result are sent back
+ * 				on the same connection, as they are produced, one JSON
+ * 				object per line.
+ *
+ * 				Parsed schemas (and thus reprojection settings) are
+ * 				kept for later requests with the same options, until
+ * 				the schema file changes. Jobs run in worker processes,
+ * 				several at a time.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "global.h"
+
+#include "options.h"
+#include "s2g.h"
+
+
+#ifndef SERVE_H
+#define SERVE_H
+
+/* max. size of a job request (bytes) */
+#define SERVE_MAX_REQUEST_LEN	1048576
+
+/* max. time to wait for a complete job request (seconds) */
+#define SERVE_REQUEST_TIMEOUT	10
+
+/* max. number of parsed schemas (option sets) to keep */
+#define SERVE_MAX_CACHED		16
+
+/* max. number of connections waiting to be accepted */
+#define SERVE_BACKLOG			16
+
+/*
+ * One job request, as received from a client.
+ */
+typedef struct serve_request serve_request;
+struct serve_request
+{
+	char *id; /* client's ID for this request (optional) */
+	char *schema; /* parser schema file (optional) */
+	char *output; /* output folder */
+	char *base; /* output base name */
+	int num_input; /* number of input files */
+	char **input; /* input file names */
+	int num_opts; /* number of overriding options */
+	char **opts; /* overriding options (as on the command line) */
+};
+
+/*
+ * A library context that has been set up for a set of options,
+ * kept for later requests with the same options.
+ */
+typedef struct serve_cached serve_cached;
+struct serve_cached
+{
+	int num_opts; /* number of overriding options (incl. schema) */
+	char **opts; /* overriding options */
+	s2g_context *ctx; /* context set up with these options */
+	time_t mtime; /* modification time of the schema file at setup */
+	off_t size; /* size of the schema file at setup */
+	unsigned long used; /* number of the last request that used this */
+};
+
+/* serve job requests on the socket given in "opts", until terminated */
+int serve_run ( options *opts );
+
+#endif /* SERVE_H */
@@ -0,0 +1,687 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	snapshot.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Snapshots ("--snapshot="): saves the parsed input data in
+ * 				a binary file, so that later runs on the same input do not
+ * 				have to parse it again.
+ *
+ * 				See snapshot.h for details.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifndef MINGW
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "global.h"
+
+#include "errors.h"
+#include "geom.h"
+#include "i18n.h"
+#include "incremental.h"
+#include "options.h"
+#include "parser.h"
+#include "snapshot.h"
+#include "tools.h"
+
+
+/*
+ * Helper function: returns the hash of everything that the parsed
+ * data depends on: the contents of the parser schema file, the name,
+ * size, modification time, first and last bytes of each input file
+ * and all options that are used up to parser_ds_validate_unique().
+ */
+unsigned long snapshot_hash_config ( options *opts )
+{
+	unsigned long hash = 2166136261UL;
+	unsigned long part;
+	struct stat st;
+	long size;
+	long len;
+	int i;
+
+
+	if ( opts->schema_file != NULL ) {
+		size = t_file_size_utf8 ( opts->schema_file );
+		part = size > 0 ? incremental_hash_file ( opts->schema_file, 0, size ) : 0;
+		hash = incremental_hash ( hash, (const char*) &part, sizeof (part) );
+	}
+
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		hash = incremental_hash ( hash, opts->input[i], strlen (opts->input[i]) + 1 );
+		if ( stat ( opts->input[i], &st ) == 0 ) {
+			hash = incremental_hash ( hash, (const char*) &st.st_mtime, sizeof (st.st_mtime) );
+		}
+		size = t_file_size_utf8 ( opts->input[i] );
+		hash = incremental_hash ( hash, (const char*) &size, sizeof (size) );
+		len = size < INCREMENTAL_HASH_LEN ? size : INCREMENTAL_HASH_LEN;
+		if ( len > 0 ) {
+			part = incremental_hash_file ( opts->input[i], 0, len );
+			hash = incremental_hash ( hash, (const char*) &part, sizeof (part) );
+			part = incremental_hash_file ( opts->input[i], size - len, len );
+			hash = incremental_hash ( hash, (const char*) &part, sizeof (part) );
+		}
+	}
+
+	hash = incremental_hash ( hash, opts->decimal_point, sizeof (opts->decimal_point) );
+	hash = incremental_hash ( hash, opts->decimal_group, sizeof (opts->decimal_group) );
+	hash = incremental_hash ( hash, (const char*) &opts->offset_x, sizeof (opts->offset_x) );
+	hash = incremental_hash ( hash, (const char*) &opts->offset_y, sizeof (opts->offset_y) );
+	hash = incremental_hash ( hash, (const char*) &opts->offset_z, sizeof (opts->offset_z) );
+	hash = incremental_hash ( hash, (const char*) &opts->tolerance, sizeof (opts->tolerance) );
+	hash = incremental_hash ( hash, (const char*) &opts->orient_mode, sizeof (opts->orient_mode) );
+
+	return ( hash );
+}
+
+
+/*
+ * Helper function: returns the number of fields in "parser".
+ */
+int snapshot_num_fields ( parser_desc *parser )
+{
+	int i = 0;
+
+	while ( parser->fields[i] != NULL )
+		i++;
+
+	return ( i );
+}
+
+
+/*
+ * Helper function: gets the string offsets of all strings in record "j"
+ * of data store "ds" and adds their sizes to "pool". The strings are laid
+ * out in this order: field values, tag and key (if the key is not one of
+ * the field values).
+ * "values" (can be NULL) receives the offsets of the "num_fields" field values.
+ */
+void snapshot_record_strings ( parser_data_store *ds, unsigned int j, int num_fields, unsigned long long *pool,
+		unsigned long long *values, unsigned long long *tag, unsigned long long *key, int *key_field )
+{
+	parser_record *rec = &ds->records[j];
+	int i;
+
+
+	*tag = SNAPSHOT_NONE;
+	*key = SNAPSHOT_NONE;
+	*key_field = -1;
+
+	if ( ds->flags[j] & PARSER_RECORD_EMPTY ) {
+		return;
+	}
+
+	if ( rec->contents != NULL ) {
+		for ( i = 0; i < num_fields; i ++ ) {
+			if ( rec->contents[i] != NULL ) {
+				if ( values != NULL ) {
+					values[i] = *pool;
+				}
+				*pool += strlen ( rec->contents[i] ) + 1;
+				if ( rec->key == rec->contents[i] ) {
+					*key_field = i;
+				}
+			} else if ( values != NULL ) {
+				values[i] = SNAPSHOT_NONE;
+			}
+		}
+	}
+	if ( rec->tag != NULL ) {
+		*tag = *pool;
+		*pool += strlen ( rec->tag ) + 1;
+	}
+	if ( rec->key != NULL && *key_field < 0 ) {
+		*key = *pool;
+		*pool += strlen ( rec->key ) + 1;
+	}
+}
+
+
+/*
+ * Writes all records of the data stores in "storage" (which have been
+ * through parser_ds_validate_unique()) to the snapshot file set in "opts".
+ * "topo_errors", "fused_records" and "duplicate_records" are the results
+ * of the processing steps up to there.
+ *
+ * The file is first written under a temporary name and then renamed, so
+ * that a run that is interrupted cannot leave a damaged snapshot behind.
+ *
+ * Returns 0 on success, 1 on failure (with a warning).
+ */
+int snapshot_save ( options *opts, parser_desc *parser, parser_data_store **storage,
+		unsigned int *topo_errors, unsigned int fused_records, unsigned int duplicate_records )
+{
+	FILE *fp;
+	char *tmp;
+	snapshot_header head;
+	snapshot_store st;
+	snapshot_record rec;
+	parser_record *r;
+	unsigned long long *values;
+	unsigned long long pool;
+	unsigned long long first;
+	unsigned char *skip;
+	int num_fields;
+	int i, k;
+	unsigned int j;
+	BOOLEAN ok = TRUE;
+
+
+	num_fields = snapshot_num_fields ( parser );
+
+	/* sizes of all sections */
+	memset ( &head, 0, sizeof (snapshot_header) );
+	strcpy ( head.magic, SNAPSHOT_MAGIC );
+	head.version = SNAPSHOT_VERSION;
+	head.byte_order = SNAPSHOT_BYTE_ORDER;
+	head.record_size = sizeof (snapshot_record);
+	head.config = (unsigned int) snapshot_hash_config ( opts );
+	head.num_input = opts->num_input;
+	head.num_fields = num_fields;
+	head.fused_records = fused_records;
+	head.duplicate_records = duplicate_records;
+	head.next_id = geom_get_next_id ();
+	pool = 0;
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		for ( j = 0; j < storage[i]->slot; j ++ ) {
+			r = &storage[i]->records[j];
+			if ( !( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) && r->contents != NULL ) {
+				head.num_values += num_fields;
+			}
+			snapshot_record_strings ( storage[i], j, num_fields, &pool, NULL, &rec.tag, &rec.key, &rec.key_field );
+		}
+		head.num_records += storage[i]->slot;
+	}
+	head.strings_size = pool;
+	head.file_size = sizeof (snapshot_header) + sizeof (snapshot_store) * head.num_input +
+			sizeof (snapshot_record) * head.num_records +
+			( sizeof (unsigned long long) + sizeof (unsigned char) ) * head.num_values + head.strings_size;
+
+	tmp = malloc ( sizeof (char) * ( strlen (opts->snapshot) + strlen (SNAPSHOT_TEMP_EXTENSION) + 1 ) );
+	sprintf ( tmp, "%s%s", opts->snapshot, SNAPSHOT_TEMP_EXTENSION );
+	fp = t_fopen_utf8 ( tmp, "wb" );
+	if ( fp == NULL ) {
+		err_show ( ERR_WARN, _("\nCannot write snapshot file \"%s\"."), tmp );
+		free ( tmp );
+		return ( 1 );
+	}
+
+	values = malloc ( sizeof (unsigned long long) * ( num_fields > 0 ? num_fields : 1 ) );
+	skip = malloc ( sizeof (unsigned char) * ( num_fields > 0 ? num_fields : 1 ) );
+
+	/* header and data stores */
+	fwrite ( &head, sizeof (snapshot_header), 1, fp );
+	first = 0;
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		memset ( &st, 0, sizeof (snapshot_store) );
+		st.offset_x = storage[i]->offset_x;
+		st.offset_y = storage[i]->offset_y;
+		st.offset_z = storage[i]->offset_z;
+		st.first_record = first;
+		st.num_records = storage[i]->slot;
+		st.num_points = storage[i]->num_points;
+		st.num_lines = storage[i]->num_lines;
+		st.num_polygons = storage[i]->num_polygons;
+		st.topo_errors = topo_errors[i];
+		fwrite ( &st, sizeof (snapshot_store), 1, fp );
+		first += storage[i]->slot;
+	}
+
+	/* records */
+	pool = 0;
+	first = 0;
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		for ( j = 0; j < storage[i]->slot; j ++ ) {
+			r = &storage[i]->records[j];
+			memset ( &rec, 0, sizeof (snapshot_record) );
+			rec.x = storage[i]->x[j];
+			rec.y = storage[i]->y[j];
+			rec.z = storage[i]->z[j];
+			snapshot_record_strings ( storage[i], j, num_fields, &pool, NULL, &rec.tag, &rec.key, &rec.key_field );
+			rec.values = SNAPSHOT_NONE;
+			if ( !( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) && r->contents != NULL ) {
+				rec.values = first;
+				first += num_fields;
+			}
+			rec.line = r->line;
+			rec.geom_id = storage[i]->geom_id[j];
+			rec.part_id = r->part_id;
+			rec.geom_type = storage[i]->geom_type[j];
+			rec.flags = 0;
+			if ( storage[i]->flags[j] & PARSER_RECORD_WRITTEN_OUT )
+				rec.flags |= SNAPSHOT_FLAG_WRITTEN_OUT;
+			if ( storage[i]->flags[j] & PARSER_RECORD_VALID )
+				rec.flags |= SNAPSHOT_FLAG_VALID;
+			if ( storage[i]->flags[j] & PARSER_RECORD_EMPTY )
+				rec.flags |= SNAPSHOT_FLAG_EMPTY;
+			if ( !( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) && r->skip != NULL )
+				rec.flags |= SNAPSHOT_FLAG_SKIP;
+			fwrite ( &rec, sizeof (snapshot_record), 1, fp );
+		}
+	}
+
+	/* field values */
+	pool = 0;
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		for ( j = 0; j < storage[i]->slot; j ++ ) {
+			r = &storage[i]->records[j];
+			snapshot_record_strings ( storage[i], j, num_fields, &pool, values, &rec.tag, &rec.key, &rec.key_field );
+			if ( !( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) && r->contents != NULL ) {
+				fwrite ( values, sizeof (unsigned long long), num_fields, fp );
+			}
+		}
+	}
+
+	/* "skip" flags */
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		for ( j = 0; j < storage[i]->slot; j ++ ) {
+			r = &storage[i]->records[j];
+			if ( !( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) && r->contents != NULL ) {
+				for ( k = 0; k < num_fields; k ++ ) {
+					skip[k] = ( r->skip != NULL && r->skip[k] == TRUE ) ? 1 : 0;
+				}
+				fwrite ( skip, sizeof (unsigned char), num_fields, fp );
+			}
+		}
+	}
+
+	/* strings (same order as in snapshot_record_strings()) */
+	for ( i = 0; i < opts->num_input; i ++ ) {
+		for ( j = 0; j < storage[i]->slot; j ++ ) {
+			r = &storage[i]->records[j];
+			if ( storage[i]->flags[j] & PARSER_RECORD_EMPTY ) {
+				continue;
+			}
+			BOOLEAN key_found = FALSE;
+			if ( r->contents != NULL ) {
+				for ( k = 0; k < num_fields; k ++ ) {
+					if ( r->contents[k] != NULL ) {
+						fwrite ( r->contents[k], sizeof (char), strlen ( r->contents[k] ) + 1, fp );
+						if ( r->key == r->contents[k] ) {
+							key_found = TRUE;
+						}
+					}
+				}
+			}
+			if ( r->tag != NULL ) {
+				fwrite ( r->tag, sizeof (char), strlen ( r->tag ) + 1, fp );
+			}
+			if ( r->key != NULL && key_found == FALSE ) {
+				fwrite ( r->key, sizeof (char), strlen ( r->key ) + 1, fp );
+			}
+		}
+	}
+
+	free ( values );
+	free ( skip );
+
+	if ( ferror ( fp ) ) {
+		ok = FALSE;
+	}
+	if ( fclose ( fp ) != 0 ) {
+		ok = FALSE;
+	}
+	if ( ok == TRUE && t_rename_utf8 ( tmp, opts->snapshot ) != 0 ) {
+		ok = FALSE;
+	}
+	if ( ok == FALSE ) {
+		err_show ( ERR_WARN, _("\nFailed to write snapshot file \"%s\"."), opts->snapshot );
+		t_remove_utf8 ( tmp );
+		free ( tmp );
+		return ( 1 );
+	}
+	free ( tmp );
+
+	err_show ( ERR_NOTE, _("\nSnapshot: saved %u records to \"%s\"."),
+			(unsigned int) head.num_records, opts->snapshot );
+
+	return ( 0 );
+}
+
+
+/*
+ * Helper function: makes the "size" bytes of the snapshot file "path"
+ * available in memory. The file is mapped, if the system supports
+ * that, and read otherwise.
+ *
+ * Returns a new snapshot_data object, or NULL on error.
+ */
+snapshot_data *snapshot_open ( const char *path, size_t size )
+{
+	snapshot_data *data;
+	FILE *fp;
+
+
+	data = malloc ( sizeof (snapshot_data) );
+	data->addr = NULL;
+	data->size = size;
+	data->mapped = FALSE;
+	data->refs = 0;
+	data->contents = NULL;
+	data->skip = NULL;
+
+#ifndef MINGW
+	int fd = open ( path, O_RDONLY );
+	if ( fd >= 0 ) {
+		/* private mapping: pages are copied (not written back) if changed */
+		void *addr = mmap ( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		close ( fd );
+		if ( addr != MAP_FAILED ) {
+			data->addr = addr;
+			data->mapped = TRUE;
+			return ( data );
+		}
+	}
+#endif
+
+	data->addr = malloc ( size );
+	fp = t_fopen_utf8 ( path, "rb" );
+	if ( data->addr == NULL || fp == NULL || fread ( data->addr, 1, size, fp ) != size ) {
+		if ( fp != NULL ) {
+			fclose ( fp );
+		}
+		free ( data->addr );
+		free ( data );
+		return ( NULL );
+	}
+	fclose ( fp );
+
+	return ( data );
+}
+
+
+/*
+ * Helper function: releases the memory of "data", no matter
+ * how many data stores still use it.
+ */
+void snapshot_close ( snapshot_data *data )
+{
+	if ( data->contents != NULL ) {
+		free ( data->contents );
+	}
+	if ( data->skip != NULL ) {
+		free ( data->skip );
+	}
+#ifndef MINGW
+	if ( data->mapped == TRUE ) {
+		munmap ( data->addr, data->size );
+	} else {
+		free ( data->addr );
+	}
+#else
+	free ( data->addr );
+#endif
+	free ( data );
+}
+
+
+/*
+ * Helper function: checks that all sections, string offsets and
+ * field value indices in snapshot "data" are within the file.
+ * The header must already have been checked.
+ *
+ * Returns TRUE if the snapshot can be used safely, FALSE otherwise.
+ */
+BOOLEAN snapshot_check_tables ( snapshot_data *data )
+{
+	snapshot_header *head = (snapshot_header*) data->addr;
+	snapshot_store *st;
+	snapshot_record *rec;
+	unsigned long long *values;
+	unsigned long long i;
+	const char *strings;
+	size_t size;
+
+
+	/* sizes must be checked one by one, so that they cannot overflow */
+	size = data->size - sizeof (snapshot_header);
+	if ( head->num_input > size / sizeof (snapshot_store) ) {
+		return ( FALSE );
+	}
+	size -= sizeof (snapshot_store) * head->num_input;
+	if ( head->num_records > size / sizeof (snapshot_record) ) {
+		return ( FALSE );
+	}
+	size -= sizeof (snapshot_record) * head->num_records;
+	if ( head->num_values > size / ( sizeof (unsigned long long) + sizeof (unsigned char) ) ) {
+		return ( FALSE );
+	}
+	size -= ( sizeof (unsigned long long) + sizeof (unsigned char) ) * head->num_values;
+	if ( head->strings_size != size || head->file_size != data->size ) {
+		return ( FALSE );
+	}
+
+	st = (snapshot_store*) ( data->addr + sizeof (snapshot_header) );
+	rec = (snapshot_record*) ( st + head->num_input );
+	values = (unsigned long long*) ( rec + head->num_records );
+	strings = data->addr + data->size - head->strings_size;
+
+	/* strings must end within the pool */
+	if ( head->strings_size > 0 && strings[head->strings_size - 1] != '\0' ) {
+		return ( FALSE );
+	}
+
+	for ( i = 0; i < head->num_input; i ++ ) {
+		if ( st[i].first_record > head->num_records ||
+				st[i].num_records > head->num_records - st[i].first_record ) {
+			return ( FALSE );
+		}
+	}
+	for ( i = 0; i < head->num_records; i ++ ) {
+		if ( rec[i].values != SNAPSHOT_NONE &&
+				( rec[i].values > head->num_values || head->num_fields > head->num_values - rec[i].values ) ) {
+			return ( FALSE );
+		}
+		if ( rec[i].tag != SNAPSHOT_NONE && rec[i].tag >= head->strings_size ) {
+			return ( FALSE );
+		}
+		if ( rec[i].key != SNAPSHOT_NONE && rec[i].key >= head->strings_size ) {
+			return ( FALSE );
+		}
+		if ( rec[i].key_field < -1 || rec[i].key_field >= (int) head->num_fields ||
+				( rec[i].key_field >= 0 && rec[i].values == SNAPSHOT_NONE ) ) {
+			return ( FALSE );
+		}
+	}
+	for ( i = 0; i < head->num_values; i ++ ) {
+		if ( values[i] != SNAPSHOT_NONE && values[i] >= head->strings_size ) {
+			return ( FALSE );
+		}
+	}
+
+	return ( TRUE );
+}
+
+
+/*
+ * Loads the snapshot file set in "opts", if it exists and was made
+ * from the same parser schema, input files and parsing options, and
+ * makes one data store per input file from it. These contain the same
+ * records as after parser_ds_validate_unique() in the run that wrote
+ * the snapshot. "topo_errors" (one per input file), "fused_records"
+ * and "duplicate_records" receive the results of the processing steps
+ * up to there. This also sets the geom ID to continue with.
+ *
+ * Returns the data stores, or NULL if there is no valid snapshot
+ * (with a note why). In that case, the input must be parsed.
+ */
+parser_data_store **snapshot_load ( options *opts, parser_desc *parser, unsigned int *topo_errors,
+		unsigned int *fused_records, unsigned int *duplicate_records )
+{
+	snapshot_data *data = NULL;
+	snapshot_header *head = NULL;
+	snapshot_store *st;
+	snapshot_record *rec;
+	unsigned long long *values;
+	unsigned char *skip;
+	const char *strings;
+	const char *reason = NULL;
+	parser_data_store **storage;
+	parser_data_store *ds;
+	parser_record *r;
+	unsigned long long i;
+	long size;
+	int num_fields;
+	int k;
+	unsigned int j;
+
+
+	num_fields = snapshot_num_fields ( parser );
+
+	size = t_file_size_utf8 ( opts->snapshot );
+	if ( size < 0 ) {
+		reason = _("no snapshot file");
+	} else if ( size < (long) sizeof (snapshot_header) ) {
+		reason = _("snapshot file damaged");
+	} else {
+		data = snapshot_open ( opts->snapshot, (size_t) size );
+		if ( data == NULL ) {
+			reason = _("cannot read snapshot file");
+		} else {
+			head = (snapshot_header*) data->addr;
+			if ( 	memcmp ( head->magic, SNAPSHOT_MAGIC, strlen (SNAPSHOT_MAGIC) + 1 ) != 0 ||
+					head->version != SNAPSHOT_VERSION ||
+					head->byte_order != SNAPSHOT_BYTE_ORDER ||
+					head->record_size != sizeof (snapshot_record) ) {
+				reason = _("snapshot file from another program version or system");
+			} else if ( 	head->config != (unsigned int) snapshot_hash_config ( opts ) ||
+							head->num_input != opts->num_input ||
+							head->num_fields != num_fields ) {
+				reason = _("input, parser schema or options changed");
+			} else if ( snapshot_check_tables ( data ) == FALSE ) {
+				reason = _("snapshot file damaged");
+			}
+		}
+	}
+
+	if ( reason != NULL ) {
+		if ( data != NULL ) {
+			snapshot_close ( data );
+		}
+		err_show ( ERR_NOTE, _("\nSnapshot: parsing input (%s)."), reason );
+		return ( NULL );
+	}
+
+	st = (snapshot_store*) ( data->addr + sizeof (snapshot_header) );
+	rec = (snapshot_record*) ( st + head->num_input );
+	values = (unsigned long long*) ( rec + head->num_records );
+	skip = (unsigned char*) ( values + head->num_values );
+	strings = data->addr + data->size - head->strings_size;
+
+	/* field values of all records */
+	data->contents = malloc ( sizeof (char*) * ( head->num_values > 0 ? head->num_values : 1 ) );
+	data->skip = malloc ( sizeof (BOOLEAN) * ( head->num_values > 0 ? head->num_values : 1 ) );
+	for ( i = 0; i < head->num_values; i ++ ) {
+		data->contents[i] = values[i] == SNAPSHOT_NONE ? NULL : (char*) ( strings + values[i] );
+		data->skip[i] = skip[i] != 0 ? TRUE : FALSE;
+	}
+
+	/* one data store per input file */
+	storage = malloc ( sizeof ( parser_data_store* ) * opts->num_input );
+	for ( k = 0; k < opts->num_input; k ++ ) {
+		ds = malloc ( sizeof ( parser_data_store ) );
+		ds->input = strdup ( opts->input[k] );
+		ds->slot = st[k].num_records;
+		ds->num_records = 0;
+		ds->num_points = st[k].num_points;
+		ds->num_lines = st[k].num_lines;
+		ds->num_polygons = st[k].num_polygons;
+		ds->space_left = 0;
+		ds->num_fields = num_fields;
+		ds->offset_x = st[k].offset_x;
+		ds->offset_y = st[k].offset_y;
+		ds->offset_z = st[k].offset_z;
+		ds->start_offset = 0;
+		ds->start_line = 1;
+		ds->end_offset = 0;
+		ds->end_line = 1;
+		ds->x = NULL;
+		ds->y = NULL;
+		ds->z = NULL;
+		ds->geom_id = NULL;
+		ds->geom_type = NULL;
+		ds->flags = NULL;
+		ds->records = NULL;
+		parser_data_store_resize ( ds, st[k].num_records );
+		for ( j = 0; j < ds->num_records; j ++ ) {
+			snapshot_record *s = &rec[st[k].first_record + j];
+			r = &ds->records[j];
+			r->line = s->line;
+			ds->x[j] = s->x;
+			ds->y[j] = s->y;
+			ds->z[j] = s->z;
+			ds->geom_id[j] = s->geom_id;
+			r->part_id = s->part_id;
+			ds->geom_type[j] = s->geom_type;
+			ds->flags[j] = 0;
+			if ( s->flags & SNAPSHOT_FLAG_WRITTEN_OUT )
+				ds->flags[j] |= PARSER_RECORD_WRITTEN_OUT;
+			if ( s->flags & SNAPSHOT_FLAG_VALID )
+				ds->flags[j] |= PARSER_RECORD_VALID;
+			if ( s->flags & SNAPSHOT_FLAG_EMPTY )
+				ds->flags[j] |= PARSER_RECORD_EMPTY;
+			if ( s->values != SNAPSHOT_NONE ) {
+				r->contents = &data->contents[s->values];
+				if ( s->flags & SNAPSHOT_FLAG_SKIP ) {
+					r->skip = &data->skip[s->values];
+				}
+			}
+			if ( s->tag != SNAPSHOT_NONE ) {
+				r->tag = (char*) ( strings + s->tag );
+			}
+			if ( s->key_field >= 0 ) {
+				r->key = r->contents[s->key_field];
+			} else if ( s->key != SNAPSHOT_NONE ) {
+				r->key = (char*) ( strings + s->key );
+			}
+		}
+		ds->output_points = NULL;
+		ds->output_points_raw = NULL;
+		ds->output_lines = NULL;
+		ds->output_polygons = NULL;
+		ds->snapshot = data;
+		data->refs ++;
+		storage[k] = ds;
+		topo_errors[k] = st[k].topo_errors;
+	}
+
+	*fused_records = head->fused_records;
+	*duplicate_records = head->duplicate_records;
+	geom_set_next_id ( head->next_id );
+
+	err_show ( ERR_NOTE, _("\nSnapshot: loaded %u records from \"%s\" (input not parsed)."),
+			(unsigned int) head->num_records, opts->snapshot );
+
+	return ( storage );
+}
+
+
+/*
+ * Releases a data store's share of snapshot "data". The snapshot's
+ * memory is released once no data store uses it any more.
+ */
+void snapshot_release ( snapshot_data *data )
+{
+	data->refs --;
+	if ( data->refs < 1 ) {
+		snapshot_close ( data );
+	}
+}
@@ -0,0 +1,155 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	snapshot.h
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Snapshots ("--snapshot="): saves the parsed input data, as
+ * 				it is after multiplexing, cleaning, fusing and checking of
+ * 				unique attributes, in a binary file. Later runs on the same
+ * 				input (e.g. to produce another output format or to try other
+ * 				topology settings) load the data from there instead of
+ * 				parsing the input again.
+ *
+ * 				A snapshot is only used if it was made from the same parser
+ * 				schema, input files and options that affect parsing. If any
+ * 				of these have changed, the input is parsed again and the
+ * 				snapshot is replaced.
+ *
+ * 				The file consists of a header, a table of data stores, a
+ * 				table of records (all of fixed size), a table of field
+ * 				values and a pool of strings. Field values, tags and keys
+ * 				are stored as offsets into the string pool. The file is
+ * 				mapped into memory (where possible) and the strings are
+ * 				used from there, without copying them. Snapshots are only
+ * 				meant to be read on the system that wrote them.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <stddef.h>
+
+#include "global.h"
+
+#include "options.h"
+#include "parser.h"
+
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/* first bytes of a snapshot file */
+#define SNAPSHOT_MAGIC			"S2GSNAP"
+
+/* format version (increase whenever the layout below changes) */
+#define SNAPSHOT_VERSION		1
+
+/* written in the machine's byte order (detects files from other systems) */
+#define SNAPSHOT_BYTE_ORDER		0x01020304U
+
+/* extension of a snapshot while it is being written */
+#define SNAPSHOT_TEMP_EXTENSION	".tmp"
+
+/* marks a missing string or field table entry */
+#define SNAPSHOT_NONE			((unsigned long long) -1)
+
+/* record flags */
+#define SNAPSHOT_FLAG_WRITTEN_OUT	1
+#define SNAPSHOT_FLAG_VALID			2
+#define SNAPSHOT_FLAG_EMPTY			4
+#define SNAPSHOT_FLAG_SKIP			8 /* record has a "skip" array */
+
+/*
+ * File header. The sections follow in this order, each starting
+ * right after the one before: data stores ("num_input"), records
+ * ("num_records"), field values ("num_values" string offsets),
+ * "skip" flags ("num_values" bytes), strings ("strings_size" bytes).
+ */
+typedef struct snapshot_header snapshot_header;
+struct snapshot_header
+{
+	char magic[8]; /* SNAPSHOT_MAGIC */
+	unsigned int version; /* SNAPSHOT_VERSION */
+	unsigned int byte_order; /* SNAPSHOT_BYTE_ORDER */
+	unsigned int record_size; /* size of one snapshot_record (detects different builds) */
+	unsigned int config; /* hash of parser schema, input files and parsing options */
+	unsigned int num_input; /* number of data stores */
+	unsigned int num_fields; /* number of fields in each record */
+	unsigned int fused_records; /* result of parser_ds_fuse() */
+	unsigned int duplicate_records; /* result of parser_ds_validate_unique() */
+	unsigned int next_id; /* geom ID to continue with */
+	unsigned int reserved;
+	unsigned long long num_records; /* in all data stores */
+	unsigned long long num_values; /* in the field value table */
+	unsigned long long strings_size; /* size of the string pool (bytes) */
+	unsigned long long file_size; /* detects truncated files */
+};
+
+/*
+ * One data store.
+ */
+typedef struct snapshot_store snapshot_store;
+struct snapshot_store
+{
+	double offset_x, offset_y, offset_z;
+	unsigned long long first_record; /* index of its first record in the record table */
+	unsigned int num_records; /* only records in use ("slot" of the data store) */
+	unsigned int num_points;
+	unsigned int num_lines;
+	unsigned int num_polygons;
+	unsigned int topo_errors; /* topological errors removed while cleaning */
+	unsigned int reserved;
+};
+
+/*
+ * One record (see parser_record).
+ */
+typedef struct snapshot_record snapshot_record;
+struct snapshot_record
+{
+	double x, y, z;
+	unsigned long long values; /* index of first field value (or SNAPSHOT_NONE if no contents) */
+	unsigned long long tag; /* string offset (or SNAPSHOT_NONE) */
+	unsigned long long key; /* string offset, if "key" is not one of the field values */
+	unsigned int line;
+	unsigned int geom_id;
+	unsigned int part_id;
+	int key_field; /* field value that "key" points to (-1 if none) */
+	short geom_type;
+	unsigned char flags; /* SNAPSHOT_FLAG_* */
+	unsigned char reserved[5];
+};
+
+/*
+ * A loaded snapshot. It owns the field values of all records in
+ * the data stores made from it and is released with the last of them.
+ */
+typedef struct snapshot_data snapshot_data;
+struct snapshot_data
+{
+	char *addr; /* file contents */
+	size_t size;
+	BOOLEAN mapped; /* TRUE if "addr" is mapped, FALSE if allocated */
+	int refs; /* number of data stores that use this snapshot */
+	char **contents; /* "contents" arrays of all records */
+	BOOLEAN *skip; /* "skip" arrays of all records */
+};
+
+/* make data stores from a valid snapshot; returns NULL if there is none */
+parser_data_store **snapshot_load ( options *opts, parser_desc *parser, unsigned int *topo_errors,
+		unsigned int *fused_records, unsigned int *duplicate_records );
+
+/* write parsed data stores to a snapshot file */
+int snapshot_save ( options *opts, parser_desc *parser, parser_data_store **storage,
+		unsigned int *topo_errors, unsigned int fused_records, unsigned int duplicate_records );
+
+/* called by parser_data_store_destroy() for data stores made from a snapshot */
+void snapshot_release ( snapshot_data *data );
+
+#endif /* SNAPSHOT_H */
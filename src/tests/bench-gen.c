@@ -0,0 +1,530 @@
+
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	tests/bench-gen.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Generate synthetic survey data and a matching parser
+ * 				schema for benchmarking. The data is modelled on the
+ * 				files in "samples/" and can be produced for all four
+ * 				tagging modes ("min", "max", "end", "none").
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+/* tagging modes (as in the parser schema) */
+#define BENCH_MODE_MIN	0
+#define BENCH_MODE_MAX	1
+#define BENCH_MODE_END	2
+#define BENCH_MODE_NONE	3
+
+static const char *BENCH_MODE_NAMES[] = { "min", "max", "end", "none", NULL };
+
+/* geometry types */
+#define BENCH_POINT	0
+#define BENCH_LINE	1
+#define BENCH_POLY	2
+
+/* geometry tags (as in the sample parser schemas) */
+static const char BENCH_TAGS[] = { '.', '$', '@' };
+
+/* feature type codes (as in the sample data) */
+static const char *BENCH_TYPES_POINT[] = { "AU", "AG", "BR", "CK", "FE", "GL", "KE" };
+static const char *BENCH_TYPES_LINE[] = { "LO", "LI", "US" };
+static const char *BENCH_TYPES_POLY[] = { "GR", "LO", "LI", "US" };
+
+/* origin and cell size of the synthetic survey grid (m) */
+#define BENCH_ORIGIN_X	3513000.0
+#define BENCH_ORIGIN_Y	5279000.0
+#define BENCH_ORIGIN_Z	399.0
+#define BENCH_CELL		10.0
+
+/* gap left between a dangling line node and its neighbour (m) */
+#define BENCH_DANGLE_GAP	0.02
+
+
+/*
+ * Generator settings and state.
+ */
+typedef struct bench_gen bench_gen;
+struct bench_gen
+{
+	int mode; /* tagging mode (BENCH_MODE_*) */
+	unsigned long num_features; /* number of geometries to write */
+	unsigned long num_records; /* stop after this many records (0 = no limit) */
+	int vertices; /* mean number of vertices per line or polygon */
+	int pct_points; /* share of points (percent) */
+	int pct_lines; /* share of lines (percent); the rest are polygons */
+	double overlap; /* fraction of polygons that overlap their neighbours */
+	double dangle; /* fraction of lines that end just short of their neighbour */
+	double multipart; /* fraction of geometries that are parts of an earlier one */
+	unsigned long seed; /* seed for pseudo-random numbers */
+	const char *dir; /* output directory */
+	/* state */
+	unsigned long long rand; /* pseudo-random number generator state */
+	unsigned long idx; /* running record index */
+	unsigned long key; /* last primary key used */
+	unsigned long keys[3][2]; /* last two keys for each geometry type */
+	unsigned long last_key; /* key of last geometry written */
+	unsigned long cols; /* number of grid columns */
+};
+
+
+/*
+ * Returns the next pseudo-random number in [0;1).
+ * This uses a 64 bit xorshift generator, so that the same seed
+ * produces the same data on every platform.
+ */
+double bench_rand ( bench_gen *gen ) {
+	gen->rand ^= gen->rand << 13;
+	gen->rand ^= gen->rand >> 7;
+	gen->rand ^= gen->rand << 17;
+	return ( (double) ( gen->rand >> 11 ) / 9007199254740992.0 );
+}
+
+
+/*
+ * Returns a pseudo-random number in [min;max).
+ */
+double bench_rand_range ( bench_gen *gen, double min, double max ) {
+	return ( min + bench_rand ( gen ) * ( max - min ) );
+}
+
+
+/*
+ * Returns a reproducible Y offset (0..BENCH_CELL) for the point at which
+ * lines cross the vertical grid border "col" in grid row "row". Lines in
+ * neighbouring cells meet at these points.
+ */
+double bench_border_y ( unsigned long col, unsigned long row ) {
+	unsigned long long h = ( (unsigned long long) col * 2654435761ULL ) ^
+			( (unsigned long long) row * 40503ULL );
+	h ^= h >> 15;
+	h *= 2246822519ULL;
+	h ^= h >> 13;
+	return ( 2.0 + (double) ( h % 6000 ) / 1000.0 );
+}
+
+
+/*
+ * Writes the parser schema for the current tagging mode.
+ * Returns 0 on success, -1 on error.
+ */
+int bench_write_schema ( bench_gen *gen, const char *path ) {
+	FILE *fp;
+	const char *mode = BENCH_MODE_NAMES[gen->mode];
+	/* mode "min" needs exact field counts, as in the sample schema */
+	const char *merge = ( gen->mode == BENCH_MODE_MIN ) ? "No" : "Yes";
+
+	fp = fopen ( path, "w" );
+	if ( fp == NULL ) {
+		fprintf ( stderr, "Cannot create '%s': %s\n", path, strerror (errno) );
+		return ( -1 );
+	}
+
+	fprintf ( fp, "# Synthetic parser schema for tagging mode \"%s\".\n", mode );
+	fprintf ( fp, "# Generated by bench-gen for use with bench_%s.dat.\n\n", mode );
+	fprintf ( fp, "[Parser]\n" );
+	fprintf ( fp, "name = survey2gis parser description: benchmark for mode \"%s\"\n", mode );
+	fprintf ( fp, "tagging_mode = %s\n", mode );
+	if ( gen->mode == BENCH_MODE_END ) {
+		fprintf ( fp, "tag_field = AUX\n" );
+	}
+	if ( gen->mode == BENCH_MODE_MIN || gen->mode == BENCH_MODE_MAX ) {
+		fprintf ( fp, "tag_field = TAG\n" );
+	}
+	if ( gen->mode == BENCH_MODE_MAX || gen->mode == BENCH_MODE_END ) {
+		/* multi-part geometries need a unique key */
+		fprintf ( fp, "key_field = ID\n" );
+		fprintf ( fp, "key_unique = Yes\n" );
+	}
+	if ( gen->mode != BENCH_MODE_NONE ) {
+		fprintf ( fp, "tag_strict = No\n" );
+	}
+	fprintf ( fp, "no_data = -1\n" );
+	if ( gen->mode == BENCH_MODE_MIN || gen->mode == BENCH_MODE_MAX ) {
+		fprintf ( fp, "geom_tag_point = \"%c\"\n", BENCH_TAGS[BENCH_POINT] );
+	}
+	if ( gen->mode != BENCH_MODE_NONE ) {
+		fprintf ( fp, "geom_tag_line = \"%c\"\n", BENCH_TAGS[BENCH_LINE] );
+		fprintf ( fp, "geom_tag_poly = \"%c\"\n", BENCH_TAGS[BENCH_POLY] );
+	}
+	fprintf ( fp, "coor_x = COORX\ncoor_y = COORY\ncoor_z = COORZ\ncomment_mark = #\n\n" );
+
+	/* constant field first, as in the sample schemas */
+	fprintf ( fp, "[Field]\nname = CONST1\ninfo = pseudo field of type double\ntype = double\nvalue = 123.45\n\n" );
+	fprintf ( fp, "[Field]\nname = IDX\ninfo = Measurement index\ntype = integer\n" );
+	fprintf ( fp, "empty_allowed = No\n%sseparator = space\nmerge_separators = %s\nunique = Yes\n\n",
+			gen->mode == BENCH_MODE_MIN ? "persistent = Yes\n" : "", merge );
+	fprintf ( fp, "[Field]\nname = LEVEL\ninfo = N/A\ntype = Integer\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = _\nmerge_separators = No\n\n" );
+	fprintf ( fp, "[Field]\nname = TYPE\ninfo = N/A\ntype = Text\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = _\nmerge_separators = No\nchange_case = upper\n" );
+	fprintf ( fp, "@AU = Gold\n@AG = Silver\n@KE = Pottery\n\n" );
+	fprintf ( fp, "[Field]\nname = AUX\ninfo = N/A\ntype = Text\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = _\nmerge_separators = No\nchange_case = upper\n\n" );
+	if ( gen->mode == BENCH_MODE_MAX || gen->mode == BENCH_MODE_NONE ) {
+		fprintf ( fp, "[Field]\nname = FEAT\ninfo = Feature number\ntype = Integer\n" );
+		fprintf ( fp, "empty_allowed = No\nseparator = %s\nmerge_separators = %s\n\n",
+				gen->mode == BENCH_MODE_MAX ? "_" : "space",
+				gen->mode == BENCH_MODE_MAX ? "No" : merge );
+	}
+	if ( gen->mode == BENCH_MODE_MAX ) {
+		fprintf ( fp, "[Field]\nname = TAG\ninfo = N/A\ntype = Text\n" );
+		fprintf ( fp, "empty_allowed = No\nseparator = _\nmerge_separators = No\nskip = Yes\n\n" );
+	}
+	if ( gen->mode != BENCH_MODE_NONE ) {
+		fprintf ( fp, "[Field]\nname = ID\ninfo = Primary key\ntype = Integer\n" );
+		fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\n\n", merge );
+	}
+	if ( gen->mode == BENCH_MODE_MIN ) {
+		fprintf ( fp, "[Field]\nname = TAG\ninfo = N/A\ntype = Text\n" );
+		fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\nskip = Yes\n\n", merge );
+	}
+	fprintf ( fp, "[Field]\nname = XLABEL\ninfo = Useless field\ntype = text\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\nskip = Yes\n\n", merge );
+	fprintf ( fp, "[Field]\nname = COORX\ninfo = Holds X coordinate\ntype = double\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\n\n", merge );
+	fprintf ( fp, "[Field]\nname = YLABEL\ninfo = Useless field\ntype = text\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\nskip = Yes\n\n", merge );
+	fprintf ( fp, "[Field]\nname = COORY\ninfo = Holds Y coordinate\ntype = double\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\n\n", merge );
+	fprintf ( fp, "[Field]\nname = ZLABEL\ninfo = Useless field\ntype = text\n" );
+	fprintf ( fp, "empty_allowed = No\nseparator = space\nmerge_separators = %s\nskip = Yes\n\n", merge );
+	fprintf ( fp, "[Field]\nname = COORZ\ninfo = Holds Z coordinate\ntype = double\n" );
+	fprintf ( fp, "empty_allowed = No\n" );
+
+	if ( fclose ( fp ) != 0 ) {
+		fprintf ( stderr, "Error writing '%s': %s\n", path, strerror (errno) );
+		return ( -1 );
+	}
+	return ( 0 );
+}
+
+
+/*
+ * Returns the primary key for a new geometry of type "type".
+ * A share of "multipart" geometries reuses the key of the last
+ * but one geometry of the same type, so that survey2gis will fuse
+ * them into multi-part geometries. Keys are never repeated for
+ * consecutive geometries, because that would join them into one
+ * geometry in mode "max".
+ */
+unsigned long bench_get_key ( bench_gen *gen, int type ) {
+	unsigned long key;
+
+	if ( gen->keys[type][1] > 0 && gen->keys[type][1] != gen->last_key &&
+			bench_rand ( gen ) < gen->multipart ) {
+		key = gen->keys[type][1];
+	} else {
+		gen->key ++;
+		key = gen->key;
+	}
+	gen->keys[type][1] = gen->keys[type][0];
+	gen->keys[type][0] = key;
+	gen->last_key = key;
+
+	return ( key );
+}
+
+
+/*
+ * Writes one vertex record in the format required by the current
+ * tagging mode. "first" and "last" mark the first and last vertex
+ * of the geometry.
+ */
+void bench_write_vertex ( bench_gen *gen, FILE *fp, int type, const char *code,
+		unsigned long key, unsigned long feat, int first, int last,
+		double x, double y, double z )
+{
+	const char *aux = ( type == BENCH_POINT ) ? "FZ" : "W";
+	char tag = BENCH_TAGS[type];
+
+	gen->idx ++;
+	switch ( gen->mode ) {
+	case BENCH_MODE_MIN:
+		if ( first ) {
+			fprintf ( fp, "%lu 1_%s_%s_%lu %c X %.3f Y %.3f Z %.3f\n",
+					gen->idx, code, aux, key, tag, x, y, z );
+		} else {
+			fprintf ( fp, "%lu %.3f %.3f %.3f\n", gen->idx, x, y, z );
+		}
+		break;
+	case BENCH_MODE_MAX:
+		fprintf ( fp, "%lu 1_%s_%s_%lu_%c_%lu X %.3f Y %.3f Z %.3f\n",
+				gen->idx, code, aux, feat, tag, key, x, y, z );
+		break;
+	case BENCH_MODE_END:
+		if ( last && type != BENCH_POINT ) {
+			fprintf ( fp, "%lu 1_%s_%c_%lu X %.3f Y %.3f Z %.3f\n",
+					gen->idx, code, tag, key, x, y, z );
+		} else {
+			fprintf ( fp, "%lu 1_%s_%s_%lu X %.3f Y %.3f Z %.3f\n",
+					gen->idx, code, aux, key, x, y, z );
+		}
+		break;
+	default:
+		fprintf ( fp, "%lu 1_%s_%s_%lu X %.3f Y %.3f Z %.3f\n",
+				gen->idx, code, aux, feat, x, y, z );
+		break;
+	}
+}
+
+
+/*
+ * Writes one geometry into grid cell number "cell".
+ */
+void bench_write_feature ( bench_gen *gen, FILE *fp, unsigned long cell ) {
+	unsigned long col = cell % gen->cols;
+	unsigned long row = cell / gen->cols;
+	double ox = BENCH_ORIGIN_X + (double) col * BENCH_CELL;
+	double oy = BENCH_ORIGIN_Y + (double) row * BENCH_CELL;
+	double pick = bench_rand ( gen ) * 100.0;
+	unsigned long key;
+	int type, num_vertices, i;
+	const char *code;
+
+	if ( pick < (double) gen->pct_points ) {
+		type = BENCH_POINT;
+		code = BENCH_TYPES_POINT[(int) ( bench_rand ( gen ) * 7 )];
+	} else if ( pick < (double) ( gen->pct_points + gen->pct_lines ) ) {
+		type = BENCH_LINE;
+		code = BENCH_TYPES_LINE[(int) ( bench_rand ( gen ) * 3 )];
+	} else {
+		type = BENCH_POLY;
+		code = BENCH_TYPES_POLY[(int) ( bench_rand ( gen ) * 4 )];
+	}
+	key = bench_get_key ( gen, type );
+
+	/* vary number of vertices by +/- 50% */
+	num_vertices = (int) floor ( bench_rand_range ( gen, 0.5, 1.5 ) * (double) gen->vertices + 0.5 );
+
+	if ( type == BENCH_POINT ) {
+		bench_write_vertex ( gen, fp, type, code, key, cell, 1, 1,
+				ox + bench_rand_range ( gen, 1.0, BENCH_CELL - 1.0 ),
+				oy + bench_rand_range ( gen, 1.0, BENCH_CELL - 1.0 ),
+				BENCH_ORIGIN_Z + bench_rand ( gen ) );
+	}
+
+	if ( type == BENCH_LINE ) {
+		/* Lines cross the cell from left to right border, so that
+		   lines in neighbouring cells share their end nodes. */
+		double y_start = bench_border_y ( col, row );
+		double y_end = bench_border_y ( col + 1, row );
+		double x_end = BENCH_CELL;
+		if ( num_vertices < 2 ) {
+			num_vertices = 2;
+		}
+		if ( bench_rand ( gen ) < gen->dangle ) {
+			x_end -= BENCH_DANGLE_GAP;
+		}
+		for ( i = 0; i < num_vertices; i ++ ) {
+			double t = (double) i / (double) ( num_vertices - 1 );
+			double x = ox + t * x_end;
+			double y = oy + y_start + t * ( y_end - y_start );
+			if ( i > 0 && i < num_vertices - 1 ) {
+				y += bench_rand_range ( gen, -1.5, 1.5 );
+			}
+			bench_write_vertex ( gen, fp, type, code, key, cell, i == 0, i == num_vertices - 1,
+					x, y, BENCH_ORIGIN_Z + bench_rand ( gen ) );
+		}
+	}
+
+	if ( type == BENCH_POLY ) {
+		/* Polygons are jagged circles around the cell center;
+		   overlapping ones reach into the neighbouring cells. */
+		double radius = BENCH_CELL * 0.3;
+		if ( num_vertices < 3 ) {
+			num_vertices = 3;
+		}
+		if ( bench_rand ( gen ) < gen->overlap ) {
+			radius = BENCH_CELL * 0.8;
+		}
+		for ( i = 0; i < num_vertices; i ++ ) {
+			double a = 2.0 * M_PI * (double) i / (double) num_vertices;
+			double r = radius * bench_rand_range ( gen, 0.8, 1.0 );
+			bench_write_vertex ( gen, fp, type, code, key, cell, i == 0, i == num_vertices - 1,
+					ox + BENCH_CELL / 2.0 + r * cos ( a ),
+					oy + BENCH_CELL / 2.0 + r * sin ( a ),
+					BENCH_ORIGIN_Z + bench_rand ( gen ) );
+		}
+	}
+}
+
+
+/*
+ * Writes the survey data file.
+ * Returns 0 on success, -1 on error.
+ */
+int bench_write_data ( bench_gen *gen, const char *path ) {
+	FILE *fp;
+	unsigned long i, num_features;
+
+	fp = fopen ( path, "w" );
+	if ( fp == NULL ) {
+		fprintf ( stderr, "Cannot create '%s': %s\n", path, strerror (errno) );
+		return ( -1 );
+	}
+
+	/* with a record limit, estimate the number of features from the
+	   mean number of records per feature (for the grid size only) */
+	num_features = gen->num_features;
+	if ( gen->num_records > 0 ) {
+		double points = (double) gen->pct_points / 100.0;
+		num_features = (unsigned long) ( (double) gen->num_records /
+				( points + ( 1.0 - points ) * (double) gen->vertices ) ) + 1;
+	}
+	gen->cols = (unsigned long) ceil ( sqrt ( (double) num_features ) );
+	if ( gen->cols < 1 ) {
+		gen->cols = 1;
+	}
+
+	fprintf ( fp, "# Synthetic survey data for tagging mode \"%s\".\n", BENCH_MODE_NAMES[gen->mode] );
+	fprintf ( fp, "# Generated by bench-gen (seed %lu). Use with bench_%s.txt.\n",
+			gen->seed, BENCH_MODE_NAMES[gen->mode] );
+	for ( i = 0; ; i ++ ) {
+		if ( gen->num_records > 0 ) {
+			if ( gen->idx >= gen->num_records ) {
+				break;
+			}
+		} else if ( i >= num_features ) {
+			break;
+		}
+		bench_write_feature ( gen, fp, i );
+	}
+
+	if ( fclose ( fp ) != 0 ) {
+		fprintf ( stderr, "Error writing '%s': %s\n", path, strerror (errno) );
+		return ( -1 );
+	}
+	fprintf ( stdout, "%s: %lu features, %lu records\n", path, i, gen->idx );
+	return ( 0 );
+}
+
+
+/*
+ * Print usage instructions.
+ */
+void bench_usage ( const char *cmd ) {
+	fprintf ( stdout, "Usage: %s [options]\n", cmd );
+	fprintf ( stdout, "Writes bench_<mode>.txt (parser schema) and bench_<mode>.dat (survey data).\n" );
+	fprintf ( stdout, "  -m mode\ttagging mode: min, max, end or none (default: max)\n" );
+	fprintf ( stdout, "  -n count\tnumber of features (default: 1000)\n" );
+	fprintf ( stdout, "  -r count\tstop after this many records (default: 0 = no limit)\n" );
+	fprintf ( stdout, "  -v count\tmean number of vertices per line/polygon (default: 8)\n" );
+	fprintf ( stdout, "  -p percent\tshare of points (default: 40)\n" );
+	fprintf ( stdout, "  -l percent\tshare of lines (default: 30), the rest are polygons\n" );
+	fprintf ( stdout, "  -O fraction\tpolygons that overlap their neighbours (default: 0.1)\n" );
+	fprintf ( stdout, "  -D fraction\tlines with a dangling end node (default: 0.1)\n" );
+	fprintf ( stdout, "  -K fraction\tgeometries that share the key of an earlier one (default: 0.05)\n" );
+	fprintf ( stdout, "\t\t(modes \"max\" and \"end\" only)\n" );
+	fprintf ( stdout, "  -s seed\tseed for pseudo-random numbers (default: 1)\n" );
+	fprintf ( stdout, "  -o dir\t\toutput directory (default: .)\n" );
+}
+
+
+int main ( int argc, char *argv[] ) {
+	bench_gen gen;
+	char path[4096];
+	int option, i;
+
+	memset ( &gen, 0, sizeof (bench_gen) );
+	gen.mode = BENCH_MODE_MAX;
+	gen.num_features = 1000;
+	gen.vertices = 8;
+	gen.pct_points = 40;
+	gen.pct_lines = 30;
+	gen.overlap = 0.1;
+	gen.dangle = 0.1;
+	gen.multipart = 0.05;
+	gen.seed = 1;
+	gen.dir = ".";
+
+	while ( ( option = getopt ( argc, argv, "m:n:r:v:p:l:O:D:K:s:o:h" ) ) != -1 ) {
+		switch ( option ) {
+		case 'm':
+			gen.mode = -1;
+			for ( i = 0; BENCH_MODE_NAMES[i] != NULL; i ++ ) {
+				if ( !strcmp ( BENCH_MODE_NAMES[i], optarg ) ) {
+					gen.mode = i;
+				}
+			}
+			if ( gen.mode < 0 ) {
+				fprintf ( stderr, "Invalid tagging mode: '%s'.\n", optarg );
+				return ( EXIT_FAILURE );
+			}
+			break;
+		case 'n':
+			gen.num_features = strtoul ( optarg, NULL, 10 );
+			break;
+		case 'r':
+			gen.num_records = strtoul ( optarg, NULL, 10 );
+			break;
+		case 'v':
+			gen.vertices = atoi ( optarg );
+			break;
+		case 'p':
+			gen.pct_points = atoi ( optarg );
+			break;
+		case 'l':
+			gen.pct_lines = atoi ( optarg );
+			break;
+		case 'O':
+			gen.overlap = atof ( optarg );
+			break;
+		case 'D':
+			gen.dangle = atof ( optarg );
+			break;
+		case 'K':
+			gen.multipart = atof ( optarg );
+			break;
+		case 's':
+			gen.seed = strtoul ( optarg, NULL, 10 );
+			break;
+		case 'o':
+			gen.dir = optarg;
+			break;
+		default:
+			bench_usage ( argv[0] );
+			return ( option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE );
+		}
+	}
+
+	if ( gen.vertices < 1 || gen.pct_points < 0 || gen.pct_lines < 0 ||
+			gen.pct_points + gen.pct_lines > 100 ) {
+		fprintf ( stderr, "Invalid vertex count or feature shares.\n" );
+		return ( EXIT_FAILURE );
+	}
+
+	/* the generator state must never be zero */
+	gen.rand = 88172645463325252ULL ^ ( (unsigned long long) gen.seed * 2654435761ULL );
+	if ( gen.rand == 0 ) {
+		gen.rand = 88172645463325252ULL;
+	}
+
+	snprintf ( path, sizeof (path), "%s/bench_%s.txt", gen.dir, BENCH_MODE_NAMES[gen.mode] );
+	if ( bench_write_schema ( &gen, path ) != 0 ) {
+		return ( EXIT_FAILURE );
+	}
+	snprintf ( path, sizeof (path), "%s/bench_%s.dat", gen.dir, BENCH_MODE_NAMES[gen.mode] );
+	if ( bench_write_data ( &gen, path ) != 0 ) {
+		return ( EXIT_FAILURE );
+	}
+
+	return ( EXIT_SUCCESS );
+}
@@ -0,0 +1,594 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	tests/bench-kernels.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Micro-benchmarks for the innermost geometry, number
+ * 				conversion and selection functions. Each kernel is run
+ * 				on a pool of pseudo-random (but reproducible) inputs
+ * 				and the time and the number of heap allocations per
+ * 				call are reported. Changes to these functions (or to
+ * 				the layout of the data they work on) should be
+ * 				measured with this before and after.
+ *
+ * 				Heap allocations are counted by wrapping malloc(),
+ * 				calloc(), realloc() and strdup() at link time
+ * 				("-Wl,--wrap=..."). This needs the GNU linker and
+ * 				is enabled by defining BENCH_WRAP_ALLOC. Otherwise,
+ * 				"n/a" is reported for allocations.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#define MAIN
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../global.h"
+
+#include "../errors.h"
+#include "../geom.h"
+#include "../gui_form.h"
+#include "../i18n.h"
+#include "../options.h"
+#include "../parser.h"
+#include "../selections.h"
+#include "../tools.h"
+
+#include "../multclip/polyarea.h"
+
+
+/* These are normally defined in main.c. */
+char *PRG_NAME_CLI;
+char *PRG_PATH_CLI;
+char *PRG_DIR_CLI;
+
+
+/* number of different inputs prepared for each kernel */
+#define BENCH_POOL	256
+
+/* side length of the area in which random geometries are placed */
+#define BENCH_EXTENT	100.0
+
+
+/*
+ * Allocation counters. These are only updated if the program
+ * was linked with "-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup".
+ */
+static unsigned long long BENCH_ALLOCS = 0;
+
+#ifdef BENCH_WRAP_ALLOC
+void *__real_malloc ( size_t size );
+void *__real_calloc ( size_t nmemb, size_t size );
+void *__real_realloc ( void *ptr, size_t size );
+char *__real_strdup ( const char *s );
+
+void *__wrap_malloc ( size_t size ) {
+	BENCH_ALLOCS ++;
+	return ( __real_malloc ( size ) );
+}
+
+void *__wrap_calloc ( size_t nmemb, size_t size ) {
+	BENCH_ALLOCS ++;
+	return ( __real_calloc ( nmemb, size ) );
+}
+
+void *__wrap_realloc ( void *ptr, size_t size ) {
+	BENCH_ALLOCS ++;
+	return ( __real_realloc ( ptr, size ) );
+}
+
+char *__wrap_strdup ( const char *s ) {
+	BENCH_ALLOCS ++;
+	return ( __real_strdup ( s ) );
+}
+#endif
+
+
+/*
+ * Benchmark settings and inputs.
+ */
+typedef struct bench_kernels bench_kernels;
+struct bench_kernels
+{
+	double min_time; /* min. run time per kernel (s) */
+	int vertices; /* number of vertices per polygon ring */
+	unsigned long seed; /* seed for pseudo-random numbers */
+	const char *only; /* name of single kernel to run (or NULL) */
+	/* state */
+	unsigned long long rand; /* pseudo-random number generator state */
+	double seg[BENCH_POOL][4]; /* line segments: x1, y1, x2, y2 */
+	double pts[BENCH_POOL][2]; /* points: x, y */
+	geom_store_polygon polys[BENCH_POOL]; /* single-ring polygons; odd ones lie within or overlap their predecessor */
+	char *nums[BENCH_POOL]; /* numeric strings */
+	short sel_type[BENCH_POOL]; /* selections: type, field type, content and expression */
+	BOOLEAN sel_case[BENCH_POOL];
+	short sel_field[BENCH_POOL];
+	char *sel_content[BENCH_POOL];
+	char *sel_expr[BENCH_POOL];
+	POLYAREA *areas[BENCH_POOL]; /* 'multclip' versions of "polys" (odd ones shifted to overlap) */
+	/* result sink, to keep the compiler from optimizing calls away */
+	volatile long sink;
+};
+
+
+/* A kernel runs "n" operations, starting at pool index "i". */
+typedef void (*bench_kernel_func) ( bench_kernels *bk, unsigned long i, unsigned long n );
+
+
+/*
+ * Returns the next pseudo-random number in [0;1).
+ * Same 64 bit xorshift generator as in bench-gen.c.
+ */
+double bench_rand ( bench_kernels *bk ) {
+	bk->rand ^= bk->rand << 13;
+	bk->rand ^= bk->rand >> 7;
+	bk->rand ^= bk->rand << 17;
+	return ( (double) ( bk->rand >> 11 ) / 9007199254740992.0 );
+}
+
+
+/*
+ * Returns a pseudo-random number in [min;max).
+ */
+double bench_rand_range ( bench_kernels *bk, double min, double max ) {
+	return ( min + bench_rand ( bk ) * ( max - min ) );
+}
+
+
+/*
+ * Fills "part" with a closed, star-shaped (and therefore simple) ring
+ * of "vertices"+1 vertices around cx/cy, in counter-clockwise order.
+ * The distance of each vertex from cx/cy is between 0.6 and 1.0 times
+ * "radius".
+ */
+void bench_make_ring ( bench_kernels *bk, geom_part *part, int vertices,
+		double cx, double cy, double radius ) {
+	int i;
+
+	memset ( part, 0, sizeof (geom_part) );
+	part->num_vertices = vertices + 1;
+	part->X = malloc ( sizeof (double) * part->num_vertices );
+	part->Y = malloc ( sizeof (double) * part->num_vertices );
+	part->Z = calloc ( part->num_vertices, sizeof (double) );
+	for ( i = 0; i < vertices; i ++ ) {
+		double a = 2.0 * M_PI * (double) i / (double) vertices;
+		double r = radius * bench_rand_range ( bk, 0.6, 1.0 );
+		part->X[i] = cx + r * cos ( a );
+		part->Y[i] = cy + r * sin ( a );
+	}
+	part->X[vertices] = part->X[0];
+	part->Y[vertices] = part->Y[0];
+}
+
+
+/*
+ * Reverses the vertex order of a ring.
+ */
+void bench_reverse_ring ( geom_part *part ) {
+	unsigned int first = 0;
+	unsigned int last = part->num_vertices - 1;
+
+	while ( first < last ) {
+		double x = part->X[first];
+		double y = part->Y[first];
+		part->X[first] = part->X[last];
+		part->Y[first] = part->Y[last];
+		part->X[last] = x;
+		part->Y[last] = y;
+		first ++;
+		last --;
+	}
+}
+
+
+/*
+ * Converts the (counter-clockwise) ring of a polygon into a 'multclip'
+ * polygon, shifted by dx/dy. This is done as in geom.c.
+ */
+POLYAREA *bench_make_area ( geom_store_polygon *poly, double dx, double dy ) {
+	POLYAREA *area = poly_Create ();
+	PLINE *ring = NULL;
+	Vector v;
+	unsigned int i;
+
+	/* 'multclip' does not require 1st vertex = last vertex */
+	for ( i = 0; i < poly->parts[0].num_vertices - 1; i ++ ) {
+		v[0] = poly->parts[0].X[i] + dx;
+		v[1] = poly->parts[0].Y[i] + dy;
+		v[2] = 0.0;
+		if ( ring == NULL ) {
+			ring = poly_NewContour ( v );
+		} else {
+			poly_InclVertex ( ring->head.prev, poly_CreateNode ( v ) );
+		}
+	}
+	poly_PreContour ( ring, TRUE );
+	if ( !poly_InclContour ( area, ring ) || !poly_Valid ( area ) ) {
+		fprintf ( stderr, "Invalid 'multclip' polygon.\n" );
+		exit ( EXIT_FAILURE );
+	}
+
+	return ( area );
+}
+
+
+/*
+ * Prepares the input pools of all kernels.
+ */
+void bench_setup ( bench_kernels *bk ) {
+	static const char *words[] = { "AU", "AG", "BR", "CK", "FE", "GL", "KE", "LO", "LI", "US", "GR",
+			"Pfosten", "Grube", "Befund", "Mauer" };
+	char buf[256];
+	double cx = 0.0, cy = 0.0;
+	int i;
+
+	for ( i = 0; i < BENCH_POOL; i ++ ) {
+		int j;
+		/* line segments, anywhere in the extent */
+		for ( j = 0; j < 4; j ++ ) {
+			bk->seg[i][j] = bench_rand_range ( bk, 0.0, BENCH_EXTENT );
+		}
+		/* polygons: even ones at random positions, odd ones nested in or
+		   partly overlapping their predecessor */
+		geom_store_polygon *poly = &bk->polys[i];
+		memset ( poly, 0, sizeof (geom_store_polygon) );
+		poly->num_parts = 1;
+		poly->parts = malloc ( sizeof (geom_part) );
+		if ( i % 2 == 0 ) {
+			cx = bench_rand_range ( bk, 20.0, BENCH_EXTENT - 20.0 );
+			cy = bench_rand_range ( bk, 20.0, BENCH_EXTENT - 20.0 );
+			bench_make_ring ( bk, &poly->parts[0], bk->vertices, cx, cy, 20.0 );
+		} else {
+			/* the predecessor has a min. radius of 12 around cx/cy */
+			if ( bench_rand ( bk ) < 0.5 ) {
+				bench_make_ring ( bk, &poly->parts[0], bk->vertices, cx, cy, 5.0 );
+			} else {
+				bench_make_ring ( bk, &poly->parts[0], bk->vertices, cx + 10.0, cy, 20.0 );
+			}
+		}
+		/* random points in and around the polygon */
+		bk->pts[i][0] = bench_rand_range ( bk, 0.0, BENCH_EXTENT );
+		bk->pts[i][1] = bench_rand_range ( bk, 0.0, BENCH_EXTENT );
+		/* numbers in various formats, as found in survey data */
+		switch ( i % 4 ) {
+		case 0:
+			snprintf ( buf, sizeof (buf), "%.3f", bench_rand_range ( bk, 3500000.0, 3600000.0 ) );
+			break;
+		case 1:
+			snprintf ( buf, sizeof (buf), "%.3f", bench_rand_range ( bk, -1000.0, 1000.0 ) );
+			break;
+		case 2:
+			snprintf ( buf, sizeof (buf), "%d,%03d.%02d", (int) bench_rand_range ( bk, 1.0, 999.0 ),
+					(int) bench_rand_range ( bk, 0.0, 999.0 ), (int) bench_rand_range ( bk, 0.0, 99.0 ) );
+			break;
+		default:
+			snprintf ( buf, sizeof (buf), "%d", (int) bench_rand_range ( bk, 0.0, 100000.0 ) );
+		}
+		bk->nums[i] = strdup ( buf );
+		/* selections of all common types */
+		switch ( i % 6 ) {
+		case 0:
+			bk->sel_type[i] = SELECTION_TYPE_EQ;
+			bk->sel_case[i] = FALSE;
+			bk->sel_field[i] = PARSER_FIELD_TYPE_TEXT;
+			bk->sel_content[i] = strdup ( words[(int) bench_rand_range ( bk, 0.0, 15.0 )] );
+			bk->sel_expr[i] = strdup ( words[(int) bench_rand_range ( bk, 0.0, 15.0 )] );
+			break;
+		case 1:
+			bk->sel_type[i] = SELECTION_TYPE_LT;
+			bk->sel_case[i] = FALSE;
+			bk->sel_field[i] = PARSER_FIELD_TYPE_DOUBLE;
+			bk->sel_content[i] = strdup ( bk->nums[i] );
+			snprintf ( buf, sizeof (buf), "%.2f", bench_rand_range ( bk, -1000.0, 1000.0 ) );
+			bk->sel_expr[i] = strdup ( buf );
+			break;
+		case 2:
+			bk->sel_type[i] = SELECTION_TYPE_RANGE;
+			bk->sel_case[i] = FALSE;
+			bk->sel_field[i] = PARSER_FIELD_TYPE_DOUBLE;
+			snprintf ( buf, sizeof (buf), "%.3f", bench_rand_range ( bk, 0.0, 100.0 ) );
+			bk->sel_content[i] = strdup ( buf );
+			snprintf ( buf, sizeof (buf), "%.1f%s%.1f", bench_rand_range ( bk, 0.0, 50.0 ), SELECTION_RANGE_SEP,
+					bench_rand_range ( bk, 50.0, 100.0 ) );
+			bk->sel_expr[i] = strdup ( buf );
+			break;
+		case 3:
+			bk->sel_type[i] = SELECTION_TYPE_SUB;
+			bk->sel_case[i] = ( bench_rand ( bk ) < 0.5 );
+			bk->sel_field[i] = PARSER_FIELD_TYPE_TEXT;
+			snprintf ( buf, sizeof (buf), "%s %s %d", words[(int) bench_rand_range ( bk, 0.0, 15.0 )],
+					words[(int) bench_rand_range ( bk, 0.0, 15.0 )], (int) bench_rand_range ( bk, 0.0, 1000.0 ) );
+			bk->sel_content[i] = strdup ( buf );
+			bk->sel_expr[i] = strdup ( words[(int) bench_rand_range ( bk, 0.0, 15.0 )] );
+			break;
+		case 4:
+			bk->sel_type[i] = SELECTION_TYPE_REGEXP;
+			bk->sel_case[i] = FALSE;
+			bk->sel_field[i] = PARSER_FIELD_TYPE_TEXT;
+			snprintf ( buf, sizeof (buf), "%s%d", words[(int) bench_rand_range ( bk, 0.0, 15.0 )],
+					(int) bench_rand_range ( bk, 0.0, 1000.0 ) );
+			bk->sel_content[i] = strdup ( buf );
+			bk->sel_expr[i] = strdup ( "^[A-Z][A-Za-z]+[0-9]+$" );
+			break;
+		default:
+			bk->sel_type[i] = SELECTION_TYPE_GTE;
+			bk->sel_case[i] = TRUE;
+			bk->sel_field[i] = PARSER_FIELD_TYPE_INT;
+			snprintf ( buf, sizeof (buf), "%d", (int) bench_rand_range ( bk, 0.0, 1000.0 ) );
+			bk->sel_content[i] = strdup ( buf );
+			snprintf ( buf, sizeof (buf), "%d", (int) bench_rand_range ( bk, 0.0, 1000.0 ) );
+			bk->sel_expr[i] = strdup ( buf );
+		}
+	}
+
+	/* 'multclip' needs counter-clockwise outer rings, so build these
+	   before reversing some of the rings for the winding order test */
+	for ( i = 0; i < BENCH_POOL; i ++ ) {
+		bk->areas[i] = bench_make_area ( &bk->polys[i], 0.0, ( i % 2 == 0 ) ? 0.0 : 3.0 );
+	}
+	for ( i = 0; i < BENCH_POOL; i ++ ) {
+		if ( bench_rand ( bk ) < 0.5 ) {
+			bench_reverse_ring ( &bk->polys[i].parts[0] );
+		}
+	}
+}
+
+
+/*
+ * Releases all input pools.
+ */
+void bench_cleanup ( bench_kernels *bk ) {
+	int i;
+
+	for ( i = 0; i < BENCH_POOL; i ++ ) {
+		free ( bk->polys[i].parts[0].X );
+		free ( bk->polys[i].parts[0].Y );
+		free ( bk->polys[i].parts[0].Z );
+		free ( bk->polys[i].parts );
+		free ( bk->nums[i] );
+		free ( bk->sel_content[i] );
+		free ( bk->sel_expr[i] );
+		poly_Free ( &bk->areas[i] );
+	}
+}
+
+
+/* KERNELS */
+
+void bench_line_intersection ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	double x, y;
+	long hits = 0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		double *a = bk->seg[i % BENCH_POOL];
+		double *b = bk->seg[(i + 1) % BENCH_POOL];
+		hits += geom_tools_line_intersection_2D ( a[0], a[1], a[2], a[3], b[0], b[1], b[2], b[3], &x, &y );
+	}
+	bk->sink += hits;
+}
+
+void bench_point_in_part ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	long hits = 0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		double *p = bk->pts[i % BENCH_POOL];
+		hits += geom_tools_point_in_part_2D ( p[0], p[1], &bk->polys[(i / 7) % BENCH_POOL], 0 );
+	}
+	bk->sink += hits;
+}
+
+void bench_part_in_part ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	long hits = 0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		unsigned long k = ( i % ( BENCH_POOL / 2 ) ) * 2;
+		hits += geom_tools_part_in_part_2D ( &bk->polys[k+1].parts[0], &bk->polys[k].parts[0] );
+	}
+	bk->sink += hits;
+}
+
+void bench_vertex_order ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	long sum = 0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		sum += geom_get_vertex_order ( &bk->polys[i % BENCH_POOL].parts[0] );
+	}
+	bk->sink += sum;
+}
+
+void bench_str_to_dbl ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	BOOLEAN error, overflow;
+	double sum = 0.0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		sum += t_str_to_dbl ( bk->nums[i % BENCH_POOL], '.', ',', &error, &overflow );
+	}
+	bk->sink += (long) sum;
+}
+
+void bench_selection_apply_one ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	long hits = 0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		unsigned long k = i % BENCH_POOL;
+		hits += selection_apply_one ( bk->sel_type[k], bk->sel_case[k], bk->sel_field[k],
+				bk->sel_content[k], bk->sel_expr[k] );
+	}
+	bk->sink += hits;
+}
+
+void bench_poly_boolean ( bench_kernels *bk, unsigned long i, unsigned long n ) {
+	static const int actions[] = { PBO_ISECT, PBO_SUB, PBO_UNITE };
+	long codes = 0;
+
+	for ( ; n > 0; n --, i ++ ) {
+		unsigned long k = ( i % ( BENCH_POOL / 2 ) ) * 2;
+		POLYAREA *res = NULL;
+		codes += poly_Boolean ( bk->areas[k], bk->areas[k+1], &res, actions[i % 3] );
+		if ( res != NULL ) {
+			poly_Free ( &res );
+		}
+	}
+	bk->sink += codes;
+}
+
+
+/* All kernels, in the order in which they are run. */
+static const struct {
+	const char *name;
+	bench_kernel_func func;
+} BENCH_KERNELS[] = {
+		{ "line_intersection", bench_line_intersection },
+		{ "point_in_part", bench_point_in_part },
+		{ "part_in_part", bench_part_in_part },
+		{ "vertex_order", bench_vertex_order },
+		{ "str_to_dbl", bench_str_to_dbl },
+		{ "selection_apply_one", bench_selection_apply_one },
+		{ "poly_boolean", bench_poly_boolean },
+		{ NULL, NULL }
+};
+
+
+/*
+ * Runs one kernel with an increasing number of operations, until
+ * one run takes at least "min_time" seconds, then prints the time
+ * and allocations per operation of that run.
+ */
+void bench_run ( bench_kernels *bk, const char *name, bench_kernel_func func ) {
+	unsigned long n = 16;
+	double start, elapsed;
+	unsigned long long allocs;
+
+	func ( bk, 0, BENCH_POOL ); /* warm up */
+	for ( ;; ) {
+		allocs = BENCH_ALLOCS;
+		start = t_get_wall_time ();
+		func ( bk, 0, n );
+		elapsed = t_get_wall_time () - start;
+		allocs = BENCH_ALLOCS - allocs;
+		if ( elapsed >= bk->min_time || n >= ( 1UL << 30 ) ) {
+			break;
+		}
+		/* aim a little above the target time for the next run */
+		if ( elapsed * 8.0 < bk->min_time ) {
+			n *= 8;
+		} else {
+			n = (unsigned long) ( (double) n * bk->min_time * 1.2 / elapsed ) + 1;
+		}
+	}
+
+#ifdef BENCH_WRAP_ALLOC
+	fprintf ( stdout, "%-20s\t%12lu\t%12.1f\t%10.2f\n", name, n, elapsed * 1.0e9 / (double) n,
+			(double) allocs / (double) n );
+#else
+	fprintf ( stdout, "%-20s\t%12lu\t%12.1f\t%10s\n", name, n, elapsed * 1.0e9 / (double) n, "n/a" );
+#endif
+	fflush ( stdout );
+}
+
+
+/*
+ * Print usage instructions.
+ */
+void bench_usage ( const char *cmd ) {
+	int i;
+
+	fprintf ( stdout, "Usage: %s [options]\n", cmd );
+	fprintf ( stdout, "Runs micro-benchmarks of time and heap allocations per operation.\n" );
+	fprintf ( stdout, "  -k kernel\trun only this kernel (default: all)\n" );
+	fprintf ( stdout, "  -t seconds\tmin. run time per kernel (default: 0.5)\n" );
+	fprintf ( stdout, "  -v vertices\tvertices per polygon ring (default: 32)\n" );
+	fprintf ( stdout, "  -s seed\tseed for pseudo-random inputs (default: 1)\n" );
+	fprintf ( stdout, "Kernels:" );
+	for ( i = 0; BENCH_KERNELS[i].name != NULL; i ++ ) {
+		fprintf ( stdout, " %s", BENCH_KERNELS[i].name );
+	}
+	fprintf ( stdout, "\n" );
+}
+
+
+int main ( int argc, char *argv[] ) {
+	static bench_kernels bk;
+	int option, i;
+	BOOLEAN found = FALSE;
+
+	memset ( &bk, 0, sizeof (bench_kernels) );
+	bk.min_time = 0.5;
+	bk.vertices = 32;
+	bk.seed = 1;
+	bk.only = NULL;
+
+	while ( ( option = getopt ( argc, argv, "k:t:v:s:h" ) ) != -1 ) {
+		switch ( option ) {
+		case 'k':
+			bk.only = optarg;
+			break;
+		case 't':
+			bk.min_time = atof ( optarg );
+			break;
+		case 'v':
+			bk.vertices = atoi ( optarg );
+			break;
+		case 's':
+			bk.seed = strtoul ( optarg, NULL, 10 );
+			break;
+		default:
+			bench_usage ( argv[0] );
+			return ( option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE );
+		}
+	}
+
+	if ( bk.vertices < 4 || bk.min_time <= 0.0 ) {
+		fprintf ( stderr, "Invalid vertex count or run time.\n" );
+		return ( EXIT_FAILURE );
+	}
+
+	for ( i = 0; bk.only != NULL && BENCH_KERNELS[i].name != NULL; i ++ ) {
+		if ( !strcmp ( bk.only, BENCH_KERNELS[i].name ) ) {
+			found = TRUE;
+		}
+	}
+	if ( bk.only != NULL && found == FALSE ) {
+		fprintf ( stderr, "Unknown kernel: '%s'.\n", bk.only );
+		return ( EXIT_FAILURE );
+	}
+
+	/* needed by some functions in tools.c and errors.c */
+	PRG_NAME_CLI = argv[0];
+	PRG_PATH_CLI = ".";
+	PRG_DIR_CLI = ".";
+	I18N_DECIMAL_POINT = ".";
+	I18N_THOUSANDS_SEP = ",";
+	OPTIONS_GUI_MODE = FALSE;
+
+	/* the generator state must never be zero */
+	bk.rand = 88172645463325252ULL ^ ( (unsigned long long) bk.seed * 2654435761ULL );
+	if ( bk.rand == 0 ) {
+		bk.rand = 88172645463325252ULL;
+	}
+
+	bench_setup ( &bk );
+
+	fprintf ( stdout, "%-20s\t%12s\t%12s\t%10s\n", "kernel", "ops", "ns/op", "allocs/op" );
+	for ( i = 0; BENCH_KERNELS[i].name != NULL; i ++ ) {
+		if ( bk.only == NULL || !strcmp ( bk.only, BENCH_KERNELS[i].name ) ) {
+			bench_run ( &bk, BENCH_KERNELS[i].name, BENCH_KERNELS[i].func );
+		}
+	}
+
+	bench_cleanup ( &bk );
+
+	return ( EXIT_SUCCESS );
+}
@@ -0,0 +1,95 @@
+#!/bin/sh
+#############################################################################
+#
+# PROGRAM:	survey2gis
+# FILE:	tests/bench-run.sh
+# AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+#				Landesamt fuer Denkmalpflege
+# 				http://www.denkmalpflege-bw.de/
+#
+# PURPOSE:	 	End-to-end benchmark: Generates synthetic survey data
+#				of increasing size with "bench-gen", processes it with
+#				"survey2gis --profile" and collects the stage timings
+#				of all runs in one table (tab separated).
+#
+#				Run this via "make -f Makefile.<system> bench".
+#				The following environment variables control the runs:
+#
+#				BENCH_SIZES	record counts to test
+#				BENCH_MODES	tagging modes to test
+#				BENCH_GEN_ARGS	extra options for bench-gen
+#				BENCH_ARGS	extra options for survey2gis
+#				BENCH_DIR	output folder for data and results
+#				BENCH_TIMEOUT	max. seconds per run (needs "timeout")
+#				BENCH_KEEP	set to "1" to keep generated data
+#
+# COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+#
+#		This program is free software under the GPL (>=v2)
+#		Read the file COPYING that comes with this software for details.
+#############################################################################
+
+BENCH_SIZES=${BENCH_SIZES:-"1000 10000 100000 1000000 10000000"}
+BENCH_MODES=${BENCH_MODES:-"min max end none"}
+BENCH_GEN_ARGS=${BENCH_GEN_ARGS:-""}
+BENCH_ARGS=${BENCH_ARGS:-"-t 0.001 -s 0.01 -D 0.05"}
+BENCH_DIR=${BENCH_DIR:-"bench-results"}
+BENCH_TIMEOUT=${BENCH_TIMEOUT:-"3600"}
+BENCH_KEEP=${BENCH_KEEP:-"0"}
+
+PRG=./survey2gis
+GEN=./bench-gen
+
+if [ ! -x "$PRG" ] || [ ! -x "$GEN" ]; then
+	echo "Please compile 'survey2gis' and 'bench-gen' first."
+	exit 1
+fi
+
+# limit run time, if possible
+TIMEOUT=""
+if command -v timeout > /dev/null 2>&1; then
+	TIMEOUT="timeout $BENCH_TIMEOUT"
+fi
+
+mkdir -p "$BENCH_DIR" || exit 1
+RESULTS="$BENCH_DIR/bench.tsv"
+printf "mode\trecords\tstatus\tstage\twall_us\tcpu_us\tmax_rss_kb\tcount\n" > "$RESULTS"
+
+for mode in $BENCH_MODES; do
+	for size in $BENCH_SIZES; do
+		run="${mode}_${size}"
+		echo "*** Mode '$mode', $size records ***"
+		$GEN -m "$mode" -r "$size" -o "$BENCH_DIR" $BENCH_GEN_ARGS || exit 1
+		rm -f "$BENCH_DIR/${run}_profile.json"
+		$TIMEOUT $PRG -e --profile $BENCH_ARGS -p "$BENCH_DIR/bench_$mode.txt" \
+			-o "$BENCH_DIR" -n "$run" "$BENCH_DIR/bench_$mode.dat" > "$BENCH_DIR/$run.log" 2>&1
+		status=$?
+		if [ $status -eq 124 ]; then
+			echo "Timed out after $BENCH_TIMEOUT seconds."
+		elif [ $status -ne 0 ]; then
+			echo "Failed with exit status $status (see $BENCH_DIR/$run.log)."
+		fi
+		# The profile has one JSON object per stage and line.
+		if [ -f "$BENCH_DIR/${run}_profile.json" ]; then
+			sed -n -e 's/.*"name": "\([^"]*\)", "wall_us": \([0-9]*\), "cpu_us": \([0-9]*\), "max_rss_kb": \([0-9a-z]*\), "count": \([0-9a-z]*\).*/\1\t\2\t\3\t\4\t\5/p' \
+				"$BENCH_DIR/${run}_profile.json" |
+			while read -r line; do
+				printf "%s\t%s\t%s\t%s\n" "$mode" "$size" "$status" "$line" >> "$RESULTS"
+			done
+			grep '"total"' "$BENCH_DIR/${run}_profile.json" | sed -e 's/^ *//'
+		else
+			printf "%s\t%s\t%s\ttotal\t\t\t\t\n" "$mode" "$size" "$status" >> "$RESULTS"
+		fi
+		if [ "$BENCH_KEEP" != "1" ]; then
+			rm -f "$BENCH_DIR/bench_$mode.dat"
+			for f in "$BENCH_DIR/${run}"_*; do
+				case "$f" in
+					*_profile.json) ;;
+					*) rm -rf "$f" ;;
+				esac
+			done
+		fi
+	done
+done
+
+echo "Results saved as: $RESULTS"
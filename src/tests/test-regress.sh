@@ -0,0 +1,106 @@
+#!/bin/sh
+#############################################################################
+#
+# PROGRAM:	survey2gis
+# FILE:	tests/test-regress.sh
+# AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+#				Landesamt fuer Denkmalpflege
+# 				http://www.denkmalpflege-bw.de/
+#
+# PURPOSE:	 	Regression tests: Runs "survey2gis" on the small inputs
+#				in "tests/data" and checks the exit status of each run.
+#				Each case documents a bug that has been fixed.
+#
+#				Run this via "make -f Makefile.<system> test-regress".
+#				The following environment variables control the runs:
+#
+#				REGRESS_DIR	output folder for results
+#				REGRESS_KEEP	set to "1" to keep results
+#
+# COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+#
+#		This program is free software under the GPL (>=v2)
+#		Read the file COPYING that comes with this software for details.
+#############################################################################
+
+REGRESS_DIR=${REGRESS_DIR:-"regress-results"}
+REGRESS_KEEP=${REGRESS_KEEP:-"0"}
+
+PRG=./survey2gis
+DATA=tests/data
+
+if [ ! -x "$PRG" ]; then
+	echo "Please compile 'survey2gis' first."
+	exit 1
+fi
+
+mkdir -p "$REGRESS_DIR" || exit 1
+
+num_cases=0
+num_failed=0
+
+# Usage: run_case <name> <expected status: ok|fail> <survey2gis options...>
+run_case () {
+	name=$1
+	expect=$2
+	shift 2
+	num_cases=$((num_cases + 1))
+	rm -rf "$REGRESS_DIR/$name"
+	mkdir -p "$REGRESS_DIR/$name" || exit 1
+	$PRG -o "$REGRESS_DIR/$name" -n "$name" "$@" > "$REGRESS_DIR/$name.log" 2>&1
+	status=$?
+	if [ $status -gt 1 ]; then
+		# Crashed (signal) or otherwise abnormal exit.
+		result="FAILED (exit status $status)"
+	elif [ "$expect" = "ok" ] && [ $status -ne 0 ]; then
+		result="FAILED (unexpected error)"
+	elif [ "$expect" = "fail" ] && [ $status -eq 0 ]; then
+		result="FAILED (unexpected success)"
+	else
+		result="passed"
+	fi
+	case "$result" in
+		passed) ;;
+		*) num_failed=$((num_failed + 1)) ;;
+	esac
+	echo "$name: $result"
+}
+
+# Usage: log_lacks <name> <text>
+# Fails the last case, if its log contains <text>.
+log_lacks () {
+	if grep -q "$2" "$REGRESS_DIR/$1.log"; then
+		num_failed=$((num_failed + 1))
+		echo "$1: FAILED (log contains \"$2\")"
+	fi
+}
+
+# MVT output needs lat/lon or Web Mercator data after reprojection,
+# not just lat/lon input data.
+run_case mvt_latlon_to_gk fail -f mvt --proj-in=wgs84 --proj-out=epsg:31467 \
+	-p $DATA/regress_desc.txt $DATA/regress_latlon.dat
+run_case mvt_latlon_to_web ok -f mvt --proj-in=wgs84 --proj-out=epsg:3857 \
+	-p $DATA/regress_desc.txt $DATA/regress_latlon.dat
+run_case mvt_latlon ok -f mvt --proj-in=wgs84 \
+	-p $DATA/regress_desc.txt $DATA/regress_latlon.dat
+
+# Overlap removal must add the intersection vertices to the other polygon,
+# and the line/polygon pass must not index the lines with polygon numbers
+# (run with a "-fsanitize=address" build to catch out-of-bounds reads).
+run_case topo_overlap ok -p $DATA/regress_desc.txt $DATA/regress_topology.dat
+log_lacks topo_overlap "Failed to add intersection vertices"
+
+# Z interpolation of new boundary vertices must stay within the ring's
+# Z values, even if no vertex of the ring has an original Z value.
+run_case topo_z_interpolate ok -p $DATA/regress_desc.txt $DATA/regress_zinterp.dat
+
+echo "$num_cases cases, $num_failed failed."
+
+if [ $num_failed -ne 0 ]; then
+	echo "See the log files in: $REGRESS_DIR"
+	exit 1
+fi
+if [ "$REGRESS_KEEP" != "1" ]; then
+	rm -rf "$REGRESS_DIR"
+fi
+exit 0
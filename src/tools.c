@@ -20,16 +20,22 @@
 #include <errno.h>
 #include <iconv.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef MINGW
+#include <io.h>
 #include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
 #endif
 
 #include "global.h"
@@ -878,6 +884,179 @@ FILE* t_fopen_utf8 ( const char *path, const char* mode ) {
 }
 
 
+/*
+ * Creates a new directory. The path must be given in UTF-8 encoding
+ * (see t_fopen_utf8()). Parent directories are not created.
+ *
+ * Returns 0 on success or if the directory already exists, -1 otherwise
+ * (with "errno" set).
+ */
+int t_mkdir_utf8 ( const char *path ) {
+	int result;
+	struct stat info;
+#ifdef MINGW
+	char *buf_out = NULL;
+	if ( t_str_enc("UTF-8", I18N_WIN_CODEPAGE_FILES, (char*) path, &buf_out) < 0 || buf_out == NULL ) {
+		if ( buf_out != NULL ) {
+			free ( buf_out );
+		}
+		/* maybe the path is already in Windows' multi-byte encoding */
+		buf_out = strdup ( path );
+	}
+	result = mkdir ( buf_out );
+	if ( result != 0 && errno == EEXIST && stat ( buf_out, &info ) == 0 && S_ISDIR ( info.st_mode ) ) {
+		result = 0;
+	}
+	free ( buf_out );
+#else
+	result = mkdir ( path, 0777 );
+	if ( result != 0 && errno == EEXIST && stat ( path, &info ) == 0 && S_ISDIR ( info.st_mode ) ) {
+		result = 0;
+	}
+#endif
+	return ( result );
+}
+
+
+/*
+ * Returns the size (in bytes) of the file at "path", which must be
+ * given in UTF-8 encoding (see t_fopen_utf8()), or -1 if the file
+ * does not exist or cannot be read.
+ */
+long t_file_size_utf8 ( const char *path ) {
+	FILE *fp;
+	long size = -1;
+
+	fp = t_fopen_utf8 ( path, "rb" );
+	if ( fp == NULL ) {
+		return ( -1 );
+	}
+	if ( fseek ( fp, 0, SEEK_END ) == 0 ) {
+		size = ftell ( fp );
+	}
+	fclose ( fp );
+
+	return ( size );
+}
+
+
+/*
+ * Cuts the file at "path" (UTF-8 encoding) down to its first "size"
+ * bytes. Nothing happens if the file is not longer than that.
+ *
+ * Returns 0 on success, -1 otherwise (with "errno" set).
+ */
+int t_truncate_utf8 ( const char *path, long size ) {
+	FILE *fp;
+	int result;
+
+	fp = t_fopen_utf8 ( path, "r+b" );
+	if ( fp == NULL ) {
+		return ( -1 );
+	}
+	result = 0;
+	if ( fseek ( fp, 0, SEEK_END ) == 0 && ftell ( fp ) > size ) {
+#ifdef MINGW
+		result = _chsize ( _fileno ( fp ), size );
+#else
+		result = ftruncate ( fileno ( fp ), (off_t) size );
+#endif
+	}
+	fclose ( fp );
+
+	return ( result );
+}
+
+
+/*
+ * Deletes the file at "path" (UTF-8 encoding).
+ *
+ * Returns 0 on success, -1 otherwise (with "errno" set).
+ */
+int t_remove_utf8 ( const char *path ) {
+	int result;
+#ifdef MINGW
+	char *buf_out = NULL;
+	if ( t_str_enc("UTF-8", I18N_WIN_CODEPAGE_FILES, (char*) path, &buf_out) < 0 || buf_out == NULL ) {
+		if ( buf_out != NULL ) {
+			free ( buf_out );
+		}
+		/* maybe the path is already in Windows' multi-byte encoding */
+		buf_out = strdup ( path );
+	}
+	result = remove ( buf_out );
+	free ( buf_out );
+#else
+	result = remove ( path );
+#endif
+	return ( result );
+}
+
+
+/*
+ * Deletes the empty directory at "path" (UTF-8 encoding).
+ *
+ * Returns 0 on success, -1 otherwise (with "errno" set).
+ */
+int t_rmdir_utf8 ( const char *path ) {
+	int result;
+#ifdef MINGW
+	char *buf_out = NULL;
+	if ( t_str_enc("UTF-8", I18N_WIN_CODEPAGE_FILES, (char*) path, &buf_out) < 0 || buf_out == NULL ) {
+		if ( buf_out != NULL ) {
+			free ( buf_out );
+		}
+		/* maybe the path is already in Windows' multi-byte encoding */
+		buf_out = strdup ( path );
+	}
+	result = rmdir ( buf_out );
+	free ( buf_out );
+#else
+	result = rmdir ( path );
+#endif
+	return ( result );
+}
+
+
+/*
+ * Renames the file at "from" to "to" (both in UTF-8 encoding). If a
+ * file "to" exists, then it is replaced. On POSIX systems, this is
+ * atomic: other processes see either the old or the new file.
+ *
+ * Returns 0 on success, -1 otherwise (with "errno" set).
+ */
+int t_rename_utf8 ( const char *from, const char *to ) {
+	int result;
+#ifdef MINGW
+	char *buf_from = NULL;
+	char *buf_to = NULL;
+	if ( t_str_enc("UTF-8", I18N_WIN_CODEPAGE_FILES, (char*) from, &buf_from) < 0 || buf_from == NULL ) {
+		if ( buf_from != NULL ) {
+			free ( buf_from );
+		}
+		buf_from = strdup ( from );
+	}
+	if ( t_str_enc("UTF-8", I18N_WIN_CODEPAGE_FILES, (char*) to, &buf_to) < 0 || buf_to == NULL ) {
+		if ( buf_to != NULL ) {
+			free ( buf_to );
+		}
+		buf_to = strdup ( to );
+	}
+	/* rename() on Windows does not replace existing files */
+	result = 0;
+	if ( MoveFileExA ( buf_from, buf_to, MOVEFILE_REPLACE_EXISTING ) == 0 ) {
+		errno = EACCES;
+		result = -1;
+	}
+	free ( buf_from );
+	free ( buf_to );
+#else
+	result = rename ( from, to );
+#endif
+	return ( result );
+}
+
+
 #ifdef MINGW
 
 /*
@@ -1057,6 +1236,372 @@ char *realpath(const char *path, char resolved_path[PATH_MAX])
 #endif
 
 
+/*
+ * Returns the number of processors (cores) that are currently online.
+ * Returns "1" if the number cannot be determined.
+ */
+int t_get_num_cpus () {
+	int num_cpus = 1;
+#ifdef MINGW
+	SYSTEM_INFO info;
+	GetSystemInfo ( &info );
+	num_cpus = (int) info.dwNumberOfProcessors;
+#else
+#ifdef _SC_NPROCESSORS_ONLN
+	num_cpus = (int) sysconf ( _SC_NPROCESSORS_ONLN );
+#endif
+#endif
+	if ( num_cpus < 1 ) {
+		num_cpus = 1;
+	}
+	return ( num_cpus );
+}
+
+
+/*
+ * Runs "func" on "num_jobs" argument blocks in parallel, using
+ * one thread per job. "jobs" points to an array of "num_jobs"
+ * argument blocks, each of size "job_size" bytes. The function
+ * "func" receives a pointer to its own argument block.
+ *
+ * This function returns only after all jobs have completed.
+ * If a thread cannot be created, then the affected job will be run
+ * in the calling thread instead. Jobs must therefore never depend
+ * on each other.
+ *
+ * Worker functions must not call err_show() or exit(). Instead, they
+ * should store any error information in their argument blocks, so that
+ * it can be reported by the calling thread once all jobs are done.
+ * Alternatively, a worker may attach a message queue to its thread
+ * (see err_queue_attach() in errors.c), which the calling thread
+ * then flushes.
+ */
+void t_thread_run ( void *(*func)(void*), void *jobs, int num_jobs, size_t job_size ) {
+	pthread_t *threads;
+	BOOLEAN *running;
+	int i;
+
+	if ( func == NULL || jobs == NULL || num_jobs < 1 ) {
+		return;
+	}
+
+	/* single job: no need for a new thread */
+	if ( num_jobs == 1 ) {
+		func ( jobs );
+		return;
+	}
+
+	threads = malloc ( sizeof (pthread_t) * num_jobs );
+	running = malloc ( sizeof (BOOLEAN) * num_jobs );
+	if ( threads == NULL || running == NULL ) {
+		/* out of memory: run all jobs in sequence */
+		t_free ( threads );
+		t_free ( running );
+		for ( i = 0; i < num_jobs; i ++ ) {
+			func ( (void*) ((char*) jobs + ( i * job_size )) );
+		}
+		return;
+	}
+
+	for ( i = 0; i < num_jobs; i ++ ) {
+		void *job = (void*) ((char*) jobs + ( i * job_size ));
+		running[i] = FALSE;
+		if ( pthread_create ( &threads[i], NULL, func, job ) == 0 ) {
+			running[i] = TRUE;
+		} else {
+			func ( job );
+		}
+	}
+
+	/* wait for all threads to finish */
+	for ( i = 0; i < num_jobs; i ++ ) {
+		if ( running[i] == TRUE ) {
+			pthread_join ( threads[i], NULL );
+		}
+	}
+
+	t_free ( threads );
+	t_free ( running );
+}
+
+
+/*
+ * Helper function for t_thread_run_pool():
+ * Keeps picking the next job that has not been started yet
+ * and runs it, until there are no more jobs left.
+ */
+void *t_thread_pool_worker ( void *arg ) {
+	t_thread_pool *pool = (t_thread_pool*) arg;
+	int i;
+
+	while ( TRUE ) {
+		pthread_mutex_lock ( &pool->lock );
+		i = pool->next;
+		pool->next ++;
+		pthread_mutex_unlock ( &pool->lock );
+		if ( i >= pool->num_jobs ) {
+			break;
+		}
+		pool->func ( (void*) (pool->jobs + ( i * pool->job_size )) );
+	}
+
+	return ( NULL );
+}
+
+
+/*
+ * Works like t_thread_run() (see above), but uses no more than
+ * "max_threads" threads (including the calling thread) to run
+ * the jobs. Each thread runs one job after the other, until all
+ * jobs have been processed. Jobs are started in the order in which
+ * they appear in "jobs", but they may finish in any order.
+ *
+ * If "max_threads" is 1 or less, then all jobs will be run in
+ * sequence by the calling thread.
+ */
+void t_thread_run_pool ( void *(*func)(void*), void *jobs, int num_jobs, size_t job_size, int max_threads ) {
+	t_thread_pool pool;
+	pthread_t *threads;
+	BOOLEAN *running;
+	int num_threads;
+	int i;
+
+	if ( func == NULL || jobs == NULL || num_jobs < 1 ) {
+		return;
+	}
+
+	num_threads = max_threads;
+	if ( num_threads > num_jobs ) {
+		num_threads = num_jobs;
+	}
+
+	pool.func = func;
+	pool.jobs = (char*) jobs;
+	pool.num_jobs = num_jobs;
+	pool.job_size = job_size;
+	pool.next = 0;
+
+	/* single thread: run all jobs in sequence */
+	if ( num_threads < 2 ) {
+		for ( i = 0; i < num_jobs; i ++ ) {
+			func ( (void*) (pool.jobs + ( i * job_size )) );
+		}
+		return;
+	}
+
+	/* the calling thread will be one of the workers */
+	threads = malloc ( sizeof (pthread_t) * ( num_threads - 1 ) );
+	running = malloc ( sizeof (BOOLEAN) * ( num_threads - 1 ) );
+	if ( threads == NULL || running == NULL ) {
+		/* out of memory: run all jobs in sequence */
+		t_free ( threads );
+		t_free ( running );
+		for ( i = 0; i < num_jobs; i ++ ) {
+			func ( (void*) (pool.jobs + ( i * job_size )) );
+		}
+		return;
+	}
+
+	pthread_mutex_init ( &pool.lock, NULL );
+
+	/* if a thread cannot be created, the others will pick up its jobs */
+	for ( i = 0; i < num_threads - 1; i ++ ) {
+		running[i] = FALSE;
+		if ( pthread_create ( &threads[i], NULL, t_thread_pool_worker, &pool ) == 0 ) {
+			running[i] = TRUE;
+		}
+	}
+	t_thread_pool_worker ( &pool );
+
+	/* wait for all threads to finish */
+	for ( i = 0; i < num_threads - 1; i ++ ) {
+		if ( running[i] == TRUE ) {
+			pthread_join ( threads[i], NULL );
+		}
+	}
+
+	pthread_mutex_destroy ( &pool.lock );
+
+	t_free ( threads );
+	t_free ( running );
+}
+
+
+/*
+ * Returns the current value of a monotonic clock, in seconds.
+ * Only differences between two return values are meaningful.
+ */
+double t_get_wall_time () {
+#ifdef MINGW
+	LARGE_INTEGER freq, count;
+	if ( QueryPerformanceFrequency ( &freq ) && QueryPerformanceCounter ( &count ) ) {
+		return ( (double) count.QuadPart / (double) freq.QuadPart );
+	}
+	return ( (double) GetTickCount () / 1000.0 );
+#else
+	struct timeval tv;
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if ( clock_gettime ( CLOCK_MONOTONIC, &ts ) == 0 ) {
+		return ( (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0 );
+	}
+#endif
+	gettimeofday ( &tv, NULL );
+	return ( (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0 );
+#endif
+}
+
+
+/*
+ * Returns the CPU time (user + system) that this process has used
+ * so far, in seconds. This includes the time spent in all threads.
+ */
+double t_get_cpu_time () {
+#ifdef MINGW
+	FILETIME t_create, t_exit, t_kernel, t_user;
+	if ( GetProcessTimes ( GetCurrentProcess (), &t_create, &t_exit, &t_kernel, &t_user ) ) {
+		/* FILETIME values are in units of 100 nanoseconds */
+		double kernel = (double) t_kernel.dwHighDateTime * 4294967296.0 + (double) t_kernel.dwLowDateTime;
+		double user = (double) t_user.dwHighDateTime * 4294967296.0 + (double) t_user.dwLowDateTime;
+		return ( ( kernel + user ) / 10000000.0 );
+	}
+	return ( (double) clock () / (double) CLOCKS_PER_SEC );
+#else
+	struct rusage usage;
+	if ( getrusage ( RUSAGE_SELF, &usage ) == 0 ) {
+		return ( (double) usage.ru_utime.tv_sec + (double) usage.ru_utime.tv_usec / 1000000.0 +
+				(double) usage.ru_stime.tv_sec + (double) usage.ru_stime.tv_usec / 1000000.0 );
+	}
+	return ( (double) clock () / (double) CLOCKS_PER_SEC );
+#endif
+}
+
+
+/*
+ * Returns the peak resident set size (max. physical memory used)
+ * of this process so far, in KiB.
+ * Returns "-1" if this cannot be determined on the current platform.
+ */
+long t_get_max_rss () {
+#ifdef MINGW
+	return ( -1 );
+#else
+	struct rusage usage;
+	if ( getrusage ( RUSAGE_SELF, &usage ) != 0 ) {
+		return ( -1 );
+	}
+#ifdef __APPLE__
+	/* Mac OS X reports bytes instead of KiB */
+	return ( (long) ( usage.ru_maxrss / 1024 ) );
+#else
+	return ( (long) usage.ru_maxrss );
+#endif
+#endif
+}
+
+
+/*
+ * Initializes a run-time profile and starts measuring its first stage.
+ * If "enabled" is not TRUE, then all subsequent measurements on
+ * "prof" will be ignored.
+ */
+void t_profile_init ( t_profile *prof, BOOLEAN enabled ) {
+	if ( prof == NULL ) {
+		return;
+	}
+	memset ( prof, 0, sizeof (t_profile) );
+	prof->enabled = enabled;
+	if ( prof->enabled == TRUE ) {
+		prof->wall_start = t_get_wall_time ();
+		prof->cpu_start = t_get_cpu_time ();
+		prof->wall_mark = prof->wall_start;
+		prof->cpu_mark = prof->cpu_start;
+	}
+}
+
+
+/*
+ * Starts measuring a new stage. Anything that happened since the
+ * previous call to t_profile_stop() will not be attributed to any stage.
+ */
+void t_profile_start ( t_profile *prof ) {
+	if ( prof == NULL || prof->enabled == FALSE ) {
+		return;
+	}
+	prof->wall_mark = t_get_wall_time ();
+	prof->cpu_mark = t_get_cpu_time ();
+}
+
+
+/*
+ * Finishes measuring the current stage and stores its results
+ * under "name", then immediately starts measuring the next stage.
+ *
+ * If a stage of the same name has already been measured (e.g. once
+ * for each input file), then times and "count" will be added to it.
+ * Pass "-1" for "count", if the stage has no result counter.
+ * Stages beyond T_PROFILE_MAX_STAGES will be ignored.
+ */
+void t_profile_stop ( t_profile *prof, const char *name, long count ) {
+	t_profile_stage *stage = NULL;
+	double wall, cpu;
+	int i;
+
+	if ( prof == NULL || prof->enabled == FALSE || name == NULL ) {
+		return;
+	}
+
+	wall = t_get_wall_time ();
+	cpu = t_get_cpu_time ();
+
+	for ( i = 0; i < prof->num_stages; i ++ ) {
+		if ( !strcmp ( prof->stages[i].name, name ) ) {
+			stage = &prof->stages[i];
+			break;
+		}
+	}
+	if ( stage == NULL && prof->num_stages < T_PROFILE_MAX_STAGES ) {
+		stage = &prof->stages[prof->num_stages];
+		stage->name = name;
+		stage->count = -1;
+		prof->num_stages ++;
+	}
+
+	if ( stage != NULL ) {
+		stage->wall += wall - prof->wall_mark;
+		stage->cpu += cpu - prof->cpu_mark;
+		stage->max_rss = t_get_max_rss ();
+		if ( count >= 0 ) {
+			stage->count = ( stage->count < 0 ) ? count : stage->count + count;
+		}
+		stage->calls ++;
+	}
+
+	prof->wall_mark = wall;
+	prof->cpu_mark = cpu;
+}
+
+
+/*
+ * Stores the total wall clock and CPU time since t_profile_init(),
+ * as well as the current peak RSS in "total".
+ */
+void t_profile_total ( const t_profile *prof, t_profile_stage *total ) {
+	if ( prof == NULL || total == NULL ) {
+		return;
+	}
+	memset ( total, 0, sizeof (t_profile_stage) );
+	total->name = "total";
+	total->count = -1;
+	if ( prof->enabled == TRUE ) {
+		total->wall = t_get_wall_time () - prof->wall_start;
+		total->cpu = t_get_cpu_time () - prof->cpu_start;
+		total->max_rss = t_get_max_rss ();
+		total->calls = 1;
+	}
+}
+
+
 /*
  * Returns a string that contains the current program name.
  *
@@ -15,6 +15,7 @@
  ***************************************************************************/
 
 
+#include <pthread.h>
 #include <string.h>
 
 #include "global.h"
@@ -23,6 +24,54 @@
 #ifndef TOOLS_H
 #define TOOLS_H
 
+/*
+ * Shared state of a pool of worker threads (see t_thread_run_pool()).
+ */
+typedef struct t_thread_pool t_thread_pool;
+struct t_thread_pool
+{
+	void *(*func)(void*); /* function to run on each job */
+	char *jobs; /* array of job argument blocks */
+	int num_jobs; /* number of jobs in "jobs" */
+	size_t job_size; /* size of one job argument block (bytes) */
+	int next; /* index of next job to start */
+	pthread_mutex_t lock; /* protects "next" */
+};
+
+/* max. number of distinct stages in a run-time profile */
+#define T_PROFILE_MAX_STAGES	32
+
+/*
+ * One measured processing stage (see t_profile_stop()).
+ * Times are in seconds, peak RSS in KiB (-1 if not available).
+ */
+typedef struct t_profile_stage t_profile_stage;
+struct t_profile_stage
+{
+	const char *name; /* stage name (must be a static string) */
+	double wall; /* elapsed (monotonic) wall clock time */
+	double cpu; /* CPU time (user + system, all threads) */
+	long max_rss; /* peak resident set size of process at end of stage */
+	long count; /* result counter reported by the stage (-1 = none) */
+	int calls; /* number of times this stage was measured */
+};
+
+/*
+ * Run-time profile of a sequence of processing stages.
+ * A disabled profile ignores all measurements.
+ */
+typedef struct t_profile t_profile;
+struct t_profile
+{
+	BOOLEAN enabled; /* only measure if TRUE */
+	t_profile_stage stages[T_PROFILE_MAX_STAGES]; /* stages in order of first measurement */
+	int num_stages; /* number of entries in "stages" */
+	double wall_start; /* wall clock time at t_profile_init() */
+	double cpu_start; /* CPU time at t_profile_init() */
+	double wall_mark; /* wall clock time at start of current stage */
+	double cpu_mark; /* CPU time at start of current stage */
+};
+
 /* helper function for storing 0 as "0" in string representation */
 void t_dbl_to_str ( double value, char *dst );
 
@@ -66,6 +115,24 @@ int t_str_enc(const char *from, const char* to, char *in, char **out);
 /* open a file whose path is given in UTF-8 encoding */
 FILE* t_fopen_utf8 ( const char *path, const char* mode );
 
+/* create a directory whose path is given in UTF-8 encoding */
+int t_mkdir_utf8 ( const char *path );
+
+/* get the size of a file whose path is given in UTF-8 encoding */
+long t_file_size_utf8 ( const char *path );
+
+/* shorten a file whose path is given in UTF-8 encoding */
+int t_truncate_utf8 ( const char *path, long size );
+
+/* delete a file whose path is given in UTF-8 encoding */
+int t_remove_utf8 ( const char *path );
+
+/* delete an empty directory whose path is given in UTF-8 encoding */
+int t_rmdir_utf8 ( const char *path );
+
+/* rename (and replace) a file whose path is given in UTF-8 encoding */
+int t_rename_utf8 ( const char *from, const char *to );
+
 /* check for legal file path specifier */
 BOOLEAN t_is_legal_path (const char *s);
 
@@ -81,6 +148,36 @@ void t_setenv ( const char *name, const char *value );
 /* set path to data directory with precedence */
 char *t_set_data_dir ( const char *env, const char *local, const char *global );
 
+/* return number of online processors */
+int t_get_num_cpus ();
+
+/* run several jobs in parallel threads and wait for all of them */
+void t_thread_run ( void *(*func)(void*), void *jobs, int num_jobs, size_t job_size );
+
+/* run several jobs on a limited number of threads and wait for all of them */
+void t_thread_run_pool ( void *(*func)(void*), void *jobs, int num_jobs, size_t job_size, int max_threads );
+
+/* return monotonic wall clock time in seconds */
+double t_get_wall_time ();
+
+/* return CPU time used by this process in seconds */
+double t_get_cpu_time ();
+
+/* return peak resident set size of this process in KiB */
+long t_get_max_rss ();
+
+/* initialize a run-time profile */
+void t_profile_init ( t_profile *prof, BOOLEAN enabled );
+
+/* start measuring a new stage */
+void t_profile_start ( t_profile *prof );
+
+/* finish measuring the current stage and start the next one */
+void t_profile_stop ( t_profile *prof, const char *name, long count );
+
+/* return profile totals since t_profile_init() */
+void t_profile_total ( const t_profile *prof, t_profile_stage *total );
+
 /* return program name string */
 const char *t_get_prg_name ();
 
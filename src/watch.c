@@ -0,0 +1,621 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	watch.c
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Watch mode: converts the input again whenever the
+ * 				input files or the parser schema change ("--watch").
+ *
+ * 				See watch.h for details.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef MINGW
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "global.h"
+
+#include "errors.h"
+#include "i18n.h"
+#include "options.h"
+#include "s2g.h"
+#include "tools.h"
+#include "watch.h"
+
+
+/* set by the signal handler, to stop watching */
+static volatile sig_atomic_t WATCH_STOP = 0;
+
+
+/*
+ * Signal handler: Ends the watch loop after the current conversion.
+ */
+void watch_stop ( int sig )
+{
+	WATCH_STOP = 1;
+#ifdef MINGW
+	/* Windows resets the handler after each signal */
+	signal ( sig, watch_stop );
+#endif
+}
+
+
+/*
+ * Helper function: waits for "ms" milliseconds.
+ */
+void watch_sleep ( int ms )
+{
+#ifdef MINGW
+	Sleep ( (DWORD) ms );
+#else
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = ( ms % 1000 ) * 1000000L;
+	nanosleep ( &ts, NULL );
+#endif
+}
+
+
+/*
+ * Helper function: reads the current state of watched file "f".
+ * Returns TRUE if it differs from the state at the last check.
+ */
+BOOLEAN watch_file_check ( watch_file *f )
+{
+	struct stat st;
+	BOOLEAN exists;
+	time_t mtime = 0;
+	long size = 0;
+	BOOLEAN changed;
+
+
+	exists = ( stat ( f->path, &st ) == 0 );
+	if ( exists == TRUE ) {
+		mtime = st.st_mtime;
+		size = (long) st.st_size;
+	}
+	changed = ( exists != f->exists || mtime != f->mtime || size != f->size );
+	f->exists = exists;
+	f->mtime = mtime;
+	f->size = size;
+
+	return ( changed );
+}
+
+
+/*
+ * Sets up the list of watched files: all input files and the parser
+ * schema. On Linux, the folders that contain them are added to an
+ * inotify instance. Folders are watched instead of files, because
+ * many programs save a file by replacing it with a new one.
+ */
+void watch_files_init ( watch_state *w, options *opts )
+{
+	watch_file *f;
+	char *sep;
+	int i;
+
+
+	w->num_files = opts->num_input + ( opts->schema_file != NULL ? 1 : 0 );
+	w->files = malloc ( sizeof (watch_file) * w->num_files );
+	w->fd = -1;
+#ifdef __linux__
+	w->fd = inotify_init ();
+	if ( w->fd < 0 ) {
+		err_show ( ERR_WARN, _("Cannot watch files for changes.\nReason: %s\nChecking them every %i ms instead."),
+				strerror (errno), WATCH_POLL_INTERVAL );
+	}
+#endif
+
+	for ( i = 0; i < w->num_files; i ++ ) {
+		f = &w->files[i];
+		f->path = strdup ( i < opts->num_input ? opts->input[i] : opts->schema_file );
+		sep = strrchr ( f->path, PRG_FILE_SEPARATOR );
+		if ( sep == NULL ) {
+			f->dir = strdup ( "." );
+			f->name = f->path;
+		} else {
+			f->dir = t_str_ndup ( f->path, (size_t) ( sep - f->path ) + 1 );
+			f->name = sep + 1;
+		}
+		f->wd = -1;
+		f->exists = FALSE;
+		f->mtime = 0;
+		f->size = 0;
+		f->changed = FALSE;
+		watch_file_check ( f );
+#ifdef __linux__
+		if ( w->fd >= 0 ) {
+			f->wd = inotify_add_watch ( w->fd, f->dir, IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE |
+					IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO );
+			if ( f->wd < 0 ) {
+				err_show ( ERR_WARN, _("Cannot watch folder '%s' for changes.\nReason: %s\nChecking it every %i ms instead."),
+						f->dir, strerror (errno), WATCH_POLL_INTERVAL );
+			}
+		}
+#endif
+	}
+}
+
+
+/*
+ * Helper function for watch_wait(): waits up to "ms" milliseconds for
+ * changes to any watched file. Changed files are marked.
+ *
+ * Returns TRUE if any file has changed.
+ */
+BOOLEAN watch_poll ( watch_state *w, int ms )
+{
+	BOOLEAN changed = FALSE;
+	BOOLEAN polling = ( w->fd < 0 );
+	int i;
+
+
+#ifdef __linux__
+	if ( w->fd >= 0 ) {
+		struct pollfd pfd;
+		char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+		const struct inotify_event *ev;
+		ssize_t len;
+		char *p;
+
+		/* files whose folder cannot be watched are checked, too */
+		for ( i = 0; i < w->num_files; i ++ ) {
+			if ( w->files[i].wd < 0 ) {
+				polling = TRUE;
+				if ( ms > WATCH_POLL_INTERVAL ) {
+					ms = WATCH_POLL_INTERVAL;
+				}
+			}
+		}
+		pfd.fd = w->fd;
+		pfd.events = POLLIN;
+		if ( poll ( &pfd, 1, ms ) > 0 ) {
+			len = read ( w->fd, buf, sizeof (buf) );
+			for ( p = buf; len > 0 && p < buf + len; p += sizeof (struct inotify_event) + ev->len ) {
+				ev = (const struct inotify_event*) p;
+				if ( ev->len < 1 ) {
+					continue;
+				}
+				for ( i = 0; i < w->num_files; i ++ ) {
+					if ( w->files[i].wd == ev->wd && !strcmp ( w->files[i].name, ev->name ) ) {
+						w->files[i].changed = TRUE;
+						changed = TRUE;
+					}
+				}
+			}
+		}
+		ms = 0;
+	}
+#endif
+
+	if ( polling == TRUE ) {
+		if ( ms > 0 ) {
+			watch_sleep ( ms );
+		}
+		for ( i = 0; i < w->num_files; i ++ ) {
+			if ( w->files[i].wd < 0 && watch_file_check ( &w->files[i] ) == TRUE ) {
+				w->files[i].changed = TRUE;
+				changed = TRUE;
+			}
+		}
+	}
+
+	return ( changed );
+}
+
+
+/*
+ * Waits until any watched file changes, then until there have been no
+ * more changes for WATCH_DEBOUNCE ms (but no longer than WATCH_MAX_DELAY).
+ *
+ * Returns FALSE if watching has been stopped.
+ */
+BOOLEAN watch_wait ( watch_state *w )
+{
+	double first, last, now;
+
+
+	while ( WATCH_STOP == 0 && watch_poll ( w, WATCH_POLL_INTERVAL ) == FALSE ) {
+		/* nothing to do */
+	}
+	first = t_get_wall_time ();
+	last = first;
+	while ( WATCH_STOP == 0 ) {
+		if ( watch_poll ( w, WATCH_DEBOUNCE / 5 ) == TRUE ) {
+			last = t_get_wall_time ();
+		}
+		now = t_get_wall_time ();
+		if ( ( now - last ) * 1000.0 >= WATCH_DEBOUNCE || ( now - first ) * 1000.0 >= WATCH_MAX_DELAY ) {
+			break;
+		}
+	}
+
+	return ( WATCH_STOP == 0 );
+}
+
+
+/*
+ * Helper function for watch_publish(): copies file "from" to "to".
+ * Returns 0 on success, -1 otherwise (with "errno" set).
+ */
+int watch_copy ( const char *from, const char *to )
+{
+	FILE *in, *out;
+	char buf[65536];
+	size_t n;
+	int result = 0;
+
+
+	in = t_fopen_utf8 ( from, "rb" );
+	if ( in == NULL ) {
+		return ( -1 );
+	}
+	out = t_fopen_utf8 ( to, "wb" );
+	if ( out == NULL ) {
+		fclose ( in );
+		return ( -1 );
+	}
+	while ( ( n = fread ( buf, sizeof (char), sizeof (buf), in ) ) > 0 ) {
+		if ( fwrite ( buf, sizeof (char), n, out ) != n ) {
+			result = -1;
+			break;
+		}
+	}
+	if ( ferror ( in ) ) {
+		result = -1;
+	}
+	fclose ( in );
+	if ( fclose ( out ) != 0 ) {
+		result = -1;
+	}
+
+	return ( result );
+}
+
+
+/*
+ * Moves all output files from the staging folder into the output folder
+ * "output". With "copy" set, the staging folder keeps its files (which
+ * incremental mode continues from), and copies are moved into place
+ * instead. Files that the last conversion produced, but this one did
+ * not, are removed from the output folder.
+ *
+ * Returns the number of files that could not be moved into place.
+ */
+int watch_publish ( watch_state *w, const char *output, const char *base, BOOLEAN copy )
+{
+	DIR *dir;
+	struct dirent *entry;
+	struct stat st;
+	char src[PRG_MAX_PATH_LENGTH];
+	char dst[PRG_MAX_PATH_LENGTH];
+	char tmp[PRG_MAX_PATH_LENGTH];
+	char checkpoint[PRG_MAX_PATH_LENGTH];
+	char **names = NULL;
+	int num_names = 0;
+	int num_errors = 0;
+	int i, j;
+
+
+	dir = opendir ( w->staging );
+	if ( dir == NULL ) {
+		err_show ( ERR_WARN, _("Cannot read staging folder '%s'.\nReason: %s"), w->staging, strerror (errno) );
+		return ( 1 );
+	}
+	snprintf ( checkpoint, PRG_MAX_PATH_LENGTH, "%s%s", base, INCREMENTAL_EXTENSION );
+	while ( ( entry = readdir ( dir ) ) != NULL ) {
+		size_t len = strlen ( entry->d_name );
+		snprintf ( src, PRG_MAX_PATH_LENGTH, "%s%c%s", w->staging, PRG_FILE_SEPARATOR, entry->d_name );
+		if ( stat ( src, &st ) != 0 || !S_ISREG ( st.st_mode ) || !strcmp ( entry->d_name, checkpoint ) ) {
+			continue;
+		}
+		if ( len > strlen (WATCH_TEMP_EXTENSION) &&
+				!strcmp ( entry->d_name + len - strlen (WATCH_TEMP_EXTENSION), WATCH_TEMP_EXTENSION ) ) {
+			continue;
+		}
+		names = realloc ( names, sizeof (char*) * ( num_names + 1 ) );
+		names[num_names++] = strdup ( entry->d_name );
+	}
+	closedir ( dir );
+
+	/* make all copies first, so that the files are replaced close together */
+	if ( copy == TRUE ) {
+		for ( i = 0; i < num_names; i ++ ) {
+			snprintf ( src, PRG_MAX_PATH_LENGTH, "%s%c%s", w->staging, PRG_FILE_SEPARATOR, names[i] );
+			snprintf ( tmp, PRG_MAX_PATH_LENGTH, "%s%c%s%s", output, PRG_FILE_SEPARATOR, names[i], WATCH_TEMP_EXTENSION );
+			if ( watch_copy ( src, tmp ) != 0 ) {
+				err_show ( ERR_WARN, _("Cannot copy output file to '%s'.\nReason: %s"), tmp, strerror (errno) );
+				t_remove_utf8 ( tmp );
+				num_errors ++;
+			}
+		}
+		if ( num_errors > 0 ) {
+			for ( i = 0; i < num_names; i ++ ) {
+				snprintf ( tmp, PRG_MAX_PATH_LENGTH, "%s%c%s%s", output, PRG_FILE_SEPARATOR, names[i], WATCH_TEMP_EXTENSION );
+				t_remove_utf8 ( tmp );
+				free ( names[i] );
+			}
+			t_free ( names );
+			return ( num_errors );
+		}
+	}
+	for ( i = 0; i < num_names; i ++ ) {
+		if ( copy == TRUE ) {
+			snprintf ( src, PRG_MAX_PATH_LENGTH, "%s%c%s%s", output, PRG_FILE_SEPARATOR, names[i], WATCH_TEMP_EXTENSION );
+		} else {
+			snprintf ( src, PRG_MAX_PATH_LENGTH, "%s%c%s", w->staging, PRG_FILE_SEPARATOR, names[i] );
+		}
+		snprintf ( dst, PRG_MAX_PATH_LENGTH, "%s%c%s", output, PRG_FILE_SEPARATOR, names[i] );
+		if ( t_rename_utf8 ( src, dst ) != 0 ) {
+			err_show ( ERR_WARN, _("Cannot replace output file '%s'.\nReason: %s"), dst, strerror (errno) );
+			num_errors ++;
+		}
+	}
+
+	/* remove output that is no longer produced */
+	for ( i = 0; i < w->num_published; i ++ ) {
+		for ( j = 0; j < num_names; j ++ ) {
+			if ( !strcmp ( w->published[i], names[j] ) ) {
+				break;
+			}
+		}
+		if ( j == num_names ) {
+			snprintf ( dst, PRG_MAX_PATH_LENGTH, "%s%c%s", output, PRG_FILE_SEPARATOR, w->published[i] );
+			t_remove_utf8 ( dst );
+		}
+		free ( w->published[i] );
+	}
+	t_free ( w->published );
+	w->published = names;
+	w->num_published = num_names;
+
+	return ( num_errors );
+}
+
+
+/*
+ * Helper function for watch_show_messages(): returns a copy of "msg"
+ * in which all paths into the staging folder are replaced with the
+ * same paths in the output folder "output" (where watch_publish()
+ * puts the files). The copy must be freed by the caller.
+ */
+char *watch_unstage_msg ( watch_state *w, const char *output, const char *msg )
+{
+	char prefix[PRG_MAX_PATH_LENGTH];
+	const char *p, *q;
+	char *result;
+	size_t len_prefix;
+	int num = 0;
+
+
+	snprintf ( prefix, PRG_MAX_PATH_LENGTH, "%s%c", w->staging, PRG_FILE_SEPARATOR );
+	len_prefix = strlen ( prefix );
+	for ( p = strstr ( msg, prefix ); p != NULL; p = strstr ( p + len_prefix, prefix ) ) {
+		num ++;
+	}
+	result = malloc ( sizeof (char) * ( strlen (msg) + num * ( strlen (output) + 1 ) + 1 ) );
+	result[0] = '\0';
+	for ( p = msg; ( q = strstr ( p, prefix ) ) != NULL; p = q + len_prefix ) {
+		strncat ( result, p, q - p );
+		sprintf ( result + strlen (result), "%s%c", output, PRG_FILE_SEPARATOR );
+	}
+	strcat ( result, p );
+
+	return ( result );
+}
+
+
+/*
+ * Helper function for watch_convert(): shows the messages of the last
+ * call to library context "ctx" as usual. Fatal errors are shown as
+ * warnings, because they must not end the program here. Output files
+ * are shown with their final paths in the output folder "output",
+ * not in the staging folder.
+ */
+void watch_show_messages ( watch_state *w, s2g_context *ctx, const char *output )
+{
+	unsigned short type;
+	char *msg;
+	int i;
+
+
+	for ( i = 0; i < s2g_get_num_messages ( ctx ); i ++ ) {
+		msg = watch_unstage_msg ( w, output, s2g_get_message ( ctx, i, &type ) );
+		err_show ( type == ERR_EXIT ? ERR_WARN : type, "%s", msg );
+		free ( msg );
+	}
+}
+
+
+/*
+ * Runs one conversion with library context "ctx", writing to the
+ * staging folder. If "ctx" is NULL, then a new context is set up
+ * first (and kept in "ctx", if successful).
+ *
+ * Returns S2G_OK or S2G_ERROR.
+ */
+int watch_convert ( watch_state *w, s2g_context **ctx, options *opts )
+{
+	int status;
+
+
+	if ( *ctx == NULL ) {
+		*ctx = s2g_context_create ();
+		status = s2g_context_setup ( *ctx, opts->argc, opts->argv );
+		watch_show_messages ( w, *ctx, opts->output );
+		if ( status != S2G_OK ) {
+			s2g_context_destroy ( *ctx );
+			*ctx = NULL;
+			return ( S2G_ERROR );
+		}
+	}
+
+	status = s2g_process_files ( *ctx, w->staging, opts->base,
+			opts->num_input, (const char**) opts->input );
+	watch_show_messages ( w, *ctx, opts->output );
+
+	return ( status );
+}
+
+
+/*
+ * Deletes the staging folder and all files left in it (e.g. the
+ * incremental mode checkpoint). Shows a warning if that fails.
+ */
+void watch_remove_staging ( watch_state *w )
+{
+	DIR *dir;
+	struct dirent *entry;
+	struct stat st;
+	char path[PRG_MAX_PATH_LENGTH];
+
+
+	dir = opendir ( w->staging );
+	if ( dir != NULL ) {
+		while ( ( entry = readdir ( dir ) ) != NULL ) {
+			snprintf ( path, PRG_MAX_PATH_LENGTH, "%s%c%s", w->staging, PRG_FILE_SEPARATOR, entry->d_name );
+			if ( stat ( path, &st ) == 0 && S_ISREG ( st.st_mode ) ) {
+				t_remove_utf8 ( path );
+			}
+		}
+		closedir ( dir );
+	}
+	if ( t_rmdir_utf8 ( w->staging ) != 0 ) {
+		err_show ( ERR_WARN, _("Cannot remove staging folder '%s'.\nReason: %s"), w->staging, strerror (errno) );
+	}
+}
+
+
+/*
+ * Converts the input files in "opts", then watches them and the parser
+ * schema for changes, and converts them again after each change (see
+ * watch.h). Runs until SIGINT or SIGTERM is received.
+ *
+ * Returns 0 if the last conversion was successful, 1 otherwise.
+ */
+int watch_run ( options *opts )
+{
+	watch_state w;
+	s2g_context *ctx = NULL;
+	BOOLEAN schema_changed;
+	int status = S2G_ERROR;
+	int i;
+#ifndef MINGW
+	struct sigaction sa;
+#endif
+
+
+	memset ( &w, 0, sizeof (watch_state) );
+
+	err_log_init ( opts );
+
+	/* clean shutdown on SIGINT and SIGTERM */
+#ifdef MINGW
+	signal ( SIGINT, watch_stop );
+	signal ( SIGTERM, watch_stop );
+#else
+	memset ( &sa, 0, sizeof (struct sigaction) );
+	sa.sa_handler = watch_stop;
+	sigemptyset ( &sa.sa_mask );
+	sigaction ( SIGINT, &sa, NULL );
+	sigaction ( SIGTERM, &sa, NULL );
+#endif
+
+	/* staging folder */
+	w.staging = malloc ( sizeof (char) * ( strlen (opts->output) + strlen (opts->base) + strlen (WATCH_DIR_EXTENSION) + 2 ) );
+	sprintf ( w.staging, "%s%c%s%s", opts->output, PRG_FILE_SEPARATOR, opts->base, WATCH_DIR_EXTENSION );
+	if ( t_mkdir_utf8 ( w.staging ) != 0 ) {
+		err_show ( ERR_EXIT, _("Cannot create staging folder '%s'.\nReason: %s"), w.staging, strerror (errno) );
+		free ( w.staging );
+		return ( 1 );
+	}
+
+	watch_files_init ( &w, opts );
+	err_show ( ERR_NOTE, _("Watching %i file(s) for changes (stop with Ctrl+C)."), w.num_files );
+
+	while ( WATCH_STOP == 0 ) {
+		for ( i = 0; i < w.num_files; i ++ ) {
+			w.files[i].changed = FALSE;
+		}
+
+		err_show ( ERR_NOTE, _("\nConverting ...") );
+		status = watch_convert ( &w, &ctx, opts );
+		/* nothing to publish if there was no new data (incremental mode) */
+		if ( status == S2G_OK && s2g_get_result ( ctx )->output_files[0] != NULL ) {
+			if ( watch_publish ( &w, opts->output, opts->base, opts->incremental ) > 0 ) {
+				status = S2G_ERROR;
+			}
+		}
+		if ( status == S2G_OK ) {
+			err_show ( ERR_NOTE, _("\nConversion completed. Waiting for changes ...") );
+		} else {
+			err_show ( ERR_WARN, _("\nConversion failed. Waiting for changes ...") );
+		}
+
+		if ( watch_wait ( &w ) == FALSE ) {
+			break;
+		}
+
+		/* a new parser schema requires a new setup */
+		schema_changed = FALSE;
+		for ( i = opts->num_input; i < w.num_files; i ++ ) {
+			schema_changed = schema_changed || w.files[i].changed;
+		}
+		if ( schema_changed == TRUE && ctx != NULL ) {
+			err_show ( ERR_NOTE, _("\nParser schema '%s' has changed. Reading it again."), opts->schema_file );
+			s2g_context_destroy ( ctx );
+			ctx = NULL;
+		}
+	}
+
+	err_show ( ERR_NOTE, _("\nStopped watching.") );
+	if ( ctx != NULL ) {
+		s2g_context_destroy ( ctx );
+	}
+	watch_remove_staging ( &w );
+#ifdef __linux__
+	if ( w.fd >= 0 ) {
+		close ( w.fd );
+	}
+#endif
+	for ( i = 0; i < w.num_files; i ++ ) {
+		free ( w.files[i].path );
+		free ( w.files[i].dir );
+	}
+	t_free ( w.files );
+	for ( i = 0; i < w.num_published; i ++ ) {
+		free ( w.published[i] );
+	}
+	t_free ( w.published );
+	free ( w.staging );
+	err_close ();
+
+	return ( status == S2G_OK ? 0 : 1 );
+}
@@ -0,0 +1,93 @@
+/***************************************************************************
+ *
+ * PROGRAM:	Survey2GIS
+ * FILE:	watch.h
+ * AUTHOR(S):	Benjamin Ducke for Regierungspraesidium Stuttgart,
+ * 				Landesamt fuer Denkmalpflege
+ * 				http://www.denkmalpflege-bw.de/
+ *
+ * PURPOSE:	 	Watch mode ("--watch"): converts the input files once,
+ * 				then again every time that the input files or the
+ * 				parser schema change, until the program is stopped.
+ *
+ * 				On Linux, changes are reported by inotify. Elsewhere
+ * 				(or if inotify is not available), the modification
+ * 				time and size of each file are checked regularly.
+ * 				Conversion only starts once the files have not changed
+ * 				for a short while, so that a burst of writes (e.g. a
+ * 				data logger appending line by line) triggers only one.
+ *
+ * 				Output is written to a staging folder first. Then each
+ * 				output file replaces the one in the output folder by
+ * 				renaming it, so that other programs never read half-
+ * 				written files. With "--incremental", the staging folder
+ * 				keeps the checkpoint and output of the last conversion,
+ * 				and the output files are copied instead. The staging
+ * 				folder is removed when watching stops.
+ *
+ * COPYRIGHT:	(C) 2016 by the gvSIG Community Edition team
+ *
+ *		This program is free software under the GPL (>=v2)
+ *		Read the file COPYING that comes with this software for details.
+ ***************************************************************************/
+
+
+#include <time.h>
+
+#include "global.h"
+
+#include "options.h"
+
+
+#ifndef WATCH_H
+#define WATCH_H
+
+/* extension of the staging folder ("<output>/<base>.watch") */
+#define WATCH_DIR_EXTENSION		".watch"
+
+/* extension of output files while they are being copied */
+#define WATCH_TEMP_EXTENSION	".tmp"
+
+/* time without changes before conversion starts (milliseconds) */
+#define WATCH_DEBOUNCE			500
+
+/* max. time to put off conversion while changes keep coming (milliseconds) */
+#define WATCH_MAX_DELAY			5000
+
+/* time between two checks of all files, if there is no inotify (milliseconds) */
+#define WATCH_POLL_INTERVAL		250
+
+/*
+ * One watched file.
+ */
+typedef struct watch_file watch_file;
+struct watch_file
+{
+	char *path; /* file name, as given on the command line */
+	char *dir; /* folder that contains the file */
+	const char *name; /* file name without folder (points into "path") */
+	int wd; /* inotify watch descriptor of "dir" (-1 if none) */
+	BOOLEAN exists; /* state at last check: file exists, */
+	time_t mtime; /* modification time */
+	long size; /* and size */
+	BOOLEAN changed; /* TRUE if changed since the last conversion */
+};
+
+/*
+ * All files watched, and the output of the last conversion.
+ */
+typedef struct watch_state watch_state;
+struct watch_state
+{
+	int num_files; /* input files, followed by the parser schema (if any) */
+	watch_file *files;
+	int fd; /* inotify instance (-1 if not available: check files regularly) */
+	char *staging; /* folder that receives output before it is moved into place */
+	int num_published; /* names of files moved to the output folder by the last conversion */
+	char **published;
+};
+
+/* convert, then convert again after each change, until terminated */
+int watch_run ( options *opts );
+
+#endif /* WATCH_H */